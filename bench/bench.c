@@ -0,0 +1,489 @@
+/* bench.c
+ * Throughput benchmarks for libopdis and the opdis output formats.
+ *
+ * Usage: opdis_bench [-t seconds] [-s blob_size] [elf_file]
+ *
+ * Each benchmark is run repeatedly until it has taken at least the minimum
+ * time (default 0.5 seconds), against a synthetic x86-64 blob generated
+ * from a fixed seed and, if given, the .text section of an ELF file.
+ * Results are printed as pipe-delimited lines with a header:
+ *
+ *   benchmark|corpus|iterations|insns|bytes|seconds|insns/s|bytes/s
+ *
+ * where insns and bytes are the instructions and code bytes processed by
+ * a single iteration.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <opdis/opdis.h>
+#include <opdis/insn_vec.h>
+#include <opdis/x86_native.h>
+
+#include "../src/asm_format.h"
+#include "../test/test_code.h"
+
+#define DEFAULT_BLOB_SIZE (1024 * 1024)
+#define DEFAULT_MIN_TIME 0.5
+
+/* ---------------------------------------------------------------------- */
+/* CORPUS */
+
+struct CORPUS {
+	const char * name;
+	opdis_buf_t buf;		/* contents of code section */
+	opdis_vma_t entry;		/* start of control flow disassembly */
+	opdis_insn_t ** insns;		/* insns from linear disassembly */
+	size_t num_insns;
+	size_t insn_bytes;		/* total size of insns */
+	opdis_insn_vec_t vec;		/* insns, for formats which need one */
+};
+
+/* body insns for synthetic functions: common x86-64 integer, SSE and
+ * memory-operand encodings */
+static const struct {
+	unsigned char len;
+	unsigned char bytes[8];
+} body_insns[] = {
+	{ 3, { 0x48, 0x89, 0xc3 } },			/* mov %rax,%rbx */
+	{ 4, { 0x48, 0x8b, 0x45, 0xf8 } },		/* mov -0x8(%rbp),%rax */
+	{ 3, { 0x48, 0x01, 0xd8 } },			/* add %rbx,%rax */
+	{ 4, { 0x48, 0x83, 0xc0, 0x01 } },		/* add $0x1,%rax */
+	{ 2, { 0x31, 0xc0 } },				/* xor %eax,%eax */
+	{ 5, { 0x48, 0x8d, 0x44, 0x24, 0x08 } },	/* lea 0x8(%rsp),%rax */
+	{ 3, { 0x0f, 0xb6, 0xc0 } },			/* movzbl %al,%eax */
+	{ 7, { 0x48, 0xc7, 0xc0, 0x78, 0x56, 0x34, 0x12 } }, /* mov $.,%rax */
+	{ 3, { 0x48, 0x85, 0xc0 } },			/* test %rax,%rax */
+	{ 4, { 0x66, 0x0f, 0xef, 0xc0 } },		/* pxor %xmm0,%xmm0 */
+	{ 5, { 0xf3, 0x0f, 0x10, 0x45, 0xf0 } },	/* movss -0x10(%rbp) */
+	{ 3, { 0x48, 0x39, 0xd8 } },			/* cmp %rbx,%rax */
+	{ 4, { 0x48, 0xc1, 0xe0, 0x04 } },		/* shl $0x4,%rax */
+	{ 5, { 0x48, 0x89, 0x44, 0x24, 0x10 } },	/* mov %rax,0x10(%rsp) */
+	{ 1, { 0x90 } }					/* nop */
+};
+
+#define NUM_BODY_INSNS (sizeof(body_insns) / sizeof(body_insns[0]))
+
+static size_t emit( opdis_byte_t * buf, size_t pos, const void * bytes,
+		    size_t len ) {
+	memcpy( &buf[pos], bytes, len );
+	return pos + len;
+}
+
+static size_t emit_call( opdis_byte_t * buf, size_t pos, size_t target ) {
+	int32_t rel = (int32_t) ( target - (pos + 5) );
+	buf[pos] = 0xe8;
+	memcpy( &buf[pos + 1], &rel, 4 );
+	return pos + 5;
+}
+
+/* A chain of functions: each calls the function before it, so control flow
+ * disassembly from the last function reaches all of them. Function bodies
+ * contain conditional branches over a single insn, and calls to random
+ * earlier functions. */
+static opdis_buf_t make_blob( opdis_off_t size, opdis_vma_t * entry ) {
+	static const unsigned char prologue[] = { 0x55, 0x48, 0x89, 0xe5 };
+	static const unsigned char epilogue[] = { 0x5d, 0xc3 };
+	opdis_buf_t buf = opdis_buf_alloc( size, 0x400000 );
+	size_t pos = 0, prev = 0, last = 0, *funcs = NULL;
+	unsigned int num_funcs = 0;
+	uint32_t seed = 0x0bd15;
+
+	if (! buf ) {
+		return NULL;
+	}
+
+	/* the largest function: prologue, 64 body insns with branches and
+	 * calls, epilogue */
+	while ( pos + 4 + 5 + 64 * (2 + 8) + 2 < size ) {
+		unsigned int i, n = 16 + test_rand( &seed ) % 48;
+		void * ptr = realloc( funcs, (num_funcs + 1) * sizeof(size_t) );
+		if (! ptr ) {
+			break;
+		}
+		funcs = (size_t *) ptr;
+		funcs[num_funcs++] = last = pos;
+
+		pos = emit( buf->data, pos, prologue, sizeof(prologue) );
+		if ( num_funcs > 1 ) {
+			pos = emit_call( buf->data, pos, prev );
+		}
+
+		for ( i = 0; i < n; i++ ) {
+			unsigned int r = test_rand( &seed );
+			unsigned int idx = r % NUM_BODY_INSNS;
+
+			if ( r % 8 == 0 ) {
+				/* je over the next insn */
+				buf->data[pos++] = 0x74;
+				buf->data[pos++] = body_insns[idx].len;
+			} else if ( r % 16 == 1 && num_funcs > 1 ) {
+				pos = emit_call( buf->data, pos,
+					funcs[test_rand( &seed ) % num_funcs] );
+				continue;
+			}
+			pos = emit( buf->data, pos, body_insns[idx].bytes,
+				    body_insns[idx].len );
+		}
+
+		pos = emit( buf->data, pos, epilogue, sizeof(epilogue) );
+		prev = last;
+	}
+
+	/* pad with int3 */
+	memset( &buf->data[pos], 0xcc, size - pos );
+	*entry = buf->vma + last;
+
+	free( funcs );
+	return buf;
+}
+
+/* load the .text section of an ELF file */
+static opdis_buf_t load_elf( const char * path, opdis_vma_t * entry,
+			     unsigned long * mach ) {
+	opdis_buf_t buf;
+	asection * sec;
+	bfd * abfd;
+
+	bfd_init();
+	abfd = bfd_openr( path, NULL );
+	if (! abfd || ! bfd_check_format( abfd, bfd_object ) ) {
+		fprintf( stderr, "Unable to load BFD %s\n", path );
+		return NULL;
+	}
+
+	sec = bfd_get_section_by_name( abfd, ".text" );
+	if (! sec ) {
+		fprintf( stderr, "No .text section in %s\n", path );
+		bfd_close( abfd );
+		return NULL;
+	}
+
+	buf = opdis_buf_alloc( bfd_section_size( abfd, sec ),
+			       bfd_section_vma( abfd, sec ) );
+	if ( buf && ! bfd_get_section_contents( abfd, sec, buf->data, 0,
+						buf->len ) ) {
+		opdis_buf_free( buf );
+		buf = NULL;
+	}
+
+	if ( buf ) {
+		*entry = bfd_get_start_address( abfd );
+		if ( *entry < buf->vma || *entry >= buf->vma + buf->len ) {
+			*entry = buf->vma;
+		}
+		*mach = bfd_get_mach( abfd );
+	}
+
+	bfd_close( abfd );
+	return buf;
+}
+
+static void store_insn( const opdis_insn_t * insn, void * arg ) {
+	struct CORPUS * c = (struct CORPUS *) arg;
+	void * ptr = realloc( c->insns,
+			      (c->num_insns + 1) * sizeof(opdis_insn_t *) );
+	if ( ptr ) {
+		c->insns = (opdis_insn_t **) ptr;
+		c->insns[c->num_insns++] = opdis_insn_dupe( insn );
+		c->insn_bytes += insn->size;
+	}
+}
+
+static int corpus_init( struct CORPUS * c, opdis_t o ) {
+	size_t i;
+
+	opdis_set_display( o, store_insn, c );
+	opdis_disasm_linear( o, c->buf, c->buf->vma, 0 );
+
+	c->vec = opdis_insn_vec_init( 0 );
+	for ( i = 0; c->vec && i < c->num_insns; i++ ) {
+		opdis_insn_vec_add( c->vec, opdis_insn_dupe( c->insns[i] ) );
+	}
+
+	return ( c->num_insns && c->vec );
+}
+
+static void corpus_term( struct CORPUS * c ) {
+	size_t i;
+
+	for ( i = 0; i < c->num_insns; i++ ) {
+		opdis_insn_free( c->insns[i] );
+	}
+	free( c->insns );
+	opdis_insn_vec_free( c->vec );
+	opdis_buf_free( c->buf );
+}
+
+/* ---------------------------------------------------------------------- */
+/* TIMING */
+
+struct BENCH {
+	double min_time;
+	opdis_t o;		/* disassembler for the current corpus */
+	struct CORPUS * corpus;
+	FILE * out;		/* /dev/null, for output formats */
+	size_t insns;		/* insns processed by the last iteration */
+	size_t bytes;		/* code bytes processed by the last iteration */
+};
+
+typedef void (*BENCH_FN) ( struct BENCH * b, void * arg );
+
+static double now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run( struct BENCH * b, const char * name, BENCH_FN fn,
+		 void * arg ) {
+	double start = now(), elapsed;
+	unsigned long iter = 0;
+
+	do {
+		b->insns = b->bytes = 0;
+		fn( b, arg );
+		iter++;
+		elapsed = now() - start;
+	} while ( elapsed < b->min_time );
+
+	printf( "%s|%s|%lu|%lu|%lu|%.6f|%.0f|%.0f\n", name, b->corpus->name,
+		iter, (unsigned long) b->insns, (unsigned long) b->bytes,
+		elapsed, b->insns * iter / elapsed, b->bytes * iter / elapsed );
+	fflush( stdout );
+}
+
+/* ---------------------------------------------------------------------- */
+/* BENCHMARKS */
+
+static void count_insn( const opdis_insn_t * insn, void * arg ) {
+	struct BENCH * b = (struct BENCH *) arg;
+	b->insns++;
+	b->bytes += insn->size;
+}
+
+static void bench_linear( struct BENCH * b, void * arg ) {
+	opdis_visited_clear( b->o->visited_addr );
+	opdis_disasm_linear( b->o, b->corpus->buf, b->corpus->buf->vma, 0 );
+}
+
+static void bench_cflow( struct BENCH * b, void * arg ) {
+	opdis_visited_clear( b->o->visited_addr );
+	opdis_disasm_cflow( b->o, b->corpus->buf, b->corpus->entry );
+}
+
+static void bench_dupe( struct BENCH * b, void * arg ) {
+	struct CORPUS * c = b->corpus;
+	size_t i;
+
+	for ( i = 0; i < c->num_insns; i++ ) {
+		opdis_insn_free( opdis_insn_dupe( c->insns[i] ) );
+	}
+	b->insns = c->num_insns;
+	b->bytes = c->insn_bytes;
+}
+
+static void bench_vma_tree( struct BENCH * b, void * arg ) {
+	struct CORPUS * c = b->corpus;
+	opdis_vma_tree_t tree = (opdis_vma_tree_t) arg;
+	size_t i;
+
+	if ( tree ) {
+		/* lookup */
+		for ( i = 0; i < c->num_insns; i++ ) {
+			opdis_vma_tree_contains( tree, c->insns[i]->vma );
+		}
+	} else {
+		tree = opdis_vma_tree_init();
+		for ( i = 0; i < c->num_insns; i++ ) {
+			opdis_vma_tree_add( tree, c->insns[i]->vma );
+		}
+		opdis_vma_tree_free( tree );
+	}
+	b->insns = c->num_insns;
+	b->bytes = c->insn_bytes;
+}
+
+static void bench_insn_tree( struct BENCH * b, void * arg ) {
+	struct CORPUS * c = b->corpus;
+	opdis_insn_tree_t tree = (opdis_insn_tree_t) arg;
+	size_t i;
+
+	if ( tree ) {
+		for ( i = 0; i < c->num_insns; i++ ) {
+			opdis_insn_tree_find( tree, c->insns[i]->vma );
+		}
+	} else {
+		/* the tree does not own the insns */
+		tree = opdis_insn_tree_init( 0 );
+		for ( i = 0; i < c->num_insns; i++ ) {
+			opdis_insn_tree_add( tree, c->insns[i] );
+		}
+		opdis_insn_tree_free( tree );
+	}
+	b->insns = c->num_insns;
+	b->bytes = c->insn_bytes;
+}
+
+struct FORMAT {
+	const char * name;
+	enum asm_format_t fmt;
+	const char * fmt_str;
+};
+
+static const struct FORMAT formats[] = {
+	{ "format_asm", asmfmt_asm, NULL },
+	{ "format_dump", asmfmt_dump, NULL },
+	{ "format_delim", asmfmt_delim, NULL },
+	{ "format_xml", asmfmt_xml, NULL },
+	{ "format_custom", asmfmt_custom, "%a %b %m %o\n" },
+	{ "format_bin", asmfmt_bin, NULL }
+};
+
+static void bench_format( struct BENCH * b, void * arg ) {
+	const struct FORMAT * f = (const struct FORMAT *) arg;
+	struct CORPUS * c = b->corpus;
+	asm_fmt_t prog = NULL;
+	size_t i;
+
+	if ( f->fmt == asmfmt_bin ) {
+		asm_fwrite_bin( b->out, c->vec );
+	} else {
+		if ( f->fmt_str ) {
+			prog = asm_fmt_compile( f->fmt_str );
+		}
+		asm_fprintf_header( b->out, f->fmt );
+		for ( i = 0; i < c->num_insns; i++ ) {
+			asm_fprintf_insn( b->out, f->fmt, prog, c->insns[i] );
+		}
+		asm_fprintf_footer( b->out, f->fmt );
+		asm_fmt_free( prog );
+	}
+	b->insns = c->num_insns;
+	b->bytes = c->insn_bytes;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void bench_disasm( struct BENCH * b, enum opdis_x86_syntax_t syntax,
+			  const char * suffix ) {
+	char name[64];
+
+	opdis_set_x86_syntax( b->o, syntax );
+	opdis_set_display( b->o, count_insn, b );
+
+	snprintf( name, sizeof(name), "linear_%s", suffix );
+	run( b, name, bench_linear, NULL );
+	snprintf( name, sizeof(name), "cflow_%s", suffix );
+	run( b, name, bench_cflow, NULL );
+}
+
+static void bench_corpus( struct BENCH * b, struct CORPUS * c,
+			  unsigned long mach ) {
+	opdis_vma_tree_t vtree;
+	opdis_insn_tree_t itree;
+	unsigned int i;
+	size_t j;
+
+	b->corpus = c;
+	b->o = opdis_init();
+	opdis_set_arch( b->o, bfd_arch_i386, mach, NULL );
+	b->o->visited_addr = opdis_visited_init();
+
+	if (! corpus_init( c, b->o ) ) {
+		fprintf( stderr, "Unable to disassemble corpus %s\n", c->name );
+		return;
+	}
+
+	/* the decoders, and libopcodes alone for comparison */
+	bench_disasm( b, opdis_x86_syntax_att, "att" );
+	bench_disasm( b, opdis_x86_syntax_intel, "intel" );
+	opdis_set_decoder( b->o, opdis_x86_native_decoder, b->o );
+	bench_disasm( b, opdis_x86_syntax_att, "native_att" );
+	bench_disasm( b, opdis_x86_syntax_intel, "native_intel" );
+	opdis_set_x86_syntax( b->o, opdis_x86_syntax_att );
+	opdis_set_decoder( b->o, opdis_default_decoder, NULL );
+	bench_disasm( b, opdis_x86_syntax_att, "nodecode" );
+
+	run( b, "insn_dupe", bench_dupe, NULL );
+
+	run( b, "vma_tree_insert", bench_vma_tree, NULL );
+	vtree = opdis_vma_tree_init();
+	for ( j = 0; j < c->num_insns; j++ ) {
+		opdis_vma_tree_add( vtree, c->insns[j]->vma );
+	}
+	run( b, "vma_tree_lookup", bench_vma_tree, vtree );
+	opdis_vma_tree_free( vtree );
+
+	run( b, "insn_tree_insert", bench_insn_tree, NULL );
+	itree = opdis_insn_tree_init( 0 );
+	for ( j = 0; j < c->num_insns; j++ ) {
+		opdis_insn_tree_add( itree, c->insns[j] );
+	}
+	run( b, "insn_tree_lookup", bench_insn_tree, itree );
+	opdis_insn_tree_free( itree );
+
+	for ( i = 0; i < sizeof(formats) / sizeof(formats[0]); i++ ) {
+		run( b, formats[i].name, bench_format, (void *) &formats[i] );
+	}
+
+	opdis_visited_free( b->o->visited_addr );
+	opdis_term( b->o );
+	corpus_term( c );
+}
+
+int main( int argc, char ** argv ) {
+	struct BENCH b = { DEFAULT_MIN_TIME };
+	struct CORPUS blob = { "blob" }, elf = { NULL };
+	opdis_off_t blob_size = DEFAULT_BLOB_SIZE;
+	const char * elf_path = NULL;
+	unsigned long mach = bfd_mach_x86_64;
+	int i;
+
+	for ( i = 1; i < argc; i++ ) {
+		if (! strcmp( argv[i], "-t" ) && i + 1 < argc ) {
+			b.min_time = strtod( argv[++i], NULL );
+		} else if (! strcmp( argv[i], "-s" ) && i + 1 < argc ) {
+			blob_size = strtoul( argv[++i], NULL, 0 );
+		} else if ( argv[i][0] != '-' ) {
+			elf_path = argv[i];
+		} else {
+			printf( "Usage: %s [-t seconds] [-s blob_size] "
+				"[elf_file]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	b.out = fopen( "/dev/null", "w" );
+	if (! b.out ) {
+		fprintf( stderr, "Unable to open /dev/null: %s\n",
+			 strerror(errno) );
+		return 2;
+	}
+
+	printf( "benchmark|corpus|iterations|insns|bytes|seconds|insns/s|"
+		"bytes/s\n" );
+
+	blob.buf = make_blob( blob_size, &blob.entry );
+	if (! blob.buf ) {
+		fprintf( stderr, "Unable to generate blob\n" );
+		return 2;
+	}
+	bench_corpus( &b, &blob, bfd_mach_x86_64 );
+
+	if ( elf_path ) {
+		elf.name = elf_path;
+		elf.buf = load_elf( elf_path, &elf.entry, &mach );
+		if ( elf.buf ) {
+			bench_corpus( &b, &elf, mach );
+		}
+	}
+
+	fclose( b.out );
+	return 0;
+}
@@ -171,7 +171,7 @@ static int disassemble_file( const char * name, opdis_off_t offset ) {
 	fclose( f );
 
 	o = opdis_init();
-	o->visited_addr = opdis_vma_tree_init();
+	o->visited_addr = opdis_visited_init();
 
 	tree = opdis_insn_tree_init( 1 );
 	strncpy( handler_arg.halt_mnem, "ret", 32 );
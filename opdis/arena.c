@@ -0,0 +1,127 @@
+/*!
+ * \file arena.c
+ * \brief Arena allocator implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/arena.h>
+
+/* all allocations are aligned to this many bytes */
+#define ARENA_ALIGN sizeof(void *)
+#define ALIGN_SIZE(x) (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/* slab header size, rounded so that slab data is aligned */
+#define SLAB_HDR_SIZE ALIGN_SIZE(sizeof(opdis_arena_slab_t))
+#define SLAB_DATA(s) (((unsigned char *) (s)) + SLAB_HDR_SIZE)
+
+static opdis_arena_slab_t * slab_alloc( opdis_arena_t arena, size_t size ) {
+	opdis_arena_slab_t * s;
+
+	/* calloc: memory handed out by opdis_arena_alloc is zero-filled */
+	s = (opdis_arena_slab_t *) calloc( 1, SLAB_HDR_SIZE + size );
+	if (! s ) {
+		return NULL;
+	}
+
+	s->size = size;
+	s->used = 0;
+	arena->total += SLAB_HDR_SIZE + size;
+
+	return s;
+}
+
+opdis_arena_t LIBCALL opdis_arena_init( size_t slab_size ) {
+	opdis_arena_t a = (opdis_arena_t) calloc( 1,
+						  sizeof(opdis_arena_base_t) );
+	if ( a ) {
+		a->slab_size = ( slab_size ) ? ALIGN_SIZE(slab_size) :
+					       OPDIS_ARENA_SLAB_SIZE;
+	}
+
+	return a;
+}
+
+void * LIBCALL opdis_arena_alloc( opdis_arena_t arena, size_t size ) {
+	opdis_arena_slab_t * s;
+	void * ptr;
+
+	if (! arena ) {
+		return NULL;
+	}
+
+	size = ALIGN_SIZE( (size) ? size : 1 );
+
+	if ( size > arena->slab_size / 4 ) {
+		/* large object: give it its own slab behind the current one
+		 * so that the remainder of the current slab is not wasted */
+		s = slab_alloc( arena, size );
+		if (! s ) {
+			return NULL;
+		}
+		s->used = size;
+		if ( arena->slabs ) {
+			s->next = arena->slabs->next;
+			arena->slabs->next = s;
+		} else {
+			arena->slabs = s;
+		}
+		return SLAB_DATA(s);
+	}
+
+	s = arena->slabs;
+	if (! s || s->size - s->used < size ) {
+		s = slab_alloc( arena, arena->slab_size );
+		if (! s ) {
+			return NULL;
+		}
+		s->next = arena->slabs;
+		arena->slabs = s;
+	}
+
+	ptr = SLAB_DATA(s) + s->used;
+	s->used += size;
+
+	return ptr;
+}
+
+char * LIBCALL opdis_arena_strdup( opdis_arena_t arena, const char * str ) {
+	size_t len;
+	char * s;
+
+	if (! str ) {
+		return NULL;
+	}
+
+	len = strlen(str) + 1;
+	s = (char *) opdis_arena_alloc( arena, len );
+	if ( s ) {
+		memcpy( s, str, len );
+	}
+
+	return s;
+}
+
+size_t LIBCALL opdis_arena_size( opdis_arena_t arena ) {
+	return ( arena ) ? arena->total : 0;
+}
+
+void LIBCALL opdis_arena_free( opdis_arena_t arena ) {
+	opdis_arena_slab_t * s, * next;
+
+	if (! arena ) {
+		return;
+	}
+
+	for ( s = arena->slabs; s; s = next ) {
+		next = s->next;
+		free( s );
+	}
+
+	free( arena );
+}
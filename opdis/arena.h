@@ -0,0 +1,115 @@
+/*!
+ * \file arena.h
+ * \brief Arena (slab) allocator for libopdis objects.
+ * \details This provides a bump allocator which carves small objects such
+ *          as tree nodes and duplicated instructions out of large slabs.
+ *          Objects allocated from an arena are not freed individually;
+ *          all of them are released at once by opdis_arena_free.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_ARENA_H
+#define OPDIS_ARENA_H
+
+#include <stddef.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_ARENA_SLAB_SIZE
+ * \ingroup internal
+ * \brief Default size of an arena slab in bytes.
+ */
+#define OPDIS_ARENA_SLAB_SIZE (1024 * 1024)
+
+/*! \struct opdis_arena_slab_t
+ *  \ingroup internal
+ *  \brief A block of memory from which arena objects are allocated.
+ */
+typedef struct opdis_arena_slab {
+	struct opdis_arena_slab * next;	/*!< Next (older) slab */
+	size_t			size;	/*!< Usable size of slab */
+	size_t			used;	/*!< Bytes allocated from slab */
+} opdis_arena_slab_t;
+
+/*! \struct opdis_arena_base_t
+ *  \ingroup internal
+ *  \brief An arena allocator.
+ */
+typedef struct {
+	opdis_arena_slab_t	* slabs;	/*!< Current slab (list head) */
+	size_t			slab_size;	/*!< Size of new slabs */
+	size_t			total;		/*!< Total bytes in all slabs */
+} opdis_arena_base_t;
+
+/*! \typedef opdis_arena_base_t * opdis_arena_t
+ *  \ingroup internal
+ *  \brief An arena allocator.
+ */
+typedef opdis_arena_base_t * opdis_arena_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn opdis_arena_t opdis_arena_init( size_t )
+ * \ingroup internal
+ * \brief Allocate an arena.
+ * \param slab_size Size of each slab in bytes, or 0 for the default.
+ * \return The allocated arena.
+ * \sa opdis_arena_free
+ */
+opdis_arena_t LIBCALL opdis_arena_init( size_t slab_size );
+
+/*!
+ * \fn void * opdis_arena_alloc( opdis_arena_t, size_t )
+ * \ingroup internal
+ * \brief Allocate zero-filled memory from an arena.
+ * \param arena The arena.
+ * \param size Number of bytes to allocate.
+ * \return Pointer to the memory, or NULL.
+ * \note Allocations larger than a quarter of the slab size get a slab of
+ *       their own.
+ */
+void * LIBCALL opdis_arena_alloc( opdis_arena_t arena, size_t size );
+
+/*!
+ * \fn char * opdis_arena_strdup( opdis_arena_t, const char * )
+ * \ingroup internal
+ * \brief Copy a string into an arena.
+ * \param arena The arena.
+ * \param str The string to copy.
+ * \return The copy, or NULL.
+ */
+char * LIBCALL opdis_arena_strdup( opdis_arena_t arena, const char * str );
+
+/*!
+ * \fn size_t opdis_arena_size( opdis_arena_t )
+ * \ingroup internal
+ * \brief Return the number of bytes the arena has obtained from the system.
+ * \param arena The arena.
+ */
+size_t LIBCALL opdis_arena_size( opdis_arena_t arena );
+
+/*!
+ * \fn void opdis_arena_free( opdis_arena_t )
+ * \ingroup internal
+ * \brief Free an arena and every object allocated from it.
+ * \param arena The arena.
+ */
+void LIBCALL opdis_arena_free( opdis_arena_t arena );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
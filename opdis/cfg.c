@@ -0,0 +1,555 @@
+/*!
+ * \file cfg.c
+ * \brief Control flow graph implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/cfg.h>
+
+#define CFG_INIT_INSNS 256
+#define CFG_INIT_FUNCS 16
+
+/* ---------------------------------------------------------------------- */
+/* RECORDING */
+
+opdis_cfg_t LIBCALL opdis_cfg_init( void ) {
+	opdis_cfg_t cfg = (opdis_cfg_t) calloc( 1, sizeof(opdis_cfg_base_t) );
+	if (! cfg ) {
+		return NULL;
+	}
+
+	cfg->alloc_insns = CFG_INIT_INSNS;
+	cfg->insns = (opdis_cfg_insn_t *) calloc( cfg->alloc_insns,
+						sizeof(opdis_cfg_insn_t) );
+	cfg->alloc_funcs = CFG_INIT_FUNCS;
+	cfg->funcs = (opdis_cfg_func_t *) calloc( cfg->alloc_funcs,
+						sizeof(opdis_cfg_func_t) );
+	cfg->num_buckets = CFG_INIT_FUNCS * 2;
+	cfg->func_index = (unsigned int *) calloc( cfg->num_buckets,
+						   sizeof(unsigned int) );
+	if (! cfg->insns || ! cfg->funcs || ! cfg->func_index ) {
+		opdis_cfg_free( cfg );
+		return NULL;
+	}
+
+	return cfg;
+}
+
+int LIBCALL opdis_cfg_add_insn( opdis_cfg_t cfg, const opdis_insn_t * insn,
+				opdis_vma_t target ) {
+	opdis_cfg_insn_t * i;
+
+	if (! cfg || ! insn || ! insn->size ) {
+		return 0;
+	}
+
+	if ( cfg->num_insns == cfg->alloc_insns ) {
+		size_t alloc = cfg->alloc_insns * 2;
+		void * ptr = realloc( cfg->insns,
+				      alloc * sizeof(opdis_cfg_insn_t) );
+		if (! ptr ) {
+			return 0;
+		}
+		cfg->insns = (opdis_cfg_insn_t *) ptr;
+		cfg->alloc_insns = alloc;
+	}
+
+	i = &cfg->insns[cfg->num_insns++];
+	i->vma = insn->vma;
+	i->size = (uint32_t) insn->size;
+	i->target = target;
+	i->flags = 0;
+
+	if ( opdis_insn_fallthrough( (opdis_insn_t *) insn ) ) {
+		i->flags |= OPDIS_CFG_INSN_FALLTHROUGH;
+	}
+	if ( opdis_insn_is_branch( (opdis_insn_t *) insn ) ) {
+		i->flags |= OPDIS_CFG_INSN_BRANCH;
+		if ( insn->flags.cflow == opdis_cflow_flag_call ||
+		     insn->flags.cflow == opdis_cflow_flag_callcc ) {
+			i->flags |= OPDIS_CFG_INSN_CALL;
+		}
+	}
+
+	cfg->dirty = 1;
+
+	/* call targets are function entry points */
+	if ( (i->flags & OPDIS_CFG_INSN_CALL) && target != OPDIS_INVALID_ADDR ) {
+		return opdis_cfg_add_func( cfg, target, NULL );
+	}
+
+	return 1;
+}
+
+/* return the slot of func_index for vma: either the slot holding it, or an
+ * empty one */
+static unsigned int * func_slot( opdis_cfg_t cfg, opdis_vma_t vma ) {
+	size_t mask = cfg->num_buckets - 1;
+	size_t i = (size_t) ( ( (uint64_t) vma * 0x9E3779B97F4A7C15ULL ) >> 32 )
+		   & mask;
+
+	while ( cfg->func_index[i] &&
+		cfg->funcs[cfg->func_index[i] - 1].vma != vma ) {
+		i = ( i + 1 ) & mask;
+	}
+
+	return &cfg->func_index[i];
+}
+
+/* double the size of func_index, which is kept at most half full */
+static int grow_func_index( opdis_cfg_t cfg ) {
+	size_t i, num_buckets = cfg->num_buckets * 2;
+	unsigned int * index;
+
+	index = (unsigned int *) calloc( num_buckets, sizeof(unsigned int) );
+	if (! index ) {
+		return 0;
+	}
+
+	free( cfg->func_index );
+	cfg->func_index = index;
+	cfg->num_buckets = num_buckets;
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		*func_slot( cfg, cfg->funcs[i].vma ) = i + 1;
+	}
+
+	return 1;
+}
+
+static opdis_cfg_func_t * find_func( opdis_cfg_t cfg, opdis_vma_t vma ) {
+	unsigned int idx = *func_slot( cfg, vma );
+
+	return ( idx ) ? &cfg->funcs[idx - 1] : NULL;
+}
+
+int LIBCALL opdis_cfg_add_func( opdis_cfg_t cfg, opdis_vma_t vma,
+				const char * name ) {
+	opdis_cfg_func_t * f;
+	unsigned int * slot;
+
+	if (! cfg ) {
+		return 0;
+	}
+
+	slot = func_slot( cfg, vma );
+	if (! *slot ) {
+		if ( ( cfg->num_funcs + 1 ) * 2 > cfg->num_buckets ) {
+			if (! grow_func_index( cfg ) ) {
+				return 0;
+			}
+			slot = func_slot( cfg, vma );
+		}
+
+		if ( cfg->num_funcs == cfg->alloc_funcs ) {
+			size_t alloc = cfg->alloc_funcs * 2;
+			void * ptr = realloc( cfg->funcs,
+					      alloc * sizeof(opdis_cfg_func_t) );
+			if (! ptr ) {
+				return 0;
+			}
+			cfg->funcs = (opdis_cfg_func_t *) ptr;
+			cfg->alloc_funcs = alloc;
+		}
+
+		f = &cfg->funcs[cfg->num_funcs++];
+		memset( f, 0, sizeof(opdis_cfg_func_t) );
+		f->vma = vma;
+		f->entry = OPDIS_CFG_NONE;
+		*slot = cfg->num_funcs;
+		cfg->dirty = 1;
+	}
+
+	f = &cfg->funcs[*slot - 1];
+
+	if ( name && ! f->name ) {
+		f->name = strdup( name );
+	}
+
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* BUILDING */
+
+static int cmp_insn( const void * a, const void * b ) {
+	opdis_vma_t va = ((const opdis_cfg_insn_t *) a)->vma;
+	opdis_vma_t vb = ((const opdis_cfg_insn_t *) b)->vma;
+
+	return ( va < vb ) ? -1 : ( va > vb );
+}
+
+/* index of the recorded insn at vma, or OPDIS_CFG_NONE */
+static unsigned int find_insn( opdis_cfg_t cfg, opdis_vma_t vma ) {
+	size_t lo = 0, hi = cfg->num_insns;
+
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ( cfg->insns[mid].vma < vma ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if ( lo < cfg->num_insns && cfg->insns[lo].vma == vma ) {
+		return (unsigned int) lo;
+	}
+
+	return OPDIS_CFG_NONE;
+}
+
+static void sort_insns( opdis_cfg_t cfg ) {
+	size_t i, num = 0;
+
+	qsort( cfg->insns, cfg->num_insns, sizeof(opdis_cfg_insn_t), cmp_insn );
+
+	for ( i = 0; i < cfg->num_insns; i++ ) {
+		if ( num && cfg->insns[num - 1].vma == cfg->insns[i].vma ) {
+			continue;
+		}
+		cfg->insns[num++] = cfg->insns[i];
+	}
+	cfg->num_insns = num;
+}
+
+static void free_blocks( opdis_cfg_t cfg ) {
+	free( cfg->blocks );
+	free( cfg->edges );
+	free( cfg->preds );
+	free( cfg->func_blocks );
+	cfg->blocks = NULL;
+	cfg->edges = NULL;
+	cfg->preds = NULL;
+	cfg->func_blocks = NULL;
+	cfg->num_blocks = cfg->num_edges = 0;
+}
+
+/* fill insn_block with the block index of each insn */
+static size_t build_blocks( opdis_cfg_t cfg, unsigned int * insn_block ) {
+	opdis_cfg_block_t * b = NULL;
+	size_t i, num = 0;
+	unsigned int j;
+
+	/* mark leaders: branch targets, entry points, and the insns after a
+	 * gap or a control flow insn */
+	memset( insn_block, 0, cfg->num_insns * sizeof(unsigned int) );
+	for ( i = 0; i < cfg->num_insns; i++ ) {
+		const opdis_cfg_insn_t * prev = ( i ) ? &cfg->insns[i - 1] :
+						    NULL;
+		if ( ! prev || prev->vma + prev->size != cfg->insns[i].vma ||
+		     ! (prev->flags & OPDIS_CFG_INSN_FALLTHROUGH) ||
+		     (prev->flags & OPDIS_CFG_INSN_BRANCH) ) {
+			insn_block[i] = 1;
+		}
+		if ( cfg->insns[i].target != OPDIS_INVALID_ADDR &&
+		     (j = find_insn( cfg, cfg->insns[i].target ))
+		     != OPDIS_CFG_NONE ) {
+			insn_block[j] = 1;
+		}
+	}
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		if ( (j = find_insn( cfg, cfg->funcs[i].vma ))
+		     != OPDIS_CFG_NONE ) {
+			insn_block[j] = 1;
+		}
+	}
+
+	for ( i = 0; i < cfg->num_insns; i++ ) {
+		num += insn_block[i];
+	}
+
+	cfg->blocks = (opdis_cfg_block_t *) calloc( num + 1,
+						sizeof(opdis_cfg_block_t) );
+	if (! cfg->blocks ) {
+		return 0;
+	}
+
+	for ( i = 0, num = 0; i < cfg->num_insns; i++ ) {
+		if ( insn_block[i] ) {
+			b = &cfg->blocks[num++];
+			b->vma = cfg->insns[i].vma;
+			b->func = OPDIS_CFG_NONE;
+		}
+		b->size += cfg->insns[i].size;
+		b->num_insns++;
+		insn_block[i] = (unsigned int) (num - 1);
+	}
+
+	cfg->num_blocks = num;
+	return num;
+}
+
+static void add_edge( opdis_cfg_t cfg, unsigned int src, unsigned int dest,
+		      enum opdis_cfg_edge_type_t type ) {
+	opdis_cfg_edge_t * e = &cfg->edges[cfg->num_edges++];
+
+	e->src = src;
+	e->dest = dest;
+	e->type = type;
+	cfg->blocks[src].num_succ++;
+	cfg->blocks[dest].num_pred++;
+}
+
+static int build_edges( opdis_cfg_t cfg, const unsigned int * insn_block ) {
+	size_t i, last = 0;
+	unsigned int j, pos;
+
+	/* a block has at most a fallthrough and a branch successor */
+	cfg->edges = (opdis_cfg_edge_t *) calloc( cfg->num_blocks * 2 + 1,
+						sizeof(opdis_cfg_edge_t) );
+	cfg->preds = (unsigned int *) calloc( cfg->num_blocks * 2 + 1,
+					      sizeof(unsigned int) );
+	if (! cfg->edges || ! cfg->preds ) {
+		return 0;
+	}
+
+	for ( i = 0; i < cfg->num_blocks; i++ ) {
+		opdis_cfg_block_t * b = &cfg->blocks[i];
+		const opdis_cfg_insn_t * insn;
+
+		last += b->num_insns;
+		insn = &cfg->insns[last - 1];
+		b->succ = (unsigned int) cfg->num_edges;
+
+		if ( (insn->flags & OPDIS_CFG_INSN_FALLTHROUGH) &&
+		     i + 1 < cfg->num_blocks &&
+		     b[1].vma == insn->vma + insn->size ) {
+			add_edge( cfg, i, i + 1, opdis_cfg_edge_fallthrough );
+		}
+
+		if ( (insn->flags & OPDIS_CFG_INSN_BRANCH) &&
+		     insn->target != OPDIS_INVALID_ADDR &&
+		     (j = find_insn( cfg, insn->target )) != OPDIS_CFG_NONE ) {
+			add_edge( cfg, i, insn_block[j],
+				  (insn->flags & OPDIS_CFG_INSN_CALL) ?
+				  opdis_cfg_edge_call : opdis_cfg_edge_jump );
+		}
+	}
+
+	/* predecessors: edge indices bucketed by destination block */
+	for ( i = 0, pos = 0; i < cfg->num_blocks; i++ ) {
+		cfg->blocks[i].pred = pos;
+		pos += cfg->blocks[i].num_pred;
+		cfg->blocks[i].num_pred = 0;
+	}
+	for ( i = 0; i < cfg->num_edges; i++ ) {
+		opdis_cfg_block_t * b = &cfg->blocks[cfg->edges[i].dest];
+		cfg->preds[b->pred + b->num_pred++] = (unsigned int) i;
+	}
+
+	return 1;
+}
+
+/* assign each block to the first function which reaches it without
+ * following a call */
+static int build_funcs( opdis_cfg_t cfg, const unsigned int * insn_block ) {
+	unsigned int * stack, pos = 0;
+	size_t i;
+
+	cfg->func_blocks = (unsigned int *) calloc( cfg->num_blocks + 1,
+						    sizeof(unsigned int) );
+	stack = (unsigned int *) calloc( cfg->num_blocks + 1,
+					 sizeof(unsigned int) );
+	if (! cfg->func_blocks || ! stack ) {
+		free( stack );
+		return 0;
+	}
+
+	/* entry points are claimed first, so that a tail jump into another
+	 * function does not absorb it */
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		opdis_cfg_func_t * f = &cfg->funcs[i];
+		unsigned int j = find_insn( cfg, f->vma );
+
+		f->entry = ( j == OPDIS_CFG_NONE ) ? j : insn_block[j];
+		f->num_blocks = 0;
+		if ( f->entry != OPDIS_CFG_NONE &&
+		     cfg->blocks[f->entry].func == OPDIS_CFG_NONE ) {
+			cfg->blocks[f->entry].func = (unsigned int) i;
+		}
+	}
+
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		opdis_cfg_func_t * f = &cfg->funcs[i];
+		unsigned int top = 0;
+
+		f->first = pos;
+		if ( f->entry == OPDIS_CFG_NONE ||
+		     cfg->blocks[f->entry].func != i ) {
+			continue;
+		}
+
+		stack[top++] = f->entry;
+		while ( top ) {
+			const opdis_cfg_block_t * b = &cfg->blocks[stack[--top]];
+			unsigned int n;
+
+			cfg->func_blocks[pos++] = (unsigned int) (b - cfg->blocks);
+			f->num_blocks++;
+
+			/* push in reverse so the first successor is next */
+			for ( n = b->num_succ; n > 0; n-- ) {
+				const opdis_cfg_edge_t * e =
+					&cfg->edges[b->succ + n - 1];
+				opdis_cfg_block_t * d = &cfg->blocks[e->dest];
+				if ( e->type == opdis_cfg_edge_call ||
+				     d->func != OPDIS_CFG_NONE ) {
+					continue;
+				}
+				d->func = (unsigned int) i;
+				stack[top++] = e->dest;
+			}
+		}
+	}
+
+	free( stack );
+	return 1;
+}
+
+size_t LIBCALL opdis_cfg_build( opdis_cfg_t cfg ) {
+	unsigned int * insn_block;
+
+	if (! cfg ) {
+		return 0;
+	}
+
+	if (! cfg->dirty ) {
+		return cfg->num_blocks;
+	}
+
+	free_blocks( cfg );
+	sort_insns( cfg );
+	cfg->dirty = 0;
+
+	insn_block = (unsigned int *) calloc( cfg->num_insns + 1,
+					      sizeof(unsigned int) );
+	if (! insn_block || ! build_blocks( cfg, insn_block ) ||
+	     ! build_edges( cfg, insn_block ) ||
+	     ! build_funcs( cfg, insn_block ) ) {
+		if ( cfg->num_insns ) {
+			fprintf( stderr, "Unable to allocate CFG blocks\n" );
+		}
+		free_blocks( cfg );
+	}
+
+	free( insn_block );
+	return cfg->num_blocks;
+}
+
+/* ---------------------------------------------------------------------- */
+/* WALKING */
+
+const opdis_cfg_block_t * LIBCALL opdis_cfg_find_block( opdis_cfg_t cfg,
+							opdis_vma_t vma ) {
+	size_t lo = 0, hi;
+
+	if (! cfg ) {
+		return NULL;
+	}
+
+	hi = opdis_cfg_build( cfg );
+
+	/* last block starting at or before vma */
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ( cfg->blocks[mid].vma <= vma ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if ( lo && vma < cfg->blocks[lo - 1].vma + cfg->blocks[lo - 1].size ) {
+		return &cfg->blocks[lo - 1];
+	}
+
+	return NULL;
+}
+
+const opdis_cfg_func_t * LIBCALL opdis_cfg_find_func( opdis_cfg_t cfg,
+						      opdis_vma_t vma ) {
+	if (! cfg ) {
+		return NULL;
+	}
+
+	opdis_cfg_build( cfg );
+	return find_func( cfg, vma );
+}
+
+const opdis_cfg_edge_t * LIBCALL opdis_cfg_succ( opdis_cfg_t cfg,
+					const opdis_cfg_block_t * block,
+					unsigned int n ) {
+	if (! cfg || ! block || n >= block->num_succ ) {
+		return NULL;
+	}
+
+	return &cfg->edges[block->succ + n];
+}
+
+const opdis_cfg_edge_t * LIBCALL opdis_cfg_pred( opdis_cfg_t cfg,
+					const opdis_cfg_block_t * block,
+					unsigned int n ) {
+	if (! cfg || ! block || n >= block->num_pred ) {
+		return NULL;
+	}
+
+	return &cfg->edges[cfg->preds[block->pred + n]];
+}
+
+void LIBCALL opdis_cfg_foreach_block( opdis_cfg_t cfg, OPDIS_CFG_BLOCK_FN fn,
+				      void * arg ) {
+	size_t i, num;
+
+	if (! cfg || ! fn ) {
+		return;
+	}
+
+	num = opdis_cfg_build( cfg );
+	for ( i = 0; i < num; i++ ) {
+		if (! fn( cfg, &cfg->blocks[i], arg ) ) {
+			break;
+		}
+	}
+}
+
+void LIBCALL opdis_cfg_foreach_func_block( opdis_cfg_t cfg,
+					   const opdis_cfg_func_t * func,
+					   OPDIS_CFG_BLOCK_FN fn, void * arg ) {
+	unsigned int i;
+
+	if (! cfg || ! func || ! fn ) {
+		return;
+	}
+
+	opdis_cfg_build( cfg );
+	for ( i = 0; i < func->num_blocks; i++ ) {
+		unsigned int b = cfg->func_blocks[func->first + i];
+		if (! fn( cfg, &cfg->blocks[b], arg ) ) {
+			break;
+		}
+	}
+}
+
+void LIBCALL opdis_cfg_free( opdis_cfg_t cfg ) {
+	size_t i;
+
+	if (! cfg ) {
+		return;
+	}
+
+	free_blocks( cfg );
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		free( cfg->funcs[i].name );
+	}
+	free( cfg->funcs );
+	free( cfg->func_index );
+	free( cfg->insns );
+	free( cfg );
+}
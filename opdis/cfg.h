@@ -0,0 +1,329 @@
+/*!
+ * \file cfg.h
+ * \brief Basic blocks and control flow graphs for libopdis.
+ * \details A control flow graph is filled by control flow disassembly: if
+ *          a graph has been set with opdis_set_cfg, every instruction which
+ *          is displayed is recorded in it along with its branch target.
+ *          The basic blocks and edges are built from the recorded
+ *          instructions when the graph is first examined, so a branch into
+ *          the middle of a block which was disassembled earlier splits the
+ *          block.
+ *          Blocks and edges are stored in arrays: the successor edges of a
+ *          block are contiguous in the edge array, and its predecessor
+ *          edges are contiguous in the predecessor array.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_CFG_H
+#define OPDIS_CFG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <opdis/types.h>
+#include <opdis/model.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_CFG_NONE
+ * \ingroup cfg
+ * \brief Index of a missing block or function.
+ */
+#define OPDIS_CFG_NONE ((unsigned int) -1)
+
+/*!
+ * \def OPDIS_CFG_INSN_FALLTHROUGH
+ * \ingroup cfg
+ * \brief Execution can continue to the next instruction.
+ */
+#define OPDIS_CFG_INSN_FALLTHROUGH 1
+
+/*!
+ * \def OPDIS_CFG_INSN_BRANCH
+ * \ingroup cfg
+ * \brief The instruction is a jump or call.
+ */
+#define OPDIS_CFG_INSN_BRANCH 2
+
+/*!
+ * \def OPDIS_CFG_INSN_CALL
+ * \ingroup cfg
+ * \brief The instruction is a call.
+ */
+#define OPDIS_CFG_INSN_CALL 4
+
+/*!
+ * \enum opdis_cfg_edge_type_t
+ * \ingroup cfg
+ * \brief The type of a control flow graph edge.
+ */
+enum opdis_cfg_edge_type_t {
+	opdis_cfg_edge_fallthrough=1,	/*!< Execution continues to dest */
+	opdis_cfg_edge_jump=2,		/*!< Jump or conditional jump to dest */
+	opdis_cfg_edge_call=3		/*!< Call or conditional call to dest */
+};
+
+/*! \struct opdis_cfg_insn_t
+ *  \ingroup cfg
+ *  \brief An instruction recorded in a control flow graph.
+ */
+typedef struct {
+	opdis_vma_t	vma;		/*!< Address of insn */
+	opdis_vma_t	target;		/*!< Branch target or OPDIS_INVALID_ADDR */
+	uint32_t	size;		/*!< Size of insn in bytes */
+	uint32_t	flags;		/*!< OPDIS_CFG_INSN_* flags */
+} opdis_cfg_insn_t;
+
+/*! \struct opdis_cfg_edge_t
+ *  \ingroup cfg
+ *  \brief An edge between two basic blocks.
+ */
+typedef struct {
+	unsigned int	src;		/*!< Index of source block */
+	unsigned int	dest;		/*!< Index of destination block */
+	enum opdis_cfg_edge_type_t type; /*!< Type of edge */
+} opdis_cfg_edge_t;
+
+/*! \struct opdis_cfg_block_t
+ *  \ingroup cfg
+ *  \brief A basic block.
+ *  \details The successors of the block are edges[succ] to
+ *           edges[succ + num_succ - 1]; the predecessors are the edges
+ *           indexed by preds[pred] to preds[pred + num_pred - 1].
+ */
+typedef struct {
+	opdis_vma_t	vma;		/*!< Address of first insn */
+	opdis_off_t	size;		/*!< Size of block in bytes */
+	unsigned int	num_insns;	/*!< Number of insns in block */
+	unsigned int	func;		/*!< Function containing block */
+	unsigned int	succ;		/*!< Index of first successor edge */
+	unsigned int	num_succ;	/*!< Number of successor edges */
+	unsigned int	pred;		/*!< Index of first predecessor */
+	unsigned int	num_pred;	/*!< Number of predecessor edges */
+} opdis_cfg_block_t;
+
+/*! \struct opdis_cfg_func_t
+ *  \ingroup cfg
+ *  \brief A function: the blocks reachable from an entry point.
+ *  \details The blocks of the function are indexed by func_blocks[first]
+ *           to func_blocks[first + num_blocks - 1], entry block first.
+ *           Call edges are not followed, so the function is the subgraph
+ *           of the blocks which it contains; a block reachable from
+ *           several entry points belongs to the first.
+ */
+typedef struct {
+	opdis_vma_t	vma;		/*!< Entry point */
+	char *		name;		/*!< Name of function or NULL */
+	unsigned int	entry;		/*!< Index of entry block */
+	unsigned int	first;		/*!< Index of first block in func_blocks */
+	unsigned int	num_blocks;	/*!< Number of blocks in function */
+} opdis_cfg_func_t;
+
+/*! \struct opdis_cfg_base_t
+ *  \ingroup cfg
+ *  \brief A control flow graph.
+ *  \details The block, edge and function block arrays are rebuilt from
+ *           the recorded instructions by opdis_cfg_build when they are out
+ *           of date; they should only be read after it has been called.
+ */
+typedef struct {
+	opdis_cfg_insn_t * insns;	/*!< Recorded instructions */
+	size_t		num_insns;	/*!< Number of recorded instructions */
+	size_t		alloc_insns;	/*!< Allocated size of insns */
+	opdis_cfg_func_t * funcs;	/*!< Function entry points */
+	size_t		num_funcs;	/*!< Number of functions */
+	size_t		alloc_funcs;	/*!< Allocated size of funcs */
+	unsigned int *	func_index;	/*!< Hash of funcs by VMA: index + 1 */
+	size_t		num_buckets;	/*!< Size of func_index, a power of 2 */
+
+	opdis_cfg_block_t * blocks;	/*!< Blocks, sorted by VMA */
+	size_t		num_blocks;	/*!< Number of blocks */
+	opdis_cfg_edge_t * edges;	/*!< Edges, sorted by source block */
+	size_t		num_edges;	/*!< Number of edges */
+	unsigned int *	preds;		/*!< Edge indices, sorted by dest */
+	unsigned int *	func_blocks;	/*!< Block indices, grouped by func */
+	int		dirty;		/*!< Blocks are out of date */
+} opdis_cfg_base_t;
+
+/*! \typedef opdis_cfg_base_t * opdis_cfg_t
+ *  \ingroup cfg
+ *  \brief A control flow graph.
+ */
+typedef opdis_cfg_base_t * opdis_cfg_t;
+
+/*!
+ * \typedef int (*OPDIS_CFG_BLOCK_FN) ( opdis_cfg_t,
+ * 				       const opdis_cfg_block_t *, void * )
+ * \ingroup cfg
+ * \brief Callback invoked for each block in a control flow graph.
+ * \param cfg The control flow graph.
+ * \param block The block.
+ * \param arg Argument provided by the caller.
+ * \return 1 to continue, 0 to stop.
+ * \sa opdis_cfg_foreach_block
+ */
+typedef int (*OPDIS_CFG_BLOCK_FN) ( opdis_cfg_t cfg,
+				    const opdis_cfg_block_t * block,
+				    void * arg );
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn opdis_cfg_t opdis_cfg_init( void )
+ * \ingroup cfg
+ * \brief Allocate an empty control flow graph.
+ * \return The allocated graph.
+ * \sa opdis_cfg_free opdis_set_cfg
+ */
+opdis_cfg_t LIBCALL opdis_cfg_init( void );
+
+/*!
+ * \fn int opdis_cfg_add_insn( opdis_cfg_t, const opdis_insn_t *,
+ * 			       opdis_vma_t )
+ * \ingroup cfg
+ * \brief Record a disassembled instruction.
+ * \param cfg The control flow graph.
+ * \param insn The instruction.
+ * \param target The resolved branch target, or OPDIS_INVALID_ADDR.
+ * \return 1 on success, 0 on error.
+ * \details Control flow disassembly calls this for every displayed
+ *          instruction when a graph has been set with opdis_set_cfg.
+ *          Blocks end after a call, jump or return; a branch target starts
+ *          a block, and a call target is added as a function.
+ * \note An instruction recorded twice is only kept once.
+ */
+int LIBCALL opdis_cfg_add_insn( opdis_cfg_t cfg, const opdis_insn_t * insn,
+				opdis_vma_t target );
+
+/*!
+ * \fn int opdis_cfg_add_func( opdis_cfg_t, opdis_vma_t, const char * )
+ * \ingroup cfg
+ * \brief Add a function entry point.
+ * \param cfg The control flow graph.
+ * \param vma The entry point.
+ * \param name The function name, or NULL.
+ * \return 1 on success, 0 on error.
+ * \details Control flow disassembly adds each start address as a function.
+ *          Adding an existing entry point with a name sets its name.
+ */
+int LIBCALL opdis_cfg_add_func( opdis_cfg_t cfg, opdis_vma_t vma,
+				const char * name );
+
+/*!
+ * \fn size_t opdis_cfg_build( opdis_cfg_t )
+ * \ingroup cfg
+ * \brief Build the blocks and edges of a graph.
+ * \param cfg The control flow graph.
+ * \return The number of blocks.
+ * \note This is invoked automatically by the lookup and foreach functions
+ *       if instructions have been recorded since the last build.
+ */
+size_t LIBCALL opdis_cfg_build( opdis_cfg_t cfg );
+
+/*!
+ * \fn const opdis_cfg_block_t * opdis_cfg_find_block( opdis_cfg_t,
+ * 						      opdis_vma_t )
+ * \ingroup cfg
+ * \brief Find the block containing an address.
+ * \param cfg The control flow graph.
+ * \param vma The address.
+ * \return The block or NULL.
+ */
+const opdis_cfg_block_t * LIBCALL opdis_cfg_find_block( opdis_cfg_t cfg,
+							opdis_vma_t vma );
+
+/*!
+ * \fn const opdis_cfg_func_t * opdis_cfg_find_func( opdis_cfg_t,
+ * 						    opdis_vma_t )
+ * \ingroup cfg
+ * \brief Find a function by entry point.
+ * \param cfg The control flow graph.
+ * \param vma The entry point.
+ * \return The function or NULL.
+ */
+const opdis_cfg_func_t * LIBCALL opdis_cfg_find_func( opdis_cfg_t cfg,
+						      opdis_vma_t vma );
+
+/*!
+ * \fn const opdis_cfg_edge_t * opdis_cfg_succ( opdis_cfg_t,
+ * 					      const opdis_cfg_block_t *,
+ * 					      unsigned int )
+ * \ingroup cfg
+ * \brief Return a successor edge of a block.
+ * \param cfg The control flow graph.
+ * \param block The block.
+ * \param n The index of the successor.
+ * \return The edge, or NULL if \e block has fewer than n + 1 successors.
+ */
+const opdis_cfg_edge_t * LIBCALL opdis_cfg_succ( opdis_cfg_t cfg,
+					const opdis_cfg_block_t * block,
+					unsigned int n );
+
+/*!
+ * \fn const opdis_cfg_edge_t * opdis_cfg_pred( opdis_cfg_t,
+ * 					      const opdis_cfg_block_t *,
+ * 					      unsigned int )
+ * \ingroup cfg
+ * \brief Return a predecessor edge of a block.
+ * \param cfg The control flow graph.
+ * \param block The block.
+ * \param n The index of the predecessor.
+ * \return The edge, or NULL if \e block has fewer than n + 1 predecessors.
+ */
+const opdis_cfg_edge_t * LIBCALL opdis_cfg_pred( opdis_cfg_t cfg,
+					const opdis_cfg_block_t * block,
+					unsigned int n );
+
+/*!
+ * \fn void opdis_cfg_foreach_block( opdis_cfg_t, OPDIS_CFG_BLOCK_FN,
+ * 				     void * )
+ * \ingroup cfg
+ * \brief Invoke a callback for every block, in order of VMA.
+ * \param cfg The control flow graph.
+ * \param fn The callback.
+ * \param arg Argument to pass to the callback.
+ */
+void LIBCALL opdis_cfg_foreach_block( opdis_cfg_t cfg, OPDIS_CFG_BLOCK_FN fn,
+				      void * arg );
+
+/*!
+ * \fn void opdis_cfg_foreach_func_block( opdis_cfg_t,
+ * 					  const opdis_cfg_func_t *,
+ * 					  OPDIS_CFG_BLOCK_FN, void * )
+ * \ingroup cfg
+ * \brief Invoke a callback for every block in a function.
+ * \param cfg The control flow graph.
+ * \param func The function.
+ * \param fn The callback.
+ * \param arg Argument to pass to the callback.
+ * \details The entry block is visited first, then the other blocks in
+ *          depth-first order.
+ */
+void LIBCALL opdis_cfg_foreach_func_block( opdis_cfg_t cfg,
+					   const opdis_cfg_func_t * func,
+					   OPDIS_CFG_BLOCK_FN fn, void * arg );
+
+/*!
+ * \fn void opdis_cfg_free( opdis_cfg_t )
+ * \ingroup cfg
+ * \brief Free a control flow graph.
+ * \param cfg The control flow graph.
+ */
+void LIBCALL opdis_cfg_free( opdis_cfg_t cfg );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
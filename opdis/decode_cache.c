@@ -0,0 +1,586 @@
+/*!
+ * \file decode_cache.c
+ * \brief Decode cache implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include <opdis/decode_cache.h>
+
+#define DEFAULT_BUCKETS 1024
+
+/* longest string which is re-rendered for a relative hit */
+#define MAX_STR 512
+
+/* index of the comment string in rel_str; operand strings follow it */
+#define STR_ASCII 0
+#define STR_COMMENT 1
+#define STR_OP(i) ((i) + 2)
+
+#ifdef HAVE_PTHREAD_H
+#define CACHE_LOCK(c) pthread_mutex_lock( (pthread_mutex_t *) (c)->lock )
+#define CACHE_UNLOCK(c) pthread_mutex_unlock( (pthread_mutex_t *) (c)->lock )
+#else
+#define CACHE_LOCK(c)
+#define CACHE_UNLOCK(c)
+#endif
+
+/* ---------------------------------------------------------------------- */
+/* HASH TABLE */
+
+static uint32_t hash_init( uint64_t config ) {
+	uint32_t h = 2166136261U;
+	int i;
+
+	for ( i = 0; i < 8; i++, config >>= 8 ) {
+		h = ( h ^ (uint32_t) (config & 0xFF) ) * 16777619U;
+	}
+
+	return h;
+}
+
+static uint32_t hash_byte( uint32_t h, opdis_byte_t b ) {
+	return ( h ^ b ) * 16777619U;
+}
+
+static uint32_t hash_insn( uint64_t config, const opdis_byte_t * bytes,
+			   opdis_off_t size ) {
+	uint32_t h = hash_init( config );
+	opdis_off_t i;
+
+	for ( i = 0; i < size; i++ ) {
+		h = hash_byte( h, bytes[i] );
+	}
+
+	return h;
+}
+
+/* entries are keyed on every byte read to decode the insn, which may extend
+ * past it: e.g. libopcodes reads the byte after an x86 FWAIT to determine
+ * whether it is a prefix */
+static opdis_decode_entry_t * find_entry( opdis_decode_cache_t c,
+					  uint32_t hash, uint64_t config,
+					  const opdis_byte_t * bytes,
+					  opdis_off_t len ) {
+	opdis_decode_entry_t * e = c->buckets[hash & (c->num_buckets - 1)];
+
+	for ( ; e; e = e->next ) {
+		if ( e->hash == hash && e->key_size == len &&
+		     e->config == config && ! memcmp( e->key, bytes, len ) ) {
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+static void grow_table( opdis_decode_cache_t c ) {
+	size_t i, num = c->num_buckets * 2;
+	opdis_decode_entry_t ** buckets, * e, * next;
+
+	buckets = (opdis_decode_entry_t **) calloc( num,
+					sizeof(opdis_decode_entry_t *) );
+	if (! buckets ) {
+		/* the table still works, with longer chains */
+		return;
+	}
+
+	for ( i = 0; i < c->num_buckets; i++ ) {
+		for ( e = c->buckets[i]; e; e = next ) {
+			next = e->next;
+			e->next = buckets[e->hash & (num - 1)];
+			buckets[e->hash & (num - 1)] = e;
+		}
+	}
+
+	free( c->buckets );
+	c->buckets = buckets;
+	c->num_buckets = num;
+}
+
+/* ---------------------------------------------------------------------- */
+/* RELATIVE FIELDS */
+
+static const char * str_or_empty( const char * str ) {
+	return ( str ) ? str : "";
+}
+
+static int is_hex_num( const char * s ) {
+	return ( s[0] == '0' && s[1] == 'x' && isxdigit((unsigned char) s[2]) );
+}
+
+/* parse an "0x" number in "0x%0*llx" form. width is the number of digits
+ * of a zero-padded number (libopcodes prints addresses as "0x%08lx"), or 0.
+ * 0 is returned if the number could not be reproduced for another value. */
+static int parse_hex_num( const char * s, uint64_t * val, int * width,
+			  const char ** end ) {
+	const char * p;
+
+	for ( p = s + 2; isxdigit((unsigned char) *p); p++ ) {
+		if ( isupper((unsigned char) *p) ) {
+			return 0;
+		}
+	}
+	*end = p;
+
+	if ( p - s > 18 ) {
+		return 0;
+	}
+
+	*width = ( s[2] == '0' && p - s > 3 ) ? (int) (p - s - 2) : 0;
+	*val = strtoull( s + 2, NULL, 16 );
+	return 1;
+}
+
+static int print_hex_num( char * buf, uint64_t val, int width ) {
+	return sprintf( buf, "0x%0*llx", width, (unsigned long long) val );
+}
+
+/* Compare template string t with string s, which was decoded delta bytes
+ * later. The strings must be identical, except for "0x" numbers in s which
+ * are larger by delta: these are flagged in mask. */
+static int match_str( const char * t, const char * s, uint64_t delta,
+		      uint32_t * mask ) {
+	unsigned int n = 0;
+
+	*mask = 0;
+	t = str_or_empty( t );
+	s = str_or_empty( s );
+
+	while ( *t && *s ) {
+		if ( is_hex_num( t ) && is_hex_num( s ) ) {
+			const char * t_end, * s_end;
+			uint64_t t_val, s_val;
+			int t_width, s_width;
+			char num[24];
+
+			if (! parse_hex_num( t, &t_val, &t_width, &t_end ) ||
+			    ! parse_hex_num( s, &s_val, &s_width, &s_end ) ) {
+				return 0;
+			}
+
+			if ( t_val != s_val ) {
+				/* s must be the value of t, shifted and printed
+				 * with the padding of t */
+				if ( s_val - t_val != delta || n >= 32 ||
+				     print_hex_num( num, s_val, t_width ) !=
+				     s_end - s || memcmp( num, s, s_end - s ) ) {
+					return 0;
+				}
+				*mask |= 1U << n;
+			} else if ( t_width != s_width ) {
+				return 0;
+			}
+
+			n++;
+			t = t_end;
+			s = s_end;
+			continue;
+		}
+
+		if ( *t != *s ) {
+			return 0;
+		}
+		t++;
+		s++;
+	}
+
+	return ( *t == *s );
+}
+
+/* render template string t for an insn delta bytes after the template */
+static int shift_str( const char * t, uint32_t mask, uint64_t delta,
+		      char * buf ) {
+	unsigned int n = 0;
+	size_t len = 0;
+
+	while ( *t ) {
+		if ( is_hex_num( t ) ) {
+			const char * end;
+			uint64_t val;
+			int width;
+
+			parse_hex_num( t, &val, &width, &end );
+			if ( mask & (1U << n) ) {
+				val += delta;
+			}
+			n++;
+			t = end;
+
+			if ( len + 19 >= MAX_STR ) {
+				return 0;
+			}
+			len += print_hex_num( &buf[len], val, width );
+			continue;
+		}
+
+		if ( len + 1 >= MAX_STR ) {
+			return 0;
+		}
+		buf[len++] = *t++;
+	}
+
+	buf[len] = '\0';
+	return 1;
+}
+
+/* shift the VMA-dependent part of an operand value by delta */
+static void shift_value( uint8_t category, opdis_op_rec_value_t * v,
+			 uint64_t delta ) {
+	switch ( category ) {
+		case opdis_op_cat_immediate:
+			v->immediate.vma += delta; break;
+		case opdis_op_cat_absolute:
+			v->abs.offset += delta; break;
+		case opdis_op_cat_expr:
+			v->expr.displacement.u += delta; break;
+		default:
+			break;
+	}
+}
+
+/* Compare the template of e with a decode of the same bytes at another
+ * address, and record which fields of the template are VMA-relative. */
+static int verify_entry( opdis_decode_entry_t * e,
+			 const opdis_insn_rec_t * rec ) {
+	const opdis_insn_rec_t * t = e->rec;
+	uint64_t delta = rec->vma - t->vma;
+	uint32_t mask;
+	int i;
+
+	if ( t->num_operands != rec->num_operands ||
+	     t->num_prefixes != rec->num_prefixes ||
+	     t->size != rec->size || t->status != rec->status ||
+	     t->category != rec->category || t->isa != rec->isa ||
+	     t->target != rec->target || t->dest != rec->dest ||
+	     t->src != rec->src || t->flags != rec->flags ||
+	     strcmp( str_or_empty( opdis_insn_rec_mnemonic( t ) ),
+		     str_or_empty( opdis_insn_rec_mnemonic( rec ) ) ) ||
+	     strcmp( str_or_empty( opdis_insn_rec_prefixes( t ) ),
+		     str_or_empty( opdis_insn_rec_prefixes( rec ) ) ) ) {
+		return 0;
+	}
+
+	if (! match_str( opdis_insn_rec_ascii( t ), opdis_insn_rec_ascii( rec ),
+			 delta, &e->rel_str[STR_ASCII] ) ||
+	    ! match_str( opdis_insn_rec_comment( t ),
+			 opdis_insn_rec_comment( rec ), delta,
+			 &e->rel_str[STR_COMMENT] ) ) {
+		return 0;
+	}
+
+	for ( i = 0; i < t->num_operands; i++ ) {
+		const opdis_op_rec_t * t_op = opdis_insn_rec_op( t, i );
+		const opdis_op_rec_t * op = opdis_insn_rec_op( rec, i );
+		opdis_op_rec_value_t v;
+
+		if ( t_op->category != op->category ||
+		     t_op->flags != op->flags ||
+		     t_op->data_size != op->data_size ) {
+			return 0;
+		}
+
+		if ( memcmp( &t_op->value, &op->value, sizeof(v) ) ) {
+			memcpy( &v, &t_op->value, sizeof(v) );
+			shift_value( t_op->category, &v, delta );
+			if ( i >= OPDIS_DECODE_CACHE_MAX_OPS ||
+			     memcmp( &v, &op->value, sizeof(v) ) ) {
+				return 0;
+			}
+			e->rel_ops |= 1U << i;
+		}
+
+		if (! match_str( opdis_op_rec_ascii( t, t_op ),
+				 opdis_op_rec_ascii( rec, op ), delta, &mask ) ) {
+			return 0;
+		}
+		if ( mask ) {
+			if ( i >= OPDIS_DECODE_CACHE_MAX_OPS ) {
+				return 0;
+			}
+			e->rel_str[STR_OP(i)] = mask;
+		}
+	}
+
+	return 1;
+}
+
+static int relative_fields( const opdis_decode_entry_t * e ) {
+	int i;
+
+	if ( e->rel_ops ) {
+		return 1;
+	}
+	for ( i = 0; i < OPDIS_DECODE_CACHE_MAX_OPS + 2; i++ ) {
+		if ( e->rel_str[i] ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void set_comment( opdis_insn_t * insn, const char * comment ) {
+	if ( insn->fixed_size ) {
+		strncpy( insn->comment, comment, insn->ascii_sz - 1 );
+		insn->comment[insn->ascii_sz - 1] = '\0';
+		return;
+	}
+
+	if ( insn->comment ) {
+		free( (void *) insn->comment );
+	}
+
+	insn->comment = strdup( comment );
+}
+
+/* adjust the relative fields of an insn filled from the template of e */
+static int shift_insn( const opdis_decode_entry_t * e, opdis_insn_t * insn,
+		       uint64_t delta ) {
+	const opdis_insn_rec_t * t = e->rec;
+	char buf[MAX_STR];
+	int i;
+
+	if ( e->rel_str[STR_ASCII] ) {
+		if (! shift_str( opdis_insn_rec_ascii( t ),
+				 e->rel_str[STR_ASCII], delta, buf ) ) {
+			return 0;
+		}
+		opdis_insn_set_ascii( insn, buf );
+	}
+
+	if ( e->rel_str[STR_COMMENT] ) {
+		if (! shift_str( opdis_insn_rec_comment( t ),
+				 e->rel_str[STR_COMMENT], delta, buf ) ) {
+			return 0;
+		}
+		set_comment( insn, buf );
+	}
+
+	for ( i = 0; i < t->num_operands && i < OPDIS_DECODE_CACHE_MAX_OPS;
+	      i++ ) {
+		const opdis_op_rec_t * t_op = opdis_insn_rec_op( t, i );
+		opdis_op_t * op = insn->operands[i];
+
+		if ( e->rel_ops & (1U << i) ) {
+			shift_value( t_op->category,
+				     (opdis_op_rec_value_t *) &op->value, delta );
+		}
+
+		if ( e->rel_str[STR_OP(i)] ) {
+			if (! shift_str( opdis_op_rec_ascii( t, t_op ),
+					 e->rel_str[STR_OP(i)], delta, buf ) ) {
+				return 0;
+			}
+			opdis_op_set_ascii( op, buf );
+		}
+	}
+
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* CACHE */
+
+opdis_decode_cache_t LIBCALL opdis_decode_cache_init( size_t max_entries ) {
+	opdis_decode_cache_t c;
+
+	c = (opdis_decode_cache_t) calloc( 1, sizeof(opdis_decode_cache_base_t));
+	if (! c ) {
+		return NULL;
+	}
+
+	c->max_entries = max_entries;
+	c->num_buckets = DEFAULT_BUCKETS;
+	c->buckets = (opdis_decode_entry_t **) calloc( c->num_buckets,
+					sizeof(opdis_decode_entry_t *) );
+	c->arena = opdis_arena_init( 0 );
+#ifdef HAVE_PTHREAD_H
+	c->lock = malloc( sizeof(pthread_mutex_t) );
+	if ( c->lock ) {
+		pthread_mutex_init( (pthread_mutex_t *) c->lock, NULL );
+	}
+	if (! c->lock ) {
+		opdis_decode_cache_free( c );
+		return NULL;
+	}
+#endif
+
+	if (! c->buckets || ! c->arena ) {
+		opdis_decode_cache_free( c );
+		return NULL;
+	}
+
+	return c;
+}
+
+opdis_off_t LIBCALL opdis_decode_cache_fill( opdis_decode_cache_t c,
+				uint64_t config, const opdis_byte_t * buf,
+				opdis_off_t offset, opdis_off_t len,
+				opdis_vma_t vma, opdis_insn_t * insn ) {
+	const opdis_byte_t * bytes = &buf[offset];
+	opdis_decode_entry_t * e = NULL;
+	opdis_off_t size, max_size = len - offset;
+	uint32_t h;
+
+	if (! c || ! buf || ! insn || offset >= len ) {
+		return 0;
+	}
+
+	CACHE_LOCK( c );
+
+	/* probe the table at each length of key which has been cached. At
+	 * most one key can match: the decode of the bytes of a longer key
+	 * would have stopped reading at the end of the shorter one. */
+	h = hash_init( config );
+	for ( size = 1; size <= max_size && size <= OPDIS_DECODE_CACHE_MAX_INSN
+	      && ( c->sizes >> size ); size++ ) {
+		h = hash_byte( h, bytes[size - 1] );
+		if ( (c->sizes & (1U << size)) &&
+		     (e = find_entry( c, h, config, bytes, size )) ) {
+			break;
+		}
+	}
+
+	if (! e || ( e->state != opdis_decode_entry_cached &&
+		     e->state != opdis_decode_entry_relative ) ||
+	    ! opdis_insn_rec_fill( e->rec, insn ) ) {
+		c->misses++;
+		CACHE_UNLOCK( c );
+		return 0;
+	}
+
+	insn->offset = offset;
+	insn->vma = vma;
+	if ( insn->borrow_bytes ) {
+		/* borrow from the buffer, not the cache */
+		insn->bytes = (opdis_byte_t *) bytes;
+	}
+	if ( e->state == opdis_decode_entry_relative &&
+	     ! shift_insn( e, insn, vma - e->rec->vma ) ) {
+		c->misses++;
+		CACHE_UNLOCK( c );
+		return 0;
+	}
+
+	c->hits++;
+	CACHE_UNLOCK( c );
+
+	return e->size;
+}
+
+void LIBCALL opdis_decode_cache_add( opdis_decode_cache_t c, uint64_t config,
+				     const opdis_insn_t * insn,
+				     const opdis_byte_t * bytes,
+				     opdis_off_t len ) {
+	opdis_decode_entry_t * e;
+	opdis_insn_rec_t * rec;
+	opdis_byte_t * key;
+	uint32_t h;
+
+	if (! bytes ) {
+		bytes = insn ? insn->bytes : NULL;
+		len = insn ? insn->size : 0;
+	}
+
+	if (! c || ! insn || ! bytes || ! insn->size || len < insn->size ||
+	     len > OPDIS_DECODE_CACHE_MAX_INSN ) {
+		return;
+	}
+
+	CACHE_LOCK( c );
+
+	h = hash_insn( config, bytes, len );
+	e = find_entry( c, h, config, bytes, len );
+	if ( e ) {
+		/* a second decode at a new address verifies the template */
+		if ( e->state == opdis_decode_entry_pending &&
+		     insn->vma != e->rec->vma ) {
+			rec = opdis_insn_rec_alloc( insn );
+			if (! rec || ! verify_entry( e, rec ) ) {
+				e->state = opdis_decode_entry_uncacheable;
+			} else {
+				e->state = relative_fields( e ) ?
+					   opdis_decode_entry_relative :
+					   opdis_decode_entry_cached;
+			}
+			opdis_insn_rec_free( rec );
+		}
+
+		CACHE_UNLOCK( c );
+		return;
+	}
+
+	if ( c->max_entries && c->num >= c->max_entries ) {
+		CACHE_UNLOCK( c );
+		return;
+	}
+
+	e = (opdis_decode_entry_t *) opdis_arena_alloc( c->arena,
+						sizeof(opdis_decode_entry_t) );
+	rec = opdis_insn_rec_arena( insn, c->arena );
+	key = (opdis_byte_t *) opdis_arena_alloc( c->arena, len );
+	if ( e && rec && key ) {
+		memset( e, 0, sizeof(opdis_decode_entry_t) );
+		memcpy( key, bytes, len );
+		e->rec = rec;
+		e->key = key;
+		e->config = config;
+		e->hash = h;
+		e->size = (uint8_t) insn->size;
+		e->key_size = (uint8_t) len;
+		e->state = opdis_decode_entry_pending;
+
+		e->next = c->buckets[h & (c->num_buckets - 1)];
+		c->buckets[h & (c->num_buckets - 1)] = e;
+		c->sizes |= 1U << len;
+		if ( ++c->num > c->num_buckets ) {
+			grow_table( c );
+		}
+	}
+
+	CACHE_UNLOCK( c );
+}
+
+void LIBCALL opdis_decode_cache_clear( opdis_decode_cache_t c ) {
+	if (! c ) {
+		return;
+	}
+
+	CACHE_LOCK( c );
+
+	memset( c->buckets, 0, c->num_buckets * sizeof(opdis_decode_entry_t *) );
+	opdis_arena_free( c->arena );
+	c->arena = opdis_arena_init( 0 );
+	c->num = 0;
+	c->sizes = 0;
+
+	CACHE_UNLOCK( c );
+}
+
+void LIBCALL opdis_decode_cache_free( opdis_decode_cache_t c ) {
+	if (! c ) {
+		return;
+	}
+
+#ifdef HAVE_PTHREAD_H
+	if ( c->lock ) {
+		pthread_mutex_destroy( (pthread_mutex_t *) c->lock );
+		free( c->lock );
+	}
+#endif
+	opdis_arena_free( c->arena );
+	free( c->buckets );
+	free( c );
+}
@@ -0,0 +1,204 @@
+/*!
+ * \file decode_cache.h
+ * \brief Cache of decoded instructions, keyed by instruction bytes.
+ * \details A decode cache stores the instructions decoded by a disassembler
+ *          as packed templates, keyed on the raw bytes of the instruction.
+ *          When the same encoding is found at another address, the
+ *          instruction is filled from its template instead of being
+ *          decoded again by libopcodes and the opdis decoder.
+ *          Fields which depend on the address of the instruction, such as
+ *          relative branch targets and the addresses printed by libopcodes,
+ *          are detected by comparing the first two decodes of an encoding
+ *          at different addresses; on a hit, these fields are adjusted by
+ *          the distance between the template address and the new address.
+ *          Encodings whose decodes differ in any other way are not cached.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_DECODE_CACHE_H
+#define OPDIS_DECODE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <opdis/types.h>
+#include <opdis/model.h>
+#include <opdis/arena.h>
+#include <opdis/insn_rec.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_DECODE_CACHE_MAX_INSN
+ * \ingroup disassembly
+ * \brief Size in bytes of the longest instruction which is cached,
+ *        including any bytes read past its end to decode it.
+ */
+#define OPDIS_DECODE_CACHE_MAX_INSN 31
+
+/*!
+ * \def OPDIS_DECODE_CACHE_MAX_OPS
+ * \ingroup disassembly
+ * \brief Max number of operands in an instruction with relative fields.
+ */
+#define OPDIS_DECODE_CACHE_MAX_OPS 8
+
+/*!
+ * \enum opdis_decode_entry_state_t
+ * \ingroup disassembly
+ * \brief State of a cached encoding.
+ */
+enum opdis_decode_entry_state_t {
+	opdis_decode_entry_pending,	/*!< Decoded once; not yet verified */
+	opdis_decode_entry_cached,	/*!< Decode does not depend on VMA */
+	opdis_decode_entry_relative,	/*!< Decode has VMA-relative fields */
+	opdis_decode_entry_uncacheable	/*!< Encoding is always decoded */
+};
+
+/*! \struct opdis_decode_entry_t
+ *  \ingroup disassembly
+ *  \brief A cached instruction encoding.
+ *  \details The relative fields of the template are recorded as bitmasks:
+ *           bit n of \e rel_ops is set if the value of operand n is
+ *           VMA-relative, and bit n of a \e rel_str element is set if the
+ *           nth hexadecimal ("0x") number in the string is VMA-relative.
+ *           The strings are, in order, the instruction string, the comment,
+ *           and the operand strings.
+ */
+typedef struct opdis_decode_entry {
+	struct opdis_decode_entry * next;	/*!< Next entry in bucket */
+	opdis_insn_rec_t * rec;		/*!< Template, decoded at rec->vma */
+	const opdis_byte_t * key;	/*!< Bytes read to decode the insn */
+	uint64_t	config;		/*!< Disassembler configuration key */
+	uint32_t	hash;		/*!< Hash of config and key bytes */
+	uint8_t		size;		/*!< Size of insn in bytes */
+	uint8_t		key_size;	/*!< Size of key in bytes */
+	uint8_t		state;		/*!< enum opdis_decode_entry_state_t */
+	uint16_t	rel_ops;	/*!< Operands with relative values */
+	uint32_t	rel_str[OPDIS_DECODE_CACHE_MAX_OPS + 2]; /*!< Relative
+						  numbers in strings */
+} opdis_decode_entry_t;
+
+/*! \struct opdis_decode_cache_base_t
+ *  \ingroup disassembly
+ *  \brief A cache of decoded instructions.
+ *  \note The cache is locked by every lookup and update, so it can be
+ *        shared by disassemblers running in different threads.
+ */
+typedef struct {
+	opdis_decode_entry_t ** buckets;	/*!< Hash table */
+	size_t		num_buckets;	/*!< Size of hash table (power of 2) */
+	size_t		num;		/*!< Number of cached encodings */
+	size_t		max_entries;	/*!< Cap on cached encodings, or 0 */
+	uint32_t	sizes;		/*!< Bit n set if an n-byte key is
+					     cached */
+	opdis_arena_t	arena;		/*!< Storage for entries and templates */
+	unsigned long	hits;		/*!< Number of insns filled from cache */
+	unsigned long	misses;		/*!< Number of insns decoded */
+	void *		lock;		/*!< Mutex, if built with pthreads */
+} opdis_decode_cache_base_t;
+
+/*! \typedef opdis_decode_cache_base_t * opdis_decode_cache_t
+ *  \ingroup disassembly
+ *  \brief A cache of decoded instructions.
+ */
+typedef opdis_decode_cache_base_t * opdis_decode_cache_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn opdis_decode_cache_t opdis_decode_cache_init( size_t )
+ * \ingroup disassembly
+ * \brief Allocate a decode cache.
+ * \param max_entries Maximum number of encodings to cache, or 0 for no
+ *                    limit.
+ * \return The allocated cache.
+ * \sa opdis_decode_cache_free opdis_set_decode_cache
+ * \note Once \e max_entries encodings are cached, new encodings are
+ *       decoded but not added to the cache.
+ */
+opdis_decode_cache_t LIBCALL opdis_decode_cache_init( size_t max_entries );
+
+/*!
+ * \fn opdis_off_t opdis_decode_cache_fill( opdis_decode_cache_t, uint64_t,
+ * 				const opdis_byte_t *, opdis_off_t, opdis_off_t,
+ * 				opdis_vma_t, opdis_insn_t * )
+ * \ingroup disassembly
+ * \brief Fill an instruction from the cache.
+ * \param cache The decode cache.
+ * \param config Key for the configuration of the disassembler.
+ * \param buf The buffer being disassembled.
+ * \param offset Offset of the instruction in \e buf.
+ * \param len Length of \e buf.
+ * \param vma Address of the instruction.
+ * \param insn The instruction to fill.
+ * \return The size of the instruction, or 0 if it is not in the cache.
+ * \details The bytes at \e offset are matched against the bytes which
+ *          were read to decode each cached encoding. If a verified template is found, \e insn is filled
+ *          from it, and its offset, VMA and relative fields are set for
+ *          \e vma. On a miss, the caller decodes the instruction and
+ *          passes it to opdis_decode_cache_add.
+ */
+opdis_off_t LIBCALL opdis_decode_cache_fill( opdis_decode_cache_t cache,
+				uint64_t config, const opdis_byte_t * buf,
+				opdis_off_t offset, opdis_off_t len,
+				opdis_vma_t vma, opdis_insn_t * insn );
+
+/*!
+ * \fn void opdis_decode_cache_add( opdis_decode_cache_t, uint64_t,
+ * 				    const opdis_insn_t *, const opdis_byte_t *,
+ * 				    opdis_off_t )
+ * \ingroup disassembly
+ * \brief Add a decoded instruction to the cache.
+ * \param cache The decode cache.
+ * \param config Key for the configuration of the disassembler.
+ * \param insn The decoded instruction.
+ * \param bytes The bytes which were read to decode \e insn, starting with
+ *              its first byte; or NULL for the bytes of \e insn.
+ * \param len The number of bytes in \e bytes; at least the size of
+ *            \e insn.
+ * \details The first decode of an encoding is stored as its template. The
+ *          second decode at a different address verifies the template, and
+ *          determines which of its fields are VMA-relative.
+ * \note The encoding is keyed on all of \e bytes, as a decoder may read
+ *       past the end of an instruction to decode it. An x86 FWAIT, for
+ *       example, depends on the byte after it.
+ */
+void LIBCALL opdis_decode_cache_add( opdis_decode_cache_t cache,
+				     uint64_t config,
+				     const opdis_insn_t * insn,
+				     const opdis_byte_t * bytes,
+				     opdis_off_t len );
+
+/*!
+ * \fn void opdis_decode_cache_clear( opdis_decode_cache_t )
+ * \ingroup disassembly
+ * \brief Discard all cached encodings.
+ * \param cache The decode cache.
+ * \note The hit and miss statistics are not reset.
+ */
+void LIBCALL opdis_decode_cache_clear( opdis_decode_cache_t cache );
+
+/*!
+ * \fn void opdis_decode_cache_free( opdis_decode_cache_t )
+ * \ingroup disassembly
+ * \brief Free a decode cache.
+ * \param cache The decode cache.
+ */
+void LIBCALL opdis_decode_cache_free( opdis_decode_cache_t cache );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,420 @@
+/*!
+ * \file gen_x86_tables.c
+ * \brief Build-time generator for the x86 decoder lookup tables.
+ * \details This writes x86_tables.h to STDOUT: perfect-hash tables which
+ *          map each known x86 mnemonic to the classification produced by
+ *          x86_mnemonic_rules, and each register and prefix name to its
+ *          index in the arrays in x86_rules.h. The tables are regenerated
+ *          whenever x86_rules.h or metadata.h changes.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/x86_rules.h>
+
+static const char * intel_prefixes[] = { X86_PREFIX_NAMES };
+
+/* Mnemonics as emitted by libopcodes. Mnemonics not listed here are
+ * classified by applying x86_mnemonic_rules at runtime. */
+static const char * mnemonics[] = {
+	/* general purpose */
+	"aaa", "aad", "aam", "aas", "adc", "adcx", "add", "adox", "and",
+	"andn", "arpl", "bextr", "blsi", "blsmsk", "blsr", "bound", "bsf",
+	"bsr", "bswap", "bt", "btc", "btr", "bts", "bzhi", "call", "cbw",
+	"cbtw", "cdq", "cdqe", "clac", "clc", "cld", "clflush", "cli",
+	"cltd", "cltq", "clts", "cmc", "cmova", "cmovae", "cmovb",
+	"cmovbe", "cmove", "cmovg", "cmovge", "cmovl", "cmovle", "cmovne",
+	"cmovno", "cmovnp", "cmovns", "cmovo", "cmovp", "cmovs", "cmp",
+	"cmpsb", "cmpsw", "cmpsl", "cmpsd", "cmpsq", "cmpxchg",
+	"cmpxchg8b", "cmpxchg16b", "cpuid", "cqo", "cqto", "crc32", "cwd",
+	"cwde", "cwtd", "cwtl", "daa", "das", "dec", "div", "endbr32",
+	"endbr64", "enter", "hlt", "idiv", "imul", "in", "inc", "insb",
+	"insw", "insl", "insd", "int", "int3", "into", "invd", "invlpg",
+	"invpcid", "iret", "iretd", "iretq", "iretw", "ja", "jae", "jb",
+	"jbe", "jcxz", "je", "jecxz", "jg", "jge", "jl", "jle", "jmp",
+	"jne", "jno", "jnp", "jns", "jo", "jp", "jrcxz", "js", "lahf",
+	"lar", "lcall", "lds", "lea", "leave", "les", "lfence", "lfs",
+	"lgdt", "lgs", "lidt", "ljmp", "lldt", "lmsw", "lodsb", "lodsw",
+	"lodsl", "lodsd", "lodsq", "loop", "loope", "loopne", "lret",
+	"lsl", "lss", "ltr", "lzcnt", "mfence", "monitor", "mov", "movabs",
+	"movbe", "movsb", "movsw", "movsl", "movsd", "movsq", "movsx",
+	"movsxd", "movzx", "movsbw", "movsbl", "movsbq", "movswl",
+	"movswq", "movslq", "movzbw", "movzbl", "movzbq", "movzwl",
+	"movzwq", "mul", "mulx", "mwait", "neg", "nop", "not", "or", "out",
+	"outsb", "outsw", "outsl", "outsd", "pause", "pdep", "pext", "pop",
+	"popa", "popad", "popcnt", "popf", "popfd", "popfq", "popfw",
+	"push", "pusha", "pushad", "pushf", "pushfd", "pushfq", "pushfw",
+	"rcl", "rcr", "rdfsbase", "rdgsbase", "rdmsr", "rdpmc", "rdrand",
+	"rdseed", "rdtsc", "rdtscp", "ret", "rol", "ror", "rorx", "rsm",
+	"sahf", "sal", "sar", "sarx", "sbb", "scasb", "scasw", "scasl",
+	"scasd", "scasq", "seta", "setae", "setb", "setbe", "sete", "setg",
+	"setge", "setl", "setle", "setne", "setno", "setnp", "setns",
+	"seto", "setp", "sets", "sfence", "sgdt", "shl", "shld", "shlx",
+	"shr", "shrd", "shrx", "sidt", "sldt", "smsw", "stac", "stc", "std",
+	"sti", "stosb", "stosw", "stosl", "stosd", "stosq", "str", "sub",
+	"swapgs", "syscall", "sysenter", "sysexit", "sysret", "test",
+	"tzcnt", "ud2", "verr", "verw", "wait", "wbinvd", "wrfsbase",
+	"wrgsbase", "wrmsr", "xabort", "xadd", "xbegin", "xchg", "xend",
+	"xgetbv", "xlat", "xor", "xrstor", "xsave", "xsaveopt", "xsetbv",
+	"xtest",
+	/* virtual machine extensions */
+	"invept", "invvpid", "vmcall", "vmclear", "vmlaunch", "vmptrld",
+	"vmptrst", "vmread", "vmresume", "vmwrite", "vmxoff", "vmxon",
+	/* x87 */
+	"f2xm1", "fabs", "fadd", "faddp", "fbld", "fbstp", "fchs", "fclex",
+	"fcmovb", "fcmovbe", "fcmove", "fcmovnb", "fcmovnbe", "fcmovne",
+	"fcmovnu", "fcmovu", "fcom", "fcomi", "fcomip", "fcomp", "fcompp",
+	"fcos", "fdecstp", "fdiv", "fdivp", "fdivr", "fdivrp", "ffree",
+	"fiadd", "ficom", "ficomp", "fidiv", "fidivr", "fild", "fimul",
+	"fincstp", "finit", "fist", "fistp", "fisttp", "fisub", "fisubr",
+	"fld", "fld1", "fldcw", "fldenv", "fldl2e", "fldl2t", "fldlg2",
+	"fldln2", "fldpi", "fldz", "fmul", "fmulp", "fnclex", "fninit",
+	"fnop", "fnsave", "fnstcw", "fnstenv", "fnstsw", "fpatan", "fprem",
+	"fprem1", "fptan", "frndint", "frstor", "fsave", "fscale", "fsin",
+	"fsincos", "fsqrt", "fst", "fstcw", "fstenv", "fstp", "fstsw",
+	"fsub", "fsubp", "fsubr", "fsubrp", "ftst", "fucom", "fucomi",
+	"fucomip", "fucomp", "fucompp", "fwait", "fxam", "fxch", "fxrstor",
+	"fxsave", "fxtract", "fyl2x", "fyl2xp1",
+	"fadds", "faddl", "fdivs", "fdivl", "fildl", "fildll", "fildq",
+	"fistl", "fistpl", "fistpll", "fistpq", "flds", "fldl", "fldt",
+	"fmuls", "fmull", "fsts", "fstl", "fstps", "fstpl", "fstpt",
+	"fsubs", "fsubl",
+	/* MMX, SSE */
+	"addpd", "addps", "addsd", "addss", "addsubpd", "addsubps",
+	"aesdec", "aesdeclast", "aesenc", "aesenclast", "aesimc",
+	"aeskeygenassist", "andnpd", "andnps", "andpd", "andps", "blendpd",
+	"blendps", "blendvpd", "blendvps", "cmppd", "cmpps", "cmpss",
+	"comisd", "comiss", "cvtdq2pd", "cvtdq2ps", "cvtpd2dq", "cvtpd2pi",
+	"cvtpd2ps", "cvtpi2pd", "cvtpi2ps", "cvtps2dq", "cvtps2pd",
+	"cvtps2pi", "cvtsd2si", "cvtsd2ss", "cvtsi2sd", "cvtsi2ss",
+	"cvtss2sd", "cvtss2si", "cvttpd2dq", "cvttpd2pi", "cvttps2dq",
+	"cvttps2pi", "cvttsd2si", "cvttss2si", "divpd", "divps", "divsd",
+	"divss", "dppd", "dpps", "emms", "extractps", "haddpd", "haddps",
+	"hsubpd", "hsubps", "insertps", "lddqu", "ldmxcsr", "maskmovdqu",
+	"maskmovq", "maxpd", "maxps", "maxsd", "maxss", "minpd", "minps",
+	"minsd", "minss", "movapd", "movaps", "movd", "movddup", "movdq2q",
+	"movdqa", "movdqu", "movhlps", "movhpd", "movhps", "movlhps",
+	"movlpd", "movlps", "movmskpd", "movmskps", "movntdq", "movntdqa",
+	"movnti", "movntpd", "movntps", "movntq", "movq", "movq2dq",
+	"movshdup", "movsldup", "movss", "movupd", "movups", "mpsadbw",
+	"mulpd", "mulps", "mulsd", "mulss", "orpd", "orps", "pabsb",
+	"pabsd", "pabsw", "packssdw", "packsswb", "packusdw", "packuswb",
+	"paddb", "paddd", "paddq", "paddsb", "paddsw", "paddusb",
+	"paddusw", "paddw", "palignr", "pand", "pandn", "pavgb", "pavgw",
+	"pblendvb", "pblendw", "pclmulqdq", "pcmpeqb", "pcmpeqd",
+	"pcmpeqq", "pcmpeqw", "pcmpestri", "pcmpestrm", "pcmpgtb",
+	"pcmpgtd", "pcmpgtq", "pcmpgtw", "pcmpistri", "pcmpistrm",
+	"pextrb", "pextrd", "pextrq", "pextrw", "phaddd", "phaddsw",
+	"phaddw", "phminposuw", "phsubd", "phsubsw", "phsubw", "pinsrb",
+	"pinsrd", "pinsrq", "pinsrw", "pmaddubsw", "pmaddwd", "pmaxsb",
+	"pmaxsd", "pmaxsw", "pmaxub", "pmaxud", "pmaxuw", "pminsb",
+	"pminsd", "pminsw", "pminub", "pminud", "pminuw", "pmovmskb",
+	"pmovsxbd", "pmovsxbq", "pmovsxbw", "pmovsxdq", "pmovsxwd",
+	"pmovsxwq", "pmovzxbd", "pmovzxbq", "pmovzxbw", "pmovzxdq",
+	"pmovzxwd", "pmovzxwq", "pmuldq", "pmulhrsw", "pmulhuw", "pmulhw",
+	"pmulld", "pmullw", "pmuludq", "por", "prefetchnta", "prefetcht0",
+	"prefetcht1", "prefetcht2", "prefetchw", "psadbw", "pshufb",
+	"pshufd", "pshufhw", "pshuflw", "pshufw", "psignb", "psignd",
+	"psignw", "pslld", "pslldq", "psllq", "psllw", "psrad", "psraw",
+	"psrld", "psrldq", "psrlq", "psrlw", "psubb", "psubd", "psubq",
+	"psubsb", "psubsw", "psubusb", "psubusw", "psubw", "ptest",
+	"punpckhbw", "punpckhdq", "punpckhqdq", "punpckhwd", "punpcklbw",
+	"punpckldq", "punpcklqdq", "punpcklwd", "pxor", "rcpps", "rcpss",
+	"roundpd", "roundps", "roundsd", "roundss", "rsqrtps", "rsqrtss",
+	"shufpd", "shufps", "sqrtpd", "sqrtps", "sqrtsd", "sqrtss",
+	"stmxcsr", "subpd", "subps", "subsd", "subss", "ucomisd",
+	"ucomiss", "unpckhpd", "unpckhps", "unpcklpd", "unpcklps", "xorpd",
+	"xorps",
+	/* AVX */
+	"vaddpd", "vaddps", "vaddsd", "vaddss", "vandnpd", "vandnps",
+	"vandpd", "vandps", "vbroadcastsd", "vbroadcastss", "vcmppd",
+	"vcmpps", "vcvtdq2pd", "vcvtdq2ps", "vcvtpd2ps", "vcvtps2pd",
+	"vcvtsd2ss", "vcvtsi2sd", "vcvtsi2ss", "vcvtss2sd", "vcvttsd2si",
+	"vcvttss2si", "vdivpd", "vdivps", "vdivsd", "vdivss",
+	"vextractf128", "vextracti128", "vinsertf128", "vinserti128",
+	"vmaxpd", "vmaxps", "vminpd", "vminps", "vmovapd", "vmovaps",
+	"vmovd", "vmovdqa", "vmovdqu", "vmovq", "vmovsd", "vmovss",
+	"vmovupd", "vmovups", "vmulpd", "vmulps", "vmulsd", "vmulss",
+	"vorpd", "vorps", "vpaddb", "vpaddd", "vpaddq", "vpaddw", "vpand",
+	"vpandn", "vpbroadcastb", "vpbroadcastd", "vpbroadcastq",
+	"vpbroadcastw", "vpcmpeqb", "vpcmpeqd", "vpcmpeqq", "vpcmpeqw",
+	"vpermd", "vpermq", "vperm2f128", "vperm2i128", "vpmovmskb",
+	"vpor", "vpshufb", "vpshufd", "vpslld", "vpsllq", "vpsrld",
+	"vpsrlq", "vpsubb", "vpsubd", "vpsubq", "vpsubw", "vptest",
+	"vpxor", "vshufps", "vsqrtpd", "vsqrtps", "vsubpd", "vsubps",
+	"vsubsd", "vsubss", "vucomisd", "vucomiss", "vxorpd", "vxorps",
+	"vzeroall", "vzeroupper",
+	NULL
+};
+
+/* General-purpose mnemonics which take an AT&T operand size suffix */
+static const char * att_suffixed[] = {
+	"adc", "add", "and", "bsf", "bsr", "bt", "btc", "btr", "bts", "call",
+	"cmp", "cmpxchg", "dec", "div", "idiv", "imul", "in", "inc", "jmp",
+	"lea", "leave", "lgdt", "lidt", "mov", "movs", "mul", "neg", "nop",
+	"not", "or", "out", "pop", "push", "rcl", "rcr", "ret", "rol",
+	"ror", "sal", "sar", "sbb", "sgdt", "shl", "shld", "shr", "shrd",
+	"sidt", "sub", "test", "xadd", "xchg", "xor",
+	NULL
+};
+
+static const char att_suffixes[] = "bwlq";
+
+/* ---------------------------------------------------------------------- */
+/* TABLE CONSTRUCTION */
+
+#define MAX_DISP 0xFFFF
+
+struct TABLE {
+	const char ** keys;
+	size_t num;
+	size_t buckets;
+	size_t slots;
+	unsigned int * disp;
+	int * slot_key;		/* index of key in slot, or -1 */
+};
+
+static int key_exists( struct TABLE * t, const char * key ) {
+	size_t i;
+	for ( i = 0; i < t->num; i++ ) {
+		if (! strcmp( t->keys[i], key ) ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void add_key( struct TABLE * t, const char * key ) {
+	if ( key_exists( t, key ) ) {
+		return;
+	}
+	t->keys = (const char **) realloc( t->keys,
+					   (t->num + 1) * sizeof(char *) );
+	if (! t->keys ) {
+		fprintf( stderr, "Out of memory\n" );
+		exit( 1 );
+	}
+	t->keys[t->num++] = key;
+}
+
+static size_t bucket_size( struct TABLE * t, size_t b ) {
+	size_t i, n = 0;
+	for ( i = 0; i < t->num; i++ ) {
+		if ( x86_hash( t->keys[i], 0 ) % t->buckets == b ) {
+			n++;
+		}
+	}
+	return n;
+}
+
+/* try to place all keys of bucket b using displacement d */
+static int place_bucket( struct TABLE * t, size_t b, unsigned int d ) {
+	size_t i, j;
+	int placed = 0;
+
+	for ( i = 0; i < t->num; i++ ) {
+		size_t slot;
+		if ( x86_hash( t->keys[i], 0 ) % t->buckets != b ) {
+			continue;
+		}
+
+		slot = x86_hash( t->keys[i], d ) % t->slots;
+		if ( t->slot_key[slot] != -1 ) {
+			/* collision: undo this attempt */
+			for ( j = 0; j < t->slots; j++ ) {
+				if ( t->slot_key[j] <= -2 ) {
+					t->slot_key[j] = -1;
+				}
+			}
+			return 0;
+		}
+		/* tentatively placed keys are encoded as -2 - key */
+		t->slot_key[slot] = -2 - (int) i;
+		placed++;
+	}
+
+	for ( j = 0; placed && j < t->slots; j++ ) {
+		if ( t->slot_key[j] <= -2 ) {
+			t->slot_key[j] = -2 - t->slot_key[j];
+		}
+	}
+	t->disp[b] = d;
+	return 1;
+}
+
+static int build_table( struct TABLE * t ) {
+	size_t i, b, size, max_size = 0;
+
+	t->disp = (unsigned int *) calloc( t->buckets, sizeof(unsigned int) );
+	t->slot_key = (int *) malloc( t->slots * sizeof(int) );
+	if (! t->disp || ! t->slot_key ) {
+		fprintf( stderr, "Out of memory\n" );
+		exit( 1 );
+	}
+	for ( i = 0; i < t->slots; i++ ) {
+		t->slot_key[i] = -1;
+	}
+
+	for ( b = 0; b < t->buckets; b++ ) {
+		size = bucket_size( t, b );
+		max_size = ( size > max_size ) ? size : max_size;
+	}
+
+	/* place the largest buckets first, while most slots are free */
+	for ( size = max_size; size > 0; size-- ) {
+		for ( b = 0; b < t->buckets; b++ ) {
+			unsigned int d;
+
+			if ( bucket_size( t, b ) != size ) {
+				continue;
+			}
+			for ( d = 1; d <= MAX_DISP; d++ ) {
+				if ( place_bucket( t, b, d ) ) {
+					break;
+				}
+			}
+			if ( d > MAX_DISP ) {
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static void init_table( struct TABLE * t ) {
+	/* grow the table until a perfect hash is found */
+	t->buckets = t->num / 2 + 1;
+	for ( t->slots = t->num + t->num / 4 + 1; ! build_table( t );
+	      t->slots += t->num / 8 + 1 ) {
+		free( t->disp );
+		free( t->slot_key );
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+/* OUTPUT */
+
+static void print_disp( struct TABLE * t, const char * name,
+			const char * upper ) {
+	size_t i;
+
+	printf( "#define X86_%s_BUCKETS %lu\n", upper,
+		(unsigned long) t->buckets );
+	printf( "#define X86_%s_SLOTS %lu\n\n", upper,
+		(unsigned long) t->slots );
+	printf( "static const unsigned short x86_%s_disp[] = {", name );
+	for ( i = 0; i < t->buckets; i++ ) {
+		printf( "%s%u,", ( i % 12 ) ? " " : "\n\t", t->disp[i] );
+	}
+	printf( "\n};\n\n" );
+}
+
+/* slots contain an index into an array in x86_rules.h */
+static void print_index_table( struct TABLE * t, const char ** names,
+			       size_t num_names, const char * name,
+			       const char * upper ) {
+	size_t i, j;
+
+	print_disp( t, name, upper );
+	printf( "static const short x86_%s_slots[] = {", name );
+	for ( i = 0; i < t->slots; i++ ) {
+		int idx = -1;
+		if ( t->slot_key[i] > -1 ) {
+			for ( j = 0; j < num_names; j++ ) {
+				if ( names[j] == t->keys[t->slot_key[i]] ) {
+					idx = (int) j;
+				}
+			}
+		}
+		printf( "%s%d,", ( i % 12 ) ? " " : "\n\t", idx );
+	}
+	printf( "\n};\n\n" );
+}
+
+static void print_mnemonic_table( struct TABLE * t ) {
+	size_t i;
+
+	print_disp( t, "mnemonic", "MNEMONIC" );
+	printf( "static const x86_mnemonic_def_t x86_mnemonic_slots[] = {\n" );
+	for ( i = 0; i < t->slots; i++ ) {
+		opdis_insn_t insn;
+		const char * key;
+
+		if ( t->slot_key[i] < 0 ) {
+			printf( "\t{ NULL, 0, 0, 0 },\n" );
+			continue;
+		}
+
+		/* defaults are those set by opdis_insn_clear */
+		key = t->keys[t->slot_key[i]];
+		memset( &insn, 0, sizeof(insn) );
+		insn.category = opdis_insn_cat_unknown;
+		insn.flags.cflow = 0;
+		x86_mnemonic_rules( &insn, key );
+
+		printf( "\t{ \"%s\", %d, %d, %d },\n", key, (int) insn.category,
+			(int) insn.flags.cflow, (int) insn.isa );
+	}
+	printf( "};\n\n" );
+}
+
+int main( void ) {
+	struct TABLE mnem = { 0 }, reg = { 0 }, pfx = { 0 };
+	size_t num_regs = sizeof(intel_registers) / sizeof(char *);
+	size_t num_pfx = sizeof(intel_prefixes) / sizeof(char *);
+	char * suffixed;
+	size_t i, j, n;
+
+	if ( sizeof(intel_reg_id) != num_regs ||
+	     sizeof(intel_reg_size) != num_regs ) {
+		fprintf( stderr, "x86_rules.h: register arrays differ in size\n");
+		return 1;
+	}
+
+	for ( i = 0; mnemonics[i]; i++ ) {
+		add_key( &mnem, mnemonics[i] );
+	}
+
+	/* AT&T size variants: "add" -> "addb", "addw", "addl", "addq" */
+	for ( n = 0; att_suffixed[n]; n++ )
+		;
+	suffixed = (char *) calloc( n * 4, 16 );
+	for ( i = 0; suffixed && i < n; i++ ) {
+		for ( j = 0; j < 4; j++ ) {
+			char * name = &suffixed[(i * 4 + j) * 16];
+			snprintf( name, 16, "%s%c", att_suffixed[i],
+				  att_suffixes[j] );
+			add_key( &mnem, name );
+		}
+	}
+
+	for ( i = 0; i < num_regs; i++ ) {
+		add_key( &reg, intel_registers[i] );
+	}
+	for ( i = 0; i < num_pfx; i++ ) {
+		add_key( &pfx, intel_prefixes[i] );
+	}
+
+	init_table( &mnem );
+	init_table( &reg );
+	init_table( &pfx );
+
+	printf( "/* x86_tables.h : generated by gen_x86_tables from "
+		"x86_rules.h. DO NOT EDIT. */\n\n" );
+	printf( "#ifndef OPDIS_X86_TABLES_H\n#define OPDIS_X86_TABLES_H\n\n" );
+	print_mnemonic_table( &mnem );
+	print_index_table( &reg, intel_registers, num_regs, "register",
+			   "REGISTER" );
+	print_index_table( &pfx, intel_prefixes, num_pfx, "prefix",
+			   "PREFIX" );
+	printf( "#endif\n" );
+
+	return 0;
+}
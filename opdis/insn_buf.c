@@ -7,6 +7,8 @@
  * See http://www.gnu.org/licenses/gpl.txt for details.
  */
 
+#include <ctype.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -52,6 +54,14 @@ opdis_insn_buf_t LIBCALL opdis_insn_buf_alloc( unsigned int max_items,
 	}
 	buf->max_string_size = max_insn_str;
 
+	buf->spans = (opdis_insn_span_t *) calloc( OPDIS_MAX_SPANS,
+						   sizeof(opdis_insn_span_t) );
+	if (! buf->spans ) {
+		opdis_insn_buf_free(buf);
+		return NULL;
+	}
+	buf->max_span_count = OPDIS_MAX_SPANS;
+
 	return buf;
 }
 
@@ -75,10 +85,140 @@ int LIBCALL opdis_insn_buf_append( opdis_insn_buf_t buf, const char * item ) {
 	return 1;
 }
 
+/* ---------------------------------------------------------------------- */
+/* SPANS */
+
+static int is_blank( const char * str, unsigned int len ) {
+	unsigned int i;
+	for ( i = 0; i < len; i++ ) {
+		if (! isspace( (unsigned char) str[i] ) ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void update_depth( opdis_insn_buf_t buf, const char * str, 
+			  unsigned int len ) {
+	unsigned int i;
+	for ( i = 0; i < len; i++ ) {
+		if ( str[i] == '(' || str[i] == '[' ) {
+			buf->span_depth++;
+		} else if ( (str[i] == ')' || str[i] == ']') && 
+			    buf->span_depth ) {
+			buf->span_depth--;
+		}
+	}
+}
+
+/* does a span of this type begin a new item? */
+static int span_starts_item( opdis_insn_buf_t buf, 
+			     enum opdis_span_type_t type,
+			     const char * str, unsigned int len ) {
+	opdis_insn_span_t * prev = &buf->spans[buf->span_count - 1];
+	const char * prev_str = &buf->string[prev->offset];
+	int after_mnem = ( prev->type == opdis_span_mnemonic ||
+			   prev->type == opdis_span_directive );
+	int brk = buf->span_break;
+
+	buf->span_break = 0;
+
+	switch ( type ) {
+		case opdis_span_mnemonic:
+		case opdis_span_directive:
+			/* a prefix is followed by a space */
+			return brk || prev->type != type || ! prev->len ||
+			       isspace( (unsigned char) prev_str[prev->len-1] );
+		case opdis_span_comment:
+			if ( prev->type != opdis_span_comment ) {
+				/* comment text follows the comment start */
+				buf->span_break = 1;
+				return 1;
+			}
+			return brk;
+		case opdis_span_text:
+			if ( after_mnem && is_blank( str, len ) ) {
+				/* padding after mnemonic */
+				buf->span_break = 1;
+				return brk;
+			}
+			if ( len == 1 && *str == ',' && ! buf->span_depth ) {
+				/* operand separator */
+				buf->span_break = 1;
+				return 1;
+			}
+			update_depth( buf, str, len );
+			return brk || after_mnem;
+		default:
+			return brk || after_mnem;
+	}
+}
+
+static void add_span( opdis_insn_buf_t buf, enum opdis_span_type_t type,
+		      unsigned int offset, unsigned int len ) {
+	const char * str = &buf->string[offset];
+	int new_item = 1;
+
+	if ( buf->span_count ) {
+		if ( buf->spans[buf->span_count - 1].type == 
+		     opdis_span_comment ) {
+			type = opdis_span_comment;
+		}
+		new_item = span_starts_item( buf, type, str, len );
+	} else if ( type == opdis_span_text ) {
+		update_depth( buf, str, len );
+	}
+
+	if ( new_item && buf->item_count < buf->max_item_count ) {
+		unsigned int n = ( len < buf->max_item_size ) ? len :
+				 buf->max_item_size - 1;
+		memcpy( buf->items[buf->item_count], str, n );
+		buf->items[buf->item_count][n] = '\0';
+		buf->item_count++;
+	} else if ( buf->item_count ) {
+		char * item = buf->items[buf->item_count - 1];
+		unsigned int room = buf->max_item_size - strlen(item) - 1;
+		strncat( item, str, ( len < room ) ? len : room );
+	}
+
+	if ( buf->span_count < buf->max_span_count && buf->item_count ) {
+		opdis_insn_span_t * s = &buf->spans[buf->span_count++];
+		s->type = type;
+		s->item = buf->item_count - 1;
+		s->offset = offset;
+		s->len = len;
+	}
+}
+
+int LIBCALL opdis_insn_buf_append_span( opdis_insn_buf_t buf, 
+					enum opdis_span_type_t type,
+					const char * format, va_list args ) {
+	unsigned int offset, avail;
+	int rv;
+
+	if (! buf || ! buf->string || ! buf->spans ) {
+		return 0;
+	}
+
+	/* format straight into the insn string */
+	offset = strlen( buf->string );
+	avail = buf->max_string_size - offset;
+	rv = vsnprintf( &buf->string[offset], avail, format, args );
+	if ( rv > 0 ) {
+		add_span( buf, type, offset, 
+			  ( (unsigned int) rv < avail ) ? rv : avail - 1 );
+	}
+
+	return rv;
+}
+
 void LIBCALL opdis_insn_buf_clear( opdis_insn_buf_t buf ) {
 	if ( buf ) {
 		buf->item_count = 0;
 		buf->string[0] = '\0';
+		buf->span_count = 0;
+		buf->span_depth = 0;
+		buf->span_break = 0;
 	}
 }
 
@@ -103,5 +243,9 @@ void LIBCALL opdis_insn_buf_free( opdis_insn_buf_t buf ) {
 		free(buf->string);
 	}
 
+	if ( buf->spans ) {
+		free(buf->spans);
+	}
+
 	free(buf);
 }
@@ -18,6 +18,8 @@
         #define LIBCALL
 #endif
 
+#include <stdarg.h>
+
 #include <bfd.h>
 #include <dis-asm.h>
 
@@ -46,6 +48,44 @@
  */
 #define OPDIS_MAX_INSN_STR 128		
 
+/*! \def OPDIS_MAX_SPANS
+ *  Max number of typed spans that buffer can store.
+ *  \ingroup internal
+ *  \sa opdis_insn_buffer_t
+ */
+#define OPDIS_MAX_SPANS 128
+
+/* ---------------------------------------------------------------------- */
+/*! \enum opdis_span_type_t
+ *  \ingroup internal
+ *  \brief The type of a fragment of libopcodes output.
+ *  \details This is the libopcodes disassembler_style of the fragment, as
+ *           provided by fprintf_styled_func in binutils 2.39 and later.
+ */
+enum opdis_span_type_t {
+	opdis_span_text = 0,		/*!< Punctuation, padding, etc */
+	opdis_span_mnemonic,		/*!< Mnemonic or prefix */
+	opdis_span_directive,		/*!< Assembler directive, e.g. .byte */
+	opdis_span_register,		/*!< Register name */
+	opdis_span_immediate,		/*!< Immediate value */
+	opdis_span_address,		/*!< Address or address offset */
+	opdis_span_symbol,		/*!< Symbol name */
+	opdis_span_comment		/*!< Comment, to end of insn */
+};
+
+/*! \struct opdis_insn_span_t
+ *  \ingroup internal
+ *  \brief A typed fragment of libopcodes output.
+ *  \details The text of a span is not terminated; it is the \e len bytes
+ *           at \e offset in the raw instruction string.
+ */
+typedef struct {
+	enum opdis_span_type_t type;		/*!< Type of fragment */
+	unsigned int item;			/*!< Index of item containing span */
+	unsigned int offset;			/*!< Offset of text in string */
+	unsigned int len;			/*!< Length of text */
+} opdis_insn_span_t;
+
 /* ---------------------------------------------------------------------- */
 /*! \struct opdis_insn_buffer_t
  *  \ingroup internal
@@ -54,6 +94,11 @@
  *  \details This collects the strings emitted by libopcodes during 
  *           disassembly. A 'raw' string representation of the instruction 
  *           is also constructed.
+ *  \note When libopcodes provides styled output, each fragment is also
+ *        recorded as a span, and consecutive fragments belonging to the
+ *        same operand are merged into a single item. Decoders can use
+ *        the span types rather than parsing the items; \e span_count is
+ *        zero when libopcodes does not provide styled output.
  */
 typedef struct {
 	unsigned int item_count;		/*!< Number of items */
@@ -62,6 +107,11 @@ typedef struct {
 	char **items;				/*!< Array of stored items */
 	char *string;				/*!< Raw instruction string */
 	unsigned int max_string_size;		/*!< Max insn string length */
+	opdis_insn_span_t * spans;		/*!< Typed fragments of string */
+	unsigned int span_count;		/*!< Number of spans */
+	unsigned int max_span_count;		/*!< Max number of spans */
+	unsigned int span_depth;		/*!< Bracket depth of last span */
+	char span_break;			/*!< Next span starts an item */
 	/* instruction info from libopcodes disassemble_info struct */
 	char insn_info_valid;			/*!< Nonzero if info is set */
 	char branch_delay_insns;		/*!< Branch delay insn count */
@@ -69,6 +119,8 @@ typedef struct {
 	enum dis_insn_type insn_type;		/*!< Type of insn */
 	bfd_vma target;				/*!< Target addr of branch */
 	bfd_vma target2;			/*!< Second addr ref */
+	/* decoding requested by the disassembler; 0 requests all levels */
+	unsigned int decode_mask;		/*!< opdis_insn_decode_t levels */
 } opdis_insn_buffer_t;
 
 /*! \typedef opdis_insn_buf_t
@@ -123,6 +175,28 @@ void LIBCALL opdis_insn_buf_free( opdis_insn_buf_t buf );
  */
 int LIBCALL opdis_insn_buf_append( opdis_insn_buf_t buf, const char * item );
 
+/*!
+ * \fn int opdis_insn_buf_append_span( opdis_insn_buf_t, 
+ * 				      enum opdis_span_type_t, const char *,
+ * 				      va_list )
+ * \ingroup internal
+ * \brief Format a typed fragment of libopcodes output into a buffer.
+ * \details The fragment is formatted directly into the raw instruction
+ *          string and recorded as a span. It is appended to the current
+ *          item if it continues an operand, and starts a new item if it
+ *          begins a prefix, mnemonic, operand, separator or comment.
+ * \param buf The instruction buffer to append to.
+ * \param type The type of the fragment.
+ * \param format The printf-style format string.
+ * \param args The arguments for \e format.
+ * \return The number of characters formatted, as with vsnprintf.
+ * \note Once a comment span has been appended, all following spans in
+ *       the instruction are comment spans.
+ */
+int LIBCALL opdis_insn_buf_append_span( opdis_insn_buf_t buf, 
+					enum opdis_span_type_t type,
+					const char * format, va_list args );
+
 /*!
  * \fn void opdis_insn_buf_clear( opdis_insn_buf_t )
  * \ingroup internal
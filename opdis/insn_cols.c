@@ -0,0 +1,522 @@
+/*!
+ * \file insn_cols.c
+ * \brief Columnar binary instruction files.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/insn_cols.h>
+
+#define ALIGN8(x) ( ((x) + 7) & ~((size_t) 7) )
+
+/* ---------------------------------------------------------------------- */
+/* STRING TABLES */
+
+/* strings are interned in an open-addressed hash table of string indexes;
+ * index 0 is the empty string */
+struct strtab {
+	uint32_t num, alloc;
+	uint32_t * off;
+	char * data;
+	size_t len, data_alloc;
+	uint32_t * buckets;		/* string index + 1, or 0 if empty */
+	uint32_t num_buckets;
+};
+
+static uint32_t str_hash( const char * s ) {
+	uint32_t h = 2166136261U;
+	for ( ; *s; s++ ) {
+		h = ( h ^ (unsigned char) *s ) * 16777619U;
+	}
+	return h;
+}
+
+static int strtab_rehash( struct strtab * t, uint32_t num_buckets ) {
+	uint32_t i, * b = calloc( num_buckets, sizeof(uint32_t) );
+
+	if (! b ) {
+		return 0;
+	}
+
+	/* string 0 is never hashed: it is the empty string */
+	for ( i = 1; i < t->num; i++ ) {
+		uint32_t h = str_hash( &t->data[t->off[i]] );
+		while ( b[h & (num_buckets - 1)] ) {
+			h++;
+		}
+		b[h & (num_buckets - 1)] = i + 1;
+	}
+
+	free( t->buckets );
+	t->buckets = b;
+	t->num_buckets = num_buckets;
+	return 1;
+}
+
+static void strtab_clear( struct strtab * t ) {
+	t->num = 1;
+	t->off[0] = 0;
+	t->data[0] = '\0';
+	t->len = 1;
+	memset( t->buckets, 0, t->num_buckets * sizeof(uint32_t) );
+}
+
+static int strtab_init( struct strtab * t ) {
+	memset( t, 0, sizeof(struct strtab) );
+	t->alloc = 256;
+	t->data_alloc = 4096;
+	t->num_buckets = 512;
+	t->off = calloc( t->alloc, sizeof(uint32_t) );
+	t->data = calloc( t->data_alloc, 1 );
+	t->buckets = calloc( t->num_buckets, sizeof(uint32_t) );
+	if (! t->off || ! t->data || ! t->buckets ) {
+		return 0;
+	}
+
+	strtab_clear( t );
+	return 1;
+}
+
+static void strtab_free( struct strtab * t ) {
+	free( t->off );
+	free( t->data );
+	free( t->buckets );
+}
+
+/* return index of string s, adding it if necessary; UINT32_MAX on error */
+static uint32_t strtab_add( struct strtab * t, const char * s ) {
+	uint32_t h, idx;
+	size_t len;
+
+	if (! s || ! s[0] ) {
+		return 0;
+	}
+
+	h = str_hash( s );
+	while ( (idx = t->buckets[h & (t->num_buckets - 1)]) ) {
+		if (! strcmp( &t->data[t->off[idx - 1]], s ) ) {
+			return idx - 1;
+		}
+		h++;
+	}
+
+	len = strlen( s ) + 1;
+	if ( t->len + len > t->data_alloc ) {
+		size_t size = t->data_alloc * 2;
+		char * data;
+		while ( t->len + len > size ) {
+			size *= 2;
+		}
+		data = realloc( t->data, size );
+		if (! data ) {
+			return UINT32_MAX;
+		}
+		t->data = data;
+		t->data_alloc = size;
+	}
+
+	if ( t->num == t->alloc ) {
+		uint32_t * off = realloc( t->off, t->alloc * 2 *
+					  sizeof(uint32_t) );
+		if (! off ) {
+			return UINT32_MAX;
+		}
+		t->off = off;
+		t->alloc *= 2;
+	}
+
+	idx = t->num++;
+	t->off[idx] = (uint32_t) t->len;
+	memcpy( &t->data[t->len], s, len );
+	t->len += len;
+	t->buckets[h & (t->num_buckets - 1)] = idx + 1;
+
+	/* keep the table at most half full */
+	if ( t->num * 2 > t->num_buckets &&
+	     ! strtab_rehash( t, t->num_buckets * 2 ) ) {
+		return UINT32_MAX;
+	}
+
+	return idx;
+}
+
+/* ---------------------------------------------------------------------- */
+/* WRITER */
+
+struct opdis_cols_writer {
+	FILE * f;
+	uint32_t max_insns;
+
+	/* insn columns */
+	uint32_t num_insns;
+	uint64_t * vma;
+	uint16_t * size;
+	uint8_t * category;
+	uint16_t * flags;
+	uint32_t * mnemonic;
+	uint32_t * op_first;
+
+	/* operand columns */
+	uint32_t num_ops, alloc_ops;
+	uint32_t * op_ascii;
+	uint8_t * op_category;
+	uint8_t * op_flags;
+
+	struct strtab mnemonics;
+	struct strtab op_strs;
+};
+
+static int write_col( FILE * f, const void * col, size_t len ) {
+	static const char pad[8] = {0};
+	size_t padding = ALIGN8(len) - len;
+
+	if ( len && fwrite( col, len, 1, f ) != 1 ) {
+		return 0;
+	}
+	return ( ! padding || fwrite( pad, padding, 1, f ) == 1 );
+}
+
+/* size of the columns of a block, not including the header */
+static size_t block_cols_size( const opdis_cols_block_hdr_t * hdr ) {
+	size_t n = hdr->num_insns, m = hdr->num_operands;
+
+	return ALIGN8(n * 8) + ALIGN8(n * 2) + ALIGN8(n) + ALIGN8(n * 2) +
+	       ALIGN8(n * 4) + ALIGN8((n + 1) * 4) +
+	       ALIGN8(m * 4) + ALIGN8(m) + ALIGN8(m) +
+	       ALIGN8((size_t) hdr->num_mnemonics * 4) +
+	       ALIGN8(hdr->mnemonic_bytes) +
+	       ALIGN8((size_t) hdr->num_op_strings * 4) +
+	       ALIGN8(hdr->op_str_bytes);
+}
+
+static int write_block( opdis_cols_writer_t w ) {
+	opdis_cols_block_hdr_t hdr = {0};
+	size_t n = w->num_insns, m = w->num_ops;
+	size_t size;
+	int ok;
+
+	if (! n ) {
+		return 1;
+	}
+
+	hdr.num_insns = w->num_insns;
+	hdr.num_operands = w->num_ops;
+	hdr.num_mnemonics = w->mnemonics.num;
+	hdr.mnemonic_bytes = (uint32_t) w->mnemonics.len;
+	hdr.num_op_strings = w->op_strs.num;
+	hdr.op_str_bytes = (uint32_t) w->op_strs.len;
+
+	size = sizeof(hdr) + block_cols_size( &hdr );
+	if ( size > UINT32_MAX ) {
+		fprintf( stderr, "Columnar block exceeds 4 GB\n" );
+		return 0;
+	}
+	hdr.block_size = (uint32_t) size;
+	w->op_first[n] = w->num_ops;
+
+	ok = write_col( w->f, &hdr, sizeof(hdr) ) &&
+	     write_col( w->f, w->vma, n * 8 ) &&
+	     write_col( w->f, w->size, n * 2 ) &&
+	     write_col( w->f, w->category, n ) &&
+	     write_col( w->f, w->flags, n * 2 ) &&
+	     write_col( w->f, w->mnemonic, n * 4 ) &&
+	     write_col( w->f, w->op_first, (n + 1) * 4 ) &&
+	     write_col( w->f, w->op_ascii, m * 4 ) &&
+	     write_col( w->f, w->op_category, m ) &&
+	     write_col( w->f, w->op_flags, m ) &&
+	     write_col( w->f, w->mnemonics.off, w->mnemonics.num * 4 ) &&
+	     write_col( w->f, w->mnemonics.data, w->mnemonics.len ) &&
+	     write_col( w->f, w->op_strs.off, w->op_strs.num * 4 ) &&
+	     write_col( w->f, w->op_strs.data, w->op_strs.len );
+
+	/* string tables are per block, so each block stands alone */
+	w->num_insns = w->num_ops = 0;
+	strtab_clear( &w->mnemonics );
+	strtab_clear( &w->op_strs );
+
+	return ok;
+}
+
+static void writer_free( opdis_cols_writer_t w ) {
+	free( w->vma );
+	free( w->size );
+	free( w->category );
+	free( w->flags );
+	free( w->mnemonic );
+	free( w->op_first );
+	free( w->op_ascii );
+	free( w->op_category );
+	free( w->op_flags );
+	strtab_free( &w->mnemonics );
+	strtab_free( &w->op_strs );
+	free( w );
+}
+
+opdis_cols_writer_t LIBCALL opdis_cols_writer_init( FILE * f,
+						    unsigned int block_insns ) {
+	opdis_cols_file_hdr_t hdr;
+	opdis_cols_writer_t w;
+	size_t n;
+
+	if (! f ) {
+		return NULL;
+	}
+
+	w = calloc( 1, sizeof(struct opdis_cols_writer) );
+	if (! w ) {
+		return NULL;
+	}
+
+	n = w->max_insns = ( block_insns ) ? block_insns :
+					     OPDIS_COLS_BLOCK_INSNS;
+	w->f = f;
+	w->vma = calloc( n, sizeof(uint64_t) );
+	w->size = calloc( n, sizeof(uint16_t) );
+	w->category = calloc( n, sizeof(uint8_t) );
+	w->flags = calloc( n, sizeof(uint16_t) );
+	w->mnemonic = calloc( n, sizeof(uint32_t) );
+	w->op_first = calloc( n + 1, sizeof(uint32_t) );
+	w->alloc_ops = n * 2;
+	w->op_ascii = calloc( w->alloc_ops, sizeof(uint32_t) );
+	w->op_category = calloc( w->alloc_ops, sizeof(uint8_t) );
+	w->op_flags = calloc( w->alloc_ops, sizeof(uint8_t) );
+
+	if ( ! strtab_init( &w->mnemonics ) || ! strtab_init( &w->op_strs ) ||
+	     ! w->vma || ! w->size || ! w->category || ! w->flags ||
+	     ! w->mnemonic || ! w->op_first || ! w->op_ascii ||
+	     ! w->op_category || ! w->op_flags ) {
+		writer_free( w );
+		return NULL;
+	}
+
+	memcpy( hdr.magic, OPDIS_COLS_MAGIC, sizeof(hdr.magic) );
+	hdr.version = OPDIS_COLS_VERSION;
+	hdr.byte_order = OPDIS_COLS_BYTE_ORDER;
+	if ( fwrite( &hdr, sizeof(hdr), 1, f ) != 1 ) {
+		writer_free( w );
+		return NULL;
+	}
+
+	return w;
+}
+
+static int grow_ops( opdis_cols_writer_t w, uint32_t num ) {
+	uint32_t alloc = w->alloc_ops;
+	void * a, * c, * f;
+
+	while ( w->num_ops + num > alloc ) {
+		alloc *= 2;
+	}
+
+	a = realloc( w->op_ascii, alloc * sizeof(uint32_t) );
+	if ( a ) w->op_ascii = a;
+	c = realloc( w->op_category, alloc );
+	if ( c ) w->op_category = c;
+	f = realloc( w->op_flags, alloc );
+	if ( f ) w->op_flags = f;
+
+	if (! a || ! c || ! f ) {
+		return 0;
+	}
+
+	w->alloc_ops = alloc;
+	return 1;
+}
+
+int LIBCALL opdis_cols_writer_add( opdis_cols_writer_t w,
+				   const opdis_insn_t * insn ) {
+	uint32_t i, n, mnem;
+
+	if (! w || ! insn ) {
+		return 0;
+	}
+
+	if ( w->num_ops + insn->num_operands > w->alloc_ops &&
+	     ! grow_ops( w, insn->num_operands ) ) {
+		return 0;
+	}
+
+	mnem = strtab_add( &w->mnemonics, insn->mnemonic );
+	if ( mnem == UINT32_MAX ) {
+		return 0;
+	}
+
+	n = w->num_insns;
+	w->vma[n] = insn->vma;
+	w->size[n] = (uint16_t) insn->size;
+	w->category[n] = (uint8_t) insn->category;
+	w->flags[n] = (uint16_t) insn->flags.cflow;
+	w->mnemonic[n] = mnem;
+	w->op_first[n] = w->num_ops;
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		const opdis_op_t * op = insn->operands[i];
+		uint32_t str = strtab_add( &w->op_strs, op->ascii );
+		if ( str == UINT32_MAX ) {
+			return 0;
+		}
+		w->op_ascii[w->num_ops] = str;
+		w->op_category[w->num_ops] = (uint8_t) op->category;
+		w->op_flags[w->num_ops] = (uint8_t) op->flags;
+		w->num_ops++;
+	}
+
+	w->num_insns++;
+	if ( w->num_insns == w->max_insns ) {
+		return write_block( w );
+	}
+
+	return 1;
+}
+
+int LIBCALL opdis_cols_writer_close( opdis_cols_writer_t w ) {
+	int rv;
+
+	if (! w ) {
+		return 0;
+	}
+
+	rv = write_block( w );
+	writer_free( w );
+	return rv;
+}
+
+/* ---------------------------------------------------------------------- */
+/* READER */
+
+size_t LIBCALL opdis_cols_check( const void * buf, size_t len ) {
+	const opdis_cols_file_hdr_t * hdr = (const opdis_cols_file_hdr_t *) buf;
+
+	if (! buf || len < sizeof(opdis_cols_file_hdr_t) ||
+	     ((uintptr_t) buf & 7) ||
+	     memcmp( hdr->magic, OPDIS_COLS_MAGIC, sizeof(hdr->magic) ) ||
+	     hdr->version != OPDIS_COLS_VERSION ||
+	     hdr->byte_order != OPDIS_COLS_BYTE_ORDER ) {
+		return 0;
+	}
+
+	return sizeof(opdis_cols_file_hdr_t);
+}
+
+/* is every string offset in range, and the string table NUL-terminated? */
+static int check_strtab( const uint32_t * off, uint32_t num, const char * str,
+			 uint32_t bytes ) {
+	uint32_t i;
+
+	if (! num || ! bytes || str[bytes - 1] != '\0' || off[0] >= bytes ||
+	     str[off[0]] != '\0' ) {
+		return 0;
+	}
+
+	for ( i = 1; i < num; i++ ) {
+		if ( off[i] >= bytes ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* are all string and operand indexes of a block in range? */
+static int check_block( const opdis_cols_block_t * b ) {
+	uint32_t i;
+
+	if ( b->op_first[0] != 0 || b->op_first[b->num_insns] != b->num_operands ){
+		return 0;
+	}
+
+	for ( i = 0; i < b->num_insns; i++ ) {
+		if ( b->mnemonic[i] >= b->num_mnemonics ||
+		     b->op_first[i] > b->op_first[i + 1] ) {
+			return 0;
+		}
+	}
+
+	for ( i = 0; i < b->num_operands; i++ ) {
+		if ( b->op_ascii[i] >= b->num_op_strings ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+size_t LIBCALL opdis_cols_block( const void * buf, size_t len, size_t pos,
+				 opdis_cols_block_t * blk ) {
+	const opdis_cols_block_hdr_t * hdr;
+	const unsigned char * p;
+	size_t n, m;
+
+	if (! buf || ! blk || (pos & 7) || pos >= len ||
+	     len - pos < sizeof(opdis_cols_block_hdr_t) ) {
+		return 0;
+	}
+
+	hdr = (const opdis_cols_block_hdr_t *) ((const char *) buf + pos);
+	if ( hdr->block_size > len - pos || ! hdr->num_insns ||
+	     hdr->block_size != sizeof(*hdr) + block_cols_size( hdr ) ) {
+		fprintf( stderr, "Invalid columnar block at offset %lu\n",
+			 (unsigned long) pos );
+		return 0;
+	}
+
+	n = hdr->num_insns;
+	m = hdr->num_operands;
+	p = (const unsigned char *) (hdr + 1);
+
+	blk->num_insns = hdr->num_insns;
+	blk->num_operands = hdr->num_operands;
+	blk->vma = (const uint64_t *) p;	p += ALIGN8(n * 8);
+	blk->size = (const uint16_t *) p;	p += ALIGN8(n * 2);
+	blk->category = p;			p += ALIGN8(n);
+	blk->flags = (const uint16_t *) p;	p += ALIGN8(n * 2);
+	blk->mnemonic = (const uint32_t *) p;	p += ALIGN8(n * 4);
+	blk->op_first = (const uint32_t *) p;	p += ALIGN8((n + 1) * 4);
+	blk->op_ascii = (const uint32_t *) p;	p += ALIGN8(m * 4);
+	blk->op_category = p;			p += ALIGN8(m);
+	blk->op_flags = p;			p += ALIGN8(m);
+
+	blk->num_mnemonics = hdr->num_mnemonics;
+	blk->mnemonic_off = (const uint32_t *) p;
+	p += ALIGN8((size_t) hdr->num_mnemonics * 4);
+	blk->mnemonic_str = (const char *) p;
+	p += ALIGN8(hdr->mnemonic_bytes);
+
+	blk->num_op_strings = hdr->num_op_strings;
+	blk->op_str_off = (const uint32_t *) p;
+	p += ALIGN8((size_t) hdr->num_op_strings * 4);
+	blk->op_str = (const char *) p;
+
+	if (! check_strtab( blk->mnemonic_off, blk->num_mnemonics,
+			     blk->mnemonic_str, hdr->mnemonic_bytes ) ||
+	     ! check_strtab( blk->op_str_off, blk->num_op_strings,
+			     blk->op_str, hdr->op_str_bytes ) ||
+	     ! check_block( blk ) ) {
+		fprintf( stderr, "Invalid columnar block at offset %lu\n",
+			 (unsigned long) pos );
+		return 0;
+	}
+
+	return pos + hdr->block_size;
+}
+
+const char * LIBCALL opdis_cols_mnemonic( const opdis_cols_block_t * blk,
+					  uint32_t insn ) {
+	if (! blk || insn >= blk->num_insns ) {
+		return "";
+	}
+	return &blk->mnemonic_str[blk->mnemonic_off[blk->mnemonic[insn]]];
+}
+
+const char * LIBCALL opdis_cols_op_ascii( const opdis_cols_block_t * blk,
+					  uint32_t op ) {
+	if (! blk || op >= blk->num_operands ) {
+		return "";
+	}
+	return &blk->op_str[blk->op_str_off[blk->op_ascii[op]]];
+}
@@ -0,0 +1,256 @@
+/*!
+ * \file insn_cols.h
+ * \brief Columnar binary instruction files.
+ * \details A columnar file stores instructions in blocks. Each block holds
+ *          one array (column) per instruction field, plus string tables
+ *          for the mnemonics and operands of the instructions in the
+ *          block. A block can be used in place, e.g. from a memory-mapped
+ *          file, without decoding or copying the instructions.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_INSN_COLS_H
+#define OPDIS_INSN_COLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <opdis/model.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_COLS_MAGIC
+ * \ingroup model
+ * \brief The first 8 bytes of a columnar file.
+ */
+#define OPDIS_COLS_MAGIC "OPDISCOL"
+
+/*!
+ * \def OPDIS_COLS_VERSION
+ * \ingroup model
+ * \brief The version of the columnar file format.
+ */
+#define OPDIS_COLS_VERSION 1
+
+/*!
+ * \def OPDIS_COLS_BYTE_ORDER
+ * \ingroup model
+ * \brief Value written in the byte order of the host that wrote the file.
+ */
+#define OPDIS_COLS_BYTE_ORDER 0x01020304
+
+/*!
+ * \def OPDIS_COLS_BLOCK_INSNS
+ * \ingroup model
+ * \brief Default number of instructions in a block.
+ */
+#define OPDIS_COLS_BLOCK_INSNS 65536
+
+/*!
+ * \struct opdis_cols_file_hdr_t
+ * \ingroup model
+ * \brief The header of a columnar file.
+ * \details The header is followed by the blocks of the file. All values
+ *          in the file are in host byte order; a reader on a host of the
+ *          other byte order will see a byte-swapped \e byte_order field.
+ */
+typedef struct {
+	char		magic[8];	/*!< OPDIS_COLS_MAGIC */
+	uint32_t	version;	/*!< OPDIS_COLS_VERSION */
+	uint32_t	byte_order;	/*!< OPDIS_COLS_BYTE_ORDER */
+} opdis_cols_file_hdr_t;
+
+/*!
+ * \struct opdis_cols_block_hdr_t
+ * \ingroup model
+ * \brief The header of a block of instructions.
+ * \details The columns follow the header in this order, each starting on
+ *          an 8-byte boundary:
+ *          <pre>
+ *          uint64_t vma[num_insns]
+ *          uint16_t size[num_insns]
+ *          uint8_t  category[num_insns]         enum opdis_insn_cat_t
+ *          uint16_t flags[num_insns]            insn flags
+ *          uint32_t mnemonic[num_insns]         mnemonic string index
+ *          uint32_t op_first[num_insns + 1]     first operand of insn
+ *          uint32_t op_ascii[num_operands]      operand string index
+ *          uint8_t  op_category[num_operands]   enum opdis_op_cat_t
+ *          uint8_t  op_flags[num_operands]      enum opdis_op_flag_t
+ *          uint32_t mnemonic_off[num_mnemonics]
+ *          char     mnemonic_str[mnemonic_bytes]
+ *          uint32_t op_str_off[num_op_strings]
+ *          char     op_str[op_str_bytes]
+ *          </pre>
+ *          The operands of instruction \e i are op_first[i] up to (but
+ *          not including) op_first[i + 1]. Each string table is an array
+ *          of offsets into a block of NUL-terminated strings; string 0 is
+ *          always the empty string, and is used for an absent string.
+ */
+typedef struct {
+	uint32_t	block_size;	/*!< Size of block including header */
+	uint32_t	num_insns;	/*!< Number of insns in block */
+	uint32_t	num_operands;	/*!< Number of operands in block */
+	uint32_t	num_mnemonics;	/*!< Number of mnemonic strings */
+	uint32_t	mnemonic_bytes;	/*!< Size of mnemonic strings */
+	uint32_t	num_op_strings;	/*!< Number of operand strings */
+	uint32_t	op_str_bytes;	/*!< Size of operand strings */
+	uint32_t	reserved;
+} opdis_cols_block_hdr_t;
+
+/*!
+ * \struct opdis_cols_block_t
+ * \ingroup model
+ * \brief A block of instructions read from a columnar file.
+ * \details The pointers refer to the columns of the block in the buffer
+ *          that the block was read from.
+ */
+typedef struct {
+	uint32_t num_insns;		/*!< Number of insns */
+	uint32_t num_operands;		/*!< Number of operands */
+	const uint64_t * vma;		/*!< VMA of each insn */
+	const uint16_t * size;		/*!< Size of each insn */
+	const uint8_t * category;	/*!< Category of each insn */
+	const uint16_t * flags;		/*!< Flags of each insn */
+	const uint32_t * mnemonic;	/*!< Mnemonic string of each insn */
+	const uint32_t * op_first;	/*!< First operand of each insn */
+	const uint32_t * op_ascii;	/*!< String of each operand */
+	const uint8_t * op_category;	/*!< Category of each operand */
+	const uint8_t * op_flags;	/*!< Flags of each operand */
+	uint32_t num_mnemonics;		/*!< Number of mnemonic strings */
+	const uint32_t * mnemonic_off;	/*!< Offsets of mnemonic strings */
+	const char * mnemonic_str;	/*!< Mnemonic strings */
+	uint32_t num_op_strings;	/*!< Number of operand strings */
+	const uint32_t * op_str_off;	/*!< Offsets of operand strings */
+	const char * op_str;		/*!< Operand strings */
+} opdis_cols_block_t;
+
+/*!
+ * \typedef opdis_cols_writer_t
+ * \ingroup model
+ * \brief A writer which collects instructions into blocks.
+ */
+typedef struct opdis_cols_writer * opdis_cols_writer_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* ---------------------------------------------------------------------- */
+/* WRITER */
+
+/*!
+ * \fn opdis_cols_writer_t opdis_cols_writer_init( FILE *, unsigned int )
+ * \ingroup model
+ * \brief Write a file header and create a writer for the blocks following it.
+ * \param f The stream to write to.
+ * \param block_insns Number of instructions in each block, or 0 for
+ *                    \ref OPDIS_COLS_BLOCK_INSNS.
+ * \return The writer, or NULL on error.
+ * \sa opdis_cols_writer_close
+ */
+opdis_cols_writer_t LIBCALL opdis_cols_writer_init( FILE * f,
+						    unsigned int block_insns );
+
+/*!
+ * \fn int opdis_cols_writer_add( opdis_cols_writer_t, const opdis_insn_t * )
+ * \ingroup model
+ * \brief Add an instruction to the current block.
+ * \details The block is written once it contains \e block_insns
+ *          instructions.
+ * \param w The writer.
+ * \param insn The instruction to add.
+ * \return 1 on success, 0 on failure.
+ */
+int LIBCALL opdis_cols_writer_add( opdis_cols_writer_t w,
+				   const opdis_insn_t * insn );
+
+/*!
+ * \fn int opdis_cols_writer_close( opdis_cols_writer_t )
+ * \ingroup model
+ * \brief Write the current block and free the writer.
+ * \param w The writer.
+ * \return 1 on success, 0 if a block could not be written.
+ * \note The stream is not closed.
+ */
+int LIBCALL opdis_cols_writer_close( opdis_cols_writer_t w );
+
+/* ---------------------------------------------------------------------- */
+/* READER */
+
+/*!
+ * \fn size_t opdis_cols_check( const void *, size_t )
+ * \ingroup model
+ * \brief Check the header of a columnar file in memory.
+ * \param buf The contents of the file. This must be 8-byte aligned.
+ * \param len The size of \e buf.
+ * \return The offset of the first block, or 0 if \e buf is not a columnar
+ *         file written on a host of the same byte order.
+ */
+size_t LIBCALL opdis_cols_check( const void * buf, size_t len );
+
+/*!
+ * \fn size_t opdis_cols_block( const void *, size_t, size_t,
+ * 			       opdis_cols_block_t * )
+ * \ingroup model
+ * \brief Read the block at \e pos of a columnar file in memory.
+ * \details The block is validated, so that every string and operand index
+ *          in it is in range; the columns are not copied.
+ * \param buf The contents of the file.
+ * \param len The size of \e buf.
+ * \param pos The offset of the block, as returned by opdis_cols_check or
+ *            a previous call to opdis_cols_block.
+ * \param blk The block to fill.
+ * \return The offset of the next block, or 0 at the end of the file or if
+ *         the block is invalid.
+ * \code
+ * 	size_t pos = opdis_cols_check( buf, len );
+ * 	while ( pos && (pos = opdis_cols_block( buf, len, pos, &blk )) ) {
+ * 		for ( i = 0; i < blk.num_insns; i++ ) {
+ * 			printf( "%lX %s\n", blk.vma[i],
+ * 				opdis_cols_mnemonic( &blk, i ) );
+ * 		}
+ * 	}
+ * \endcode
+ */
+size_t LIBCALL opdis_cols_block( const void * buf, size_t len, size_t pos,
+				 opdis_cols_block_t * blk );
+
+/*!
+ * \fn const char * opdis_cols_mnemonic( const opdis_cols_block_t *,
+ * 					 uint32_t )
+ * \ingroup model
+ * \brief Return the mnemonic of an instruction in a block.
+ * \param blk The block.
+ * \param insn The index of the instruction.
+ * \return The mnemonic, or "" if the instruction has none.
+ */
+const char * LIBCALL opdis_cols_mnemonic( const opdis_cols_block_t * blk,
+					  uint32_t insn );
+
+/*!
+ * \fn const char * opdis_cols_op_ascii( const opdis_cols_block_t *,
+ * 					 uint32_t )
+ * \ingroup model
+ * \brief Return the string of an operand in a block.
+ * \param blk The block.
+ * \param op The index of the operand in the block (not in the insn).
+ * \return The operand string, or "" if the operand has none.
+ */
+const char * LIBCALL opdis_cols_op_ascii( const opdis_cols_block_t * blk,
+					  uint32_t op );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
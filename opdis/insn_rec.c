@@ -0,0 +1,385 @@
+/*!
+ * \file insn_rec.c
+ * \brief Packed instruction record implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/insn_rec.h>
+
+/* records are aligned to, and sized in multiples of, 8 bytes */
+#define REC_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
+/* size of the fixed-size prefix field; see model.c */
+#define PREFIX_SIZE(mnem_size) (4 * mnem_size)
+
+#define REC_PTR(rec, off) (((const char *) (rec)) + (off))
+#define REC_OPS(rec) ((const opdis_op_rec_t *) \
+		      REC_PTR(rec, REC_ALIGN(sizeof(opdis_insn_rec_t))))
+
+static size_t str_size( const char * str ) {
+	return ( str ) ? strlen(str) + 1 : 0;
+}
+
+static int op_index( const opdis_insn_t * insn, const opdis_op_t * op ) {
+	int i;
+
+	if (! op ) {
+		return OPDIS_INSN_REC_NO_OP;
+	}
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		if ( insn->operands[i] == op ) {
+			return i;
+		}
+	}
+
+	return OPDIS_INSN_REC_NO_OP;
+}
+
+/* copy a string into the record tail; returns its offset or 0 for NULL */
+static uint32_t pack_str( char * base, size_t * pos, const char * str ) {
+	size_t len = str_size( str );
+	uint32_t off;
+
+	if (! len ) {
+		return 0;
+	}
+
+	off = (uint32_t) *pos;
+	memcpy( base + off, str, len );
+	*pos += len;
+
+	return off;
+}
+
+/* ---------------------------------------------------------------------- */
+/* CONVERSION */
+
+size_t LIBCALL opdis_insn_rec_size( const opdis_insn_t * insn ) {
+	size_t size;
+	int i;
+
+	if (! insn ) {
+		return 0;
+	}
+
+	size = REC_ALIGN(sizeof(opdis_insn_rec_t));
+	size += insn->num_operands * sizeof(opdis_op_rec_t);
+	size += insn->size;
+	size += str_size( insn->ascii ) + str_size( insn->prefixes ) +
+		str_size( insn->mnemonic ) + str_size( insn->comment );
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		size += str_size( insn->operands[i]->ascii );
+	}
+
+	return REC_ALIGN(size);
+}
+
+size_t LIBCALL opdis_insn_pack( const opdis_insn_t * insn, void * buf,
+				size_t buf_len ) {
+	opdis_insn_rec_t * rec = (opdis_insn_rec_t *) buf;
+	opdis_op_rec_t * ops;
+	char * base = (char *) buf;
+	size_t size, pos;
+	int i;
+
+	size = opdis_insn_rec_size( insn );
+	if (! size || ! buf || size > buf_len ) {
+		return 0;
+	}
+
+	memset( buf, 0, size );
+
+	rec->rec_size = (uint32_t) size;
+	rec->num_operands = (uint16_t) insn->num_operands;
+	rec->num_prefixes = (uint16_t) insn->num_prefixes;
+	rec->offset = insn->offset;
+	rec->vma = insn->vma;
+	rec->size = (uint32_t) insn->size;
+	rec->status = (uint8_t) insn->status;
+	rec->category = (uint8_t) insn->category;
+	rec->isa = (uint8_t) insn->isa;
+	rec->flags = (uint16_t) insn->flags.cflow;
+	rec->target = (int8_t) op_index( insn, insn->target );
+	rec->dest = (int8_t) op_index( insn, insn->dest );
+	rec->src = (int8_t) op_index( insn, insn->src );
+
+	pos = REC_ALIGN(sizeof(opdis_insn_rec_t));
+	ops = (opdis_op_rec_t *) (base + pos);
+	pos += insn->num_operands * sizeof(opdis_op_rec_t);
+
+	rec->bytes = (uint32_t) pos;
+	if ( insn->bytes && insn->size ) {
+		memcpy( base + pos, insn->bytes, insn->size );
+	}
+	pos += insn->size;
+
+	rec->ascii = pack_str( base, &pos, insn->ascii );
+	rec->prefixes = pack_str( base, &pos, insn->prefixes );
+	rec->mnemonic = pack_str( base, &pos, insn->mnemonic );
+	rec->comment = pack_str( base, &pos, insn->comment );
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		opdis_op_t * op = insn->operands[i];
+		memcpy( &ops[i].value, &op->value, sizeof(ops[i].value) );
+		ops[i].category = (uint8_t) op->category;
+		ops[i].flags = (uint8_t) op->flags;
+		ops[i].data_size = op->data_size;
+		ops[i].ascii = pack_str( base, &pos, op->ascii );
+	}
+
+	return size;
+}
+
+opdis_insn_rec_t * LIBCALL opdis_insn_rec_alloc( const opdis_insn_t * insn ) {
+	opdis_insn_rec_t * rec;
+	size_t size = opdis_insn_rec_size( insn );
+
+	if (! size ) {
+		return NULL;
+	}
+
+	rec = (opdis_insn_rec_t *) malloc( size );
+	if ( rec ) {
+		opdis_insn_pack( insn, rec, size );
+	}
+
+	return rec;
+}
+
+opdis_insn_rec_t * LIBCALL opdis_insn_rec_arena( const opdis_insn_t * insn,
+						 opdis_arena_t arena ) {
+	opdis_insn_rec_t * rec;
+	size_t size = opdis_insn_rec_size( insn );
+
+	if (! size || ! arena ) {
+		return NULL;
+	}
+
+	rec = (opdis_insn_rec_t *) opdis_arena_alloc( arena, size );
+	if ( rec ) {
+		opdis_insn_pack( insn, rec, size );
+	}
+
+	return rec;
+}
+
+opdis_insn_rec_t * LIBCALL opdis_insn_rec_dupe( const opdis_insn_rec_t * rec){
+	opdis_insn_rec_t * new_rec;
+
+	if (! rec ) {
+		return NULL;
+	}
+
+	new_rec = (opdis_insn_rec_t *) malloc( rec->rec_size );
+	if ( new_rec ) {
+		memcpy( new_rec, rec, rec->rec_size );
+	}
+
+	return new_rec;
+}
+
+void LIBCALL opdis_insn_rec_free( opdis_insn_rec_t * rec ) {
+	if ( rec ) {
+		free( rec );
+	}
+}
+
+opdis_insn_t * LIBCALL opdis_insn_unpack( const opdis_insn_rec_t * rec ) {
+	opdis_insn_t * insn;
+
+	if (! rec ) {
+		return NULL;
+	}
+
+	insn = opdis_insn_alloc( 0 );
+	if (! insn ) {
+		return NULL;
+	}
+
+	if (! opdis_insn_rec_fill( rec, insn ) ) {
+		opdis_insn_free( insn );
+		return NULL;
+	}
+
+	return insn;
+}
+
+static void fill_prefixes( opdis_insn_t * insn, const char * prefixes ) {
+	if ( insn->fixed_size ) {
+		strncpy( insn->prefixes, prefixes,
+			 PREFIX_SIZE(insn->mnemonic_sz) - 1 );
+		return;
+	}
+
+	if ( insn->prefixes ) {
+		free( (void *) insn->prefixes );
+	}
+
+	insn->prefixes = strdup( prefixes );
+}
+
+static void fill_comment( opdis_insn_t * insn, const char * comment ) {
+	if ( insn->fixed_size ) {
+		strncpy( insn->comment, comment, insn->ascii_sz - 1 );
+		return;
+	}
+
+	if ( insn->comment ) {
+		free( (void *) insn->comment );
+	}
+
+	insn->comment = strdup( comment );
+}
+
+/* an insn which borrows its bytes points into the record */
+static int fill_bytes( opdis_insn_t * insn, const opdis_insn_rec_t * rec ) {
+	const opdis_byte_t * bytes = (const opdis_byte_t *)
+				     REC_PTR(rec, rec->bytes);
+
+	return opdis_insn_set_bytes( insn, bytes, rec->size );
+}
+
+int LIBCALL opdis_insn_rec_fill( const opdis_insn_rec_t * rec,
+				 opdis_insn_t * insn ) {
+	const opdis_op_rec_t * ops;
+	int i;
+
+	if (! rec || ! insn ) {
+		return 0;
+	}
+
+	opdis_insn_clear( insn );
+
+	insn->status = (enum opdis_insn_decode_t) rec->status;
+	insn->offset = (opdis_off_t) rec->offset;
+	insn->vma = (opdis_vma_t) rec->vma;
+	insn->size = (opdis_off_t) rec->size;
+	insn->num_prefixes = rec->num_prefixes;
+	insn->category = (enum opdis_insn_cat_t) rec->category;
+	insn->isa = (enum opdis_insn_subset_t) rec->isa;
+	insn->flags.cflow = (enum opdis_cflow_flag_t) rec->flags;
+
+	if (! fill_bytes( insn, rec ) ) {
+		return 0;
+	}
+
+	if ( rec->ascii ) {
+		opdis_insn_set_ascii( insn, REC_PTR(rec, rec->ascii) );
+	}
+	if ( rec->prefixes ) {
+		fill_prefixes( insn, REC_PTR(rec, rec->prefixes) );
+	}
+	if ( rec->mnemonic ) {
+		opdis_insn_set_mnemonic( insn, REC_PTR(rec, rec->mnemonic) );
+	}
+	if ( rec->comment ) {
+		fill_comment( insn, REC_PTR(rec, rec->comment) );
+	}
+
+	ops = REC_OPS(rec);
+	for ( i = 0; i < rec->num_operands; i++ ) {
+		opdis_op_t * op = NULL;
+
+		if ( insn->num_operands < insn->alloc_operands &&
+		     insn->operands[insn->num_operands] ) {
+			/* re-use operand already allocated in insn */
+			op = opdis_insn_next_avail_op( insn );
+		} else if (! insn->fixed_size ) {
+			op = opdis_op_alloc();
+			if ( op && ! opdis_insn_add_operand( insn, op ) ) {
+				opdis_op_free( op );
+				op = NULL;
+			}
+		}
+
+		if (! op ) {
+			return 0;
+		}
+
+		memcpy( &op->value, &ops[i].value, sizeof(op->value) );
+		op->category = (enum opdis_op_cat_t) ops[i].category;
+		op->flags = (enum opdis_op_flag_t) ops[i].flags;
+		op->data_size = ops[i].data_size;
+		if ( ops[i].ascii ) {
+			opdis_op_set_ascii( op, REC_PTR(rec, ops[i].ascii) );
+		}
+	}
+
+	if ( rec->target >= 0 && rec->target < insn->num_operands ) {
+		insn->target = insn->operands[(int) rec->target];
+	}
+	if ( rec->dest >= 0 && rec->dest < insn->num_operands ) {
+		insn->dest = insn->operands[(int) rec->dest];
+	}
+	if ( rec->src >= 0 && rec->src < insn->num_operands ) {
+		insn->src = insn->operands[(int) rec->src];
+	}
+
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* ACCESSORS */
+
+const opdis_byte_t * LIBCALL opdis_insn_rec_bytes(const opdis_insn_rec_t * rec){
+	return ( rec ) ? (const opdis_byte_t *) REC_PTR(rec, rec->bytes) : NULL;
+}
+
+const char * LIBCALL opdis_insn_rec_ascii( const opdis_insn_rec_t * rec ) {
+	return ( rec && rec->ascii ) ? REC_PTR(rec, rec->ascii) : NULL;
+}
+
+const char * LIBCALL opdis_insn_rec_mnemonic( const opdis_insn_rec_t * rec ) {
+	return ( rec && rec->mnemonic ) ? REC_PTR(rec, rec->mnemonic) : NULL;
+}
+
+const char * LIBCALL opdis_insn_rec_prefixes( const opdis_insn_rec_t * rec ) {
+	return ( rec && rec->prefixes ) ? REC_PTR(rec, rec->prefixes) : NULL;
+}
+
+const char * LIBCALL opdis_insn_rec_comment( const opdis_insn_rec_t * rec ) {
+	return ( rec && rec->comment ) ? REC_PTR(rec, rec->comment) : NULL;
+}
+
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_op( const opdis_insn_rec_t * rec,
+						  int idx ) {
+	if (! rec || idx < 0 || idx >= rec->num_operands ) {
+		return NULL;
+	}
+
+	return &REC_OPS(rec)[idx];
+}
+
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_target(
+						const opdis_insn_rec_t * rec ) {
+	return ( rec ) ? opdis_insn_rec_op( rec, rec->target ) : NULL;
+}
+
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_dest(
+						const opdis_insn_rec_t * rec ) {
+	return ( rec ) ? opdis_insn_rec_op( rec, rec->dest ) : NULL;
+}
+
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_src(
+						const opdis_insn_rec_t * rec ) {
+	return ( rec ) ? opdis_insn_rec_op( rec, rec->src ) : NULL;
+}
+
+const char * LIBCALL opdis_op_rec_ascii( const opdis_insn_rec_t * rec,
+					 const opdis_op_rec_t * op ) {
+	return ( rec && op && op->ascii ) ? REC_PTR(rec, op->ascii) : NULL;
+}
+
+const opdis_insn_rec_t * LIBCALL opdis_insn_rec_next(
+						const opdis_insn_rec_t * rec ) {
+	return ( rec ) ? (const opdis_insn_rec_t *) REC_PTR(rec, rec->rec_size)
+		       : NULL;
+}
@@ -0,0 +1,318 @@
+/*!
+ * \file insn_rec.h
+ * \brief Packed, relocatable instruction records.
+ * \details An opdis_insn_rec_t stores an instruction in a single contiguous
+ *          block of memory: a fixed-size header followed by a variable-length
+ *          tail containing the operands, the instruction bytes, and the
+ *          instruction strings. All references within a record are offsets
+ *          from the start of the record, so a record can be copied with
+ *          memcpy, written to disk, or stored back-to-back with other
+ *          records in a large buffer.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_INSN_REC_H
+#define OPDIS_INSN_REC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <opdis/model.h>
+#include <opdis/arena.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_INSN_REC_NO_OP
+ * \ingroup model
+ * \brief Operand index used for an absent target, dest or src operand.
+ */
+#define OPDIS_INSN_REC_NO_OP -1
+
+/*!
+ * \union opdis_op_rec_value_t
+ * \ingroup model
+ * \brief The value of a packed operand.
+ * \note This has the same layout as the \e value field of opdis_op_t.
+ */
+typedef union {
+	opdis_reg_t reg;		/*!< Register value */
+	opdis_addr_expr_t expr;		/*!< Address expression value */
+	opdis_abs_addr_t abs;		/*!< Absolute address value */
+	union {
+		opdis_vma_t vma;	/*!< Virtual memory address */
+		uint64_t u;		/*!< Unsigned immediate value */
+		int64_t s;		/*!< Signed immediate value */
+	} immediate;			/*!< Immediate value */
+} opdis_op_rec_value_t;
+
+/*!
+ * \struct opdis_op_rec_t
+ * \ingroup model
+ * \brief A packed operand.
+ * \details Packed operands are stored in an array immediately following
+ *          the opdis_insn_rec_t header.
+ */
+typedef struct {
+	opdis_op_rec_value_t value;	/*!< Value of operand */
+	uint32_t	ascii;		/*!< Offset of operand string, or 0 */
+	uint8_t		category;	/*!< enum opdis_op_cat_t */
+	uint8_t		flags;		/*!< enum opdis_op_flag_t */
+	uint8_t		data_size;	/*!< Size of operand datatype */
+	uint8_t		reserved;
+} opdis_op_rec_t;
+
+/*!
+ * \struct opdis_insn_rec_t
+ * \ingroup model
+ * \brief A packed instruction.
+ * \details The header of a packed instruction. The operand array, the
+ *          instruction bytes, and the strings follow the header; the
+ *          total size of the record (always a multiple of 8) is stored in
+ *          \e rec_size. String offsets are relative to the start of the
+ *          record; an offset of 0 indicates a NULL string.
+ * \note The accessor functions below should be used to read the tail of a
+ *       record.
+ */
+typedef struct {
+	uint32_t	rec_size;	/*!< Size of record including tail */
+	uint16_t	num_operands;	/*!< Number of operands in insn */
+	uint16_t	num_prefixes;	/*!< Number of prefixes in insn */
+	uint64_t	offset;		/*!< Offset of instruction in buffer */
+	uint64_t	vma;		/*!< Virtual memory address of insn */
+	uint32_t	size;		/*!< Size (# bytes) of insn */
+	uint8_t		status;		/*!< enum opdis_insn_decode_t */
+	uint8_t		category;	/*!< enum opdis_insn_cat_t */
+	uint8_t		isa;		/*!< enum opdis_insn_subset_t */
+	int8_t		target;		/*!< Index of branch target operand */
+	int8_t		dest;		/*!< Index of destination operand */
+	int8_t		src;		/*!< Index of source operand */
+	uint16_t	flags;		/*!< Instruction-specific flags */
+	uint32_t	bytes;		/*!< Offset of instruction bytes */
+	uint32_t	ascii;		/*!< Offset of insn string, or 0 */
+	uint32_t	prefixes;	/*!< Offset of prefixes string, or 0 */
+	uint32_t	mnemonic;	/*!< Offset of mnemonic string, or 0 */
+	uint32_t	comment;	/*!< Offset of comment string, or 0 */
+} opdis_insn_rec_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* ---------------------------------------------------------------------- */
+/* CONVERSION */
+
+/*!
+ * \fn size_t opdis_insn_rec_size( const opdis_insn_t * )
+ * \ingroup model
+ * \brief Return the size of the packed record for an instruction.
+ * \param insn The instruction.
+ * \return The number of bytes required to pack \e insn, or 0 on error.
+ */
+size_t LIBCALL opdis_insn_rec_size( const opdis_insn_t * insn );
+
+/*!
+ * \fn size_t opdis_insn_pack( const opdis_insn_t *, void *, size_t )
+ * \ingroup model
+ * \brief Pack an instruction into a buffer.
+ * \param insn The instruction to pack.
+ * \param buf The buffer to pack the instruction into.
+ * \param buf_len The size of the buffer.
+ * \return The number of bytes written to \e buf, or 0 if \e buf is too small.
+ * \note \e buf must be aligned to 8 bytes. Since record sizes are multiples
+ *       of 8, records packed back-to-back remain aligned.
+ */
+size_t LIBCALL opdis_insn_pack( const opdis_insn_t * insn, void * buf,
+				size_t buf_len );
+
+/*!
+ * \fn opdis_insn_rec_t * opdis_insn_rec_alloc( const opdis_insn_t * )
+ * \ingroup model
+ * \brief Allocate a packed record for an instruction.
+ * \param insn The instruction to pack.
+ * \return The packed record.
+ * \sa opdis_insn_rec_free
+ */
+opdis_insn_rec_t * LIBCALL opdis_insn_rec_alloc( const opdis_insn_t * insn );
+
+/*!
+ * \fn opdis_insn_rec_t * opdis_insn_rec_arena( const opdis_insn_t *,
+ * 					       opdis_arena_t )
+ * \ingroup model
+ * \brief Pack an instruction into an arena.
+ * \param insn The instruction to pack.
+ * \param arena The arena to allocate the record from.
+ * \return The packed record.
+ * \note The record is freed when the arena is freed.
+ */
+opdis_insn_rec_t * LIBCALL opdis_insn_rec_arena( const opdis_insn_t * insn,
+						 opdis_arena_t arena );
+
+/*!
+ * \fn opdis_insn_rec_t * opdis_insn_rec_dupe( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Duplicate a packed record.
+ * \param rec The record to duplicate.
+ * \return The allocated copy.
+ */
+opdis_insn_rec_t * LIBCALL opdis_insn_rec_dupe( const opdis_insn_rec_t * rec);
+
+/*!
+ * \fn void opdis_insn_rec_free( opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Free a packed record allocated by opdis_insn_rec_alloc.
+ * \param rec The record.
+ */
+void LIBCALL opdis_insn_rec_free( opdis_insn_rec_t * rec );
+
+/*!
+ * \fn opdis_insn_t * opdis_insn_unpack( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Allocate an instruction object from a packed record.
+ * \param rec The packed record.
+ * \return The allocated instruction.
+ * \sa opdis_insn_free
+ */
+opdis_insn_t * LIBCALL opdis_insn_unpack( const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn int opdis_insn_rec_fill( const opdis_insn_rec_t *, opdis_insn_t * )
+ * \ingroup model
+ * \brief Fill an existing instruction object from a packed record.
+ * \param rec The packed record.
+ * \param insn The instruction to fill.
+ * \return 1 on success, 0 on failure.
+ * \details \e insn is cleared before it is filled. This works for both
+ *          dynamically allocated and fixed-size instructions; in a
+ *          fixed-size instruction, strings are truncated to the field
+ *          sizes, and 0 is returned if the record has more operands than
+ *          have been allocated. If \e borrow_bytes is set in \e insn,
+ *          its \e bytes field points into \e rec.
+ */
+int LIBCALL opdis_insn_rec_fill( const opdis_insn_rec_t * rec,
+				 opdis_insn_t * insn );
+
+/* ---------------------------------------------------------------------- */
+/* ACCESSORS */
+
+/*!
+ * \fn const opdis_byte_t * opdis_insn_rec_bytes( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the bytes of a packed instruction.
+ * \param rec The packed record.
+ */
+const opdis_byte_t * LIBCALL opdis_insn_rec_bytes(const opdis_insn_rec_t * rec);
+
+/*!
+ * \fn const char * opdis_insn_rec_ascii( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the string representation of a packed instruction.
+ * \param rec The packed record.
+ * \return The string, or NULL.
+ */
+const char * LIBCALL opdis_insn_rec_ascii( const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const char * opdis_insn_rec_mnemonic( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the mnemonic of a packed instruction.
+ * \param rec The packed record.
+ * \return The string, or NULL.
+ */
+const char * LIBCALL opdis_insn_rec_mnemonic( const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const char * opdis_insn_rec_prefixes( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the space-delimited prefixes of a packed instruction.
+ * \param rec The packed record.
+ * \return The string, or NULL.
+ */
+const char * LIBCALL opdis_insn_rec_prefixes( const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const char * opdis_insn_rec_comment( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the comment of a packed instruction.
+ * \param rec The packed record.
+ * \return The string, or NULL.
+ */
+const char * LIBCALL opdis_insn_rec_comment( const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const opdis_op_rec_t * opdis_insn_rec_op( const opdis_insn_rec_t *,
+ * 						 int )
+ * \ingroup model
+ * \brief Return an operand of a packed instruction.
+ * \param rec The packed record.
+ * \param idx The index of the operand.
+ * \return The operand, or NULL if \e idx is out of range.
+ */
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_op( const opdis_insn_rec_t * rec,
+						  int idx );
+
+/*!
+ * \fn const opdis_op_rec_t * opdis_insn_rec_target(const opdis_insn_rec_t *)
+ * \ingroup model
+ * \brief Return the branch target operand of a packed instruction.
+ * \param rec The packed record.
+ * \return The operand, or NULL.
+ */
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_target(
+						const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const opdis_op_rec_t * opdis_insn_rec_dest( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the destination operand of a packed instruction.
+ * \param rec The packed record.
+ * \return The operand, or NULL.
+ */
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_dest(
+						const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const opdis_op_rec_t * opdis_insn_rec_src( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the source operand of a packed instruction.
+ * \param rec The packed record.
+ * \return The operand, or NULL.
+ */
+const opdis_op_rec_t * LIBCALL opdis_insn_rec_src(
+						const opdis_insn_rec_t * rec );
+
+/*!
+ * \fn const char * opdis_op_rec_ascii( const opdis_insn_rec_t *,
+ * 				       const opdis_op_rec_t * )
+ * \ingroup model
+ * \brief Return the string representation of a packed operand.
+ * \param rec The packed record containing the operand.
+ * \param op The operand.
+ * \return The string, or NULL.
+ */
+const char * LIBCALL opdis_op_rec_ascii( const opdis_insn_rec_t * rec,
+					 const opdis_op_rec_t * op );
+
+/*!
+ * \fn const opdis_insn_rec_t * opdis_insn_rec_next( const opdis_insn_rec_t * )
+ * \ingroup model
+ * \brief Return the record following \e rec in a buffer of packed records.
+ * \param rec The packed record.
+ * \note The caller must check that the result is within the buffer.
+ */
+const opdis_insn_rec_t * LIBCALL opdis_insn_rec_next(
+						const opdis_insn_rec_t * rec );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
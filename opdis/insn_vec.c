@@ -0,0 +1,248 @@
+/*!
+ * \file insn_vec.c
+ * \brief Instruction Vector implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/insn_vec.h>
+
+#define VEC_MIN_ALLOC 256
+
+opdis_insn_vec_t LIBCALL opdis_insn_vec_init( int manage ) {
+	opdis_insn_vec_t v = (opdis_insn_vec_t) calloc( 1,
+						sizeof(opdis_insn_vec_base_t) );
+	if ( v ) {
+		v->manage = manage;
+	}
+
+	return v;
+}
+
+int LIBCALL opdis_insn_vec_add( opdis_insn_vec_t v, opdis_insn_t * insn ) {
+	if (! v || ! insn ) {
+		return 0;
+	}
+
+	if ( v->num && v->items[v->num - 1]->vma == insn->vma ) {
+		return 0;
+	}
+
+	if ( v->num == v->alloc ) {
+		size_t alloc = ( v->alloc ) ? v->alloc * 2 : VEC_MIN_ALLOC;
+		void * ptr = realloc( v->items, alloc * sizeof(opdis_insn_t *) );
+		if (! ptr ) {
+			return 0;
+		}
+		v->items = (opdis_insn_t **) ptr;
+		v->alloc = alloc;
+	}
+
+	v->items[v->num] = insn;
+	v->num++;
+
+	/* vector remains sorted as long as insns are appended in order */
+	if ( v->sorted == v->num - 1 &&
+	     ( v->sorted == 0 || v->items[v->sorted - 1]->vma < insn->vma ) ) {
+		v->sorted = v->num;
+	}
+
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SORTING */
+
+/* stable merge of a[0..n) and b[0..m) into out */
+static void merge( opdis_insn_t ** a, size_t n, opdis_insn_t ** b, size_t m,
+		   opdis_insn_t ** out ) {
+	size_t i = 0, j = 0, k = 0;
+
+	while ( i < n && j < m ) {
+		/* <= keeps the earlier (left) item first for equal VMAs */
+		if ( a[i]->vma <= b[j]->vma ) {
+			out[k++] = a[i++];
+		} else {
+			out[k++] = b[j++];
+		}
+	}
+
+	while ( i < n ) {
+		out[k++] = a[i++];
+	}
+	while ( j < m ) {
+		out[k++] = b[j++];
+	}
+}
+
+/* bottom-up stable merge sort of items[0..n) using tmp as scratch */
+static void merge_sort( opdis_insn_t ** items, size_t n, opdis_insn_t ** tmp ){
+	opdis_insn_t ** src = items, ** dest = tmp, ** swap;
+	size_t width, i;
+
+	for ( width = 1; width < n; width *= 2 ) {
+		for ( i = 0; i < n; i += 2 * width ) {
+			size_t left = ( i + width < n ) ? width : n - i;
+			size_t right = ( i + 2 * width < n ) ? width :
+						n - i - left;
+			merge( &src[i], left, &src[i + left], right, &dest[i] );
+		}
+		swap = src; src = dest; dest = swap;
+	}
+
+	if ( src != items ) {
+		memcpy( items, src, n * sizeof(opdis_insn_t *) );
+	}
+}
+
+void LIBCALL opdis_insn_vec_finalize( opdis_insn_vec_t v ) {
+	opdis_insn_t ** tmp;
+	size_t i, num;
+
+	if (! v || v->sorted == v->num ) {
+		return;
+	}
+
+	tmp = (opdis_insn_t **) malloc( v->num * sizeof(opdis_insn_t *) );
+	if (! tmp ) {
+		return;
+	}
+
+	/* sort the unsorted tail, then merge it with the sorted prefix */
+	merge_sort( &v->items[v->sorted], v->num - v->sorted, tmp );
+	merge( v->items, v->sorted, &v->items[v->sorted], v->num - v->sorted,
+	       tmp );
+
+	/* remove duplicates, keeping the first-added instruction */
+	for ( i = 0, num = 0; i < v->num; i++ ) {
+		if ( num && tmp[i]->vma == v->items[num - 1]->vma ) {
+			if ( v->manage ) {
+				opdis_insn_free( tmp[i] );
+			}
+			continue;
+		}
+		v->items[num++] = tmp[i];
+	}
+
+	free( tmp );
+	v->num = v->sorted = num;
+}
+
+/* ---------------------------------------------------------------------- */
+/* LOOKUP */
+
+/* index of first item with vma >= addr */
+static size_t lower_bound( opdis_insn_vec_t v, opdis_vma_t addr ) {
+	size_t lo = 0, hi = v->num;
+
+	while ( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		if ( v->items[mid]->vma < addr ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+int LIBCALL opdis_insn_vec_contains( opdis_insn_vec_t v, opdis_vma_t addr ) {
+	return ( opdis_insn_vec_find( v, addr ) != NULL );
+}
+
+opdis_insn_t * LIBCALL opdis_insn_vec_find( opdis_insn_vec_t v,
+					    opdis_vma_t addr ) {
+	size_t idx;
+
+	if (! v ) {
+		return NULL;
+	}
+
+	opdis_insn_vec_finalize( v );
+	idx = lower_bound( v, addr );
+	if ( idx < v->num && v->items[idx]->vma == addr ) {
+		return v->items[idx];
+	}
+
+	return NULL;
+}
+
+opdis_insn_t * LIBCALL opdis_insn_vec_closest( opdis_insn_vec_t v,
+					       opdis_vma_t addr ) {
+	size_t idx;
+
+	if (! v ) {
+		return NULL;
+	}
+
+	opdis_insn_vec_finalize( v );
+	idx = lower_bound( v, addr );
+	if ( idx < v->num && v->items[idx]->vma == addr ) {
+		return v->items[idx];
+	}
+
+	return ( idx ) ? v->items[idx - 1] : NULL;
+}
+
+opdis_insn_t * LIBCALL opdis_insn_vec_next( opdis_insn_vec_t v,
+					    opdis_vma_t addr ) {
+	size_t idx;
+
+	if (! v ) {
+		return NULL;
+	}
+
+	opdis_insn_vec_finalize( v );
+	idx = lower_bound( v, addr );
+	if ( idx < v->num && v->items[idx]->vma == addr ) {
+		idx++;
+	}
+
+	return ( idx < v->num ) ? v->items[idx] : NULL;
+}
+
+void LIBCALL opdis_insn_vec_foreach( opdis_insn_vec_t v,
+				     OPDIS_INSN_TREE_FOREACH_FN fn, void * arg ){
+	size_t i;
+
+	if (! v || ! fn ) {
+		return;
+	}
+
+	opdis_insn_vec_finalize( v );
+	for ( i = 0; i < v->num; i++ ) {
+		if (! fn( v->items[i], arg ) ) {
+			break;
+		}
+	}
+}
+
+size_t LIBCALL opdis_insn_vec_count( opdis_insn_vec_t v ) {
+	return ( v ) ? v->num : 0;
+}
+
+void LIBCALL opdis_insn_vec_free( opdis_insn_vec_t v ) {
+	size_t i;
+
+	if (! v ) {
+		return;
+	}
+
+	if ( v->manage ) {
+		for ( i = 0; i < v->num; i++ ) {
+			opdis_insn_free( v->items[i] );
+		}
+	}
+
+	if ( v->items ) {
+		free( v->items );
+	}
+
+	free( v );
+}
@@ -0,0 +1,174 @@
+/*!
+ * \file insn_vec.h
+ * \brief Sorted, contiguous instruction store.
+ * \details An Instruction Vector is an append-only array of instructions
+ *          which is an alternative to the Instruction Tree when instructions
+ *          are generated in (mostly) ascending VMA order, as they are by a
+ *          linear disassembly. Appending in order is O(1); instructions
+ *          appended out of order are sorted once, by a single stable merge,
+ *          when the vector is finalized. Lookups use binary search.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_INSN_VEC_H
+#define OPDIS_INSN_VEC_H
+
+#include <stddef.h>
+
+#include <opdis/model.h>
+#include <opdis/tree.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*! \struct opdis_insn_vec_base_t
+ *  \ingroup tree
+ *  \brief An Instruction Vector.
+ */
+typedef struct {
+	opdis_insn_t	** items;	/*!< Array of instructions */
+	size_t		num;		/*!< Number of items in array */
+	size_t		alloc;		/*!< Number of allocated items */
+	size_t		sorted;		/*!< Length of sorted prefix of items */
+	int		manage;		/*!< Free instructions on free? */
+} opdis_insn_vec_base_t;
+
+/*! \typedef opdis_insn_vec_base_t * opdis_insn_vec_t
+ *  \ingroup tree
+ *  \brief An Instruction Vector.
+ */
+typedef opdis_insn_vec_base_t * opdis_insn_vec_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn opdis_insn_vec_t opdis_insn_vec_init( int )
+ * \ingroup tree
+ * \brief Allocate an Instruction Vector.
+ * \param manage 1 if vector should free items on deletion; 0 otherwise.
+ * \return The allocated vector.
+ * \sa opdis_insn_vec_free
+ * \note Use 0 for instructions created by opdis_insn_dupe_arena.
+ */
+opdis_insn_vec_t LIBCALL opdis_insn_vec_init( int manage );
+
+/*!
+ * \fn int opdis_insn_vec_add( opdis_insn_vec_t, opdis_insn_t * )
+ * \ingroup tree
+ * \brief Append an instruction to the vector.
+ * \param vec The Instruction Vector.
+ * \param insn The instruction to append.
+ * \return 1 if instruction was added, 0 if instruction exists.
+ * \details Only the last instruction in the vector is checked for a
+ *          duplicate VMA; instructions appended out of order are
+ *          de-duplicated by opdis_insn_vec_finalize, which keeps the
+ *          instruction that was added first.
+ * \note If 0 is returned, the instruction is not stored in the vector and
+ *       remains owned by the caller.
+ */
+int LIBCALL opdis_insn_vec_add( opdis_insn_vec_t vec, opdis_insn_t * insn );
+
+/*!
+ * \fn void opdis_insn_vec_finalize( opdis_insn_vec_t )
+ * \ingroup tree
+ * \brief Sort the vector by VMA and remove duplicate instructions.
+ * \param vec The Instruction Vector.
+ * \note This is invoked automatically by the lookup and foreach functions
+ *       if instructions have been added out of order since the last sort.
+ *       Duplicates are freed if the vector was created with \e manage
+ *       set to 1.
+ */
+void LIBCALL opdis_insn_vec_finalize( opdis_insn_vec_t vec );
+
+/*!
+ * \fn int opdis_insn_vec_contains( opdis_insn_vec_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Determine if an instruction is in the vector.
+ * \param vec The Instruction Vector.
+ * \param addr The address to search for.
+ * \return 1 if the address is in the vector, 0 otherwise.
+ */
+int LIBCALL opdis_insn_vec_contains( opdis_insn_vec_t vec, opdis_vma_t addr );
+
+/*!
+ * \fn opdis_insn_t * opdis_insn_vec_find( opdis_insn_vec_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Find an instruction in the vector.
+ * \param vec The Instruction Vector.
+ * \param addr The address of the instruction.
+ * \return The instruction or NULL.
+ */
+opdis_insn_t * LIBCALL opdis_insn_vec_find( opdis_insn_vec_t vec,
+					    opdis_vma_t addr );
+
+/*!
+ * \fn opdis_insn_t * opdis_insn_vec_closest( opdis_insn_vec_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Find closest instruction to an address.
+ * \param vec The Instruction Vector.
+ * \param addr The address to match.
+ * \return The instruction at \e addr, or the instruction closest to (but
+ *         less than) \e addr, or NULL.
+ * \sa opdis_tree_closest
+ */
+opdis_insn_t * LIBCALL opdis_insn_vec_closest( opdis_insn_vec_t vec,
+					       opdis_vma_t addr );
+
+/*!
+ * \fn opdis_insn_t * opdis_insn_vec_next( opdis_insn_vec_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Find the instruction following an address.
+ * \param vec The Instruction Vector.
+ * \param addr The address to match.
+ * \return The first instruction with a VMA greater than \e addr, or NULL.
+ * \sa opdis_tree_next
+ */
+opdis_insn_t * LIBCALL opdis_insn_vec_next( opdis_insn_vec_t vec,
+					    opdis_vma_t addr );
+
+/*!
+ * \fn void opdis_insn_vec_foreach( opdis_insn_vec_t,
+ * 				    OPDIS_INSN_TREE_FOREACH_FN, void * )
+ * \ingroup tree
+ * \brief Invoke a callback for every instruction in the vector, in VMA order.
+ * \param vec The Instruction Vector.
+ * \param fn The callback to invoke for each instruction.
+ * \param arg An optional argument to pass to the callback function.
+ */
+void LIBCALL opdis_insn_vec_foreach( opdis_insn_vec_t vec,
+				     OPDIS_INSN_TREE_FOREACH_FN fn, void * arg );
+
+/*!
+ * \fn size_t opdis_insn_vec_count( opdis_insn_vec_t )
+ * \ingroup tree
+ * \brief Return the number of instructions in the vector.
+ * \param vec The Instruction Vector.
+ * \note This includes duplicates which have not yet been removed by
+ *       opdis_insn_vec_finalize.
+ */
+size_t LIBCALL opdis_insn_vec_count( opdis_insn_vec_t vec );
+
+/*!
+ * \fn void opdis_insn_vec_free( opdis_insn_vec_t )
+ * \ingroup tree
+ * \brief Free the Instruction Vector.
+ * \param vec The Instruction Vector.
+ * \note The instructions in the vector are freed if the vector was created
+ *       with \e manage set to 1.
+ */
+void LIBCALL opdis_insn_vec_free( opdis_insn_vec_t vec );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -40,6 +40,13 @@ opdis_insn_t * LIBCALL opdis_insn_alloc( opdis_off_t num_operands ) {
 opdis_insn_t * LIBCALL opdis_insn_alloc_fixed( size_t ascii_sz, 
 				size_t mnemonic_sz, size_t num_operands,
 				size_t op_ascii_sz ) {
+	return opdis_insn_alloc_fixed_bytes( 128, ascii_sz, mnemonic_sz,
+					     num_operands, op_ascii_sz );
+}
+
+opdis_insn_t * LIBCALL opdis_insn_alloc_fixed_bytes( size_t bytes_sz,
+				size_t ascii_sz, size_t mnemonic_sz,
+				size_t num_operands, size_t op_ascii_sz ) {
 	int i;
 
 	opdis_insn_t * insn = opdis_insn_alloc( num_operands );
@@ -47,14 +54,20 @@ opdis_insn_t * LIBCALL opdis_insn_alloc_fixed( size_t ascii_sz,
 		return NULL;
 	}
 
-	insn->bytes = calloc( 1, 128 );	/* plenty */
+	if ( bytes_sz ) {
+		insn->bytes = calloc( 1, bytes_sz );
+		if (! insn->bytes ) {
+			opdis_insn_free( insn );
+			return NULL;
+		}
+	}
 	insn->ascii = calloc( 1, ascii_sz );
 	insn->prefixes = calloc( 1, PREFIX_SIZE(mnemonic_sz) );
 	insn->mnemonic = calloc( 1, mnemonic_sz );
 	insn->comment = calloc( 1, ascii_sz );
 
 	if (! insn->ascii || ! insn->prefixes || ! insn->mnemonic ||
-	    ! insn->prefixes || ! insn->comment || ! insn->bytes ) {
+	    ! insn->prefixes || ! insn->comment ) {
 		opdis_insn_free( insn );
 		return NULL;
 	}
@@ -72,6 +85,7 @@ opdis_insn_t * LIBCALL opdis_insn_alloc_fixed( size_t ascii_sz,
 	insn->fixed_size = 1;
 	insn->ascii_sz = ascii_sz;
 	insn->mnemonic_sz = mnemonic_sz;
+	insn->bytes_sz = bytes_sz;
 
 	return insn;
 }
@@ -104,8 +118,12 @@ opdis_insn_t * LIBCALL opdis_insn_dupe( const opdis_insn_t * insn ) {
 	new_insn->ascii = NULL;
 	new_insn->mnemonic = NULL;
 	new_insn->prefixes = NULL;
+	new_insn->comment = NULL;
 	new_insn->operands = new_operands;
+	/* the source may be a fixed insn with spare operands allocated */
+	new_insn->alloc_operands = insn->num_operands;
 	new_insn->fixed_size = new_insn->ascii_sz = new_insn->mnemonic_sz = 0;
+	new_insn->bytes_sz = new_insn->borrow_bytes = 0;
 
 	new_insn->bytes = calloc( 1, insn->size );
 	if (! new_insn->bytes ) {
@@ -176,6 +194,100 @@ opdis_insn_t * LIBCALL opdis_insn_dupe( const opdis_insn_t * insn ) {
 	return new_insn;
 }
 
+/* arena copy of a string field; sets *err if the copy failed */
+static char * arena_str( opdis_arena_t arena, const char * str, int * err ) {
+	char * s;
+
+	if (! str ) {
+		return NULL;
+	}
+
+	s = opdis_arena_strdup( arena, str );
+	if (! s ) {
+		*err = 1;
+	}
+
+	return s;
+}
+
+opdis_insn_t * LIBCALL opdis_insn_dupe_arena( const opdis_insn_t * insn,
+					      opdis_arena_t arena ) {
+	int i, err = 0;
+	opdis_insn_t * new_insn;
+	opdis_op_t * ops = NULL;
+
+	if (! insn || ! arena ) {
+		return NULL;
+	}
+
+	new_insn = (opdis_insn_t *) opdis_arena_alloc( arena, 
+							sizeof(opdis_insn_t) );
+	if (! new_insn ) {
+		return NULL;
+	}
+
+	memcpy( new_insn, insn, sizeof(opdis_insn_t) );
+	new_insn->fixed_size = new_insn->ascii_sz = new_insn->mnemonic_sz = 0;
+	new_insn->bytes_sz = new_insn->borrow_bytes = 0;
+
+	new_insn->bytes = opdis_arena_alloc( arena, insn->size );
+	if (! new_insn->bytes ) {
+		return NULL;
+	}
+	if ( insn->bytes ) {
+		memcpy( new_insn->bytes, insn->bytes, insn->size );
+	}
+
+	new_insn->ascii = arena_str( arena, insn->ascii, &err );
+	new_insn->prefixes = arena_str( arena, insn->prefixes, &err );
+	new_insn->mnemonic = arena_str( arena, insn->mnemonic, &err );
+	new_insn->comment = arena_str( arena, insn->comment, &err );
+
+	new_insn->operands = NULL;
+	new_insn->alloc_operands = insn->num_operands;
+	if ( insn->num_operands ) {
+		new_insn->operands = (opdis_op_t **) opdis_arena_alloc( arena,
+				insn->num_operands * sizeof(opdis_op_t *) );
+		ops = (opdis_op_t *) opdis_arena_alloc( arena,
+				insn->num_operands * sizeof(opdis_op_t) );
+		if (! new_insn->operands || ! ops ) {
+			return NULL;
+		}
+	}
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		opdis_op_t * op = &ops[i];
+		memcpy( op, insn->operands[i], sizeof(opdis_op_t) );
+		op->fixed_size = op->ascii_sz = 0;
+		op->ascii = arena_str( arena, insn->operands[i]->ascii, &err );
+		new_insn->operands[i] = op;
+	}
+
+	if ( err ) {
+		return NULL;
+	}
+
+	new_insn->target = new_insn->dest = new_insn->src = NULL;
+	if (! insn->num_operands ) {
+		return new_insn;
+	}
+
+	if ( insn->target ) {
+		new_insn->target = new_insn->operands[idx_for_op(insn, 
+						      insn->target)    ];
+	}
+	if ( insn->dest ) {
+		new_insn->dest = new_insn->operands[idx_for_op(insn, 
+						    insn->dest)    ];
+	}
+	if ( insn->src ) {
+		new_insn->src = new_insn->operands[idx_for_op(insn, 
+						   insn->src)      ];
+	}
+
+	return new_insn;
+}
+
 void LIBCALL opdis_insn_clear( opdis_insn_t * insn ) {
 	int i;
 	if ( insn ) {
@@ -195,13 +307,13 @@ void LIBCALL opdis_insn_clear( opdis_insn_t * insn ) {
 	}
 }
 
-void LIBCALL opdis_insn_free( opdis_insn_t * insn ) {
+void LIBCALL opdis_insn_free_members( opdis_insn_t * insn ) {
 	int i; 
 	if (! insn ) {
 		return;
 	}
 
-	if ( insn->bytes ) {
+	if ( insn->bytes && ! insn->borrow_bytes ) {
 		free( (void *) insn->bytes);
 	}
 
@@ -231,7 +343,10 @@ void LIBCALL opdis_insn_free( opdis_insn_t * insn ) {
 	if ( insn->operands ) {
 		free( (void *) insn->operands);
 	}
+}
 
+void LIBCALL opdis_insn_free( opdis_insn_t * insn ) {
+	opdis_insn_free_members( insn );
 	free(insn);
 }
 
@@ -269,6 +384,35 @@ void LIBCALL opdis_insn_set_mnemonic( opdis_insn_t * i, const char * mnemonic ){
 	i->mnemonic = strdup(mnemonic);
 }
 
+int LIBCALL opdis_insn_set_bytes( opdis_insn_t * i, const opdis_byte_t * bytes,
+				  opdis_off_t size ) {
+	void * p;
+
+	if (! i || ! bytes ) {
+		return 0;
+	}
+
+	if ( i->borrow_bytes ) {
+		/* the source outlives the insn: no copy */
+		i->bytes = (opdis_byte_t *) bytes;
+		return 1;
+	}
+
+	if (! i->fixed_size || size > i->bytes_sz ) {
+		p = realloc( i->bytes, ( size ) ? size : 1 );
+		if (! p ) {
+			return 0;
+		}
+		i->bytes = (opdis_byte_t *) p;
+		if ( i->fixed_size ) {
+			i->bytes_sz = ( size < 255 ) ? size : 255;
+		}
+	}
+
+	memcpy( i->bytes, bytes, size );
+	return 1;
+}
+
 void LIBCALL opdis_insn_add_prefix( opdis_insn_t * i, const char * prefix ){
 	if (! i || ! prefix ) {
 		return;
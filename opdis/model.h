@@ -11,6 +11,7 @@
 #ifndef OPDIS_MODEL_H
 #define OPDIS_MODEL_H
 
+#include <opdis/arena.h>
 #include <opdis/metadata.h>
 #include <opdis/types.h>
 
@@ -34,6 +35,25 @@ enum opdis_insn_decode_t {
 	opdis_decode_op_flags = 16	/*!< operand category, flags decoded */
 };
 
+/*! 
+ * \def OPDIS_DECODE_ALL
+ * Decode mask requesting every level of decoding. This is the default.
+ * \sa opdis_set_decode_mask
+ */
+#define OPDIS_DECODE_ALL ( opdis_decode_basic | opdis_decode_mnem | \
+			   opdis_decode_ops | opdis_decode_mnem_flags | \
+			   opdis_decode_op_flags )
+
+/*! 
+ * \def OPDIS_DECODE_CFLOW
+ * Decode mask requesting what control flow disassembly needs: the mnemonic,
+ * insn category and flags, and the operand list. Of the operands, only the
+ * branch target is decoded.
+ * \sa opdis_set_decode_mask
+ */
+#define OPDIS_DECODE_CFLOW ( opdis_decode_basic | opdis_decode_mnem | \
+			     opdis_decode_ops | opdis_decode_mnem_flags )
+
 /* ---------------------------------------------------------------------- */
 /* OPERAND */
 
@@ -183,6 +203,10 @@ typedef struct {
  *       opdis_insn_alloc_fixed, \e num_operands will contain the number of
  *       operands in the instruction, and \e alloc_operands will contain the
  *       number of fixed_size operands that have been allocated.
+ * \note If \e borrow_bytes is set, \e bytes is not owned by the instruction:
+ *       it points into the buffer the instruction was disassembled from,
+ *       and is only valid as long as that buffer is. opdis_insn_dupe
+ *       copies the bytes into the new instruction.
  * \sa opdis_op_t
  */
 typedef struct {
@@ -225,6 +249,11 @@ typedef struct {
 	unsigned char fixed_size;	/*!< Is insn of a fixed size? 0 or 1 */
 	unsigned char ascii_sz;		/*!< Size of fixed ascii field */
 	unsigned char mnemonic_sz;	/*!< Size of fixed mnemonic field */
+	unsigned char bytes_sz;		/*!< Size of fixed bytes field */
+
+	/* borrowed bytes */
+	unsigned char borrow_bytes;	/*!< Does bytes point into the source
+					     buffer? 0 or 1 */
 
 } opdis_insn_t;
 
@@ -271,6 +300,29 @@ opdis_insn_t * LIBCALL opdis_insn_alloc_fixed( size_t ascii_sz,
 				size_t mnemonic_sz, size_t num_operands,
 				size_t op_ascii_sz );
 
+/*!
+ * \fn opdis_insn_t * opdis_insn_alloc_fixed_bytes( size_t, size_t, size_t, size_t, size_t )
+ * \ingroup model
+ * \brief Allocate a fixed-size instruction object with a \e bytes field of
+ *        the specified size.
+ * \details This is opdis_insn_alloc_fixed with the size of the \e bytes
+ *          field as a parameter; opdis_insn_alloc_fixed uses 128 bytes.
+ * \param bytes_sz Maximum size of an instruction, or 0 to not allocate
+ *                 \e bytes. This must be less than 256.
+ * \param ascii_sz
+ * \param mnemonic_sz
+ * \param num_operands
+ * \param op_ascii_sz
+ * \return The allocated instruction.
+ * \sa opdis_insn_alloc_fixed
+ * \sa opdis_insn_sizes
+ * \note An instruction without a \e bytes field is intended for use with
+ *       \e borrow_bytes.
+ */
+opdis_insn_t * LIBCALL opdis_insn_alloc_fixed_bytes( size_t bytes_sz,
+				size_t ascii_sz, size_t mnemonic_sz,
+				size_t num_operands, size_t op_ascii_sz );
+
 /*!
  * \fn opdis_insn_t * opdis_insn_dupe( const opdis_insn_t * )
  * \ingroup model
@@ -286,6 +338,24 @@ opdis_insn_t * LIBCALL opdis_insn_alloc_fixed( size_t ascii_sz,
  */
 opdis_insn_t * LIBCALL opdis_insn_dupe( const opdis_insn_t * i );
 
+/*!
+ * \fn opdis_insn_t * opdis_insn_dupe_arena( const opdis_insn_t *, 
+ * 					    opdis_arena_t )
+ * \ingroup model
+ * \brief Duplicate an instruction object into an arena
+ * \details This is identical to opdis_insn_dupe, except that the instruction,
+ *          its strings and its operands are all allocated from \e arena.
+ *          The operands are stored in a single contiguous array.
+ * \param i The instruction to duplicate.
+ * \param arena The arena to allocate from.
+ * \return The duplicate instruction.
+ * \sa opdis_insn_tree_init_arena
+ * \note The duplicate must not be passed to opdis_insn_free; it is released
+ *       when the arena is freed.
+ */
+opdis_insn_t * LIBCALL opdis_insn_dupe_arena( const opdis_insn_t * i,
+					      opdis_arena_t arena );
+
 /*!
  * \fn void opdis_insn_clear( opdis_insn_t * )
  * \ingroup model
@@ -304,6 +374,17 @@ void LIBCALL opdis_insn_clear( opdis_insn_t * i );
  */
 void LIBCALL opdis_insn_free( opdis_insn_t * i );
 
+/*!
+ * \fn void opdis_insn_free_members( opdis_insn_t * )
+ * \ingroup internal
+ * \brief Free the contents of an instruction object, but not the object.
+ * \param i The instruction whose contents are freed.
+ * \details This is for instructions which are not allocated on their own,
+ *          e.g. elements of an array of instructions.
+ * \sa opdis_insn_free
+ */
+void LIBCALL opdis_insn_free_members( opdis_insn_t * i );
+
 /*!
  * \fn void opdis_insn_set_ascii( opdis_insn_t *, const char * )
  * \ingroup model
@@ -330,6 +411,22 @@ void LIBCALL opdis_insn_set_ascii( opdis_insn_t * i, const char * ascii );
  */
 void LIBCALL opdis_insn_set_mnemonic( opdis_insn_t * i, const char * mnemonic );
 
+/*!
+ * \fn int opdis_insn_set_bytes( opdis_insn_t *, const opdis_byte_t *, opdis_off_t )
+ * \ingroup model
+ * \brief Set the \e bytes field of an instruction.
+ * \details This copies \e size bytes into the \e bytes field of \e i,
+ *          which is reallocated if it is too small. If \e borrow_bytes is
+ *          set, nothing is copied: \e bytes is set to point to \e bytes.
+ * \param i The instruction to modify.
+ * \param bytes The instruction bytes.
+ * \param size The number of bytes in \e bytes.
+ * \return 1 on success, 0 on failure.
+ * \note This does not set the \e size field of \e i.
+ */
+int LIBCALL opdis_insn_set_bytes( opdis_insn_t * i, const opdis_byte_t * bytes,
+				  opdis_off_t size );
+
 /*!
  * a
  * a
@@ -11,8 +11,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 #include <opdis/opdis.h>
+#include <opdis/insn_rec.h>
 #include <opdis/x86_decoder.h>
+#include <opdis/x86_length.h>
+#include <opdis/x86_native.h>
 
 void opdis_debug( opdis_t o, int min_level, const char * format, ... ) {
 	if (  o->debug >= min_level ) {
@@ -30,21 +37,26 @@ void opdis_debug( opdis_t o, int min_level, const char * format, ... ) {
 /* ---------------------------------------------------------------------- */
 /* Default callbacks */
 
-int opdis_default_handler( const opdis_insn_t * insn, void * arg ) {
-	opdis_t o = (opdis_t) arg;
-
+static int default_handler( const opdis_insn_t * insn, 
+			    opdis_visited_t visited ) {
 	if ( insn->status == opdis_decode_invalid ) {
 		/* invalid instruction */
 		return 0;
 	}
 
-	if (! o || ! o->visited_addr ) {
+	if (! visited ) {
 		/* visited addresses not being tracked */
 		return 1;
 	}
 
-	/* returns 0 if address already exists in tree */
-	return opdis_vma_tree_add( o->visited_addr, insn->vma );
+	/* returns 0 if address already exists in set */
+	return opdis_visited_add( visited, insn->vma );
+}
+
+int opdis_default_handler( const opdis_insn_t * insn, void * arg ) {
+	opdis_t o = (opdis_t) arg;
+
+	return default_handler( insn, ( o ) ? o->visited_addr : NULL );
 }
 
 void opdis_default_display( const opdis_insn_t * i, void * arg ) {
@@ -94,14 +106,9 @@ int opdis_default_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 			   opdis_vma_t vma, opdis_off_t length, void * arg ) {
 	opdis_insn_set_ascii( out, in->string );
 
-
-	if (! out->bytes ) {
-		out->bytes = calloc(1, length);
-		if (! out->bytes ) {
-			return 0;
-		}
+	if (! opdis_insn_set_bytes( out, &buf[offset], length ) ) {
+		return 0;
 	}
-	memcpy( out->bytes, &buf[offset], length );
 
 	out->size = length;
 	out->offset = offset;
@@ -111,6 +118,21 @@ int opdis_default_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 	return 1;
 }
 
+/* ---------------------------------------------------------------------- */
+/* Statistics */
+
+/* phase timers are only read if the context has a stats object */
+static inline uint64_t stats_start( opdis_ctx_t c ) {
+	return ( c->stats ) ? opdis_stats_clock() : 0;
+}
+
+static inline void stats_end( opdis_ctx_t c, enum opdis_stats_phase_t phase,
+			      uint64_t start ) {
+	if ( c->stats ) {
+		c->stats->ticks[phase] += opdis_stats_clock() - start;
+	}
+}
+
 /* ---------------------------------------------------------------------- */
 /* libopcodes callbacks */
 
@@ -118,15 +140,17 @@ static int build_insn_fprintf( void * stream, const char * format, ... ) {
 	char str[OPDIS_MAX_ITEM_SIZE];
 	int rv;
 	/* hack to get around libopcodes' fprintf-only output */
-	opdis_t o = (opdis_t) stream;
+	opdis_ctx_t c = (opdis_ctx_t) stream;
+	uint64_t start = stats_start( c );
 
 	va_list args;
 	va_start (args, format);
 	rv = vsnprintf( str, OPDIS_MAX_ITEM_SIZE - 1, format, args );
 	va_end (args);
 
-	opdis_insn_buf_append( o->buf, str );
+	opdis_insn_buf_append( c->buf, str );
 
+	stats_end( c, opdis_phase_capture, start );
 	return rv;
 }
 
@@ -135,6 +159,54 @@ static int null_fprintf( void * f, const char * str, ... ) {
 	return 0;
 }
 
+#ifdef HAVE_STRUCT_DISASSEMBLE_INFO_FPRINTF_STYLED_FUNC
+static enum opdis_span_type_t span_type( enum disassembler_style style ) {
+	switch ( style ) {
+		case dis_style_mnemonic:
+		case dis_style_sub_mnemonic:
+			return opdis_span_mnemonic;
+		case dis_style_assembler_directive:
+			return opdis_span_directive;
+		case dis_style_register:
+			return opdis_span_register;
+		case dis_style_immediate:
+			return opdis_span_immediate;
+		case dis_style_address:
+		case dis_style_address_offset:
+			return opdis_span_address;
+		case dis_style_symbol:
+			return opdis_span_symbol;
+		case dis_style_comment_start:
+			return opdis_span_comment;
+		default:
+			return opdis_span_text;
+	}
+}
+
+/* styled output is formatted directly into the insn buffer as spans */
+static int build_insn_fprintf_styled( void * stream, 
+				      enum disassembler_style style,
+				      const char * format, ... ) {
+	opdis_ctx_t c = (opdis_ctx_t) stream;
+	uint64_t start = stats_start( c );
+	int rv;
+
+	va_list args;
+	va_start (args, format);
+	rv = opdis_insn_buf_append_span( c->buf, span_type(style), format, 
+					 args );
+	va_end (args);
+
+	stats_end( c, opdis_phase_capture, start );
+	return rv;
+}
+
+static int null_fprintf_styled( void * f, enum disassembler_style style,
+				const char * str, ... ) {
+	return 0;
+}
+#endif
+
 static void report_memory_error( int status, bfd_vma vma, 
 				 struct disassemble_info * info ) {
 	char msg[48];
@@ -148,6 +220,19 @@ static void report_memory_error( int status, bfd_vma vma,
 	opdis_error( o, opdis_error_bounds, msg );
 }
 
+/* libopcodes fetches insn bytes through this; the end of the bytes it has
+ * read is recorded, as the decode depends on all of them */
+static int read_memory( bfd_vma vma, bfd_byte * buf, unsigned int length,
+			struct disassemble_info * info ) {
+	opdis_ctx_t c = (opdis_ctx_t) info->stream;
+
+	if ( c && vma + length > c->fetched ) {
+		c->fetched = vma + length;
+	}
+
+	return buffer_read_memory( vma, buf, length, info );
+}
+
 /* ---------------------------------------------------------------------- */
 /* OPDIS MGT */
 
@@ -156,9 +241,15 @@ opdis_t LIBCALL opdis_init( void ) {
 	
 	if ( o ) {
 		o->buf = opdis_insn_buf_alloc( 0, 0, 0 );
+#ifdef HAVE_STRUCT_DISASSEMBLE_INFO_FPRINTF_STYLED_FUNC
+		init_disassemble_info ( &o->config, o, build_insn_fprintf,
+					build_insn_fprintf_styled );
+#else
 		init_disassemble_info ( &o->config, o, build_insn_fprintf );
+#endif
 		o->config.application_data = (void *) o;
 		o->config.memory_error_func = report_memory_error;
+		o->config.read_memory_func = read_memory;
 		opdis_set_defaults( o );
 	}
 
@@ -189,6 +280,19 @@ opdis_t LIBCALL opdis_dupe( opdis_t src ) {
 		o->resolver_arg = src->resolver_arg;
 		o->decoder = src->decoder;
 		o->decoder_arg = src->decoder_arg;
+		o->decode_mask = src->decode_mask;
+		o->borrow_bytes = src->borrow_bytes;
+		o->cflow_order = src->cflow_order;
+		o->bfd_image = src->bfd_image;
+		o->bfd_image_bfd = src->bfd_image_bfd;
+		o->sec_cache = src->sec_cache;
+		o->decode_cache = src->decode_cache;
+		o->decode_cache_key = src->decode_cache_key;
+		o->cfg = src->cfg;
+		o->batch = src->batch;
+		o->batch_arg = src->batch_arg;
+		o->batch_size = src->batch_size;
+		o->stats = src->stats;
 		o->debug = src->debug;
 
 		/* NOTE: this is not threadsafe, but we don't really care;
@@ -227,11 +331,50 @@ opdis_t LIBCALL opdis_init_from_bfd( bfd * abfd ) {
 /* ---------------------------------------------------------------------- */
 /* Configuration */
 
+/* Key for the configuration which cached decodes depend on: FNV-1a over the
+ * print_insn routine, decoder, architecture and disassembler options. This
+ * is updated by the setters of these, rather than computed for every insn */
+static void set_decode_cache_key( opdis_t o ) {
+	const disassemble_info * config = &o->config;
+	uint64_t h = 14695981039346656037ULL;
+	const unsigned char * p;
+	unsigned int i;
+	struct {
+		disassembler_ftype disassembler;
+		OPDIS_DECODER decoder;
+		enum opdis_insn_decode_t decode_mask;
+		enum bfd_architecture arch;
+		unsigned long mach;
+		enum bfd_endian endian;
+	} key;
+
+	memset( &key, 0, sizeof(key) );
+	key.disassembler = o->disassembler;
+	key.decoder = o->decoder;
+	key.decode_mask = o->decode_mask;
+	key.arch = config->arch;
+	key.mach = config->mach;
+	key.endian = config->endian;
+
+	for ( i = 0, p = (const unsigned char *) &key; i < sizeof(key); i++ ) {
+		h = ( h ^ p[i] ) * 1099511628211ULL;
+	}
+	p = (const unsigned char *) config->disassembler_options;
+	for ( ; p && *p; p++ ) {
+		h = ( h ^ *p ) * 1099511628211ULL;
+	}
+
+	o->decode_cache_key = h;
+}
+
 void LIBCALL opdis_set_defaults( opdis_t o ) {
 	opdis_set_handler( o, opdis_default_handler, o );
 	opdis_set_display( o, opdis_default_display, NULL );
 	opdis_set_resolver( o, opdis_default_resolver, NULL );
 	opdis_set_error_reporter( o, opdis_default_error_reporter, NULL );
+	opdis_set_cflow_order( o, opdis_cflow_order_dfs );
+	opdis_set_decode_mask( o, OPDIS_DECODE_ALL );
+	opdis_set_borrow_bytes( o, 0 );
 	opdis_set_arch( o, bfd_arch_i386, bfd_mach_i386_i386, NULL );
 	/* note: this sets the decoder */
 	opdis_set_x86_syntax( o, opdis_x86_syntax_intel );
@@ -247,6 +390,7 @@ void LIBCALL opdis_set_disassembler_options( opdis_t o, const char * options ) {
 	}
 
 	o->config.disassembler_options = strdup( options );
+	set_decode_cache_key( o );
 }
 
 void LIBCALL opdis_set_x86_syntax( opdis_t o, enum opdis_x86_syntax_t syntax ) {
@@ -267,9 +411,22 @@ void LIBCALL opdis_set_x86_syntax( opdis_t o, enum opdis_x86_syntax_t syntax ) {
 
 	o->disassembler = fn;
 
+	/* the native decoder supports both syntaxes */
+	if ( o->decoder == opdis_x86_native_decoder ) {
+		d_fn = opdis_x86_native_decoder;
+	}
+
 	opdis_set_decoder( o, d_fn, o );
 }
 
+enum opdis_x86_syntax_t LIBCALL opdis_get_x86_syntax( opdis_t o ) {
+	if ( o && o->disassembler == print_insn_i386_intel ) {
+		return opdis_x86_syntax_intel;
+	}
+
+	return opdis_x86_syntax_att;
+}
+
 void LIBCALL opdis_set_arch( opdis_t o, enum bfd_architecture arch, 
 			     unsigned long mach, disassembler_ftype fn ) {
 	OPDIS_DECODER d_fn = opdis_default_decoder;
@@ -311,6 +468,7 @@ void LIBCALL opdis_set_decoder( opdis_t o, OPDIS_DECODER fn, void * arg ) {
 	if ( o && fn ) {
 		o->decoder = fn;
 		o->decoder_arg = arg;
+		set_decode_cache_key( o );
 	}
 }
 
@@ -328,237 +486,1046 @@ void LIBCALL opdis_set_error_reporter( opdis_t o, OPDIS_ERROR fn, void * arg ) {
 	}
 }
 
+void LIBCALL opdis_set_decode_mask( opdis_t o, enum opdis_insn_decode_t mask ){
+	if (! o ) {
+		return;
+	}
+
+	mask |= opdis_decode_basic;
+	if ( mask & opdis_decode_mnem_flags ) {
+		mask |= opdis_decode_mnem;
+	}
+	if ( mask & opdis_decode_op_flags ) {
+		mask |= opdis_decode_ops;
+	}
+	o->decode_mask = mask;
+	set_decode_cache_key( o );
+}
+
+void LIBCALL opdis_set_borrow_bytes( opdis_t o, int enabled ) {
+	if ( o ) {
+		o->borrow_bytes = ( enabled ) ? 1 : 0;
+	}
+}
+
+void LIBCALL opdis_set_cflow_order( opdis_t o, 
+				    enum opdis_cflow_order_t order ) {
+	if ( o ) {
+		o->cflow_order = order;
+	}
+}
+
+void LIBCALL opdis_set_decode_cache( opdis_t o, opdis_decode_cache_t cache ) {
+	if ( o ) {
+		o->decode_cache = cache;
+		/* pick up configuration fields which were set directly */
+		set_decode_cache_key( o );
+	}
+}
+
+void LIBCALL opdis_set_cfg( opdis_t o, opdis_cfg_t cfg ) {
+	if ( o ) {
+		o->cfg = cfg;
+	}
+}
+
+void LIBCALL opdis_set_batch_handler( opdis_t o, OPDIS_BATCH_HANDLER fn,
+				      void * arg, size_t size ) {
+	if ( o ) {
+		o->batch = fn;
+		o->batch_arg = arg;
+		o->batch_size = ( size ) ? size : OPDIS_BATCH_SIZE;
+	}
+}
+
+void LIBCALL opdis_set_stats( opdis_t o, opdis_stats_t * stats ) {
+	if ( o ) {
+		o->stats = stats;
+	}
+}
+
+const opdis_stats_t * LIBCALL opdis_get_stats( opdis_t o ) {
+	return ( o ) ? o->stats : NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Decode contexts */
+
+/* Set up a context for one call of the classic opdis_t API: the context
+ * uses the libopcodes state and insn buffer of o itself. */
+static void ctx_local( opdis_ctx_t c, opdis_t o ) {
+	c->opdis = o;
+	c->config = &o->config;
+	c->buf = o->buf;
+	c->visited_addr = o->visited_addr;
+	c->stats = o->stats;
+	c->buffer_owned = 0;
+}
+
+opdis_ctx_t LIBCALL opdis_ctx_init( opdis_t o ) {
+	opdis_ctx_t c;
+
+	if (! o ) {
+		return NULL;
+	}
+
+	c = (opdis_ctx_t) calloc( 1, sizeof(opdis_ctx_info_t) );
+	if (! c ) {
+		return NULL;
+	}
+
+	c->buf = opdis_insn_buf_alloc( 0, 0, 0 );
+	if (! c->buf ) {
+		free( c );
+		return NULL;
+	}
+
+	c->opdis = o;
+	memcpy( &c->info, &o->config, sizeof(disassemble_info) );
+	c->config = &c->info;
+	c->config->buffer = NULL;
+	c->config->buffer_length = 0;
+	c->config->buffer_vma = 0;
+	c->config->section = NULL;
+	/* libopcodes keeps per-decoder state here: start each context afresh
+	 * rather than sharing the state of o */
+	c->config->private_data = NULL;
+
+	return c;
+}
+
+void LIBCALL opdis_ctx_free( opdis_ctx_t c ) {
+	if ( c ) {
+		opdis_insn_buf_free( c->buf );
+		free( c );
+	}
+}
+
+/* Insns decoded by the native x86 decoder have no ascii until it is needed
+ * by a callback. Insns decoded by libopcodes already have theirs. */
+static void render_insn( opdis_t o, opdis_insn_t * insn ) {
+	if ( o->decoder == opdis_x86_native_decoder && insn->status &&
+	     ( ! insn->ascii || ! insn->ascii[0] ) ) {
+		opdis_x86_native_render( insn, opdis_get_x86_syntax( o ) );
+	}
+}
+
+/* Invoke the handler: the default handler checks the visited addresses of
+ * the context rather than those of the shared opdis_t. */
+static int ctx_handler( opdis_ctx_t c, opdis_insn_t * insn ) {
+	opdis_t o = c->opdis;
+	uint64_t start = stats_start( c );
+	int rv;
+
+	if ( o->handler == opdis_default_handler && o->handler_arg == o ) {
+		rv = default_handler( insn, c->visited_addr );
+		if ( c->stats && ! rv && c->visited_addr ) {
+			c->stats->visited_hits++;
+		}
+	} else {
+		render_insn( o, insn );
+		rv = o->handler( insn, o->handler_arg );
+	}
+
+	stats_end( c, opdis_phase_handler, start );
+	return rv;
+}
+
 /* ---------------------------------------------------------------------- */
 /* Disassemble instruction */
 
+/* Cache an insn decoded by libopcodes, keyed on all of the bytes it read.
+ * A decode which read past the end of the buffer depends on where the
+ * buffer ends, and is not cached. */
+static void cache_insn( opdis_ctx_t c, opdis_vma_t vma, unsigned int size,
+			uint64_t cache_key, const opdis_insn_t * insn ) {
+	opdis_off_t offset = vma - c->config->buffer_vma;
+	opdis_off_t len = ( c->fetched > vma + size ) ? c->fetched - vma : size;
+
+	if ( offset + len > c->config->buffer_length ) {
+		return;
+	}
+
+	opdis_decode_cache_add( c->opdis->decode_cache, cache_key, insn,
+				&c->config->buffer[offset], len );
+}
+
 /* Internal wrapper for libopcodes disassembler used by the three main
  * disasm functions: disasm_insn, disasm_linear, disasm_cflow. */
-// NOTE: This requires that opdis_set_buffer() have been called
-static unsigned int disasm_single_insn( opdis_t o, opdis_vma_t vma, 
+// NOTE: This requires that set_ctx_buffer() have been called
+static unsigned int disasm_single_insn( opdis_ctx_t c, opdis_vma_t vma, 
 					opdis_insn_t * insn ) {
-	unsigned int size;
+	opdis_t o = c->opdis;
+	uint64_t cache_key = 0, start, capture = 0;
+	int size;
+
+	if ( o->decode_cache ) {
+		start = stats_start( c );
+		cache_key = o->decode_cache_key;
+		size = opdis_decode_cache_fill( o->decode_cache, cache_key,
+				c->config->buffer, vma - c->config->buffer_vma,
+				c->config->buffer_length, vma, insn );
+		stats_end( c, opdis_phase_cache, start );
+		if ( size > 0 ) {
+			opdis_debug( o, 3, "Cached %d bytes at %p", size,
+				     (void *) vma );
+			if ( c->stats ) {
+				c->stats->insns++;
+				c->stats->bytes += size;
+				c->stats->cache_hits++;
+			}
+			return size;
+		}
+	}
 
-	o->config.insn_info_valid = 0;
-	o->buf->item_count = 0;
-	o->buf->string[0] = '\0';
+	c->config->insn_info_valid = 0;
+	opdis_insn_buf_clear( c->buf );
 	opdis_insn_clear( insn );
 
-	o->config.stream = o;
-	size = o->disassembler( (bfd_vma) vma, &o->config );
-	if (! size ) {
+	if ( o->decoder == opdis_x86_native_decoder ) {
+		/* libopcodes is only needed for encodings the native decoder
+		 * does not support; the ascii is rendered on display */
+		start = stats_start( c );
+		size = opdis_x86_native_decode( insn, c->config->buffer,
+				vma - c->config->buffer_vma,
+				c->config->buffer_length, vma,
+				opdis_x86_mach_mode( c->config->mach ),
+				opdis_get_x86_syntax( o ) );
+		stats_end( c, opdis_phase_decode, start );
+		if ( size > 0 ) {
+			opdis_debug( o, 3, "Decoded %d bytes at %p", size,
+				     (void *) vma );
+			if ( c->stats ) {
+				c->stats->insns++;
+				c->stats->bytes += size;
+			}
+			if ( o->decode_cache ) {
+				/* only the bytes of the insn were read */
+				start = stats_start( c );
+				opdis_decode_cache_add( o->decode_cache,
+							cache_key, insn, NULL,
+							0 );
+				stats_end( c, opdis_phase_cache, start );
+			}
+			return size;
+		}
+	}
+
+	c->config->stream = c;
+	c->fetched = vma;
+	if ( c->stats ) {
+		/* capture time is counted separately from libopcodes time */
+		capture = c->stats->ticks[opdis_phase_capture];
+	}
+	start = stats_start( c );
+	size = o->disassembler( (bfd_vma) vma, c->config );
+	if ( c->stats ) {
+		c->stats->ticks[opdis_phase_opcodes] += opdis_stats_clock() - 
+			start - ( c->stats->ticks[opdis_phase_capture] - 
+				  capture );
+	}
+	/* libopcodes returns -1 if the insn extends past the end of buffer */
+	if ( size <= 0 ) {
 		char msg[32];
 		snprintf( msg, 31, "VMA %p: %02X\n", (void *) vma, 
-			  o->config.buffer[(vma - o->config.buffer_vma)] );
+			  c->config->buffer[(vma - c->config->buffer_vma)] );
 		opdis_error( o, opdis_error_invalid_insn, msg );
+		if ( c->stats ) {
+			c->stats->invalid++;
+		}
 		return 0;
 	}
 
+	if ( c->stats ) {
+		c->stats->insns++;
+		c->stats->bytes += size;
+	}
+
 	opdis_debug( o, 3, "Disassembled %d bytes at %p", size, (void *) vma );
 
-	opdis_debug( o, 4, "%p : %s", (void *) vma, o->buf->string );
+	opdis_debug( o, 4, "%p : %s", (void *) vma, c->buf->string );
 
 
 	/* fill insn_buf with libopcodes meta-info */
-	o->buf->insn_info_valid = o->config.insn_info_valid;
-	o->buf->branch_delay_insns = o->config.branch_delay_insns;
-	o->buf->data_size = o->config.data_size;
-	o->buf->insn_type = o->config.insn_type;
-	o->buf->target = o->config.target;
-	o->buf->target2 = o->config.target2;
-
-	if (! o->decoder( o->buf, insn, o->config.buffer, 
-			  vma - o->config.buffer_vma, vma, size,
+	c->buf->insn_info_valid = c->config->insn_info_valid;
+	c->buf->branch_delay_insns = c->config->branch_delay_insns;
+	c->buf->data_size = c->config->data_size;
+	c->buf->insn_type = c->config->insn_type;
+	c->buf->target = c->config->target;
+	c->buf->target2 = c->config->target2;
+	c->buf->decode_mask = o->decode_mask;
+
+	start = stats_start( c );
+	if (! o->decoder( c->buf, insn, c->config->buffer, 
+			  vma - c->config->buffer_vma, vma, size,
 			  o->decoder_arg ) ) {
 		char msg[64];
+		stats_end( c, opdis_phase_decode, start );
 		snprintf( msg, 63, "VMA %p: '%s'\n", (void *) vma,
-			  o->buf->string );
+			  c->buf->string );
 		opdis_error( o, opdis_error_decode_insn, msg );
 		// Note: this is a warning, not an error
+		if ( c->stats ) {
+			c->stats->decode_errors++;
+		}
+	} else if ( o->decode_cache ) {
+		stats_end( c, opdis_phase_decode, start );
+		start = stats_start( c );
+		cache_insn( c, vma, size, cache_key, insn );
+		stats_end( c, opdis_phase_cache, start );
+	} else {
+		stats_end( c, opdis_phase_decode, start );
 	}
 
 	/* clear insn buffer now that decoding has taken place */
-	opdis_insn_buf_clear( o->buf );
+	opdis_insn_buf_clear( c->buf );
+
+	return size;
+}
+
+static void set_ctx_buffer( opdis_ctx_t c, opdis_buf_t buf ) {
+	opdis_debug( c->opdis, 2, "Buffer VMA %p size %d\n", 
+		     (void *) buf->vma, buf->len );
+	c->config->buffer_vma = buf->vma;
+	c->config->buffer = (bfd_byte *) buf->data;
+	c->config->buffer_length = buf->len;
+
+	opdis_visited_cover( c->visited_addr, buf->vma, buf->len );
+}
+
+/* size of single insn at address: libopcodes output is discarded */
+static unsigned int disasm_insn_size( opdis_ctx_t c, opdis_buf_t buf, 
+				      opdis_vma_t vma ) {
+	fprintf_ftype fn = c->config->fprintf_func;
+#ifdef HAVE_STRUCT_DISASSEMBLE_INFO_FPRINTF_STYLED_FUNC
+	fprintf_styled_ftype styled_fn = c->config->fprintf_styled_func;
+#endif
+	unsigned int size;
+
+	set_ctx_buffer( c, buf );
+
+	c->config->fprintf_func = null_fprintf;
+#ifdef HAVE_STRUCT_DISASSEMBLE_INFO_FPRINTF_STYLED_FUNC
+	c->config->fprintf_styled_func = null_fprintf_styled;
+#endif
+	c->config->stream = c;
+	size = c->opdis->disassembler( vma, c->config );
+	c->config->fprintf_func = fn;
+#ifdef HAVE_STRUCT_DISASSEMBLE_INFO_FPRINTF_STYLED_FUNC
+	c->config->fprintf_styled_func = styled_fn;
+#endif
 
 	return size;
 }
 
-// size of single insn at address
 unsigned int LIBCALL opdis_disasm_insn_size( opdis_t o, opdis_buf_t buf, 
 					     opdis_vma_t vma ){
-	size_t size;
-	fprintf_ftype fn = o->config.fprintf_func;
-	o->config.fprintf_func = null_fprintf;
+	opdis_ctx_info_t c;
 
 	if (! o || ! buf  ) {
 		return 0;
 	}
 
-	o->config.stream = o;
-	size = o->disassembler( vma, &o->config );
-	
-	o->config.fprintf_func = fn;
-	return size;
-}
-
-static void set_opdis_buffer( opdis_t o, opdis_buf_t buf ) {
-	opdis_debug( o, 2, "Buffer VMA %p size %d\n", (void *) buf->vma,
-		     buf->len );
-	o->config.buffer_vma = buf->vma;
-	o->config.buffer = (bfd_byte *) buf->data;
-	o->config.buffer_length = buf->len;
+	ctx_local( &c, o );
+	return disasm_insn_size( &c, buf, vma );
 }
 
-unsigned int LIBCALL opdis_disasm_insn( opdis_t o, opdis_buf_t buf, 
-					opdis_vma_t vma, 
-					opdis_insn_t * insn ) {
-	size_t size;
-
-	if (! o || ! buf  ) {
+unsigned int LIBCALL opdis_ctx_disasm_insn_size( opdis_ctx_t c, 
+						 opdis_buf_t buf,
+						 opdis_vma_t vma ){
+	if (! c || ! buf  ) {
 		return 0;
 	}
 
-	set_opdis_buffer( o, buf );
-	size = disasm_single_insn( o, vma, insn );
-	o->display( insn, o->display_arg );
-
-	return size;
+	return disasm_insn_size( c, buf, vma );
 }
 
-/* ---------------------------------------------------------------------- */
-/* Disassembler algorithms */
-
-static inline opdis_insn_t * alloc_fixed_insn() {
-	// TODO: verify these values across architectures
-	//       or use per-arch values
-	return opdis_insn_alloc_fixed( 128, 32, 16, 32 );
+/* size of every insn for fixed-size architectures, or 0 */
+static unsigned int fixed_insn_size( enum bfd_architecture arch,
+				     unsigned long mach ) {
+	switch ( arch ) {
+		case bfd_arch_alpha:
+		case bfd_arch_sparc:
+#if HAVE_DECL_BFD_ARCH_AARCH64
+		case bfd_arch_aarch64:
+#endif
+			return 4;
+		case bfd_arch_mips:
+#ifdef bfd_mach_mips16
+			if ( mach == bfd_mach_mips16 ) {
+				return 0;
+			}
+#endif
+#ifdef bfd_mach_mips_micromips
+			if ( mach == bfd_mach_mips_micromips ) {
+				return 0;
+			}
+#endif
+			return 4;
+		case bfd_arch_powerpc:
+		case bfd_arch_rs6000:
+#ifdef bfd_mach_ppc_vle
+			if ( mach == bfd_mach_ppc_vle ) {
+				return 0;
+			}
+#endif
+			return 4;
+		default:
+			return 0;
+	}
 }
 
-static int disasm_linear( opdis_t o, opdis_vma_t vma, opdis_off_t length ) {
-	opdis_insn_t * insn;
-	int cont = 1;
-	unsigned int count = 0;
-	opdis_off_t pos = vma;
-	length = (length == 0) ? o->config.buffer_length : length;
-	opdis_off_t max_pos = o->config.buffer_vma + length;
+static int insn_lengths( opdis_ctx_t c, opdis_buf_t buf, opdis_vma_t vma,
+			 opdis_off_t length, opdis_off_t * offsets ) {
+	enum bfd_architecture arch = c->config->arch;
+	unsigned long mach = c->config->mach;
+	unsigned int stride = fixed_insn_size( arch, mach );
+	enum opdis_x86_mode_t mode = opdis_x86_mach_mode( mach );
+	opdis_off_t pos, max_pos = buf->len;
+	int count = 0;
 
-	insn = alloc_fixed_insn();
-	if (! insn ) {
-		fprintf( stderr, "Unable to alloc insn\n" );
+	if ( vma < buf->vma || vma >= buf->vma + buf->len ) {
 		return 0;
 	}
 
-	opdis_debug( o, 1, "Start linear from %p max %p", (void *) vma,
-		     (void *) max_pos );
+	/* a range within the buffer ends length bytes after vma */
+	pos = vma - buf->vma;
+	if ( length && pos + length < max_pos ) {
+		max_pos = pos + length;
+	}
 
-	while ( cont && pos < max_pos ) {
-		unsigned int size = disasm_single_insn( o, pos, insn );
-		pos += size;
-		if ( pos - vma > length ) {
-			opdis_debug( o, 1, "Instruction at %p exceeds buffer", 
-				    (void *) vma );
+	opdis_debug( c->opdis, 1, "Start insn lengths from %p max %p",
+		     (void *) vma, (void *) (buf->vma + max_pos) );
+
+	while ( pos < max_pos ) {
+		unsigned int size;
+
+		if ( arch == bfd_arch_i386 ) {
+			size = opdis_x86_insn_length( &buf->data[pos],
+						      max_pos - pos, mode );
+#if HAVE_DECL_BFD_ARCH_RISCV
+		} else if ( arch == bfd_arch_riscv ) {
+			/* the low bits of the first parcel select RVC */
+			size = ( (buf->data[pos] & 3) == 3 ) ? 4 : 2;
+#endif
+		} else if ( stride ) {
+			size = stride;
+		} else {
+			/* a negative libopcodes size becomes huge */
+			size = disasm_insn_size( c, buf, buf->vma + pos );
+		}
+
+		if (! size || pos + size > max_pos ) {
 			break;
 		}
+
+		if ( offsets ) {
+			offsets[count] = pos;
+		}
 		count++;
-		o->display( insn, o->display_arg );
-		cont = o->handler( insn, o->handler_arg );
+		pos += size;
 	}
 
-	opdis_debug( o, 1, "End linear %p (count %d)", (void *) vma, count );
-
-	opdis_insn_free(insn);
+	opdis_debug( c->opdis, 1, "End insn lengths %p (count %d)",
+		     (void *) vma, count );
 
 	return count;
 }
 
-int LIBCALL opdis_disasm_linear( opdis_t o, opdis_buf_t buf, opdis_vma_t vma,
-				 opdis_off_t length ) {
-	set_opdis_buffer( o, buf );
-
-	return disasm_linear( o, vma, length );
-}
-
-static int disasm_cflow(opdis_t o, opdis_vma_tree_t tree, opdis_vma_t vma) {
-	int cont = 1;
-	unsigned int count = 0;
-	opdis_off_t pos = vma;
-	opdis_off_t max_pos = o->config.buffer_vma + o->config.buffer_length;
-	opdis_insn_t * insn = alloc_fixed_insn();
+int LIBCALL opdis_insn_lengths( opdis_t o, opdis_buf_t buf, opdis_vma_t vma,
+				opdis_off_t length, opdis_off_t * offsets ) {
+	opdis_ctx_info_t c;
 
-	if (! insn ) {
-		fprintf( stderr, "Unable to alloc insn\n" );
+	if (! o || ! buf  ) {
 		return 0;
 	}
 
-	if ( pos < o->config.buffer_vma ) {
+	ctx_local( &c, o );
+	return insn_lengths( &c, buf, vma, length, offsets );
+}
+
+int LIBCALL opdis_ctx_insn_lengths( opdis_ctx_t c, opdis_buf_t buf,
+				    opdis_vma_t vma, opdis_off_t length,
+				    opdis_off_t * offsets ) {
+	if (! c || ! buf  ) {
 		return 0;
 	}
 
-	opdis_debug( o, 1, "Start cflow from %p max %p", (void *) vma,
-		     (void *) max_pos );
-
-	while ( cont && pos < max_pos ) {
-		unsigned int size = disasm_single_insn( o, pos, insn );
-		pos += size;
-		count++;
-
-		/* NOTE : handler determines if an address has already been
-		 *        visited, and if not it adds the insn to the addr
-		 *        list. this means that the first insn of a branch could
-		 *        be disassembled, but will not be added. a bit
-		 *        inefficient, but not too troubling. */
-		cont = o->handler( insn, o->handler_arg );
+	return insn_lengths( c, buf, vma, length, offsets );
+}
 
-		if ( cont ) {
-			o->display( insn, o->display_arg );
-		} else {
-			opdis_debug( o, 2, "VMA %p invalid or already visited",
-			             (void *) pos );
-		}
+/* a single insn is a batch of one */
+static void display_single( opdis_ctx_t c, opdis_insn_t * insn ) {
+	opdis_t o = c->opdis;
+	uint64_t start = stats_start( c );
 
-		if (! opdis_insn_fallthrough( insn ) ) {
-			opdis_debug( o, 2, "CFLOW BRANCH END: %s",
-				     insn->ascii );
-			cont = 0;
-		}
+	render_insn( o, insn );
 
-		if (! opdis_insn_is_branch( insn ) ) {
-			/* no need for further processing */
-			continue;
-		}
+	if ( o->batch ) {
+		o->batch( insn, 1, o->batch_arg );
+	} else {
+		o->display( insn, o->display_arg );
+	}
 
-		opdis_vma_t vma = o->resolver( insn, o->resolver_arg );
-		/* recurse on branch target */
-		if ( vma == OPDIS_INVALID_ADDR ) {
-			opdis_debug( o, 2, "Cannot Resolve: %s", insn->ascii );
-		} else if ( vma < o->config.buffer_vma || vma >= max_pos ) {
-			opdis_debug( o, 2, "Branch target %p not in buffer %p", 
-				(void *) vma, (void *) o->config.buffer_vma );
-		} else if ( opdis_vma_tree_add( tree, vma ) ) {
-			opdis_debug( o, 2, "CFLOW BRANCH START: %p", 
-				     (void *) vma );
-			count +=  disasm_cflow( o, tree, vma );
-		} else {
-			opdis_debug( o, 3, "VMA %p already visited\n",
-				     (void *) vma );
-		}
+	stats_end( c, opdis_phase_display, start );
+	if ( c->stats ) {
+		c->stats->displayed++;
 	}
+}
 
-	opdis_debug( o, 1, "End cflow %p (count %d)", (void *) vma, count );
+static unsigned int disasm_insn( opdis_ctx_t c, opdis_buf_t buf, 
+				 opdis_vma_t vma, opdis_insn_t * insn ) {
+	unsigned int size;
 
-	return count;
+	set_ctx_buffer( c, buf );
+	size = disasm_single_insn( c, vma, insn );
+	display_single( c, insn );
+
+	return size;
 }
 
-int LIBCALL opdis_disasm_cflow( opdis_t o, opdis_buf_t buf, opdis_vma_t vma ) {
-	int count;
-	opdis_vma_tree_t tree = opdis_vma_tree_init();
+unsigned int LIBCALL opdis_disasm_insn( opdis_t o, opdis_buf_t buf, 
+					opdis_vma_t vma, 
+					opdis_insn_t * insn ) {
+	opdis_ctx_info_t c;
 
-	set_opdis_buffer( o, buf );
+	if (! o || ! buf  ) {
+		return 0;
+	}
 
-	count = disasm_cflow( o, tree, vma );
+	ctx_local( &c, o );
+	return disasm_insn( &c, buf, vma, insn );
+}
 
-	opdis_vma_tree_free( tree );
+unsigned int LIBCALL opdis_ctx_disasm_insn( opdis_ctx_t c, opdis_buf_t buf, 
+					    opdis_vma_t vma, 
+					    opdis_insn_t * insn ) {
+	if (! c || ! buf  ) {
+		return 0;
+	}
 
-	return count;
+	return disasm_insn( c, buf, vma, insn );
+}
+
+/* ---------------------------------------------------------------------- */
+/* Disassembler algorithms */
+
+/* Field sizes of fixed insns. bytes is the longest encoding libopcodes
+ * will return; num_operands the most operands of an insn in its syntax. */
+static const struct {
+	enum bfd_architecture arch;
+	opdis_insn_sizes_t sizes;
+} insn_sizes[] = {
+	{ bfd_arch_i386,	{ 16, 128, 32, 8, 32 } },
+	{ bfd_arch_alpha,	{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_arm,		{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_avr,		{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_hppa,	{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_m32r,	{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_mips,	{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_sh,		{ 4, 128, 16, 4, 32 } },
+	{ bfd_arch_sparc,	{ 4, 128, 16, 4, 32 } },
+#if HAVE_DECL_BFD_ARCH_AARCH64
+	{ bfd_arch_aarch64,	{ 4, 128, 16, 4, 32 } },
+#endif
+	/* prefixed (POWER10) insns are 8 bytes; rlwinm has 5 operands */
+	{ bfd_arch_powerpc,	{ 8, 128, 16, 5, 32 } },
+	{ bfd_arch_rs6000,	{ 8, 128, 16, 5, 32 } },
+#if HAVE_DECL_BFD_ARCH_RISCV
+	{ bfd_arch_riscv,	{ 8, 128, 16, 4, 32 } },
+#endif
+	{ bfd_arch_s390,	{ 6, 128, 16, 6, 32 } },
+	{ bfd_arch_ia64,	{ 16, 128, 16, 6, 32 } },
+	{ bfd_arch_m68k,	{ 22, 128, 16, 4, 32 } }
+};
+
+/* architectures without an entry: the original sizes */
+static const opdis_insn_sizes_t default_insn_sizes = { 128, 128, 32, 16, 32 };
+
+const opdis_insn_sizes_t * LIBCALL opdis_insn_sizes( enum bfd_architecture 
+						     arch ) {
+	unsigned int i;
+
+	for ( i = 0; i < sizeof(insn_sizes) / sizeof(insn_sizes[0]); i++ ) {
+		if ( insn_sizes[i].arch == arch ) {
+			return &insn_sizes[i].sizes;
+		}
+	}
+
+	return &default_insn_sizes;
+}
+
+/* an insn which borrows its bytes has no bytes field of its own */
+static opdis_insn_t * alloc_fixed_insn( opdis_ctx_t c ) {
+	const opdis_insn_sizes_t * sz = opdis_insn_sizes( c->config->arch );
+	int borrow = c->opdis->borrow_bytes;
+	opdis_insn_t * insn;
+
+	insn = opdis_insn_alloc_fixed_bytes( ( borrow ) ? 0 : sz->bytes_sz,
+					     sz->ascii_sz, sz->mnemonic_sz,
+					     sz->num_operands, 
+					     sz->op_ascii_sz );
+	if ( insn ) {
+		insn->borrow_bytes = borrow;
+	}
+
+	return insn;
+}
+
+/* Ring of insns for the batch handler. Without a batch handler, the ring is
+ * empty and insns are passed to the display callback one at a time. */
+typedef struct {
+	opdis_insn_t * insns;
+	size_t num;
+	size_t size;
+	int stop;		/* batch handler returned 0 */
+} insn_batch_t;
+
+static void batch_term( insn_batch_t * b ) {
+	size_t i;
+
+	for ( i = 0; i < b->size; i++ ) {
+		opdis_insn_free_members( &b->insns[i] );
+	}
+
+	free( b->insns );
+	b->insns = NULL;
+	b->size = b->num = 0;
+}
+
+static int batch_init( opdis_ctx_t c, insn_batch_t * b ) {
+	opdis_t o = c->opdis;
+
+	memset( b, 0, sizeof(insn_batch_t) );
+	if (! o->batch ) {
+		return 1;
+	}
+
+	b->insns = calloc( o->batch_size, sizeof(opdis_insn_t) );
+	if (! b->insns ) {
+		return 0;
+	}
+
+	/* the ring is an array of insns, so the fixed insns are moved into
+	 * it from the objects returned by alloc_fixed_insn */
+	for ( b->size = 0; b->size < o->batch_size; b->size++ ) {
+		opdis_insn_t * insn = alloc_fixed_insn( c );
+		if (! insn ) {
+			batch_term( b );
+			return 0;
+		}
+		b->insns[b->size] = *insn;
+		free( insn );
+	}
+
+	return 1;
+}
+
+/* insn to decode the next instruction into: the next slot of the ring */
+static opdis_insn_t * batch_insn( insn_batch_t * b, opdis_insn_t * insn ) {
+	return ( b->size ) ? &b->insns[b->num] : insn;
+}
+
+static int batch_flush( opdis_t o, insn_batch_t * b ) {
+	if ( b->num && ! b->stop ) {
+		b->stop = ! o->batch( b->insns, b->num, o->batch_arg );
+	}
+	b->num = 0;
+	return ! b->stop;
+}
+
+/* display the insn returned by batch_insn. returns 0 if the batch handler
+ * asked for disassembly to stop */
+static int batch_display( opdis_t o, insn_batch_t * b,
+			  const opdis_insn_t * insn ) {
+	if (! b->size ) {
+		o->display( insn, o->display_arg );
+		return 1;
+	}
+
+	b->num++;
+	return ( b->num < b->size ) ? 1 : batch_flush( o, b );
+}
+
+/* batch_display and batch_flush, timed as the display phase */
+static int ctx_display( opdis_ctx_t c, insn_batch_t * b,
+			opdis_insn_t * insn ) {
+	uint64_t start = stats_start( c );
+	int rv;
+
+	render_insn( c->opdis, insn );
+	rv = batch_display( c->opdis, b, insn );
+
+	stats_end( c, opdis_phase_display, start );
+	if ( c->stats ) {
+		c->stats->displayed++;
+	}
+	return rv;
+}
+
+static void ctx_flush( opdis_ctx_t c, insn_batch_t * b ) {
+	uint64_t start = stats_start( c );
+	batch_flush( c->opdis, b );
+	stats_end( c, opdis_phase_display, start );
+}
+
+static int disasm_linear( opdis_ctx_t c, opdis_vma_t vma, 
+			  opdis_off_t length ) {
+	opdis_t o = c->opdis;
+	opdis_insn_t * insn;
+	insn_batch_t batch;
+	int cont = 1;
+	unsigned int count = 0;
+	opdis_off_t pos = vma;
+	opdis_off_t max_pos = c->config->buffer_vma + c->config->buffer_length;
+
+	/* a range within the buffer ends length bytes after vma */
+	if ( length && vma + length < max_pos ) {
+		max_pos = vma + length;
+	}
+
+	insn = alloc_fixed_insn( c );
+	if (! insn || ! batch_init( c, &batch ) ) {
+		fprintf( stderr, "Unable to alloc insn\n" );
+		opdis_insn_free( insn );
+		return 0;
+	}
+
+	opdis_debug( o, 1, "Start linear from %p max %p", (void *) vma,
+		     (void *) max_pos );
+
+	while ( cont && pos < max_pos ) {
+		opdis_insn_t * i = batch_insn( &batch, insn );
+		unsigned int size = disasm_single_insn( c, pos, i );
+		pos += size;
+		if ( pos > max_pos ) {
+			opdis_debug( o, 1, "Instruction at %p exceeds buffer", 
+				    (void *) vma );
+			break;
+		}
+		count++;
+		cont = ctx_display( c, &batch, i );
+		cont &= ctx_handler( c, i );
+	}
+
+	ctx_flush( c, &batch );
+	opdis_debug( o, 1, "End linear %p (count %d)", (void *) vma, count );
+
+	batch_term( &batch );
+	opdis_insn_free(insn);
+
+	return count;
+}
+
+int LIBCALL opdis_disasm_linear( opdis_t o, opdis_buf_t buf, opdis_vma_t vma,
+				 opdis_off_t length ) {
+	opdis_ctx_info_t c;
+
+	if (! o || ! buf  ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	set_ctx_buffer( &c, buf );
+
+	return disasm_linear( &c, vma, length );
+}
+
+int LIBCALL opdis_ctx_disasm_linear( opdis_ctx_t c, opdis_buf_t buf, 
+				     opdis_vma_t vma, opdis_off_t length ) {
+	if (! c || ! buf  ) {
+		return 0;
+	}
+
+	set_ctx_buffer( c, buf );
+
+	return disasm_linear( c, vma, length );
+}
+
+/* Worklist of branch targets pending control-flow disassembly. This is
+ * used as a stack (DFS) or a queue (BFS) depending on o->cflow_order. */
+typedef struct {
+	opdis_vma_t * vma;
+	size_t head;
+	size_t tail;
+	size_t alloc;
+	opdis_visited_t queued;		/* every address pushed, or NULL */
+} cflow_worklist_t;
+
+#define CFLOW_WORKLIST_INIT_SIZE 64
+
+static int worklist_init( cflow_worklist_t * wl ) {
+	wl->head = wl->tail = 0;
+	wl->queued = NULL;
+	wl->alloc = CFLOW_WORKLIST_INIT_SIZE;
+	wl->vma = (opdis_vma_t *) calloc( wl->alloc, sizeof(opdis_vma_t) );
+	return (wl->vma != NULL);
+}
+
+static void worklist_term( cflow_worklist_t * wl ) {
+	free( wl->vma );
+	opdis_visited_free( wl->queued );
+	wl->vma = NULL;
+	wl->queued = NULL;
+	wl->head = wl->tail = wl->alloc = 0;
+}
+
+static int worklist_push( cflow_worklist_t * wl, opdis_vma_t vma ) {
+	if ( wl->tail == wl->alloc ) {
+		if ( wl->head > 0 ) {
+			/* reclaim space consumed by BFS pops */
+			memmove( wl->vma, &wl->vma[wl->head], 
+				 (wl->tail - wl->head) * sizeof(opdis_vma_t) );
+			wl->tail -= wl->head;
+			wl->head = 0;
+		} else {
+			size_t alloc = wl->alloc * 2;
+			opdis_vma_t * v = (opdis_vma_t *) realloc( wl->vma, 
+						alloc * sizeof(opdis_vma_t) );
+			if (! v ) {
+				return 0;
+			}
+			wl->vma = v;
+			wl->alloc = alloc;
+		}
+	}
+
+	wl->vma[wl->tail++] = vma;
+	return 1;
+}
+
+static int worklist_pop( cflow_worklist_t * wl, enum opdis_cflow_order_t order,
+			 opdis_vma_t * vma ) {
+	if ( wl->head == wl->tail ) {
+		wl->head = wl->tail = 0;
+		return 0;
+	}
+
+	if ( order == opdis_cflow_order_bfs ) {
+		*vma = wl->vma[wl->head++];
+	} else {
+		*vma = wl->vma[--wl->tail];
+	}
+
+	return 1;
+}
+
+/* Return 1 if the default handler would reject the insn at vma because it
+ * has already been visited; this saves decoding it again */
+static int ctx_visited( opdis_ctx_t c, opdis_vma_t vma ) {
+	opdis_t o = c->opdis;
+
+	return ( c->visited_addr && o->handler == opdis_default_handler &&
+		 o->handler_arg == o &&
+		 opdis_visited_contains( c->visited_addr, vma ) );
+}
+
+/* Disassemble a single run of instructions starting at vma, stopping at the
+ * end of the branch (or when the handler says to). Branch targets are added
+ * to the worklist rather than being disassembled immediately. Targets
+ * outside of the buffer are added to ext, if it is not NULL; ext->queued
+ * keeps a target from being added more than once. */
+static int disasm_cflow_run( opdis_ctx_t c, opdis_visited_t targets, 
+			     cflow_worklist_t * wl, cflow_worklist_t * ext,
+			     insn_batch_t * batch, opdis_insn_t * ring_insn,
+			     opdis_vma_t vma ) {
+	opdis_t o = c->opdis;
+	int cont = 1;
+	unsigned int count = 0;
+	opdis_off_t pos = vma;
+	opdis_off_t max_pos = c->config->buffer_vma + c->config->buffer_length;
+
+	if ( pos < c->config->buffer_vma ) {
+		return 0;
+	}
+
+	opdis_debug( o, 1, "Start cflow from %p max %p", (void *) vma,
+		     (void *) max_pos );
+
+	while ( cont && pos < max_pos ) {
+		opdis_vma_t target = OPDIS_INVALID_ADDR;
+		opdis_insn_t * insn;
+		uint64_t start;
+		unsigned int size;
+		int is_branch, displayed;
+
+		/* NOTE : handler determines if an address has already been
+		 *        visited, and if not it adds the insn to the addr
+		 *        list. with the default handler, the run ends before
+		 *        an insn which has been visited is decoded again. */
+		if ( ctx_visited( c, pos ) ) {
+			opdis_debug( o, 2, "VMA %p already visited",
+			             (void *) pos );
+			if ( c->stats ) {
+				c->stats->visited_hits++;
+			}
+			break;
+		}
+
+		insn = batch_insn( batch, ring_insn );
+		size = disasm_single_insn( c, pos, insn );
+		pos += size;
+		count++;
+
+		cont = displayed = ctx_handler( c, insn );
+
+		if ( cont ) {
+			/* the insn stays valid until the next is decoded, even
+			 * if this fills the batch */
+			cont = ctx_display( c, batch, insn );
+		} else {
+			opdis_debug( o, 2, "VMA %p invalid or already visited",
+			             (void *) pos );
+		}
+
+		if (! size ) {
+			/* cannot advance past an undecodable instruction */
+			cont = 0;
+		}
+
+		if (! opdis_insn_fallthrough( insn ) ) {
+			opdis_debug( o, 2, "CFLOW BRANCH END: %s",
+				     insn->ascii );
+			cont = 0;
+		}
+
+		is_branch = opdis_insn_is_branch( insn );
+		if ( is_branch ) {
+			start = stats_start( c );
+			target = o->resolver( insn, o->resolver_arg );
+			stats_end( c, opdis_phase_resolve, start );
+		}
+
+		if ( o->cfg && displayed && size ) {
+			start = stats_start( c );
+			opdis_cfg_add_insn( o->cfg, insn, target );
+			stats_end( c, opdis_phase_cfg, start );
+		}
+
+		if (! is_branch ) {
+			/* no need for further processing */
+			continue;
+		}
+
+		if ( c->stats ) {
+			if ( target == OPDIS_INVALID_ADDR ) {
+				c->stats->targets_unresolved++;
+			} else {
+				c->stats->targets_resolved++;
+			}
+		}
+
+		start = stats_start( c );
+		if ( target == OPDIS_INVALID_ADDR ) {
+			opdis_debug( o, 2, "Cannot Resolve: %s", insn->ascii );
+		} else if ( target < c->config->buffer_vma || 
+			    target >= max_pos ) {
+			opdis_debug( o, 2, "Branch target %p not in buffer %p", 
+				(void *) target, (void *) c->config->buffer_vma);
+			if (! ext ) {
+				/* targets outside the buffer are not followed */
+			} else if ( opdis_visited_contains( targets, target ) ||
+				    ! opdis_visited_add( ext->queued, target ) ) {
+				/* already disassembled or already pending */
+				if ( c->stats ) {
+					c->stats->visited_hits++;
+				}
+			} else if (! worklist_push( ext, target ) ) {
+				opdis_error( o, opdis_error_unknown, 
+					     "Unable to grow cflow worklist" );
+			}
+		} else if ( opdis_visited_add( targets, target ) ) {
+			if (! worklist_push( wl, target ) ) {
+				opdis_error( o, opdis_error_unknown, 
+					     "Unable to grow cflow worklist" );
+			}
+		} else {
+			opdis_debug( o, 3, "VMA %p already visited\n",
+				     (void *) target );
+			if ( c->stats ) {
+				c->stats->visited_hits++;
+			}
+		}
+		stats_end( c, opdis_phase_resolve, start );
+	}
+
+	opdis_debug( o, 1, "End cflow %p (count %d)", (void *) vma, count );
+
+	return count;
+}
+
+/* Control-flow disassembly starting at entry point vma. This requires that
+ * set_ctx_buffer() or load_section() has been called. */
+static int disasm_cflow( opdis_ctx_t c, opdis_vma_t vma ) {
+	opdis_t o = c->opdis;
+	cflow_worklist_t wl;
+	opdis_visited_t targets;
+	opdis_insn_t * insn;
+	insn_batch_t batch;
+	unsigned int count = 0;
+
+	insn = alloc_fixed_insn( c );
+	if (! insn || ! batch_init( c, &batch ) ) {
+		fprintf( stderr, "Unable to alloc insn\n" );
+		opdis_insn_free( insn );
+		return 0;
+	}
+
+	/* branch targets always lie inside the buffer */
+	targets = opdis_visited_init_bitmap( c->config->buffer_vma, 
+					     c->config->buffer_length );
+	if (! targets || ! worklist_init( &wl ) ) {
+		fprintf( stderr, "Unable to alloc cflow worklist\n" );
+		opdis_visited_free( targets );
+		batch_term( &batch );
+		opdis_insn_free( insn );
+		return 0;
+	}
+
+	if ( o->cfg ) {
+		opdis_cfg_add_func( o->cfg, vma, NULL );
+	}
+
+	opdis_visited_add( targets, vma );
+	worklist_push( &wl, vma );
+
+	while ( ! batch.stop && worklist_pop( &wl, o->cflow_order, &vma ) ) {
+		opdis_debug( o, 2, "CFLOW BRANCH START: %p", (void *) vma );
+		count += disasm_cflow_run( c, targets, &wl, NULL, &batch, insn,
+					   vma );
+	}
+	ctx_flush( c, &batch );
+
+	worklist_term( &wl );
+	opdis_visited_free( targets );
+	batch_term( &batch );
+	opdis_insn_free( insn );
+
+	return count;
+}
+
+int LIBCALL opdis_disasm_cflow( opdis_t o, opdis_buf_t buf, opdis_vma_t vma ) {
+	opdis_ctx_info_t c;
+
+	if (! o || ! buf  ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	set_ctx_buffer( &c, buf );
+
+	return disasm_cflow( &c, vma );
+}
+
+int LIBCALL opdis_ctx_disasm_cflow( opdis_ctx_t c, opdis_buf_t buf, 
+				    opdis_vma_t vma ) {
+	if (! c || ! buf  ) {
+		return 0;
+	}
+
+	set_ctx_buffer( c, buf );
+
+	return disasm_cflow( c, vma );
 }
 
 /* ---------------------------------------------------------------------- */
@@ -569,31 +1536,140 @@ struct BFD_VMA_SECTION {
 	asection * sec;
 };
 
-static int load_section( opdis_t o, asection * s ) {
-	int size;
+void LIBCALL opdis_set_bfd_image( opdis_t o, bfd * abfd, opdis_buf_t image ) {
+	if ( o ) {
+		o->bfd_image = ( abfd ) ? image : NULL;
+		o->bfd_image_bfd = ( image ) ? abfd : NULL;
+	}
+}
+
+/* return a pointer to the section contents in the file image, or NULL if
+ * the section must be copied out of the BFD */
+static unsigned char * section_in_image( opdis_t o, asection * s, 
+					 bfd_size_type size ) {
+	opdis_buf_t img = o->bfd_image;
+
+	if (! img || s->owner != o->bfd_image_bfd || ! size ) {
+		return NULL;
+	}
+
+	if (! (s->flags & SEC_HAS_CONTENTS) || (s->flags & SEC_IN_MEMORY) ||
+	    bfd_my_archive(s->owner) ) {
+		return NULL;
+	}
+
+	if ( s->filepos < 0 || (opdis_off_t) s->filepos > img->len ||
+	     size > img->len - s->filepos ) {
+		return NULL;
+	}
+
+	return (unsigned char *) &img->data[s->filepos];
+}
+
+void LIBCALL opdis_set_sec_cache( opdis_t o, opdis_sec_cache_t cache ) {
+	if ( o ) {
+		o->sec_cache = cache;
+	}
+}
+
+static int load_section( opdis_ctx_t c, asection * s ) {
+	opdis_t o = c->opdis;
+	int size, owned = 0;
 	unsigned char *buf;
 	opdis_vma_t vma;
 
 	size = bfd_section_size( s->owner, s );
 	vma = bfd_section_vma( s->owner, s );
-	buf = calloc( size, 1 );
-	if (! buf || ! bfd_get_section_contents( s->owner, s, buf, 0, size ) ) {
-		char msg[32];
-		snprintf( msg, 31, "Unable to get section %s\n", s->name );
-		opdis_error( o, opdis_error_bfd, msg );
-		return 0;
+
+	buf = opdis_sec_cache_get( o->sec_cache, s );
+	if ( buf ) {
+		opdis_debug( o, 2, "Section %s found in cache\n", s->name );
+	} else if ( (buf = section_in_image( o, s, size )) ) {
+		opdis_debug( o, 2, "Section %s mapped from file image\n", 
+			     s->name );
+		opdis_sec_cache_put( o->sec_cache, s, buf, 0 );
+	} else {
+		buf = calloc( size, 1 );
+		if (! buf || 
+		    ! bfd_get_section_contents( s->owner, s, buf, 0, size ) ) {
+			char msg[32];
+			snprintf( msg, 31, "Unable to get section %s\n", 
+				  s->name );
+			opdis_error( o, opdis_error_bfd, msg );
+			free( buf );
+			return 0;
+		}
+
+		/* if the cache does not take the buffer, unload frees it */
+		owned = ! opdis_sec_cache_put( o->sec_cache, s, buf, 1 );
 	}
 
 	opdis_debug( o, 2, "Loaded section of %d bytes [%p-%p]\n", size,
 		     (void *) vma, (void *) (vma + size - 1) );
-	o->config.section = s;
-	o->config.buffer = buf;
-	o->config.buffer_length = size;
-	o->config.buffer_vma = vma;
+	c->config->section = s;
+	c->config->buffer = buf;
+	c->config->buffer_length = size;
+	c->config->buffer_vma = vma;
+	c->buffer_owned = owned;
+
+	opdis_visited_cover( c->visited_addr, vma, size );
 
 	return 1;
 }
 
+/* release the buffer set by load_section() */
+static void unload_section( opdis_ctx_t c ) {
+	if ( c->buffer_owned && c->config->buffer ) {
+		free( c->config->buffer );
+	}
+
+	c->config->buffer = NULL;
+	c->buffer_owned = 0;
+}
+
+struct BFD_PRELOAD {
+	opdis_ctx_t c;
+	int ok;
+};
+
+static void preload_section( bfd * abfd, asection *s, PTR data ){
+	struct BFD_PRELOAD * req = (struct BFD_PRELOAD *) data;
+
+	if (! (s->flags & SEC_ALLOC) || ! (s->flags & SEC_HAS_CONTENTS) ||
+	    ! bfd_section_size(abfd, s) ) {
+		return;
+	}
+
+	if (! load_section( req->c, s ) ) {
+		req->ok = 0;
+		return;
+	}
+
+	if ( req->c->buffer_owned ) {
+		/* section did not fit in the cache */
+		req->ok = 0;
+	}
+	unload_section( req->c );
+}
+
+int LIBCALL opdis_preload_bfd_sections( opdis_t o, bfd * abfd ) {
+	opdis_ctx_info_t c;
+	struct BFD_PRELOAD req = { &c, 1 };
+
+	if (! o || ! abfd || ! o->sec_cache || o->sec_cache->abfd != abfd ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	/* nothing is disassembled, so no addresses are visited */
+	c.visited_addr = NULL;
+	bfd_map_over_sections( abfd, preload_section, &req );
+
+	opdis_sec_cache_freeze( o->sec_cache );
+
+	return req.ok;
+}
+
 static void vma_in_section( bfd * abfd, asection *s, PTR data ){
 	struct BFD_VMA_SECTION * req = (struct BFD_VMA_SECTION *) data;
 	if ( req && req->vma >= s->vma && req->vma < 
@@ -602,20 +1678,30 @@ static void vma_in_section( bfd * abfd, asection *s, PTR data ){
 	}
 }
 
-static int load_section_for_vma( opdis_t o, bfd * abfd, bfd_vma vma ){
-	int size;
-	unsigned char * buf;
+static asection * section_for_vma( opdis_t o, bfd * abfd, bfd_vma vma ) {
 	struct BFD_VMA_SECTION req = { vma, NULL };
 
-	bfd_map_over_sections( abfd, vma_in_section, & req );
-	if (! req.sec ) {
+	if ( o->sec_cache && o->sec_cache->abfd == abfd ) {
+		req.sec = opdis_sec_cache_find( o->sec_cache, vma );
+	} else {
+		bfd_map_over_sections( abfd, vma_in_section, & req );
+	}
+
+	return req.sec;
+}
+
+static int load_section_for_vma( opdis_ctx_t c, bfd * abfd, bfd_vma vma ){
+	opdis_t o = c->opdis;
+	asection * sec = section_for_vma( o, abfd, vma );
+
+	if (! sec ) {
 		char msg[32];
 		snprintf( msg, 31, "No section for VMA %p\n", (void *) vma );
 		opdis_error( o, opdis_error_bfd, msg );
 		return 0;
 	}
 
-	if (! load_section( o, req.sec ) ) {
+	if (! load_section( c, sec ) ) {
 		return 0;
 	}
 
@@ -625,102 +1711,102 @@ static int load_section_for_vma( opdis_t o, bfd * abfd, bfd_vma vma ){
 unsigned int LIBCALL opdis_disasm_bfd_insn( opdis_t o, bfd * abfd, 
 					    opdis_vma_t vma, 
 					    opdis_insn_t * insn ) {
+	opdis_ctx_info_t c;
 	size_t size;
 
 	if (! o || ! abfd ) {
 		return 0;
 	}
 
-	if (! load_section_for_vma(o, abfd, vma) ) {
+	ctx_local( &c, o );
+	if (! load_section_for_vma(&c, abfd, vma) ) {
 		return 0;
 	}
 
-	size = disasm_single_insn( o, vma, insn );
-	o->display( insn, o->display_arg );
+	size = disasm_single_insn( &c, vma, insn );
+	display_single( &c, insn );
 
-	free( o->config.buffer );
-	o->config.buffer = NULL;
+	unload_section( &c );
 
 	return size;
 }
 
 int LIBCALL opdis_disasm_bfd_linear( opdis_t o, bfd * abfd, opdis_vma_t vma,
 				     opdis_off_t length ) {
+	opdis_ctx_info_t c;
 	int count;
 	if (! o || ! abfd ) {
 		return 0;
 	}
 
-	if (! load_section_for_vma(o, abfd, vma) ) {
+	ctx_local( &c, o );
+	if (! load_section_for_vma(&c, abfd, vma) ) {
 		return 0;
 	}
 
-	count = disasm_linear( o, vma, length );
+	count = disasm_linear( &c, vma, length );
 
-	free( o->config.buffer );
-	o->config.buffer = NULL;
+	unload_section( &c );
 
 	return count;
 }
 
 int LIBCALL opdis_disasm_bfd_cflow( opdis_t o, bfd * abfd, opdis_vma_t vma ) {
+	opdis_ctx_info_t c;
 	int count;
-	opdis_vma_tree_t tree;
 
 	if (! o || ! abfd ) {
 		return 0;
 	}
 
-	if (! load_section_for_vma(o, abfd, vma) ) {
+	ctx_local( &c, o );
+	if (! load_section_for_vma(&c, abfd, vma) ) {
 		return 0;
 	}
 
-	tree = opdis_vma_tree_init();
+	count = disasm_cflow( &c, vma );
 
-	count = disasm_cflow( o, tree, vma );
-
-	opdis_vma_tree_free( tree );
-
-	free( o->config.buffer );
-	o->config.buffer = NULL;
+	unload_section( &c );
 
 	return count;
 }
 
 
 int LIBCALL opdis_disasm_bfd_section( opdis_t o, asection * sec ) {
+	opdis_ctx_info_t c;
 	int count = 0;
 	if (! o || ! sec ) {
 		return 0;
 	}
 
-	if ( load_section( o, sec ) ) {
-		count = disasm_linear( o, bfd_section_vma(sec->owner, sec), 0 );
-		free( o->config.buffer );
-		o->config.buffer = NULL;
+	ctx_local( &c, o );
+	if ( load_section( &c, sec ) ) {
+		count = disasm_linear( &c, bfd_section_vma(sec->owner, sec), 0 );
+		unload_section( &c );
 	}
 	return count;
 }
 
 
 int LIBCALL opdis_disasm_bfd_symbol( opdis_t o, asymbol * sym ) {
-	int count;
-	opdis_vma_tree_t tree;
-	asection * sec = sym->section;
-	if (! o || ! sym || ! sec ) {
+	opdis_ctx_info_t c;
+	int count = 0;
+	asection * sec;
+	if (! o || ! sym || ! (sec = sym->section) ) {
 		return 0;
 	}
 
-	if ( load_section( o, sec ) ) {
+	ctx_local( &c, o );
+	if ( load_section( &c, sec ) ) {
 		symbol_info info;
 		bfd_symbol_info( sym, &info );
 
-		tree = opdis_vma_tree_init();
-		count = disasm_cflow( o, tree, info.value );
-		opdis_vma_tree_free( tree );
+		if ( o->cfg ) {
+			opdis_cfg_add_func( o->cfg, info.value, info.name );
+		}
+		count = disasm_cflow( &c, info.value );
 
-		free( o->config.buffer );
-		o->config.buffer = NULL;
+		unload_section( &c );
 	}
 	return count;
 }
@@ -733,6 +1819,619 @@ int LIBCALL opdis_disasm_bfd_entry( opdis_t o, bfd * abfd ) {
 	return opdis_disasm_bfd_cflow( o, abfd, bfd_get_start_address(abfd) );
 }
 
+/* Control flow disassembly of every address in pending, and of every branch
+ * target reachable from them in any section of abfd. The sets of branch
+ * targets and of visited insns are shared by all sections, so code reached
+ * from several start addresses is only decoded once. */
+static int disasm_program( opdis_ctx_t c, bfd * abfd,
+			   cflow_worklist_t * pending ) {
+	opdis_t o = c->opdis;
+	opdis_visited_t targets, visited = NULL;
+	cflow_worklist_t wl;
+	opdis_insn_t * insn;
+	insn_batch_t batch;
+	unsigned int count = 0;
+	opdis_vma_t vma;
+
+	insn = alloc_fixed_insn( c );
+	if (! insn || ! batch_init( c, &batch ) ) {
+		fprintf( stderr, "Unable to alloc insn\n" );
+		opdis_insn_free( insn );
+		return 0;
+	}
+
+	targets = opdis_visited_init();
+	if (! c->visited_addr ) {
+		/* without a visited set, runs would overlap */
+		c->visited_addr = visited = opdis_visited_init();
+	}
+	if (! targets || ! c->visited_addr || ! worklist_init( &wl ) ) {
+		fprintf( stderr, "Unable to alloc cflow worklist\n" );
+		opdis_visited_free( targets );
+		opdis_visited_free( visited );
+		c->visited_addr = NULL;
+		batch_term( &batch );
+		opdis_insn_free( insn );
+		return 0;
+	}
+
+	/* start addresses are taken in order; then targets in other
+	 * sections, in the order they are found */
+	while ( ! batch.stop && 
+		worklist_pop( pending, opdis_cflow_order_bfs, &vma ) ) {
+		opdis_vma_t start, end;
+		asection * sec;
+		size_t i;
+
+		if ( opdis_visited_contains( targets, vma ) ) {
+			continue;
+		}
+
+		/* branches into the PLT or other unmapped areas are normal:
+		 * each pending address is only seen here once */
+		sec = section_for_vma( o, abfd, vma );
+		if (! sec ) {
+			opdis_debug( o, 1, "No section for VMA %p",
+				     (void *) vma );
+			continue;
+		}
+		if (! load_section( c, sec ) ) {
+			continue;
+		}
+
+		start = c->config->buffer_vma;
+		end = start + c->config->buffer_length;
+		opdis_visited_cover( targets, start, c->config->buffer_length );
+		opdis_debug( o, 1, "Start program section %p-%p", 
+			     (void *) start, (void *) end );
+
+		/* disassemble all pending addresses in the section while it
+		 * is loaded */
+		opdis_visited_add( targets, vma );
+		worklist_push( &wl, vma );
+		for ( i = pending->head; i < pending->tail; i++ ) {
+			vma = pending->vma[i];
+			if ( vma >= start && vma < end &&
+			     opdis_visited_add( targets, vma ) ) {
+				worklist_push( &wl, vma );
+			}
+		}
+
+		while ( ! batch.stop && 
+			worklist_pop( &wl, o->cflow_order, &vma ) ) {
+			opdis_debug( o, 2, "CFLOW BRANCH START: %p", 
+				     (void *) vma );
+			count += disasm_cflow_run( c, targets, &wl, pending, 
+						   &batch, insn, vma );
+		}
+		/* insns in the batch which borrow their bytes point into the
+		 * section: they are displayed before it goes */
+		if ( o->borrow_bytes ) {
+			ctx_flush( c, &batch );
+		}
+		unload_section( c );
+	}
+	ctx_flush( c, &batch );
+
+	worklist_term( &wl );
+	opdis_visited_free( targets );
+	if ( visited ) {
+		opdis_visited_free( visited );
+		c->visited_addr = NULL;
+	}
+	batch_term( &batch );
+	opdis_insn_free( insn );
+
+	return count;
+}
+
+int LIBCALL opdis_disasm_bfd_program( opdis_t o, bfd * abfd,
+				      const opdis_vma_t * vmas, size_t num ) {
+	opdis_ctx_info_t c;
+	cflow_worklist_t pending;
+	size_t i;
+	int count;
+
+	if (! o || ! abfd || ! worklist_init( &pending ) ) {
+		return 0;
+	}
+
+	/* addresses are only queued once, as start addresses or as branch
+	 * targets in other sections */
+	pending.queued = opdis_visited_init();
+	if (! pending.queued ) {
+		worklist_term( &pending );
+		return 0;
+	}
+
+	opdis_visited_add( pending.queued, bfd_get_start_address( abfd ) );
+	worklist_push( &pending, bfd_get_start_address( abfd ) );
+	for ( i = 0; vmas && i < num; i++ ) {
+		if (! opdis_visited_add( pending.queued, vmas[i] ) ) {
+			continue;
+		}
+		if (! worklist_push( &pending, vmas[i] ) ) {
+			opdis_error( o, opdis_error_unknown, 
+				     "Unable to grow cflow worklist" );
+			break;
+		}
+	}
+
+	if ( o->cfg ) {
+		for ( i = pending.head; i < pending.tail; i++ ) {
+			opdis_cfg_add_func( o->cfg, pending.vma[i], NULL );
+		}
+	}
+
+	ctx_local( &c, o );
+	count = disasm_program( &c, abfd, &pending );
+
+	worklist_term( &pending );
+	return count;
+}
+
+
+/* ---------------------------------------------------------------------- */
+/* Signatures */
+
+static unsigned int disasm_invariant( opdis_ctx_t c, opdis_vma_t vma,
+				      opdis_insn_t * insn,
+				      opdis_insn_sig_t * sig ) {
+	unsigned int size = disasm_single_insn( c, vma, insn );
+
+	if ( size && ! opdis_insn_signature( insn,
+				c->config->endian == BFD_ENDIAN_BIG, sig ) ) {
+		/* insn has no signature: it only matches itself */
+		memset( sig, 0, sizeof(opdis_insn_sig_t) );
+	}
+
+	return size;
+}
+
+unsigned int LIBCALL opdis_disasm_invariant( opdis_t o, opdis_buf_t buf,
+					     opdis_vma_t vma,
+					     opdis_insn_t * insn,
+					     opdis_insn_sig_t * sig ) {
+	opdis_ctx_info_t c;
+
+	if (! o || ! buf || ! insn || ! sig ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	set_ctx_buffer( &c, buf );
+	return disasm_invariant( &c, vma, insn, sig );
+}
+
+/* An insn of a linear sweep, as needed to hash basic blocks */
+typedef struct {
+	opdis_vma_t	vma;
+	opdis_off_t	size;
+	uint64_t	hash;
+	int		ends_block;
+} sig_insn_t;
+
+static int add_sig_block( opdis_sig_index_t index, uint64_t hash,
+			  const sig_insn_t * first, const sig_insn_t * last,
+			  unsigned int num_insns ) {
+	return opdis_sig_index_add( index, hash, first->vma,
+				    last->vma + last->size - first->vma,
+				    num_insns );
+}
+
+/* Linear sweep from vma, adding each basic block to the index. Blocks end
+ * after a control-flow insn and before the target of a branch, so two
+ * passes are made: one to decode insns and collect branch targets, and one
+ * to hash the blocks. */
+static int sig_index_build( opdis_ctx_t c, opdis_vma_t vma,
+			    opdis_off_t length, opdis_sig_index_t index ) {
+	opdis_t o = c->opdis;
+	opdis_off_t pos = vma;
+	opdis_off_t max_pos = c->config->buffer_vma + c->config->buffer_length;
+	sig_insn_t * recs = NULL;
+	size_t i, num = 0, alloc = 0, start = 0;
+	opdis_visited_t targets;
+	opdis_insn_sig_t sig;
+	opdis_insn_t * insn;
+	uint64_t hash = OPDIS_SIG_HASH_INIT;
+	int count = 0;
+
+	if ( length && vma + length < max_pos ) {
+		max_pos = vma + length;
+	}
+
+	insn = alloc_fixed_insn( c );
+	targets = opdis_visited_init_bitmap( c->config->buffer_vma,
+					     c->config->buffer_length );
+	if (! insn || ! targets ) {
+		fprintf( stderr, "Unable to alloc insn\n" );
+		opdis_insn_free( insn );
+		opdis_visited_free( targets );
+		return 0;
+	}
+
+	opdis_debug( o, 1, "Start signatures from %p max %p", (void *) vma,
+		     (void *) max_pos );
+
+	while ( pos < max_pos ) {
+		unsigned int size = disasm_invariant( c, pos, insn, &sig );
+		if (! size || pos + size > max_pos ) {
+			break;
+		}
+
+		if ( num == alloc ) {
+			size_t n = ( alloc ) ? alloc * 2 : 1024;
+			sig_insn_t * ptr = (sig_insn_t *) realloc( recs,
+						n * sizeof(sig_insn_t) );
+			if (! ptr ) {
+				fprintf( stderr, "Unable to alloc signatures\n" );
+				break;
+			}
+			recs = ptr;
+			alloc = n;
+		}
+
+		recs[num].vma = pos;
+		recs[num].size = size;
+		recs[num].hash = opdis_insn_sig_hash( &sig );
+		recs[num].ends_block = ( insn->status == opdis_decode_invalid ||
+					 insn->category == opdis_insn_cat_cflow );
+		num++;
+
+		if ( insn->target &&
+		     insn->target->category == opdis_op_cat_immediate ) {
+			opdis_visited_add( targets,
+					   insn->target->value.immediate.vma );
+		}
+
+		pos += size;
+	}
+
+	for ( i = 0; i < num; i++ ) {
+		if ( i > start && opdis_visited_contains( targets,
+							  recs[i].vma ) ) {
+			/* a branch target starts a new block */
+			count += add_sig_block( index, hash, &recs[start],
+						&recs[i - 1], i - start );
+			hash = OPDIS_SIG_HASH_INIT;
+			start = i;
+		}
+
+		hash = OPDIS_SIG_ROLL( hash, recs[i].hash );
+
+		if ( recs[i].ends_block ) {
+			count += add_sig_block( index, hash, &recs[start],
+						&recs[i], i + 1 - start );
+			hash = OPDIS_SIG_HASH_INIT;
+			start = i + 1;
+		}
+	}
+	if ( start < num ) {
+		count += add_sig_block( index, hash, &recs[start],
+					&recs[num - 1], num - start );
+	}
+
+	opdis_debug( o, 1, "End signatures %p (%lu insns, %d blocks)",
+		     (void *) vma, (unsigned long) num, count );
+
+	free( recs );
+	opdis_visited_free( targets );
+	opdis_insn_free( insn );
+
+	return count;
+}
+
+int LIBCALL opdis_sig_index_build( opdis_t o, opdis_buf_t buf,
+				   opdis_vma_t vma, opdis_off_t length,
+				   opdis_sig_index_t index ) {
+	opdis_ctx_info_t c;
+
+	if (! o || ! buf || ! index ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	set_ctx_buffer( &c, buf );
+	return sig_index_build( &c, vma, length, index );
+}
+
+int LIBCALL opdis_sig_index_bfd_section( opdis_t o, asection * sec,
+					 opdis_sig_index_t index ) {
+	opdis_ctx_info_t c;
+	int count = 0;
+
+	if (! o || ! sec || ! index ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	if ( load_section( &c, sec ) ) {
+		count = sig_index_build( &c, bfd_section_vma(sec->owner, sec),
+					 0, index );
+		unload_section( &c );
+	}
+	return count;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Parallel linear disassembly */
+
+#ifdef HAVE_PTHREAD_H
+
+/* Number of bytes decoded by each thread in one pass. This is a multiple of
+ * the instruction size of all fixed-width ISAs, so for those every shard
+ * starts on an instruction boundary. */
+#define PARALLEL_SHARD_SIZE 0x10000
+
+/* A shard of a linear disassembly: the instructions decoded from a range of
+ * the buffer, packed back-to-back as opdis_insn_rec_t records */
+typedef struct {
+	opdis_ctx_t ctx;
+	opdis_vma_t start;
+	opdis_vma_t end;
+	unsigned char * recs;
+	size_t len;
+	size_t alloc;
+	opdis_stats_t stats;	/* stats of the shard thread */
+} linear_shard_t;
+
+static int shard_append( linear_shard_t * s, const opdis_insn_t * insn ) {
+	size_t size = opdis_insn_rec_size( insn );
+
+	if (! size ) {
+		return 0;
+	}
+
+	if ( s->len + size > s->alloc ) {
+		size_t alloc = ( s->alloc ) ? s->alloc * 2 : 4096;
+		void * ptr;
+
+		while ( alloc < s->len + size ) {
+			alloc *= 2;
+		}
+		/* malloc alignment satisfies the 8-byte record alignment */
+		ptr = realloc( s->recs, alloc );
+		if (! ptr ) {
+			return 0;
+		}
+		s->recs = (unsigned char *) ptr;
+		s->alloc = alloc;
+	}
+
+	s->len += opdis_insn_pack( insn, s->recs + s->len, s->alloc - s->len );
+	return 1;
+}
+
+/* decode a shard; no callbacks other than the decoder are invoked */
+static void * decode_shard( void * arg ) {
+	linear_shard_t * s = (linear_shard_t *) arg;
+	opdis_insn_t * insn = alloc_fixed_insn( s->ctx );
+	opdis_vma_t pos = s->start;
+
+	s->len = 0;
+	while ( insn && pos < s->end ) {
+		unsigned int size = disasm_single_insn( s->ctx, pos, insn );
+		if (! size || ! shard_append( s, insn ) ) {
+			break;
+		}
+		pos += size;
+	}
+
+	opdis_insn_free( insn );
+	return NULL;
+}
+
+/* Emit the instructions of a shard from *pos onwards, as disasm_linear
+ * would. Records are only used once *pos reaches one of them; before that,
+ * the shard is out of step with the instruction sequence and instructions
+ * are decoded again. Returns 0 if disassembly is to stop. */
+static int emit_shard( opdis_ctx_t c, linear_shard_t * s, insn_batch_t * b,
+		       opdis_insn_t * ring_insn, opdis_vma_t * pos,
+		       opdis_vma_t max_pos, unsigned int * count ) {
+	opdis_t o = c->opdis;
+	const opdis_insn_rec_t * rec = (const opdis_insn_rec_t *) s->recs;
+	const unsigned char * end = s->recs + s->len;
+
+	while ( *pos < s->end ) {
+		opdis_insn_t * insn = batch_insn( b, ring_insn );
+		unsigned int size;
+
+		while ( (const unsigned char *) rec < end && rec->vma < *pos ) {
+			rec = opdis_insn_rec_next( rec );
+		}
+
+		if ( (const unsigned char *) rec < end && rec->vma == *pos &&
+		     opdis_insn_rec_fill( rec, insn ) ) {
+			size = rec->size;
+			rec = opdis_insn_rec_next( rec );
+			if ( insn->borrow_bytes ) {
+				/* the shard is reused: borrow from the buffer */
+				insn->bytes = c->config->buffer + 
+					      ( *pos - c->config->buffer_vma );
+			}
+		} else {
+			size = disasm_single_insn( c, *pos, insn );
+		}
+
+		*pos += size;
+		if ( *pos > max_pos ) {
+			opdis_debug( o, 1, "Instruction at %p exceeds buffer", 
+				    (void *) ( *pos - size ) );
+			return 0;
+		}
+		(*count)++;
+		if (! ctx_display( c, b, insn ) ) {
+			return 0;
+		}
+		if (! ctx_handler( c, insn ) || ! size ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int disasm_linear_parallel( opdis_ctx_t c, opdis_vma_t vma,
+				   opdis_off_t length,
+				   unsigned int num_threads ) {
+	opdis_t o = c->opdis;
+	linear_shard_t * shards;
+	opdis_insn_t * insn;
+	insn_batch_t batch;
+	unsigned int i, count = 0;
+	int cont = 1;
+	opdis_vma_t pos = vma;
+	opdis_vma_t max_pos = c->config->buffer_vma + c->config->buffer_length;
+
+	if ( length && vma + length < max_pos ) {
+		max_pos = vma + length;
+	}
+
+	shards = (linear_shard_t *) calloc( num_threads, 
+					    sizeof(linear_shard_t) );
+	insn = alloc_fixed_insn( c );
+	if (! shards || ! insn || ! batch_init( c, &batch ) ) {
+		fprintf( stderr, "Unable to alloc shards\n" );
+		free( shards );
+		opdis_insn_free( insn );
+		return 0;
+	}
+
+	for ( i = 0; i < num_threads; i++ ) {
+		opdis_ctx_t sc = opdis_ctx_init( o );
+		if (! sc ) {
+			break;
+		}
+		/* shard contexts share the buffer but not the visited set */
+		sc->config->buffer = c->config->buffer;
+		sc->config->buffer_length = c->config->buffer_length;
+		sc->config->buffer_vma = c->config->buffer_vma;
+		sc->config->section = c->config->section;
+		if ( c->stats ) {
+			sc->stats = &shards[i].stats;
+		}
+		shards[i].ctx = sc;
+	}
+	num_threads = i;
+
+	if (! num_threads ) {
+		/* no shard contexts: decode on the calling thread */
+		opdis_debug( o, 1, "Unable to alloc shard contexts" );
+		free( shards );
+		batch_term( &batch );
+		opdis_insn_free( insn );
+		return disasm_linear( c, vma, length );
+	}
+
+	opdis_debug( o, 1, "Start parallel linear from %p max %p (%d threads)",
+		     (void *) vma, (void *) max_pos, num_threads );
+
+	while ( cont && pos < max_pos ) {
+		pthread_t * threads;
+		unsigned int started;
+
+		/* the first shard starts on the next insn; the rest are
+		 * placed at fixed distances from it */
+		for ( i = 0; i < num_threads; i++ ) {
+			opdis_vma_t start = pos + (opdis_vma_t) i * 
+						  PARALLEL_SHARD_SIZE;
+			shards[i].start = ( start < max_pos ) ? start : max_pos;
+			shards[i].end = ( max_pos - shards[i].start > 
+					  PARALLEL_SHARD_SIZE ) ?
+					shards[i].start + PARALLEL_SHARD_SIZE :
+					max_pos;
+		}
+
+		threads = (pthread_t *) calloc( num_threads, sizeof(pthread_t) );
+		for ( started = 1; threads && started < num_threads; 
+		      started++ ) {
+			if ( pthread_create( &threads[started], NULL, 
+					     decode_shard, &shards[started] ) ){
+				break;
+			}
+		}
+		/* the calling thread decodes the first shard */
+		decode_shard( &shards[0] );
+		for ( i = 1; threads && i < started; i++ ) {
+			pthread_join( threads[i], NULL );
+		}
+		free( threads );
+
+		/* shards which were not decoded are decoded while emitting */
+		for ( i = started; i < num_threads; i++ ) {
+			shards[i].len = 0;
+		}
+
+		for ( i = 0; cont && i < num_threads; i++ ) {
+			cont = emit_shard( c, &shards[i], &batch, insn, &pos,
+					   max_pos, &count );
+		}
+	}
+	ctx_flush( c, &batch );
+
+	opdis_debug( o, 1, "End parallel linear %p (count %d)", (void *) vma,
+		     count );
+
+	for ( i = 0; i < num_threads; i++ ) {
+		opdis_stats_add( c->stats, &shards[i].stats );
+		opdis_ctx_free( shards[i].ctx );
+		free( shards[i].recs );
+	}
+	free( shards );
+	batch_term( &batch );
+	opdis_insn_free( insn );
+
+	return count;
+}
+
+#else
+
+/* built without thread support: decode on the calling thread */
+static int disasm_linear_parallel( opdis_ctx_t c, opdis_vma_t vma,
+				   opdis_off_t length,
+				   unsigned int num_threads ) {
+	return disasm_linear( c, vma, length );
+}
+
+#endif
+
+int LIBCALL opdis_disasm_linear_parallel( opdis_t o, opdis_buf_t buf,
+					  opdis_vma_t vma, opdis_off_t length,
+					  unsigned int num_threads ) {
+	opdis_ctx_info_t c;
+
+	if (! o || ! buf  ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	set_ctx_buffer( &c, buf );
+
+	if ( num_threads <= 1 ) {
+		return disasm_linear( &c, vma, length );
+	}
+
+	return disasm_linear_parallel( &c, vma, length, num_threads );
+}
+
+int LIBCALL opdis_disasm_bfd_section_parallel( opdis_t o, asection * sec,
+					       unsigned int num_threads ) {
+	opdis_ctx_info_t c;
+	int count = 0;
+	if (! o || ! sec ) {
+		return 0;
+	}
+
+	ctx_local( &c, o );
+	if ( load_section( &c, sec ) ) {
+		opdis_vma_t vma = bfd_section_vma(sec->owner, sec);
+		count = ( num_threads <= 1 ) ? disasm_linear( &c, vma, 0 ) :
+			disasm_linear_parallel( &c, vma, 0, num_threads );
+		unload_section( &c );
+	}
+	return count;
+}
+
 
 /* ---------------------------------------------------------------------- */
 void LIBCALL opdis_error( opdis_t o, enum opdis_error_t error, 
@@ -17,6 +17,12 @@
 #include <opdis/insn_buf.h>
 #include <opdis/model.h>
 #include <opdis/tree.h>
+#include <opdis/sec_cache.h>
+#include <opdis/cfg.h>
+#include <opdis/decode_cache.h>
+#include <opdis/signature.h>
+#include <opdis/stats.h>
+#include <opdis/visited.h>
 
 #ifdef WIN32
         #define LIBCALL _stdcall
@@ -88,6 +94,35 @@ typedef void (*OPDIS_DISPLAY) ( const opdis_insn_t * i, void * arg );
  */
 void opdis_default_display ( const opdis_insn_t * i, void * arg );
 
+/*!
+ * \typedef int (*OPDIS_BATCH_HANDLER) ( const opdis_insn_t * insns, size_t n,
+ * 				       void * arg )
+ * \ingroup configuration
+ * \brief Callback used to display or store a batch of instructions.
+ * \param insns Array of the most recently disassembled instructions, in
+ *              the order they were disassembled.
+ * \param n Number of instructions in \e insns.
+ * \param arg Argument provided when the callback is set
+ * \return 0 if disassembly should halt, nonzero (1) otherwise.
+ * \details If set, this is invoked instead of the display callback. The
+ *          linear and control flow algorithms decode instructions into a
+ *          ring of preallocated instructions, and pass the ring to the
+ *          callback whenever it is full and when disassembly ends.
+ * \note As with the display callback, the caller must copy any instruction
+ *       that it is going to store; the ring is reused after the callback
+ *       returns.
+ * \sa opdis_set_batch_handler
+ */
+typedef int (*OPDIS_BATCH_HANDLER) ( const opdis_insn_t * insns, size_t n,
+				     void * arg );
+
+/*!
+ * \def OPDIS_BATCH_SIZE
+ * \ingroup configuration
+ * \brief Default number of instructions passed to a batch handler.
+ */
+#define OPDIS_BATCH_SIZE 256
+
 /*!
  * \typedef int (*OPDIS_DECODER) ( const opdis_insn_buf_t, opdis_insn_t *,
 			           opdis_byte_t *, opdis_off_t, opdis_vma_t, 
@@ -207,17 +242,49 @@ typedef void (*OPDIS_ERROR) ( enum opdis_error_t error, const char * msg,
 void opdis_default_error_reporter( enum opdis_error_t error, const char * msg,
 			      void * arg );
 
+/*!
+ * \enum opdis_cflow_order_t
+ * \ingroup configuration
+ * \brief Order in which control-flow disassembly visits branch targets.
+ * \details Branch targets found during control-flow disassembly are stored
+ *          in a worklist, and the current run of instructions always
+ *          ends before the next target is disassembled. Depth-first order
+ *          then disassembles the most recently found target; breadth-first
+ *          order disassembles targets in the order they were found, which
+ *          tends to stay within a region of the buffer for longer.
+ */
+enum opdis_cflow_order_t {
+	opdis_cflow_order_dfs,		/*!< Depth-first (LIFO) */
+	opdis_cflow_order_bfs		/*!< Breadth-first (FIFO) */
+};
+
+/*!
+ * \struct opdis_insn_sizes_t
+ * \ingroup configuration
+ * \brief Field sizes of the fixed-size instructions used by an architecture.
+ * \sa opdis_insn_sizes opdis_insn_alloc_fixed_bytes
+ */
+typedef struct {
+	unsigned char bytes_sz;		/*!< Maximum size of an insn */
+	unsigned char ascii_sz;		/*!< Size of ascii and comment fields */
+	unsigned char mnemonic_sz;	/*!< Size of mnemonic field */
+	unsigned char num_operands;	/*!< Number of operands */
+	unsigned char op_ascii_sz;	/*!< Size of operand ascii field */
+} opdis_insn_sizes_t;
+
 /* ---------------------------------------------------------------------- */
 
 /*!
  * \struct opdis_info_t
  * \ingroup configuration
  * \brief An opdis disassembler
- * \note The \e visited_addr tree is NULL by default. Both 
- *       opdis_disasm_cflow and opdis_disasm_bfd_cflow create this tree
- *       if \e visited_addr is NULL. This means that linear disassembly
- *       will not check if an address exists before invoking the display
- *       callback.
+ * \note The \e visited_addr set is NULL by default. This means that
+ *       the default handler will not check if an address has already
+ *       been disassembled before the display callback is invoked. The
+ *       control-flow disassembly functions always track the branch
+ *       targets they have visited in a bitmap covering the buffer.
+ * \note An opdis_t must not be used to disassemble in several threads at
+ *       once; use a decode context (opdis_ctx_t) per thread instead.
  */
 typedef struct {
 	/*! \var config
@@ -262,6 +329,18 @@ typedef struct {
 	OPDIS_DECODER decoder;
 	void * decoder_arg;
 
+	/*! \var decode_mask
+	 *  \brief Levels of decoding requested from the decoder.
+	 *  \details See opdis_set_decode_mask.
+	 */
+	enum opdis_insn_decode_t decode_mask;
+
+	/*! \var borrow_bytes
+	 *  \brief Do disassembled instructions point into the buffer?
+	 *  \details See opdis_set_borrow_bytes.
+	 */
+	int borrow_bytes;
+
 	/*! \var buf
 	 *  \brief buffer for storing libopcodes strings as they are emitted.
 	 */
@@ -270,17 +349,78 @@ typedef struct {
 
 	/*! \var visited_addr
 	 *  \brief Index of all VMAs that have been disassembled and displayed.
-	 *  \details A tree of all instructions that have been disassembled.
+	 *  \details A set of all instructions that have been disassembled.
 	 *   If this is non-NULL, the default handler will check if the VMA
-	 *   for the current instruction is in the tree. If not, the instruction
-	 *   is added to the tree and the handler returns 1 (i.e. instruction
+	 *   for the current instruction is in the set. If not, the instruction
+	 *   is added to the set and the handler returns 1 (i.e. instruction
 	 *   will be displayed). Otherwise, the handler returns 0 (do not
 	 *   display the instruction, and stop disassembly).
-	 *   \note Use of the visited addresses tree will ensure that no
-	 *         duplicate instructions are emitted, but will noticably 
-	 *         slow down disassembly.
+	 *   \note The set returned by opdis_visited_init() is a bitmap which
+	 *         is extended to cover each buffer as it is disassembled;
+	 *         use opdis_visited_init_tree() for sparse address spaces.
+	 */
+	opdis_visited_t visited_addr;
+
+	/*! \var cflow_order
+	 *  \brief Order in which control-flow disassembly visits branch targets
+	 */
+	enum opdis_cflow_order_t cflow_order;
+
+	/*! \var bfd_image
+	 *  \brief Contents of the file backing \e bfd_image_bfd.
+	 *  \details If set, sections of \e bfd_image_bfd are disassembled in
+	 *   place instead of being copied out of the BFD.
+	 *   See opdis_set_bfd_image.
 	 */
-	opdis_vma_tree_t visited_addr;
+	opdis_buf_t bfd_image;
+	bfd * bfd_image_bfd;
+
+	/*! \var sec_cache
+	 *  \brief Section index and contents cache for BFD disassembly.
+	 *  \details If set, the BFD routines use the cache to locate the
+	 *   section containing a VMA, and re-use section contents loaded by
+	 *   earlier calls. See opdis_set_sec_cache.
+	 */
+	opdis_sec_cache_t sec_cache;
+
+	/*! \var decode_cache
+	 *  \brief Cache of decoded instructions, keyed by instruction bytes.
+	 *  \details If set, instructions whose encoding is in the cache are
+	 *   filled from it rather than being decoded. See 
+	 *   opdis_set_decode_cache.
+	 */
+	opdis_decode_cache_t decode_cache;
+
+	/*! \var decode_cache_key
+	 *  \brief Hash of the configuration which cached decodes depend on.
+	 *  \details This is updated by the opdis_set routines which change
+	 *   the architecture, syntax, options, decoder or decode mask, and by
+	 *   opdis_set_decode_cache.
+	 */
+	uint64_t decode_cache_key;
+
+	/*! \var cfg
+	 *  \brief Control flow graph filled by control flow disassembly.
+	 *  \details If set, every instruction displayed during control flow
+	 *   disassembly is recorded in the graph. See opdis_set_cfg.
+	 */
+	opdis_cfg_t cfg;
+
+	/*! \var batch
+	 *  \brief callback to display or store batches of instructions
+	 *  \details If set, this replaces \e display. See
+	 *   opdis_set_batch_handler.
+	 */
+	OPDIS_BATCH_HANDLER batch;
+	void * batch_arg;
+	size_t batch_size;
+
+	/*! \var stats
+	 *  \brief Counters and phase timers updated during disassembly.
+	 *  \details If NULL (the default), no statistics are collected. See
+	 *   opdis_set_stats.
+	 */
+	opdis_stats_t * stats;
 
 	/*! \var debug
 	 *  \brief Print debug info to STDERR
@@ -296,6 +436,79 @@ typedef struct {
 
 typedef opdis_info_t * opdis_t;
 
+/*!
+ * \struct opdis_ctx_info_t
+ * \ingroup disassembly
+ * \brief Per-thread decode state for an opdis disassembler.
+ * \details An opdis_t holds the configuration of a disassembler (the
+ *          architecture, libopcodes options and callbacks) as well as the
+ *          state of the current decode: the buffer being disassembled, the
+ *          libopcodes output, and the visited addresses. A decode context
+ *          holds its own copy of this state, so that one configured opdis_t
+ *          can be shared by several threads, each of which disassembles
+ *          with its own context. The opdis_t is not modified by the
+ *          opdis_ctx routines.
+ * \note The callbacks of the opdis_t are invoked from every thread using
+ *       it; they, and their arguments, must be thread-safe.
+ */
+typedef struct {
+	/*! \var opdis
+	 *  \brief The shared, read-only disassembler configuration.
+	 */
+	opdis_t opdis;
+
+	/*! \var config
+	 *  \brief libopcodes state used by this context.
+	 *  \details This points to \e info for a context created with
+	 *   opdis_ctx_init.
+	 */
+	disassemble_info * config;
+
+	/*! \var info
+	 *  \brief Private copy of the libopcodes configuration structure.
+	 */
+	disassemble_info info;
+
+	/*! \var buf
+	 *  \brief buffer for storing libopcodes strings as they are emitted.
+	 */
+	opdis_insn_buf_t buf;
+
+	/*! \var visited_addr
+	 *  \brief Index of all VMAs disassembled and displayed by this context.
+	 *  \details This replaces the \e visited_addr of the opdis_t when the
+	 *   default handler is used. It is NULL by default.
+	 */
+	opdis_visited_t visited_addr;
+
+	/*! \var stats
+	 *  \brief Counters and phase timers updated by this context.
+	 *  \details This is NULL for a context created with opdis_ctx_init;
+	 *   as the stats object is not threadsafe, each thread should use
+	 *   its own, to be merged with opdis_stats_add.
+	 */
+	opdis_stats_t * stats;
+
+	/*! \var buffer_owned
+	 *  \brief Set if the loaded section buffer must be freed on unload.
+	 */
+	int buffer_owned;
+
+	/*! \var fetched
+	 *  \brief End (VMA) of the bytes read by libopcodes while decoding
+	 *   the current instruction.
+	 */
+	opdis_vma_t fetched;
+} opdis_ctx_info_t;
+
+/*!
+ * \typedef opdis_ctx_info_t * opdis_ctx_t
+ * \ingroup disassembly
+ * \brief Decode context handle (pointer to opdis_ctx_info_t).
+ */
+
+typedef opdis_ctx_info_t * opdis_ctx_t;
+
 /* ---------------------------------------------------------------------- */
 
 /*!
@@ -401,9 +614,22 @@ enum opdis_x86_syntax_t {
  * \param o opdis disassembler to configure.
  * \param syntax The syntax option to use.
  * \note This only applies to x86 disassemblers.
+ * \note The decoder is set to opdis_x86_intel_decoder or
+ *       opdis_x86_att_decoder, unless it is opdis_x86_native_decoder,
+ *       which supports both syntaxes.
  */
 void LIBCALL opdis_set_x86_syntax( opdis_t o, enum opdis_x86_syntax_t syntax );
 
+/*!
+ * \fn opdis_get_x86_syntax( opdis_t )
+ * \ingroup configuration
+ * \brief Return the syntax of an x86 disassembler.
+ * \param o opdis disassembler.
+ * \return opdis_x86_syntax_intel if the disassembler is
+ *         print_insn_i386_intel, otherwise opdis_x86_syntax_att.
+ */
+enum opdis_x86_syntax_t LIBCALL opdis_get_x86_syntax( opdis_t o );
+
 /*!
  * \fn opdis_set_arch( opdis_t, enum bfd_architecture, unsigned long mach,
  * 		       disassembler_ftype )
@@ -501,9 +727,73 @@ void LIBCALL opdis_set_handler( opdis_t o, OPDIS_HANDLER fn, void * arg );
  * \param o opdis disassembler to configure.
  * \param fn The callback function.
  * \param arg An optional argument to pass to the callback function.
+ * \note Setting opdis_x86_native_decoder (with \e o as \e arg) on an x86
+ *       disassembler decodes instructions from their bytes, bypassing
+ *       libopcodes for the encodings it supports. The ASCII version of
+ *       those instructions is generated just before they are passed to
+ *       the display, batch or handler callback, and every level of
+ *       decoding is always performed.
  */
 void LIBCALL opdis_set_decoder( opdis_t o, OPDIS_DECODER fn, void * arg );
 
+/*!
+ * \fn opdis_set_decode_mask( opdis_t, enum opdis_insn_decode_t )
+ * \ingroup configuration
+ * \brief Set the levels of decoding performed for each instruction.
+ * \details By default (OPDIS_DECODE_ALL), the decoder fills every field of
+ *          an opdis_insn_t. A caller which only uses some of the fields can
+ *          request less: e.g. opdis_decode_basic for just the ASCII string
+ *          and bytes, or OPDIS_DECODE_CFLOW for control flow disassembly.
+ *          The mask is passed to the decoder in the \e decode_mask field
+ *          of the opdis_insn_buf_t; the built-in x86 decoders skip the
+ *          levels which are not requested. The \e status field of each
+ *          instruction reports the levels which were decoded.
+ * \param o opdis disassembler to configure.
+ * \param mask Bitwise OR of opdis_insn_decode_t values.
+ * \note opdis_decode_basic is always included. Requesting
+ *       opdis_decode_mnem_flags implies opdis_decode_mnem, and requesting
+ *       opdis_decode_op_flags implies opdis_decode_ops.
+ * \note The default resolver needs OPDIS_DECODE_CFLOW to find branch
+ *       targets.
+ */
+void LIBCALL opdis_set_decode_mask( opdis_t o, enum opdis_insn_decode_t mask );
+
+/*!
+ * \fn opdis_set_borrow_bytes( opdis_t, int )
+ * \ingroup configuration
+ * \brief Set whether disassembled instructions copy their bytes.
+ * \details By default, the bytes of each instruction are copied into the
+ *          \e bytes field of the opdis_insn_t. If \e enabled is nonzero,
+ *          the instructions which opdis allocates for linear, control flow
+ *          and BFD disassembly have \e borrow_bytes set: \e bytes points
+ *          into the opdis_buf_t being disassembled, and no bytes are copied
+ *          until the instruction is duplicated with opdis_insn_dupe.
+ * \param o opdis disassembler to configure.
+ * \param enabled 1 to borrow the bytes of instructions, 0 to copy them.
+ * \note The \e bytes field of a borrowed instruction is only valid as long
+ *       as the buffer is. A display or batch callback which keeps an
+ *       instruction must duplicate it.
+ * \note Instructions passed to opdis_disasm_insn keep the \e borrow_bytes
+ *       setting they were allocated with.
+ */
+void LIBCALL opdis_set_borrow_bytes( opdis_t o, int enabled );
+
+/*!
+ * \fn opdis_insn_sizes( enum bfd_architecture )
+ * \ingroup configuration
+ * \brief Return the field sizes of fixed-size instructions for an
+ *        architecture.
+ * \details These are the sizes used for the instructions allocated by the
+ *          disassembly functions: e.g. 16 bytes for an x86 instruction, but
+ *          4 bytes for an instruction of most RISC architectures.
+ *          Architectures without an entry use conservative sizes.
+ * \param arch A BFD architecture.
+ * \return The field sizes for \e arch.
+ * \sa opdis_insn_alloc_fixed_bytes
+ */
+const opdis_insn_sizes_t * LIBCALL opdis_insn_sizes( enum bfd_architecture 
+						     arch );
+
 /*!
  * \fn opdis_set_resolver( opdis_t, OPDIS_RESOLVER, void * )
  * \ingroup configuration
@@ -534,6 +824,108 @@ void LIBCALL opdis_set_resolver( opdis_t o, OPDIS_RESOLVER fn, void * arg );
  */
 void LIBCALL opdis_set_error_reporter( opdis_t o, OPDIS_ERROR fn, void * arg );
 
+/*!
+ * \fn opdis_set_cflow_order( opdis_t, enum opdis_cflow_order_t )
+ * \ingroup configuration
+ * \brief Set the order in which control-flow disassembly visits branches.
+ * \details This determines whether the pending branch targets found during
+ *          control-flow disassembly are processed depth-first (the default)
+ *          or breadth-first. The set of instructions disassembled is the
+ *          same in either case; only the order in which they are passed to
+ *          the display callback changes.
+ * \param o opdis disassembler to configure.
+ * \param order The order to use.
+ */
+void LIBCALL opdis_set_cflow_order( opdis_t o, 
+				    enum opdis_cflow_order_t order );
+
+/*!
+ * \fn opdis_set_decode_cache( opdis_t, opdis_decode_cache_t )
+ * \ingroup configuration
+ * \brief Use a decode cache for all disassembly.
+ * \details With a decode cache, an instruction whose bytes have already
+ *          been decoded (and verified) is filled from the cached template
+ *          instead of being passed to libopcodes and the decoder. The
+ *          hit/miss counters of the cache report how effective it is.
+ * \param o opdis disassembler to configure.
+ * \param cache The decode cache, or NULL to disable caching.
+ * \note The cache is not freed by opdis_term. It can be shared by several
+ *       disassemblers, including disassemblers in different threads and
+ *       with different configurations: cached encodings are keyed on the
+ *       architecture, options, print_insn routine and decoder.
+ * \note The configuration key is computed by the opdis_set routines. If
+ *       fields of \e o are changed directly, call this again.
+ * \note The decoder callback is not invoked for cache hits. A decoder
+ *       with side effects, or a libopcodes print_address_func which
+ *       prints symbol names, should not be used with a decode cache.
+ * \sa opdis_decode_cache_init
+ */
+void LIBCALL opdis_set_decode_cache( opdis_t o, opdis_decode_cache_t cache );
+
+/*!
+ * \fn opdis_set_cfg( opdis_t, opdis_cfg_t )
+ * \ingroup configuration
+ * \brief Build a control flow graph during control flow disassembly.
+ * \details Each start address of a control flow disassembly is added to
+ *          the graph as a function, and each instruction which is displayed
+ *          is recorded along with its resolved branch target. Instructions
+ *          are still passed to the display callback as usual.
+ * \param o opdis disassembler to configure.
+ * \param cfg The control flow graph, or NULL to stop recording.
+ * \note The graph is not freed by opdis_term, and is not threadsafe: it
+ *       must not be shared by disassemblers running in different threads.
+ * \sa opdis_cfg_init
+ */
+void LIBCALL opdis_set_cfg( opdis_t o, opdis_cfg_t cfg );
+
+/*!
+ * \fn opdis_set_batch_handler( opdis_t, OPDIS_BATCH_HANDLER, void *, size_t )
+ * \ingroup configuration
+ * \brief Set a callback to receive disassembled instructions in batches.
+ * \details Instead of invoking the display callback for each instruction,
+ *          the linear and control flow algorithms fill an array of \e size
+ *          preallocated instructions and pass it to the batch callback
+ *          when it is full, and when disassembly ends. The handler callback
+ *          is still invoked for each instruction. Single instructions
+ *          disassembled by opdis_disasm_insn are passed in a batch of one.
+ * \param o opdis disassembler to configure.
+ * \param fn The callback function, or NULL to use the display callback.
+ * \param arg An optional argument to pass to the callback function.
+ * \param size The number of instructions in a batch, or 0 for
+ *             \ref OPDIS_BATCH_SIZE.
+ * \note The instructions in a batch are fixed-size instructions; see
+ *       opdis_insn_alloc_fixed.
+ */
+void LIBCALL opdis_set_batch_handler( opdis_t o, OPDIS_BATCH_HANDLER fn,
+				      void * arg, size_t size );
+
+/*!
+ * \fn opdis_set_stats( opdis_t, opdis_stats_t * )
+ * \ingroup configuration
+ * \brief Collect counters and phase timers during disassembly.
+ * \details Each instruction decoded by \e o is counted in \e stats, and the
+ *          time spent in each phase of its disassembly is added to the
+ *          phase timers. Statistics accumulate until the object is cleared
+ *          with opdis_stats_clear.
+ * \param o opdis disassembler to configure.
+ * \param stats The stats object, or NULL to stop collecting statistics.
+ * \note The stats object is not freed by opdis_term, and is not threadsafe:
+ *       it must not be shared by disassemblers running in different
+ *       threads. opdis_disasm_linear_parallel collects the statistics of
+ *       its threads separately, and adds them to \e stats when done.
+ * \sa opdis_get_stats
+ */
+void LIBCALL opdis_set_stats( opdis_t o, opdis_stats_t * stats );
+
+/*!
+ * \fn opdis_get_stats( opdis_t )
+ * \ingroup configuration
+ * \brief Return the stats object of a disassembler.
+ * \param o opdis disassembler.
+ * \return The stats object set by opdis_set_stats, or NULL.
+ */
+const opdis_stats_t * LIBCALL opdis_get_stats( opdis_t o );
+
 /*!
  * \fn opdis_disasm_insn_size( opdis_t, opdis_buf_t, opdis_vma_t )
  * \ingroup disassembly
@@ -546,10 +938,81 @@ void LIBCALL opdis_set_error_reporter( opdis_t o, OPDIS_ERROR fn, void * arg );
 unsigned int LIBCALL opdis_disasm_insn_size( opdis_t o, opdis_buf_t buf, 
 					     opdis_vma_t vma );
 
-// TODO: opdis_disam_invariant
-//       * wraps decoder
-//       * after decode, find addr arguments in insns bytes (search backwards
-//         from end) and wildcard them out of bytes to create signature
+/*!
+ * \fn opdis_insn_lengths( opdis_t, opdis_buf_t, opdis_vma_t, opdis_off_t,
+ *			 opdis_off_t * )
+ * \ingroup disassembly
+ * \brief Find the instruction boundaries in a sequence of instructions.
+ * \param o opdis disassembler
+ * \param buf The buffer to scan
+ * \param vma The address (VMA) in the buffer of the first instruction.
+ * \param length The number of bytes to scan.
+ * \param offsets Array filled with the buffer offset of each instruction,
+ *                or NULL.
+ * \return The number of instructions found.
+ * \details This performs a linear sweep like opdis_disasm_linear, but
+ *          only determines the size of each instruction. x86 and x86-64
+ *          instructions are sized by the built-in length decoder, and the
+ *          instructions of fixed-size RISC architectures are not examined
+ *          at all; for other architectures, each instruction is sized by
+ *          libopcodes as in opdis_disasm_insn_size.
+ * \note If the vma of \e buf is 0, then \e vma is the offset into the buffer.
+ * \note If \e length is zero, then all bytes from \e vma to the end of
+ *       the buffer will be scanned.
+ * \note \e offsets must have room for one entry per byte scanned.
+ * \note The sweep stops at the first instruction which extends past the
+ *       end of the scanned bytes.
+ */
+int LIBCALL opdis_insn_lengths( opdis_t o, opdis_buf_t buf, opdis_vma_t vma,
+				opdis_off_t length, opdis_off_t * offsets );
+
+/*!
+ * \fn opdis_disasm_invariant( opdis_t, opdis_buf_t, opdis_vma_t,
+ *			     opdis_insn_t *, opdis_insn_sig_t * )
+ * \ingroup signature
+ * \brief Disassemble an instruction and build its signature.
+ * \param o opdis disassembler
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) in the buffer to disassemble.
+ * \param insn The op_insn_t to fill with the disassembled instruction
+ * \param sig The signature to fill
+ * \return The size of the instruction, or 0 on error.
+ * \details The instruction is decoded, and the bytes of its address
+ *          operands are wildcarded as in opdis_insn_signature. The display
+ *          callback is not invoked.
+ * \note An instruction larger than OPDIS_SIG_MAX_INSN bytes gets an empty
+ *       signature.
+ * \note If the vma of \e buf is 0, then \e vma is the offset into the buffer.
+ */
+unsigned int LIBCALL opdis_disasm_invariant( opdis_t o, opdis_buf_t buf,
+					     opdis_vma_t vma,
+					     opdis_insn_t * insn,
+					     opdis_insn_sig_t * sig );
+
+/*!
+ * \fn opdis_sig_index_build( opdis_t, opdis_buf_t, opdis_vma_t, opdis_off_t,
+ *			    opdis_sig_index_t )
+ * \ingroup signature
+ * \brief Add the basic blocks of a sequence of instructions to an index.
+ * \param o opdis disassembler
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) in the buffer to start disassembly at.
+ * \param length The number of bytes to disassemble.
+ * \param index The signature index to add blocks to
+ * \return The number of blocks added.
+ * \details The instructions are disassembled in order, as with
+ *          opdis_disasm_linear. A basic block ends after a control flow
+ *          instruction or an invalid instruction, and before the target of
+ *          a branch in the sequence. The hash of each block is the rolling
+ *          hash (OPDIS_SIG_ROLL) of the signatures of its instructions.
+ *          The display and handler callbacks are not invoked.
+ * \note If \e length is zero, then all bytes from \e vma to the end of
+ *       the buffer will be disassembled.
+ */
+int LIBCALL opdis_sig_index_build( opdis_t o, opdis_buf_t buf,
+				   opdis_vma_t vma, opdis_off_t length,
+				   opdis_sig_index_t index );
+
 /*!
  * \fn opdis_disasm_insn( opdis_t, opdis_buf_t, opdis_vma_t, opdis_insn_t * )
  * \ingroup disassembly
@@ -586,9 +1049,146 @@ int LIBCALL opdis_disasm_linear( opdis_t o, opdis_buf_t buf, opdis_vma_t vma,
  * \param buf The buffer to disassemble
  * \param vma The address (VMA) of the entry point in the buffer
  * \note If the vma of \e buf is 0, then \e vma is the offset into the buffer.
+ * \note Branch targets are kept in a worklist rather than disassembled
+ *       recursively; see opdis_set_cflow_order.
  */
 int LIBCALL opdis_disasm_cflow( opdis_t o, opdis_buf_t buf, 
 				opdis_vma_t vma );
+/*!
+ * \fn opdis_ctx_init( opdis_t )
+ * \ingroup disassembly
+ * \brief Allocate a decode context for a configured disassembler.
+ * \param o opdis disassembler, which must be fully configured
+ * \return The decode context, or NULL on error.
+ * \details The libopcodes configuration of \e o is copied into the
+ *          context. Changes made to the configuration of \e o after this
+ *          call do not affect the context. The \e private_data of the
+ *          copy is cleared, so that a libopcodes disassembler which keeps
+ *          its state there sets up its own for the context. Symbol tables
+ *          (\e symbols, \e symtab) are shared with \e o, and must not be
+ *          modified while contexts are in use.
+ * \note Contexts are cheap: they contain a disassemble_info and an insn
+ *       buffer. Create one per thread, and do not share them.
+ * \note Some libopcodes disassemblers (e.g. x86 before binutils 2.39,
+ *       or ARM, which keeps its mapping symbol state in a static object
+ *       that it points \e private_data at) keep decoder state in global
+ *       variables, and are not thread-safe regardless of how opdis is
+ *       used. Only stateless disassemblers should be run from several
+ *       contexts at once.
+ * \sa opdis_ctx_free
+ */
+opdis_ctx_t LIBCALL opdis_ctx_init( opdis_t o );
+
+/*!
+ * \fn opdis_ctx_free( opdis_ctx_t )
+ * \ingroup disassembly
+ * \brief Free a decode context.
+ * \param ctx The decode context.
+ * \note The opdis_t and the \e visited_addr set are not freed.
+ */
+void LIBCALL opdis_ctx_free( opdis_ctx_t ctx );
+
+/*!
+ * \fn opdis_ctx_disasm_insn_size( opdis_ctx_t, opdis_buf_t, opdis_vma_t )
+ * \ingroup disassembly
+ * \brief Return the size of the instruction at an offset in the buffer.
+ * \param ctx decode context
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) in the buffer to disassemble.
+ * \sa opdis_disasm_insn_size
+ */
+unsigned int LIBCALL opdis_ctx_disasm_insn_size( opdis_ctx_t ctx, 
+						 opdis_buf_t buf,
+						 opdis_vma_t vma );
+
+/*!
+ * \fn opdis_ctx_insn_lengths( opdis_ctx_t, opdis_buf_t, opdis_vma_t,
+ *			     opdis_off_t, opdis_off_t * )
+ * \ingroup disassembly
+ * \brief Find the instruction boundaries in a sequence of instructions.
+ * \param ctx decode context
+ * \param buf The buffer to scan
+ * \param vma The address (VMA) in the buffer of the first instruction.
+ * \param length The number of bytes to scan.
+ * \param offsets Array filled with the buffer offset of each instruction,
+ *                or NULL.
+ * \sa opdis_insn_lengths
+ */
+int LIBCALL opdis_ctx_insn_lengths( opdis_ctx_t ctx, opdis_buf_t buf,
+				    opdis_vma_t vma, opdis_off_t length,
+				    opdis_off_t * offsets );
+
+/*!
+ * \fn opdis_ctx_disasm_insn( opdis_ctx_t, opdis_buf_t, opdis_vma_t, 
+ *			      opdis_insn_t * )
+ * \ingroup disassembly
+ * \brief Disassemble a single instruction in the buffer
+ * \param ctx decode context
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) in the buffer to disassemble.
+ * \param insn The op_insn_t to fill with the disassembled instruction
+ * \sa opdis_disasm_insn
+ */
+unsigned int LIBCALL opdis_ctx_disasm_insn( opdis_ctx_t ctx, opdis_buf_t buf, 
+					    opdis_vma_t vma, 
+					    opdis_insn_t * insn );
+
+/*!
+ * \fn opdis_ctx_disasm_linear( opdis_ctx_t, opdis_buf_t, opdis_vma_t, 
+ *				opdis_off_t )
+ * \ingroup disassembly
+ * \brief Disassemble a sequence of instructions in order.
+ * \param ctx decode context
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) in the buffer to start disassembly at.
+ * \param length The number of bytes to disassemble.
+ * \sa opdis_disasm_linear
+ */
+int LIBCALL opdis_ctx_disasm_linear( opdis_ctx_t ctx, opdis_buf_t buf, 
+				     opdis_vma_t vma, opdis_off_t length );
+
+/*!
+ * \fn opdis_ctx_disasm_cflow( opdis_ctx_t, opdis_buf_t, opdis_vma_t )
+ * \ingroup disassembly
+ * \brief Disassemble a buffer following flow of control.
+ * \param ctx decode context
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) of the entry point in the buffer
+ * \sa opdis_disasm_cflow
+ */
+int LIBCALL opdis_ctx_disasm_cflow( opdis_ctx_t ctx, opdis_buf_t buf, 
+				    opdis_vma_t vma );
+
+/*!
+ * \fn opdis_disasm_linear_parallel( opdis_t, opdis_buf_t, opdis_vma_t,
+ *				     opdis_off_t, unsigned int )
+ * \ingroup disassembly
+ * \brief Disassemble a sequence of instructions in order using several
+ *        threads.
+ * \param o opdis disassembler
+ * \param buf The buffer to disassemble
+ * \param vma The address (VMA) in the buffer to start disassembly at.
+ * \param length The number of bytes to disassemble.
+ * \param num_threads The number of threads to decode with.
+ * \details The range is split into shards which are decoded concurrently,
+ *          each with its own decode context. The shards are then stitched
+ *          together in VMA order: decoding of a shard starts at a guessed
+ *          instruction boundary, and the instructions of a shard are only
+ *          used once the sequence from the previous shard reaches one of
+ *          them; until then, instructions are decoded again on the calling
+ *          thread. The result is identical to that of opdis_disasm_linear.
+ * \note The display and handler callbacks are invoked on the calling
+ *       thread, in VMA order. The decoder callback and the error reporter
+ *       may be invoked from any thread, and the decoder may be invoked on
+ *       instructions which are never displayed.
+ * \note If \e num_threads is 1 or less, or if libopdis was built without
+ *       thread support, this is equivalent to opdis_disasm_linear.
+ * \sa opdis_ctx_init
+ */
+int LIBCALL opdis_disasm_linear_parallel( opdis_t o, opdis_buf_t buf,
+					  opdis_vma_t vma, opdis_off_t length,
+					  unsigned int num_threads );
+
 /*!
  * \fn opdis_disasm_insn( opdis_t, bfd *, opdis_vma_t, opdis_insn_t * )
  * \ingroup bfd
@@ -634,15 +1234,100 @@ int LIBCALL opdis_disasm_bfd_cflow( opdis_t o, bfd * abfd, opdis_vma_t vma );
  */
 int LIBCALL opdis_disasm_bfd_section( opdis_t o, asection * sec );
 
+/*!
+ * \fn opdis_disasm_bfd_section_parallel( opdis_t, asection *, unsigned int )
+ * \ingroup bfd
+ * \brief Disassemble the contents of a BFD section using linear disassembly
+ *        in several threads.
+ * \param o opdis disassembler
+ * \param sec The section to disassemble
+ * \param num_threads The number of threads to decode with.
+ * \note The section is loaded on the calling thread.
+ * \sa opdis_disasm_linear_parallel
+ */
+int LIBCALL opdis_disasm_bfd_section_parallel( opdis_t o, asection * sec,
+					       unsigned int num_threads );
+
+/*!
+ * \fn opdis_sig_index_bfd_section( opdis_t, asection *, opdis_sig_index_t )
+ * \ingroup bfd
+ * \brief Add the basic blocks of a BFD section to a signature index.
+ * \param o opdis disassembler
+ * \param sec The section to disassemble
+ * \param index The signature index to add blocks to
+ * \return The number of blocks added.
+ * \sa opdis_sig_index_build
+ */
+int LIBCALL opdis_sig_index_bfd_section( opdis_t o, asection * sec,
+					 opdis_sig_index_t index );
+
 /*!
  * \fn opdis_disasm_bfd_symbol( opdis_t, asymbol * )
  * \ingroup bfd
  * \brief Disassemble a BFD following flow of control from a symbol.
  * \param o opdis disassembler
  * \param sym The BFD symbol to start disassembly at.
+ * \note If a control flow graph has been set with opdis_set_cfg, the
+ *       symbol is added to it as a named function.
  */
 int LIBCALL opdis_disasm_bfd_symbol( opdis_t o, asymbol * sym );
 
+/*!
+ * \fn opdis_set_bfd_image( opdis_t, bfd *, opdis_buf_t )
+ * \ingroup bfd
+ * \brief Provide the file contents of a BFD for zero-copy section loading.
+ * \details By default, the BFD disassembly routines copy the contents of a
+ *          section into a temporary buffer. If the file backing \e abfd has
+ *          been loaded (ideally with opdis_buf_map), sections whose contents
+ *          are stored contiguously in the file are instead disassembled
+ *          directly from \e image. Sections which are not stored in the
+ *          file, which are held in memory by BFD, or which belong to an
+ *          archive member, are copied as usual.
+ * \param o opdis disassembler
+ * \param abfd The BFD which \e image contains the file contents of.
+ * \param image A buffer containing the entire file, or NULL to disable.
+ * \note \e image is not freed by opdis_term; it must remain valid for as
+ *       long as \e o is used to disassemble \e abfd.
+ */
+void LIBCALL opdis_set_bfd_image( opdis_t o, bfd * abfd, opdis_buf_t image );
+
+/*!
+ * \fn opdis_set_sec_cache( opdis_t, opdis_sec_cache_t )
+ * \ingroup bfd
+ * \brief Use a section cache for BFD disassembly.
+ * \details The BFD disassembly routines normally locate a section by 
+ *          walking all sections of the BFD, and read its contents into a
+ *          buffer that is freed when the routine returns. With a section
+ *          cache, sections are located by binary search and their contents
+ *          are kept in the cache for subsequent calls.
+ * \param o opdis disassembler
+ * \param cache The section cache, or NULL to disable caching.
+ * \note The cache is not freed by opdis_term; it can be shared by all
+ *       opdis disassemblers which operate on the same BFD, but not by
+ *       disassemblers running in different threads unless it has been
+ *       frozen (see opdis_preload_bfd_sections).
+ * \sa opdis_sec_cache_init
+ */
+void LIBCALL opdis_set_sec_cache( opdis_t o, opdis_sec_cache_t cache );
+
+/*!
+ * \fn opdis_preload_bfd_sections( opdis_t, bfd * )
+ * \ingroup bfd
+ * \brief Load all sections of a BFD into the section cache and freeze it.
+ * \details The contents of every allocated section in \e abfd are loaded
+ *          into the section cache of \e o (from the BFD image if one has
+ *          been set), after which the cache is frozen. Duplicates of \e o
+ *          can then disassemble \e abfd in different threads without
+ *          reading from the BFD, which is not thread-safe.
+ * \param o opdis disassembler with a section cache for \e abfd
+ * \param abfd The BFD to load
+ * \return 1 if all section contents are in the cache, 0 otherwise.
+ * \note The cache should not have a memory cap, or sections which do not
+ *       fit will be read from the BFD when they are disassembled.
+ * \sa opdis_set_sec_cache opdis_sec_cache_freeze
+ */
+int LIBCALL opdis_preload_bfd_sections( opdis_t o, bfd * abfd );
+
 /*!
  * \fn opdis_disasm_bfd_entry( opdis_t, bfd * )
  * \ingroup bfd
@@ -652,6 +1337,31 @@ int LIBCALL opdis_disasm_bfd_symbol( opdis_t o, asymbol * sym );
  **/
 int LIBCALL opdis_disasm_bfd_entry( opdis_t o, bfd * abfd );
 
+/*!
+ * \fn opdis_disasm_bfd_program( opdis_t, bfd *, const opdis_vma_t *, size_t )
+ * \ingroup bfd
+ * \brief Disassemble a BFD following flow of control from the entry point
+ *        and from a list of start addresses, e.g. function symbols.
+ * \details All start addresses share one set of branch targets and one set
+ *          of visited instructions, so that code reachable from several of
+ *          them (a common callee, or a shared function tail) is decoded
+ *          once. Branch targets in other sections are followed as well;
+ *          each section is loaded while the pending addresses in it are
+ *          disassembled. Addresses outside every section, such as
+ *          branches into an unmapped PLT, are skipped without an error.
+ * \param o opdis disassembler
+ * \param abfd The BFD to disassemble
+ * \param vmas Start addresses in addition to the entry point, or NULL.
+ * \param num The number of addresses in \e vmas.
+ * \return The number of instructions disassembled.
+ * \note If \e o has no visited set, a temporary one is used. A handler
+ *       other than the default should check for visited addresses itself.
+ * \note Each start address is added to the control flow graph of \e o,
+ *       if it has one; add named functions to the graph beforehand.
+ **/
+int LIBCALL opdis_disasm_bfd_program( opdis_t o, bfd * abfd,
+				      const opdis_vma_t * vmas, size_t num );
+
 /*!
  * \fn opdis_error( opdis_t, enum opdis_error_t, const char * )
  * \ingroup disassembly
@@ -0,0 +1,296 @@
+/*!
+ * \file sec_cache.c
+ * \brief Section cache implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/sec_cache.h>
+
+/* ---------------------------------------------------------------------- */
+/* SECTION INDEX */
+
+struct INDEX_ARG {
+	opdis_sec_cache_t cache;
+	unsigned int order;
+	int count_only;
+};
+
+static void index_section( bfd * abfd, asection * s, PTR data ) {
+	struct INDEX_ARG * arg = (struct INDEX_ARG *) data;
+	opdis_sec_cache_entry_t * e;
+	opdis_off_t size = bfd_section_size( abfd, s );
+
+	arg->order++;
+	if (! size ) {
+		return;
+	}
+
+	if ( arg->count_only ) {
+		arg->cache->num++;
+		return;
+	}
+
+	e = &arg->cache->entries[arg->cache->num++];
+	e->sec = s;
+	e->vma = bfd_section_vma( abfd, s );
+	e->size = size;
+	e->order = arg->order;
+}
+
+static int cmp_entry( const void * a, const void * b ) {
+	const opdis_sec_cache_entry_t * ea = (const opdis_sec_cache_entry_t *) a;
+	const opdis_sec_cache_entry_t * eb = (const opdis_sec_cache_entry_t *) b;
+
+	if ( ea->vma != eb->vma ) {
+		return ( ea->vma < eb->vma ) ? -1 : 1;
+	}
+
+	return ( ea->order < eb->order ) ? -1 : ( ea->order > eb->order );
+}
+
+static int build_index( opdis_sec_cache_t c ) {
+	struct INDEX_ARG arg = { c, 0, 1 };
+	opdis_vma_t max_end = 0;
+	size_t i;
+
+	bfd_map_over_sections( c->abfd, index_section, &arg );
+	if (! c->num ) {
+		return 1;
+	}
+
+	c->entries = (opdis_sec_cache_entry_t *) calloc( c->num,
+					sizeof(opdis_sec_cache_entry_t) );
+	if (! c->entries ) {
+		return 0;
+	}
+
+	c->num = 0;
+	arg.order = 0;
+	arg.count_only = 0;
+	bfd_map_over_sections( c->abfd, index_section, &arg );
+
+	qsort( c->entries, c->num, sizeof(opdis_sec_cache_entry_t), cmp_entry );
+
+	/* max_end allows find to stop walking back through overlaps */
+	for ( i = 0; i < c->num; i++ ) {
+		opdis_vma_t end = c->entries[i].vma + c->entries[i].size;
+		max_end = ( end > max_end ) ? end : max_end;
+		c->entries[i].max_end = max_end;
+	}
+
+	return 1;
+}
+
+/* index of first entry with vma > addr */
+static size_t upper_bound( opdis_sec_cache_t c, opdis_vma_t addr ) {
+	size_t lo = 0, hi = c->num;
+
+	while ( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		if ( c->entries[mid].vma <= addr ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static opdis_sec_cache_entry_t * entry_for_sec( opdis_sec_cache_t c,
+						asection * sec ) {
+	opdis_vma_t vma;
+	size_t i;
+
+	if (! c || ! sec ) {
+		return NULL;
+	}
+
+	vma = bfd_section_vma( c->abfd, sec );
+	for ( i = upper_bound( c, vma ); i > 0; i-- ) {
+		opdis_sec_cache_entry_t * e = &c->entries[i - 1];
+		if ( e->vma != vma ) {
+			break;
+		}
+		if ( e->sec == sec ) {
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+opdis_sec_cache_t LIBCALL opdis_sec_cache_init( bfd * abfd, size_t max_bytes ){
+	opdis_sec_cache_t c;
+
+	if (! abfd ) {
+		return NULL;
+	}
+
+	c = (opdis_sec_cache_t) calloc( 1, sizeof(opdis_sec_cache_base_t) );
+	if (! c ) {
+		return NULL;
+	}
+
+	c->abfd = abfd;
+	c->max_bytes = max_bytes;
+
+	if (! build_index( c ) ) {
+		free( c );
+		return NULL;
+	}
+
+	return c;
+}
+
+asection * LIBCALL opdis_sec_cache_find( opdis_sec_cache_t c,
+					 opdis_vma_t vma ) {
+	opdis_sec_cache_entry_t * best = NULL;
+	size_t i;
+
+	if (! c ) {
+		return NULL;
+	}
+
+	for ( i = upper_bound( c, vma ); i > 0; i-- ) {
+		opdis_sec_cache_entry_t * e = &c->entries[i - 1];
+		if ( e->max_end <= vma ) {
+			/* no earlier section extends this far */
+			break;
+		}
+		if ( vma < e->vma + e->size &&
+		     ( ! best || e->order > best->order ) ) {
+			best = e;
+		}
+	}
+
+	return ( best ) ? best->sec : NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SECTION CONTENTS */
+
+static void evict_entry( opdis_sec_cache_t c, opdis_sec_cache_entry_t * e ) {
+	if ( e->owned ) {
+		free( e->data );
+		c->bytes -= e->size;
+	}
+	e->data = NULL;
+	e->owned = 0;
+}
+
+/* evict least-recently-used owned contents until size more bytes fit */
+static int make_room( opdis_sec_cache_t c, opdis_off_t size ) {
+	if (! c->max_bytes ) {
+		return 1;
+	}
+
+	if ( size > c->max_bytes ) {
+		return 0;
+	}
+
+	while ( c->bytes + size > c->max_bytes ) {
+		opdis_sec_cache_entry_t * lru = NULL;
+		size_t i;
+
+		for ( i = 0; i < c->num; i++ ) {
+			opdis_sec_cache_entry_t * e = &c->entries[i];
+			if ( e->owned && ( ! lru || e->last_use < lru->last_use ) ){
+				lru = e;
+			}
+		}
+
+		if (! lru ) {
+			return 0;
+		}
+		evict_entry( c, lru );
+	}
+
+	return 1;
+}
+
+unsigned char * LIBCALL opdis_sec_cache_get( opdis_sec_cache_t c,
+					     asection * sec ) {
+	opdis_sec_cache_entry_t * e = entry_for_sec( c, sec );
+
+	if (! e || ! e->data ) {
+		if ( c && ! c->frozen ) {
+			c->misses++;
+		}
+		return NULL;
+	}
+
+	/* a frozen cache may be read by several threads at once */
+	if (! c->frozen ) {
+		c->hits++;
+		e->last_use = ++c->tick;
+	}
+
+	return e->data;
+}
+
+int LIBCALL opdis_sec_cache_put( opdis_sec_cache_t c, asection * sec,
+				 unsigned char * data, int owned ) {
+	opdis_sec_cache_entry_t * e = entry_for_sec( c, sec );
+
+	if (! e || ! data || c->frozen ) {
+		return 0;
+	}
+
+	if ( e->data == data ) {
+		return 1;
+	}
+
+	evict_entry( c, e );
+
+	if ( owned && ! make_room( c, e->size ) ) {
+		return 0;
+	}
+
+	e->data = data;
+	e->owned = ( owned ) ? 1 : 0;
+	e->last_use = ++c->tick;
+	if ( owned ) {
+		c->bytes += e->size;
+	}
+
+	return 1;
+}
+
+void LIBCALL opdis_sec_cache_freeze( opdis_sec_cache_t c ) {
+	if ( c ) {
+		c->frozen = 1;
+	}
+}
+
+void LIBCALL opdis_sec_cache_clear( opdis_sec_cache_t c ) {
+	size_t i;
+
+	if (! c ) {
+		return;
+	}
+
+	for ( i = 0; i < c->num; i++ ) {
+		evict_entry( c, &c->entries[i] );
+	}
+}
+
+void LIBCALL opdis_sec_cache_free( opdis_sec_cache_t c ) {
+	if (! c ) {
+		return;
+	}
+
+	opdis_sec_cache_clear( c );
+
+	if ( c->entries ) {
+		free( c->entries );
+	}
+
+	free( c );
+}
@@ -0,0 +1,165 @@
+/*!
+ * \file sec_cache.h
+ * \brief Cache of BFD section contents.
+ * \details A section cache holds an index of the sections in a BFD, sorted
+ *          by VMA, and the contents of sections which have been loaded for
+ *          disassembly. This allows a sequence of BFD disassembly calls
+ *          (e.g. one per symbol) to locate the section for a VMA by binary
+ *          search and to re-use section contents rather than reading them
+ *          from the BFD each time. An optional memory cap limits the amount
+ *          of section contents held in the cache; when it is reached, the
+ *          least-recently-used section contents are discarded.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_SEC_CACHE_H
+#define OPDIS_SEC_CACHE_H
+
+#include <bfd.h>
+
+#include <opdis/types.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*! \struct opdis_sec_cache_entry_t
+ *  \ingroup bfd
+ *  \brief A section in a section cache.
+ */
+typedef struct {
+	asection	* sec;		/*!< The BFD section */
+	opdis_vma_t	vma;		/*!< Load address of section */
+	opdis_off_t	size;		/*!< Size of section in bytes */
+	opdis_vma_t	max_end;	/*!< Max end VMA of this and prior entries */
+	unsigned int	order;		/*!< Position of section in BFD */
+	unsigned char	* data;		/*!< Cached contents, or NULL */
+	unsigned char	owned;		/*!< Is \e data freed by the cache? */
+	unsigned long	last_use;	/*!< LRU timestamp */
+} opdis_sec_cache_entry_t;
+
+/*! \struct opdis_sec_cache_base_t
+ *  \ingroup bfd
+ *  \brief A cache of the sections in a BFD.
+ */
+typedef struct {
+	bfd		* abfd;		/*!< BFD whose sections are cached */
+	opdis_sec_cache_entry_t * entries;	/*!< Sections sorted by VMA */
+	size_t		num;		/*!< Number of entries */
+	size_t		max_bytes;	/*!< Cap on owned contents, or 0 */
+	size_t		bytes;		/*!< Size of owned contents in cache */
+	unsigned long	tick;		/*!< LRU clock */
+	unsigned long	hits;		/*!< Number of cache hits */
+	unsigned long	misses;		/*!< Number of cache misses */
+	unsigned char	frozen;		/*!< Cache contents are read-only */
+} opdis_sec_cache_base_t;
+
+/*! \typedef opdis_sec_cache_base_t * opdis_sec_cache_t
+ *  \ingroup bfd
+ *  \brief A cache of the sections in a BFD.
+ */
+typedef opdis_sec_cache_base_t * opdis_sec_cache_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn opdis_sec_cache_t opdis_sec_cache_init( bfd *, size_t )
+ * \ingroup bfd
+ * \brief Allocate a section cache for a BFD.
+ * \param abfd The BFD.
+ * \param max_bytes Maximum number of bytes of section contents to cache,
+ *                  or 0 for no limit.
+ * \return The allocated cache.
+ * \sa opdis_sec_cache_free opdis_set_sec_cache
+ * \note The section index is built immediately; section contents are
+ *       added as sections are loaded by the disassembler.
+ */
+opdis_sec_cache_t LIBCALL opdis_sec_cache_init( bfd * abfd, size_t max_bytes );
+
+/*!
+ * \fn asection * opdis_sec_cache_find( opdis_sec_cache_t, opdis_vma_t )
+ * \ingroup bfd
+ * \brief Find the section containing an address.
+ * \param cache The section cache.
+ * \param vma The address to search for.
+ * \return The section, or NULL if no section contains \e vma.
+ * \note If sections overlap, the one occurring last in the BFD is returned.
+ */
+asection * LIBCALL opdis_sec_cache_find( opdis_sec_cache_t cache,
+					 opdis_vma_t vma );
+
+/*!
+ * \fn unsigned char * opdis_sec_cache_get( opdis_sec_cache_t, asection * )
+ * \ingroup bfd
+ * \brief Return the cached contents of a section.
+ * \param cache The section cache.
+ * \param sec The section.
+ * \return The section contents, or NULL if they are not cached.
+ */
+unsigned char * LIBCALL opdis_sec_cache_get( opdis_sec_cache_t cache,
+					     asection * sec );
+
+/*!
+ * \fn int opdis_sec_cache_put( opdis_sec_cache_t, asection *,
+ * 				unsigned char *, int )
+ * \ingroup bfd
+ * \brief Add the contents of a section to the cache.
+ * \param cache The section cache.
+ * \param sec The section.
+ * \param data The section contents.
+ * \param owned 1 if \e data was allocated with malloc and is to be freed by
+ *              the cache; 0 if \e data is owned by someone else (e.g. a
+ *              mapped file image).
+ * \return 1 if \e data was added to the cache, 0 otherwise.
+ * \details Least-recently-used contents are evicted until \e data fits in
+ *          the memory cap. If \e data cannot be cached (it is larger than
+ *          the cap, \e sec is not in the cache, or the cache is frozen), 0
+ *          is returned and the caller retains ownership of \e data.
+ */
+int LIBCALL opdis_sec_cache_put( opdis_sec_cache_t cache, asection * sec,
+				 unsigned char * data, int owned );
+
+/*!
+ * \fn void opdis_sec_cache_freeze( opdis_sec_cache_t )
+ * \ingroup bfd
+ * \brief Make the contents of a section cache read-only.
+ * \param cache The section cache.
+ * \details Once frozen, opdis_sec_cache_put adds no contents and
+ *          opdis_sec_cache_get no longer updates the LRU clock or the
+ *          hit statistics. A frozen cache is not modified by the
+ *          disassembler, and therefore can be shared by disassemblers
+ *          running in different threads.
+ * \sa opdis_preload_bfd_sections
+ */
+void LIBCALL opdis_sec_cache_freeze( opdis_sec_cache_t cache );
+
+/*!
+ * \fn void opdis_sec_cache_clear( opdis_sec_cache_t )
+ * \ingroup bfd
+ * \brief Discard all cached section contents.
+ * \param cache The section cache.
+ * \note The section index is not affected.
+ */
+void LIBCALL opdis_sec_cache_clear( opdis_sec_cache_t cache );
+
+/*!
+ * \fn void opdis_sec_cache_free( opdis_sec_cache_t )
+ * \ingroup bfd
+ * \brief Free a section cache and all cached section contents.
+ * \param cache The section cache.
+ */
+void LIBCALL opdis_sec_cache_free( opdis_sec_cache_t cache );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
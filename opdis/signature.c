@@ -0,0 +1,320 @@
+/*!
+ * \file signature.c
+ * \brief Instruction signatures and signature index for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/signature.h>
+
+#define DEFAULT_BUCKETS 1024
+
+/* ---------------------------------------------------------------------- */
+/* INSTRUCTION SIGNATURES */
+
+/* can v be encoded as a signed or unsigned value of width bytes? */
+static int value_fits( uint64_t v, unsigned int width ) {
+	int64_t s = (int64_t) v, lim;
+
+	if ( width >= 8 ) {
+		return 1;
+	}
+
+	lim = (int64_t) 1 << ( width * 8 - 1 );
+	return ( s >= -lim && s < lim ) || v < ( (uint64_t) 1 << (width * 8) );
+}
+
+/* wildcard the last encoding of v in the insn bytes after the first byte */
+static int wildcard_value( opdis_insn_sig_t * sig, const opdis_byte_t * bytes,
+			   uint64_t v, int big_endian ) {
+	static const unsigned int widths[] = { 8, 4, 2, 1 };
+	opdis_byte_t enc[8];
+	unsigned int i, j, w;
+	int off;
+
+	for ( i = 0; i < sizeof(widths) / sizeof(widths[0]); i++ ) {
+		uint32_t bits;
+
+		w = widths[i];
+		if ( w >= sig->size || ! value_fits( v, w ) ) {
+			continue;
+		}
+
+		for ( j = 0; j < w; j++ ) {
+			enc[( big_endian ) ? w - 1 - j : j] =
+				(opdis_byte_t) ( v >> (j * 8) );
+		}
+
+		bits = (1U << w) - 1;
+		for ( off = sig->size - w; off > 0; off-- ) {
+			if ( ! (sig->mask & (bits << off)) &&
+			     ! memcmp( &bytes[off], enc, w ) ) {
+				sig->mask |= bits << off;
+				sig->num_wild += w;
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void wildcard_op( opdis_insn_sig_t * sig, const opdis_insn_t * insn,
+			 const opdis_op_t * op, int big_endian ) {
+	const opdis_addr_expr_t * expr;
+	opdis_vma_t next = insn->vma + insn->size;
+
+	switch ( op->category ) {
+		case opdis_op_cat_immediate:
+			if (! (op->flags & opdis_op_flag_address) &&
+			    op != insn->target ) {
+				/* a constant, not an address */
+				return;
+			}
+			/* branch targets are usually relative to next insn */
+			if ( op != insn->target ||
+			     ! wildcard_value( sig, insn->bytes,
+				     op->value.immediate.vma - next,
+				     big_endian ) ) {
+				wildcard_value( sig, insn->bytes,
+						op->value.immediate.vma,
+						big_endian );
+			}
+			return;
+		case opdis_op_cat_absolute:
+			wildcard_value( sig, insn->bytes, op->value.abs.offset,
+					big_endian );
+			return;
+		case opdis_op_cat_expr:
+			expr = &op->value.expr;
+			if (! (expr->elements & opdis_addr_expr_disp) ) {
+				return;
+			}
+			/* PC-relative and absolute memory references */
+			if ( ( (expr->elements & opdis_addr_expr_base) &&
+			       (expr->base.flags & opdis_reg_flag_pc) ) ||
+			     ! (expr->elements & (opdis_addr_expr_base |
+						  opdis_addr_expr_index) ) ) {
+				wildcard_value( sig, insn->bytes,
+						expr->displacement.u,
+						big_endian );
+			}
+			return;
+		default:
+			return;
+	}
+}
+
+int LIBCALL opdis_insn_signature( const opdis_insn_t * insn, int big_endian,
+				  opdis_insn_sig_t * sig ) {
+	opdis_off_t i;
+
+	if (! insn || ! sig || ! insn->bytes || ! insn->size ||
+	    insn->size > OPDIS_SIG_MAX_INSN ) {
+		return 0;
+	}
+
+	memset( sig, 0, sizeof(opdis_insn_sig_t) );
+	sig->size = (uint8_t) insn->size;
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		wildcard_op( sig, insn, insn->operands[i], big_endian );
+	}
+
+	for ( i = 0; i < insn->size; i++ ) {
+		sig->bytes[i] = ( sig->mask & (1U << i) ) ? 0 : insn->bytes[i];
+	}
+
+	return 1;
+}
+
+uint64_t LIBCALL opdis_insn_sig_hash( const opdis_insn_sig_t * sig ) {
+	uint64_t h = 14695981039346656037ULL;
+	unsigned int i;
+
+	if (! sig ) {
+		return 0;
+	}
+
+	/* FNV-1a over size, mask and bytes */
+	h = ( h ^ sig->size ) * 1099511628211ULL;
+	for ( i = 0; i < 4; i++ ) {
+		h = ( h ^ ((sig->mask >> (i * 8)) & 0xFF) ) * 1099511628211ULL;
+	}
+	for ( i = 0; i < sig->size; i++ ) {
+		h = ( h ^ sig->bytes[i] ) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+int LIBCALL opdis_insn_sig_match( const opdis_insn_sig_t * sig,
+				  const opdis_byte_t * bytes,
+				  opdis_off_t len ) {
+	unsigned int i;
+
+	if (! sig || ! bytes || len < sig->size ) {
+		return 0;
+	}
+
+	for ( i = 0; i < sig->size; i++ ) {
+		if ( ! (sig->mask & (1U << i)) && bytes[i] != sig->bytes[i] ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int LIBCALL opdis_insn_sig_str( const opdis_insn_sig_t * sig, char * buf,
+				int len ) {
+	int i, pos = 0;
+
+	if (! sig || ! buf || len < 3 * sig->size || len < 1 ) {
+		return 0;
+	}
+
+	buf[0] = '\0';
+	for ( i = 0; i < sig->size; i++ ) {
+		if ( sig->mask & (1U << i) ) {
+			pos += sprintf( &buf[pos], "%s??", ( i ) ? " " : "" );
+		} else {
+			pos += sprintf( &buf[pos], "%s%02x", ( i ) ? " " : "",
+					sig->bytes[i] );
+		}
+	}
+
+	return pos;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SIGNATURE INDEX */
+
+static void grow_index( opdis_sig_index_t index ) {
+	size_t i, num = index->num_buckets * 2;
+	opdis_sig_block_t ** buckets, * b, * next;
+
+	buckets = (opdis_sig_block_t **) calloc( num,
+					sizeof(opdis_sig_block_t *) );
+	if (! buckets ) {
+		/* the index still works, with longer chains */
+		return;
+	}
+
+	for ( i = 0; i < index->num_buckets; i++ ) {
+		for ( b = index->buckets[i]; b; b = next ) {
+			next = b->next;
+			b->next = buckets[b->hash & (num - 1)];
+			buckets[b->hash & (num - 1)] = b;
+		}
+	}
+
+	free( index->buckets );
+	index->buckets = buckets;
+	index->num_buckets = num;
+}
+
+opdis_sig_index_t LIBCALL opdis_sig_index_init( unsigned int min_insns ) {
+	opdis_sig_index_t index = (opdis_sig_index_t) calloc( 1,
+					sizeof(opdis_sig_index_base_t) );
+	if (! index ) {
+		return NULL;
+	}
+
+	index->num_buckets = DEFAULT_BUCKETS;
+	index->buckets = (opdis_sig_block_t **) calloc( index->num_buckets,
+					sizeof(opdis_sig_block_t *) );
+	index->arena = opdis_arena_init( 0 );
+	index->min_insns = min_insns;
+
+	if (! index->buckets || ! index->arena ) {
+		opdis_sig_index_free( index );
+		return NULL;
+	}
+
+	return index;
+}
+
+int LIBCALL opdis_sig_index_add( opdis_sig_index_t index, uint64_t hash,
+				 opdis_vma_t vma, opdis_off_t size,
+				 unsigned int num_insns ) {
+	opdis_sig_block_t * b;
+	size_t slot;
+
+	if (! index || ! num_insns || num_insns < index->min_insns ) {
+		return 0;
+	}
+
+	b = (opdis_sig_block_t *) opdis_arena_alloc( index->arena,
+						sizeof(opdis_sig_block_t) );
+	if (! b ) {
+		return 0;
+	}
+
+	b->hash = hash;
+	b->vma = vma;
+	b->size = size;
+	b->num_insns = num_insns;
+
+	slot = hash & (index->num_buckets - 1);
+	b->next = index->buckets[slot];
+	index->buckets[slot] = b;
+
+	if ( ++index->num > index->num_buckets ) {
+		grow_index( index );
+	}
+
+	return 1;
+}
+
+const opdis_sig_block_t * LIBCALL opdis_sig_index_find(
+						opdis_sig_index_t index,
+						uint64_t hash ) {
+	opdis_sig_block_t * b;
+
+	if (! index ) {
+		return NULL;
+	}
+
+	for ( b = index->buckets[hash & (index->num_buckets - 1)]; b;
+	      b = b->next ) {
+		if ( b->hash == hash ) {
+			return b;
+		}
+	}
+
+	return NULL;
+}
+
+const opdis_sig_block_t * LIBCALL opdis_sig_index_next(
+					const opdis_sig_block_t * block ) {
+	const opdis_sig_block_t * b;
+
+	if (! block ) {
+		return NULL;
+	}
+
+	for ( b = block->next; b; b = b->next ) {
+		if ( b->hash == block->hash ) {
+			return b;
+		}
+	}
+
+	return NULL;
+}
+
+void LIBCALL opdis_sig_index_free( opdis_sig_index_t index ) {
+	if (! index ) {
+		return;
+	}
+
+	opdis_arena_free( index->arena );
+	free( index->buckets );
+	free( index );
+}
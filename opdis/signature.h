@@ -0,0 +1,239 @@
+/*!
+ * \file signature.h
+ * \brief Position-independent instruction and basic block signatures.
+ * \details An instruction signature is the bytes of an instruction with
+ *          the bytes which encode addresses (branch targets, absolute
+ *          memory operands and PC-relative displacements) replaced by
+ *          wildcards. The same code linked at different addresses therefore
+ *          has the same signature.
+ *          The hashes of instruction signatures are combined by a rolling
+ *          hash over each basic block, and the block hashes are stored in a
+ *          signature index, which is built once per binary and which finds
+ *          the blocks with a given hash in constant time.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_SIGNATURE_H
+#define OPDIS_SIGNATURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <opdis/types.h>
+#include <opdis/model.h>
+#include <opdis/arena.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_SIG_MAX_INSN
+ * \ingroup signature
+ * \brief Size in bytes of the longest instruction which has a signature.
+ */
+#define OPDIS_SIG_MAX_INSN 31
+
+/*!
+ * \def OPDIS_SIG_HASH_INIT
+ * \ingroup signature
+ * \brief Hash of an empty sequence of instructions.
+ */
+#define OPDIS_SIG_HASH_INIT 0ULL
+
+/*!
+ * \def OPDIS_SIG_HASH_BASE
+ * \ingroup signature
+ * \brief Multiplier of the rolling block hash.
+ */
+#define OPDIS_SIG_HASH_BASE 0x100000001B3ULL
+
+/*!
+ * \def OPDIS_SIG_ROLL( hash, insn_hash )
+ * \ingroup signature
+ * \brief Append the hash of an instruction signature to a block hash.
+ * \details The hash of instructions 1..n is
+ *          h(1) * BASE^(n-1) + h(2) * BASE^(n-2) + ... + h(n), mod 2^64, so
+ *          the hash of any run of instructions can be computed from the
+ *          hashes of the runs which precede it.
+ */
+#define OPDIS_SIG_ROLL( hash, insn_hash ) \
+	( (hash) * OPDIS_SIG_HASH_BASE + (insn_hash) )
+
+/*! \struct opdis_insn_sig_t
+ *  \ingroup signature
+ *  \brief The signature of an instruction.
+ *  \details Bit n of \e mask is set if byte n of the instruction is a
+ *           wildcard. Wildcard bytes are stored as 0 in \e bytes.
+ */
+typedef struct {
+	uint8_t		size;		/*!< Size of insn in bytes */
+	uint8_t		num_wild;	/*!< Number of wildcard bytes */
+	uint32_t	mask;		/*!< Wildcard bytes */
+	opdis_byte_t	bytes[OPDIS_SIG_MAX_INSN]; /*!< Insn bytes */
+} opdis_insn_sig_t;
+
+/*! \struct opdis_sig_block_t
+ *  \ingroup signature
+ *  \brief A basic block in a signature index.
+ */
+typedef struct opdis_sig_block {
+	struct opdis_sig_block * next;	/*!< Next block in bucket */
+	uint64_t	hash;		/*!< Rolling hash of insn signatures */
+	opdis_vma_t	vma;		/*!< Address of first insn */
+	opdis_off_t	size;		/*!< Size of block in bytes */
+	unsigned int	num_insns;	/*!< Number of insns in block */
+} opdis_sig_block_t;
+
+/*! \struct opdis_sig_index_base_t
+ *  \ingroup signature
+ *  \brief A hash table of basic blocks, keyed by block hash.
+ */
+typedef struct {
+	opdis_sig_block_t ** buckets;	/*!< Hash table */
+	size_t		num_buckets;	/*!< Size of hash table (power of 2) */
+	size_t		num;		/*!< Number of blocks */
+	unsigned int	min_insns;	/*!< Smallest block which is indexed */
+	opdis_arena_t	arena;		/*!< Storage for blocks */
+} opdis_sig_index_base_t;
+
+/*! \typedef opdis_sig_index_base_t * opdis_sig_index_t
+ *  \ingroup signature
+ *  \brief A hash table of basic blocks, keyed by block hash.
+ */
+typedef opdis_sig_index_base_t * opdis_sig_index_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn int opdis_insn_signature( const opdis_insn_t *, int,
+ * 				 opdis_insn_sig_t * )
+ * \ingroup signature
+ * \brief Build the signature of a decoded instruction.
+ * \param insn The decoded instruction.
+ * \param big_endian Nonzero if values are encoded big-endian.
+ * \param sig The signature to fill.
+ * \return 1 on success, 0 if \e insn has no bytes or is too large.
+ * \details The value of each address operand is searched for in the
+ *          instruction bytes, from the end of the instruction back to its
+ *          second byte. Branch targets are searched for both as absolute
+ *          values and relative to the end of the instruction; the bytes of
+ *          the first match are wildcarded.
+ * \note Values which are not encoded in whole bytes, such as the branch
+ *       offsets of most RISC instructions, are not found, and so are not
+ *       wildcarded.
+ */
+int LIBCALL opdis_insn_signature( const opdis_insn_t * insn, int big_endian,
+				  opdis_insn_sig_t * sig );
+
+/*!
+ * \fn uint64_t opdis_insn_sig_hash( const opdis_insn_sig_t * )
+ * \ingroup signature
+ * \brief Return the hash of an instruction signature.
+ * \param sig The signature.
+ */
+uint64_t LIBCALL opdis_insn_sig_hash( const opdis_insn_sig_t * sig );
+
+/*!
+ * \fn int opdis_insn_sig_match( const opdis_insn_sig_t *,
+ * 				 const opdis_byte_t *, opdis_off_t )
+ * \ingroup signature
+ * \brief Match bytes against an instruction signature.
+ * \param sig The signature.
+ * \param bytes The bytes to match.
+ * \param len The number of bytes available in \e bytes.
+ * \return 1 if the signature matches the start of \e bytes, else 0.
+ */
+int LIBCALL opdis_insn_sig_match( const opdis_insn_sig_t * sig,
+				  const opdis_byte_t * bytes,
+				  opdis_off_t len );
+
+/*!
+ * \fn int opdis_insn_sig_str( const opdis_insn_sig_t *, char *, int )
+ * \ingroup signature
+ * \brief Write an instruction signature as a string.
+ * \param sig The signature.
+ * \param buf The buffer to write to.
+ * \param len The size of \e buf.
+ * \return The length of the string, or 0 if \e buf is too small.
+ * \details The string is a space-delimited list of hex bytes, with "??"
+ *          for each wildcard byte, e.g. "e8 ?? ?? ?? ??".
+ */
+int LIBCALL opdis_insn_sig_str( const opdis_insn_sig_t * sig, char * buf,
+				int len );
+
+/*!
+ * \fn opdis_sig_index_t opdis_sig_index_init( unsigned int )
+ * \ingroup signature
+ * \brief Allocate a signature index.
+ * \param min_insns The smallest number of insns in an indexed block.
+ * \return The allocated index.
+ * \sa opdis_sig_index_free opdis_sig_index_build
+ * \note Very short blocks, e.g. a single ret, occur in every binary and
+ *       are rarely useful for matching; \e min_insns causes them to be
+ *       skipped.
+ */
+opdis_sig_index_t LIBCALL opdis_sig_index_init( unsigned int min_insns );
+
+/*!
+ * \fn int opdis_sig_index_add( opdis_sig_index_t, uint64_t, opdis_vma_t,
+ * 				opdis_off_t, unsigned int )
+ * \ingroup signature
+ * \brief Add a basic block to a signature index.
+ * \param index The signature index.
+ * \param hash The rolling hash of the block.
+ * \param vma The address of the block.
+ * \param size The size of the block in bytes.
+ * \param num_insns The number of instructions in the block.
+ * \return 1 if the block was added, 0 if it is too short or on error.
+ */
+int LIBCALL opdis_sig_index_add( opdis_sig_index_t index, uint64_t hash,
+				 opdis_vma_t vma, opdis_off_t size,
+				 unsigned int num_insns );
+
+/*!
+ * \fn const opdis_sig_block_t * opdis_sig_index_find( opdis_sig_index_t,
+ * 						       uint64_t )
+ * \ingroup signature
+ * \brief Find a basic block by hash.
+ * \param index The signature index.
+ * \param hash The block hash to find.
+ * \return The most recently added block with \e hash, or NULL.
+ * \sa opdis_sig_index_next
+ */
+const opdis_sig_block_t * LIBCALL opdis_sig_index_find(
+						opdis_sig_index_t index,
+						uint64_t hash );
+
+/*!
+ * \fn const opdis_sig_block_t * opdis_sig_index_next(
+ * 						const opdis_sig_block_t * )
+ * \ingroup signature
+ * \brief Return the next basic block with the same hash.
+ * \param block A block returned by opdis_sig_index_find.
+ * \return The next block with the hash of \e block, or NULL.
+ */
+const opdis_sig_block_t * LIBCALL opdis_sig_index_next(
+					const opdis_sig_block_t * block );
+
+/*!
+ * \fn void opdis_sig_index_free( opdis_sig_index_t )
+ * \ingroup signature
+ * \brief Free a signature index.
+ * \param index The signature index.
+ */
+void LIBCALL opdis_sig_index_free( opdis_sig_index_t index );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/*!
+ * \file stats.c
+ * \brief Disassembly counters and per-phase timers for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include <opdis/stats.h>
+
+static const char * phase_names[opdis_phase_count] = {
+	"opcodes", "capture", "decode", "cache", "handler", "display",
+	"resolve", "cfg"
+};
+
+void LIBCALL opdis_stats_clear( opdis_stats_t * stats ) {
+	if ( stats ) {
+		memset( stats, 0, sizeof(opdis_stats_t) );
+	}
+}
+
+void LIBCALL opdis_stats_add( opdis_stats_t * dest, const opdis_stats_t * src ){
+	unsigned int i;
+
+	if (! dest || ! src ) {
+		return;
+	}
+
+	dest->insns += src->insns;
+	dest->bytes += src->bytes;
+	dest->invalid += src->invalid;
+	dest->decode_errors += src->decode_errors;
+	dest->cache_hits += src->cache_hits;
+	dest->displayed += src->displayed;
+	dest->visited_hits += src->visited_hits;
+	dest->targets_resolved += src->targets_resolved;
+	dest->targets_unresolved += src->targets_unresolved;
+	for ( i = 0; i < opdis_phase_count; i++ ) {
+		dest->ticks[i] += src->ticks[i];
+	}
+}
+
+uint64_t LIBCALL opdis_stats_total( const opdis_stats_t * stats ) {
+	uint64_t total = 0;
+	unsigned int i;
+
+	for ( i = 0; stats && i < opdis_phase_count; i++ ) {
+		total += stats->ticks[i];
+	}
+
+	return total;
+}
+
+const char * LIBCALL opdis_stats_phase_name( enum opdis_stats_phase_t phase ) {
+	if ( phase >= opdis_phase_count ) {
+		return "unknown";
+	}
+	return phase_names[phase];
+}
+
+uint64_t LIBCALL opdis_stats_clock( void ) {
+#if defined(__GNUC__) && ( defined(__i386__) || defined(__x86_64__) )
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,117 @@
+/*!
+ * \file stats.h
+ * \brief Disassembly counters and per-phase timers.
+ * \details A stats object collects counts of the instructions decoded by a
+ *          disassembler, and the time spent in each phase of decoding an
+ *          instruction: libopcodes, the capture of libopcodes output, the
+ *          opdis decoder, and the handler, display and resolver callbacks.
+ *          Collection is enabled by attaching a stats object to a
+ *          disassembler with opdis_set_stats; a disassembler without one
+ *          does no timing.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_STATS_H
+#define OPDIS_STATS_H
+
+#include <stdint.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \enum opdis_stats_phase_t
+ * \ingroup disassembly
+ * \brief Phases of disassembly which are timed.
+ */
+enum opdis_stats_phase_t {
+	opdis_phase_opcodes,	/*!< libopcodes print_insn, less capture */
+	opdis_phase_capture,	/*!< Storing libopcodes output in insn buf */
+	opdis_phase_decode,	/*!< OPDIS_DECODER callback */
+	opdis_phase_cache,	/*!< Decode cache lookup and insertion */
+	opdis_phase_handler,	/*!< OPDIS_HANDLER callback and visited set */
+	opdis_phase_display,	/*!< OPDIS_DISPLAY or batch callback */
+	opdis_phase_resolve,	/*!< OPDIS_RESOLVER and branch target set */
+	opdis_phase_cfg,	/*!< Control flow graph construction */
+	opdis_phase_count	/*!< Number of phases */
+};
+
+/*!
+ * \struct opdis_stats_t
+ * \ingroup disassembly
+ * \brief Counters and phase timers for a disassembler.
+ * \details Timers are in ticks of opdis_stats_clock. Phases run by several
+ *          threads (e.g. in opdis_disasm_linear_parallel) add the time of
+ *          each thread, so the total can exceed the elapsed time.
+ */
+typedef struct {
+	uint64_t insns;			/*!< Insns decoded */
+	uint64_t bytes;			/*!< Bytes decoded */
+	uint64_t invalid;		/*!< Insns libopcodes could not decode */
+	uint64_t decode_errors;		/*!< Insns the decoder rejected */
+	uint64_t cache_hits;		/*!< Insns filled from decode cache */
+	uint64_t displayed;		/*!< Insns sent to display callback */
+	uint64_t visited_hits;		/*!< Insns or targets already visited */
+	uint64_t targets_resolved;	/*!< Branch targets resolved */
+	uint64_t targets_unresolved;	/*!< Branch targets not resolved */
+	uint64_t ticks[opdis_phase_count]; /*!< Time spent in each phase */
+} opdis_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn void opdis_stats_clear( opdis_stats_t * )
+ * \ingroup disassembly
+ * \brief Reset all counters and timers to zero.
+ * \param stats The stats object.
+ */
+void LIBCALL opdis_stats_clear( opdis_stats_t * stats );
+
+/*!
+ * \fn void opdis_stats_add( opdis_stats_t *, const opdis_stats_t * )
+ * \ingroup disassembly
+ * \brief Add the counters and timers of one stats object to another.
+ * \param dest The stats object to add to.
+ * \param src The stats object to add.
+ */
+void LIBCALL opdis_stats_add( opdis_stats_t * dest, const opdis_stats_t * src );
+
+/*!
+ * \fn uint64_t opdis_stats_total( const opdis_stats_t * )
+ * \ingroup disassembly
+ * \brief Return the sum of the timers of all phases.
+ * \param stats The stats object.
+ */
+uint64_t LIBCALL opdis_stats_total( const opdis_stats_t * stats );
+
+/*!
+ * \fn const char * opdis_stats_phase_name( enum opdis_stats_phase_t )
+ * \ingroup disassembly
+ * \brief Return a short name for a phase, e.g. "opcodes".
+ * \param phase The phase.
+ */
+const char * LIBCALL opdis_stats_phase_name( enum opdis_stats_phase_t phase );
+
+/*!
+ * \fn uint64_t opdis_stats_clock( void )
+ * \ingroup disassembly
+ * \brief Return the current value of the clock used by the phase timers.
+ * \details This is the CPU timestamp counter on x86, and a monotonic clock
+ *          in nanoseconds elsewhere.
+ */
+uint64_t LIBCALL opdis_stats_clock( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
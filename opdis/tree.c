@@ -14,14 +14,19 @@
 /* ----------------------------------------------------------------------*/
 /* Node alloc/free */
 
-static opdis_tree_node_t * node_alloc( void *data ) {
+static opdis_tree_node_t * node_alloc( opdis_tree_t tree, void *data ) {
 	opdis_tree_node_t *node;
 
 	if (! data ) {
 		return NULL;
 	}
 
-	node = calloc( 1, sizeof(opdis_tree_node_t) );
+	if ( tree->arena ) {
+		node = opdis_arena_alloc( tree->arena, 
+					  sizeof(opdis_tree_node_t) );
+	} else {
+		node = calloc( 1, sizeof(opdis_tree_node_t) );
+	}
 	if (! node ) {
 		return NULL;
 	}
@@ -40,7 +45,10 @@ static int tree_node_free( opdis_tree_t tree, opdis_tree_node_t * node ) {
 		tree->free_fn( node->data );
 	}
 
-	free(node);
+	if (! tree->arena ) {
+		/* arena nodes are released with the arena */
+		free(node);
+	}
 
 	return 1;
 }
@@ -251,7 +259,7 @@ static opdis_tree_node_t * insert_node( opdis_tree_t tree,
 
 	if (! start ) {
 		*exists = 0;
-		return node_alloc( data );
+		return node_alloc( tree, data );
 	}
 
 	key = tree->key_fn(data);
@@ -261,8 +269,10 @@ static opdis_tree_node_t * insert_node( opdis_tree_t tree,
 		start->left = insert_node(tree, start->left, data, exists);
 		start->left->parent = start;
 
-		if ( start->right &&
-		     start->left->level - start->right->level > 1 ) {
+		/* a missing child has level -1 */
+		if ( ( start->right &&
+		       start->left->level - start->right->level > 1 ) ||
+		     ( ! start->right && start->left->level > 0 ) ) {
 			/* is data < right child? */
 			if ( tree->cmp_fn(key, tree->key_fn(start->left->data))
 			     < 0) {
@@ -270,15 +280,14 @@ static opdis_tree_node_t * insert_node( opdis_tree_t tree,
 			} else {
 				start = rotate_left(start, 2);
 			}
-		} else if (! start->right && start->left->level > 1 ) {
-			start = rotate_right(start, 1);
 		}
 	} else if ( lr > 0 ) {
 		start->right = insert_node(tree, start->right, data, exists);
 		start->right->parent = start;
 
-		if ( start->left &&
-		     start->right->level - start->left->level > 1 ) {
+		if ( ( start->left &&
+		       start->right->level - start->left->level > 1 ) ||
+		     ( ! start->left && start->right->level > 0 ) ) {
 			/* is data > left child? */
 			if ( tree->cmp_fn(key, tree->key_fn(start->right->data))
 			     > 0) {
@@ -286,8 +295,6 @@ static opdis_tree_node_t * insert_node( opdis_tree_t tree,
 			} else {
 				start = rotate_right(start, 2);
 			}
-		} else if (! start->left && start->right->level > 1 ) {
-			start = rotate_left(start, 1);
 		}
 	} else {
 		//exists = 1;
@@ -423,6 +430,18 @@ opdis_tree_t LIBCALL opdis_tree_init( OPDIS_TREE_KEY_FN key_fn,
 	return t;
 }
 
+opdis_tree_t LIBCALL opdis_tree_init_arena( OPDIS_TREE_KEY_FN key_fn, 
+					    OPDIS_TREE_CMP_FN cmp_fn,
+					    OPDIS_TREE_FREE_FN free_fn,
+					    opdis_arena_t arena ) {
+	opdis_tree_t t = opdis_tree_init( key_fn, cmp_fn, free_fn );
+	if ( t ) {
+		t->arena = arena;
+	}
+
+	return t;
+}
+
 int LIBCALL opdis_tree_add( opdis_tree_t tree, void * data ) {
 	int exists = 1;
 
@@ -564,7 +583,10 @@ void LIBCALL opdis_tree_free( opdis_tree_t tree ) {
 		return;
 	}
 
-	tree_node_destroy(tree, tree->root);
+	if (! tree->arena || tree->free_fn != builtin_free_fn ) {
+		/* nodes in an arena only need to be visited to free items */
+		tree_node_destroy(tree, tree->root);
+	}
 
 	free(tree);
 }
@@ -648,6 +670,12 @@ opdis_insn_tree_t LIBCALL opdis_insn_tree_init( int manage ) {
 	return (opdis_insn_tree_t) opdis_tree_init(insn_key_fn, NULL, free_fn);
 }
 
+opdis_insn_tree_t LIBCALL opdis_insn_tree_init_arena( opdis_arena_t arena ) {
+	/* instructions are owned by the arena, not the tree */
+	return (opdis_insn_tree_t) opdis_tree_init_arena( insn_key_fn, NULL,
+							  NULL, arena );
+}
+
 int LIBCALL opdis_insn_tree_add( opdis_insn_tree_t tree, 
 				 opdis_insn_t * insn ) {
 	return opdis_tree_add( (opdis_tree_t) tree, insn );
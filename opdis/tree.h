@@ -14,6 +14,7 @@
 
 #include <sys/types.h>
 
+#include <opdis/arena.h>
 #include <opdis/model.h>
 #include <opdis/types.h>
 
@@ -79,6 +80,7 @@ typedef struct std_tree {
 	OPDIS_TREE_FREE_FN	free_fn;	/*!< Item free callback */
 	opdis_tree_node_t	* root;		/*!< Root node of tree */
 	int	  		  num;		/*!< Number of nodes in tree */
+	opdis_arena_t		arena;		/*!< Node allocator or NULL */
 } opdis_tree_base_t;
 
 /*! \typedef opdis_tree_base_t * opdis_tree_t
@@ -126,6 +128,30 @@ opdis_tree_t LIBCALL opdis_tree_init( OPDIS_TREE_KEY_FN key_fn,
 				      OPDIS_TREE_CMP_FN cmp_fn,
 				      OPDIS_TREE_FREE_FN free_fn );
 
+/*!
+ * \fn opdis_tree_t opdis_tree_init_arena( OPDIS_TREE_KEY_FN, 
+ *                                         OPDIS_TREE_CMP_FN,
+ *                                         OPDIS_TREE_FREE_FN, opdis_arena_t )
+ * \ingroup tree
+ * \brief Allocate and initialize an AVL tree whose nodes live in an arena.
+ * \param key_fn Callback to use for key retrieval.
+ * \param cmp_fn Callback to use for key comparison.
+ * \param free_fn Callback to use to free items or NULL.
+ * \param arena The arena to allocate nodes from.
+ * \return The allocated binary tree.
+ * \sa opdis_tree_init opdis_arena_init
+ * \details This behaves like opdis_tree_init, except that nodes are
+ *          allocated from \e arena. Nodes are never freed individually;
+ *          they are released when the arena is freed. If \e free_fn is
+ *          NULL, opdis_tree_free does not walk the tree at all.
+ * \note The arena must not be freed before the tree.
+ */
+
+opdis_tree_t LIBCALL opdis_tree_init_arena( OPDIS_TREE_KEY_FN key_fn, 
+					    OPDIS_TREE_CMP_FN cmp_fn,
+					    OPDIS_TREE_FREE_FN free_fn,
+					    opdis_arena_t arena );
+
 /*!
  * \fn int opdis_tree_add( opdis_tree_t, void * )
  * \ingroup tree
@@ -387,6 +413,21 @@ void LIBCALL opdis_vma_tree_free( opdis_vma_tree_t tree );
 
 opdis_insn_tree_t LIBCALL opdis_insn_tree_init( int manage );
 
+/*!
+ * \fn opdis_tree_t opdis_insn_tree_init_arena( opdis_arena_t )
+ * \ingroup tree
+ * \brief Allocate an Instruction Tree whose nodes live in an arena.
+ * \param arena The arena to allocate nodes from.
+ * \return The allocated tree.
+ * \sa opdis_insn_tree_free opdis_insn_dupe_arena
+ * \details The tree does not free the instructions stored in it; these are
+ *          expected to have been created by opdis_insn_dupe_arena from the
+ *          same arena, so that the whole tree is released by a single call
+ *          to opdis_arena_free after opdis_insn_tree_free.
+ */
+
+opdis_insn_tree_t LIBCALL opdis_insn_tree_init_arena( opdis_arena_t arena );
+
 /*!
  * \fn int opdis_insn_tree_add( opdis_insn_tree_t, opdis_insn_t * )
  * \ingroup tree
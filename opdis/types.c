@@ -10,6 +10,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <opdis/types.h>
 
 opdis_buf_t LIBCALL opdis_buf_alloc( opdis_off_t size, opdis_vma_t addr ) {
@@ -75,6 +82,72 @@ opdis_buf_t LIBCALL opdis_buf_read( FILE * f, opdis_off_t size,
 	return buf;
 }
 
+#ifdef HAVE_SYS_MMAN_H
+static opdis_buf_t map_file( const char * path, opdis_vma_t addr ) {
+	opdis_buf_t buf;
+	struct stat st;
+	void * data;
+	int fd;
+
+	fd = open( path, O_RDONLY );
+	if ( fd == -1 ) {
+		return NULL;
+	}
+
+	if ( fstat( fd, &st ) == -1 || ! S_ISREG(st.st_mode) || 
+	     st.st_size <= 0 ) {
+		close( fd );
+		return NULL;
+	}
+
+	/* private, writeable mapping: writes to data do not reach the file */
+	data = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		     fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED ) {
+		return NULL;
+	}
+
+	buf = (opdis_buf_t) calloc( 1, sizeof(opdis_buffer_t) );
+	if (! buf ) {
+		munmap( data, st.st_size );
+		return NULL;
+	}
+
+	buf->len = st.st_size;
+	buf->vma = addr;
+	buf->data = (opdis_byte_t *) data;
+	buf->mapped = 1;
+
+	return buf;
+}
+#endif
+
+opdis_buf_t LIBCALL opdis_buf_map( const char * path, opdis_vma_t addr ) {
+	opdis_buf_t buf = NULL;
+	FILE * f;
+
+	if (! path ) {
+		return NULL;
+	}
+
+#ifdef HAVE_SYS_MMAN_H
+	buf = map_file( path, addr );
+	if ( buf ) {
+		return buf;
+	}
+#endif
+
+	/* fall back to reading the file */
+	f = fopen( path, "r" );
+	if ( f ) {
+		buf = opdis_buf_read( f, 0, addr );
+		fclose( f );
+	}
+
+	return buf;
+}
+
 int LIBCALL opdis_buf_fill( opdis_buf_t buf, opdis_off_t offset,
 			    void * src, opdis_off_t len ) {
 	if ( ! buf || ! buf->data || ! src || ! len || 
@@ -89,6 +162,12 @@ int LIBCALL opdis_buf_fill( opdis_buf_t buf, opdis_off_t offset,
 
 void LIBCALL opdis_buf_free( opdis_buf_t buf ) {
 	if ( buf ) {
+#ifdef HAVE_SYS_MMAN_H
+		if ( buf->mapped ) {
+			munmap( buf->data, buf->len );
+			buf->data = NULL;
+		}
+#endif
 		if ( buf->data ) {
 			free(buf->data);
 		}
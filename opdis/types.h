@@ -61,6 +61,7 @@ typedef struct {
 	opdis_off_t 	len;	/*!< Number of bytes in buffer. */
 	opdis_vma_t	vma;	/*!< Load address of buffer. */
 	opdis_byte_t * 	data;	/*!< Contents of buffer. */
+	unsigned char	mapped;	/*!< Is \e data mapped from a file? 0 or 1 */
 } opdis_buffer_t;
 
 /*! \typedef opdis_buffer_t * opdis_buf_t
@@ -120,6 +121,22 @@ void LIBCALL opdis_buf_set_vma( opdis_buf_t buf, opdis_vma_t addr );
 opdis_buf_t LIBCALL opdis_buf_read( FILE * f, opdis_off_t size, 
 				    opdis_vma_t addr );
 
+/*!
+ * \fn opdis_buf_t opdis_buf_map( const char *, opdis_vma_t )
+ * \ingroup types
+ * \brief Allocate an opdis buffer containing the contents of a file.
+ * \details Maps the file at \e path into memory instead of reading it. The
+ *          file is mapped privately, so writes to the buffer (which are best
+ *          avoided) are not written back to the file. If the file cannot be
+ *          mapped, it is read into the buffer with opdis_buf_read.
+ * \param path The path of the file.
+ * \param addr Load address (vma) of buffer or 0.
+ * \return The allocated opdis buffer.
+ * \sa opdis_buf_read opdis_buf_free
+ * \note The memory map is released by opdis_buf_free.
+ */
+opdis_buf_t LIBCALL opdis_buf_map( const char * path, opdis_vma_t addr );
+
 /*!
  * \fn int opdis_buf_fill( opdis_buf_t, opdis_off_t, void *, opdis_off_t )
  * \ingroup types
@@ -0,0 +1,284 @@
+/*!
+ * \file visited.c
+ * \brief Visited-address set implementation for libopdis.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/visited.h>
+
+#define BITMAP_SIZE(len) (((len) + 7) / 8)
+#define BIT_IS_SET(bits, off) ((bits)[(off) >> 3] & (1 << ((off) & 7)))
+#define BIT_SET(bits, off) ((bits)[(off) >> 3] |= (1 << ((off) & 7)))
+#define BIT_CLEAR(bits, off) ((bits)[(off) >> 3] &= ~(1 << ((off) & 7)))
+
+static int in_bitmap( opdis_visited_t v, opdis_vma_t vma ) {
+	return ( v->bits && vma >= v->base && vma - v->base < v->len );
+}
+
+static opdis_visited_t visited_alloc( enum opdis_visited_type_t type ) {
+	opdis_visited_t v = (opdis_visited_t) calloc( 1,
+						sizeof(opdis_visited_set_t) );
+	if (! v ) {
+		return NULL;
+	}
+
+	v->type = type;
+	v->tree = opdis_vma_tree_init();
+	if (! v->tree ) {
+		free( v );
+		return NULL;
+	}
+
+	return v;
+}
+
+opdis_visited_t LIBCALL opdis_visited_init( void ) {
+	return visited_alloc( opdis_visited_bitmap );
+}
+
+opdis_visited_t LIBCALL opdis_visited_init_bitmap( opdis_vma_t vma,
+						   opdis_off_t len ) {
+	opdis_visited_t v = visited_alloc( opdis_visited_bitmap );
+	if ( v ) {
+		opdis_visited_cover( v, vma, len );
+	}
+
+	return v;
+}
+
+opdis_visited_t LIBCALL opdis_visited_init_tree( void ) {
+	return visited_alloc( opdis_visited_tree );
+}
+
+/* split of the fallback tree performed when the bitmap grows */
+struct MIGRATE_ARG {
+	opdis_visited_t v;
+	opdis_vma_tree_t tree;
+};
+
+static int migrate_vma( opdis_vma_t vma, void * arg ) {
+	struct MIGRATE_ARG * m = (struct MIGRATE_ARG *) arg;
+	if ( in_bitmap(m->v, vma) ) {
+		BIT_SET( m->v->bits, vma - m->v->base );
+	} else {
+		opdis_vma_tree_add( m->tree, vma );
+	}
+	return 1;
+}
+
+int LIBCALL opdis_visited_cover( opdis_visited_t v, opdis_vma_t vma,
+				 opdis_off_t len ) {
+	opdis_vma_t base, end;
+	unsigned char * bits;
+	struct MIGRATE_ARG m;
+
+	if (! v || v->type != opdis_visited_bitmap || ! len ) {
+		return 0;
+	}
+
+	if ( in_bitmap(v, vma) && in_bitmap(v, vma + len - 1) ) {
+		return 1;
+	}
+
+	base = vma;
+	end = vma + len;
+	if ( v->bits ) {
+		base = ( v->base < base ) ? v->base : base;
+		end = ( v->base + v->len > end ) ? v->base + v->len : end;
+	}
+
+	if ( end <= base || end - base > OPDIS_VISITED_MAX_SPAN ) {
+		return 0;
+	}
+
+	bits = (unsigned char *) calloc( 1, BITMAP_SIZE(end - base) );
+	if (! bits ) {
+		return 0;
+	}
+
+	if ( v->bits ) {
+		opdis_off_t shift = v->base - base;
+		opdis_off_t off;
+		if ( shift % 8 == 0 ) {
+			memcpy( &bits[shift / 8], v->bits, BITMAP_SIZE(v->len) );
+		} else {
+			for ( off = 0; off < v->len; off++ ) {
+				if ( BIT_IS_SET(v->bits, off) ) {
+					BIT_SET(bits, off + shift);
+				}
+			}
+		}
+		free( v->bits );
+	}
+
+	v->bits = bits;
+	v->base = base;
+	v->len = end - base;
+
+	/* move any tree entries that are now covered by the bitmap */
+	if ( opdis_tree_count(v->tree) ) {
+		m.v = v;
+		m.tree = opdis_vma_tree_init();
+		if ( m.tree ) {
+			opdis_vma_tree_foreach( v->tree, migrate_vma, &m );
+			opdis_vma_tree_free( v->tree );
+			v->tree = m.tree;
+		}
+	}
+
+	return 1;
+}
+
+int LIBCALL opdis_visited_add( opdis_visited_t v, opdis_vma_t vma ) {
+	if (! v ) {
+		return 0;
+	}
+
+	if ( in_bitmap(v, vma) ) {
+		opdis_off_t off = vma - v->base;
+		if ( BIT_IS_SET(v->bits, off) ) {
+			return 0;
+		}
+		BIT_SET(v->bits, off);
+	} else if (! opdis_vma_tree_add( v->tree, vma ) ) {
+		return 0;
+	}
+
+	v->num++;
+	return 1;
+}
+
+int LIBCALL opdis_visited_contains( opdis_visited_t v, opdis_vma_t vma ) {
+	if (! v ) {
+		return 0;
+	}
+
+	if ( in_bitmap(v, vma) ) {
+		return BIT_IS_SET(v->bits, vma - v->base) ? 1 : 0;
+	}
+
+	return opdis_vma_tree_contains( v->tree, vma );
+}
+
+int LIBCALL opdis_visited_delete( opdis_visited_t v, opdis_vma_t vma ) {
+	if (! v ) {
+		return 0;
+	}
+
+	if ( in_bitmap(v, vma) ) {
+		opdis_off_t off = vma - v->base;
+		if (! BIT_IS_SET(v->bits, off) ) {
+			return 0;
+		}
+		BIT_CLEAR(v->bits, off);
+	} else if (! opdis_vma_tree_delete( v->tree, vma ) ) {
+		return 0;
+	}
+
+	v->num--;
+	return 1;
+}
+
+size_t LIBCALL opdis_visited_count( opdis_visited_t v ) {
+	return ( v ) ? v->num : 0;
+}
+
+/* foreach over the part of the tree that lies before or after the bitmap */
+struct TREE_RANGE_ARG {
+	opdis_vma_t min;
+	opdis_vma_t max;
+	OPDIS_ADDR_TREE_FOREACH_FN fn;
+	void * arg;
+	int cont;
+};
+
+static int tree_range_fn( opdis_vma_t vma, void * arg ) {
+	struct TREE_RANGE_ARG * r = (struct TREE_RANGE_ARG *) arg;
+	if ( vma > r->max ) {
+		return 0;
+	}
+	if ( vma >= r->min ) {
+		r->cont = r->fn( vma, r->arg );
+	}
+	return r->cont;
+}
+
+void LIBCALL opdis_visited_foreach( opdis_visited_t v,
+				    OPDIS_ADDR_TREE_FOREACH_FN fn, void * arg ){
+	struct TREE_RANGE_ARG r;
+	opdis_off_t off;
+
+	if (! v || ! fn ) {
+		return;
+	}
+
+	r.fn = fn;
+	r.arg = arg;
+	r.cont = 1;
+
+	if (! v->bits ) {
+		opdis_vma_tree_foreach( v->tree, fn, arg );
+		return;
+	}
+
+	/* addresses below the bitmap */
+	if ( v->base > 0 ) {
+		r.min = 0;
+		r.max = v->base - 1;
+		opdis_vma_tree_foreach( v->tree, tree_range_fn, &r );
+		if (! r.cont ) {
+			return;
+		}
+	}
+
+	for ( off = 0; off < v->len; off++ ) {
+		if (! v->bits[off >> 3] ) {
+			/* skip empty bytes */
+			off |= 7;
+			continue;
+		}
+		if ( BIT_IS_SET(v->bits, off) && ! fn( v->base + off, arg ) ) {
+			return;
+		}
+	}
+
+	/* addresses above the bitmap */
+	r.min = v->base + v->len;
+	r.max = OPDIS_INVALID_ADDR;
+	if ( r.min > v->base ) {
+		opdis_vma_tree_foreach( v->tree, tree_range_fn, &r );
+	}
+}
+
+void LIBCALL opdis_visited_clear( opdis_visited_t v ) {
+	if (! v ) {
+		return;
+	}
+
+	if ( v->bits ) {
+		memset( v->bits, 0, BITMAP_SIZE(v->len) );
+	}
+
+	opdis_vma_tree_free( v->tree );
+	v->tree = opdis_vma_tree_init();
+	v->num = 0;
+}
+
+void LIBCALL opdis_visited_free( opdis_visited_t v ) {
+	if (! v ) {
+		return;
+	}
+
+	if ( v->bits ) {
+		free( v->bits );
+	}
+
+	opdis_vma_tree_free( v->tree );
+	free( v );
+}
@@ -0,0 +1,194 @@
+/*!
+ * \file visited.h
+ * \brief Sets of visited addresses.
+ * \details This provides a set of addresses (VMAs) used to track which
+ *          instructions or branch targets have already been disassembled.
+ *          The default implementation is a bitmap with one bit per byte
+ *          of the buffer being disassembled; addresses which fall outside
+ *          of the bitmap are stored in an AVL tree.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_VISITED_H
+#define OPDIS_VISITED_H
+
+#include <opdis/types.h>
+#include <opdis/tree.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_VISITED_MAX_SPAN
+ * \ingroup tree
+ * \brief Maximum number of bytes that a visited-address bitmap will cover.
+ * \details Addresses outside of this span are stored in the fallback tree.
+ */
+#define OPDIS_VISITED_MAX_SPAN (1UL << 30)
+
+/*!
+ * \enum opdis_visited_type_t
+ * \ingroup tree
+ * \brief Storage backend for a visited-address set.
+ */
+enum opdis_visited_type_t {
+	opdis_visited_bitmap,		/*!< Per-byte bitmap with tree fallback */
+	opdis_visited_tree		/*!< AVL tree only (sparse addresses) */
+};
+
+/*! \struct opdis_visited_set_t
+ *  \ingroup tree
+ *  \brief A set of visited addresses.
+ */
+typedef struct {
+	enum opdis_visited_type_t type;	/*!< Storage backend */
+	opdis_vma_t	base;		/*!< First VMA covered by \e bits */
+	opdis_off_t	len;		/*!< Number of bytes covered by \e bits */
+	unsigned char * bits;		/*!< One bit per byte from \e base */
+	opdis_vma_tree_t tree;		/*!< Addresses not covered by \e bits */
+	size_t		num;		/*!< Number of addresses in set */
+} opdis_visited_set_t;
+
+/*! \typedef opdis_visited_set_t * opdis_visited_t
+ *  \ingroup tree
+ *  \brief A set of visited addresses.
+ */
+typedef opdis_visited_set_t * opdis_visited_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn opdis_visited_t opdis_visited_init( void )
+ * \ingroup tree
+ * \brief Allocate a bitmap-backed visited-address set.
+ * \return The allocated set.
+ * \sa opdis_visited_free opdis_visited_cover
+ * \details The bitmap is empty until opdis_visited_cover is called; the
+ *          disassembly functions do this automatically for the buffer
+ *          being disassembled. Until then, all addresses are stored in
+ *          the fallback tree.
+ */
+opdis_visited_t LIBCALL opdis_visited_init( void );
+
+/*!
+ * \fn opdis_visited_t opdis_visited_init_bitmap( opdis_vma_t, opdis_off_t )
+ * \ingroup tree
+ * \brief Allocate a visited-address set covering an address range.
+ * \param vma The first address in the range.
+ * \param len The number of bytes in the range.
+ * \return The allocated set.
+ * \sa opdis_visited_free
+ */
+opdis_visited_t LIBCALL opdis_visited_init_bitmap( opdis_vma_t vma,
+						   opdis_off_t len );
+
+/*!
+ * \fn opdis_visited_t opdis_visited_init_tree( void )
+ * \ingroup tree
+ * \brief Allocate a tree-backed visited-address set.
+ * \return The allocated set.
+ * \sa opdis_visited_free
+ * \details This is intended for sparse address spaces, where a bitmap
+ *          would be mostly empty.
+ */
+opdis_visited_t LIBCALL opdis_visited_init_tree( void );
+
+/*!
+ * \fn int opdis_visited_cover( opdis_visited_t, opdis_vma_t, opdis_off_t )
+ * \ingroup tree
+ * \brief Extend the bitmap of a visited-address set to cover a range.
+ * \param v The visited-address set.
+ * \param vma The first address in the range.
+ * \param len The number of bytes in the range.
+ * \return 1 if the range is covered by the bitmap, 0 otherwise.
+ * \details Addresses already stored in the fallback tree which fall inside
+ *          the new bitmap are moved into it. If the combined range would
+ *          exceed OPDIS_VISITED_MAX_SPAN, or if \e v is tree-backed, the
+ *          set is unchanged and addresses in the range will continue to be
+ *          stored in the tree.
+ */
+int LIBCALL opdis_visited_cover( opdis_visited_t v, opdis_vma_t vma,
+				 opdis_off_t len );
+
+/*!
+ * \fn int opdis_visited_add( opdis_visited_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Add an address to a visited-address set.
+ * \param v The visited-address set.
+ * \param vma The address to add.
+ * \return 1 if the address was added, 0 if it was already in the set.
+ */
+int LIBCALL opdis_visited_add( opdis_visited_t v, opdis_vma_t vma );
+
+/*!
+ * \fn int opdis_visited_contains( opdis_visited_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Determine if an address is in a visited-address set.
+ * \param v The visited-address set.
+ * \param vma The address to search for.
+ * \return 1 if the address is in the set, 0 otherwise.
+ */
+int LIBCALL opdis_visited_contains( opdis_visited_t v, opdis_vma_t vma );
+
+/*!
+ * \fn int opdis_visited_delete( opdis_visited_t, opdis_vma_t )
+ * \ingroup tree
+ * \brief Remove an address from a visited-address set.
+ * \param v The visited-address set.
+ * \param vma The address to remove.
+ * \return 1 on success, 0 if the address was not in the set.
+ */
+int LIBCALL opdis_visited_delete( opdis_visited_t v, opdis_vma_t vma );
+
+/*!
+ * \fn size_t opdis_visited_count( opdis_visited_t )
+ * \ingroup tree
+ * \brief Return the number of addresses in a visited-address set.
+ * \param v The visited-address set.
+ */
+size_t LIBCALL opdis_visited_count( opdis_visited_t v );
+
+/*!
+ * \fn void opdis_visited_foreach( opdis_visited_t,
+ * 				   OPDIS_ADDR_TREE_FOREACH_FN, void * )
+ * \ingroup tree
+ * \brief Invoke a callback for every address in the set, in ascending order.
+ * \param v The visited-address set.
+ * \param fn The callback to invoke for each address.
+ * \param arg An optional argument to pass to the callback function.
+ */
+void LIBCALL opdis_visited_foreach( opdis_visited_t v,
+				    OPDIS_ADDR_TREE_FOREACH_FN fn, void * arg );
+
+/*!
+ * \fn void opdis_visited_clear( opdis_visited_t )
+ * \ingroup tree
+ * \brief Remove all addresses from a visited-address set.
+ * \param v The visited-address set.
+ * \note The range covered by the bitmap is not changed.
+ */
+void LIBCALL opdis_visited_clear( opdis_visited_t v );
+
+/*!
+ * \fn void opdis_visited_free( opdis_visited_t )
+ * \ingroup tree
+ * \brief Free a visited-address set.
+ * \param v The visited-address set.
+ * \sa opdis_visited_init
+ */
+void LIBCALL opdis_visited_free( opdis_visited_t v );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -13,234 +13,12 @@
 #include <ctype.h>
 
 #include <opdis/opdis.h>
-
+#include <opdis/x86_rules.h>
+#include <opdis/x86_tables.h>
 
 /* ---------------------------------------------------------------------- */
 /* MNEMONICS */
 
-static void set_isa( opdis_insn_t * out, const char * item ) {
-
-	/* check for obvious subsets */
-	if ( item[0] == 'f' ) {
-		out->isa = opdis_insn_subset_fpu;
-		return;
-	}
-
-	if ( strstr( item, "pd" ) || strstr( item, "ps" ) ||
-	     strstr( item, "ss" ) || strstr( item, "sd" ) ) {
-		out->isa = opdis_insn_subset_simd;
-		return;
-	}
-
-	if ( item[0] == 'p' && strncmp( "pause", item, 5 ) &&
-	     strncmp( "pop", item, 3 ) && strncmp( "push", item, 4 ) &&
-	     strncmp( "prefetch", item, 8 ) ) {
-		out->isa = opdis_insn_subset_simd;
-		return;
-	}
-
-	out->isa = opdis_insn_subset_gen;
-}
-
-static void decode_intel_mnemonic( opdis_insn_t * out, const char * item ) {
-	int i, num;
-
-	set_isa( out, item );
-
-	/* detect NOP */
-	if (! strcmp( "nop", item ) || ! strcmp( "fnop", item ) ) {
-		out->category = opdis_insn_cat_nop;
-		return;
-	}
-
-	/* detect JMP */
-	if (! strncmp( "jmp", item, 3 ) || ! strncmp( "ljmp", item, 4) ) {
-		out->category = opdis_insn_cat_cflow;
-		out->flags.cflow = opdis_cflow_flag_jmp;
-		return;
-	}
-
-	/* detect RET */
-	if (! strncmp( "ret", item, 3 ) || ! strncmp( "lret", item, 4) ||
-	    ! strncmp( "iret", item, 4 ) || ! strcmp( "sysexit", item ) ||
-	    ! strcmp( "sysret", item ) ) {
-		out->category = opdis_insn_cat_cflow;
-		out->flags.cflow = opdis_cflow_flag_ret;
-		return;
-	}
-
-	/* detect branch (call/jcc) */
-	if (! strncmp( "call", item, 4 ) || ! strncmp( "lcall", item, 5) ||
-	    ! strcmp( "syscall", item ) || ! strcmp("sysenter", item ) ) {
-		out->category = opdis_insn_cat_cflow;
-		out->flags.cflow = opdis_cflow_flag_call;
-		return;
-	}
-	if ( item[0] == 'j' || ! strncmp( "loop", item, 4) ) {
-		/* all mnemonics starting with J are either JMP or Jcc */
-		out->category = opdis_insn_cat_cflow;
-		out->flags.cflow = opdis_cflow_flag_jmpcc;
-		return;
-	}
-
-	/* stack instructions */
-	if (! strncmp( "pop", item, 3 ) && strcmp( "popcnt", item ) ) {
-		out->category = opdis_insn_cat_stack;
-		out->flags.stack = opdis_stack_flag_pop;
-		return;
-	}
-	if (! strncmp( "push", item, 4 ) ) {
-		out->category = opdis_insn_cat_stack;
-		out->flags.stack = opdis_stack_flag_push;
-		return;
-	}
-	if (! strncmp( "enter", item, 5 ) ) {
-		out->category = opdis_insn_cat_stack;
-		out->flags.stack = opdis_stack_flag_frame;
-		return;
-	}
-	if (! strncmp( "leave", item, 5 ) ) {
-		out->category = opdis_insn_cat_stack;
-		out->flags.stack = opdis_stack_flag_unframe;
-		return;
-	}
-
-	/* load/store instructions */
-	if ( strstr( item, "mov" ) || strstr( item, "xch" ) ||
-	    ! strncmp( "lod", item, 3 ) || ! strncmp( "sto", item, 3 ) || 
-	    ! strncmp( "fild", item, 4 ) || ! strncmp( "fist", item, 4 ) ||
-	    ! strncmp( "fld", item, 3 ) || ! strncmp( "fst", item, 3 ) ||
-	    ! strncmp( "ld", item, 2 ) || ! strncmp( "la", item, 2 ) ||
-	    ! strncmp( "ll", item, 2 ) || ! strncmp( "lf", item, 2 ) ||
-	    ! strncmp( "lg", item, 2 ) || ! strncmp( "lm", item, 2 ) ||
-	    ! strncmp( "mask", item, 4 ) || ! strncmp( "rd", item, 2 ) ||
-	    ! strncmp( "sahf", item, 4 ) || ! strncmp( "sg", item, 2 ) ||
-	    ! strncmp( "si", item, 2 ) || ! strncmp( "sl", item, 2 ) ||
-	    ! strncmp( "sm", item, 2 ) || ! strncmp( "stm", item, 3 ) ||
-	    ! strncmp( "str", item, 3 ) || ! strncmp( "swap", item, 4 ) ||
-	    ! strncmp( "wrm", item, 3 ) || ! strncmp( "xget", item, 4 ) ||
-	    ! strncmp( "xset", item, 4 ) || ! strncmp( "xsave", item, 5 ) ||
-	    ! strncmp( "xrstor", item, 6 ) ) {
-		out->category = opdis_insn_cat_lost;
-		return;
-	}
-
-	/* bitwise instructions */
-	if (! strncmp( "and", item, 3 ) || ! strncmp( "pand", item, 4 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_and;
-		return;
-	}
-	if (! strncmp( "or", item, 2 ) || ! strncmp( "por", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_or;
-		return;
-	}
-	if (! strncmp( "xor", item, 3 ) || ! strncmp( "pxor", item, 4 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_xor;
-		return;
-	}
-	if (! strncmp( "neg", item, 3 ) || ! strncmp( "not", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_not;
-		return;
-	}
-	if (! strncmp( "sal", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_asl;
-		return;
-	}
-	if (! strncmp( "sar", item, 3 ) || ! strncmp( "psra", item, 4 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_asr;
-		return;
-	}
-	if (! strncmp( "shl", item, 3 ) || ! strncmp( "psll", item, 4 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_lsl;
-		return;
-	}
-	if (! strncmp( "shr", item, 3 ) || ! strncmp( "psrl", item, 4 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_lsr;
-		return;
-	}
-	if (! strncmp( "rcl", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_rcl;
-		return;
-	}
-	if (! strncmp( "rcr", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_rcr;
-		return;
-	}
-	if (! strncmp( "rol", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_rol;
-		return;
-	}
-	if (! strncmp( "ror", item, 3 ) ) {
-		out->category = opdis_insn_cat_bit;
-		out->flags.bit = opdis_bit_flag_ror;
-		return;
-	}
-
-	/* trap */
-	if (! strncmp( "int", item, 3 ) || ! strcmp( "cli", item ) ||
-	    ! strcmp( "sti", item ) || ! strcmp( "ud2", item ) ) {
-		out->category = opdis_insn_cat_trap;
-		return;
-	}
-
-	/* test */
-	if ( strstr( item, "cmp" ) || strstr( item, "test" ) ||
-	     strstr( item, "com" ) || strstr( item, "min" ) ||
-	     strstr( item, "max" ) || ! strncmp( "mps", item, 3 ) ||
-	    ! strncmp( "bt", item , 2 ) || ! strncmp( "ftst", item, 4 ) ) {
-		out->category = opdis_insn_cat_test;
-		return;
-	}
-
-	/* math */
-	if ( strstr( item, "add" ) || strstr( item, "sub" ) ||
-	     strstr( item, "div" ) || strstr( item, "mul" ) ||
-	     strstr( item, "cos" ) || strstr( item, "sin" ) ||
-	     strstr( item, "sqrt" ) || strstr( item, "abs" ) ||
-	     strstr( item, "avg" ) || ! strncmp( "rou", item, 3 ) ||
-	    ! strncmp( "inc", item, 3 ) || ! strncmp( "dec", item, 3 ) ||
-	    ! strncmp( "adc", item, 3 ) || ! strncmp( "fp", item, 2 ) ||
-	    ! strncmp( "fy", item, 2 ) || ! strncmp( "f2", item, 2 ) ||
-	    ! strncmp( "dp", item, 2 ) || ! strncmp( "rcp", item, 2 ) ||
-	    ! strncmp( "lea", item, 3 ) || ! strncmp( "fscale", item, 6 ) ||
-	    ! strncmp( "psad", item, 4 ) ) {
-		out->category = opdis_insn_cat_math;
-		return;
-	}
-
-	/* system instructions */
-	if (! strncmp( "inv", item, 3 ) || ! strncmp( "halt", item, 4 ) ||
-	    ! strncmp( "hlt", item, 3 ) ||
-	    ! strncmp( "clts", item, 4 ) || ! strncmp( "ltr", item, 3 ) ||
-	    ! strncmp( "rsm", item, 3 ) || ! strncmp( "wbinvd", item, 6 ) ) {
-		out->category = opdis_insn_cat_priv;
-		return;
-	}
-
-	/* i/o instructions */
-	if (! strncmp( "in", item, 2 ) ) {
-		out->category = opdis_insn_cat_io;
-		out->flags.io = opdis_io_flag_in;
-		return;
-	}
-	if (! strncmp( "out", item, 3 ) ) {
-		out->category = opdis_insn_cat_io;
-		out->flags.io = opdis_io_flag_out;
-		return;
-	}
-}
-
 typedef void (*MNEMONIC_DECODE_FN) ( opdis_insn_t *, const char * );
 static void decode_mnemonic( opdis_insn_t * insn, MNEMONIC_DECODE_FN decode_fn, 
 			    const char * item ) {
@@ -253,21 +31,35 @@ static void decode_mnemonic( opdis_insn_t * insn, MNEMONIC_DECODE_FN decode_fn,
 
 	opdis_insn_set_mnemonic( insn, buf );
 
-	decode_fn( insn, item );
+	if ( decode_fn ) {
+		decode_fn( insn, buf );
+	}
 }
 
-static const char * intel_prefixes[] = {
-	"lock", "addr16", "addr32", "rep", "repe", "repz", "repne", "repnz",
-	"cs", "ss", "ds", "es", "fs", "gs", "pt", "pn"
-};
+static void decode_intel_mnemonic( opdis_insn_t * out, const char * item ) {
+	const x86_mnemonic_def_t * def = &x86_mnemonic_slots[
+			X86_HASH_SLOT( item, x86_mnemonic_disp,
+				       X86_MNEMONIC_BUCKETS, X86_MNEMONIC_SLOTS )];
+
+	if ( def->name && ! strcmp( def->name, item ) ) {
+		out->category = (enum opdis_insn_cat_t) def->category;
+		out->flags.cflow = (enum opdis_cflow_flag_t) def->flags;
+		out->isa = (enum opdis_insn_subset_t) def->isa;
+		return;
+	}
+
+	/* mnemonic is not in the generated table */
+	x86_mnemonic_rules( out, item );
+}
+
+static const char * intel_prefixes[] = { X86_PREFIX_NAMES };
 
 static int intel_prefix_lookup( const char * item ) {
-	int i;
-	int num = (int) sizeof(intel_prefixes) / sizeof(char *);
-	for ( i = 0; i < num; i++ ) {
-		if (! strcmp(intel_prefixes[i], item) ) {
-			return i;
-		}
+	int i = x86_prefix_slots[X86_HASH_SLOT( item, x86_prefix_disp,
+				X86_PREFIX_BUCKETS, X86_PREFIX_SLOTS )];
+
+	if ( i > -1 && ! strcmp(intel_prefixes[i], item) ) {
+		return i;
 	}
 
 	return -1;
@@ -287,103 +79,12 @@ static int is_prefix_byte( opdis_byte_t b ) {
 /* ---------------------------------------------------------------------- */
 /* CPU REGISTERS */
 
-static char intel_reg_id[] = {
-	1, 2, 3, 4, 1, 2, 3, 4, 	// al, cl, dl, bl, ah, ch, dh, bh
-	1, 2, 3, 4, 5, 6, 7, 8, 	// ax, cx, dx, bx, sp, bp, si, di
-	1, 2, 3, 4, 5, 6, 7, 8, 	// eax,ecx,edx,ebx,esp,ebp,esi,edi
-	1, 2, 3, 4, 5, 6, 7, 8, 	// rax,rcx,rdx,rbx,rsp,rbp,rsi,rdi
-	9, 10, 11, 12, 13, 14, 15, 16, 	// r8 - r15
-	9, 10, 11, 12, 13, 14, 15, 16, 	// r8l - r15l
-	9, 10, 11, 12, 13, 14, 15, 16, 	// r8w - r15w
-	9, 10, 11, 12, 13, 14, 15, 16, 	// r8d - r15d
-	17, 18, 19, 20, 21, 22, 23, 24, // mm0 - mm7
-	25, 26, 27, 28, 29, 30, 31, 32,	// xmm0 - xmm7
-	17, 18, 19, 20, 21, 22, 23, 24, // st(0) - st(7)
-	33, 34, 35, 36, 37, 38, 39, 40, // cr0 - cr7
-	41, 42, 43, 44, 45, 46, 47, 48, // dr0 - dr7
-	49, 50, 51, 52, 53, 54, 	// cs, ds, ss, es, fs, gs 
-	55, 55, 56, 56, 		// eip, rip, eflags, rflags
-	5, 6, 7, 8, 			// spl, bpl, sil, dil
-	57, 58, 59, 60, 61 		// gdtr, ldtr, idtr, tr, mxcsr
-};
-
-static enum opdis_reg_flag_t lookup_register_type( unsigned int id ) {
-	enum opdis_reg_flag_t type = opdis_reg_flag_unknown;
-
-	if ( id == 5 ) {
-		type = opdis_reg_flag_gen | opdis_reg_flag_stack;
-	} else if ( id == 6 ) {
-		type = opdis_reg_flag_gen | opdis_reg_flag_frame;
-	} else if ( id <= 16 ) {
-		type = opdis_reg_flag_gen;
-	} else if ( id >= 17 && id <= 24 ) {
-		type = opdis_reg_flag_fpu | opdis_reg_flag_simd;
-	} else if (( id >= 25 && id <= 32 ) || id == 61 ) {
-		type = opdis_reg_flag_simd;
-	} else if ( id >= 33 && id <= 40 ) {
-		type = opdis_reg_flag_task;
-	} else if ( id >= 41 && id <= 48 ) {
-		type = opdis_reg_flag_debug;
-	} else if ( id >= 49 && id <= 54 ) {
-		type = opdis_reg_flag_gen | opdis_reg_flag_seg;
-	} else if ( id == 55 ) {
-		type = opdis_reg_flag_pc;
-	} else if ( id == 56 ) {
-		type = opdis_reg_flag_flags;
-	} else if ( id >= 57 && id <= 60 ) {
-		type = opdis_reg_flag_mem;
-	}
-
-	return type;
-}
-
-static char intel_reg_size[] = {
-	1, 1, 1, 1, 1, 1, 1, 1, 	// al, cl, dl, bl, ah, ch, dh, bh
-	2, 2, 2, 2, 2, 2, 2, 2, 	// ax, cx, dx, bx, sp, bp, si, di
-	4, 4, 4, 4, 4, 4, 4, 4, 	// eax,ecx,edx,ebx,esp,ebp,esi,edi
-	8, 8, 8, 8, 8, 8, 8, 8, 	// rax,rcx,rdx,rbx,rsp,rbp,rsi,rdi
-	8, 8, 8, 8, 8, 8, 8, 8, 	// r8 - r15
-	1, 1, 1, 1, 1, 1, 1, 1, 	// r8l - r15l
-	2, 2, 2, 2, 2, 2, 2, 2, 	// r8w - r15w
-	4, 4, 4, 4, 4, 4, 4, 4, 	// r8d - r15d
-	8, 8, 8, 8, 8, 8, 8, 8, 	// mm0 - mm7
-	16, 16, 16, 16, 16, 16, 16, 16,	// xmm0 - xmm7
-	10, 10, 10, 10, 10, 10, 10, 10,	// st(0) - st(7)
-	4, 4, 4, 4, 4, 4, 4, 4, 	// cr0 - cr7
-	4, 4, 4, 4, 4, 4, 4, 4, 	// dr0 - dr7
-	2, 2, 2, 2, 2, 2, 		// cs, ds, ss, es, fs, gs 
-	4, 8, 4, 8, 			// eip, rip, eflags, rflags
-	1, 1, 1, 1, 			// spl, bpl, sil, dil
-	6, 6, 6, 6, 4 			// gdtr, ldtr, idtr, tr, mxcsr
-};
-
-static const char * intel_registers[] = {
-	"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh",
-	"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
-	"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
-	"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
-	"r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
-	"r8l", "r9l", "r10l", "r11l", "r12l", "r13l", "r14l", "r15l",
-	"r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w",
-	"r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
-	"mm0", "mm1", "mm2", "mm3", "mm4", "mm5", "mm6", "mm7",
-	"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
-	"st(0)", "st(1)", "st(2)", "st(3)", "st(4)", "st(5)", "st(6)", "st(7)",
-	"cr0", "cr1", "cr2", "cr3", "cr4", "cr5", "cr6", "cr7",
-	"dr0", "dr1", "dr2", "dr3", "dr4", "dr5", "dr6", "dr7",
-	"cs", "ds", "ss", "es", "fs", "gs", 
-	"eip", "rip", "eflags", "rflags",
-	"spl", "bpl", "sil", "dil", 
-	"gdtr", "ldtr", "idtr", "tr", "mxcsr"
-};
-
 static int intel_register_lookup( const char * item ) {
-	int i;
-	int num_regs = (int) sizeof(intel_registers) / sizeof(char *);
-	for ( i = 0; i < num_regs; i++ ) {
-		if (! strcmp(intel_registers[i], item) ) {
-			return i;
-		}
+	int i = x86_register_slots[X86_HASH_SLOT( item, x86_register_disp,
+				X86_REGISTER_BUCKETS, X86_REGISTER_SLOTS )];
+
+	if ( i > -1 && ! strcmp(intel_registers[i], item) ) {
+		return i;
 	}
 
 	return -1;
@@ -444,7 +145,9 @@ static int decode_operand( opdis_op_t * op, OPERAND_DECODE_FN decode_fn,
 	op->category = opdis_op_cat_unknown;
 	op->flags = opdis_op_flag_none;
 	opdis_op_set_ascii( op, item );
-	decode_fn( op, item );
+	if ( decode_fn ) {
+		decode_fn( op, item );
+	}
 
 	return 1;
 }
@@ -452,6 +155,24 @@ static int decode_operand( opdis_op_t * op, OPERAND_DECODE_FN decode_fn,
 /* ---------------------------------------------------------------------- */
 /* SHARED DECODING */
 
+/* levels of decoding requested by the disassembler */
+static unsigned int decode_levels( const opdis_insn_buf_t in ) {
+	return ( in->decode_mask ) ? in->decode_mask : OPDIS_DECODE_ALL;
+}
+
+/* levels which were decoded, for insn status */
+static enum opdis_insn_decode_t decoded_levels( unsigned int levels ) {
+	/* the mnemonic flags are looked up from the mnemonic, and the
+	 * operand flags from the operands */
+	if (! (levels & opdis_decode_mnem) ) {
+		levels &= ~opdis_decode_mnem_flags;
+	}
+	if (! (levels & opdis_decode_ops) ) {
+		levels &= ~opdis_decode_op_flags;
+	}
+	return (enum opdis_insn_decode_t) (levels | opdis_decode_basic);
+}
+
 struct INSN_BUF_PARSE {
 	int pfx, mnem, first_op, last_op, cmt, cmt_char;
 };
@@ -502,6 +223,61 @@ static void parse_insn_buf( const opdis_insn_buf_t in, IS_OPERAND_FN is_operand,
 	}
 }
 
+/* Styled libopcodes output: the span types identify the mnemonic, operand
+ * and comment items, so the items do not have to be examined. */
+static int parse_insn_spans( const opdis_insn_buf_t in, 
+			     struct INSN_BUF_PARSE * parse ) {
+	unsigned int i;
+
+	/* all spans must be present, or items will be missed */
+	if (! in->span_count || in->span_count >= in->max_span_count ) {
+		return 0;
+	}
+
+	parse->pfx = parse->mnem = parse->first_op = parse->last_op = 
+		     parse->cmt = parse->cmt_char = -1;
+
+	for ( i = 0; i < in->span_count; i++ ) {
+		const opdis_insn_span_t * span = &in->spans[i];
+		int item = (int) span->item;
+
+		switch ( span->type ) {
+			case opdis_span_mnemonic:
+			case opdis_span_directive:
+				/* the last mnemonic item before operands
+				 * is the mnemonic; the rest are prefixes */
+				if ( parse->first_op == -1 ) {
+					parse->mnem = item;
+				}
+				break;
+			case opdis_span_comment:
+				if ( parse->cmt_char == -1 ) {
+					parse->cmt_char = item;
+				} else if ( parse->cmt == -1 && 
+					    item != parse->cmt_char ) {
+					parse->cmt = item;
+				}
+				break;
+			default:
+				if ( parse->cmt_char == -1 && 
+				     item > parse->mnem &&
+				     in->items[item][0] != ',' ) {
+					if ( parse->first_op == -1 ) {
+						parse->first_op = item;
+					}
+					parse->last_op = item;
+				}
+				break;
+		}
+	}
+
+	if ( parse->mnem > 0 ) {
+		parse->pfx = 0;
+	}
+
+	return 1;
+}
+
 static void add_prefixes( const opdis_insn_buf_t in, opdis_insn_t * out,
 			  struct INSN_BUF_PARSE * parse ) {
 	int i, max_i, rv;
@@ -683,16 +459,24 @@ int opdis_x86_att_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 			   opdis_vma_t vma, opdis_off_t length, void * arg ) {
 
 	int i, max_i, rv;
+	unsigned int levels = decode_levels( in );
 	struct INSN_BUF_PARSE parse = { 0 };
 
 	rv = opdis_default_decoder( in, out, buf, offset, vma, length, NULL );
+	if (! (levels & (opdis_decode_mnem | opdis_decode_ops)) ) {
+		return rv;
+	}
 
-	parse_insn_buf( in, is_att_operand, & parse );
+	if (! parse_insn_spans( in, &parse ) ) {
+		parse_insn_buf( in, is_att_operand, & parse );
+	}
 
-	add_prefixes( in, out, &parse );
+	if ( levels & opdis_decode_mnem ) {
+		add_prefixes( in, out, &parse );
+	}
 
 	/* fill instruction info */
-	if ( parse.mnem > -1 ) {
+	if ( parse.mnem > -1 && (levels & opdis_decode_mnem) ) {
 		char *c, mnem[32];
 		int i;
 
@@ -713,14 +497,18 @@ int opdis_x86_att_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 			opdis_insn_add_prefix( out, buf );
 		}
 
-		decode_mnemonic( out, decode_att_mnemonic, mnem );
+		decode_mnemonic( out, (levels & opdis_decode_mnem_flags) ?
+				 decode_att_mnemonic : NULL, mnem );
 	}
 
 	/* fill operands */
-	for ( i = parse.first_op; i > -1 && i <= parse.last_op; i++ ) {
+	for ( i = parse.first_op; (levels & opdis_decode_ops) && i > -1 && 
+	      i <= parse.last_op; i++ ) {
 		if ( in->items[i][0] != ',' ) {
 			decode_operand( opdis_insn_next_avail_op(out),
-					decode_att_operand, in->items[i] );
+					(levels & opdis_decode_op_flags) ? 
+					decode_att_operand : NULL, 
+					in->items[i] );
 		}
 	}
 
@@ -732,6 +520,11 @@ int opdis_x86_att_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 		     (out->flags.cflow >= opdis_cflow_flag_call &&
 		      out->flags.cflow <= opdis_cflow_flag_jmpcc ) ) {
 			out->target = out->operands[0];
+			if (! (levels & opdis_decode_op_flags) ) {
+				/* the branch target is always decoded */
+				decode_att_operand( out->target, 
+						    out->target->ascii );
+			}
 			out->target->flags |= opdis_op_flag_r | opdis_op_flag_x;
 		}
 	} else if ( out->num_operands > 0 ) {
@@ -748,9 +541,7 @@ int opdis_x86_att_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 
 	// NOTE: it might be better to set the *_flags status(es) only
 	//       when insn and operands have been successfully parsed
-	out->status |= (opdis_decode_basic | opdis_decode_mnem | 
-			opdis_decode_ops | opdis_decode_mnem_flags |
-			opdis_decode_op_flags);
+	out->status |= decoded_levels( levels );
 
 	return rv;
 }
@@ -905,25 +696,37 @@ int opdis_x86_intel_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 			     opdis_vma_t vma, opdis_off_t length, void * arg ) {
 
 	int i, max_i, rv;
+	unsigned int levels = decode_levels( in );
 	struct INSN_BUF_PARSE parse = { 0 };
 
 	rv = opdis_default_decoder( in, out, buf, offset, vma, length, NULL );
+	if (! (levels & (opdis_decode_mnem | opdis_decode_ops)) ) {
+		return rv;
+	}
 
-	parse_insn_buf( in, is_intel_operand, & parse );
-
-	add_prefixes( in, out, & parse );
+	if (! parse_insn_spans( in, &parse ) ) {
+		parse_insn_buf( in, is_intel_operand, & parse );
+	}
 
 	/* fill instruction info */
-	if ( parse.mnem > -1 ) {
-		decode_mnemonic( out, decode_intel_mnemonic, 
-				 in->items[parse.mnem] );
+	if ( levels & opdis_decode_mnem ) {
+		add_prefixes( in, out, & parse );
+		if ( parse.mnem > -1 ) {
+			decode_mnemonic( out, 
+					 (levels & opdis_decode_mnem_flags) ?
+					 decode_intel_mnemonic : NULL, 
+					 in->items[parse.mnem] );
+		}
 	}
 
 	/* fill operands */
-	for ( i = parse.first_op; i > -1 && i <= parse.last_op; i++ ) {
+	for ( i = parse.first_op; (levels & opdis_decode_ops) && i > -1 && 
+	      i <= parse.last_op; i++ ) {
  		if ( in->items[i][0] != ',' ) {
 			decode_operand( opdis_insn_next_avail_op(out),
-					decode_intel_operand, in->items[i] );
+					(levels & opdis_decode_op_flags) ?
+					decode_intel_operand : NULL, 
+					in->items[i] );
 		}
 	}
 
@@ -935,6 +738,11 @@ int opdis_x86_intel_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 		     (out->flags.cflow >= opdis_cflow_flag_call &&
 		      out->flags.cflow <= opdis_cflow_flag_jmpcc ) ) {
 			out->target = out->operands[0];
+			if (! (levels & opdis_decode_op_flags) ) {
+				/* the branch target is always decoded */
+				decode_intel_operand( out->target, 
+						      out->target->ascii );
+			}
 			out->target->flags |= opdis_op_flag_r | opdis_op_flag_x;
 		}
 	} else if ( out->num_operands > 0 ) {
@@ -947,9 +755,7 @@ int opdis_x86_intel_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
 		}
 	}
 	
-	out->status |= (opdis_decode_basic | opdis_decode_mnem | 
-			opdis_decode_ops | opdis_decode_mnem_flags |
-			opdis_decode_op_flags);
+	out->status |= decoded_levels( levels );
 
 	return rv;
 }
@@ -0,0 +1,408 @@
+/*!
+ * \file x86_length.c
+ * \brief Table-driven length decoder for x86 and x86-64 instructions
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <opdis/x86_length.h>
+
+/* ---------------------------------------------------------------------- */
+/* OPCODE TABLES */
+
+/* operand encoding of an opcode */
+#define LM	0x01		/* ModR/M byte */
+#define LI8	0x02		/* 8-bit immediate */
+#define LI16	0x04		/* 16-bit immediate */
+#define LIZ	0x08		/* 16- or 32-bit immediate (operand size) */
+#define LIV	0x10		/* 16-, 32- or 64-bit immediate (operand size) */
+#define LAO	0x20		/* memory offset (address size) */
+#define LPFX	0x40		/* legacy prefix */
+#define LX64	0x80		/* invalid in 64-bit mode */
+
+/* one-byte opcodes. 0F (escape), 40-4F (REX), 62 (EVEX), 8F (XOP),
+ * C4/C5 (VEX) and F6/F7 (group 3) are also handled in insn_length */
+static const unsigned char one_byte[256] = {
+/*	 0      1      2      3      4      5      6      7  */
+/*	 8      9      A      B      C      D      E      F  */
+/* 0 */	LM,    LM,    LM,    LM,    LI8,   LIZ,   LX64,  LX64,
+	LM,    LM,    LM,    LM,    LI8,   LIZ,   LX64,  0,
+/* 1 */	LM,    LM,    LM,    LM,    LI8,   LIZ,   LX64,  LX64,
+	LM,    LM,    LM,    LM,    LI8,   LIZ,   LX64,  LX64,
+/* 2 */	LM,    LM,    LM,    LM,    LI8,   LIZ,   LPFX,  LX64,
+	LM,    LM,    LM,    LM,    LI8,   LIZ,   LPFX,  LX64,
+/* 3 */	LM,    LM,    LM,    LM,    LI8,   LIZ,   LPFX,  LX64,
+	LM,    LM,    LM,    LM,    LI8,   LIZ,   LPFX,  LX64,
+/* 4 */	0,     0,     0,     0,     0,     0,     0,     0,
+	0,     0,     0,     0,     0,     0,     0,     0,
+/* 5 */	0,     0,     0,     0,     0,     0,     0,     0,
+	0,     0,     0,     0,     0,     0,     0,     0,
+/* 6 */	LX64,  LX64,  LM|LX64, LM,  LPFX,  LPFX,  LPFX,  LPFX,
+	LIZ,   LM|LIZ, LI8,  LM|LI8, 0,    0,     0,     0,
+/* 7 */	LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,
+	LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,
+/* 8 */	LM|LI8, LM|LIZ, LM|LI8|LX64, LM|LI8, LM, LM,  LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 9 */	0,     0,     0,     0,     0,     0,     0,     0,
+	0,     0,     LIZ|LI16|LX64, 0, 0, 0,     0,     0,
+/* A */	LAO,   LAO,   LAO,   LAO,   0,     0,     0,     0,
+	LI8,   LIZ,   0,     0,     0,     0,     0,     0,
+/* B */	LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,
+	LIV,   LIV,   LIV,   LIV,   LIV,   LIV,   LIV,   LIV,
+/* C */	LM|LI8, LM|LI8, LI16, 0,    LM|LX64, LM|LX64, LM|LI8, LM|LIZ,
+	LI16|LI8, 0,  LI16,  0,     0,     LI8,   LX64,  0,
+/* D */	LM,    LM,    LM,    LM,    LI8|LX64, LI8|LX64, LX64, 0,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* E */	LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,   LI8,
+	LIZ,   LIZ,   LIZ|LI16|LX64, LI8, 0, 0,   0,     0,
+/* F */	LPFX,  0,     LPFX,  LPFX,  0,     0,     LM,    LM,
+	0,     0,     0,     0,     0,     0,     LM,    LM
+};
+
+/* two-byte (0F xx) opcodes, also used for VEX and EVEX map 1. 0F 0F
+ * (3DNow!) takes its opcode as an 8-bit immediate; 0F 38 and 0F 3A are
+ * handled in insn_length */
+static const unsigned char two_byte[256] = {
+/*	 0      1      2      3      4      5      6      7  */
+/*	 8      9      A      B      C      D      E      F  */
+/* 0 */	LM,    LM,    LM,    LM,    0,     0,     0,     0,
+	0,     0,     0,     0,     0,     LM,    0,     LM|LI8,
+/* 1 */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 2 */	LM,    LM,    LM,    LM,    LM,    0,     LM,    0,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 3 */	0,     0,     0,     0,     0,     0,     0,     0,
+	0,     0,     0,     0,     0,     0,     0,     0,
+/* 4 */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 5 */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 6 */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 7 */	LM|LI8, LM|LI8, LM|LI8, LM|LI8, LM, LM,   LM,    0,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* 8 */	LIZ,   LIZ,   LIZ,   LIZ,   LIZ,   LIZ,   LIZ,   LIZ,
+	LIZ,   LIZ,   LIZ,   LIZ,   LIZ,   LIZ,   LIZ,   LIZ,
+/* 9 */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* A */	0,     0,     0,     LM,    LM|LI8, LM,   0,     0,
+	0,     0,     0,     LM,    LM|LI8, LM,   LM,    LM,
+/* B */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM|LI8, LM,   LM,    LM,    LM,    LM,
+/* C */	LM,    LM,    LM|LI8, LM,   LM|LI8, LM|LI8, LM|LI8, LM,
+	0,     0,     0,     0,     0,     0,     0,     0,
+/* D */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* E */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+/* F */	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM,
+	LM,    LM,    LM,    LM,    LM,    LM,    LM,    LM
+};
+
+/* operand encoding of an opcode in a VEX, EVEX or XOP opcode map */
+static unsigned char map_flags( unsigned int map, opdis_byte_t op ) {
+	switch ( map ) {
+		case 1: return two_byte[op];		/* 0F */
+		case 3: return LM | LI8;		/* 0F 3A */
+		case 8: return LM | LI8;		/* XOP 8 */
+		default: return LM;			/* 0F 38, XOP 9, ... */
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+/* LENGTH DECODER */
+
+/* VEX and EVEX payloads which select a defined opcode map */
+static int valid_map( opdis_byte_t esc, const opdis_byte_t * payload ) {
+	unsigned int map;
+
+	if ( esc == 0xC5 ) {
+		return 1;
+	}
+	if ( esc == 0xC4 ) {
+		map = payload[0] & 0x1F;
+		return map >= 1 && map <= 3;
+	}
+
+	/* EVEX has a reserved 0 in P0 and a reserved 1 in P1 */
+	map = payload[0] & 0x07;
+	return (payload[0] & 0x08) == 0 && (payload[1] & 0x04) &&
+	       map != 0 && map != 4 && map != 7;
+}
+
+/* opcodes defined in VEX map 1 */
+static int vex_valid( opdis_byte_t op ) {
+	return ( op >= 0x10 && op <= 0x17 ) || ( op >= 0x28 && op <= 0x2F ) ||
+	       ( op >= 0x41 && op <= 0x4B && op != 0x43 && op != 0x48 &&
+		 op != 0x49 ) ||
+	       ( op >= 0x50 && op <= 0x77 ) || ( op >= 0x7C && op <= 0x7F ) ||
+	       ( op >= 0x90 && op <= 0x93 ) || op == 0x98 || op == 0x99 ||
+	       op == 0xAE || op == 0xC2 || ( op >= 0xC4 && op <= 0xC6 ) ||
+	       ( op >= 0xD0 && op <= 0xFE );
+}
+
+/* VEX map 1 opcodes which are only defined for packed integers (66) */
+static int vex_needs_66( opdis_byte_t op ) {
+	return ( op >= 0x60 && op <= 0x6E ) || ( op >= 0x71 && op <= 0x76 ) ||
+	       ( op >= 0xD1 && op <= 0xEF && op != 0xE6 ) ||
+	       ( op >= 0xF1 && op <= 0xFE );
+}
+
+/* opcodes defined in the XOP maps */
+static int xop_valid( unsigned int map, opdis_byte_t op ) {
+	switch ( map ) {
+		case 8:
+			return ( op >= 0x85 && op <= 0x87 ) || op == 0x8E ||
+			       op == 0x8F || ( op >= 0x95 && op <= 0x97 ) ||
+			       op == 0x9E || op == 0x9F || op == 0xA2 ||
+			       op == 0xA3 || op == 0xA6 || op == 0xB6 ||
+			       ( op >= 0xC0 && op <= 0xC3 ) ||
+			       ( op >= 0xCC && op <= 0xCF ) ||
+			       ( op >= 0xEC && op <= 0xEF );
+		case 9:
+			return op == 0x01 || op == 0x02 || op == 0x12 ||
+			       ( op >= 0x80 && op <= 0x83 ) ||
+			       ( op >= 0x90 && op <= 0x9B ) ||
+			       ( op >= 0xC1 && op <= 0xC3 ) || op == 0xC6 ||
+			       op == 0xC7 || op == 0xCB ||
+			       ( op >= 0xD1 && op <= 0xD3 ) || op == 0xD6 ||
+			       op == 0xD7 || op == 0xDB ||
+			       ( op >= 0xE1 && op <= 0xE3 );
+		default:
+			return op == 0x10 || op == 0x12;
+	}
+}
+
+/* one-byte opcodes whose ModR/M selects an undefined insn. As with other
+ * invalid opcodes, libopcodes does not consume the ModR/M of these */
+static int invalid_modrm( opdis_byte_t op, opdis_byte_t modrm ) {
+	unsigned int reg = (modrm >> 3) & 7;
+
+	switch ( op ) {
+		case 0x8D: return ( modrm >> 6 ) == 3;		/* LEA */
+		case 0x8F: return reg != 0;			/* POP */
+		case 0xC6: case 0xC7:				/* MOV */
+			return reg != 0 && modrm != 0xF8;	/* XABORT, XBEGIN */
+		case 0xFE: return reg > 1;			/* INC, DEC */
+		case 0xFF: return reg == 7 ||			/* far jmp/call */
+				  ( (reg == 3 || reg == 5) && (modrm >> 6) == 3 );
+		default: return 0;
+	}
+}
+
+/* size of ModR/M displacement, SIB byte included */
+static unsigned int modrm_extra( const opdis_byte_t * p,
+				 const opdis_byte_t * end,
+				 unsigned int addr_size ) {
+	unsigned int mod = p[0] >> 6, rm = p[0] & 7;
+
+	if ( mod == 3 ) {
+		return 0;
+	}
+
+	if ( addr_size == 16 ) {
+		if ( mod == 0 ) {
+			return ( rm == 6 ) ? 2 : 0;
+		}
+		return ( mod == 1 ) ? 1 : 2;
+	}
+
+	if ( rm == 4 ) {
+		/* SIB byte; base 5 with mod 0 is disp32 */
+		if ( p + 1 >= end ) {
+			return (unsigned int) ( end - p );
+		}
+		if ( mod == 0 ) {
+			return ( (p[1] & 7) == 5 ) ? 5 : 1;
+		}
+		return ( mod == 1 ) ? 2 : 5;
+	}
+
+	if ( mod == 0 ) {
+		return ( rm == 5 ) ? 4 : 0;
+	}
+	return ( mod == 1 ) ? 1 : 4;
+}
+
+unsigned int LIBCALL opdis_x86_insn_length( const opdis_byte_t * buf,
+					    opdis_off_t len,
+					    enum opdis_x86_mode_t mode ) {
+	const opdis_byte_t * p = buf, * end = buf + len;
+	unsigned int op_size = ( mode == opdis_x86_mode_16 ) ? 16 : 32;
+	unsigned int addr_size = mode;
+	unsigned int flags, imm = 0, size;
+	int rex = 0, rex_w = 0, is_pfx;
+	int legacy_map = 1, no_disp = 0;
+	opdis_byte_t op, esc;
+
+	if (! buf ) {
+		return 0;
+	}
+
+	/* prefixes. REX must immediately precede the opcode */
+	for ( ;; p++ ) {
+		if ( p >= end ) {
+			return 0;
+		}
+		op = *p;
+		/* FWAIT is decoded as part of a following FPU insn */
+		is_pfx = ( one_byte[op] & LPFX ) ||
+			 ( op == 0x9B && p + 1 < end && p[1] >= 0xD8 &&
+			   p[1] <= 0xDF );
+		if ( rex && ( (op & 0xF0) == 0x40 || is_pfx || op == 0x9B ) ) {
+			/* libopcodes ends the insn at a REX that is not
+			 * followed by the opcode */
+			return (unsigned int) ( p - buf );
+		}
+		if ( mode == opdis_x86_mode_64 && (op & 0xF0) == 0x40 ) {
+			rex = 1;
+			rex_w = op & 0x08;
+			continue;
+		}
+		if (! is_pfx ) {
+			break;
+		}
+		if ( p - buf == OPDIS_X86_MAX_INSN - 1 ) {
+			/* libopcodes emits a run of prefixes as an insn */
+			return OPDIS_X86_MAX_INSN - 1;
+		}
+		if ( op == 0x66 ) {
+			op_size = ( mode == opdis_x86_mode_16 ) ? 32 : 16;
+		} else if ( op == 0x67 ) {
+			addr_size = ( mode == opdis_x86_mode_64 ) ? 32 :
+				    ( mode == opdis_x86_mode_32 ) ? 16 : 32;
+		}
+	}
+	if ( rex_w ) {
+		op_size = 64;
+	}
+
+	/* opcode */
+	p++;
+	flags = one_byte[op];
+	if ( op == 0x0F ) {
+		if ( p >= end ) {
+			return 0;
+		}
+		op = *p++;
+		legacy_map = 0;
+		if ( op == 0x38 || op == 0x3A ) {
+			if ( p >= end ) {
+				return 0;
+			}
+			flags = map_flags( ( op == 0x38 ) ? 2 : 3, *p++ );
+		} else {
+			flags = two_byte[op];
+			/* mov to/from control, debug and test regs ignores
+			 * mod */
+			no_disp = ( op >= 0x20 && op <= 0x26 );
+		}
+
+	} else if ( (op == 0xC4 || op == 0xC5 || op == 0x62) &&
+		    p < end && ( mode == opdis_x86_mode_64 ||
+				 (*p & 0xC0) == 0xC0 ) ) {
+		/* VEX or EVEX; outside of 64-bit mode, LES/LDS/BOUND have a
+		 * memory operand and so never have mod 11 */
+		unsigned int pp, payload = ( op == 0xC5 ) ? 1 :
+				       ( op == 0xC4 ) ? 2 : 3;
+		unsigned int map = ( op == 0xC5 ) ? 1 :
+				   ( op == 0xC4 ) ? (*p & 0x1F) : (*p & 0x07);
+		if ( p + payload >= end ) {
+			return 0;
+		}
+		if (! valid_map( op, p ) ) {
+			/* libopcodes stops at the first reserved bit */
+			return (unsigned int) ( p - buf ) +
+			       ( op == 0x62 && ! (p[0] & 0x08) );
+		}
+		/* the implied 66/F3/F2 prefix is in VEX byte 1 or EVEX P1 */
+		pp = p[( op == 0xC5 ) ? 0 : 1] & 3;
+		p += payload;
+		esc = op;
+		op = *p++;
+		if ( map == 1 && ( ( pp != 1 && vex_needs_66( op ) ) ||
+				   ( esc != 0x62 && ! vex_valid( op ) ) ) ) {
+			/* libopcodes consumes the opcode of a bad insn */
+			return (unsigned int) ( p - buf );
+		}
+		flags = map_flags( map, op ) | LM;
+		if ( map == 1 && op == 0x77 ) {
+			/* vzeroupper/vzeroall */
+			flags = 0;
+		}
+		legacy_map = 0;
+
+	} else if ( op == 0x8F && p < end && (*p & 0x1F) >= 8 &&
+		    (*p & 0x1F) <= 0xA ) {
+		/* XOP; POP Ev uses a ModR/M with reg 0, so map < 8 */
+		unsigned int map = *p & 0x1F;
+		if ( p + 2 >= end ) {
+			return 0;
+		}
+		p += 2;
+		op = *p++;
+		if (! xop_valid( map, op ) ) {
+			return (unsigned int) ( p - buf );
+		}
+		flags = map_flags( map, op );
+		if ( map == 0xA ) {
+			/* XOP map A has a 32-bit immediate */
+			imm = 4;
+		}
+		legacy_map = 0;
+	}
+
+	if ( mode == opdis_x86_mode_64 && (flags & LX64) ) {
+		/* libopcodes consumes only the opcode of a bad insn */
+		return (unsigned int) ( p - buf );
+	}
+
+	/* ModR/M, SIB and displacement */
+	if ( flags & LM ) {
+		if ( p >= end ) {
+			return 0;
+		}
+		if ( legacy_map && invalid_modrm( op, *p ) ) {
+			return (unsigned int) ( p - buf );
+		}
+		if ( legacy_map && (op == 0xF6 || op == 0xF7) &&
+		     ((*p >> 3) & 7) < 2 ) {
+			/* TEST Eb,Ib / TEST Ev,Iz */
+			flags |= ( op == 0xF6 ) ? LI8 : LIZ;
+		}
+		if (! no_disp ) {
+			p += modrm_extra( p, end, addr_size );
+		}
+		p++;
+	}
+
+	/* immediates */
+	if ( flags & LI8 ) {
+		imm += 1;
+	}
+	if ( flags & LI16 ) {
+		imm += 2;
+	}
+	if ( flags & LIZ ) {
+		imm += ( op_size == 16 ) ? 2 : 4;
+	}
+	if ( flags & LIV ) {
+		imm += op_size / 8;
+	}
+	if ( flags & LAO ) {
+		imm += addr_size / 8;
+	}
+
+	size = (unsigned int) ( p - buf ) + imm;
+	if ( size > OPDIS_X86_MAX_INSN && len >= OPDIS_X86_MAX_INSN ) {
+		/* libopcodes reports a bad insn of the max length */
+		return OPDIS_X86_MAX_INSN;
+	}
+	if ( size > len ) {
+		return 0;
+	}
+
+	return size;
+}
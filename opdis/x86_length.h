@@ -0,0 +1,71 @@
+/*!
+ * \file x86_length.h
+ * \brief Table-driven length decoder for x86 and x86-64 instructions
+ * \details This determines the size of an x86 instruction from its prefixes,
+ *          opcode, ModR/M and SIB bytes without disassembling it. It is used
+ *          by opdis_insn_lengths for x86 targets.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_X86_LENGTH_H
+#define OPDIS_X86_LENGTH_H
+
+#include <opdis/types.h>
+
+#ifdef WIN32
+        #define LIBCALL _stdcall
+#else
+        #define LIBCALL
+#endif
+
+/*!
+ * \def OPDIS_X86_MAX_INSN
+ * \ingroup x86
+ * \brief The architectural limit on the size of an x86 instruction.
+ */
+#define OPDIS_X86_MAX_INSN 15
+
+/*!
+ * \enum opdis_x86_mode_t
+ * \ingroup x86
+ * \brief The default operand and address size of x86 code.
+ */
+enum opdis_x86_mode_t {
+	opdis_x86_mode_16 = 16,		/*!< Real mode or 16-bit segment */
+	opdis_x86_mode_32 = 32,		/*!< 32-bit protected mode */
+	opdis_x86_mode_64 = 64		/*!< 64-bit long mode */
+};
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn unsigned int opdis_x86_insn_length( const opdis_byte_t *, opdis_off_t,
+ * 					   enum opdis_x86_mode_t )
+ * \ingroup x86
+ * \brief Return the size of the x86 instruction at the start of a buffer.
+ * \param buf The instruction bytes.
+ * \param len The number of bytes available in \e buf.
+ * \param mode The processor mode of the code.
+ * \return The size of the instruction in bytes, or 0 if the instruction
+ *         extends past \e len bytes.
+ * \note As with libopcodes, an opcode which is undefined or invalid in
+ *       \e mode is reported as ending after its opcode byte, and an
+ *       instruction longer than OPDIS_X86_MAX_INSN bytes is reported as
+ *       OPDIS_X86_MAX_INSN bytes. Sizes of undefined encodings may still
+ *       differ from libopcodes, which checks every opcode and operand.
+ */
+unsigned int LIBCALL opdis_x86_insn_length( const opdis_byte_t * buf,
+					    opdis_off_t len,
+					    enum opdis_x86_mode_t mode );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1185 @@
+/*!
+ * \file x86_native.c
+ * \brief Native table-driven decoder for x86 and x86-64 instructions
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+#include <opdis/x86_decoder.h>
+#include <opdis/x86_native.h>
+#include <opdis/x86_rules.h>
+#include <opdis/x86_tables.h>
+
+/* ---------------------------------------------------------------------- */
+/* OPCODE TABLES */
+
+/* operand specifiers, as in the opcode maps of the Intel SDM */
+enum {
+	O_NONE,
+	O_Eb, O_Ew, O_Ed, O_Ev,		/* ModR/M r/m register or memory */
+	O_M,				/* ModR/M memory, no data size */
+	O_Gb, O_Gv,			/* ModR/M reg register */
+	O_Zb, O_Zv,			/* register in low 3 bits of opcode */
+	O_AL, O_rAX, O_CL,		/* fixed registers */
+	O_1,				/* implicit shift count of 1 */
+	O_Ib,				/* 8-bit immediate */
+	O_Ibs,				/* 8-bit immediate, sign-extended */
+	O_Iw,				/* 16-bit immediate */
+	O_Iz,				/* 16- or 32-bit immediate, sign-extended */
+	O_Iv,				/* 16-, 32- or 64-bit immediate */
+	O_Jb, O_Jz			/* relative branch target */
+};
+
+/* opcode flags */
+#define NF_D64		0x001	/* 64-bit operand size in 64-bit mode */
+#define NF_F64		0x002	/* forced 64-bit operand size; no 0x66 */
+#define NF_I64		0x004	/* invalid in 64-bit mode */
+#define NF_W64		0x008	/* only valid in 64-bit mode with REX.W */
+#define NF_LOCK		0x010	/* LOCK is valid with a memory operand */
+#define NF_NOSFX	0x020	/* no AT&T operand size suffix */
+#define NF_IND		0x040	/* operand is an indirect branch target */
+#define NF_CONV		0x080	/* mnemonic is selected by operand size */
+#define NF_EXT		0x100	/* AT&T mnemonic encodes both operand sizes */
+#define NF_ABS		0x200	/* movabs with a 64-bit immediate */
+
+/* opcode groups: the ModR/M reg field selects the opcode */
+enum {
+	G_NONE, G_1, G_1A, G_2, G_3b, G_3v, G_4, G_5, G_8, G_11b, G_11v,
+	G_NOP
+};
+
+typedef struct {
+	const char * mnemonic;		/* NULL if not decoded natively */
+	unsigned char ops[3];		/* operand specifiers, Intel order */
+	unsigned short flags;
+	unsigned char group;
+} x86_native_op_t;
+
+#define ALU( op, name, lock ) \
+	[op]     = { name, { O_Eb, O_Gb }, lock }, \
+	[op + 1] = { name, { O_Ev, O_Gv }, lock }, \
+	[op + 2] = { name, { O_Gb, O_Eb } }, \
+	[op + 3] = { name, { O_Gv, O_Ev } }, \
+	[op + 4] = { name, { O_AL, O_Ib } }, \
+	[op + 5] = { name, { O_rAX, O_Iz } }
+
+#define CC( op, pfx, ops, flags ) \
+	[op]      = { pfx "o", ops, flags },  [op + 1]  = { pfx "no", ops, flags },\
+	[op + 2]  = { pfx "b", ops, flags },  [op + 3]  = { pfx "ae", ops, flags },\
+	[op + 4]  = { pfx "e", ops, flags },  [op + 5]  = { pfx "ne", ops, flags },\
+	[op + 6]  = { pfx "be", ops, flags }, [op + 7]  = { pfx "a", ops, flags }, \
+	[op + 8]  = { pfx "s", ops, flags },  [op + 9]  = { pfx "ns", ops, flags },\
+	[op + 10] = { pfx "p", ops, flags },  [op + 11] = { pfx "np", ops, flags },\
+	[op + 12] = { pfx "l", ops, flags },  [op + 13] = { pfx "ge", ops, flags },\
+	[op + 14] = { pfx "le", ops, flags }, [op + 15] = { pfx "g", ops, flags }
+
+#define REG8( op, name, ops, flags ) \
+	[op]     = { name, ops, flags }, [op + 1] = { name, ops, flags }, \
+	[op + 2] = { name, ops, flags }, [op + 3] = { name, ops, flags }, \
+	[op + 4] = { name, ops, flags }, [op + 5] = { name, ops, flags }, \
+	[op + 6] = { name, ops, flags }, [op + 7] = { name, ops, flags }
+
+#define OPS( ... ) { __VA_ARGS__ }
+
+/* one-byte opcodes. Prefixes, string insns, x87 escapes, far and
+ * segment-register insns are left to libopcodes */
+static const x86_native_op_t one_byte[256] = {
+	ALU( 0x00, "add", NF_LOCK ),
+	ALU( 0x08, "or",  NF_LOCK ),
+	ALU( 0x10, "adc", NF_LOCK ),
+	ALU( 0x18, "sbb", NF_LOCK ),
+	ALU( 0x20, "and", NF_LOCK ),
+	ALU( 0x28, "sub", NF_LOCK ),
+	ALU( 0x30, "xor", NF_LOCK ),
+	ALU( 0x38, "cmp", 0 ),
+	REG8( 0x40, "inc", OPS( O_Zv ), NF_I64 ),
+	REG8( 0x48, "dec", OPS( O_Zv ), NF_I64 ),
+	REG8( 0x50, "push", OPS( O_Zv ), NF_D64 | NF_NOSFX ),
+	REG8( 0x58, "pop", OPS( O_Zv ), NF_D64 | NF_NOSFX ),
+	[0x63] = { "movsxd", { O_Gv, O_Ed }, NF_W64 | NF_EXT },
+	[0x68] = { "push", { O_Iz }, NF_D64 | NF_NOSFX },
+	[0x69] = { "imul", { O_Gv, O_Ev, O_Iz } },
+	[0x6A] = { "push", { O_Ibs }, NF_D64 | NF_NOSFX },
+	[0x6B] = { "imul", { O_Gv, O_Ev, O_Ibs } },
+	CC( 0x70, "j", OPS( O_Jb ), NF_F64 ),
+	[0x80] = { "", { O_Eb, O_Ib }, 0, G_1 },
+	[0x81] = { "", { O_Ev, O_Iz }, 0, G_1 },
+	[0x83] = { "", { O_Ev, O_Ibs }, 0, G_1 },
+	[0x84] = { "test", { O_Eb, O_Gb } },
+	[0x85] = { "test", { O_Ev, O_Gv } },
+	[0x86] = { "xchg", { O_Eb, O_Gb }, NF_LOCK },
+	[0x87] = { "xchg", { O_Ev, O_Gv }, NF_LOCK },
+	[0x88] = { "mov", { O_Eb, O_Gb } },
+	[0x89] = { "mov", { O_Ev, O_Gv } },
+	[0x8A] = { "mov", { O_Gb, O_Eb } },
+	[0x8B] = { "mov", { O_Gv, O_Ev } },
+	[0x8D] = { "lea", { O_Gv, O_M } },
+	[0x8F] = { "", { O_NONE }, 0, G_1A },
+	[0x90] = { "nop" },
+	[0x91] = { "xchg", { O_Zv, O_rAX } },
+	[0x92] = { "xchg", { O_Zv, O_rAX } },
+	[0x93] = { "xchg", { O_Zv, O_rAX } },
+	[0x94] = { "xchg", { O_Zv, O_rAX } },
+	[0x95] = { "xchg", { O_Zv, O_rAX } },
+	[0x96] = { "xchg", { O_Zv, O_rAX } },
+	[0x97] = { "xchg", { O_Zv, O_rAX } },
+	[0x98] = { "cwde", { O_NONE }, NF_CONV },
+	[0x99] = { "cdq", { O_NONE }, NF_CONV },
+	[0x9E] = { "sahf" },
+	[0x9F] = { "lahf" },
+	[0xA8] = { "test", { O_AL, O_Ib } },
+	[0xA9] = { "test", { O_rAX, O_Iz } },
+	REG8( 0xB0, "mov", OPS( O_Zb, O_Ib ), 0 ),
+	REG8( 0xB8, "mov", OPS( O_Zv, O_Iv ), NF_ABS ),
+	[0xC0] = { "", { O_Eb, O_Ib }, 0, G_2 },
+	[0xC1] = { "", { O_Ev, O_Ib }, 0, G_2 },
+	[0xC2] = { "ret", { O_Iw }, NF_F64 | NF_NOSFX },
+	[0xC3] = { "ret", { O_NONE }, NF_F64 },
+	[0xC6] = { "", { O_NONE }, 0, G_11b },
+	[0xC7] = { "", { O_NONE }, 0, G_11v },
+	[0xC8] = { "enter", { O_Iw, O_Ib }, NF_F64 | NF_NOSFX },
+	[0xC9] = { "leave", { O_NONE }, NF_F64 },
+	[0xCC] = { "int3" },
+	[0xCD] = { "int", { O_Ib } },
+	[0xD0] = { "", { O_Eb, O_1 }, 0, G_2 },
+	[0xD1] = { "", { O_Ev, O_1 }, 0, G_2 },
+	[0xD2] = { "", { O_Eb, O_CL }, 0, G_2 },
+	[0xD3] = { "", { O_Ev, O_CL }, 0, G_2 },
+	[0xE8] = { "call", { O_Jz }, NF_F64 },
+	[0xE9] = { "jmp", { O_Jz }, NF_F64 },
+	[0xEB] = { "jmp", { O_Jb }, NF_F64 },
+	[0xF4] = { "hlt" },
+	[0xF5] = { "cmc" },
+	[0xF6] = { "", { O_NONE }, 0, G_3b },
+	[0xF7] = { "", { O_NONE }, 0, G_3v },
+	[0xF8] = { "clc" },
+	[0xF9] = { "stc" },
+	[0xFA] = { "cli" },
+	[0xFB] = { "sti" },
+	[0xFC] = { "cld" },
+	[0xFD] = { "std" },
+	[0xFE] = { "", { O_NONE }, 0, G_4 },
+	[0xFF] = { "", { O_NONE }, 0, G_5 }
+};
+
+/* two-byte (0F xx) opcodes */
+static const x86_native_op_t two_byte[256] = {
+	[0x05] = { "syscall" },
+	[0x0B] = { "ud2" },
+	[0x1F] = { "", { O_NONE }, 0, G_NOP },
+	[0x31] = { "rdtsc" },
+	CC( 0x40, "cmov", OPS( O_Gv, O_Ev ), 0 ),
+	CC( 0x80, "j", OPS( O_Jz ), NF_F64 ),
+	CC( 0x90, "set", OPS( O_Eb ), NF_NOSFX ),
+	[0xA2] = { "cpuid" },
+	[0xA3] = { "bt", { O_Ev, O_Gv } },
+	[0xAB] = { "bts", { O_Ev, O_Gv }, NF_LOCK },
+	[0xAF] = { "imul", { O_Gv, O_Ev } },
+	[0xB0] = { "cmpxchg", { O_Eb, O_Gb }, NF_LOCK },
+	[0xB1] = { "cmpxchg", { O_Ev, O_Gv }, NF_LOCK },
+	[0xB3] = { "btr", { O_Ev, O_Gv }, NF_LOCK },
+	[0xB6] = { "movzx", { O_Gv, O_Eb }, NF_EXT },
+	[0xB7] = { "movzx", { O_Gv, O_Ew }, NF_EXT },
+	[0xBA] = { "", { O_NONE }, 0, G_8 },
+	[0xBB] = { "btc", { O_Ev, O_Gv }, NF_LOCK },
+	[0xBE] = { "movsx", { O_Gv, O_Eb }, NF_EXT },
+	[0xBF] = { "movsx", { O_Gv, O_Ew }, NF_EXT },
+	[0xC0] = { "xadd", { O_Eb, O_Gb }, NF_LOCK },
+	[0xC1] = { "xadd", { O_Ev, O_Gv }, NF_LOCK },
+	REG8( 0xC8, "bswap", OPS( O_Zv ), 0 )
+};
+
+/* group members without operands use the operands of the opcode */
+static const x86_native_op_t groups[][8] = {
+	[G_1] = {
+		{ "add", { O_NONE }, NF_LOCK }, { "or", { O_NONE }, NF_LOCK },
+		{ "adc", { O_NONE }, NF_LOCK }, { "sbb", { O_NONE }, NF_LOCK },
+		{ "and", { O_NONE }, NF_LOCK }, { "sub", { O_NONE }, NF_LOCK },
+		{ "xor", { O_NONE }, NF_LOCK }, { "cmp" }
+	},
+	[G_1A] = {
+		{ "pop", { O_Ev }, NF_D64 | NF_NOSFX }
+	},
+	[G_2] = {
+		{ "rol" }, { "ror" }, { "rcl" }, { "rcr" },
+		{ "shl" }, { "shr" }, { NULL }, { "sar" }
+	},
+	[G_3b] = {
+		{ "test", { O_Eb, O_Ib } }, { NULL },
+		{ "not", { O_Eb }, NF_LOCK }, { "neg", { O_Eb }, NF_LOCK },
+		{ "mul", { O_Eb } }, { "imul", { O_Eb } },
+		{ "div", { O_Eb } }, { "idiv", { O_Eb } }
+	},
+	[G_3v] = {
+		{ "test", { O_Ev, O_Iz } }, { NULL },
+		{ "not", { O_Ev }, NF_LOCK }, { "neg", { O_Ev }, NF_LOCK },
+		{ "mul", { O_Ev } }, { "imul", { O_Ev } },
+		{ "div", { O_Ev } }, { "idiv", { O_Ev } }
+	},
+	[G_4] = {
+		{ "inc", { O_Eb }, NF_LOCK }, { "dec", { O_Eb }, NF_LOCK }
+	},
+	[G_5] = {
+		{ "inc", { O_Ev }, NF_LOCK }, { "dec", { O_Ev }, NF_LOCK },
+		{ "call", { O_Ev }, NF_F64 | NF_NOSFX | NF_IND }, { NULL },
+		{ "jmp", { O_Ev }, NF_F64 | NF_NOSFX | NF_IND }, { NULL },
+		{ "push", { O_Ev }, NF_D64 | NF_NOSFX }, { NULL }
+	},
+	[G_8] = {
+		{ NULL }, { NULL }, { NULL }, { NULL },
+		{ "bt", { O_Ev, O_Ib } }, { "bts", { O_Ev, O_Ib }, NF_LOCK },
+		{ "btr", { O_Ev, O_Ib }, NF_LOCK },
+		{ "btc", { O_Ev, O_Ib }, NF_LOCK }
+	},
+	[G_11b] = {
+		{ "mov", { O_Eb, O_Ib } }
+	},
+	[G_11v] = {
+		{ "mov", { O_Ev, O_Iz } }
+	},
+	[G_NOP] = {
+		{ "nop", { O_Ev } }
+	}
+};
+
+/* cbw/cwde/cdqe and cwd/cdq/cqo, by syntax and operand size */
+static const char * conv_mnemonics[2][2][3] = {
+	{ { "cbw", "cwde", "cdqe" }, { "cwd", "cdq", "cqo" } },
+	{ { "cbtw", "cwtl", "cltq" }, { "cwtd", "cltd", "cqto" } }
+};
+
+/* ---------------------------------------------------------------------- */
+/* CPU REGISTERS */
+
+/* indexes into intel_registers */
+#define REG_AL		0
+#define REG_CL		1
+#define REG_AX		8
+#define REG_EAX		16
+#define REG_RAX		24
+#define REG_R8		32
+#define REG_R8B		40
+#define REG_R8W		48
+#define REG_R8D		56
+#define REG_CS		104
+#define REG_EIP		110
+#define REG_RIP		111
+#define REG_SPL		114
+
+/* libopcodes names the low bytes of r8-r15 "r8b", not "r8l" */
+static const char * rex_byte_regs[] = {
+	"r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+};
+
+/* intel_registers index of general purpose register num (0-15) */
+static int gpr_index( unsigned int num, unsigned int size, int rex ) {
+	if ( num >= 8 ) {
+		switch ( size ) {
+			case 1: return REG_R8B + num - 8;
+			case 2: return REG_R8W + num - 8;
+			case 4: return REG_R8D + num - 8;
+			default: return REG_R8 + num - 8;
+		}
+	}
+
+	switch ( size ) {
+		case 1:
+			/* with a REX prefix, 4-7 are spl-dil instead of ah-bh */
+			return ( rex && num >= 4 ) ? REG_SPL + num - 4 :
+						     REG_AL + num;
+		case 2: return REG_AX + num;
+		case 4: return REG_EAX + num;
+		default: return REG_RAX + num;
+	}
+}
+
+static void fill_register( opdis_reg_t * reg, int id ) {
+	reg->id = intel_reg_id[id];
+	reg->flags = lookup_register_type( reg->id );
+	reg->size = intel_reg_size[id];
+	strncpy( reg->ascii, ( id >= REG_R8B && id < REG_R8W ) ?
+		 rex_byte_regs[id - REG_R8B] : intel_registers[id],
+		 OPDIS_REG_NAME_SZ - 1 );
+}
+
+/* ---------------------------------------------------------------------- */
+/* DECODING */
+
+#define REX_B	0x01
+#define REX_X	0x02
+#define REX_R	0x04
+#define REX_W	0x08
+
+enum { K_REG, K_IMM, K_MEM, K_TARGET };
+
+typedef struct {
+	unsigned char kind;
+	unsigned char size;		/* data size in bytes */
+	unsigned char implicit;		/* not shown in AT&T syntax */
+	unsigned char is_signed;
+	int reg;
+	uint64_t value;
+} x86_native_opnd_t;
+
+typedef struct {
+	char mnemonic[16];
+	const char * intel_mnemonic;	/* for the insn category and flags */
+	unsigned int flags;
+	unsigned int size;
+	int lock;
+	int seg;			/* segment override, or -1 */
+	/* memory operand */
+	int base, index, scale;
+	int has_disp;
+	int64_t disp;
+	unsigned int num_ops;
+	x86_native_opnd_t ops[3];
+} x86_native_insn_t;
+
+static int segment_prefix( opdis_byte_t b ) {
+	switch ( b ) {
+		case 0x2E: return REG_CS;
+		case 0x3E: return REG_CS + 1;
+		case 0x36: return REG_CS + 2;
+		case 0x26: return REG_CS + 3;
+		case 0x64: return REG_CS + 4;
+		case 0x65: return REG_CS + 5;
+		default: return -1;
+	}
+}
+
+static int uses_modrm( const x86_native_op_t * def ) {
+	int i;
+
+	if ( def->group ) {
+		return 1;
+	}
+
+	for ( i = 0; i < 3; i++ ) {
+		if ( def->ops[i] >= O_Eb && def->ops[i] <= O_Gv ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* operand specifiers whose size is the operand size */
+static int is_v_operand( unsigned char spec ) {
+	switch ( spec ) {
+		case O_Ev: case O_Gv: case O_Zv: case O_rAX:
+		case O_Ibs: case O_Iz: case O_Iv:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static uint64_t size_mask( unsigned int size ) {
+	return ( size >= 8 ) ? (uint64_t) -1 :
+			       ( (uint64_t) 1 << ( size * 8 ) ) - 1;
+}
+
+/* read a little-endian immediate or displacement */
+static int read_imm( const opdis_byte_t * buf, unsigned int len,
+		     unsigned int * pos, unsigned int size, int sign,
+		     uint64_t * value ) {
+	uint64_t v = 0;
+	unsigned int i;
+
+	if ( *pos + size > len ) {
+		return 0;
+	}
+
+	for ( i = 0; i < size; i++ ) {
+		v |= (uint64_t) buf[*pos + i] << ( i * 8 );
+	}
+	*pos += size;
+
+	if ( sign && size < 8 && ( v >> ( size * 8 - 1 ) ) ) {
+		v |= ~size_mask( size );
+	}
+
+	*value = v;
+	return 1;
+}
+
+static char att_suffix( unsigned int size ) {
+	switch ( size ) {
+		case 1: return 'b';
+		case 2: return 'w';
+		case 4: return 'l';
+		default: return 'q';
+	}
+}
+
+/* decode the insn at the start of buf into n; returns the size or 0 */
+static unsigned int decode_insn( x86_native_insn_t * n,
+				 const opdis_byte_t * buf, unsigned int len,
+				 opdis_vma_t vma, enum opdis_x86_mode_t mode,
+				 enum opdis_x86_syntax_t syntax ) {
+	const x86_native_op_t * def, * member;
+	const unsigned char * ops;
+	unsigned int pos = 0, i, op_size, addr_size, mod = 0, reg = 0, rm = 0;
+	int opsize_pfx = 0, addr_pfx = 0, rex = 0, rex_used = 0, rex_byte = 0;
+	int opsize_used = 0, has_mem = 0, has_sizing_reg = 0, mem_size = 0;
+	unsigned char opcode;
+	uint64_t v;
+
+	/* 16-bit code, and 16-bit addressing, are left to libopcodes */
+	if ( mode == opdis_x86_mode_16 ) {
+		return 0;
+	}
+
+	if ( len > OPDIS_X86_MAX_INSN ) {
+		len = OPDIS_X86_MAX_INSN;
+	}
+
+	memset( n, 0, sizeof(x86_native_insn_t) );
+	n->seg = n->base = n->index = -1;
+
+	/* legacy prefixes; F2 and F3 fall through to the opcode tables */
+	for ( ; pos < len; pos++ ) {
+		opdis_byte_t b = buf[pos];
+		int seg = segment_prefix( b );
+
+		if ( b == 0x66 ) {
+			if ( opsize_pfx ) return 0;
+			opsize_pfx = 1;
+		} else if ( b == 0x67 ) {
+			if ( addr_pfx ) return 0;
+			addr_pfx = 1;
+		} else if ( b == 0xF0 ) {
+			if ( n->lock ) return 0;
+			n->lock = 1;
+		} else if ( seg > -1 ) {
+			/* only FS and GS overrides apply in 64-bit mode */
+			if ( n->seg > -1 || ( mode == opdis_x86_mode_64 &&
+			     seg < REG_CS + 4 ) ) {
+				return 0;
+			}
+			n->seg = seg;
+		} else {
+			break;
+		}
+	}
+
+	if ( pos < len && mode == opdis_x86_mode_64 &&
+	     ( buf[pos] & 0xF0 ) == 0x40 ) {
+		rex = buf[pos++];
+	}
+
+	if ( pos >= len ) {
+		return 0;
+	}
+
+	opcode = buf[pos++];
+	if ( opcode == 0x0F ) {
+		if ( pos >= len ) {
+			return 0;
+		}
+		opcode = buf[pos++];
+		def = &two_byte[opcode];
+	} else {
+		def = &one_byte[opcode];
+	}
+
+	if (! def->mnemonic ) {
+		return 0;
+	}
+
+	if ( uses_modrm( def ) ) {
+		if ( pos >= len ) {
+			return 0;
+		}
+		mod = buf[pos] >> 6;
+		reg = ( buf[pos] >> 3 ) & 7;
+		rm = buf[pos] & 7;
+		pos++;
+	}
+
+	member = def;
+	ops = def->ops;
+	n->flags = def->flags;
+	if ( def->group ) {
+		member = &groups[def->group][reg];
+		if (! member->mnemonic ) {
+			return 0;
+		}
+		n->flags |= member->flags;
+		if ( member->ops[0] ) {
+			ops = member->ops;
+		}
+	}
+
+	if ( ( n->flags & NF_I64 ) && mode == opdis_x86_mode_64 ) {
+		return 0;
+	}
+	if ( ( n->flags & NF_W64 ) && ! ( rex & REX_W ) ) {
+		return 0;
+	}
+
+	/* operand size */
+	op_size = ( rex & REX_W ) ? 8 : ( opsize_pfx ) ? 2 : 4;
+	if ( n->flags & ( NF_D64 | NF_F64 ) ) {
+		/* libopcodes shows a redundant REX.W or 0x66 as a prefix */
+		if ( ( rex & REX_W ) || ( opsize_pfx && (n->flags & NF_F64) ) ){
+			return 0;
+		}
+		if ( mode == opdis_x86_mode_64 ) {
+			op_size = ( opsize_pfx ) ? 2 : 8;
+		}
+		opsize_used = 1;
+	}
+	if ( n->flags & NF_CONV ) {
+		opsize_used = 1;
+		rex_used |= REX_W;
+	}
+	addr_size = ( mode == opdis_x86_mode_64 ) ? ( addr_pfx ? 4 : 8 ) :
+						    ( addr_pfx ? 2 : 4 );
+	if ( addr_size == 2 ) {
+		return 0;
+	}
+
+	/* memory operand */
+	if ( uses_modrm( def ) && mod != 3 ) {
+		unsigned int disp_size = ( mod == 1 ) ? 1 : ( mod == 2 ) ? 4 : 0;
+
+		has_mem = 1;
+		if ( rm == 4 ) {
+			unsigned int sib, idx, base;
+
+			if ( pos >= len ) {
+				return 0;
+			}
+			sib = buf[pos++];
+			idx = ( ( sib >> 3 ) & 7 ) | ( ( rex & REX_X ) ? 8 : 0 );
+			base = ( sib & 7 ) | ( ( rex & REX_B ) ? 8 : 0 );
+			rex_used |= REX_X;
+
+			if ( idx != 4 ) {
+				n->index = gpr_index( idx, addr_size, rex );
+				n->scale = sib >> 6;
+			} else if ( sib >> 6 ) {
+				return 0;
+			}
+
+			if ( ( base & 7 ) == 5 && mod == 0 ) {
+				disp_size = 4;
+			} else {
+				n->base = gpr_index( base, addr_size, rex );
+				rex_used |= REX_B;
+				/* libopcodes shows an unneeded SIB as eiz/riz */
+				if ( n->index < 0 && ( base & 7 ) != 4 ) {
+					return 0;
+				}
+			}
+		} else if ( rm == 5 && mod == 0 ) {
+			disp_size = 4;
+			if ( mode == opdis_x86_mode_64 ) {
+				n->base = ( addr_size == 8 ) ? REG_RIP : REG_EIP;
+			}
+		} else {
+			n->base = gpr_index( rm | ( ( rex & REX_B ) ? 8 : 0 ),
+					     addr_size, rex );
+			rex_used |= REX_B;
+		}
+
+		if ( disp_size ) {
+			if (! read_imm( buf, len, &pos, disp_size, 1, &v ) ) {
+				return 0;
+			}
+			n->has_disp = 1;
+			n->disp = (int64_t) v;
+			if ( n->base < 0 && n->index < 0 && addr_size == 4 ) {
+				/* absolute 32-bit address */
+				n->disp = (int64_t) ( v & 0xFFFFFFFF );
+			}
+		}
+	}
+
+	/* operands */
+	for ( i = 0; i < 3 && ops[i]; i++ ) {
+		x86_native_opnd_t * op = &n->ops[n->num_ops++];
+		unsigned char spec = ops[i];
+
+		if ( is_v_operand( spec ) ) {
+			opsize_used = 1;
+			rex_used |= REX_W;
+		}
+
+		switch ( spec ) {
+			case O_Eb: case O_Ew: case O_Ed: case O_Ev: case O_M:
+				op->size = ( spec == O_Eb ) ? 1 :
+					   ( spec == O_Ew ) ? 2 :
+					   ( spec == O_Ed ) ? 4 :
+					   ( spec == O_Ev ) ? op_size : 0;
+				if ( mod == 3 ) {
+					if ( spec == O_M ) {
+						return 0;
+					}
+					op->kind = K_REG;
+					op->reg = gpr_index( rm | ( ( rex & REX_B ) ?
+							8 : 0 ), op->size, rex );
+					rex_used |= REX_B;
+					rex_byte |= ( op->size == 1 );
+					has_sizing_reg = 1;
+				} else {
+					op->kind = K_MEM;
+					mem_size = op->size;
+				}
+				break;
+			case O_Gb: case O_Gv:
+				op->kind = K_REG;
+				op->size = ( spec == O_Gb ) ? 1 : op_size;
+				op->reg = gpr_index( reg | ( ( rex & REX_R ) ?
+						8 : 0 ), op->size, rex );
+				rex_used |= REX_R;
+				rex_byte |= ( op->size == 1 );
+				has_sizing_reg = 1;
+				break;
+			case O_Zb: case O_Zv:
+				op->kind = K_REG;
+				op->size = ( spec == O_Zb ) ? 1 : op_size;
+				op->reg = gpr_index( ( opcode & 7 ) | ( ( rex &
+						REX_B ) ? 8 : 0 ), op->size, rex );
+				rex_used |= REX_B;
+				rex_byte |= ( op->size == 1 );
+				has_sizing_reg = 1;
+				break;
+			case O_AL: case O_rAX:
+				op->kind = K_REG;
+				op->size = ( spec == O_AL ) ? 1 : op_size;
+				op->reg = gpr_index( 0, op->size, rex );
+				has_sizing_reg = 1;
+				break;
+			case O_CL:
+				op->kind = K_REG;
+				op->size = 1;
+				op->reg = REG_CL;
+				break;
+			case O_1:
+				op->kind = K_IMM;
+				op->size = 1;
+				op->value = 1;
+				op->implicit = 1;
+				break;
+			case O_Ib: case O_Iw:
+				op->kind = K_IMM;
+				op->size = ( spec == O_Ib ) ? 1 : 2;
+				if (! read_imm( buf, len, &pos, op->size, 0,
+						&op->value ) ) {
+					return 0;
+				}
+				break;
+			case O_Ibs: case O_Iz: case O_Iv:
+				op->kind = K_IMM;
+				op->size = op_size;
+				if (! read_imm( buf, len, &pos, ( spec == O_Ibs ) ?
+						1 : ( spec == O_Iv || op_size < 4 ) ?
+						op_size : 4, 1, &op->value ) ) {
+					return 0;
+				}
+				op->is_signed = ( (int64_t) op->value < 0 );
+				op->value &= size_mask( op_size );
+				break;
+			case O_Jb: case O_Jz:
+				op->kind = K_TARGET;
+				op->size = op_size;
+				if (! read_imm( buf, len, &pos, ( spec == O_Jb ) ?
+						1 : 4, 1, &v ) ) {
+					return 0;
+				}
+				/* relative to the end of the insn */
+				op->value = v;
+				break;
+		}
+	}
+
+	/* prefixes which do not apply to the insn are shown by libopcodes */
+	if ( opsize_pfx && ! opsize_used ) {
+		return 0;
+	}
+	if ( ( addr_pfx || n->seg > -1 ) && ! has_mem ) {
+		return 0;
+	}
+	if ( n->lock && ( ! ( n->flags & NF_LOCK ) || ! has_mem ) ) {
+		return 0;
+	}
+	if ( ( rex & ~rex_used & 0x0F ) ||
+	     ( rex && ! ( rex & rex_used & 0x0F ) && ! rex_byte ) ) {
+		return 0;
+	}
+
+	n->size = pos;
+	for ( i = 0; i < n->num_ops; i++ ) {
+		if ( n->ops[i].kind == K_TARGET ) {
+			n->ops[i].value = ( vma + pos + n->ops[i].value ) &
+					  size_mask( op_size );
+		}
+	}
+
+	/* mnemonic */
+	n->intel_mnemonic = member->mnemonic;
+	if ( n->flags & NF_CONV ) {
+		i = ( op_size == 2 ) ? 0 : ( op_size == 4 ) ? 1 : 2;
+		n->intel_mnemonic = conv_mnemonics[0][opcode & 1][i];
+		strcpy( n->mnemonic, conv_mnemonics[syntax ==
+			opdis_x86_syntax_att][opcode & 1][i] );
+	} else if ( ( n->flags & NF_ABS ) && op_size == 8 ) {
+		n->intel_mnemonic = "movabs";
+		strcpy( n->mnemonic, n->intel_mnemonic );
+	} else if ( ( n->flags & NF_EXT ) && syntax == opdis_x86_syntax_att ) {
+		/* movzbl, movswq, movslq, etc */
+		if ( n->ops[1].size >= n->ops[0].size ) {
+			return 0;
+		}
+		strncpy( n->mnemonic, member->mnemonic, 4 );
+		n->mnemonic[4] = att_suffix( n->ops[1].size );
+		n->mnemonic[5] = att_suffix( n->ops[0].size );
+	} else {
+		strcpy( n->mnemonic, member->mnemonic );
+		/* AT&T needs a suffix when no register gives the data size */
+		if ( syntax == opdis_x86_syntax_att && has_mem && mem_size &&
+		     ! has_sizing_reg && ! ( n->flags & NF_NOSFX ) ) {
+			n->mnemonic[strlen(n->mnemonic)] = att_suffix(mem_size);
+		}
+	}
+
+	return n->size;
+}
+
+/* ---------------------------------------------------------------------- */
+/* INSN FILL */
+
+static void classify_mnemonic( opdis_insn_t * out, const char * item ) {
+	const x86_mnemonic_def_t * def = &x86_mnemonic_slots[
+			X86_HASH_SLOT( item, x86_mnemonic_disp,
+				       X86_MNEMONIC_BUCKETS, X86_MNEMONIC_SLOTS )];
+
+	if ( def->name && ! strcmp( def->name, item ) ) {
+		out->category = (enum opdis_insn_cat_t) def->category;
+		out->flags.cflow = (enum opdis_cflow_flag_t) def->flags;
+		out->isa = (enum opdis_insn_subset_t) def->isa;
+		return;
+	}
+
+	x86_mnemonic_rules( out, item );
+}
+
+static void fill_memory( opdis_op_t * op, const x86_native_insn_t * n ) {
+	opdis_addr_expr_t * expr = &op->value.expr;
+	enum opdis_addr_expr_elem_t elements = 0;
+
+	op->flags |= opdis_op_flag_address;
+	if ( n->flags & NF_IND ) {
+		op->flags |= opdis_op_flag_indirect;
+	}
+
+	if ( n->base < 0 && n->index < 0 && n->seg > -1 ) {
+		/* seg:offset */
+		op->category = opdis_op_cat_absolute;
+		fill_register( &op->value.abs.segment, n->seg );
+		op->value.abs.offset = (uint64_t) n->disp;
+		return;
+	}
+
+	op->category = opdis_op_cat_expr;
+	if ( n->base > -1 ) {
+		fill_register( &expr->base, n->base );
+		elements |= opdis_addr_expr_base;
+	}
+	if ( n->index > -1 ) {
+		fill_register( &expr->index, n->index );
+		elements |= opdis_addr_expr_index;
+	}
+
+	if ( n->seg > -1 ) {
+		fill_register( &expr->displacement.a.segment, n->seg );
+		expr->displacement.a.offset = (uint64_t) n->disp;
+		elements |= opdis_addr_expr_disp_abs;
+	} else if ( n->has_disp ) {
+		expr->displacement.u = (uint64_t) n->disp;
+	}
+
+	if ( n->has_disp ) {
+		elements |= opdis_addr_expr_disp;
+		elements |= ( n->disp < 0 && ( elements & (opdis_addr_expr_base |
+			      opdis_addr_expr_index) ) ) ?
+			    opdis_addr_expr_disp_s : opdis_addr_expr_disp_u;
+	}
+
+	expr->scale = 1 << n->scale;
+	expr->shift = opdis_addr_expr_asl;
+	expr->elements = elements;
+}
+
+static void fill_operand( opdis_op_t * op, const x86_native_insn_t * n,
+			  const x86_native_opnd_t * src ) {
+	op->flags = opdis_op_flag_none;
+	op->data_size = src->size;
+
+	switch ( src->kind ) {
+		case K_REG:
+			op->category = opdis_op_cat_register;
+			fill_register( &op->value.reg, src->reg );
+			if ( n->flags & NF_IND ) {
+				op->flags |= opdis_op_flag_indirect;
+			}
+			break;
+		case K_IMM:
+			op->category = opdis_op_cat_immediate;
+			op->value.immediate.u = src->value;
+			if ( src->is_signed ) {
+				op->flags |= opdis_op_flag_signed;
+			}
+			if ( src->implicit ) {
+				/* libopcodes shows the shift count as "1" */
+				opdis_op_set_ascii( op, "1" );
+			}
+			break;
+		case K_TARGET:
+			op->category = opdis_op_cat_immediate;
+			op->value.immediate.vma = src->value;
+			op->flags |= opdis_op_flag_address;
+			break;
+		case K_MEM:
+			fill_memory( op, n );
+			break;
+	}
+}
+
+unsigned int LIBCALL opdis_x86_native_decode( opdis_insn_t * out,
+					      const opdis_byte_t * buf,
+					      opdis_off_t offset,
+					      opdis_off_t len,
+					      opdis_vma_t vma,
+					      enum opdis_x86_mode_t mode,
+					      enum opdis_x86_syntax_t syntax ) {
+	x86_native_insn_t n;
+	unsigned int i, num_ops = 0;
+	int order[3];
+
+	if (! out || ! buf || offset >= len ) {
+		return 0;
+	}
+
+	if (! decode_insn( &n, &buf[offset], len - offset, vma, mode,
+			   syntax ) ) {
+		return 0;
+	}
+
+	if (! opdis_insn_set_bytes( out, &buf[offset], n.size ) ) {
+		return 0;
+	}
+
+	out->size = n.size;
+	out->offset = offset;
+	out->vma = vma;
+
+	if ( n.lock ) {
+		opdis_insn_add_prefix( out, "lock" );
+	}
+	opdis_insn_set_mnemonic( out, n.mnemonic );
+	/* AT&T suffixes are not in the mnemonic table */
+	classify_mnemonic( out, n.intel_mnemonic );
+
+	/* AT&T reverses the operands, except for insns such as enter which
+	 * have two immediate operands; it also omits an implicit count */
+	for ( i = 0; i < n.num_ops; i++ ) {
+		if ( syntax == opdis_x86_syntax_intel ||
+		     ( n.num_ops == 2 && n.ops[0].kind == K_IMM &&
+		       n.ops[1].kind == K_IMM ) ) {
+			order[num_ops++] = i;
+		} else if (! n.ops[n.num_ops - 1 - i].implicit ) {
+			order[num_ops++] = n.num_ops - 1 - i;
+		}
+	}
+
+	for ( i = 0; i < num_ops; i++ ) {
+		opdis_op_t * op = opdis_insn_next_avail_op( out );
+		if ( op ) {
+			fill_operand( op, &n, &n.ops[order[i]] );
+		}
+	}
+
+	/* set operand pointers as the AT&T and Intel decoders do */
+	if ( out->category == opdis_insn_cat_cflow ) {
+		if ( out->num_operands > 0 && out->operands[0] &&
+		     (out->flags.cflow >= opdis_cflow_flag_call &&
+		      out->flags.cflow <= opdis_cflow_flag_jmpcc ) ) {
+			out->target = out->operands[0];
+			out->target->flags |= opdis_op_flag_r | opdis_op_flag_x;
+		}
+	} else if ( out->num_operands > 0 && out->operands[0] ) {
+		if ( syntax == opdis_x86_syntax_intel ) {
+			out->dest = out->operands[0];
+			out->dest->flags |= opdis_op_flag_w;
+			if ( out->num_operands > 1 && out->operands[1] ) {
+				out->src = out->operands[1];
+				out->src->flags |= opdis_op_flag_r;
+			}
+		} else {
+			out->src = out->operands[0];
+			out->src->flags |= opdis_op_flag_r;
+			if ( out->num_operands > 1 && out->operands[1] ) {
+				out->dest = out->operands[1];
+				out->dest->flags |= opdis_op_flag_w;
+			}
+		}
+	}
+
+	out->status |= OPDIS_DECODE_ALL;
+	return n.size;
+}
+
+/* ---------------------------------------------------------------------- */
+/* RENDERING */
+
+static const char * intel_ptr( unsigned int size ) {
+	switch ( size ) {
+		case 1: return "BYTE PTR ";
+		case 2: return "WORD PTR ";
+		case 4: return "DWORD PTR ";
+		case 8: return "QWORD PTR ";
+		default: return "";
+	}
+}
+
+static int64_t expr_disp( const opdis_addr_expr_t * expr ) {
+	return ( expr->elements & opdis_addr_expr_disp_abs ) ?
+		(int64_t) expr->displacement.a.offset :
+		(int64_t) expr->displacement.u;
+}
+
+static int is_rip( const opdis_reg_t * reg ) {
+	return ! strcmp( reg->ascii, "rip" ) || ! strcmp( reg->ascii, "eip" );
+}
+
+/* format: segment:[base + index * scale + disp] */
+static void render_intel_expr( char * buf, size_t len, const opdis_op_t * op ){
+	const opdis_addr_expr_t * expr = &op->value.expr;
+	int64_t disp = expr_disp( expr );
+	size_t pos;
+
+	pos = snprintf( buf, len, "%s", intel_ptr( op->data_size ) );
+	if ( expr->elements & opdis_addr_expr_disp_abs ) {
+		pos += snprintf( buf + pos, len - pos, "%s:",
+				 expr->displacement.a.segment.ascii );
+	}
+
+	if (! ( expr->elements & ( opdis_addr_expr_base |
+				   opdis_addr_expr_index ) ) ) {
+		snprintf( buf + pos, len - pos, "%s0x%llx",
+			  ( expr->elements & opdis_addr_expr_disp_abs ) ? "" :
+			  "ds:", (unsigned long long) disp );
+		return;
+	}
+
+	pos += snprintf( buf + pos, len - pos, "[" );
+	if ( expr->elements & opdis_addr_expr_base ) {
+		pos += snprintf( buf + pos, len - pos, "%s",
+				 expr->base.ascii );
+	}
+	if ( expr->elements & opdis_addr_expr_index ) {
+		pos += snprintf( buf + pos, len - pos, "%s%s*%d",
+				 ( expr->elements & opdis_addr_expr_base ) ?
+				 "+" : "", expr->index.ascii, expr->scale );
+	}
+	if ( ( expr->elements & opdis_addr_expr_disp ) &&
+	     ( expr->elements & opdis_addr_expr_base ) &&
+	     is_rip( &expr->base ) ) {
+		/* libopcodes shows a RIP-relative disp as unsigned */
+		pos += snprintf( buf + pos, len - pos, "+0x%llx",
+				 (unsigned long long) disp );
+	} else if ( expr->elements & opdis_addr_expr_disp ) {
+		pos += snprintf( buf + pos, len - pos, "%c0x%llx",
+				 ( disp < 0 ) ? '-' : '+',
+				 (unsigned long long) (( disp < 0 ) ? -disp :
+						       disp) );
+	}
+	snprintf( buf + pos, len - pos, "]" );
+}
+
+/* format: %segment:disp(%base,%index,scale) */
+static void render_att_expr( char * buf, size_t len, const opdis_op_t * op ) {
+	const opdis_addr_expr_t * expr = &op->value.expr;
+	int64_t disp = expr_disp( expr );
+	int has_regs = expr->elements & ( opdis_addr_expr_base |
+					  opdis_addr_expr_index );
+	size_t pos;
+
+	pos = snprintf( buf, len, "%s", ( op->flags & opdis_op_flag_indirect ) ?
+			"*" : "" );
+	if ( expr->elements & opdis_addr_expr_disp_abs ) {
+		pos += snprintf( buf + pos, len - pos, "%%%s:",
+				 expr->displacement.a.segment.ascii );
+	}
+
+	if ( expr->elements & opdis_addr_expr_disp ) {
+		pos += snprintf( buf + pos, len - pos, "%s0x%llx",
+				 ( has_regs && disp < 0 ) ? "-" : "",
+				 (unsigned long long) (( has_regs && disp < 0 )?
+						       -disp : disp) );
+	}
+
+	if (! has_regs ) {
+		return;
+	}
+
+	pos += snprintf( buf + pos, len - pos, "(" );
+	if ( expr->elements & opdis_addr_expr_base ) {
+		pos += snprintf( buf + pos, len - pos, "%%%s",
+				 expr->base.ascii );
+	}
+	if ( expr->elements & opdis_addr_expr_index ) {
+		pos += snprintf( buf + pos, len - pos, ",%%%s,%d",
+				 expr->index.ascii, expr->scale );
+	}
+	snprintf( buf + pos, len - pos, ")" );
+}
+
+static void render_operand( char * buf, size_t len, const opdis_op_t * op,
+			    const opdis_insn_t * insn, int att ) {
+	const char * ind = ( att && ( op->flags & opdis_op_flag_indirect ) ) ?
+			   "*" : "";
+
+	switch ( op->category ) {
+		case opdis_op_cat_register:
+			snprintf( buf, len, "%s%s%s", ind, ( att ) ? "%" : "",
+				  op->value.reg.ascii );
+			break;
+		case opdis_op_cat_immediate:
+			if ( op == insn->target ) {
+				snprintf( buf, len, "0x%08llx",
+				  (unsigned long long) op->value.immediate.vma );
+			} else {
+				snprintf( buf, len, "%s0x%llx", ( att ) ? "$" :
+					  "", (unsigned long long)
+					  ( op->value.immediate.u &
+					    size_mask( op->data_size ) ) );
+			}
+			break;
+		case opdis_op_cat_absolute:
+			snprintf( buf, len, "%s%s%s:0x%llx", ( att ) ? ind :
+				  intel_ptr( op->data_size ), ( att ) ? "%" :
+				  "", op->value.abs.segment.ascii,
+				  (unsigned long long) op->value.abs.offset );
+			break;
+		case opdis_op_cat_expr:
+			if ( att ) {
+				render_att_expr( buf, len, op );
+			} else {
+				render_intel_expr( buf, len, op );
+			}
+			break;
+		default:
+			buf[0] = '\0';
+	}
+}
+
+void LIBCALL opdis_x86_native_render( opdis_insn_t * insn,
+				      enum opdis_x86_syntax_t syntax ) {
+	int att = ( syntax == opdis_x86_syntax_att );
+	char buf[256], op_buf[96], mnem[64], cmt[32];
+	unsigned int i;
+	size_t pos;
+
+	if (! insn || ! insn->mnemonic ) {
+		return;
+	}
+
+	snprintf( mnem, sizeof(mnem), "%s%s%s",
+		  ( insn->prefixes && insn->prefixes[0] ) ? insn->prefixes : "",
+		  ( insn->prefixes && insn->prefixes[0] ) ? " " : "",
+		  insn->mnemonic );
+
+	if (! insn->num_operands ) {
+		opdis_insn_set_ascii( insn, mnem );
+		return;
+	}
+
+	/* libopcodes pads the mnemonic to 6 columns */
+	pos = snprintf( buf, sizeof(buf), "%-6s ", mnem );
+	cmt[0] = '\0';
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		opdis_op_t * op = insn->operands[i];
+		const char * op_ascii;
+		if (! op ) {
+			continue;
+		}
+
+		/* the insn ascii is not truncated to the operand field */
+		op_ascii = op->ascii;
+		if (! op->ascii || ! op->ascii[0] ) {
+			render_operand( op_buf, sizeof(op_buf), op, insn, att );
+			opdis_op_set_ascii( op, op_buf );
+			op_ascii = op_buf;
+		}
+
+		if ( op->category == opdis_op_cat_expr &&
+		     ( op->value.expr.elements & opdis_addr_expr_base ) &&
+		     is_rip( &op->value.expr.base ) ) {
+			/* RIP-relative operands are relative to the next insn */
+			snprintf( cmt, sizeof(cmt), "0x%08llx",
+				  (unsigned long long) ( insn->vma + insn->size +
+				  expr_disp( &op->value.expr ) ) );
+		}
+
+		if ( pos < sizeof(buf) ) {
+			pos += snprintf( buf + pos, sizeof(buf) - pos, "%s%s",
+					 ( i ) ? "," : "", op_ascii );
+		}
+	}
+
+	if ( cmt[0] ) {
+		if ( pos < sizeof(buf) ) {
+			snprintf( buf + pos, sizeof(buf) - pos, "        # %s",
+				  cmt );
+		}
+		opdis_insn_add_comment( insn, cmt );
+	}
+
+	opdis_insn_set_ascii( insn, buf );
+}
+
+/* ---------------------------------------------------------------------- */
+/* DECODER */
+
+enum opdis_x86_mode_t LIBCALL opdis_x86_mach_mode( unsigned long mach ) {
+	if ( mach == bfd_mach_i386_i8086 ) {
+		return opdis_x86_mode_16;
+	}
+	if ( mach == bfd_mach_x86_64 || mach == bfd_mach_x86_64_intel_syntax
+#ifdef bfd_mach_x64_32
+	     || mach == bfd_mach_x64_32
+#endif
+#ifdef bfd_mach_x64_32_intel_syntax
+	     || mach == bfd_mach_x64_32_intel_syntax
+#endif
+	   ) {
+		return opdis_x86_mode_64;
+	}
+	return opdis_x86_mode_32;
+}
+
+int opdis_x86_native_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
+			      const opdis_byte_t * buf, opdis_off_t offset,
+			      opdis_vma_t vma, opdis_off_t length, void * arg ) {
+	/* Supported encodings never reach libopcodes: they have already been
+	 * decoded natively, in the mode of the disassembling context. This
+	 * is only called for those which the native decoder rejected, and
+	 * libopcodes is the reference for them. */
+	if ( opdis_get_x86_syntax( (opdis_t) arg ) == opdis_x86_syntax_intel ) {
+		return opdis_x86_intel_decoder( in, out, buf, offset, vma,
+						length, arg );
+	}
+	return opdis_x86_att_decoder( in, out, buf, offset, vma, length, arg );
+}
@@ -0,0 +1,105 @@
+/*!
+ * \file x86_native.h
+ * \brief Native table-driven decoder for x86 and x86-64 instructions
+ * \details This decodes the prefixes, opcode, ModR/M, SIB, displacement and
+ *          immediates of an instruction directly into an opdis_insn_t,
+ *          without running libopcodes or parsing its output. The ascii of
+ *          the instruction and its operands is rendered from the decoded
+ *          fields only when it is needed.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_X86_NATIVE_H
+#define OPDIS_X86_NATIVE_H
+
+#include <opdis/opdis.h>
+#include <opdis/x86_length.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * \fn int opdis_x86_native_decoder( const opdis_insn_buf_t, opdis_insn_t *,
+				     const opdis_byte_t *, opdis_off_t,
+				     opdis_vma_t, opdis_off_t, void * )
+ * \ingroup x86
+ * \brief The built-in native x86 instruction decoder.
+ * \details When this is the decoder of an opdis_t, instructions are decoded
+ *          by opdis_x86_native_decode instead of libopcodes, and their
+ *          ascii is rendered by opdis_x86_native_render before they are
+ *          passed to the display or batch callback. Encodings which the
+ *          native decoder does not support (e.g. x87, SSE, VEX and string
+ *          instructions, and 16-bit code) are disassembled by libopcodes
+ *          and passed to this callback, which hands them to the AT&T or
+ *          Intel decoder for the syntax of the opdis_t. They are not
+ *          decoded natively again.
+ * \note The \e arg parameter is expected to be an opdis_t.
+ * \note opdis_set_x86_syntax keeps this decoder if it is selected.
+ */
+int opdis_x86_native_decoder( const opdis_insn_buf_t in, opdis_insn_t * out,
+			      const opdis_byte_t * buf, opdis_off_t offset,
+			      opdis_vma_t vma, opdis_off_t length, void * arg );
+
+/*!
+ * \fn unsigned int opdis_x86_native_decode( opdis_insn_t *,
+ * 					     const opdis_byte_t *, opdis_off_t,
+ * 					     opdis_off_t, opdis_vma_t,
+ * 					     enum opdis_x86_mode_t,
+ * 					     enum opdis_x86_syntax_t )
+ * \ingroup x86
+ * \brief Decode the x86 instruction at an offset in a buffer.
+ * \param out The instruction to fill.
+ * \param buf The buffer containing the instruction.
+ * \param offset Offset of the instruction in \e buf.
+ * \param len The number of bytes in \e buf.
+ * \param vma Address (VMA) of the instruction.
+ * \param mode The processor mode of the code.
+ * \param syntax The syntax which determines the mnemonic and the order of
+ *               the operands, as with the AT&T and Intel decoders.
+ * \return The size of the instruction, or 0 if the instruction is not
+ *         supported by the native decoder.
+ * \details Every field but \e ascii, the operand \e ascii fields and the
+ *          \e comment is filled, and \e status is OPDIS_DECODE_ALL. If 0
+ *          is returned, \e out is not modified.
+ * \note Only 32- and 64-bit code is supported.
+ */
+unsigned int LIBCALL opdis_x86_native_decode( opdis_insn_t * out,
+					      const opdis_byte_t * buf,
+					      opdis_off_t offset,
+					      opdis_off_t len,
+					      opdis_vma_t vma,
+					      enum opdis_x86_mode_t mode,
+					      enum opdis_x86_syntax_t syntax );
+
+/*!
+ * \fn void opdis_x86_native_render( opdis_insn_t *, enum opdis_x86_syntax_t )
+ * \ingroup x86
+ * \brief Fill the ascii of an instruction decoded by opdis_x86_native_decode.
+ * \param insn The instruction.
+ * \param syntax The syntax \e insn was decoded for.
+ * \details This sets the \e ascii field of \e insn, and of each operand
+ *          whose \e ascii is empty, in the format used by libopcodes. The
+ *          target of a RIP-relative operand is added to \e comment.
+ */
+void LIBCALL opdis_x86_native_render( opdis_insn_t * insn,
+				      enum opdis_x86_syntax_t syntax );
+
+/*!
+ * \fn enum opdis_x86_mode_t opdis_x86_mach_mode( unsigned long )
+ * \ingroup x86
+ * \brief Return the processor mode of a BFD x86 machine.
+ * \param mach A bfd_mach_i386 or bfd_mach_x86_64 value.
+ * \return The mode of code for \e mach.
+ */
+enum opdis_x86_mode_t LIBCALL opdis_x86_mach_mode( unsigned long mach );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
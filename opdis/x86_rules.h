@@ -0,0 +1,381 @@
+/*!
+ * \file x86_rules.h
+ * \brief Classification rules and register data for the x86 decoder.
+ * \details This is shared by the x86 decoder and by gen_x86_tables, which
+ *          applies the mnemonic rules to every known mnemonic at build time
+ *          and generates perfect-hash tables (x86_tables.h) for mnemonics,
+ *          registers and prefixes. The decoder only applies the rules
+ *          directly to mnemonics which are not in the tables.
+ * \note This is an internal header; it is not installed.
+ * \author TG Community Developers <community@thoughtgang.org>
+ * \note Copyright (c) 2010 ThoughtGang.
+ * Released under the GNU Lesser Public License (LGPL), version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_X86_RULES_H
+#define OPDIS_X86_RULES_H
+
+#include <string.h>
+
+#include <opdis/model.h>
+
+/* ---------------------------------------------------------------------- */
+/* PERFECT HASH */
+
+/* A table of N keys is stored in slots by hash-and-displace: the bucket of
+ * a key is x86_hash(key, 0) % buckets, and its slot is 
+ * x86_hash(key, disp[bucket]) % slots. gen_x86_tables chooses the
+ * displacements so that no two keys share a slot. */
+
+/* FNV-1a, with the seed perturbing the offset basis */
+static inline unsigned int x86_hash( const char * str, unsigned int seed ) {
+	unsigned int h = 2166136261U ^ ( seed * 16777619U );
+	for ( ; *str; str++ ) {
+		h = ( h ^ (unsigned char) *str ) * 16777619U;
+	}
+	return h;
+}
+
+#define X86_HASH_SLOT( str, disp, buckets, slots ) \
+	( x86_hash( (str), (disp)[x86_hash( (str), 0 ) % (buckets)] ) % (slots) )
+
+/*! \struct x86_mnemonic_def_t
+ *  \ingroup x86
+ *  \brief Classification of a mnemonic, as determined by x86_mnemonic_rules.
+ */
+typedef struct {
+	const char * name;		/*!< Mnemonic, or NULL for empty slot */
+	unsigned char category;		/*!< enum opdis_insn_cat_t */
+	unsigned short flags;		/*!< Category-specific flags */
+	unsigned char isa;		/*!< enum opdis_insn_subset_t */
+} x86_mnemonic_def_t;
+
+/* ---------------------------------------------------------------------- */
+/* MNEMONICS */
+
+static void set_isa( opdis_insn_t * out, const char * item ) {
+
+	/* check for obvious subsets */
+	if ( item[0] == 'f' ) {
+		out->isa = opdis_insn_subset_fpu;
+		return;
+	}
+
+	if ( strstr( item, "pd" ) || strstr( item, "ps" ) ||
+	     strstr( item, "ss" ) || strstr( item, "sd" ) ) {
+		out->isa = opdis_insn_subset_simd;
+		return;
+	}
+
+	if ( item[0] == 'p' && strncmp( "pause", item, 5 ) &&
+	     strncmp( "pop", item, 3 ) && strncmp( "push", item, 4 ) &&
+	     strncmp( "prefetch", item, 8 ) ) {
+		out->isa = opdis_insn_subset_simd;
+		return;
+	}
+
+	out->isa = opdis_insn_subset_gen;
+}
+
+static void x86_mnemonic_rules( opdis_insn_t * out, const char * item ) {
+	set_isa( out, item );
+
+	/* detect NOP */
+	if (! strcmp( "nop", item ) || ! strcmp( "fnop", item ) ) {
+		out->category = opdis_insn_cat_nop;
+		return;
+	}
+
+	/* detect JMP */
+	if (! strncmp( "jmp", item, 3 ) || ! strncmp( "ljmp", item, 4) ) {
+		out->category = opdis_insn_cat_cflow;
+		out->flags.cflow = opdis_cflow_flag_jmp;
+		return;
+	}
+
+	/* detect RET */
+	if (! strncmp( "ret", item, 3 ) || ! strncmp( "lret", item, 4) ||
+	    ! strncmp( "iret", item, 4 ) || ! strcmp( "sysexit", item ) ||
+	    ! strcmp( "sysret", item ) ) {
+		out->category = opdis_insn_cat_cflow;
+		out->flags.cflow = opdis_cflow_flag_ret;
+		return;
+	}
+
+	/* detect branch (call/jcc) */
+	if (! strncmp( "call", item, 4 ) || ! strncmp( "lcall", item, 5) ||
+	    ! strcmp( "syscall", item ) || ! strcmp("sysenter", item ) ) {
+		out->category = opdis_insn_cat_cflow;
+		out->flags.cflow = opdis_cflow_flag_call;
+		return;
+	}
+	if ( item[0] == 'j' || ! strncmp( "loop", item, 4) ) {
+		/* all mnemonics starting with J are either JMP or Jcc */
+		out->category = opdis_insn_cat_cflow;
+		out->flags.cflow = opdis_cflow_flag_jmpcc;
+		return;
+	}
+
+	/* stack instructions */
+	if (! strncmp( "pop", item, 3 ) && strcmp( "popcnt", item ) ) {
+		out->category = opdis_insn_cat_stack;
+		out->flags.stack = opdis_stack_flag_pop;
+		return;
+	}
+	if (! strncmp( "push", item, 4 ) ) {
+		out->category = opdis_insn_cat_stack;
+		out->flags.stack = opdis_stack_flag_push;
+		return;
+	}
+	if (! strncmp( "enter", item, 5 ) ) {
+		out->category = opdis_insn_cat_stack;
+		out->flags.stack = opdis_stack_flag_frame;
+		return;
+	}
+	if (! strncmp( "leave", item, 5 ) ) {
+		out->category = opdis_insn_cat_stack;
+		out->flags.stack = opdis_stack_flag_unframe;
+		return;
+	}
+
+	/* load/store instructions */
+	if ( strstr( item, "mov" ) || strstr( item, "xch" ) ||
+	    ! strncmp( "lod", item, 3 ) || ! strncmp( "sto", item, 3 ) || 
+	    ! strncmp( "fild", item, 4 ) || ! strncmp( "fist", item, 4 ) ||
+	    ! strncmp( "fld", item, 3 ) || ! strncmp( "fst", item, 3 ) ||
+	    ! strncmp( "ld", item, 2 ) || ! strncmp( "la", item, 2 ) ||
+	    ! strncmp( "ll", item, 2 ) || ! strncmp( "lf", item, 2 ) ||
+	    ! strncmp( "lg", item, 2 ) || ! strncmp( "lm", item, 2 ) ||
+	    ! strncmp( "mask", item, 4 ) || ! strncmp( "rd", item, 2 ) ||
+	    ! strncmp( "sahf", item, 4 ) || ! strncmp( "sg", item, 2 ) ||
+	    ! strncmp( "si", item, 2 ) || ! strncmp( "sl", item, 2 ) ||
+	    ! strncmp( "sm", item, 2 ) || ! strncmp( "stm", item, 3 ) ||
+	    ! strncmp( "str", item, 3 ) || ! strncmp( "swap", item, 4 ) ||
+	    ! strncmp( "wrm", item, 3 ) || ! strncmp( "xget", item, 4 ) ||
+	    ! strncmp( "xset", item, 4 ) || ! strncmp( "xsave", item, 5 ) ||
+	    ! strncmp( "xrstor", item, 6 ) ) {
+		out->category = opdis_insn_cat_lost;
+		return;
+	}
+
+	/* bitwise instructions */
+	if (! strncmp( "and", item, 3 ) || ! strncmp( "pand", item, 4 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_and;
+		return;
+	}
+	if (! strncmp( "or", item, 2 ) || ! strncmp( "por", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_or;
+		return;
+	}
+	if (! strncmp( "xor", item, 3 ) || ! strncmp( "pxor", item, 4 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_xor;
+		return;
+	}
+	if (! strncmp( "neg", item, 3 ) || ! strncmp( "not", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_not;
+		return;
+	}
+	if (! strncmp( "sal", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_asl;
+		return;
+	}
+	if (! strncmp( "sar", item, 3 ) || ! strncmp( "psra", item, 4 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_asr;
+		return;
+	}
+	if (! strncmp( "shl", item, 3 ) || ! strncmp( "psll", item, 4 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_lsl;
+		return;
+	}
+	if (! strncmp( "shr", item, 3 ) || ! strncmp( "psrl", item, 4 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_lsr;
+		return;
+	}
+	if (! strncmp( "rcl", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_rcl;
+		return;
+	}
+	if (! strncmp( "rcr", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_rcr;
+		return;
+	}
+	if (! strncmp( "rol", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_rol;
+		return;
+	}
+	if (! strncmp( "ror", item, 3 ) ) {
+		out->category = opdis_insn_cat_bit;
+		out->flags.bit = opdis_bit_flag_ror;
+		return;
+	}
+
+	/* trap */
+	if (! strncmp( "int", item, 3 ) || ! strcmp( "cli", item ) ||
+	    ! strcmp( "sti", item ) || ! strcmp( "ud2", item ) ) {
+		out->category = opdis_insn_cat_trap;
+		return;
+	}
+
+	/* test */
+	if ( strstr( item, "cmp" ) || strstr( item, "test" ) ||
+	     strstr( item, "com" ) || strstr( item, "min" ) ||
+	     strstr( item, "max" ) || ! strncmp( "mps", item, 3 ) ||
+	    ! strncmp( "bt", item , 2 ) || ! strncmp( "ftst", item, 4 ) ) {
+		out->category = opdis_insn_cat_test;
+		return;
+	}
+
+	/* math */
+	if ( strstr( item, "add" ) || strstr( item, "sub" ) ||
+	     strstr( item, "div" ) || strstr( item, "mul" ) ||
+	     strstr( item, "cos" ) || strstr( item, "sin" ) ||
+	     strstr( item, "sqrt" ) || strstr( item, "abs" ) ||
+	     strstr( item, "avg" ) || ! strncmp( "rou", item, 3 ) ||
+	    ! strncmp( "inc", item, 3 ) || ! strncmp( "dec", item, 3 ) ||
+	    ! strncmp( "adc", item, 3 ) || ! strncmp( "fp", item, 2 ) ||
+	    ! strncmp( "fy", item, 2 ) || ! strncmp( "f2", item, 2 ) ||
+	    ! strncmp( "dp", item, 2 ) || ! strncmp( "rcp", item, 2 ) ||
+	    ! strncmp( "lea", item, 3 ) || ! strncmp( "fscale", item, 6 ) ||
+	    ! strncmp( "psad", item, 4 ) ) {
+		out->category = opdis_insn_cat_math;
+		return;
+	}
+
+	/* system instructions */
+	if (! strncmp( "inv", item, 3 ) || ! strncmp( "halt", item, 4 ) ||
+	    ! strncmp( "hlt", item, 3 ) ||
+	    ! strncmp( "clts", item, 4 ) || ! strncmp( "ltr", item, 3 ) ||
+	    ! strncmp( "rsm", item, 3 ) || ! strncmp( "wbinvd", item, 6 ) ) {
+		out->category = opdis_insn_cat_priv;
+		return;
+	}
+
+	/* i/o instructions */
+	if (! strncmp( "in", item, 2 ) ) {
+		out->category = opdis_insn_cat_io;
+		out->flags.io = opdis_io_flag_in;
+		return;
+	}
+	if (! strncmp( "out", item, 3 ) ) {
+		out->category = opdis_insn_cat_io;
+		out->flags.io = opdis_io_flag_out;
+		return;
+	}
+}
+
+/* ---------------------------------------------------------------------- */
+/* PREFIXES */
+
+/* initializer of intel_prefixes, which is defined by the decoder and by
+ * gen_x86_tables: the x86_tables.h prefix slots index into it */
+#define X86_PREFIX_NAMES \
+	"lock", "addr16", "addr32", "rep", "repe", "repz", "repne", "repnz", \
+	"cs", "ss", "ds", "es", "fs", "gs", "pt", "pn"
+
+/* ---------------------------------------------------------------------- */
+/* CPU REGISTERS */
+
+static char intel_reg_id[] = {
+	1, 2, 3, 4, 1, 2, 3, 4, 	// al, cl, dl, bl, ah, ch, dh, bh
+	1, 2, 3, 4, 5, 6, 7, 8, 	// ax, cx, dx, bx, sp, bp, si, di
+	1, 2, 3, 4, 5, 6, 7, 8, 	// eax,ecx,edx,ebx,esp,ebp,esi,edi
+	1, 2, 3, 4, 5, 6, 7, 8, 	// rax,rcx,rdx,rbx,rsp,rbp,rsi,rdi
+	9, 10, 11, 12, 13, 14, 15, 16, 	// r8 - r15
+	9, 10, 11, 12, 13, 14, 15, 16, 	// r8l - r15l
+	9, 10, 11, 12, 13, 14, 15, 16, 	// r8w - r15w
+	9, 10, 11, 12, 13, 14, 15, 16, 	// r8d - r15d
+	17, 18, 19, 20, 21, 22, 23, 24, // mm0 - mm7
+	25, 26, 27, 28, 29, 30, 31, 32,	// xmm0 - xmm7
+	17, 18, 19, 20, 21, 22, 23, 24, // st(0) - st(7)
+	33, 34, 35, 36, 37, 38, 39, 40, // cr0 - cr7
+	41, 42, 43, 44, 45, 46, 47, 48, // dr0 - dr7
+	49, 50, 51, 52, 53, 54, 	// cs, ds, ss, es, fs, gs 
+	55, 55, 56, 56, 		// eip, rip, eflags, rflags
+	5, 6, 7, 8, 			// spl, bpl, sil, dil
+	57, 58, 59, 60, 61 		// gdtr, ldtr, idtr, tr, mxcsr
+};
+
+static char intel_reg_size[] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 	// al, cl, dl, bl, ah, ch, dh, bh
+	2, 2, 2, 2, 2, 2, 2, 2, 	// ax, cx, dx, bx, sp, bp, si, di
+	4, 4, 4, 4, 4, 4, 4, 4, 	// eax,ecx,edx,ebx,esp,ebp,esi,edi
+	8, 8, 8, 8, 8, 8, 8, 8, 	// rax,rcx,rdx,rbx,rsp,rbp,rsi,rdi
+	8, 8, 8, 8, 8, 8, 8, 8, 	// r8 - r15
+	1, 1, 1, 1, 1, 1, 1, 1, 	// r8l - r15l
+	2, 2, 2, 2, 2, 2, 2, 2, 	// r8w - r15w
+	4, 4, 4, 4, 4, 4, 4, 4, 	// r8d - r15d
+	8, 8, 8, 8, 8, 8, 8, 8, 	// mm0 - mm7
+	16, 16, 16, 16, 16, 16, 16, 16,	// xmm0 - xmm7
+	10, 10, 10, 10, 10, 10, 10, 10,	// st(0) - st(7)
+	4, 4, 4, 4, 4, 4, 4, 4, 	// cr0 - cr7
+	4, 4, 4, 4, 4, 4, 4, 4, 	// dr0 - dr7
+	2, 2, 2, 2, 2, 2, 		// cs, ds, ss, es, fs, gs 
+	4, 8, 4, 8, 			// eip, rip, eflags, rflags
+	1, 1, 1, 1, 			// spl, bpl, sil, dil
+	6, 6, 6, 6, 4 			// gdtr, ldtr, idtr, tr, mxcsr
+};
+
+static const char * intel_registers[] = {
+	"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh",
+	"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+	"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+	"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+	"r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+	"r8l", "r9l", "r10l", "r11l", "r12l", "r13l", "r14l", "r15l",
+	"r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w",
+	"r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+	"mm0", "mm1", "mm2", "mm3", "mm4", "mm5", "mm6", "mm7",
+	"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+	"st(0)", "st(1)", "st(2)", "st(3)", "st(4)", "st(5)", "st(6)", "st(7)",
+	"cr0", "cr1", "cr2", "cr3", "cr4", "cr5", "cr6", "cr7",
+	"dr0", "dr1", "dr2", "dr3", "dr4", "dr5", "dr6", "dr7",
+	"cs", "ds", "ss", "es", "fs", "gs", 
+	"eip", "rip", "eflags", "rflags",
+	"spl", "bpl", "sil", "dil", 
+	"gdtr", "ldtr", "idtr", "tr", "mxcsr"
+};
+
+/* register type of an intel_reg_id */
+static inline enum opdis_reg_flag_t lookup_register_type( unsigned int id ) {
+	enum opdis_reg_flag_t type = opdis_reg_flag_unknown;
+
+	if ( id == 5 ) {
+		type = opdis_reg_flag_gen | opdis_reg_flag_stack;
+	} else if ( id == 6 ) {
+		type = opdis_reg_flag_gen | opdis_reg_flag_frame;
+	} else if ( id <= 16 ) {
+		type = opdis_reg_flag_gen;
+	} else if ( id >= 17 && id <= 24 ) {
+		type = opdis_reg_flag_fpu | opdis_reg_flag_simd;
+	} else if (( id >= 25 && id <= 32 ) || id == 61 ) {
+		type = opdis_reg_flag_simd;
+	} else if ( id >= 33 && id <= 40 ) {
+		type = opdis_reg_flag_task;
+	} else if ( id >= 41 && id <= 48 ) {
+		type = opdis_reg_flag_debug;
+	} else if ( id >= 49 && id <= 54 ) {
+		type = opdis_reg_flag_gen | opdis_reg_flag_seg;
+	} else if ( id == 55 ) {
+		type = opdis_reg_flag_pc;
+	} else if ( id == 56 ) {
+		type = opdis_reg_flag_flags;
+	} else if ( id >= 57 && id <= 60 ) {
+		type = opdis_reg_flag_mem;
+	}
+
+	return type;
+}
+
+#endif
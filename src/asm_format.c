@@ -5,17 +5,135 @@
  * See http://www.gnu.org/licenses/gpl.txt for details.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
+#include <opdis/insn_cols.h>
+
 #include "asm_format.h"
+#include "text_fmt.h"
+
+/* ---------------------------------------------------------------------- */
+/* OUTPUT BUFFER */
+
+/* Each insn is formatted into a buffer, which is written with one fwrite.
+ * The builtin formats start with a buffer on the stack; it moves to the
+ * heap if an insn does not fit. */
+
+#define OUT_STACK_SIZE 2048
+
+typedef struct {
+	char * buf;
+	size_t len;
+	size_t max;
+	int heap;		/* buf is allocated by out_reserve */
+} out_buf_t;
+
+/* make room for len more bytes in the output buffer */
+static int out_reserve( out_buf_t * o, size_t len ) {
+	char * buf;
+	size_t max;
+
+	if ( o->len + len <= o->max ) {
+		return 1;
+	}
+
+	max = o->max ? o->max : 256;
+	while ( max < o->len + len ) {
+		max *= 2;
+	}
+
+	if ( o->heap ) {
+		buf = (char *) realloc( o->buf, max );
+	} else {
+		buf = (char *) malloc( max );
+		if ( buf && o->len ) {
+			memcpy( buf, o->buf, o->len );
+		}
+	}
+	if (! buf ) {
+		return 0;
+	}
+
+	o->buf = buf;
+	o->max = max;
+	o->heap = 1;
+	return 1;
+}
+
+static void out_mem( out_buf_t * o, const char * s, size_t len ) {
+	if ( out_reserve( o, len ) ) {
+		memcpy( o->buf + o->len, s, len );
+		o->len += len;
+	}
+}
 
-#define FPRINTF_ADDR( rv, f, vma ) 				\
-	if ( vma == 0 ) {					\
-		rv += fprintf( f, "0x0" );			\
-	} else {						\
-		rv += fprintf( f, "%p", (void *) vma );		\
+/* NULL is printed as printf prints it */
+static void out_str( out_buf_t * o, const char * s ) {
+	if (! s ) {
+		s = "(null)";
 	}
+	out_mem( o, s, strlen(s) );
+}
+
+static void out_char( out_buf_t * o, char c ) {
+	if ( out_reserve( o, 1 ) ) {
+		o->buf[o->len++] = c;
+	}
+}
+
+#define OUT_LIT( o, s ) out_mem( o, s, sizeof(s) - 1 )
+
+/* numbers are formatted directly into the buffer */
+#define OUT_NUM( o, call )						\
+	if ( out_reserve( o, TXT_NUM_MAX ) ) {				\
+		(o)->len += call;					\
+	}
+
+static void out_udec( out_buf_t * o, uint64_t val ) {
+	OUT_NUM( o, txt_udec( o->buf + o->len, val ) );
+}
+
+static void out_sdec( out_buf_t * o, int64_t val ) {
+	OUT_NUM( o, txt_sdec( o->buf + o->len, val ) );
+}
+
+/* "%llX" */
+static void out_hex( out_buf_t * o, uint64_t val ) {
+	OUT_NUM( o, txt_hex( o->buf + o->len, val, 1 ) );
+}
+
+/* "%#llX" */
+static void out_hex_alt( out_buf_t * o, uint64_t val ) {
+	OUT_NUM( o, txt_hex_alt( o->buf + o->len, val ) );
+}
+
+static void out_oct( out_buf_t * o, uint64_t val ) {
+	OUT_NUM( o, txt_oct( o->buf + o->len, val ) );
+}
+
+static void out_addr( out_buf_t * o, opdis_vma_t vma ) {
+	OUT_NUM( o, txt_addr( o->buf + o->len, vma ) );
+}
+
+static void out_hex_bytes( out_buf_t * o, const opdis_byte_t * bytes,
+			   size_t n, char sep ) {
+	if ( out_reserve( o, TXT_HEX_BYTES_LEN( n, sep ) ) ) {
+		o->len += txt_hex_bytes( o->buf + o->len, bytes, n, sep );
+	}
+}
+
+static int out_fwrite( FILE * f, out_buf_t * o ) {
+	return (int) fwrite( o->buf, 1, o->len, f );
+}
+
+static int fprint_addr( FILE * f, opdis_vma_t vma ) {
+	char buf[TXT_NUM_MAX];
+	return (int) fwrite( buf, 1, txt_addr( buf, vma ), f );
+}
+
+#define FPRINTF_ADDR( rv, f, vma ) rv += fprint_addr( f, vma )
 
 int asm_fprintf_header( FILE * f, enum asm_format_t fmt ) {
 	int rv = 0;
@@ -76,6 +194,7 @@ int asm_fprintf_header( FILE * f, enum asm_format_t fmt ) {
 		case asmfmt_asm:
 		case asmfmt_dump:
 		case asmfmt_custom:
+		case asmfmt_bin:
 			break;
 
 	}
@@ -93,79 +212,88 @@ int asm_fprintf_footer( FILE * f, enum asm_format_t fmt ) {
 		case asmfmt_dump:
 		case asmfmt_delim:
 		case asmfmt_custom:
+		case asmfmt_bin:
 			break;
 	}
 	return rv;
 }
 
 /* ---------------------------------------------------------------------- */
-static int dump_insn( FILE * f, opdis_insn_t * insn ) {
-	int i, prev_op = 0, rv = 0;
+static void dump_insn( out_buf_t * o, const opdis_insn_t * insn ) {
+	size_t start = o->len;
+	int i;
 
-	FPRINTF_ADDR( rv, f, insn->vma );
-	fprintf( f, ":" );
+	out_addr( o, insn->vma );
+	out_char( o, ':' );
 
-	for ( i = 0; i < insn->size && i < 8; i++ ) {
-		rv += fprintf( f, " %02X", insn->bytes[i] );
+	if ( insn->size ) {
+		out_char( o, ' ' );
+		out_hex_bytes( o, insn->bytes, ( insn->size < 8 ) ?
+			       insn->size : 8, ' ' );
 	}
 
 	if ( insn->status == opdis_decode_invalid ) {
-		rv += fprintf( f, "(invalid instruction)\n" );
-		return rv;
+		OUT_LIT( o, "(invalid instruction)\n" );
+		return;
 	}
 
-	/* enforce space for 6 bytes */
-	for ( i=rv; i < 36; i++ ) {
-		fprintf( f, " " );
+	/* enforce space for 6 bytes; the colon is not counted */
+	while ( o->len - start < 37 ) {
+		out_char( o, ' ' );
 	}
 
 	if ( insn->num_prefixes ) {
-		rv += fprintf( f, "%s ", insn->prefixes ); 
+		out_str( o, insn->prefixes );
+		out_char( o, ' ' );
 	}
-	rv += fprintf( f, "%s\t", insn->mnemonic );
+	out_str( o, insn->mnemonic );
+	out_char( o, '\t' );
 
 	for ( i=0; i < insn->num_operands; i++ ) {
-		if ( prev_op ) {
-			fprintf( f, ", " );
+		if ( i ) {
+			OUT_LIT( o, ", " );
 		}
-
-		fprintf( f, "%s", insn->operands[i]->ascii );
-		prev_op = 1;
+		out_str( o, insn->operands[i]->ascii );
 	}
 
 	if ( insn->comment[0] ) {
-		rv += fprintf( f, "\t# %s", insn->comment );
+		OUT_LIT( o, "\t# " );
+		out_str( o, insn->comment );
 	}
-	fprintf( f, "\n" );
+	out_char( o, '\n' );
 
 	/* print additional instruction bytes */
 	if ( insn->size > 8 ) {
-		char buf[32];
-		int sz = sprintf( buf, "%p:", (void *) insn->vma );
-		for ( i = 0; i < sz; i++ ) {
-			rv += fprintf( f, " " );
+		/* indent as far as "%p:", which is "(nil):" for 0 */
+		size_t sz = 6;
+		if ( insn->vma ) {
+			char buf[TXT_NUM_MAX];
+			sz = txt_addr( buf, insn->vma ) + 1;
 		}
-		for ( i = 8; i < insn->size; i++ ) {
-			rv += fprintf( f, " %02X", insn->bytes[i] );
+		while ( sz-- ) {
+			out_char( o, ' ' );
 		}
-		rv += fprintf( f, "\n" );
-	}
 
-	return rv;
+		out_char( o, ' ' );
+		out_hex_bytes( o, &insn->bytes[8], insn->size - 8, ' ' );
+		out_char( o, '\n' );
+	}
 }
 
-static int delim_operand( FILE * f, opdis_op_t * op ) {
-	int rv = 0;
+static void delim_operand( out_buf_t * o, opdis_op_t * op ) {
 	char buf[64];
 
 	/* ascii:cat:flags: */
-	rv += fprintf( f, "%s:", op->ascii );
+	out_str( o, op->ascii );
+	out_char( o, ':' );
 	buf[0] = 0;
 	opdis_op_cat_str( op, buf, 64 );
-	rv += fprintf( f, "%s:", buf );
+	out_str( o, buf );
+	out_char( o, ':' );
 	buf[0] = 0;
 	opdis_op_flags_str( op, buf, 64, "," );
-	rv += fprintf( f, "%s:", buf );
+	out_str( o, buf );
+	out_char( o, ':' );
 
 	/* value */
 	/* NOTE: value is either a number or an object contained in {} */
@@ -174,743 +302,1060 @@ static int delim_operand( FILE * f, opdis_op_t * op ) {
 			/* {ascii;id;size;flags} */
 			buf[0] = '\0';
 			opdis_reg_flags_str( &op->value.reg, buf, 64, "," );
-			rv += fprintf( f, "{%s;%d;%d;%s}", 
-					op->value.reg.ascii,
-					op->value.reg.id,
-					op->value.reg.size, buf );
+			out_char( o, '{' );
+			out_str( o, op->value.reg.ascii );
+			out_char( o, ';' );
+			out_sdec( o, op->value.reg.id );
+			out_char( o, ';' );
+			out_sdec( o, op->value.reg.size );
+			out_char( o, ';' );
+			out_str( o, buf );
+			out_char( o, '}' );
 			break;
 		case opdis_op_cat_absolute:
 			/* {segment;offset} */
-			rv += fprintf( f, "{%s;%llX}", 
-					op->value.abs.segment.ascii,
-				 	(long long unsigned int)
-					op->value.abs.offset );
+			out_char( o, '{' );
+			out_str( o, op->value.abs.segment.ascii );
+			out_char( o, ';' );
+			out_hex( o, op->value.abs.offset );
+			out_char( o, '}' );
 			break;
 		case opdis_op_cat_expr:
 			/* {base;index;scale;op;seg;disp} */
-			rv += fprintf( f, "{%s;%s;%d;", 
-				 op->value.expr.base.ascii,
-				 op->value.expr.index.ascii,
-				 op->value.expr.scale );
+			out_char( o, '{' );
+			out_str( o, op->value.expr.base.ascii );
+			out_char( o, ';' );
+			out_str( o, op->value.expr.index.ascii );
+			out_char( o, ';' );
+			out_sdec( o, op->value.expr.scale );
+			out_char( o, ';' );
 
 			buf[0] = '\0';
 			opdis_addr_expr_shift_str( &op->value.expr, buf, 64 );
-			rv += fprintf( f, "%s;%s;", buf,
-					(op->value.expr.elements &
-					 opdis_addr_expr_disp_abs) ?
-			     op->value.expr.displacement.a.segment.ascii : "" );
-
+			out_str( o, buf );
+			out_char( o, ';' );
+			if ( op->value.expr.elements &
+			     opdis_addr_expr_disp_abs ) {
+				out_str( o, op->value.expr.displacement.a.
+					    segment.ascii );
+			}
+			out_char( o, ';' );
 
 			if ( op->value.expr.elements & 
 			     opdis_addr_expr_disp_abs )  {
-				rv += fprintf( f, "%llX", 
-					(long long unsigned int)
-					op->value.expr.displacement.a.offset);
+				out_hex( o, op->value.expr.displacement.a.offset);
 			} else if ( op->value.expr.elements &
 				    opdis_addr_expr_disp_s ) {
-				rv += fprintf( f, "%lld", (long long int)
-					op->value.expr.displacement.s);
+				out_sdec( o, op->value.expr.displacement.s );
 			} else {
-				rv += fprintf( f, "%llX", 
-					(long long unsigned int)
-					op->value.expr.displacement.u);
+				out_hex( o, op->value.expr.displacement.u );
 			}
-			rv += fprintf( f, "}" );
+			out_char( o, '}' );
 			
 			break;
 		case opdis_op_cat_immediate:
 		case opdis_op_cat_unknown:
 			if ( op->flags & opdis_op_flag_signed ) {
-				rv += fprintf( f, "%lld", 
-						(long long int)
-						op->value.immediate.s );
+				out_sdec( o, op->value.immediate.s );
 			} else {
-				rv += fprintf( f, "%#llX", 
-						(long long unsigned int)
-						op->value.immediate.u );
+				out_hex_alt( o, op->value.immediate.u );
 			}
 			break;
 	}
-
-	return rv;
 }
 
-#define DELIM( rv, f )	rv += fprintf( f, "|" );
-static int delim_insn( FILE * f, opdis_insn_t * insn ) {
-	int i, tok_req, rv = 0;
+static void delim_insn( out_buf_t * o, const opdis_insn_t * insn ) {
+	int i;
 	char buf[64];
 
 	/* offset, address */
-	FPRINTF_ADDR( rv, f, insn->offset );
-	DELIM( rv, f );
-	FPRINTF_ADDR( rv, f, insn->vma );
-	DELIM( rv, f );
+	out_addr( o, insn->offset );
+	out_char( o, '|' );
+	out_addr( o, insn->vma );
+	out_char( o, '|' );
 
 	/* bytes */
-	for ( i = 0, tok_req = 0; i < insn->size; i++ ) {
-		if ( tok_req ) {
-			rv += fprintf( f, " " );
-		}
-		rv += fprintf( f, "%02X", insn->bytes[i] );
-		tok_req = 1;
-	}
+	out_hex_bytes( o, insn->bytes, insn->size, ' ' );
 
 	/* ascii, prefix, mnemonic */
-	rv += fprintf( f, "|%s|%s|%s|", insn->ascii, insn->prefixes, 
-			insn->mnemonic );
+	out_char( o, '|' );
+	out_str( o, insn->ascii );
+	out_char( o, '|' );
+	out_str( o, insn->prefixes );
+	out_char( o, '|' );
+	out_str( o, insn->mnemonic );
+	out_char( o, '|' );
 
 	/* isa, cat, flags */
 	buf[0] = 0;
 	opdis_insn_isa_str( insn, buf, 64 );
-	rv += fprintf( f, "%s|", buf );
+	out_str( o, buf );
+	out_char( o, '|' );
 	buf[0] = 0;
 	opdis_insn_cat_str( insn, buf, 64 );
-	rv += fprintf( f, "%s|", buf );
+	out_str( o, buf );
+	out_char( o, '|' );
 	buf[0] = 0;
 	opdis_insn_flags_str( insn, buf, 64, "," );
-	rv += fprintf( f, "%s|", buf );
+	out_str( o, buf );
+	out_char( o, '|' );
 	
 	/* comment */
-	rv += fprintf( f, "%s", insn->comment );
+	out_str( o, insn->comment );
 
 	/* operands */
 	for ( i=0; i < insn->num_operands; i++ ) {
-		DELIM( rv, f );
-		rv += delim_operand( f, insn->operands[i] );
+		out_char( o, '|' );
+		delim_operand( o, insn->operands[i] );
 		if ( insn->operands[i] == insn->target ) {
-			rv += fprintf( f, ":TARGET" );
+			OUT_LIT( o, ":TARGET" );
 		}
 		if ( insn->operands[i] == insn->src ) {
-			rv += fprintf( f, ":SRC" );
+			OUT_LIT( o, ":SRC" );
 		}
 		if ( insn->operands[i] == insn->dest ) {
-			rv += fprintf( f, ":DEST" );
+			OUT_LIT( o, ":DEST" );
 		}
 	}
 
-	rv += fprintf( f, "\n" );
+	out_char( o, '\n' );
+}
 
-	return rv;
+/* <tag>str</tag> on its own line */
+static void xml_elem( out_buf_t * o, const char * indent, const char * tag,
+		      const char * str ) {
+	out_str( o, indent );
+	out_char( o, '<' );
+	out_str( o, tag );
+	out_char( o, '>' );
+	out_str( o, str );
+	OUT_LIT( o, "</" );
+	out_str( o, tag );
+	OUT_LIT( o, ">\n" );
 }
 
-static int xml_flags( FILE * f, char * buf, const char *indent ) {
-	int rv = 0;
+/* a line of markup, e.g. "<register>" */
+static void xml_line( out_buf_t * o, const char * indent, const char * str ) {
+	out_str( o, indent );
+	out_str( o, str );
+	out_char( o, '\n' );
+}
+
+static void xml_flags( out_buf_t * o, char * buf, const char *indent ) {
 	char *c, *flag;
-	rv += fprintf( f, "%s<flags>\n", indent );
+	xml_line( o, indent, "<flags>" );
 	for ( c = buf, flag = buf; *c; c++ ) {
 		if ( *c == ',' ) {
 			*c = '\0';
-			rv += fprintf( f, "%s  <flag>%s</flag>\n",
-					indent, flag );
+			out_str( o, indent );
+			xml_elem( o, "  ", "flag", flag );
 			flag = c + 1;
 		}
 	}
 
 	if ( c != buf ) {
 		/* handle last flag */
-		rv += fprintf( f, "%s  <flag>%s</flag>\n", indent, flag );
+		out_str( o, indent );
+		xml_elem( o, "  ", "flag", flag );
 	}
 
-	rv += fprintf( f, "%s</flags>\n", indent );
-	return rv;
+	xml_line( o, indent, "</flags>" );
 }
 
-static int xml_immediate_s( FILE * f, int64_t val, const char * indent ) {
-	return fprintf( f, "%s<immediate>%lld</immediate>\n", indent,
-			(long long int) val );
+static void xml_immediate_s( out_buf_t * o, int64_t val,
+			     const char * indent ) {
+	out_str( o, indent );
+	OUT_LIT( o, "<immediate>" );
+	out_sdec( o, val );
+	OUT_LIT( o, "</immediate>\n" );
 }
 
-static int xml_immediate( FILE * f, uint64_t val, const char * indent ) {
-	return fprintf( f, "%s<immediate>%#llX</immediate>\n", indent,
-			(unsigned long long int) val );
+static void xml_immediate( out_buf_t * o, uint64_t val, const char * indent ) {
+	out_str( o, indent );
+	OUT_LIT( o, "<immediate>" );
+	out_hex_alt( o, val );
+	OUT_LIT( o, "</immediate>\n" );
 }
 
-static int xml_register( FILE * f, opdis_reg_t * reg, const char * indent ) {
-	int rv = 0;
+/* <tag>val</tag> for a signed decimal value */
+static void xml_dec( out_buf_t * o, const char * indent, const char * tag,
+		     int64_t val ) {
+	out_str( o, indent );
+	out_char( o, '<' );
+	out_str( o, tag );
+	out_char( o, '>' );
+	out_sdec( o, val );
+	OUT_LIT( o, "</" );
+	out_str( o, tag );
+	OUT_LIT( o, ">\n" );
+}
+
+static void xml_register( out_buf_t * o, opdis_reg_t * reg,
+			  const char * indent ) {
 	char buf[96];
 	char indent_buf[24];
 
-	rv += fprintf( f, "%s<register>\n", indent );
-	rv += fprintf( f, "%s  <ascii>%s</ascii>\n", indent, reg->ascii );
-	rv += fprintf( f, "%s  <id>%d</id>\n", indent, reg->id );
-	rv += fprintf( f, "%s  <size>%d</size>\n", indent, reg->size );
+	sprintf( indent_buf, "%s  ", indent );
+	xml_line( o, indent, "<register>" );
+	xml_elem( o, indent_buf, "ascii", reg->ascii );
+	xml_dec( o, indent_buf, "id", reg->id );
+	xml_dec( o, indent_buf, "size", reg->size );
 	buf[0] = 0;
 	opdis_reg_flags_str( reg, buf, 96, "," );
-	sprintf( indent_buf, "%s  ", indent );
-	rv += xml_flags( f, buf, indent_buf ); 
-	rv += fprintf( f, "%s</register>\n", indent );
-
-	return rv;
+	xml_flags( o, buf, indent_buf ); 
+	xml_line( o, indent, "</register>" );
 }
 
-static int xml_abs_addr(FILE * f, opdis_abs_addr_t * abs, const char * indent) {
-	int rv = 0;
+static void xml_abs_addr( out_buf_t * o, opdis_abs_addr_t * abs,
+			  const char * indent ) {
 	char indent_buf[24];
 
 	sprintf( indent_buf, "%s    ", indent );
-	rv += fprintf( f, "%s<absolute>\n", indent );
-	rv += fprintf( f, "%s  <segment>\n", indent );
-	rv += xml_register( f, &abs->segment, indent_buf );
-	rv += fprintf( f, "%s  </segment>\n", indent );
-	rv += xml_immediate( f, abs->offset, indent_buf );
-	rv += fprintf( f, "%s</absolute>\n", indent );
-	return rv;
+	xml_line( o, indent, "<absolute>" );
+	xml_line( o, indent, "  <segment>" );
+	xml_register( o, &abs->segment, indent_buf );
+	xml_line( o, indent, "  </segment>" );
+	xml_immediate( o, abs->offset, indent_buf );
+	xml_line( o, indent, "</absolute>" );
 }
 
-static int xml_addr_expr( FILE * f, opdis_addr_expr_t * expr, 
-			  const char * indent ) {
-	int rv = 0;
+static void xml_addr_expr( out_buf_t * o, opdis_addr_expr_t * expr, 
+			   const char * indent ) {
 	char buf[8], indent_buf[24];
 
-	rv += fprintf( f, "%s<expression>\n", indent );
+	/* the displacement is indented as the base and index */
+	indent_buf[0] = '\0';
+
+	xml_line( o, indent, "<expression>" );
 
 	/* base */
 	if ( (expr->elements & opdis_addr_expr_base) != 0 ) {
-		rv += fprintf( f, "%s  <base>\n", indent );
+		xml_line( o, indent, "  <base>" );
 		sprintf( indent_buf, "%s    ", indent );
-		rv += xml_register( f, &expr->base, indent_buf );
-		rv += fprintf( f, "%s  </base>\n", indent );
+		xml_register( o, &expr->base, indent_buf );
+		xml_line( o, indent, "  </base>" );
 	}
 
 	/* index */
 	if ( (expr->elements & opdis_addr_expr_index) != 0 ) {
-		rv += fprintf( f, "%s  <index>\n", indent );
+		xml_line( o, indent, "  <index>" );
 		sprintf( indent_buf, "%s    ", indent );
-		rv += xml_register( f, &expr->index, indent_buf );
-		rv += fprintf( f, "%s  </index>\n", indent );
+		xml_register( o, &expr->index, indent_buf );
+		xml_line( o, indent, "  </index>" );
 	}
 
 	/* scale */
-	rv += fprintf( f, "%s  <scale>%d</scale>\n", indent, expr->scale );
+	out_str( o, indent );
+	xml_dec( o, "  ", "scale", expr->scale );
 	buf[0] = '\0';
 	opdis_addr_expr_shift_str( expr, buf, 8 );
-	rv += fprintf( f, "%s  <shift>%s</shift>\n", indent, buf );
+	out_str( o, indent );
+	xml_elem( o, "  ", "shift", buf );
 
 	/* displacement */
 	if ( (expr->elements & opdis_addr_expr_disp) != 0 ) {
-		rv += fprintf( f, "%s  <displacement>\n", indent );
+		xml_line( o, indent, "  <displacement>" );
 		if ( (expr->elements & opdis_addr_expr_disp_abs) != 0 ) {
-			rv += xml_abs_addr( f, &expr->displacement.a, 
-					    indent_buf );
+			xml_abs_addr( o, &expr->displacement.a, indent_buf );
 		} else if ( (expr->elements & opdis_addr_expr_disp_s) != 0 ) {
-			rv += xml_immediate_s( f, expr->displacement.s, 
-					       indent_buf );
+			xml_immediate_s( o, expr->displacement.s, indent_buf );
 		} else {
-			rv += xml_immediate( f, expr->displacement.u, 
-					     indent_buf );
+			xml_immediate( o, expr->displacement.u, indent_buf );
 		}
-		rv += fprintf( f, "%s  </displacement>\n", indent );
+		xml_line( o, indent, "  </displacement>" );
 	}
 
-	rv += fprintf( f, "%s</expression>\n", indent );
-	return rv;
+	xml_line( o, indent, "</expression>" );
 }
 
-static int xml_operand( FILE * f, opdis_op_t * op ) {
-	int rv = 0;
+static void xml_operand( out_buf_t * o, opdis_op_t * op ) {
 	char buf[64];
 
 	/* ascii:cat:flags: */
-	rv += fprintf( f, "    <ascii>%s</ascii>\n", op->ascii );
+	xml_elem( o, "    ", "ascii", op->ascii );
 	buf[0] = 0;
 	opdis_op_cat_str( op, buf, 64 );
-	rv += fprintf( f, "    <category>%s</category>\n", buf );
+	xml_elem( o, "    ", "category", buf );
 	buf[0] = 0;
 	opdis_op_flags_str( op, buf, 64, "," );
-	rv += xml_flags( f, buf, "    " ); 
+	xml_flags( o, buf, "    " ); 
 
 	/* value */
-	rv += fprintf( f, "    <value>\n" );
+	OUT_LIT( o, "    <value>\n" );
 
 	switch (op->category) {
 		case opdis_op_cat_register:
-			rv += xml_register( f, &op->value.reg, "      " );
+			xml_register( o, &op->value.reg, "      " );
 			break;
 		case opdis_op_cat_absolute:
-			rv += xml_abs_addr( f, &op->value.abs, "      " );
+			xml_abs_addr( o, &op->value.abs, "      " );
 			break;
 		case opdis_op_cat_expr:
-			rv += xml_addr_expr( f, &op->value.expr, "      " );
+			xml_addr_expr( o, &op->value.expr, "      " );
 			break;
 		case opdis_op_cat_immediate:
 		case opdis_op_cat_unknown:
 			if ( (op->flags & opdis_op_flag_signed) != 0 ) {
-				rv += xml_immediate_s( f, op->value.immediate.s,
-							"      ");
+				xml_immediate_s( o, op->value.immediate.s,
+						 "      ");
 			} else {
-				rv += xml_immediate( f, op->value.immediate.u, 
-						     "      ");
+				xml_immediate( o, op->value.immediate.u, 
+					       "      ");
 			}
 			break;
 	}
 
-	rv += fprintf( f, "    </value>\n" );
-
-	return rv;
+	OUT_LIT( o, "    </value>\n" );
 }
 
-static int xml_insn( FILE * f, opdis_insn_t * insn ) {
-	int i, rv = 0;
+static void xml_insn( out_buf_t * o, const opdis_insn_t * insn ) {
+	int i;
 	char buf[64];
 
-	rv += fprintf( f, "<instruction>\n" );
-
-	rv += fprintf( f, "  <offset>" );
-	FPRINTF_ADDR( rv, f, insn->offset );
-	rv += fprintf( f, "</offset>\n  <vma>" );
-	FPRINTF_ADDR( rv, f, insn->vma );
-	rv += fprintf( f, "</vma>\n  <bytes>\n" );
+	OUT_LIT( o, "<instruction>\n  <offset>" );
+	out_addr( o, insn->offset );
+	OUT_LIT( o, "</offset>\n  <vma>" );
+	out_addr( o, insn->vma );
+	OUT_LIT( o, "</vma>\n  <bytes>\n" );
 	for ( i = 0; i < insn->size; i++ ) {
-		rv += fprintf( f, "    <byte>%02X</byte>\n", 
-				insn->bytes[i] );
+		OUT_LIT( o, "    <byte>" );
+		if ( out_reserve( o, 2 ) ) {
+			o->len += txt_hex_byte( o->buf + o->len,
+						insn->bytes[i] );
+		}
+		OUT_LIT( o, "</byte>\n" );
 	}
-	rv += fprintf( f, "  </bytes>\n" );
+	OUT_LIT( o, "  </bytes>\n" );
 
 	if ( insn->status == opdis_decode_invalid ) {
-		rv += fprintf( f, "  <invalid />\n</instruction>\n" );
-		return rv;
+		OUT_LIT( o, "  <invalid />\n</instruction>\n" );
+		return;
 	}
 
 	/* ascii, prefix, mnemonic */
-	rv += fprintf( f, "  <ascii>%s</ascii>\n", insn->ascii );
+	xml_elem( o, "  ", "ascii", insn->ascii );
 	if ( insn->num_prefixes ) {
-		rv += fprintf( f, "  <prefix>%s</prefix>\n", insn->prefixes );
+		xml_elem( o, "  ", "prefix", insn->prefixes );
 	}
-	rv += fprintf( f, "  <mnemonic>%s</mnemonic>\n", insn->mnemonic );
+	xml_elem( o, "  ", "mnemonic", insn->mnemonic );
 
 	/* isa, cat, flags */
 	buf[0] = 0;
 	opdis_insn_isa_str( insn, buf, 64 );
-	rv += fprintf( f, "  <isa>%s</isa>\n", buf );
+	xml_elem( o, "  ", "isa", buf );
 	buf[0] = 0;
 	opdis_insn_cat_str( insn, buf, 64 );
-	rv += fprintf( f, "  <category>%s</category>\n", buf );
+	xml_elem( o, "  ", "category", buf );
 
 	buf[0] = 0;
 	opdis_insn_flags_str( insn, buf, 64, "," );
-	rv += xml_flags( f, buf, "  " ); 
+	xml_flags( o, buf, "  " ); 
 	
 	/* operands */
-	rv += fprintf( f, "  <operands>\n" );
+	OUT_LIT( o, "  <operands>\n" );
 	for ( i=0; i < insn->num_operands; i++ ) {
-		rv += fprintf( f, "    <operand" );
+		OUT_LIT( o, "    <operand" );
 		if ( insn->operands[i] == insn->target ) {
-			rv += fprintf( f, " name=\"target\"" );
+			OUT_LIT( o, " name=\"target\"" );
 		} else if ( insn->operands[i] == insn->src ) {
-			rv += fprintf( f, " name=\"src\"" );
+			OUT_LIT( o, " name=\"src\"" );
 		} else if ( insn->operands[i] == insn->dest ) {
-			rv += fprintf( f, " name=\"dest\"" );
+			OUT_LIT( o, " name=\"dest\"" );
 		}
-		rv += fprintf( f, ">\n" );
+		OUT_LIT( o, ">\n" );
 
-		rv += xml_operand( f, insn->operands[i] );
-		rv += fprintf( f, "    </operand>\n" );
+		xml_operand( o, insn->operands[i] );
+		OUT_LIT( o, "    </operand>\n" );
 	}
-	rv += fprintf( f, "  </operands>\n" );
+	OUT_LIT( o, "  </operands>\n" );
 
 	/* comment */
 	if ( insn->comment[0] ) {
-		rv += fprintf( f, "  <comment>\n%s\n</comment>\n", 
-				insn->comment );
+		OUT_LIT( o, "  <comment>\n" );
+		out_str( o, insn->comment );
+		OUT_LIT( o, "\n</comment>\n" );
 	}
 
-	rv += fprintf( f, "</instruction>\n" );
+	OUT_LIT( o, "</instruction>\n" );
+}
 
-	return rv;
+static void asm_insn( out_buf_t * o, const opdis_insn_t * insn ) {
+	out_str( o, insn->ascii );
+	if (! strchr( insn->ascii, '#' ) ) {
+		OUT_LIT( o, "\t#" );
+	}
+	OUT_LIT( o, " [" );
+	out_addr( o, insn->vma );
+	OUT_LIT( o, "]\n" );
 }
 
-static int handle_insn( FILE * f, const opdis_insn_t * insn, 
-			const char * c ) {
-	int rv = 0;
+/* ---------------------------------------------------------------------- */
+/* CUSTOM FORMAT */
+
+/* A custom format string is compiled once into a list of ops. Literal text
+ * between fields is stored as a single span. Each insn is printed into a
+ * buffer owned by the program, which is written with one fwrite. */
+
+enum fmt_op_t {
+	fop_literal,		/* literal span; clears conditional delim */
+	fop_delim,		/* set conditional delim */
+	fop_insn,		/* %i */
+	fop_addr,		/* %a */
+	fop_bytes,		/* %b */
+	fop_length,		/* %l */
+	fop_prefix,		/* %p */
+	fop_mnemonic,		/* %m */
+	fop_comment,		/* %c */
+	fop_operand		/* %o */
+};
+
+/* operand selectors */
+enum { fsel_all = -1, fsel_target = -2, fsel_dest = -3, fsel_src = -4 };
+
+typedef struct {
+	enum fmt_op_t type;
+	char field;		/* field char, e.g. 'C' in %iC; 0 for default */
+	char src;		/* %a: 'v' or 'o' */
+	int arg;		/* literal: offset into text; operand: selector */
+	int len;		/* literal: length */
+} fmt_op_t;
+
+struct ASM_FMT_PROG {
+	fmt_op_t * ops;
+	unsigned int num_ops;
+	char * text;		/* literal text */
+	out_buf_t out;		/* output buffer, reused for each insn */
+};
+
+static char escape_char( char c ) {
+	switch ( c ) {
+		case 'n': return '\n';
+		case 't': return '\t';
+		case 'r': return '\r';
+		case 'b': return '\b';
+		case 'v': return '\v';
+		case 'a': return '\a';
+		case '?': return '\?';
+		default: return c;	/* \\, \', \" and anything else */
+	}
+}
+
+static fmt_op_t * add_op( asm_fmt_t p, enum fmt_op_t type ) {
+	fmt_op_t * op = &p->ops[p->num_ops++];
+	memset( op, 0, sizeof(fmt_op_t) );
+	op->type = type;
+	return op;
+}
+
+/* append a literal char, extending the previous span if there is one */
+static void add_literal( asm_fmt_t p, int * text_len, char c ) {
+	fmt_op_t * op = p->num_ops ? &p->ops[p->num_ops - 1] : NULL;
+
+	if (! op || op->type != fop_literal ) {
+		op = add_op( p, fop_literal );
+		op->arg = *text_len;
+	}
+
+	p->text[(*text_len)++] = c;
+	op->len++;
+}
+
+static int is_field( const char * fields, char c ) {
+	return ( c && strchr( fields, c ) );
+}
+
+asm_fmt_t asm_fmt_compile( const char * fmt_str ) {
+	asm_fmt_t p;
+	const char * c;
+	int text_len = 0;
+	size_t len;
+
+	if (! fmt_str ) {
+		return NULL;
+	}
+
+	/* each char yields at most one op or one literal char */
+	len = strlen( fmt_str );
+	p = (asm_fmt_t) calloc( 1, sizeof(struct ASM_FMT_PROG) );
+	if (! p ) {
+		return NULL;
+	}
+	p->ops = (fmt_op_t *) calloc( len + 1, sizeof(fmt_op_t) );
+	p->text = (char *) calloc( len + 1, 1 );
+	if (! p->ops || ! p->text ) {
+		asm_fmt_free( p );
+		return NULL;
+	}
+
+	for ( c = fmt_str; *c; c++ ) {
+		fmt_op_t * op;
+
+		if ( *c == '\\' ) {
+			if (! c[1] ) {
+				break;
+			}
+			c++;
+			add_literal( p, &text_len, escape_char( *c ) );
+			continue;
+		}
+		if ( *c != '%' ) {
+			add_literal( p, &text_len, *c );
+			continue;
+		}
+
+		c++;
+		switch (*c) {
+			case '\0':
+				c--;
+				break;
+			case '%':
+				add_literal( p, &text_len, '%' );
+				break;
+			case 'i':	/* instruction */
+				op = add_op( p, fop_insn );
+				if ( is_field( "ICFA", c[1] ) ) {
+					op->field = *(++c);
+				}
+				break;
+			case 'a':	/* address */
+				op = add_op( p, fop_addr );
+				op->src = 'v';
+				if ( c[1] == 'v' || c[1] == 'o' ) {
+					op->src = *(++c);
+				}
+				if ( is_field( "DOX", c[1] ) ) {
+					op->field = *(++c);
+				}
+				break;
+			case 'b':	/* bytes */
+				op = add_op( p, fop_bytes );
+				if ( is_field( "CDOX", c[1] ) ) {
+					op->field = *(++c);
+				}
+				break;
+			case 'l':	/* length */
+				add_op( p, fop_length );
+				break;
+			case 'p':	/* prefix */
+				add_op( p, fop_prefix );
+				break;
+			case 'm':	/* mnemonic */
+				add_op( p, fop_mnemonic );
+				break;
+			case 'c':	/* comment */
+				add_op( p, fop_comment );
+				break;
+			case 'o':	/* operand */
+				op = add_op( p, fop_operand );
+				op->arg = fsel_all;
+				if ( c[1] == 'a' ) {
+					c++;
+				} else if ( c[1] == 't' ) {
+					op->arg = fsel_target;
+					c++;
+				} else if ( c[1] == 'd' ) {
+					op->arg = fsel_dest;
+					c++;
+				} else if ( c[1] == 's' ) {
+					op->arg = fsel_src;
+					c++;
+				} else if ( isdigit(c[1]) ) {
+					op->arg = *(++c) - '0';
+				}
+				if ( is_field( "CFA", c[1] ) ) {
+					op->field = *(++c);
+				}
+				break;
+			case '?':	/* conditional delim */
+				if (! c[1] ) {
+					break;
+				}
+				op = add_op( p, fop_delim );
+				op->field = *(++c);
+				break;
+			case 't':	/* conditional tab */
+				add_op( p, fop_delim )->field = '\t';
+				break;
+			case 's':	/* conditional space */
+				add_op( p, fop_delim )->field = ' ';
+				break;
+			case 'n':	/* conditional newline */
+				add_op( p, fop_delim )->field = '\n';
+				break;
+			default:
+				/* unknown fields are ignored */
+				break;
+		}
+	}
+
+	return p;
+}
+
+void asm_fmt_free( asm_fmt_t p ) {
+	if (! p ) {
+		return;
+	}
+
+	free( p->ops );
+	free( p->text );
+	free( p->out.buf );
+	free( p );
+}
+
+static void out_delim( asm_fmt_t p, char * delim ) {
+	if ( *delim != '\0' ) {
+		out_char( &p->out, *delim );
+		*delim = '\0';
+	}
+}
+
+static void run_insn( asm_fmt_t p, const fmt_op_t * op,
+		      const opdis_insn_t * insn ) {
 	char buf[64];
 	buf[0] = 0;
 
-	switch (*c) {
+	switch ( op->field ) {
 		case 'I':
 			opdis_insn_isa_str( insn, buf, 64 );
-			fprintf( f, "%s", buf );
-			rv++;
+			out_str( &p->out, buf );
 			break;
 		case 'C':
 			opdis_insn_cat_str( insn, buf, 64 );
-			fprintf( f, "%s", buf );
-			rv++;
+			out_str( &p->out, buf );
 			break;
 		case 'F':
 			opdis_insn_flags_str( insn, buf, 64, "|" );
-			fprintf( f, "%s", buf );
-			rv++;
+			out_str( &p->out, buf );
 			break;
-		case 'A':
-			rv++;
-			/* fall-through */
 		default:
-			fprintf( f, "%s", insn->ascii );
+			out_str( &p->out, insn->ascii );
 	}
-
-	return rv;
 }
 
-static int handle_addr( FILE * f, const opdis_insn_t * insn, 
-			const char * c ) {
-	int rv = 0, junk;
-	opdis_vma_t val;
+static void run_addr( asm_fmt_t p, const fmt_op_t * op,
+		      const opdis_insn_t * insn ) {
+	opdis_vma_t val = ( op->src == 'o' ) ? insn->offset : insn->vma;
 
-	if ( *c == 'v' ) {
-		val = insn->vma;
-		c++;
-		rv++;
-	} else if ( *c == 'o' ) {
-		val = insn->offset;
-		c++;
-		rv++;
-	} else {
-		val = insn->vma;
-	}
-
-	switch (*c) {
+	switch ( op->field ) {
 		case 'D':
-			fprintf( f, "%lld", (long long int) val );
-			rv++;
+			out_sdec( &p->out, (int64_t) val );
 			break;
 		case 'O':
-			fprintf( f, "%llo", (long long int) val );
-			rv++;
+			out_oct( &p->out, val );
 			break;
-		case 'X':
-			rv++;
-			/* fall-through */
 		default:
-			FPRINTF_ADDR( junk, f, val );
+			out_addr( &p->out, val );
 	}
-
-	return rv;
 }
 
-static int handle_bytes( FILE * f, const opdis_insn_t * insn, 
-			 const char * c ) {
-	int i, rv = 0, preceding = 0;
-	char * fmt_str = "%02X";
-	char buf[64];
+static void run_bytes( asm_fmt_t p, const fmt_op_t * op,
+		       const opdis_insn_t * insn ) {
+	out_buf_t * o = &p->out;
+	int i;
 
-	switch (*c) {
-		case 'C':
-			fmt_str = "%c";
-			rv++;
-			break;
-		case 'D':
-			fmt_str = "%2d";
-			rv++;
-			break;
-		case 'O':
-			fmt_str = "%02o";
-			rv++;
-			break;
-		case 'X':
-			rv++;
-			/* fall-through */
-		default:
-			break;
+	if ( op->field != 'C' && op->field != 'D' && op->field != 'O' ) {
+		out_hex_bytes( o, insn->bytes, insn->size, ' ' );
+		return;
+	}
 
+	if (! out_reserve( o, insn->size * 4 ) ) {
+		return;
 	}
 
 	for ( i = 0; i < insn->size; i++ ) {
-		opdis_byte_t byte = (*c == 'C' && ! isprint(insn->bytes[i])) ? 
-				'.' : insn->bytes[i];
-		if ( preceding ) {
-			fprintf( f, " " );
+		opdis_byte_t byte = insn->bytes[i];
+		if ( i ) {
+			o->buf[o->len++] = ' ';
+		}
+		switch ( op->field ) {
+			case 'C':
+				o->buf[o->len++] = isprint(byte) ? byte : '.';
+				break;
+			case 'D':
+				/* "%2d" */
+				if ( byte < 10 ) {
+					o->buf[o->len++] = ' ';
+				}
+				o->len += txt_udec( o->buf + o->len, byte );
+				break;
+			case 'O':
+				/* "%02o" */
+				if ( byte < 8 ) {
+					o->buf[o->len++] = '0';
+				}
+				o->len += txt_oct( o->buf + o->len, byte );
+				break;
 		}
-		fprintf( f, fmt_str, byte ); 
-		preceding = 1;
 	}
-
-	return rv;
 }
 
-#define OP_CAT( f, op, buf )				\
-	buf[0] = '\0';					\
-	opdis_op_cat_str( op, buf, 64 );		\
-	fprintf( f, "%s", buf );
-
-#define OP_FLAGS( f, op, buf )				\
-	buf[0] = '\0';					\
-	opdis_op_flags_str( op, buf, 64, "|" );		\
-	fprintf( f, "%s", buf );
-
-static int handle_op( FILE * f, const opdis_insn_t * insn, const char * c ) {
-	int rv = 0, all_operands = 0;
-	opdis_op_t * op = NULL;
+static void run_one_op( asm_fmt_t p, char field, opdis_op_t * op ) {
 	char buf[64];
+	buf[0] = '\0';
 
-	if ( *c == 'a' ) {
-		all_operands = 1;
-		c++;
-		rv++;
-	} else if ( *c == 't' ) {
-		op = insn->target;
-		c++;
-		rv++;
-	} else if ( *c == 'd' ) {
-		op = insn->dest;
-		c++;
-		rv++;
-	} else if ( *c == 's' ) {
-		op = insn->src;
-		c++;
-		rv++;
-	} else if ( isdigit(*c) ) {
-		int i = *c - '0';
-		c++;
-		rv++;
-		if ( i < insn->num_operands ) {
-			op = insn->operands[i];
-		}
-	} else {
-		all_operands = 1;
-	}
-
-	if (! op && (! all_operands || ! insn->num_operands ) ) {
-		if ( *c == 'C' || *c == 'F' || *c == 'A' ) {
-			/* consume next */
-			rv++;
-		}
-		return rv;
-	}
-
-	switch (*c) {
+	switch ( field ) {
 		case 'C':
-			if ( all_operands ) {
-				int i;
-				for ( i = 0; i < insn->num_operands; i++ ) {
-					if ( i > 0 ) {
-						fprintf( f, ", " );
-					}
-					OP_CAT(f, insn->operands[i], buf);
-				}
-			} else {
-				OP_CAT(f, op, buf);
-			}
-			rv++;
+			opdis_op_cat_str( op, buf, 64 );
+			out_str( &p->out, buf );
 			break;
 		case 'F':
-			if ( all_operands ) {
-				int i;
-				for ( i = 0; i < insn->num_operands; i++ ) {
-					if ( i > 0 ) {
-						fprintf( f, ", " );
-					}
-					OP_FLAGS(f, insn->operands[i], buf);
-				}
-			} else {
-				OP_FLAGS(f, op, buf);
-			}
-			rv++;
+			opdis_op_flags_str( op, buf, 64, "|" );
+			out_str( &p->out, buf );
 			break;
-		case 'A':
-			rv++;
-			/* fall-through */
 		default:
-			if ( all_operands ) {
-				int i;
-				for ( i = 0; i < insn->num_operands; i++ ) {
-					if ( i > 0 ) {
-						fprintf( f, ", " );
-					}
-					fprintf( f, "%s", 
-						insn->operands[i]->ascii );
-				}
-			} else {
-				fprintf( f, "%s", op->ascii );
-			}
+			out_str( &p->out, op->ascii );
 	}
-
-	return rv;
 }
 
-static int insn_has_component( const opdis_insn_t * insn, char c ) {
-	if ( c == 'C' && (int) insn->category == 0 ) {
-		return 0;
+static opdis_op_t * select_op( const fmt_op_t * op,
+			       const opdis_insn_t * insn ) {
+	switch ( op->arg ) {
+		case fsel_all: return NULL;
+		case fsel_target: return insn->target;
+		case fsel_dest: return insn->dest;
+		case fsel_src: return insn->src;
 	}
-	if ( c == 'F' && (int) insn->flags.cflow == 0 ) {
-		return 0;
-	}
-
-	return 1;
+	return ( op->arg < insn->num_operands ) ? insn->operands[op->arg] : 
+						  NULL;
 }
 
-static int op_is_present( const opdis_insn_t * insn, char c ) {
-	if (! insn->num_operands ) {
-		return 0;
-	}
-
-	if ( c == 't' && ! insn->target ) {
-		return 0;
-	}
+static void run_operand( asm_fmt_t p, const fmt_op_t * op,
+			 const opdis_insn_t * insn, char * delim ) {
+	opdis_op_t * o = select_op( op, insn );
+	int i;
 
-	if ( c == 'd' && ! insn->dest ) {
-		return 0;
+	if ( insn->num_operands && ( op->arg == fsel_all || o ) ) {
+		out_delim( p, delim );
+	} else {
+		*delim = '\0';
 	}
 
-	if ( c == 's' && ! insn->src ) {
-		return 0;
+	if ( op->arg != fsel_all ) {
+		if ( o ) {
+			run_one_op( p, op->field, o );
+		}
+		return;
 	}
 
-	if ( isdigit(c) ) {
-		if ( (c - '0') >= insn->num_operands ) {
-			return 0;
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		if ( i > 0 ) {
+			out_mem( &p->out, ", ", 2 );
 		}
+		run_one_op( p, op->field, insn->operands[i] );
 	}
-
-	/* default is all operands */
-	return 1;
 }
 
-#define COND_DELIM(f, d)			\
-	if ( d != '\0' ) {			\
-		fprintf( f, "%c", d );		\
-		d = '\0';			\
-	}
+int asm_fprintf_custom( FILE * f, asm_fmt_t p, const opdis_insn_t * insn ) {
+	char delim = '\0';
+	unsigned int i;
 
+	if (! p || ! insn ) {
+		return 0;
+	}
 
-static int custom_insn( FILE * f, const char * fmt_str, opdis_insn_t * insn ) {
-	const char *c;
-	char cond_delim = '\0';
-	int rv = 0, inc;
+	p->out.len = 0;
+	for ( i = 0; i < p->num_ops; i++ ) {
+		const fmt_op_t * op = &p->ops[i];
 
-	for ( c = fmt_str; *c; c++ ) {
-		/* very lame and slow implementation */
-		if ( *c != '%' ) {
-			char out = *c;
-			if ( *c == '\\' ) {
-				c++;
-				switch ( *c ) {
-					case 'n': out = '\n'; break;
-					case 't': out = '\t'; break;
-					case '\\': out = '\\'; break;
-					case '\'': out = '\''; break;
-					case '\"': out = '\"'; break;
-					case 'r': out = '\r'; break;
-					case 'b': out = '\b'; break;
-					case 'v': out = '\v'; break;
-					case 'a': out = '\a'; break;
-					case '?': out = '\?'; break;
-					default: out = *c;
-				}
-			}
-			rv += fprintf( f, "%c", out );
-			cond_delim = '\0'; /* clear cond-delim */
-			continue;
-		}
-		c++;
-		if ( *c == '%' ) {
-			rv += fprintf( f, "%%" );
-			cond_delim = '\0'; /* clear cond-delim */
-			continue;
-		}
-
-		switch (*c) {
-			case 'i':	/* instruction */
-				if ( insn_has_component( insn, c[1] ) ) {
-					COND_DELIM( f, cond_delim );
+		switch ( op->type ) {
+			case fop_literal:
+				out_mem( &p->out, p->text + op->arg, op->len );
+				delim = '\0';
+				break;
+			case fop_delim:
+				delim = op->field;
+				break;
+			case fop_insn:
+				if (! ( op->field == 'C' &&
+					(int) insn->category == 0 ) &&
+				    ! ( op->field == 'F' && 
+					(int) insn->flags.cflow == 0 ) ) {
+					out_delim( p, &delim );
 				}
-				inc = handle_insn( f, insn, &c[1] );
-				c += inc;
-				rv += inc;
+				run_insn( p, op, insn );
 				break;
-			case 'a':	/* address */
-				COND_DELIM( f, cond_delim );
-				inc = handle_addr( f, insn, &c[1] );
-				c += inc;
-				rv += inc;
+			case fop_addr:
+				out_delim( p, &delim );
+				run_addr( p, op, insn );
 				break;
-			case 'b':	/* bytes */
-				COND_DELIM( f, cond_delim );
-				inc = handle_bytes( f, insn, &c[1] );
-				c += inc;
-				rv += inc;
+			case fop_bytes:
+				out_delim( p, &delim );
+				run_bytes( p, op, insn );
 				break;
-			case 'l':	/* length */
-				COND_DELIM( f, cond_delim );
-				rv += fprintf(f, "%d", (int) insn->size);
+			case fop_length:
+				out_delim( p, &delim );
+				out_udec( &p->out, insn->size );
 				break;
-			case 'p':	/* prefix */
+			case fop_prefix:
 				if ( insn->num_prefixes ) {
-					COND_DELIM( f, cond_delim );
-					rv += fprintf(f, "%s", insn->prefixes);
+					out_delim( p, &delim );
+					out_str( &p->out, insn->prefixes );
 				} else {
-					cond_delim = '\0';
+					delim = '\0';
 				}
 				break;
-			case 'm':	/* mnemonic */
+			case fop_mnemonic:
 				if ( insn->mnemonic[0] ) {
-					COND_DELIM( f, cond_delim );
-					rv += fprintf(f, "%s", insn->mnemonic);
+					out_delim( p, &delim );
+					out_str( &p->out, insn->mnemonic );
 				} else {
-					cond_delim = '\0';
+					delim = '\0';
 				}
 				break;
-			case 'c':	/* comment */
+			case fop_comment:
 				if ( insn->comment[0] ) {
-					COND_DELIM( f, cond_delim );
-					rv += fprintf( f, "%s", insn->comment );
+					out_delim( p, &delim );
+					out_str( &p->out, insn->comment );
 				} else {
-					cond_delim = '\0';
+					delim = '\0';
 				}
 				break;
-			case 'o':	/* operand */
-				if ( op_is_present( insn, c[1] ) ) {
-					COND_DELIM( f, cond_delim );
-				} else {
-					cond_delim = '\0';
-				}
-				inc = handle_op( f, insn, &c[1] );
-				c += inc;
-				rv += inc;
-
+			case fop_operand:
+				run_operand( p, op, insn, &delim );
 				break;
-			case '?':	/* conditional delim */
-				c++;
-				cond_delim = *c;
-				break;
-			case 't':	/* conditional tab */
-				cond_delim = '\t';
-				break;
-			case 's':	/* conditional space */
-				cond_delim = ' ';
-				break;
-			case 'n':	/* conditional newline */
-				cond_delim = '\n';
-				break;
-			default:
-				continue;
 		}
 	}
 
-	return rv;
+	return out_fwrite( f, &p->out );
 }
 
-int asm_fprintf_insn( FILE * f, enum asm_format_t fmt, const char * fmt_str,
+int asm_fprintf_insn( FILE * f, enum asm_format_t fmt, asm_fmt_t fmt_prog,
 		      opdis_insn_t * insn ) {
-	int rv = 0;
+	char stack[OUT_STACK_SIZE];
+	out_buf_t o = { stack, 0, sizeof(stack), 0 };
+	int rv;
+
 	switch (fmt) {
 		case asmfmt_asm:
-			rv += fprintf( f, "%s", insn->ascii );
-			if (! strchr( insn->ascii, '#' ) ) {
-				rv += fprintf( f, "\t#" );
-			}
-			rv += fprintf( f, " [" );
-			FPRINTF_ADDR( rv, f, insn->vma );
-			rv += fprintf( f, "]\n" );
-			break;
+			asm_insn( &o, insn ); break;
 		case asmfmt_dump:
-			rv = dump_insn( f, insn ); break;
+			dump_insn( &o, insn ); break;
 		case asmfmt_delim:
-			rv = delim_insn( f, insn ); break;
+			delim_insn( &o, insn ); break;
 		case asmfmt_xml:
-			rv = xml_insn( f, insn ); break;
+			xml_insn( &o, insn ); break;
 		case asmfmt_custom:
-			rv = custom_insn( f, fmt_str, insn ); break;
+			return asm_fprintf_custom( f, fmt_prog, insn );
+		case asmfmt_bin:
+			/* binary output is written by asm_fwrite_bin */
+			return 0;
+
+	}
+
+	rv = out_fwrite( f, &o );
+	if ( o.heap ) {
+		free( o.buf );
+	}
+	return rv;
+}
+
+/* ---------------------------------------------------------------------- */
+/* BINARY OUTPUT */
+
+struct BIN_ARG {
+	opdis_cols_writer_t w;
+	int ok;
+};
+
+static int bin_insn( opdis_insn_t * insn, void * arg ) {
+	struct BIN_ARG * b = (struct BIN_ARG *) arg;
+	b->ok = opdis_cols_writer_add( b->w, insn );
+	return b->ok;
+}
+
+int asm_fwrite_bin( FILE * f, opdis_insn_vec_t vec ) {
+	struct BIN_ARG b = { NULL, 1 };
+
+	b.w = opdis_cols_writer_init( f, 0 );
+	if (! b.w ) {
+		fprintf( stderr, "Unable to write binary output\n" );
+		return 0;
+	}
+
+	opdis_insn_vec_foreach( vec, bin_insn, &b );
+	if (! opdis_cols_writer_close( b.w ) || ! b.ok ) {
+		fprintf( stderr, "Error writing binary output\n" );
+		return 0;
+	}
+
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* CONTROL FLOW GRAPHS */
+
+static const char * edge_type_str( enum opdis_cfg_edge_type_t type ) {
+	switch ( type ) {
+		case opdis_cfg_edge_fallthrough: return "fallthrough";
+		case opdis_cfg_edge_jump: return "jump";
+		case opdis_cfg_edge_call: return "call";
+	}
+	return "unknown";
+}
+
+/* print string as the body of a double-quoted dot string */
+static int dot_escape( FILE * f, const char * str ) {
+	int rv = 0;
+
+	for ( ; *str; str++ ) {
+		if ( *str == '"' || *str == '\\' ) {
+			rv += fprintf( f, "\\%c", *str );
+		} else if ( *str == '\t' ) {
+			rv += fprintf( f, " " );
+		} else {
+			rv += fprintf( f, "%c", *str );
+		}
+	}
+
+	return rv;
+}
+
+struct CFG_PRINT {
+	FILE * f;
+	opdis_insn_vec_t vec;
+	int rv;
+};
+
+static int dot_block( opdis_cfg_t cfg, const opdis_cfg_block_t * block,
+		      void * arg ) {
+	struct CFG_PRINT * p = (struct CFG_PRINT *) arg;
+	opdis_insn_t * insn = opdis_insn_vec_find( p->vec, block->vma );
+	unsigned int i;
+
+	p->rv += fprintf( p->f, "\t\tb%lu [label=\"",
+			  (unsigned long) (block - cfg->blocks) );
+	for ( i = 0; insn && i < block->num_insns; i++ ) {
+		FPRINTF_ADDR( p->rv, p->f, insn->vma );
+		p->rv += fprintf( p->f, ": " );
+		p->rv += dot_escape( p->f, insn->ascii );
+		p->rv += fprintf( p->f, "\\l" );
+		insn = opdis_insn_vec_next( p->vec, insn->vma );
+	}
+	p->rv += fprintf( p->f, "\"];\n" );
+
+	return 1;
+}
 
+static int dot_cfg( FILE * f, opdis_cfg_t cfg, opdis_insn_vec_t vec ) {
+	struct CFG_PRINT p = { f, vec, 0 };
+	size_t i;
+
+	p.rv += fprintf( f, "digraph cfg {\n" );
+	p.rv += fprintf( f, "\tnode [shape=box fontname=\"monospace\"];\n" );
+
+	/* one cluster per function */
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		const opdis_cfg_func_t * func = &cfg->funcs[i];
+		if (! func->num_blocks ) {
+			continue;
+		}
+
+		p.rv += fprintf( f, "\tsubgraph cluster_%lu {\n\t\tlabel=\"",
+				 (unsigned long) i );
+		if ( func->name ) {
+			p.rv += dot_escape( f, func->name );
+		} else {
+			FPRINTF_ADDR( p.rv, f, func->vma );
+		}
+		p.rv += fprintf( f, "\";\n" );
+		opdis_cfg_foreach_func_block( cfg, func, dot_block, &p );
+		p.rv += fprintf( f, "\t}\n" );
+	}
+
+	for ( i = 0; i < cfg->num_edges; i++ ) {
+		const opdis_cfg_edge_t * e = &cfg->edges[i];
+		p.rv += fprintf( f, "\tb%u -> b%u", e->src, e->dest );
+		if ( e->type == opdis_cfg_edge_fallthrough ) {
+			p.rv += fprintf( f, " [style=dashed]" );
+		} else if ( e->type == opdis_cfg_edge_call ) {
+			p.rv += fprintf( f, " [style=dotted]" );
+		}
+		p.rv += fprintf( f, ";\n" );
+	}
+
+	p.rv += fprintf( f, "}\n" );
+	return p.rv;
+}
+
+static int xml_block( opdis_cfg_t cfg, const opdis_cfg_block_t * block,
+		      void * arg ) {
+	struct CFG_PRINT * p = (struct CFG_PRINT *) arg;
+	opdis_insn_t * insn = opdis_insn_vec_find( p->vec, block->vma );
+	const opdis_cfg_edge_t * e;
+	unsigned int i;
+
+	p->rv += fprintf( p->f, "<block id=\"%lu\">\n  <vma>",
+			  (unsigned long) (block - cfg->blocks) );
+	FPRINTF_ADDR( p->rv, p->f, block->vma );
+	p->rv += fprintf( p->f, "</vma>\n  <size>%lu</size>\n",
+			  (unsigned long) block->size );
+	if ( block->func != OPDIS_CFG_NONE ) {
+		p->rv += fprintf( p->f, "  <function>%u</function>\n",
+				  block->func );
+	}
+
+	p->rv += fprintf( p->f, "  <successors>\n" );
+	for ( i = 0; (e = opdis_cfg_succ( cfg, block, i )); i++ ) {
+		p->rv += fprintf( p->f, "    <edge type=\"%s\">%u</edge>\n",
+				  edge_type_str( e->type ), e->dest );
+	}
+	p->rv += fprintf( p->f, "  </successors>\n  <predecessors>\n" );
+	for ( i = 0; (e = opdis_cfg_pred( cfg, block, i )); i++ ) {
+		p->rv += fprintf( p->f, "    <edge type=\"%s\">%u</edge>\n",
+				  edge_type_str( e->type ), e->src );
+	}
+	p->rv += fprintf( p->f, "  </predecessors>\n" );
+
+	for ( i = 0; insn && i < block->num_insns; i++ ) {
+		p->rv += asm_fprintf_insn( p->f, asmfmt_xml, NULL, insn );
+		insn = opdis_insn_vec_next( p->vec, insn->vma );
+	}
+	p->rv += fprintf( p->f, "</block>\n" );
+
+	return 1;
+}
+
+static int xml_cfg( FILE * f, opdis_cfg_t cfg, opdis_insn_vec_t vec ) {
+	struct CFG_PRINT p = { f, vec, 0 };
+	size_t i;
+
+	p.rv += fprintf( f, "<?xml version=\"1.0\"?>\n<cfg>\n" );
+
+	for ( i = 0; i < cfg->num_funcs; i++ ) {
+		const opdis_cfg_func_t * func = &cfg->funcs[i];
+		if (! func->num_blocks ) {
+			continue;
+		}
+
+		p.rv += fprintf( f, "<function id=\"%lu\">\n  <vma>",
+				 (unsigned long) i );
+		FPRINTF_ADDR( p.rv, f, func->vma );
+		p.rv += fprintf( f, "</vma>\n" );
+		if ( func->name ) {
+			p.rv += fprintf( f, "  <name>%s</name>\n", func->name );
+		}
+		p.rv += fprintf( f, "  <entry>%u</entry>\n", func->entry );
+		p.rv += fprintf( f, "</function>\n" );
+	}
+
+	opdis_cfg_foreach_block( cfg, xml_block, &p );
+
+	p.rv += fprintf( f, "</cfg>\n" );
+	return p.rv;
+}
+
+int asm_fprintf_cfg( FILE * f, enum cfg_format_t fmt, opdis_cfg_t cfg,
+		     opdis_insn_vec_t vec ) {
+	int rv = 0;
+
+	opdis_cfg_build( cfg );
+	switch (fmt) {
+		case cfgfmt_dot:
+			rv = dot_cfg( f, cfg, vec ); break;
+		case cfgfmt_xml:
+			rv = xml_cfg( f, cfg, vec ); break;
+		case cfgfmt_none:
+			break;
 	}
 	return rv;
 }
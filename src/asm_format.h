@@ -10,6 +10,8 @@
 
 #include <stdio.h>
 
+#include <opdis/cfg.h>
+#include <opdis/insn_vec.h>
 #include <opdis/model.h>
 
 enum asm_format_t {
@@ -17,13 +19,41 @@ enum asm_format_t {
 	asmfmt_asm,
 	asmfmt_dump,
 	asmfmt_delim,
-	asmfmt_xml
+	asmfmt_xml,
+	asmfmt_bin
 };
 
+enum cfg_format_t {
+	cfgfmt_none,
+	cfgfmt_dot,
+	cfgfmt_xml
+};
+
+/* a custom format string compiled to a list of ops. the program owns the
+ * buffer each insn is printed into, so it must not be shared by threads. */
+typedef struct ASM_FMT_PROG * asm_fmt_t;
+
+/* compile a custom format string; returns NULL on allocation failure */
+asm_fmt_t asm_fmt_compile( const char * fmt_str );
+
+void asm_fmt_free( asm_fmt_t );
+
+/* print insn with a compiled custom format */
+int asm_fprintf_custom( FILE * f, asm_fmt_t fmt_prog, 
+			const opdis_insn_t * insn );
+
 int asm_fprintf_header( FILE * f, enum asm_format_t fmt );
 
 int asm_fprintf_footer( FILE * f, enum asm_format_t fmt );
 
-int asm_fprintf_insn( FILE * f, enum asm_format_t fmt, const char * fmt_str, 
+/* fmt_prog is only used, and must be set, if fmt is asmfmt_custom */
+int asm_fprintf_insn( FILE * f, enum asm_format_t fmt, asm_fmt_t fmt_prog, 
 		      opdis_insn_t * insn );
+
+/* write the insns of vec as a columnar binary file (see opdis/insn_cols.h) */
+int asm_fwrite_bin( FILE * f, opdis_insn_vec_t vec );
+
+/* print the blocks of a control flow graph, with their insns from vec */
+int asm_fprintf_cfg( FILE * f, enum cfg_format_t fmt, opdis_cfg_t cfg,
+		     opdis_insn_vec_t vec );
 #endif
@@ -0,0 +1,613 @@
+/* db.c
+ * On-disk disassembly database
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/insn_rec.h>
+#include <opdis/x86_native.h>
+
+#include "db.h"
+
+#define DB_MAGIC "OPDISDB"
+#define DB_VERSION 2
+
+/* file header: the record sizes guard against a different record layout */
+struct DB_FILE_HDR {
+	char magic[8];
+	uint32_t version;
+	uint32_t num_sections;
+	uint32_t insn_rec_size;
+	uint32_t op_rec_size;
+};
+
+/* section header: followed by rec_bytes of packed insns, num_insns
+ * visited VMAs, and num_targets branch targets */
+struct DB_SECTION_HDR {
+	uint64_t target_hash;
+	uint64_t bytes_hash;
+	uint64_t config_hash;
+	uint64_t vma;
+	uint64_t size;
+	char name[DB_NAME_LEN];
+	uint32_t flags;
+	uint32_t num_insns;
+	uint32_t num_targets;
+	uint32_t reserved;
+	uint64_t rec_bytes;
+};
+
+db_t db_alloc( void ) {
+	return (db_t) calloc( 1, sizeof(struct DB_HEAD) );
+}
+
+static void free_section( db_section_t * sec ) {
+	free( sec->recs );
+	free( sec->visited );
+	free( sec->targets );
+	free( sec );
+}
+
+static void clear_db( db_t db ) {
+	db_section_t * sec, * next;
+
+	for ( sec = db->head; sec; sec = next ) {
+		next = sec->next;
+		free_section( sec );
+	}
+
+	db->head = NULL;
+	db->num = 0;
+}
+
+void db_free( db_t db ) {
+	if (! db ) {
+		return;
+	}
+
+	clear_db( db );
+	free( db->linear );
+	free( db );
+}
+
+uint64_t db_hash( const void * buf, size_t len ) {
+	const unsigned char * b = (const unsigned char *) buf;
+	uint64_t h = 14695981039346656037ULL;
+	size_t i;
+
+	for ( i = 0; i < len; i++ ) {
+		h = ( h ^ b[i] ) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+uint64_t db_config_hash( opdis_t o ) {
+	const char * opts = o->config.disassembler_options;
+	uint64_t h;
+	struct {
+		uint64_t mach;
+		uint32_t arch;
+		uint32_t syntax;
+		uint32_t decode_mask;
+		uint32_t native;
+	} key;
+
+	/* hash values rather than pointers, which differ between runs */
+	memset( &key, 0, sizeof(key) );
+	key.mach = o->config.mach;
+	key.arch = o->config.arch;
+	key.syntax = opdis_get_x86_syntax( o );
+	key.decode_mask = o->decode_mask;
+	key.native = ( o->decoder == opdis_x86_native_decoder );
+
+	h = db_hash( &key, sizeof(key) );
+	for ( ; opts && *opts; opts++ ) {
+		h = ( h ^ (unsigned char) *opts ) * 1099511628211ULL;
+	}
+
+	return h;
+}
+
+/* ---------------------------------------------------------------------- */
+/* FILE I/O */
+
+static void * read_array( FILE * f, size_t num, size_t size ) {
+	/* always allocate, so that an empty array is not NULL */
+	void * ptr = malloc( num * size + 8 );
+
+	if ( ptr && num && fread( ptr, size, num, f ) != num ) {
+		free( ptr );
+		return NULL;
+	}
+
+	return ptr;
+}
+
+static db_section_t * read_section( FILE * f ) {
+	struct DB_SECTION_HDR hdr;
+	db_section_t * sec;
+
+	if ( fread( &hdr, sizeof(hdr), 1, f ) != 1 ||
+	     hdr.rec_bytes % 8 || hdr.name[DB_NAME_LEN - 1] ) {
+		return NULL;
+	}
+
+	sec = (db_section_t *) calloc( 1, sizeof(db_section_t) );
+	if (! sec ) {
+		return NULL;
+	}
+
+	sec->target_hash = hdr.target_hash;
+	sec->bytes_hash = hdr.bytes_hash;
+	sec->config_hash = hdr.config_hash;
+	sec->vma = hdr.vma;
+	sec->size = hdr.size;
+	memcpy( sec->name, hdr.name, DB_NAME_LEN );
+	sec->flags = hdr.flags;
+	sec->num_insns = hdr.num_insns;
+	sec->num_targets = hdr.num_targets;
+	sec->rec_bytes = hdr.rec_bytes;
+
+	sec->recs = read_array( f, sec->rec_bytes, 1 );
+	sec->visited = (sec->recs) ? read_array( f, sec->num_insns,
+						 sizeof(opdis_vma_t) ) : NULL;
+	sec->targets = (sec->visited) ? read_array( f, sec->num_targets,
+						    sizeof(opdis_vma_t) ) : NULL;
+	if (! sec->targets ) {
+		free_section( sec );
+		return NULL;
+	}
+
+	return sec;
+}
+
+int db_load( db_t db, const char * path ) {
+	struct DB_FILE_HDR hdr;
+	db_section_t * sec, * tail = NULL;
+	unsigned int i;
+	FILE * f;
+
+	if (! db || ! path ) {
+		return 0;
+	}
+
+	f = fopen( path, "rb" );
+	if (! f ) {
+		return 0;
+	}
+
+	if ( fread( &hdr, sizeof(hdr), 1, f ) != 1 ||
+	     memcmp( hdr.magic, DB_MAGIC, sizeof(DB_MAGIC) ) ||
+	     hdr.version != DB_VERSION ||
+	     hdr.insn_rec_size != sizeof(opdis_insn_rec_t) ||
+	     hdr.op_rec_size != sizeof(opdis_op_rec_t) ) {
+		fprintf( stderr, "WARNING: '%s' is not a compatible opdis "
+			 "database; starting a new one\n", path );
+		fclose( f );
+		return 0;
+	}
+
+	for ( i = 0; i < hdr.num_sections; i++ ) {
+		sec = read_section( f );
+		if (! sec ) {
+			fprintf( stderr, "WARNING: database '%s' is truncated; "
+				 "starting a new one\n", path );
+			clear_db( db );
+			fclose( f );
+			return 0;
+		}
+
+		if ( tail ) {
+			tail->next = sec;
+		} else {
+			db->head = sec;
+		}
+		tail = sec;
+		db->num++;
+	}
+
+	fclose( f );
+	return 1;
+}
+
+static int write_section( FILE * f, const db_section_t * sec ) {
+	struct DB_SECTION_HDR hdr;
+
+	memset( &hdr, 0, sizeof(hdr) );
+	hdr.target_hash = sec->target_hash;
+	hdr.bytes_hash = sec->bytes_hash;
+	hdr.config_hash = sec->config_hash;
+	hdr.vma = sec->vma;
+	hdr.size = sec->size;
+	memcpy( hdr.name, sec->name, DB_NAME_LEN );
+	hdr.flags = sec->flags;
+	hdr.num_insns = sec->num_insns;
+	hdr.num_targets = sec->num_targets;
+	hdr.rec_bytes = sec->rec_bytes;
+
+	return ( fwrite( &hdr, sizeof(hdr), 1, f ) == 1 &&
+		 fwrite( sec->recs, 1, sec->rec_bytes, f ) == sec->rec_bytes &&
+		 fwrite( sec->visited, sizeof(opdis_vma_t), sec->num_insns, f )
+		 == sec->num_insns &&
+		 fwrite( sec->targets, sizeof(opdis_vma_t), sec->num_targets, f )
+		 == sec->num_targets );
+}
+
+int db_save( db_t db, const char * path ) {
+	struct DB_FILE_HDR hdr;
+	db_section_t * sec;
+	char * tmp;
+	int ok;
+	FILE * f;
+
+	if (! db || ! path ) {
+		return 0;
+	}
+
+	/* write to a temporary file, so an interrupted run keeps the old db */
+	tmp = (char *) malloc( strlen(path) + 5 );
+	if (! tmp ) {
+		return 0;
+	}
+	sprintf( tmp, "%s.tmp", path );
+
+	f = fopen( tmp, "wb" );
+	if (! f ) {
+		fprintf( stderr, "Unable to open '%s' for writing: %s\n", tmp,
+			 strerror(errno) );
+		free( tmp );
+		return 0;
+	}
+
+	memset( &hdr, 0, sizeof(hdr) );
+	memcpy( hdr.magic, DB_MAGIC, sizeof(DB_MAGIC) );
+	hdr.version = DB_VERSION;
+	hdr.num_sections = db->num;
+	hdr.insn_rec_size = sizeof(opdis_insn_rec_t);
+	hdr.op_rec_size = sizeof(opdis_op_rec_t);
+
+	ok = ( fwrite( &hdr, sizeof(hdr), 1, f ) == 1 );
+	for ( sec = db->head; ok && sec; sec = sec->next ) {
+		ok = write_section( f, sec );
+	}
+
+	ok = ( fclose( f ) == 0 ) && ok;
+	if ( ok && rename( tmp, path ) ) {
+		ok = 0;
+	}
+	if (! ok ) {
+		fprintf( stderr, "Unable to write database '%s': %s\n", path,
+			 strerror(errno) );
+		remove( tmp );
+	}
+
+	free( tmp );
+	return ok;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SECTIONS */
+
+struct SECTION_ITER {
+	tgt_list_item_t * tgt;
+	DB_SECTION_FN fn;
+	void * arg;
+};
+
+static void bfd_code_section( bfd * abfd, asection * s, void * arg ) {
+	struct SECTION_ITER * it = (struct SECTION_ITER *) arg;
+	opdis_buf_t img = it->tgt->data;
+	bfd_size_type size = bfd_section_size( abfd, s );
+	opdis_byte_t * bytes;
+
+	if (! (bfd_get_section_flags( abfd, s ) & SEC_CODE) ||
+	    ! (bfd_get_section_flags( abfd, s ) & SEC_HAS_CONTENTS) ||
+	    ! size || strlen( s->name ) >= DB_NAME_LEN ) {
+		return;
+	}
+
+	/* sections are read from the file image when possible */
+	if ( img && s->filepos >= 0 && ! bfd_my_archive(abfd) &&
+	     (opdis_off_t) s->filepos <= img->len &&
+	     size <= img->len - s->filepos ) {
+		it->fn( it->tgt, s->name, bfd_section_vma( abfd, s ),
+			&img->data[s->filepos], size, it->arg );
+		return;
+	}
+
+	bytes = (opdis_byte_t *) malloc( size );
+	if ( bytes && bfd_get_section_contents( abfd, s, bytes, 0, size ) ) {
+		it->fn( it->tgt, s->name, bfd_section_vma( abfd, s ), bytes,
+			size, it->arg );
+	}
+	free( bytes );
+}
+
+void db_foreach_section( tgt_list_item_t * tgt, DB_SECTION_FN fn, void * arg){
+	struct SECTION_ITER it = { tgt, fn, arg };
+
+	if (! tgt || ! fn ) {
+		return;
+	}
+
+	if ( tgt->tgt_bfd ) {
+		bfd_map_over_sections( tgt->tgt_bfd, bfd_code_section, &it );
+	} else if ( tgt->data ) {
+		fn( tgt, "", tgt->data->vma, tgt->data->data, tgt->data->len,
+		    arg );
+	}
+}
+
+db_section_t * db_find( db_t db, uint64_t target_hash, const char * name ) {
+	db_section_t * sec;
+
+	if (! db || ! name ) {
+		return NULL;
+	}
+
+	for ( sec = db->head; sec; sec = sec->next ) {
+		if ( sec->target_hash == target_hash &&
+		     ! strcmp( sec->name, name ) ) {
+			return sec;
+		}
+	}
+
+	return NULL;
+}
+
+/* the first insn of vec at or after vma */
+static opdis_insn_t * first_insn( opdis_insn_vec_t vec, opdis_vma_t vma ) {
+	opdis_insn_t * insn = opdis_insn_vec_find( vec, vma );
+	return ( insn ) ? insn : opdis_insn_vec_next( vec, vma );
+}
+
+static int fill_section( db_section_t * sec, opdis_insn_vec_t vec,
+			 opdis_t o ) {
+	opdis_vma_t end = sec->vma + sec->size;
+	opdis_insn_t * insn;
+	size_t pos = 0, num = 0, num_tgt = 0;
+	unsigned char * recs;
+
+	/* size the arrays before packing */
+	for ( insn = first_insn( vec, sec->vma ); insn && insn->vma < end;
+	      insn = opdis_insn_vec_next( vec, insn->vma ) ) {
+		pos += opdis_insn_rec_size( insn );
+		num++;
+		num_tgt += opdis_insn_is_branch( insn );
+	}
+
+	sec->recs = recs = (unsigned char *) malloc( pos + 8 );
+	sec->visited = (opdis_vma_t *) malloc( (num + 1) *
+					       sizeof(opdis_vma_t) );
+	sec->targets = (opdis_vma_t *) malloc( (num_tgt + 1) *
+					       sizeof(opdis_vma_t) );
+	if (! sec->recs || ! sec->visited || ! sec->targets ) {
+		return 0;
+	}
+
+	sec->rec_bytes = pos;
+	for ( insn = first_insn( vec, sec->vma ), pos = 0;
+	      insn && insn->vma < end;
+	      insn = opdis_insn_vec_next( vec, insn->vma ) ) {
+		pos += opdis_insn_pack( insn, &recs[pos], sec->rec_bytes - pos );
+		sec->visited[sec->num_insns++] = insn->vma;
+
+		if ( opdis_insn_is_branch( insn ) ) {
+			opdis_vma_t tgt = o->resolver( insn, o->resolver_arg );
+			if ( tgt != OPDIS_INVALID_ADDR ) {
+				sec->targets[sec->num_targets++] = tgt;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int linear_in_section( db_t db, const db_section_t * sec ) {
+	db_section_t * old = db_find( db, sec->target_hash, sec->name );
+	unsigned int i;
+
+	if ( old && old->restored && (old->flags & DB_SEC_LINEAR) ) {
+		return 1;
+	}
+
+	for ( i = 0; i < db->num_linear; i++ ) {
+		if ( db->linear[i].target_hash == sec->target_hash &&
+		     db->linear[i].vma >= sec->vma &&
+		     db->linear[i].vma < sec->vma + sec->size ) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+db_section_t * db_store( db_t db, uint64_t target_hash, const char * name,
+			 opdis_vma_t vma, opdis_off_t size, uint64_t bytes_hash,
+			 opdis_insn_vec_t vec, opdis_t o ) {
+	db_section_t * sec, ** prev;
+
+	if (! db || ! name || strlen( name ) >= DB_NAME_LEN || ! vec || ! o ) {
+		return NULL;
+	}
+
+	sec = (db_section_t *) calloc( 1, sizeof(db_section_t) );
+	if (! sec ) {
+		return NULL;
+	}
+
+	sec->target_hash = target_hash;
+	sec->bytes_hash = bytes_hash;
+	sec->config_hash = db_config_hash( o );
+	sec->vma = vma;
+	sec->size = size;
+	strcpy( sec->name, name );
+	if ( linear_in_section( db, sec ) ) {
+		sec->flags |= DB_SEC_LINEAR;
+	}
+
+	if (! fill_section( sec, vec, o ) ) {
+		fprintf( stderr, "Unable to store section '%s' in database\n",
+			 name );
+		free_section( sec );
+		return NULL;
+	}
+
+	/* replace the stored version of the section */
+	for ( prev = &db->head; *prev; prev = &(*prev)->next ) {
+		if ( (*prev)->target_hash == target_hash &&
+		     ! strcmp( (*prev)->name, name ) ) {
+			db_section_t * old = *prev;
+			sec->next = old->next;
+			*prev = sec;
+			free_section( old );
+			return sec;
+		}
+	}
+
+	*prev = sec;
+	db->num++;
+	return sec;
+}
+
+int db_restore( db_section_t * sec, opdis_t o ) {
+	const unsigned char * pos, * end;
+	unsigned int count = 0;
+
+	if (! sec || ! o ) {
+		return 0;
+	}
+
+	pos = (const unsigned char *) sec->recs;
+	end = pos + sec->rec_bytes;
+	while ( pos < end && count < sec->num_insns ) {
+		const opdis_insn_rec_t * rec = (const opdis_insn_rec_t *) pos;
+		opdis_insn_t * insn;
+
+		if ( end - pos < (long) sizeof(opdis_insn_rec_t) ||
+		     rec->rec_size < sizeof(opdis_insn_rec_t) ||
+		     rec->rec_size % 8 || rec->rec_size > end - pos ) {
+			fprintf( stderr, "Corrupt insn record in database\n" );
+			break;
+		}
+
+		insn = opdis_insn_unpack( rec );
+		if ( insn ) {
+			o->display( insn, o->display_arg );
+			opdis_insn_free( insn );
+			count++;
+		}
+		pos += rec->rec_size;
+	}
+
+	/* a section without insns was not analyzed, so it is not restored */
+	sec->restored = ( count && count == sec->num_insns );
+	return count;
+}
+
+static int cmp_vma( const void * a, const void * b ) {
+	opdis_vma_t va = *(const opdis_vma_t *) a;
+	opdis_vma_t vb = *(const opdis_vma_t *) b;
+
+	return ( va < vb ) ? -1 : ( va > vb );
+}
+
+int db_restored( db_t db, uint64_t target_hash, opdis_vma_t vma, int insn ) {
+	db_section_t * sec;
+
+	if (! db ) {
+		return 0;
+	}
+
+	for ( sec = db->head; sec; sec = sec->next ) {
+		if (! sec->restored || sec->target_hash != target_hash ||
+		    vma < sec->vma || vma >= sec->vma + sec->size ) {
+			continue;
+		}
+
+		return (! insn ) ||
+		       bsearch( &vma, sec->visited, sec->num_insns,
+				sizeof(opdis_vma_t), cmp_vma ) != NULL;
+	}
+
+	return 0;
+}
+
+int db_section_restored( db_t db, uint64_t target_hash, const char * name ) {
+	db_section_t * sec = db_find( db, target_hash, name );
+	return ( sec && sec->restored && (sec->flags & DB_SEC_LINEAR) );
+}
+
+int db_note_linear( db_t db, uint64_t target_hash, opdis_vma_t vma ) {
+	if (! db ) {
+		return 0;
+	}
+
+	if ( db->num_linear == db->alloc_linear ) {
+		unsigned int alloc = ( db->alloc_linear ) ?
+				     db->alloc_linear * 2 : 16;
+		void * ptr = realloc( db->linear,
+				      alloc * sizeof(struct DB_LINEAR) );
+		if (! ptr ) {
+			return 0;
+		}
+		db->linear = (struct DB_LINEAR *) ptr;
+		db->alloc_linear = alloc;
+	}
+
+	db->linear[db->num_linear].target_hash = target_hash;
+	db->linear[db->num_linear].vma = vma;
+	db->num_linear++;
+
+	return 1;
+}
+
+/* return 1 if vma is in a stored section of target which was not restored */
+static int in_changed_section( db_t db, uint64_t target_hash,
+			       opdis_vma_t vma ) {
+	db_section_t * sec;
+
+	for ( sec = db->head; sec; sec = sec->next ) {
+		if ( sec->target_hash == target_hash && vma >= sec->vma &&
+		     vma < sec->vma + sec->size ) {
+			return (! sec->restored );
+		}
+	}
+
+	return 0;
+}
+
+void db_foreach_frontier( db_t db, uint64_t target_hash, DB_FRONTIER_FN fn,
+			  void * arg ) {
+	opdis_visited_t seen;
+	db_section_t * sec;
+	unsigned int i;
+
+	if (! db || ! fn ) {
+		return;
+	}
+
+	seen = opdis_visited_init_tree();
+	for ( sec = db->head; sec; sec = sec->next ) {
+		if ( sec->target_hash != target_hash || ! sec->restored ) {
+			continue;
+		}
+
+		for ( i = 0; i < sec->num_targets; i++ ) {
+			opdis_vma_t vma = sec->targets[i];
+			if ( in_changed_section( db, target_hash, vma ) &&
+			     opdis_visited_add( seen, vma ) ) {
+				fn( vma, arg );
+			}
+		}
+	}
+	opdis_visited_free( seen );
+}
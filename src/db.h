@@ -0,0 +1,133 @@
+/* db.h
+ * On-disk disassembly database
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_DB_H
+#define OPDIS_DB_H
+
+#include <stdint.h>
+
+#include <opdis/opdis.h>
+#include <opdis/insn_vec.h>
+
+#include "target_list.h"
+
+/* The database stores, for each code section of each target, a hash of the
+ * section contents, the disassembled instructions (as packed records), the
+ * VMAs which were visited, and the branch targets which were discovered.
+ * A later run restores the instructions of every section whose contents
+ * and disassembler configuration (architecture, syntax, disassembler
+ * options and decoder) have not changed instead of disassembling it again.
+ *
+ * NOTE: records are stored in host byte order; a database is not portable
+ *       between hosts or builds with a different insn record layout. */
+
+#define DB_NAME_LEN 64
+
+/* section flags */
+#define DB_SEC_LINEAR 1		/* a linear job covered the section */
+
+typedef struct DB_SECTION {
+	uint64_t target_hash;		/* hash of target name */
+	uint64_t bytes_hash;		/* hash of section contents */
+	uint64_t config_hash;		/* hash of disassembler config */
+	opdis_vma_t vma;		/* load address of section */
+	opdis_off_t size;		/* size of section */
+	char name[DB_NAME_LEN];		/* BFD section name, or "" */
+	unsigned int flags;		/* DB_SEC_ flags */
+
+	unsigned int num_insns;
+	void * recs;			/* packed insns, in order of VMA */
+	size_t rec_bytes;		/* total size of recs */
+	opdis_vma_t * visited;		/* VMA of each insn, sorted */
+	unsigned int num_targets;
+	opdis_vma_t * targets;		/* resolved branch targets */
+
+	int restored;			/* contents unchanged in this run */
+	struct DB_SECTION * next;
+} db_section_t;
+
+/* start of a linear job in this run */
+struct DB_LINEAR {
+	uint64_t target_hash;
+	opdis_vma_t vma;
+};
+
+typedef struct DB_HEAD {
+	unsigned int num;
+	db_section_t * head;
+	struct DB_LINEAR * linear;
+	unsigned int num_linear, alloc_linear;
+} * db_t;
+
+/* callback for each branch target which resumes disassembly */
+typedef void (*DB_FRONTIER_FN) ( opdis_vma_t vma, void * arg );
+
+/* callback for each code section of a target */
+typedef void (*DB_SECTION_FN) ( tgt_list_item_t * tgt, const char * name,
+				opdis_vma_t vma, const opdis_byte_t * bytes,
+				opdis_off_t size, void * arg );
+
+/* ---------------------------------------------------------------------- */
+
+/* allocate an empty database */
+db_t db_alloc( void );
+
+/* free a database */
+void db_free( db_t );
+
+/* load a database from a file. returns 0 if the file does not exist or is
+ * not a valid database; db is then left empty */
+int db_load( db_t, const char * path );
+
+/* write a database to a file */
+int db_save( db_t, const char * path );
+
+/* 64-bit FNV-1a hash of len bytes */
+uint64_t db_hash( const void * buf, size_t len );
+
+/* hash of the configuration of o which stored insns depend on */
+uint64_t db_config_hash( opdis_t o );
+
+/* invoke callback for every code section of target. A target without a BFD
+ * is a single unnamed section */
+void db_foreach_section( tgt_list_item_t * tgt, DB_SECTION_FN fn, void * arg);
+
+/* find the stored section 'name' of a target */
+db_section_t * db_find( db_t, uint64_t target_hash, const char * name );
+
+/* store the insns of vec which lie in a section; branch targets are
+ * resolved with the resolver of o, and the section is keyed on the
+ * configuration of o. This replaces any stored section with
+ * the same target and name. The section is flagged DB_SEC_LINEAR if a
+ * linear job started in it, or if it was restored with the flag */
+db_section_t * db_store( db_t, uint64_t target_hash, const char * name,
+			 opdis_vma_t vma, opdis_off_t size, uint64_t bytes_hash,
+			 opdis_insn_vec_t vec, opdis_t o );
+
+/* pass every stored insn of section to the display callback of o, and mark
+ * the section as restored. returns the number of insns restored */
+int db_restore( db_section_t * sec, opdis_t o );
+
+/* return 1 if vma is in a restored section of target. If 'insn' is set,
+ * vma must also be the address of a stored insn */
+int db_restored( db_t, uint64_t target_hash, opdis_vma_t vma, int insn );
+
+/* return 1 if 'name' is a restored section of target which was covered by
+ * a linear job */
+int db_section_restored( db_t, uint64_t target_hash, const char * name );
+
+/* record that a linear job of this run starts at vma */
+int db_note_linear( db_t, uint64_t target_hash, opdis_vma_t vma );
+
+/* invoke callback once for every branch target of a restored section which
+ * lies in a stored section that was not restored, i.e. whose contents have
+ * changed. Control flow disassembly resumes from these addresses */
+void db_foreach_frontier( db_t, uint64_t target_hash, DB_FRONTIER_FN fn,
+			  void * arg );
+
+#endif
@@ -7,6 +7,13 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include <opdis/arena.h>
 
 #include "job_list.h"
 
@@ -25,6 +32,9 @@ void job_list_free( job_list_t jobs ) {
 
 	for ( item = jobs->head; item; item = next ) {
 		next = item->next;
+		if ( item->bfd_opdis ) {
+			opdis_term( item->bfd_opdis );
+		}
 		free( item );
 	}
 
@@ -148,8 +158,27 @@ static int check_bfd_job( job_opts_t o, tgt_list_item_t * tgt ) {
 	return 1;
 }
 
-static opdis_t opdis_for_bfd( bfd * abfd, opdis_t orig ) {
-	opdis_t o = opdis_init_from_bfd( abfd );
+/* create the disassembler of a BFD job. This calls into BFD, so it is done
+ * by prepare_job rather than by the thread running the job */
+static opdis_t opdis_for_bfd( tgt_list_item_t * tgt ) {
+	opdis_t o = opdis_init_from_bfd( tgt->tgt_bfd );
+
+	/* disassemble sections in place from the (mapped) target file */
+	opdis_set_bfd_image( o, tgt->tgt_bfd, tgt->data );
+	opdis_set_sec_cache( o, tgt->sec_cache );
+
+	return o;
+}
+
+/* configure the disassembler of a BFD job like orig, the opdis running the
+ * job. Each job has its own, so this is safe in a worker thread */
+static opdis_t bfd_job_opdis( job_list_item_t * job, opdis_t orig ) {
+	opdis_t o = job->bfd_opdis;
+
+	if (! o ) {
+		fprintf( stderr, "No disassembler created for BFD job\n" );
+		return NULL;
+	}
 
 	o->error_reporter = orig->error_reporter;
 	o->error_reporter_arg = orig->error_reporter_arg;
@@ -163,17 +192,27 @@ static opdis_t opdis_for_bfd( bfd * abfd, opdis_t orig ) {
 	o->resolver_arg = (orig->resolver_arg) == orig ? o : orig->resolver_arg;
 	o->debug = orig->debug;
 	o->visited_addr = orig->visited_addr;
+	o->cfg = orig->cfg;
+	o->stats = orig->stats;
+	o->decode_mask = orig->decode_mask;
+	o->borrow_bytes = orig->borrow_bytes;
 
 	/* if user has overridden syntax or decoder, defer to it */
 	if ( orig->config.arch == o->config.arch ) {
 		if ( orig->disassembler != o->disassembler ) {
 			o->disassembler = orig->disassembler;
 		}
-		if ( orig->decoder != o->decoder ) {
-			opdis_set_decoder(o, orig->decoder, orig->decoder_arg);
+		if ( orig->decoder != o->decoder ||
+		     orig->decoder_arg != o->decoder_arg ) {
+			opdis_set_decoder( o, orig->decoder,
+				(orig->decoder_arg == orig) ? o :
+				orig->decoder_arg );
 		}
 	}
 
+	/* last, as this also updates the cache key for the fields above */
+	opdis_set_decode_cache( o, orig->decode_cache );
+
 	return o;
 }
 
@@ -186,14 +225,16 @@ static int bfd_cflow_job( job_list_item_t * job, tgt_list_item_t * tgt,
 	}
 
 	if (! o->quiet ) {
-		printf( "Control Flow disassembly of " );
+		fprintf( o->msg, "Control Flow disassembly of " );
 		if ( vma ) {
-			printf( "%p\n", (void *) vma );
+			fprintf( o->msg, "%p\n", (void *) vma );
 		} else {
-			printf( "0x0\n" );
+			fprintf( o->msg, "0x0\n" );
 		}
 	}
 
+	opdis_set_bfd_image( o->opdis, tgt->tgt_bfd, tgt->data );
+	opdis_set_sec_cache( o->opdis, tgt->sec_cache );
 	return opdis_disasm_bfd_cflow( o->opdis, tgt->tgt_bfd, vma );
 }
 
@@ -206,14 +247,16 @@ static int bfd_linear_job( job_list_item_t * job, tgt_list_item_t * tgt,
 	}
 
 	if (! o->quiet ) {
-		printf( "Linear disassembly of " );
+		fprintf( o->msg, "Linear disassembly of " );
 		if ( vma ) {
-			printf( "%p\n", (void *) vma );
+			fprintf( o->msg, "%p\n", (void *) vma );
 		} else {
-			printf( "0x0\n" );
+			fprintf( o->msg, "0x0\n" );
 		}
 	}
 
+	opdis_set_bfd_image( o->opdis, tgt->tgt_bfd, tgt->data );
+	opdis_set_sec_cache( o->opdis, tgt->sec_cache );
 	return opdis_disasm_bfd_linear(o->opdis, tgt->tgt_bfd, vma, job->size);
 }
 
@@ -225,7 +268,10 @@ static int bfd_symbol_job( job_list_item_t * job, tgt_list_item_t * tgt,
 		return 0;
 	}
 
-	opdis = opdis_for_bfd( tgt->tgt_bfd, o->opdis );
+	opdis = bfd_job_opdis( job, o->opdis );
+	if (! opdis ) {
+		return 0;
+	}
 
 	vma = sym_tab_find_vma( tgt->symtab, job->bfd_name );
 	if ( vma == OPDIS_INVALID_ADDR ) {
@@ -235,9 +281,12 @@ static int bfd_symbol_job( job_list_item_t * job, tgt_list_item_t * tgt,
 	}
 
 	if (! o->quiet ) {
-		printf( "Control Flow disassembly of symbol %s\n", 
+		fprintf( o->msg, "Control Flow disassembly of symbol %s\n", 
 			 job->bfd_name );
 	}
+	if ( opdis->cfg ) {
+		opdis_cfg_add_func( opdis->cfg, vma, job->bfd_name );
+	}
 	return opdis_disasm_bfd_cflow( opdis, tgt->tgt_bfd, vma );
 }
 
@@ -248,9 +297,12 @@ static int bfd_section_job( job_list_item_t * job, tgt_list_item_t * tgt,
 	if (! check_bfd_job(o, tgt) ) {
 		return 0;
 	}
-	opdis = opdis_for_bfd( tgt->tgt_bfd, o->opdis );
+	opdis = bfd_job_opdis( job, o->opdis );
+	if (! opdis ) {
+		return 0;
+	}
 
-	section = bfd_get_section_by_name( tgt->tgt_bfd, job->bfd_name );
+	section = job->section;
 	if (! section ) {
 		fprintf( stderr, "Cannot find BFD section %s\n",
 			 job->bfd_name );
@@ -258,9 +310,11 @@ static int bfd_section_job( job_list_item_t * job, tgt_list_item_t * tgt,
 	}
 
 	if (! o->quiet ) {
-		printf( "Linear disassembly of section %s\n", job->bfd_name );
+		fprintf( o->msg, "Linear disassembly of section %s\n",
+			 job->bfd_name );
 	}
-	return opdis_disasm_bfd_section( opdis, section );
+	return opdis_disasm_bfd_section_parallel( opdis, section, 
+						  o->num_threads );
 }
 
 static int bfd_entry_job( job_list_item_t * job, tgt_list_item_t * tgt, 
@@ -269,48 +323,168 @@ static int bfd_entry_job( job_list_item_t * job, tgt_list_item_t * tgt,
 	if (! check_bfd_job(o, tgt) ) {
 		return 0;
 	}
-	opdis = opdis_for_bfd( tgt->tgt_bfd, o->opdis );
+	opdis = bfd_job_opdis( job, o->opdis );
+	if (! opdis ) {
+		return 0;
+	}
 	return opdis_disasm_bfd_entry( opdis, tgt->tgt_bfd );
 }
 
+struct PROGRAM_SEEDS {
+	opdis_cfg_t cfg;
+	opdis_vma_t * vmas;
+	size_t num, alloc;
+};
+
+static void add_program_seed( const char * name, opdis_vma_t vma, void * arg ){
+	struct PROGRAM_SEEDS * seeds = (struct PROGRAM_SEEDS *) arg;
+
+	if ( seeds->num == seeds->alloc ) {
+		size_t alloc = ( seeds->alloc ) ? seeds->alloc * 2 : 256;
+		void * ptr = realloc( seeds->vmas, alloc * sizeof(opdis_vma_t) );
+		if (! ptr ) {
+			fprintf( stderr, "Unable to add symbol %s\n", name );
+			return;
+		}
+		seeds->vmas = (opdis_vma_t *) ptr;
+		seeds->alloc = alloc;
+	}
+
+	seeds->vmas[seeds->num++] = vma;
+	if ( seeds->cfg ) {
+		opdis_cfg_add_func( seeds->cfg, vma, name );
+	}
+}
+
+static int bfd_program_job( job_list_item_t * job, tgt_list_item_t * tgt, 
+			    job_opts_t o ) {
+	struct PROGRAM_SEEDS seeds = { NULL, NULL, 0, 0 };
+	opdis_t opdis;
+	int rv;
+	if (! check_bfd_job(o, tgt) ) {
+		return 0;
+	}
+	opdis = bfd_job_opdis( job, o->opdis );
+	if (! opdis ) {
+		return 0;
+	}
+
+	seeds.cfg = opdis->cfg;
+	sym_tab_foreach_func( tgt->symtab, add_program_seed, &seeds );
+
+	if (! o->quiet ) {
+		fprintf( o->msg, "Control Flow disassembly of entry point and "
+			 "%u function symbols\n", (unsigned int) seeds.num );
+	}
+	rv = opdis_disasm_bfd_program( opdis, tgt->tgt_bfd, seeds.vmas, 
+				       seeds.num );
+
+	free( seeds.vmas );
+	return rv;
+}
+
 static int linear_job( job_list_item_t * job, tgt_list_item_t * tgt, 
 		       job_opts_t o ) {
 	opdis_vma_t vma = get_job_vma( job, tgt->data );
 
-	if (! tgt->data->vma || tgt->data->vma == OPDIS_INVALID_ADDR ) {
-		set_buffer_vma( job->target, tgt->data, o->map );
-	}
-
 	if (! o->quiet ) {
-		printf( "Linear disassembly of " );
+		fprintf( o->msg, "Linear disassembly of " );
 		if ( vma ) {
-			printf( "%p\n", (void *) vma );
+			fprintf( o->msg, "%p\n", (void *) vma );
 		} else {
-			printf( "0x0\n" );
+			fprintf( o->msg, "0x0\n" );
 		}
 	}
-	return opdis_disasm_linear( o->opdis, tgt->data, vma, job->size );
+	return opdis_disasm_linear_parallel( o->opdis, tgt->data, vma, 
+					     job->size, o->num_threads );
 }
 
 static int cflow_job( job_list_item_t * job, tgt_list_item_t * tgt, 
 		      job_opts_t o ) {
 	opdis_vma_t vma = get_job_vma( job, tgt->data );
 
-	if (! tgt->data->vma || tgt->data->vma == OPDIS_INVALID_ADDR ) {
-		set_buffer_vma( job->target, tgt->data, o->map );
-	}
-
 	if (! o->quiet ) {
-		printf( "Control Flow disassembly of " );
+		fprintf( o->msg, "Control Flow disassembly of " );
 		if ( vma ) {
-			printf( "%p\n", (void *) vma );
+			fprintf( o->msg, "%p\n", (void *) vma );
 		} else {
-			printf( "0x0\n" );
+			fprintf( o->msg, "0x0\n" );
 		}
 	}
 	return opdis_disasm_cflow( o->opdis, tgt->data, vma );
 }
 
+/* address at which a job starts, for checking against the database */
+static opdis_vma_t job_start_vma( job_list_item_t * job,
+				  tgt_list_item_t * tgt ) {
+	switch ( job->type ) {
+		case job_cflow:
+		case job_linear:
+			return ( tgt->tgt_bfd ) ? get_bfd_vma( job, tgt->tgt_bfd ) :
+						  get_job_vma( job, tgt->data );
+		case job_bfd_entry:
+		case job_bfd_program:
+			return bfd_get_start_address( tgt->tgt_bfd );
+		case job_bfd_symbol:
+			return sym_tab_find_vma( tgt->symtab, job->bfd_name );
+		default:
+			break;
+	}
+
+	return OPDIS_INVALID_ADDR;
+}
+
+/* a job is restored if its instructions were loaded from the database: a
+ * linear job if its section was covered by a linear job, a cflow job if
+ * its first insn was stored */
+static int job_restored( job_list_item_t * job, tgt_list_item_t * tgt,
+			 job_opts_t o ) {
+	uint64_t hash = db_hash( tgt->ascii, strlen(tgt->ascii) );
+	opdis_vma_t vma;
+
+	if ( job->type == job_bfd_section ) {
+		return db_section_restored( o->db, hash, job->bfd_name );
+	}
+
+	vma = job_start_vma( job, tgt );
+	if ( vma == OPDIS_INVALID_ADDR ) {
+		return 0;
+	}
+
+	if ( job->type == job_linear ) {
+		db_section_t * sec;
+		for ( sec = o->db->head; sec; sec = sec->next ) {
+			if ( sec->target_hash == hash && vma >= sec->vma &&
+			     vma < sec->vma + sec->size ) {
+				return db_section_restored( o->db, hash,
+							    sec->name );
+			}
+		}
+		return 0;
+	}
+
+	return db_restored( o->db, hash, vma, 1 );
+}
+
+/* note the start of linear jobs, so their sections are flagged as covered */
+static void db_note_job( job_list_item_t * job, tgt_list_item_t * tgt,
+			 job_opts_t o ) {
+	uint64_t hash = db_hash( tgt->ascii, strlen(tgt->ascii) );
+	opdis_vma_t vma = OPDIS_INVALID_ADDR;
+
+	if ( job->type == job_bfd_section ) {
+		if ( job->section ) {
+			vma = bfd_section_vma( tgt->tgt_bfd, job->section );
+		}
+	} else if ( job->type == job_linear ) {
+		vma = job_start_vma( job, tgt );
+	}
+
+	if ( vma != OPDIS_INVALID_ADDR ) {
+		db_note_linear( o->db, hash, vma );
+	}
+}
+
 static void decoder_check( opdis_t o ) {
 	if ( o->decoder == opdis_default_decoder ) {
 		fprintf( stderr, 
@@ -318,18 +492,19 @@ static void decoder_check( opdis_t o ) {
 	}
 }
 
-static int perform_job( job_list_item_t * job, job_opts_t o ) {
-	int rv;
+/* resolve the target and addresses of a job. This modifies the job and
+ * target, so it is always done before the job is run */
+static tgt_list_item_t * prepare_job( job_list_item_t * job, job_opts_t o ) {
 	tgt_list_item_t * target;
 
 	if (! job || ! o || ! o->targets || ! o->map ) {
-		return 0;
+		return NULL;
 	}
 
 	target = tgt_list_find( o->targets, job->target );
 	if (! target ) {
 		fprintf( stderr, "Unable to find target %d\n", job->target );
-		return 0;
+		return NULL;
 	}
 
 	/* attempt to get VMA from memory map */
@@ -338,9 +513,102 @@ static int perform_job( job_list_item_t * job, job_opts_t o ) {
 						   job->offset );
 	}
 
+	if ( (job->type == job_cflow || job->type == job_linear) &&
+	     ! target->tgt_bfd && 
+	     (! target->data->vma || target->data->vma == OPDIS_INVALID_ADDR) ){
+		set_buffer_vma( job->target, target->data, o->map );
+	}
+
 	switch (job->type) {
 		case job_cflow:
+		case job_bfd_entry:
+		case job_bfd_symbol:
+		case job_bfd_program:
 			decoder_check( o->opdis );
+			break;
+		default:
+			break;
+	}
+
+	/* make every BFD call of the job here, as workers may run it */
+	if ( target->tgt_bfd && job->type != job_cflow &&
+	     job->type != job_linear && ! job->bfd_opdis ) {
+		job->bfd_opdis = opdis_for_bfd( target );
+	}
+	if ( target->tgt_bfd && job->type == job_bfd_section ) {
+		job->section = bfd_get_section_by_name( target->tgt_bfd,
+							job->bfd_name );
+	}
+
+	if ( o->db ) {
+		db_note_job( job, target, o );
+	}
+
+	return target;
+}
+
+/* print the statistics of a job: counters, then the time in each phase */
+static void print_stats( FILE * f, job_list_item_t * job,
+			 const opdis_stats_t * s ) {
+	uint64_t total = opdis_stats_total( s );
+	unsigned int i;
+
+	fprintf( f, "Statistics for job '%s':\n", job->spec ? job->spec : "" );
+	fprintf( f, "\tInsns: %llu Bytes: %llu Invalid: %llu "
+		 "Decode errors: %llu Cache hits: %llu\n",
+		 (unsigned long long) s->insns, (unsigned long long) s->bytes,
+		 (unsigned long long) s->invalid,
+		 (unsigned long long) s->decode_errors,
+		 (unsigned long long) s->cache_hits );
+	fprintf( f, "\tDisplayed: %llu Visited hits: %llu "
+		 "Targets resolved: %llu Unresolved: %llu\n",
+		 (unsigned long long) s->displayed,
+		 (unsigned long long) s->visited_hits,
+		 (unsigned long long) s->targets_resolved,
+		 (unsigned long long) s->targets_unresolved );
+
+	for ( i = 0; i < opdis_phase_count; i++ ) {
+		fprintf( f, "\t%-8s %14llu ticks %5.1f%%\n",
+			 opdis_stats_phase_name( (enum opdis_stats_phase_t) i ),
+			 (unsigned long long) s->ticks[i],
+			 ( total ) ? 100.0 * s->ticks[i] / total : 0.0 );
+	}
+	if ( s->insns ) {
+		fprintf( f, "\t%-8s %14llu ticks (%.1f per insn)\n", "total",
+			 (unsigned long long) total,
+			 (double) total / s->insns );
+	}
+}
+
+/* print the insns of earlier jobs before a status message */
+static void sync_msg( job_opts_t o ) {
+	if ( o->pipe ) {
+		pipeline_drain( o->pipe );
+	}
+}
+
+static int run_job( job_list_item_t * job, tgt_list_item_t * target,
+		    job_opts_t o ) {
+	opdis_stats_t stats;
+	int rv = 0;
+
+	sync_msg( o );
+
+	if ( o->db && job_restored( job, target, o ) ) {
+		if (! o->quiet ) {
+			fprintf( o->msg, "Job '%s' restored from database\n",
+				 job->spec ? job->spec : "" );
+		}
+		return 1;
+	}
+
+	if ( o->stats ) {
+		opdis_stats_clear( &stats );
+		opdis_set_stats( o->opdis, &stats );
+	}
+
+	switch (job->type) {
+		case job_cflow:
 			if ( target->tgt_bfd ) {
 				rv = bfd_cflow_job( job, target, o );
 			} else {
@@ -355,22 +623,39 @@ static int perform_job( job_list_item_t * job, job_opts_t o ) {
 			}
 			break;
 		case job_bfd_entry:
-			decoder_check( o->opdis );
 			rv = bfd_entry_job( job, target, o );
 			break;
 		case job_bfd_symbol:
-			decoder_check( o->opdis );
 			rv = bfd_symbol_job( job, target, o );
 			break;
 		case job_bfd_section:
 			rv = bfd_section_job( job, target, o );
 			break;
+		case job_bfd_program:
+			rv = bfd_program_job( job, target, o );
+			break;
 		default:
 			break;
 	}
+
+	if ( o->stats ) {
+		opdis_set_stats( o->opdis, NULL );
+		sync_msg( o );
+		print_stats( o->msg, job, &stats );
+	}
+
 	return rv;
 }
 
+static int perform_job( job_list_item_t * job, job_opts_t o ) {
+	tgt_list_item_t * target = prepare_job( job, o );
+	if (! target ) {
+		return 0;
+	}
+
+	return run_job( job, target, o );
+}
+
 /* perform the specified job */
 int job_list_perform( job_list_t jobs, unsigned int id, job_opts_t opts ) {
 	job_list_item_t * item;
@@ -389,6 +674,256 @@ int job_list_perform( job_list_t jobs, unsigned int id, job_opts_t opts ) {
 	return 0;
 }
 
+/* ---------------------------------------------------------------------- */
+/* PARALLEL JOBS */
+
+#ifdef HAVE_PTHREAD_H
+
+/* output of a job run by a worker; merged into the shared output in job
+ * order once all jobs have finished */
+struct JOB_RESULT {
+	opdis_insn_t ** insns;	/* insns in the order they were displayed */
+	size_t num, alloc;
+	char * msg;		/* status messages printed by job */
+	size_t msg_len;
+	int rv;
+};
+
+struct JOB_POOL {
+	job_list_item_t ** jobs;
+	tgt_list_item_t ** targets;	/* NULL if job could not be prepared */
+	struct JOB_RESULT * results;
+	unsigned int num, next;
+	pthread_mutex_t lock;
+};
+
+struct JOB_WORKER {
+	struct JOB_POOL * pool;
+	struct job_options_t opts;	/* copy of options with worker opdis */
+	opdis_arena_t arena;		/* storage for insns of worker jobs */
+	struct JOB_RESULT * result;	/* result of current job */
+	FILE * msg;			/* used if messages cannot be buffered */
+	pthread_t thread;
+};
+
+/* display callback for worker opdis: save insn in result of current job */
+static void worker_display( const opdis_insn_t * insn, void * arg ) {
+	struct JOB_WORKER * w = (struct JOB_WORKER *) arg;
+	struct JOB_RESULT * r = w->result;
+	opdis_insn_t * i;
+
+	if ( r->num == r->alloc ) {
+		size_t alloc = ( r->alloc ) ? r->alloc * 2 : 256;
+		void * ptr = realloc( r->insns, alloc * sizeof(opdis_insn_t *) );
+		if (! ptr ) {
+			fprintf( stderr, "Unable to store insn result\n" );
+			return;
+		}
+		r->insns = (opdis_insn_t **) ptr;
+		r->alloc = alloc;
+	}
+
+	i = opdis_insn_dupe_arena( insn, w->arena );
+	if ( i ) {
+		r->insns[r->num++] = i;
+	}
+}
+
+static unsigned int next_job( struct JOB_POOL * pool ) {
+	unsigned int idx;
+
+	pthread_mutex_lock( &pool->lock );
+	idx = pool->next;
+	if ( pool->next < pool->num ) {
+		pool->next++;
+	}
+	pthread_mutex_unlock( &pool->lock );
+
+	return idx;
+}
+
+static void * worker_main( void * arg ) {
+	struct JOB_WORKER * w = (struct JOB_WORKER *) arg;
+	struct JOB_POOL * pool = w->pool;
+	unsigned int idx;
+
+	while ( (idx = next_job( pool )) < pool->num ) {
+		struct JOB_RESULT * r = &pool->results[idx];
+		if (! pool->targets[idx] ) {
+			continue;
+		}
+
+		w->result = r;
+		w->opts.msg = open_memstream( &r->msg, &r->msg_len );
+		if (! w->opts.msg ) {
+			/* print the messages of the job as it runs instead */
+			fprintf( stderr, "Unable to buffer status messages\n" );
+			w->opts.msg = w->msg;
+		}
+
+		r->rv = run_job( pool->jobs[idx], pool->targets[idx], &w->opts );
+		if ( w->opts.msg != w->msg ) {
+			fclose( w->opts.msg );
+		}
+	}
+
+	return NULL;
+}
+
+static int worker_init( struct JOB_WORKER * w, struct JOB_POOL * pool,
+			job_opts_t opts ) {
+	opdis_t o;
+
+	w->pool = pool;
+	w->opts = *opts;
+	w->msg = opts->msg;
+	/* workers buffer their messages; only merge_results pushes insns */
+	w->opts.pipe = NULL;
+	w->arena = opdis_arena_init( 0 );
+	w->opts.opdis = o = opdis_dupe( opts->opdis );
+	if (! o || ! w->arena ) {
+		return 0;
+	}
+
+	/* each worker has its own opdis, and therefore its own insn buffer */
+	opdis_set_display( o, worker_display, w );
+	if ( opts->opdis->handler_arg == opts->opdis ) {
+		o->handler_arg = o;
+	}
+	if ( opts->opdis->resolver_arg == opts->opdis ) {
+		o->resolver_arg = o;
+	}
+
+	return 1;
+}
+
+static void worker_term( struct JOB_WORKER * w ) {
+	opdis_term( w->opts.opdis );
+	opdis_arena_free( w->arena );
+}
+
+/* BFD is not thread-safe: load all BFD sections before starting workers.
+ * Returns 0 if a section was not loaded, as a worker would then read it
+ * from the BFD */
+static int preload_bfd_target( tgt_list_item_t * tgt, job_opts_t o ) {
+	if (! tgt->tgt_bfd ) {
+		return 1;
+	}
+	if (! tgt->sec_cache ) {
+		return 0;
+	}
+	if ( tgt->sec_cache->frozen ) {
+		return 1;
+	}
+
+	opdis_set_bfd_image( o->opdis, tgt->tgt_bfd, tgt->data );
+	opdis_set_sec_cache( o->opdis, tgt->sec_cache );
+	return opdis_preload_bfd_sections( o->opdis, tgt->tgt_bfd );
+}
+
+/* merge results into the shared output in job order */
+static int merge_results( struct JOB_POOL * pool, job_opts_t opts ) {
+	opdis_t o = opts->opdis;
+	unsigned int i;
+	size_t j;
+	int rv = 1;
+
+	for ( i = 0; i < pool->num; i++ ) {
+		struct JOB_RESULT * r = &pool->results[i];
+
+		if ( r->msg ) {
+			sync_msg( opts );
+			fwrite( r->msg, 1, r->msg_len, opts->msg );
+			free( r->msg );
+		}
+
+		for ( j = 0; j < r->num; j++ ) {
+			o->display( r->insns[j], o->display_arg );
+		}
+		free( r->insns );
+
+		rv &= r->rv;
+	}
+
+	return rv;
+}
+
+static int perform_parallel( job_list_t jobs , job_opts_t opts ) {
+	struct JOB_POOL pool = {0};
+	struct JOB_WORKER * workers;
+	job_list_item_t * item;
+	unsigned int i, num_workers = opts->num_jobs;
+	int preloaded = 1, rv = 0;
+
+	if ( num_workers > jobs->num_items ) {
+		num_workers = jobs->num_items;
+	}
+
+	pool.jobs = calloc( jobs->num_items, sizeof(job_list_item_t *) );
+	pool.targets = calloc( jobs->num_items, sizeof(tgt_list_item_t *) );
+	pool.results = calloc( jobs->num_items, sizeof(struct JOB_RESULT) );
+	workers = calloc( num_workers, sizeof(struct JOB_WORKER) );
+	if (! pool.jobs || ! pool.targets || ! pool.results || ! workers ) {
+		fprintf( stderr, "Unable to allocate job pool\n" );
+		free( pool.jobs ); free( pool.targets ); free( pool.results );
+		free( workers );
+		return 0;
+	}
+
+	/* jobs are prepared in sequence, as this modifies jobs and targets */
+	for ( item = jobs->head; item; item = item->next, pool.num++ ) {
+		pool.jobs[pool.num] = item;
+		pool.targets[pool.num] = prepare_job( item, opts );
+		if ( pool.targets[pool.num] ) {
+			preloaded &= preload_bfd_target( pool.targets[pool.num],
+							 opts );
+		}
+	}
+
+	if (! preloaded ) {
+		fprintf( stderr, "WARNING: Unable to preload BFD sections; "
+			 "running jobs in sequence\n" );
+		num_workers = 0;
+	}
+
+	pthread_mutex_init( &pool.lock, NULL );
+	for ( i = 0; i < num_workers; i++ ) {
+		if (! worker_init( &workers[i], &pool, opts ) ||
+		    pthread_create( &workers[i].thread, NULL, worker_main,
+				    &workers[i] ) ) {
+			fprintf( stderr, "Unable to start job worker %d\n", i );
+			worker_term( &workers[i] );
+			break;
+		}
+	}
+	num_workers = i;
+
+	if ( num_workers ) {
+		for ( i = 0; i < num_workers; i++ ) {
+			pthread_join( workers[i].thread, NULL );
+		}
+		rv = merge_results( &pool, opts );
+	} else {
+		/* no worker was started: run jobs in this thread */
+		for ( i = 0, rv = 1; i < pool.num; i++ ) {
+			rv &= ( pool.targets[i] ) ? 
+			      run_job( pool.jobs[i], pool.targets[i], opts ) : 0;
+		}
+	}
+	pthread_mutex_destroy( &pool.lock );
+
+	for ( i = 0; i < num_workers; i++ ) {
+		worker_term( &workers[i] );
+	}
+	free( workers );
+	free( pool.jobs );
+	free( pool.targets );
+	free( pool.results );
+
+	return rv;
+}
+#endif
+
 /* perform all jobs */
 int job_list_perform_all( job_list_t jobs , job_opts_t opts ) {
 	job_list_item_t * item;
@@ -398,6 +933,15 @@ int job_list_perform_all( job_list_t jobs , job_opts_t opts ) {
 		return rv;
 	}
 
+	if ( opts->num_jobs > 1 && jobs->num_items > 1 ) {
+#ifdef HAVE_PTHREAD_H
+		return perform_parallel( jobs, opts );
+#else
+		fprintf( stderr, "WARNING: threads not supported; running "
+			 "jobs in sequence\n" );
+#endif
+	}
+
 	for ( item = jobs->head; item; item = item->next ) {
 		int result = perform_job( item, opts );
 		if (! result ) {
@@ -464,6 +1008,11 @@ static void print_job( job_list_item_t * item, unsigned int id, void * arg ) {
 			fprintf( f, "Linear disassembly of BFD section '%s'\n", 
 				item->bfd_name );
 			break;
+
+		case job_bfd_program:
+			fprintf( f, "Control Flow disassembly of BFD entry point "
+				 "and all function symbols\n" );
+			break;
 		default:
 			fprintf( f, "Unknown job type for '%s'\n", item->spec );
 	}
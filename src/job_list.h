@@ -10,7 +10,9 @@
 
 #include <opdis/opdis.h>
 
+#include "db.h"
 #include "map.h"
+#include "pipeline.h"
 #include "target_list.h"
 
 /* Type of job : arg is either a memspec or a BFD name */
@@ -19,7 +21,8 @@ enum job_type_t {
 	job_linear,		/* Linear disasm on memspec */
 	job_bfd_entry,		/* Control Flow disasm of BFD entry point */
 	job_bfd_symbol,		/* Control Flow disasm of BFD symbol */
-	job_bfd_section		/* Linear disasm of BFD section */
+	job_bfd_section,	/* Linear disasm of BFD section */
+	job_bfd_program		/* Control Flow disasm of entry and all symbols */
 };
 
 typedef struct JOB_LIST_ITEM {
@@ -31,6 +34,10 @@ typedef struct JOB_LIST_ITEM {
 	opdis_vma_t vma;	/* VMA argument for job */
 	unsigned int size;	/* Size argument for job */
 
+	/* BFD is not thread-safe: these are set when the job is prepared */
+	opdis_t bfd_opdis;	/* disassembler for a BFD job */
+	struct bfd_section * section;	/* section of a BFD section job */
+
 	struct JOB_LIST_ITEM * next;
 } job_list_item_t;
 
@@ -44,6 +51,12 @@ typedef struct job_options_t {
 	mem_map_t map;
 	opdis_t opdis, bfd_opdis;
 	int quiet;
+	FILE * msg;		/* stream for status messages */
+	pipeline_t pipe;	/* drained before messages are printed */
+	unsigned int num_jobs;	/* number of jobs to run in parallel */
+	unsigned int num_threads; /* number of threads per linear job */
+	db_t db;		/* database of restored sections, or NULL */
+	int stats;		/* print disassembly statistics of each job */
 } * job_opts_t;
 
 /* ---------------------------------------------------------------------- */
@@ -73,7 +86,9 @@ void job_list_foreach( job_list_t, JOB_LIST_FOREACH_FN, void * arg );
 /* perform the specified job */
 int job_list_perform( job_list_t, unsigned int id, job_opts_t opts );
 
-/* perform all jobs */
+/* perform all jobs. If opts->num_jobs > 1, jobs are run by that many worker
+ * threads, and their output is sent to the opdis display callback in job
+ * order once all jobs have finished. */
 int job_list_perform_all( job_list_t, job_opts_t opts );
 
 void job_list_print( job_list_t, FILE * f );
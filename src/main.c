@@ -13,10 +13,16 @@
 #include <string.h>
 
 #include <opdis/opdis.h>
+#include <opdis/insn_cols.h>
+#include <opdis/insn_vec.h>
+#include <opdis/visited.h>
+#include <opdis/x86_native.h>
 
 #include "asm_format.h"
+#include "db.h"
 #include "job_list.h"
 #include "map.h"
+#include "pipeline.h"
 #include "target_list.h"
 
 /* ---------------------------------------------------------------------- */
@@ -35,7 +41,9 @@ static const char help_str[] =
 "  bfdname = [target:]name\n"
 "  mapspec = [target]:offset@vma[+size]\n"
 "  target  = ID (#) of target; use --dry-run to see IDs\n" 
-"  fmtspec = asm|dump|delim|xml|fmt_str\n"
+"  fmtspec = asm|dump|delim|xml|bin|fmt_str\n"
+"  cfgspec = dot|xml\n"
+"  levels  = basic|mnem|ops|mnem_flags|op_flags|cflow|all[,...]\n"
 ;
 
 
@@ -65,6 +73,8 @@ static struct argp_option options[] = {
 	  "Perform control flow disassembly on BFD entry point"},
 	{ "bfd-symbol", 'N', "bfdname", 0,
 	  "Perform control flow disassembly on symbol"},
+	{ "bfd-all-symbols", 13, 0, 0,
+	  "Perform control flow disassembly on entry point and all symbols"},
 	{ "bfd-section", 'S', "bfdname", 0,
 	  "Perform linear disassembly on section"},
 	{ "bfd", 'B', "[target]", OPTION_ARG_OPTIONAL, 
@@ -76,6 +86,26 @@ static struct argp_option options[] = {
 	  "List of input bytes in hex or octal" },
 	{ "disassembler-options", 'O', "string", 0,
 	  "Apply specific options to disassembler"},
+	{ "jobs", 'j', "num", 0,
+	  "Number of jobs to run in parallel"},
+	{ "threads", 7, "num", 0,
+	  "Number of threads to use for each linear disassembly"},
+	{ "decode-cache", 8, 0, 0,
+	  "Cache decoded instructions by their bytes"},
+	{ "cfg", 9, "cfgspec", 0,
+	  "Output control flow graph of control flow disassembly"},
+	{ "db", 10, "file", 0,
+	  "Restore unchanged sections from, and save results to, database"},
+	{ "stream", 11, 0, 0,
+	  "Print instructions as they are disassembled"},
+	{ "pipeline", 15, 0, 0,
+	  "Stream, formatting instructions in a separate thread"},
+	{ "stats", 12, 0, 0,
+	  "Print disassembly statistics for each job"},
+	{ "decode", 14, "levels", 0,
+	  "Instruction fields to decode (default: all)"},
+	{ "native", 16, 0, 0,
+	  "Decode x86 instructions from their bytes instead of libopcodes output"},
 	{ "list-architectures", 1, 0, 0, 
 	  "Print available machine architectures"},
 	{ "list-disassembler-options", 2, 0, 0, 
@@ -108,6 +138,7 @@ struct opdis_options {
 	const char *		syntax_str;
 	enum asm_format_t	fmt;
 	const char * 		fmt_str;
+	asm_fmt_t		fmt_prog;	/* compiled custom fmt_str */
 	const char *		output;
 
 	int			bfd_all_targets;
@@ -122,9 +153,26 @@ struct opdis_options {
 	int		dry_run;
 	int		quiet;
 	int 		debug;
+	unsigned int	num_jobs;
+	unsigned int	num_threads;
+	int		decode_cache;
+	enum cfg_format_t	cfg_fmt;
+	const char *		db_path;
+	db_t			db;
+	unsigned int		db_target;	/* target of frontier jobs */
+	int			stream;
+	char *			stream_buf;	/* buffer for output_file */
+	opdis_visited_t		streamed;	/* VMAs already printed */
+	opdis_cols_writer_t	stream_bin;	/* writer for -f bin */
+	int			pipeline;
+	pipeline_t		pipe;		/* formatter thread */
+	int			stats;
+	enum opdis_insn_decode_t decode_mask;	/* 0 = all */
+	int			native;		/* native x86 decoder */
 
 	FILE *			output_file;
-	opdis_insn_tree_t	insn_tree;
+	opdis_arena_t		insn_arena;
+	opdis_insn_vec_t	insns;
 };
 
 static void set_defaults( struct opdis_options * opts ) {
@@ -132,7 +180,9 @@ static void set_defaults( struct opdis_options * opts ) {
 	opts->map = mem_map_alloc();
 	opts->targets = tgt_list_alloc();
 	opts->opdis = opdis_init();
-	opts->insn_tree = opdis_insn_tree_init( 1 );
+	/* all stored instructions come from the arena */
+	opts->insn_arena = opdis_arena_init( 0 );
+	opts->insns = opdis_insn_vec_init( 0 );
 	opts->output_file = stdout;
 
 	// TODO get first available arch
@@ -189,7 +239,16 @@ static int set_format( struct opdis_options * opts, const char * arg ) {
 		opts->fmt = asmfmt_delim;
 	} else if ( ! strcmp( "xml", arg ) ) {
 		opts->fmt = asmfmt_xml;
+	} else if ( ! strcmp( "bin", arg ) ) {
+		opts->fmt = asmfmt_bin;
 	} else if ( strchr( arg, '%' ) ) {
+		/* compile once rather than parse arg for every insn */
+		asm_fmt_free( opts->fmt_prog );
+		opts->fmt_prog = asm_fmt_compile( arg );
+		if (! opts->fmt_prog ) {
+			fprintf( stderr, "Unable to compile format '%s'\n", arg );
+			return 0;
+		}
 		opts->fmt = asmfmt_custom;
 	} else {
 		fprintf( stderr, "Unreognized format : '%s'\n", arg );
@@ -200,6 +259,63 @@ static int set_format( struct opdis_options * opts, const char * arg ) {
 	return 1;
 }
 
+struct DECODE_LEVEL {
+	const char * name;
+	enum opdis_insn_decode_t mask;
+};
+
+static const struct DECODE_LEVEL decode_levels[] = {
+	{ "basic", opdis_decode_basic },
+	{ "mnem", opdis_decode_mnem },
+	{ "ops", opdis_decode_ops },
+	{ "mnem_flags", opdis_decode_mnem_flags },
+	{ "op_flags", opdis_decode_op_flags },
+	{ "cflow", OPDIS_DECODE_CFLOW },
+	{ "all", OPDIS_DECODE_ALL },
+	{ NULL, 0 }
+};
+
+static int set_decode_mask( struct opdis_options * opts, const char * arg ) {
+	const char * c = arg;
+	unsigned int mask = 0;
+
+	while ( *c ) {
+		const struct DECODE_LEVEL * l;
+		size_t len = strcspn( c, "," );
+
+		for ( l = decode_levels; l->name; l++ ) {
+			if ( strlen( l->name ) == len && 
+			     ! strncmp( l->name, c, len ) ) {
+				break;
+			}
+		}
+		if (! l->name ) {
+			fprintf( stderr, "Unrecognized decode level : '%.*s'\n",
+				 (int) len, c );
+			return 0;
+		}
+
+		mask |= l->mask;
+		c += ( c[len] ) ? len + 1 : len;
+	}
+
+	opts->decode_mask = (enum opdis_insn_decode_t) mask;
+	return 1;
+}
+
+static int set_cfg_format( struct opdis_options * opts, const char * arg ) {
+	if (! strcmp( "dot", arg ) ) {
+		opts->cfg_fmt = cfgfmt_dot;
+	} else if (! strcmp( "xml", arg ) ) {
+		opts->cfg_fmt = cfgfmt_xml;
+	} else {
+		fprintf( stderr, "Unrecognized CFG format : '%s'\n", arg );
+		return 0;
+	}
+
+	return 1;
+}
+
 static void parse_memspec( const char * memspec, unsigned int * target,
 			  opdis_off_t * offset, opdis_off_t * size,
 			  opdis_vma_t * vma ) {
@@ -364,6 +480,32 @@ static int set_output_file( struct opdis_options * opts, const char * arg ) {
 	return 1;
 }
 
+static int set_num_jobs( struct opdis_options * opts, const char * arg ) {
+	char * err;
+	unsigned long num = strtoul( arg, &err, 0 );
+
+	if ( (err && *err) || ! num ) {
+		fprintf( stderr, "Not a valid number of jobs: %s\n", arg );
+		return 0;
+	}
+
+	opts->num_jobs = (unsigned int) num;
+	return 1;
+}
+
+static int set_num_threads( struct opdis_options * opts, const char * arg ) {
+	char * err;
+	unsigned long num = strtoul( arg, &err, 0 );
+
+	if ( (err && *err) || ! num ) {
+		fprintf( stderr, "Not a valid number of threads: %s\n", arg );
+		return 0;
+	}
+
+	opts->num_threads = (unsigned int) num;
+	return 1;
+}
+
 static error_t parse_arg( int key, char * arg, struct argp_state *state ) {
 	struct opdis_options * opts = state->input;
 
@@ -411,6 +553,11 @@ static error_t parse_arg( int key, char * arg, struct argp_state *state ) {
 		case 'O': 
 			opts->disasm_opts = arg;
 			break;
+		case 'j':
+			if (! set_num_jobs( opts, arg ) ) {
+				argp_error( state, "Invalid argument for -j" );
+			}
+			break;
 		case 'B':
 			if (! set_bfd_target( opts, arg ) ) {
 				argp_error( state, "Invalid argument for -B" );
@@ -438,6 +585,31 @@ static error_t parse_arg( int key, char * arg, struct argp_state *state ) {
 		case 4: opts->list_format = 1; break;
 		case 5: opts->list_symbols = 1; break;
 		case 6: opts->dry_run = 1; break;
+		case 7:
+			if (! set_num_threads( opts, arg ) ) {
+				argp_error( state, 
+					    "Invalid argument for --threads" );
+			}
+			break;
+		case 8: opts->decode_cache = 1; break;
+		case 10: opts->db_path = arg; break;
+		case 11: opts->stream = 1; break;
+		case 15: opts->stream = opts->pipeline = 1; break;
+		case 12: opts->stats = 1; break;
+		case 16: opts->native = 1; break;
+		case 14:
+			if (! set_decode_mask( opts, arg ) ) {
+				argp_error( state, "Invalid argument for --decode" );
+			}
+			break;
+		case 13:
+			add_bfd_job( opts, job_bfd_program, NULL );
+			break;
+		case 9:
+			if (! set_cfg_format( opts, arg ) ) {
+				argp_error( state, "Invalid argument for --cfg" );
+			}
+			break;
 
 		case ARGP_KEY_ARG:
 			tgt_list_add( opts->targets, tgt_file, arg );
@@ -465,13 +637,46 @@ static struct argp argp_cfg = {
 
 void opdis_display_cb ( const opdis_insn_t * insn, void * arg ) {
 	opdis_insn_t * i;
-	opdis_insn_tree_t tree = (opdis_insn_tree_t) arg;
-	if (! tree ) {
+	struct opdis_options * opts = (struct opdis_options *) arg;
+	if (! opts ) {
+		return;
+	}
+
+	/* instructions are appended in the order they are disassembled; the
+	 * vector sorts them, and discards any that were disassembled again
+	 * by a later job, before output */
+	i = opdis_insn_dupe_arena( insn, opts->insn_arena );
+	opdis_insn_vec_add( opts->insns, i );
+}
+
+/* print a streamed insn; with --pipeline, this runs in the formatter */
+static void stream_format_cb( const opdis_insn_t * insn, void * arg ) {
+	struct opdis_options * opts = (struct opdis_options *) arg;
+
+	if ( opts->stream_bin ) {
+		opdis_cols_writer_add( opts->stream_bin, insn );
+		return;
+	}
+
+	asm_fprintf_insn( opts->output_file, opts->fmt, opts->fmt_prog,
+			  (opdis_insn_t *) insn );
+}
+
+/* display callback for --stream: print each insn the first time its VMA is
+ * disassembled, rather than collecting insns for output_disassembly */
+static void stream_display_cb( const opdis_insn_t * insn, void * arg ) {
+	struct opdis_options * opts = (struct opdis_options *) arg;
+	if (! opts || opdis_visited_contains( opts->streamed, insn->vma ) ) {
+		return;
+	}
+	opdis_visited_add( opts->streamed, insn->vma );
+
+	if ( opts->pipe ) {
+		pipeline_push( opts->pipe, insn );
 		return;
 	}
 
-	i = opdis_insn_dupe( insn );
-	opdis_insn_tree_add( tree, i );
+	stream_format_cb( insn, opts );
 }
 
 opdis_vma_t opdis_resolver_cb( const opdis_insn_t * i, void * arg ) {
@@ -499,20 +704,204 @@ static int print_insn( opdis_insn_t * i, void * arg ) {
 	// TODO : have display track jump/call targets in a tree,
 	//        then emit a comment label line before the tree if
 	//        the format is .asm
-	asm_fprintf_insn( opts->output_file, opts->fmt, opts->fmt_str, i );
+	asm_fprintf_insn( opts->output_file, opts->fmt, opts->fmt_prog, i );
 
 	return 1;
 }
 
 static void output_disassembly( struct opdis_options * opts ) {
+	if ( opts->opdis->cfg ) {
+		asm_fprintf_cfg( opts->output_file, opts->cfg_fmt,
+				 opts->opdis->cfg, opts->insns );
+		return;
+	}
+
+	if ( opts->fmt == asmfmt_bin ) {
+		asm_fwrite_bin( opts->output_file, opts->insns );
+		return;
+	}
+
 	asm_fprintf_header( opts->output_file, opts->fmt );
 
 	// TODO: print targets and maps
 	
-	opdis_insn_tree_foreach( opts->insn_tree, print_insn, opts );
+	opdis_insn_vec_foreach( opts->insns, print_insn, opts );
 	asm_fprintf_footer( opts->output_file, opts->fmt );
 }
 
+/* ---------------------------------------------------------------------- */
+/* STREAMING */
+
+#define STREAM_BUF_SIZE (4 * 1024 * 1024)
+
+/* the graph and the database need every insn after the jobs have run */
+static void check_stream( struct opdis_options * opts ) {
+	if ( opts->stream && ( opts->cfg_fmt != cfgfmt_none ||
+			       opts->db_path ) ) {
+		fprintf( stderr, "WARNING: --stream is ignored with --cfg "
+			 "and --db\n" );
+		opts->stream = opts->pipeline = 0;
+	}
+}
+
+static void start_stream( struct opdis_options * opts ) {
+	tgt_list_item_t * tgt;
+
+	/* output is written in large blocks rather than a line at a time.
+	 * The output file is never closed, so the buffer is not freed */
+	opts->stream_buf = malloc( STREAM_BUF_SIZE );
+	if ( opts->stream_buf ) {
+		setvbuf( opts->output_file, opts->stream_buf, _IOFBF,
+			 STREAM_BUF_SIZE );
+	}
+
+	/* cover the targets with the bitmap of the visited set */
+	opts->streamed = opdis_visited_init();
+	for ( tgt = opts->targets->head; tgt; tgt = tgt->next ) {
+		if ( tgt->tgt_bfd ) {
+			asection * s;
+			for ( s = tgt->tgt_bfd->sections; s; s = s->next ) {
+				if ( bfd_get_section_flags( tgt->tgt_bfd, s ) &
+				     SEC_CODE ) {
+					opdis_visited_cover( opts->streamed,
+						bfd_section_vma( tgt->tgt_bfd, s ),
+						bfd_section_size( tgt->tgt_bfd, s ) );
+				}
+			}
+		} else if ( tgt->data ) {
+			opdis_visited_cover( opts->streamed, tgt->data->vma,
+					     tgt->data->len );
+		}
+	}
+
+	if ( opts->fmt == asmfmt_bin ) {
+		opts->stream_bin = opdis_cols_writer_init( opts->output_file,
+							   0 );
+		if (! opts->stream_bin ) {
+			fprintf( stderr, "Unable to write binary output\n" );
+		}
+	} else {
+		asm_fprintf_header( opts->output_file, opts->fmt );
+	}
+
+	/* the formatter thread is the only writer to output_file until
+	 * stop_pipeline */
+	if ( opts->pipeline ) {
+		opts->pipe = pipeline_start( 0, stream_format_cb, opts );
+		if (! opts->pipe ) {
+			fprintf( stderr, "WARNING: Unable to start pipeline; "
+				 "formatting in sequence\n" );
+		}
+	}
+}
+
+static void stop_pipeline( struct opdis_options * opts ) {
+	pipeline_finish( opts->pipe );
+	opts->pipe = NULL;
+}
+
+static void end_stream( struct opdis_options * opts ) {
+	if ( opts->fmt == asmfmt_bin ) {
+		if (! opts->stream_bin ||
+		     ! opdis_cols_writer_close( opts->stream_bin ) ) {
+			fprintf( stderr, "Error writing binary output\n" );
+		}
+		opts->stream_bin = NULL;
+	} else {
+		asm_fprintf_footer( opts->output_file, opts->fmt );
+	}
+
+	fflush( opts->output_file );
+	opdis_visited_free( opts->streamed );
+	opts->streamed = NULL;
+}
+
+/* ---------------------------------------------------------------------- */
+/* DATABASE */
+
+static uint64_t target_hash( tgt_list_item_t * tgt ) {
+	return db_hash( tgt->ascii, strlen(tgt->ascii) );
+}
+
+static void restore_section( tgt_list_item_t * tgt, const char * name,
+			     opdis_vma_t vma, const opdis_byte_t * bytes,
+			     opdis_off_t size, void * arg ) {
+	struct opdis_options * opts = (struct opdis_options *) arg;
+	db_section_t * sec = db_find( opts->db, target_hash(tgt), name );
+	int count;
+
+	if (! sec || sec->vma != vma || sec->size != size ||
+	     sec->bytes_hash != db_hash( bytes, size ) ||
+	     sec->config_hash != db_config_hash( opts->opdis ) ) {
+		return;
+	}
+
+	count = db_restore( sec, opts->opdis );
+	if ( count && ! opts->quiet ) {
+		printf( "Restored %d insns of %s%s%s from database\n", count,
+			tgt->ascii, name[0] ? ":" : "", name );
+	}
+}
+
+static void store_section( tgt_list_item_t * tgt, const char * name,
+			   opdis_vma_t vma, const opdis_byte_t * bytes,
+			   opdis_off_t size, void * arg ) {
+	struct opdis_options * opts = (struct opdis_options *) arg;
+
+	db_store( opts->db, target_hash(tgt), name, vma, size,
+		  db_hash( bytes, size ), opts->insns, opts->opdis );
+}
+
+static void add_frontier_job( opdis_vma_t vma, void * arg ) {
+	struct opdis_options * opts = (struct opdis_options *) arg;
+
+	/* frontier jobs apply to the target being restored, which is always
+	 * the last one examined by restore_db */
+	job_list_add( opts->jobs, job_cflow, "(database)", opts->db_target,
+		      0, vma, 0 );
+}
+
+/* restore every unchanged section, then add a control flow job for each
+ * stored branch target in a changed section */
+static void restore_db( struct opdis_options * opts ) {
+	tgt_list_item_t * tgt;
+	unsigned int id = 1;
+
+	opts->db = db_alloc();
+	db_load( opts->db, opts->db_path );
+
+	for ( tgt = opts->targets->head; tgt; id++, tgt = tgt->next ) {
+		if (! tgt->tgt_bfd && ( ! tgt->data->vma ||
+				  tgt->data->vma == OPDIS_INVALID_ADDR ) ) {
+			/* buffer targets are keyed by their load address */
+			opdis_vma_t vma;
+			vma = mem_map_vma_for_target( opts->map, id, 0 );
+			tgt->data->vma = (vma == OPDIS_INVALID_ADDR) ? 0 : vma;
+		}
+
+		db_foreach_section( tgt, restore_section, opts );
+		opts->db_target = id;
+		db_foreach_frontier( opts->db, target_hash(tgt),
+				     add_frontier_job, opts );
+	}
+}
+
+static void save_db( struct opdis_options * opts ) {
+	tgt_list_item_t * tgt;
+
+	for ( tgt = opts->targets->head; tgt; tgt = tgt->next ) {
+		db_foreach_section( tgt, store_section, opts );
+	}
+
+	if (! db_save( opts->db, opts->db_path ) ) {
+		fprintf( stderr, "Unable to write database %s\n",
+			 opts->db_path );
+	}
+
+	db_free( opts->db );
+	opts->db = NULL;
+}
+
 /* ---------------------------------------------------------------------- */
 
 static void bfd_load(  tgt_list_item_t * target, unsigned int id, void * arg ) {
@@ -545,7 +934,7 @@ static void map_buffer_args( struct opdis_options * opts ) {
 	opdis_vma_t vma = 0;
 
 	/* user has manually mapped memory: defer to them */
-	if ( opdis_tree_count( opts->map ) ) {
+	if ( mem_map_count( opts->map ) ) {
 		return;
 	}
 
@@ -570,8 +959,35 @@ static void configure_opdis( struct opdis_options * opts ) {
 
 	opdis_set_x86_syntax( o, opts->syntax );
 
-	opdis_set_display( o, opdis_display_cb, opts->insn_tree );
+	if ( opts->native ) {
+		if ( arch_info->arch == bfd_arch_i386 ) {
+			opdis_set_decoder( o, opdis_x86_native_decoder, o );
+		} else {
+			fprintf( stderr, "WARNING: --native requires an x86 "
+				 "architecture\n" );
+		}
+	}
+
+	if ( opts->stream ) {
+		opdis_set_display( o, stream_display_cb, opts );
+	} else {
+		opdis_set_display( o, opdis_display_cb, opts );
+	}
 	opdis_set_resolver( o, opdis_resolver_cb, opts->map );
+	/* the display callbacks print or duplicate each insn */
+	opdis_set_borrow_bytes( o, 1 );
+
+	if ( opts->decode_mask ) {
+		opdis_set_decode_mask( o, opts->decode_mask );
+	}
+
+	if ( opts->decode_cache ) {
+		opdis_set_decode_cache( o, opdis_decode_cache_init( 0 ) );
+	}
+
+	if ( opts->cfg_fmt != cfgfmt_none ) {
+		opdis_set_cfg( o, opdis_cfg_init() );
+	}
 
 	o->debug = opts->debug;
 }
@@ -581,6 +997,17 @@ static void set_job_opts( struct opdis_options * o, job_opts_t j ) {
 	j->map = o->map;
 	j->opdis = o->opdis;
 	j->quiet = o->quiet;
+	j->msg = stdout;
+	j->pipe = o->pipe;
+	j->num_jobs = o->num_jobs;
+	if ( o->opdis->cfg && o->num_jobs > 1 ) {
+		/* the graph is not threadsafe */
+		fprintf( stderr, "WARNING: --cfg runs jobs in sequence\n" );
+		j->num_jobs = 1;
+	}
+	j->num_threads = o->num_threads;
+	j->db = o->db;
+	j->stats = o->stats;
 }
 
 static void print_target_syms (tgt_list_item_t * t, unsigned int id, void * a) {
@@ -594,6 +1021,7 @@ static void dry_run( struct opdis_options * opts ) {
 	printf( "Architecture: %s\n", opts->arch_str );
 	printf( "Disassembler options: %s\n", opts->disasm_opts );
 	printf( "Syntax: %s\n", opts->syntax_str );
+	printf( "Decoder: %s\n", opts->native ? "native" : "libopcodes" );
 	printf( "Format: %s\n", opts->fmt_str );
 	printf( "Output: %s\n\n", opts->output ? opts->output : "STDOUT" );
 
@@ -602,7 +1030,7 @@ static void dry_run( struct opdis_options * opts ) {
 		tgt_list_print( opts->targets, stdout );
 	}
 
-	if ( opts->map->num ) {
+	if ( mem_map_count( opts->map ) ) {
 		printf( "Memory Map:\n" );
 		mem_map_print( opts->map, stdout );
 	}
@@ -647,6 +1075,7 @@ static void list_format() {
 	printf( "\tdump\t: Disassembled listing (address, bytes, insn)\n" );
 	printf( "\tdelim\t: Pipe-delimited instruction info\n" );
 	printf( "\txml\t: XML representation\n" );
+	printf( "\tbin\t: Columnar binary file (see opdis/insn_cols.h)\n" );
 	printf( "\t(format string)\n" );
 }
 
@@ -720,12 +1149,53 @@ int main( int argc, char ** argv ) {
 	}
 
 	map_buffer_args( & opts );
+	mem_map_index( opts.map );
 
+	check_stream( & opts );
 	configure_opdis( & opts );
+	if ( opts.db_path ) {
+		restore_db( & opts );
+	}
+	if ( opts.stream ) {
+		start_stream( & opts );
+	}
 	set_job_opts( &opts, &job_opts );
 	job_list_perform_all( opts.jobs, &job_opts );
+	if ( opts.pipe ) {
+		stop_pipeline( & opts );
+	}
+
+	if ( opts.opdis->decode_cache ) {
+		opdis_decode_cache_t cache = opts.opdis->decode_cache;
+		if (! opts.quiet ) {
+			/* keep the disassembly on stdout parseable */
+			fprintf( ( opts.output_file == stdout ) ? stderr :
+				 stdout, "Decode cache: %lu hits, %lu misses, "
+				 "%lu encodings\n", cache->hits, cache->misses,
+				 (unsigned long) cache->num );
+		}
+		opdis_set_decode_cache( opts.opdis, NULL );
+		opdis_decode_cache_free( cache );
+	}
+
+	if ( opts.db ) {
+		save_db( & opts );
+	}
+
+	if ( opts.stream ) {
+		end_stream( & opts );
+	} else {
+		output_disassembly( & opts );
+	}
+
+	if ( opts.opdis->cfg ) {
+		opdis_cfg_free( opts.opdis->cfg );
+		opdis_set_cfg( opts.opdis, NULL );
+	}
 
-	output_disassembly( & opts );
+	opdis_insn_vec_free( opts.insns );
+	opdis_arena_free( opts.insn_arena );
+	asm_fmt_free( opts.fmt_prog );
 
 	return 0;
 }
@@ -21,18 +21,41 @@ static void * map_key( void * data ) {
 
 /* allocate a memory map */
 mem_map_t mem_map_alloc( void ) {
-	return opdis_tree_init( map_key, NULL, free );
+	mem_map_t m = (mem_map_t) calloc( 1, sizeof(mem_map_info_t) );
+	if (! m ) {
+		return NULL;
+	}
+
+	m->by_vma = opdis_tree_init( map_key, NULL, free );
+	if (! m->by_vma ) {
+		free(m);
+		return NULL;
+	}
+
+	return m;
 }
 
 /* free an allocated memory map */
 void mem_map_free( mem_map_t memmap ) {
-	opdis_tree_free( (opdis_tree_t) memmap );
+	if (! memmap ) {
+		return;
+	}
+
+	opdis_tree_free( memmap->by_vma );
+	free( memmap->index );
+	free( memmap );
 }
 
 /* map 'size' bytes at 'offset' into 'target' to load address 'vma' */
 int mem_map_add( mem_map_t memmap, unsigned int target, opdis_off_t offset,
 		 opdis_off_t size, opdis_vma_t vma ) {
-	map_t * m = opdis_tree_closest( (opdis_tree_t) memmap, (void *) vma );
+	map_t * m;
+
+	if (! memmap ) {
+		return 0;
+	}
+
+	m = opdis_tree_closest( memmap->by_vma, (void *) vma );
 	if ( m && vma < (m->vma + m->size) ) {
 		/* VMA is inside a memory block */
 		fprintf( stderr, "Unable to map %p bytes at VMA %p: ",
@@ -42,7 +65,7 @@ int mem_map_add( mem_map_t memmap, unsigned int target, opdis_off_t offset,
 		return 0;
 	}
 
-	m = opdis_tree_next( (opdis_tree_t) memmap, (void *) vma );
+	m = opdis_tree_next( memmap->by_vma, (void *) vma );
 	if ( m && (vma + size) - 1 >= m->vma ) {
 		/* VMA extends into the next memory block */
 		fprintf( stderr, "Unable to map %p bytes at VMA %p: ",
@@ -62,18 +85,27 @@ int mem_map_add( mem_map_t memmap, unsigned int target, opdis_off_t offset,
 	m->vma = vma;
 	m->size = size;
 
-	if (! opdis_tree_add( (opdis_tree_t) memmap, m ) ) {
+	if (! opdis_tree_add( memmap->by_vma, m ) ) {
 		free(m);
 		return 0;
 	}
 
+	memmap->dirty = 1;
 	return 1;
 }
 
+/* return the number of mappings */
+size_t mem_map_count( mem_map_t memmap ) {
+	return memmap ? opdis_tree_count( memmap->by_vma ) : 0;
+}
+
 /* Invoke callback for each mapping */
 void mem_map_foreach( mem_map_t memmap, MEM_MAP_FOREACH_FN fn, void * arg ) {
-	opdis_tree_foreach( (opdis_tree_t) memmap, (OPDIS_TREE_FOREACH_FN) fn, 
-			     arg );
+	if (! memmap ) {
+		return;
+	}
+
+	opdis_tree_foreach( memmap->by_vma, (OPDIS_TREE_FOREACH_FN) fn, arg );
 }
 
 static int print_memmap( map_t * map, void * arg ) {
@@ -94,34 +126,125 @@ void mem_map_print( mem_map_t memmap, FILE * f ) {
 	mem_map_foreach( memmap, print_memmap, f );
 }
 
-static int vma_search( map_t * map, void * arg ) {
-	map_t * request = (map_t *) arg;
+/* ---------------------------------------------------------------------- */
+/* target index: maps sorted by (target, offset) */
 
-	if ( map->target != request->target ) {
-		return 1;
-	}
+static int index_map( map_t * map, void * arg ) {
+	mem_map_t memmap = (mem_map_t) arg;
+	map_index_t * e = &memmap->index[memmap->num++];
 
+	e->map = map;
 	/* note: map of size 0 means "map through end of target */
-	if ( request->offset >= map->offset && 
-	     (! map->size || request->offset < (map->offset + map->size)) ) {
-		request->vma = map->vma;
+	e->end = map->size ? map->offset + map->size : (opdis_off_t) -1;
+	return 1;
+}
+
+static int cmp_index( const void * a, const void * b ) {
+	const map_t * ma = ((const map_index_t *) a)->map;
+	const map_t * mb = ((const map_index_t *) b)->map;
+
+	if ( ma->target != mb->target ) {
+		return ( ma->target < mb->target ) ? -1 : 1;
+	}
+	if ( ma->offset != mb->offset ) {
+		return ( ma->offset < mb->offset ) ? -1 : 1;
+	}
+	return ( ma->vma < mb->vma ) ? -1 : ( ma->vma > mb->vma );
+}
+
+int mem_map_index( mem_map_t memmap ) {
+	size_t i, num;
+	map_index_t * index = NULL;
+
+	if (! memmap ) {
 		return 0;
 	}
+	if (! memmap->dirty ) {
+		return 1;
+	}
 
+	num = opdis_tree_count( memmap->by_vma );
+	if ( num ) {
+		index = (map_index_t *) calloc( num, sizeof(map_index_t) );
+		if (! index ) {
+			return 0;
+		}
+	}
+
+	free( memmap->index );
+	memmap->index = index;
+	memmap->num = 0;
+	opdis_tree_foreach( memmap->by_vma, (OPDIS_TREE_FOREACH_FN) index_map,
+			    memmap );
+
+	qsort( index, memmap->num, sizeof(map_index_t), cmp_index );
+
+	/* max_end allows a lookup to stop walking back through overlaps */
+	for ( i = 0; i < memmap->num; i++ ) {
+		map_index_t * e = &index[i];
+		e->max_end = e->end;
+		if ( i && index[i - 1].map->target == e->map->target &&
+		     index[i - 1].max_end > e->max_end ) {
+			e->max_end = index[i - 1].max_end;
+		}
+	}
 
+	memmap->dirty = 0;
 	return 1;
 }
 
+/* index of first entry after (target, offset) */
+static size_t upper_bound( mem_map_t memmap, unsigned int target, 
+			   opdis_off_t offset ) {
+	size_t lo = 0, hi = memmap->num;
+
+	while ( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		map_t * m = memmap->index[mid].map;
+		if ( m->target < target || 
+		     ( m->target == target && m->offset <= offset ) ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/* return the lowest vma of a map containing offset in target */
+static opdis_vma_t vma_search( mem_map_t memmap, unsigned int target,
+			       opdis_off_t offset ) {
+	opdis_vma_t vma = OPDIS_INVALID_ADDR;
+	size_t i;
+
+	for ( i = upper_bound( memmap, target, offset ); i > 0; i-- ) {
+		map_index_t * e = &memmap->index[i - 1];
+		if ( e->map->target != target || e->max_end <= offset ) {
+			break;
+		}
+		if ( offset < e->end && e->map->vma < vma ) {
+			vma = e->map->vma;
+		}
+	}
+
+	return vma;
+}
+
 opdis_vma_t mem_map_vma_for_target( mem_map_t memmap, unsigned int target, 
 				    opdis_off_t offset ) {
-	map_t request = { target, offset, OPDIS_INVALID_ADDR, 0 };
+	opdis_vma_t vma;
+
+	/* never index here: lookups may run concurrently */
+	if (! memmap || memmap->dirty ) {
+		return OPDIS_INVALID_ADDR;
+	}
 
-	mem_map_foreach( memmap, vma_search, &request );
-	if ( request.vma == OPDIS_INVALID_ADDR && offset > 0 ) {
+	vma = vma_search( memmap, target, offset );
+	if ( vma == OPDIS_INVALID_ADDR && offset > 0 ) {
 		/* There is no map for offset; return base VMA for target */
-		request.offset = 0;
-		mem_map_foreach( memmap, vma_search, &request );
+		vma = vma_search( memmap, target, 0 );
 	}
 
-	return request.vma;
+	return vma;
 }
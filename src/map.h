@@ -22,7 +22,23 @@ typedef struct {
 	opdis_off_t size;
 } map_t;
 
-typedef opdis_tree_t mem_map_t;
+/* maps are kept in a tree keyed by vma, which is used for overlap checks
+ * and for walking the map in order of vma. lookups by target use an index
+ * of the maps sorted by (target, offset), built by mem_map_index. */
+typedef struct {
+	map_t * map;
+	opdis_off_t end;	/* offset past last byte; 0-size maps never end */
+	opdis_off_t max_end;	/* max end of this and prior maps in target */
+} map_index_t;
+
+typedef struct {
+	opdis_tree_t by_vma;
+	map_index_t * index;
+	size_t num;
+	int dirty;
+} mem_map_info_t;
+
+typedef mem_map_info_t * mem_map_t;
 
 /* ---------------------------------------------------------------------- */
 
@@ -36,6 +52,13 @@ void mem_map_free( mem_map_t );
 int mem_map_add( mem_map_t, unsigned int target, opdis_off_t offset,
 		 opdis_off_t size, opdis_vma_t vma );
 
+/* index the maps by target once all maps have been added. lookups by
+ * target fail until this has been called. */
+int mem_map_index( mem_map_t );
+
+/* return the number of mappings */
+size_t mem_map_count( mem_map_t );
+
 typedef int (*MEM_MAP_FOREACH_FN) ( map_t *, void * );
 
 /* Invoke callback for each mapping */
@@ -0,0 +1,211 @@
+/* pipeline.c
+ * decode/format pipeline
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#include <opdis/insn_rec.h>
+
+#include "pipeline.h"
+
+#ifdef HAVE_PTHREAD_H
+
+#define PIPELINE_SIZE (4 * 1024 * 1024)
+#define CACHE_LINE 64
+
+/* each record in the ring is preceded by its length. A length of 0 means
+ * the next record is at the start of the ring */
+#define ENTRY_HDR sizeof(uint64_t)
+
+/* head and tail count the bytes pushed and drained; each is written by one
+ * thread only, and they are kept on separate cache lines */
+struct PIPELINE {
+	size_t head;
+	char pad_head[CACHE_LINE - sizeof(size_t)];
+	size_t tail;
+	char pad_tail[CACHE_LINE - sizeof(size_t)];
+	int done;			/* no more insns will be pushed */
+	unsigned char * ring;
+	size_t size;
+	PIPELINE_SINK_FN fn;
+	void * arg;
+	pthread_t thread;
+};
+
+#define LOAD(ptr) __atomic_load_n( (ptr), __ATOMIC_ACQUIRE )
+#define STORE(ptr, val) __atomic_store_n( (ptr), (val), __ATOMIC_RELEASE )
+
+/* yield while the other stage catches up; sleep if it takes a while */
+static void wait_stage( unsigned int * spins ) {
+	struct timespec ts = { 0, 50000 };
+
+	if ( ++(*spins) < 64 ) {
+		sched_yield();
+	} else {
+		nanosleep( &ts, NULL );
+	}
+}
+
+static void * formatter_main( void * arg ) {
+	pipeline_t p = (pipeline_t) arg;
+	opdis_insn_t * insn = opdis_insn_alloc( 0 );
+	size_t tail = p->tail;
+	unsigned int spins = 0;
+
+	/* the bytes of each insn are not copied out of the ring */
+	if ( insn ) {
+		insn->borrow_bytes = 1;
+	}
+
+	for ( ;; ) {
+		uint64_t len;
+		size_t pos;
+
+		if ( tail == LOAD( &p->head ) ) {
+			/* head is stored before done */
+			if ( LOAD( &p->done ) && tail == LOAD( &p->head ) ) {
+				break;
+			}
+			wait_stage( &spins );
+			continue;
+		}
+		spins = 0;
+
+		pos = tail % p->size;
+		len = *(const uint64_t *) &p->ring[pos];
+		if (! len ) {
+			tail += p->size - pos;
+			STORE( &p->tail, tail );
+			continue;
+		}
+
+		if ( insn && opdis_insn_rec_fill( (const opdis_insn_rec_t *)
+					&p->ring[pos + ENTRY_HDR], insn ) ) {
+			p->fn( insn, p->arg );
+		}
+
+		tail += ENTRY_HDR + len;
+		STORE( &p->tail, tail );
+	}
+
+	opdis_insn_free( insn );
+	return NULL;
+}
+
+pipeline_t pipeline_start( size_t size, PIPELINE_SINK_FN fn, void * arg ) {
+	pipeline_t p;
+
+	if (! fn ) {
+		return NULL;
+	}
+
+	p = (pipeline_t) calloc( 1, sizeof(struct PIPELINE) );
+	if (! p ) {
+		return NULL;
+	}
+
+	/* records are multiples of 8 bytes, so the ring is as well */
+	p->size = ( size ) ? ( size + 7 ) & ~((size_t) 7) : PIPELINE_SIZE;
+	p->ring = (unsigned char *) malloc( p->size );
+	p->fn = fn;
+	p->arg = arg;
+	if (! p->ring || pthread_create( &p->thread, NULL, formatter_main, p ) ){
+		free( p->ring );
+		free( p );
+		return NULL;
+	}
+
+	return p;
+}
+
+int pipeline_push( pipeline_t p, const opdis_insn_t * insn ) {
+	size_t len, need, pos, pad;
+	unsigned int spins = 0;
+
+	if (! p || ! insn ) {
+		return 0;
+	}
+
+	len = opdis_insn_rec_size( insn );
+	need = ENTRY_HDR + len;
+	if (! len || need > p->size / 2 ) {
+		fprintf( stderr, "Unable to pipeline insn at %p\n",
+			 (void *) insn->vma );
+		return 0;
+	}
+
+	/* a record which would run past the end of the ring starts at 0 */
+	pos = p->head % p->size;
+	pad = ( p->size - pos < need ) ? p->size - pos : 0;
+
+	/* backpressure: wait for the formatter to free enough space */
+	while ( p->size - ( p->head - LOAD( &p->tail ) ) < pad + need ) {
+		wait_stage( &spins );
+	}
+
+	if ( pad ) {
+		*(uint64_t *) &p->ring[pos] = 0;
+		pos = 0;
+	}
+
+	opdis_insn_pack( insn, &p->ring[pos + ENTRY_HDR], len );
+	*(uint64_t *) &p->ring[pos] = len;
+	STORE( &p->head, p->head + pad + need );
+
+	return 1;
+}
+
+void pipeline_drain( pipeline_t p ) {
+	unsigned int spins = 0;
+
+	if (! p ) {
+		return;
+	}
+
+	/* tail is stored after the sink returns */
+	while ( LOAD( &p->tail ) != p->head ) {
+		wait_stage( &spins );
+	}
+}
+
+void pipeline_finish( pipeline_t p ) {
+	if (! p ) {
+		return;
+	}
+
+	STORE( &p->done, 1 );
+	pthread_join( p->thread, NULL );
+
+	free( p->ring );
+	free( p );
+}
+
+#else
+
+pipeline_t pipeline_start( size_t size, PIPELINE_SINK_FN fn, void * arg ) {
+	return NULL;
+}
+
+int pipeline_push( pipeline_t p, const opdis_insn_t * insn ) {
+	return 0;
+}
+
+void pipeline_drain( pipeline_t p ) {
+}
+
+void pipeline_finish( pipeline_t p ) {
+}
+
+#endif
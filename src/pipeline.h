@@ -0,0 +1,38 @@
+/* pipeline.h
+ * decode/format pipeline: a single-producer, single-consumer ring of
+ * packed instruction records drained by a formatter thread
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_PIPELINE_H
+#define OPDIS_PIPELINE_H
+
+#include <opdis/model.h>
+
+/* callback run in the formatter thread for each insn, in the order the
+ * insns were pushed. The insn borrows its bytes from the ring, and is only
+ * valid until the callback returns. */
+typedef void (*PIPELINE_SINK_FN) ( const opdis_insn_t *, void * arg );
+
+typedef struct PIPELINE * pipeline_t;
+
+/* ---------------------------------------------------------------------- */
+
+/* start a formatter thread draining a ring of size bytes (0 for the
+ * default). Returns NULL if threads are not supported */
+pipeline_t pipeline_start( size_t size, PIPELINE_SINK_FN fn, void * arg );
+
+/* pack insn into the ring; waits while the ring is full */
+int pipeline_push( pipeline_t, const opdis_insn_t * insn );
+
+/* wait for the formatter to print every insn pushed so far, e.g. before
+ * writing other output to the stream it prints to */
+void pipeline_drain( pipeline_t );
+
+/* wait for the formatter to drain the ring, then stop it */
+void pipeline_finish( pipeline_t );
+
+#endif
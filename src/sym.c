@@ -1,11 +1,12 @@
 /* sym.c
- * tree of bfd symbols
+ * table of bfd symbols
  * Copyright (c) 2010 ThoughtGang
  * Written by TG Community Developers <community@thoughtgang.org>
  * Released under the GNU Public License, version 3.
  * See http://www.gnu.org/licenses/gpl.txt for details.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,139 +15,272 @@
 
 /* ---------------------------------------------------------------------- */
 
-typedef struct {
-	const char * name;
-	opdis_vma_t vma;
-} sym_t;
-
-static void * sym_key_vma( void * data ) {
-	sym_t * sym = (sym_t *) data;
-	return sym ? (void *) sym->vma : NULL;
+sym_tab_t sym_tab_alloc( void ) {
+	return (sym_tab_t) calloc( 1, sizeof(sym_table_t) );
 }
 
-static void * sym_key_name( void * data ) {
-	sym_t * sym = (sym_t *) data;
-	return sym ? (void *) sym->name : NULL;
-}
+void sym_tab_free( sym_tab_t s ) {
+	if (! s ) {
+		return;
+	}
 
-static int name_cmp(void *a, void * b) {
-	return strcmp( (const char *) a, (const char *) b );
+	free( s->syms );
+	free( s->by_vma );
+	free( s->by_name );
+	free(s);
 }
 
-sym_tab_t sym_tab_alloc( void ) {
-	sym_tab_t s = (sym_tab_t) calloc( 1, sizeof(sym_table_t) );
+int sym_tab_reserve( sym_tab_t s, unsigned int num ) {
+	sym_t * syms;
+	unsigned int max;
+
 	if (! s ) {
-		return NULL;
+		return 0;
 	}
 
-	s->by_vma = opdis_tree_init( sym_key_vma, NULL, free );
-	s->by_name = opdis_tree_init( sym_key_name, name_cmp, NULL );
+	if ( s->num_syms + num <= s->max_syms ) {
+		return 1;
+	}
 
-	if (! s->by_vma || ! s->by_name ) {
-		sym_tab_free(s);
-		return NULL;
+	max = s->num_syms + num;
+	syms = (sym_t *) realloc( s->syms, max * sizeof(sym_t) );
+	if (! syms ) {
+		return 0;
 	}
 
-	return s;
+	s->syms = syms;
+	s->max_syms = max;
+	return 1;
 }
 
-void sym_tab_free( sym_tab_t s ) {
-	if (! s ) {
-		return;
+int sym_tab_add( sym_tab_t s, const char * name, opdis_vma_t vma, int func ){
+	sym_t * sym;
+
+	if (! s || ! name ) {
+		return 0;
 	}
 
-	if ( s->by_vma ) {
-		opdis_tree_free(s->by_vma);
+	if ( s->num_syms == s->max_syms &&
+	     ! sym_tab_reserve( s, s->max_syms ? s->max_syms : 64 ) ) {
+		return 0;
 	}
 
-	if ( s->by_name ) {
-		opdis_tree_free(s->by_name);
+	sym = &s->syms[s->num_syms++];
+	sym->name = name;
+	sym->vma = vma;
+	sym->func = func;
+
+	s->dirty = 1;
+	return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* INDEX */
+
+static uint32_t hash_name( const char * name ) {
+	uint32_t h = 2166136261U;
+
+	for ( ; *name; name++ ) {
+		h = ( h ^ (unsigned char) *name ) * 16777619U;
 	}
 
-	free(s);
+	return h;
 }
 
-int sym_tab_add( sym_tab_t s, const char * name, opdis_vma_t vma ) {
-	sym_t * sym;
+/* return the slot for name: either the slot holding it, or an empty one */
+static unsigned int * name_slot( sym_tab_t s, const char * name ) {
+	unsigned int mask = s->num_buckets - 1;
+	unsigned int i = hash_name( name ) & mask;
 
-	if (! s || ! name ) {
-		return 0;
+	while ( s->by_name[i] &&
+		strcmp( s->syms[s->by_name[i] - 1].name, name ) ) {
+		i = ( i + 1 ) & mask;
 	}
 
-	if ( opdis_tree_find( (opdis_tree_t) s->by_name, (void *) name ) ) {
-//		fprintf( stderr, "Symbol for name %s already exists\n", name );
-		return 0;
+	return &s->by_name[i];
+}
+
+typedef struct {
+	opdis_vma_t vma;
+	unsigned int idx;
+} sym_order_t;
+
+static int cmp_order( const void * a, const void * b ) {
+	const sym_order_t * oa = (const sym_order_t *) a;
+	const sym_order_t * ob = (const sym_order_t *) b;
+
+	if ( oa->vma != ob->vma ) {
+		return ( oa->vma < ob->vma ) ? -1 : 1;
 	}
-	if ( opdis_tree_find( (opdis_tree_t) s->by_vma, (void *) vma ) ) {
-//		fprintf( stderr, "Symbol for VMA %p already exists\n", 
-//			 (void *) vma );
-		return 0;
+
+	return ( oa->idx < ob->idx ) ? -1 : ( oa->idx > ob->idx );
+}
+
+static int build_index( sym_tab_t s ) {
+	unsigned int i, j, num = s->num_syms, num_buckets = 16;
+	unsigned int * group, * by_vma, * by_name;
+	sym_order_t * order;
+	char * taken;
+
+	while ( num_buckets < num * 2 ) {
+		num_buckets *= 2;
 	}
 
-	sym = (sym_t *) calloc( 1, sizeof(sym_t) );
-	if (! sym ) {
+	order = (sym_order_t *) calloc( num + 1, sizeof(sym_order_t) );
+	group = (unsigned int *) calloc( num + 1, sizeof(unsigned int) );
+	taken = (char *) calloc( num + 1, 1 );
+	by_vma = (unsigned int *) calloc( num + 1, sizeof(unsigned int) );
+	by_name = (unsigned int *) calloc( num_buckets, sizeof(unsigned int) );
+	if (! order || ! group || ! taken || ! by_vma || ! by_name ) {
+		free( order );
+		free( group );
+		free( taken );
+		free( by_vma );
+		free( by_name );
 		return 0;
 	}
-	sym->name = name;
-	sym->vma = vma;
 
-	if (! opdis_tree_add( (opdis_tree_t) s->by_vma, sym ) ) {
-		free(sym);
-		return 0;
+	/* sort once; group[i] is the position of the first symbol with the
+	 * VMA of symbol i */
+	for ( i = 0; i < num; i++ ) {
+		order[i].vma = s->syms[i].vma;
+		order[i].idx = i;
+	}
+	qsort( order, num, sizeof(sym_order_t), cmp_order );
+	for ( i = 0, j = 0; i < num; i++ ) {
+		if ( order[i].vma != order[j].vma ) {
+			j = i;
+		}
+		group[order[i].idx] = j;
 	}
 
-	if (! opdis_tree_add( (opdis_tree_t) s->by_name, sym ) ) {
-		opdis_tree_delete( (opdis_tree_t) s->by_vma, (void *) vma );
-		return 0;
+	free( s->by_vma );
+	free( s->by_name );
+	s->by_vma = by_vma;
+	s->by_name = by_name;
+	s->num_buckets = num_buckets;
+
+	/* keep symbols in the order they were added, unless an earlier
+	 * symbol has the same name or VMA */
+	for ( i = 0; i < num; i++ ) {
+		unsigned int * slot;
+
+		if ( taken[group[i]] ) {
+			continue;
+		}
+
+		slot = name_slot( s, s->syms[i].name );
+		if ( *slot ) {
+			continue;
+		}
+
+		*slot = i + 1;
+		taken[group[i]] = 1;
+	}
+
+	/* a symbol is kept if its name maps to it */
+	s->num_vma = 0;
+	for ( i = 0; i < num; i++ ) {
+		unsigned int idx = order[i].idx;
+		if ( *name_slot( s, s->syms[idx].name ) == idx + 1 ) {
+			by_vma[s->num_vma++] = idx;
+		}
 	}
 
+	free( order );
+	free( group );
+	free( taken );
+	s->dirty = 0;
 	return 1;
 }
 
+int sym_tab_index( sym_tab_t s ) {
+	if (! s ) {
+		return 0;
+	}
+
+	return ( s->dirty || ! s->by_name ) ? build_index( s ) : 1;
+}
+
+/* lookups never build the index, so they are safe to run concurrently */
+static int have_index( sym_tab_t s ) {
+	return s && s->by_name && ! s->dirty;
+}
+
+/* position of the kept symbol for vma, or num_vma if there is none */
+static unsigned int vma_pos( sym_tab_t s, opdis_vma_t vma ) {
+	unsigned int lo = 0, hi = s->num_vma;
+
+	while ( lo < hi ) {
+		unsigned int mid = lo + ( hi - lo ) / 2;
+		if ( s->syms[s->by_vma[mid]].vma < vma ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if ( lo < s->num_vma && s->syms[s->by_vma[lo]].vma == vma ) {
+		return lo;
+	}
+	return s->num_vma;
+}
+
+/* ---------------------------------------------------------------------- */
+
 opdis_vma_t sym_tab_find_vma( sym_tab_t s, const char * name ) {
-	sym_t * sym;
-	if (! s || ! name ) {
+	unsigned int * slot;
+
+	if (! name || ! have_index( s ) ) {
 		return OPDIS_INVALID_ADDR;
 	}
 
-	sym = opdis_tree_find( (opdis_tree_t) s->by_name, (void *) name ); 
-	if ( sym ) {
-		return sym->vma;
+	slot = name_slot( s, name );
+	if ( *slot ) {
+		return s->syms[*slot - 1].vma;
 	}
 	return OPDIS_INVALID_ADDR;
 }
 
 const char * sym_tab_find_name( sym_tab_t s, opdis_vma_t vma ) {
-	sym_t * sym;
-	
-	if (! s ) {
+	unsigned int pos;
+
+	if (! have_index( s ) ) {
 		return NULL;
 	}
 
-	sym = opdis_tree_find( (opdis_tree_t) s->by_vma, (void *) vma );
-	if ( sym ) {
-		return sym->name;
+	pos = vma_pos( s, vma );
+	if ( pos < s->num_vma ) {
+		return s->syms[s->by_vma[pos]].name;
 	}
 
 	return NULL;
 }
 
-static int print_symtab( void * item, void * arg ) {
-	sym_t * sym = (sym_t *) item;
-	FILE * f = (FILE *) arg;
+void sym_tab_print( sym_tab_t s, FILE * f ) {
+	unsigned int i;
 
-	if (! sym || ! f ) {
-		return 0;
+	if (! f || ! have_index( s ) ) {
+		return;
 	}
 
-	fprintf( f, "\t%p: %s\n", (void *) sym->vma, sym->name );
-	return 1;
+	for ( i = 0; i < s->num_vma; i++ ) {
+		sym_t * sym = &s->syms[s->by_vma[i]];
+		fprintf( f, "\t%p: %s\n", (void *) sym->vma, sym->name );
+	}
 }
 
-void sym_tab_print( sym_tab_t s, FILE * f ) {
-	if (!  s ) {
+void sym_tab_foreach_func( sym_tab_t s, SYM_TAB_FOREACH_FN fn, void * arg ) {
+	unsigned int i;
+
+	if (! fn || ! have_index( s ) ) {
 		return;
 	}
 
-	opdis_tree_foreach( (opdis_tree_t) s->by_vma, print_symtab, f );
+	for ( i = 0; i < s->num_vma; i++ ) {
+		sym_t * sym = &s->syms[s->by_vma[i]];
+		if ( sym->func ) {
+			fn( sym->name, sym->vma, arg );
+		}
+	}
 }
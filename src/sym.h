@@ -1,5 +1,5 @@
 /* sym.h
- * tree of symbols in a bfd target
+ * table of symbols in a bfd target
  * Copyright (c) 2010 ThoughtGang
  * Written by TG Community Developers <community@thoughtgang.org>
  * Released under the GNU Public License, version 3.
@@ -9,11 +9,29 @@
 #ifndef OPDIS_SYM_H
 #define OPDIS_SYM_H
 
-#include <opdis/tree.h>
+#include <stdio.h>
 
+#include <opdis/types.h>
+
+typedef struct {
+	const char * name;
+	opdis_vma_t vma;
+	int func;
+} sym_t;
+
+/* symbols are appended to an array as they are added. the indexes are
+ * built in one pass by sym_tab_index: an array of the symbols sorted by
+ * VMA, and a hash table of names. When two symbols share a name or a VMA,
+ * the first one added is kept. */
 typedef struct {
-	opdis_tree_t by_name;
-	opdis_tree_t by_vma;
+	sym_t * syms;			/* symbols in the order they were added */
+	unsigned int num_syms;
+	unsigned int max_syms;
+	unsigned int * by_vma;		/* kept symbols sorted by VMA */
+	unsigned int num_vma;
+	unsigned int * by_name;		/* hash of names; index + 1, 0 = empty */
+	unsigned int num_buckets;
+	int dirty;
 } sym_table_t;
 
 typedef sym_table_t * sym_tab_t;
@@ -24,7 +42,18 @@ sym_tab_t sym_tab_alloc( void );
 
 void sym_tab_free( sym_tab_t );
 
-int sym_tab_add( sym_tab_t, const char * name, opdis_vma_t vma );
+/* make room for num more symbols, e.g. before a bulk load */
+int sym_tab_reserve( sym_tab_t, unsigned int num );
+
+/* add a symbol; func is nonzero if the symbol is a function in a code
+ * section. note: name is not copied, and duplicates are discarded when the
+ * table is next indexed. */
+int sym_tab_add( sym_tab_t, const char * name, opdis_vma_t vma, int func );
+
+/* build the indexes once all symbols have been added. lookups do not
+ * modify the table, so they find nothing until this has been called; this
+ * lets threads share a table without locking. */
+int sym_tab_index( sym_tab_t );
 
 opdis_vma_t sym_tab_find_vma( sym_tab_t, const char * name );
 
@@ -32,4 +61,10 @@ const char * sym_tab_find_name( sym_tab_t, opdis_vma_t vma );
 
 void sym_tab_print( sym_tab_t, FILE * );
 
+typedef void (*SYM_TAB_FOREACH_FN) ( const char * name, opdis_vma_t vma,
+				     void * arg );
+
+/* invoke a callback for every function symbol, in order of VMA */
+void sym_tab_foreach_func( sym_tab_t, SYM_TAB_FOREACH_FN, void * arg );
+
 #endif
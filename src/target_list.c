@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "target_list.h"
+#include "text_fmt.h"
 
 /* ---------------------------------------------------------------------- */
 
@@ -33,6 +34,10 @@ void tgt_list_free( tgt_list_t targets ) {
 			opdis_buf_free( item->data );
 		}
 
+		if ( item->sec_cache ) {
+			opdis_sec_cache_free( item->sec_cache );
+		}
+
 		if ( item->tgt_bfd ) {
 			// bfd_close ?
 		}
@@ -44,7 +49,8 @@ void tgt_list_free( tgt_list_t targets ) {
 }
 
 static opdis_buf_t load_bytes( const char * bytes ) {
-	char *str, * p, * tok, *err;
+	char *str, * p, * tok, *err = NULL;
+	unsigned long val;
 	opdis_buf_t buf;
 	int i, count, base = 16;
 
@@ -83,12 +89,13 @@ static opdis_buf_t load_bytes( const char * bytes ) {
 			break;
 		}
 
-		buf->data[i] = (opdis_byte_t) strtoul( tok, &err, base );
-		if ( err && *err != '\0' ) {
+		if (! txt_parse( tok, base, &val ) ) {
 			fprintf( stderr, "Invalid number %s for base %d\n", 
 				 tok, base );
+			err = tok;
 			break;
 		}
+		buf->data[i] = (opdis_byte_t) val;
 	}
 	free(str);
 
@@ -101,23 +108,16 @@ static opdis_buf_t load_bytes( const char * bytes ) {
 }
 
 static opdis_buf_t load_file( const char * path ) {
-	FILE * f;
 	opdis_buf_t buf;
 
-	f = fopen( path, "r" );
-	if (! f ) {
-		fprintf( stderr, "Unable to open %s: %s\n", path, 
-			 strerror(errno) );
-		return NULL;
-	}
-
-	buf = opdis_buf_read( f, 0, 0 );
+	/* file is mapped, not copied, into memory where possible */
+	errno = 0;
+	buf = opdis_buf_map( path, 0 );
 	if (! buf ) {
-		fprintf( stderr, "Unable to read %s into buffer\n", path );
+		fprintf( stderr, "Unable to read %s into buffer: %s\n", path, 
+			 strerror(errno) );
 	}
 
-	fclose( f );
-
 	return buf;
 }
 
@@ -171,10 +171,14 @@ static void load_bfd_symbols( sym_tab_t symtab, asymbol ** syms,
 	unsigned int i;
 	symbol_info info;
 
+	sym_tab_reserve( symtab, num_syms );
 	for ( i = 0; i < num_syms; i++ ) {
+		asection * sec = syms[i]->section;
+		int func = ( (syms[i]->flags & BSF_FUNCTION) && sec &&
+			     (bfd_get_section_flags(sec->owner, sec) & 
+			      SEC_CODE) );
 		bfd_symbol_info( syms[i], &info );
-		// TODO: check symbol type
-		sym_tab_add( symtab, info.name, info.value );
+		sym_tab_add( symtab, info.name, info.value, func );
 	}
 }
 
@@ -206,6 +210,9 @@ static void load_symbols( bfd * abfd, sym_tab_t symtab ) {
 			free(syms);
 		}
 	}
+
+	/* index now: jobs look symbols up from worker threads */
+	sym_tab_index( symtab );
 }
 
 int tgt_list_make_bfd( tgt_list_item_t * tgt ) {
@@ -231,7 +238,10 @@ int tgt_list_make_bfd( tgt_list_item_t * tgt ) {
 		load_symbols( tgt->tgt_bfd, tgt->symtab );
 	}
 
-	// TODO: delete data
+	/* shared by all jobs on this target */
+	tgt->sec_cache = opdis_sec_cache_init( tgt->tgt_bfd, 0 );
+
+	/* data is kept: BFD sections are disassembled in place from it */
 
 	return 1;
 }
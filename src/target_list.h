@@ -11,6 +11,7 @@
 #define TARGET_LIST_H
 
 #include <opdis/types.h>
+#include <opdis/sec_cache.h>
 
 #include "sym.h"
 
@@ -29,6 +30,7 @@ typedef struct TARGET_LIST_ITEM {
 					   bytes */
 	opdis_buf_t data;		/* binary data for target */
 	bfd * tgt_bfd;			/* BFD for target, if applicable */
+	opdis_sec_cache_t sec_cache;	/* BFD section index and contents */
 	sym_tab_t symtab;		/* BFD symbols */
 	struct TARGET_LIST_ITEM * next;
 } tgt_list_item_t;
@@ -0,0 +1,269 @@
+/* text_fmt.c
+ * number and byte formatting into caller buffers
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <string.h>
+
+/* define TXT_SCALAR to build without the SIMD byte-to-hex paths */
+#if defined(TXT_SCALAR)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TXT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TXT_NEON
+#endif
+
+#include "text_fmt.h"
+
+static const char hex_upper[] = "0123456789ABCDEF";
+static const char hex_lower[] = "0123456789abcdef";
+
+/* "00" to "99": two decimal digits are emitted per division */
+static const char dec_pairs[] =
+	"00010203040506070809101112131415161718192021222324"
+	"25262728293031323334353637383940414243444546474849"
+	"50515253545556575859606162636465666768697071727374"
+	"75767778798081828384858687888990919293949596979899";
+
+/* value of each char as a digit; 36 is not a digit in any base */
+static const unsigned char digit_val[256] = {
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 36, 36, 36, 36, 36, 36,
+	36, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+	25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 36, 36, 36, 36,
+	36, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+	25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+	36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+};
+
+/* ---------------------------------------------------------------------- */
+/* BYTES */
+
+/* hex digit pairs of 16 bytes: out[2i] and out[2i+1] are in[i] */
+static void hex16( char * out, const unsigned char * in ) {
+#if defined(TXT_SSE2)
+	__m128i v = _mm_loadu_si128( (const __m128i *) in );
+	__m128i nib = _mm_set1_epi8( 0x0F );
+	__m128i nine = _mm_set1_epi8( 9 );
+	__m128i zero = _mm_set1_epi8( '0' );
+	__m128i alpha = _mm_set1_epi8( 'A' - '0' - 10 );
+	__m128i hi = _mm_and_si128( _mm_srli_epi16( v, 4 ), nib );
+	__m128i lo = _mm_and_si128( v, nib );
+
+	/* '0' + n, plus the gap to 'A' for n > 9 */
+	hi = _mm_add_epi8( _mm_add_epi8( hi, zero ),
+			   _mm_and_si128( _mm_cmpgt_epi8( hi, nine ), alpha ) );
+	lo = _mm_add_epi8( _mm_add_epi8( lo, zero ),
+			   _mm_and_si128( _mm_cmpgt_epi8( lo, nine ), alpha ) );
+
+	_mm_storeu_si128( (__m128i *) out, _mm_unpacklo_epi8( hi, lo ) );
+	_mm_storeu_si128( (__m128i *) &out[16], _mm_unpackhi_epi8( hi, lo ) );
+#elif defined(TXT_NEON)
+	uint8x16_t v = vld1q_u8( in );
+	uint8x16_t nine = vdupq_n_u8( 9 );
+	uint8x16_t zero = vdupq_n_u8( '0' );
+	uint8x16_t alpha = vdupq_n_u8( 'A' - '0' - 10 );
+	uint8x16_t hi = vshrq_n_u8( v, 4 );
+	uint8x16_t lo = vandq_u8( v, vdupq_n_u8( 0x0F ) );
+	uint8x16x2_t pairs;
+
+	pairs.val[0] = vaddq_u8( vaddq_u8( hi, zero ),
+				 vandq_u8( vcgtq_u8( hi, nine ), alpha ) );
+	pairs.val[1] = vaddq_u8( vaddq_u8( lo, zero ),
+				 vandq_u8( vcgtq_u8( lo, nine ), alpha ) );
+
+	/* interleaving store: hi, lo, hi, lo ... */
+	vst2q_u8( (uint8_t *) out, pairs );
+#else
+	int i;
+
+	for ( i = 0; i < 16; i++ ) {
+		out[2 * i] = hex_upper[in[i] >> 4];
+		out[2 * i + 1] = hex_upper[in[i] & 0x0F];
+	}
+#endif
+}
+
+size_t txt_hex_bytes( char * out, const unsigned char * bytes, size_t n,
+		      char sep ) {
+	char pairs[32];
+	unsigned char block[16];
+	size_t i, j, k, len = 0;
+
+	for ( i = 0; i < n; i += 16 ) {
+		k = ( n - i < 16 ) ? n - i : 16;
+
+		/* the vector load must not read past the end of bytes */
+		if ( k < 16 ) {
+			memset( block, 0, sizeof(block) );
+			memcpy( block, &bytes[i], k );
+			hex16( pairs, block );
+		} else {
+			hex16( pairs, &bytes[i] );
+		}
+
+		if (! sep ) {
+			memcpy( &out[len], pairs, 2 * k );
+			len += 2 * k;
+			continue;
+		}
+
+		for ( j = 0; j < k; j++ ) {
+			if ( i + j ) {
+				out[len++] = sep;
+			}
+			out[len++] = pairs[2 * j];
+			out[len++] = pairs[2 * j + 1];
+		}
+	}
+
+	return len;
+}
+
+size_t txt_hex_byte( char * out, unsigned char byte ) {
+	out[0] = hex_upper[byte >> 4];
+	out[1] = hex_upper[byte & 0x0F];
+	return 2;
+}
+
+/* ---------------------------------------------------------------------- */
+/* NUMBERS */
+
+size_t txt_hex( char * out, uint64_t val, int upper ) {
+	const char * digits = ( upper ) ? hex_upper : hex_lower;
+	char buf[16];
+	size_t i = sizeof(buf);
+
+	do {
+		buf[--i] = digits[val & 0x0F];
+		val >>= 4;
+	} while ( val );
+
+	memcpy( out, &buf[i], sizeof(buf) - i );
+	return sizeof(buf) - i;
+}
+
+size_t txt_hex_alt( char * out, uint64_t val ) {
+	if (! val ) {
+		out[0] = '0';
+		return 1;
+	}
+
+	out[0] = '0';
+	out[1] = 'X';
+	return 2 + txt_hex( &out[2], val, 1 );
+}
+
+size_t txt_addr( char * out, uint64_t val ) {
+	out[0] = '0';
+	out[1] = 'x';
+	return 2 + txt_hex( &out[2], val, 0 );
+}
+
+size_t txt_udec( char * out, uint64_t val ) {
+	char buf[20];
+	size_t i = sizeof(buf);
+	unsigned int d;
+
+	while ( val >= 100 ) {
+		d = (unsigned int) ( val % 100 ) * 2;
+		val /= 100;
+		buf[--i] = dec_pairs[d + 1];
+		buf[--i] = dec_pairs[d];
+	}
+
+	if ( val >= 10 ) {
+		d = (unsigned int) val * 2;
+		buf[--i] = dec_pairs[d + 1];
+		buf[--i] = dec_pairs[d];
+	} else {
+		buf[--i] = (char) ( '0' + val );
+	}
+
+	memcpy( out, &buf[i], sizeof(buf) - i );
+	return sizeof(buf) - i;
+}
+
+size_t txt_sdec( char * out, int64_t val ) {
+	if ( val < 0 ) {
+		out[0] = '-';
+		return 1 + txt_udec( &out[1], - (uint64_t) val );
+	}
+
+	return txt_udec( out, (uint64_t) val );
+}
+
+size_t txt_oct( char * out, uint64_t val ) {
+	char buf[22];
+	size_t i = sizeof(buf);
+
+	do {
+		buf[--i] = (char) ( '0' + ( val & 7 ) );
+		val >>= 3;
+	} while ( val );
+
+	memcpy( out, &buf[i], sizeof(buf) - i );
+	return sizeof(buf) - i;
+}
+
+/* ---------------------------------------------------------------------- */
+/* PARSING */
+
+int txt_parse( const char * str, int base, unsigned long * val ) {
+	const unsigned char * s = (const unsigned char *) str;
+	unsigned long v = 0, limit;
+	unsigned int digit;
+	int neg = 0, over = 0;
+
+	if ( base < 2 || base > 36 ) {
+		return 0;
+	}
+
+	while ( isspace( *s ) ) {
+		s++;
+	}
+	if ( *s == '-' || *s == '+' ) {
+		neg = ( *s == '-' );
+		s++;
+	}
+	if ( base == 16 && s[0] == '0' && ( s[1] == 'x' || s[1] == 'X' ) &&
+	     digit_val[s[2]] < 16 ) {
+		s += 2;
+	}
+
+	if ( digit_val[*s] >= base ) {
+		return 0;
+	}
+
+	limit = ULONG_MAX / base;
+	for ( ; ( digit = digit_val[*s] ) < (unsigned int) base; s++ ) {
+		if ( v > limit || v * base > ULONG_MAX - digit ) {
+			over = 1;
+		}
+		v = v * base + digit;
+	}
+
+	if ( *s ) {
+		return 0;
+	}
+
+	/* as strtoul, a value which does not fit is ULONG_MAX */
+	*val = ( over ) ? ULONG_MAX : ( neg ) ? - v : v;
+	return 1;
+}
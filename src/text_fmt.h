@@ -0,0 +1,54 @@
+/* text_fmt.h
+ * number and byte formatting into caller buffers, used by the output
+ * formats and the -b byte loader in place of printf and strtoul
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_TEXT_FMT_H
+#define OPDIS_TEXT_FMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* longest output of a number function: 22 octal digits of a uint64_t */
+#define TXT_NUM_MAX 24
+
+/* room needed for the output of txt_hex_bytes for n bytes */
+#define TXT_HEX_BYTES_LEN(n, sep) ( (sep) ? 3 * (n) : 2 * (n) )
+
+/* ---------------------------------------------------------------------- */
+/* None of these write a terminating '\0'; each returns the number of
+ * chars written. */
+
+/* two uppercase hex digits per byte, separated by sep if it is not 0 */
+size_t txt_hex_bytes( char * out, const unsigned char * bytes, size_t n,
+		      char sep );
+
+/* two uppercase hex digits: as "%02X" */
+size_t txt_hex_byte( char * out, unsigned char byte );
+
+/* uppercase or lowercase hex digits, without a prefix: as "%llX" */
+size_t txt_hex( char * out, uint64_t val, int upper );
+
+/* hex with a "0X" prefix unless val is 0: as "%#llX" */
+size_t txt_hex_alt( char * out, uint64_t val );
+
+/* "0x" and lowercase hex digits: as "%p", but 0 is "0x0" */
+size_t txt_addr( char * out, uint64_t val );
+
+/* decimal: as "%llu" and "%lld" */
+size_t txt_udec( char * out, uint64_t val );
+size_t txt_sdec( char * out, int64_t val );
+
+/* octal: as "%llo" */
+size_t txt_oct( char * out, uint64_t val );
+
+/* parse a number in base 2 to 36, with an optional "0x" prefix in base 16.
+ * Returns 0 unless all of str was parsed; as strtoul, leading whitespace
+ * and a sign are allowed, and a value which does not fit is ULONG_MAX */
+int txt_parse( const char * str, int base, unsigned long * val );
+
+#endif
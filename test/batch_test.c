@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+#define MAX_INSNS 32
+
+/* 0x1000: push; je 0x1006; nop; jmp 0x1008; nop; nop; call 0x1011; pop;
+ *         ret; nop; nop; nop; ret */
+static const unsigned char code[] = {
+	0x55, 0x74, 0x03, 0x90, 0xEB, 0x02, 0x90, 0x90,
+	0xE8, 0x04, 0x00, 0x00, 0x00, 0x5D, 0xC3, 0x90,
+	0x90, 0x90, 0xC3
+};
+
+struct RESULT {
+	opdis_vma_t vma[MAX_INSNS];
+	unsigned int num;
+	unsigned int batches;
+	unsigned int max_batch;
+	unsigned int stop_after;	/* stop after this many batches */
+};
+
+static void display( const opdis_insn_t * insn, void * arg ) {
+	struct RESULT * r = (struct RESULT *) arg;
+	if ( r->num < MAX_INSNS ) {
+		r->vma[r->num++] = insn->vma;
+	}
+}
+
+static int batch( const opdis_insn_t * insns, size_t n, void * arg ) {
+	struct RESULT * r = (struct RESULT *) arg;
+	size_t i;
+
+	for ( i = 0; i < n; i++ ) {
+		display( &insns[i], arg );
+	}
+	r->batches++;
+	if ( n > r->max_batch ) {
+		r->max_batch = n;
+	}
+
+	return ( r->batches != r->stop_after );
+}
+
+/* disassemble with display callback, then with batches of 3 insns */
+static int check( const char * name, opdis_t o, opdis_buf_t buf, int cflow,
+		  unsigned int stop_after ) {
+	struct RESULT d = {{0}}, b = {{0}};
+	int ok;
+
+	opdis_set_display( o, display, &d );
+	opdis_set_batch_handler( o, NULL, NULL, 0 );
+	opdis_visited_clear( o->visited_addr );
+	if ( cflow ) {
+		opdis_disasm_cflow( o, buf, buf->vma );
+	} else {
+		opdis_disasm_linear( o, buf, buf->vma, 0 );
+	}
+
+	b.stop_after = stop_after;
+	opdis_set_batch_handler( o, batch, &b, 3 );
+	opdis_visited_clear( o->visited_addr );
+	if ( cflow ) {
+		opdis_disasm_cflow( o, buf, buf->vma );
+	} else {
+		opdis_disasm_linear( o, buf, buf->vma, 0 );
+	}
+
+	if ( stop_after ) {
+		ok = ( b.batches == stop_after && b.num == stop_after * 3 &&
+		       ! memcmp( d.vma, b.vma, b.num * sizeof(opdis_vma_t) ) );
+	} else {
+		ok = ( d.num == b.num && b.max_batch == 3 &&
+		       b.batches == ( d.num + 2 ) / 3 &&
+		       ! memcmp( d.vma, b.vma, d.num * sizeof(opdis_vma_t) ) );
+	}
+
+	printf( "%-8s Insns: %u/%u Batches: %u OK: %d\n", name, b.num, d.num,
+		b.batches, ok );
+	return ok;
+}
+
+int main( void ) {
+	opdis_buf_t buf = opdis_buf_alloc( sizeof(code), 0x1000 );
+	opdis_t o = opdis_init();
+	opdis_insn_t * insn = opdis_insn_alloc_fixed( 128, 32, 16, 32 );
+	struct RESULT r = {{0}};
+	int ok = 1;
+
+	memcpy( buf->data, code, sizeof(code) );
+	o->visited_addr = opdis_visited_init();
+
+	ok &= check( "linear", o, buf, 0, 0 );
+	ok &= check( "cflow", o, buf, 1, 0 );
+	ok &= check( "stop", o, buf, 0, 2 );
+
+	/* a single insn is passed as a batch of one */
+	opdis_set_batch_handler( o, batch, &r, 0 );
+	ok &= ( o->batch_size == OPDIS_BATCH_SIZE );
+	ok &= ( opdis_disasm_insn( o, buf, 0x1001, insn ) == 2 );
+	ok &= ( r.batches == 1 && r.num == 1 && r.vma[0] == 0x1001 );
+
+	opdis_insn_free( insn );
+	opdis_visited_free( o->visited_addr );
+	opdis_term( o );
+	opdis_buf_free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
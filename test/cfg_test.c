@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+/* 0x1000: push; je 0x1006; nop; jmp 0x1008; nop; nop; call 0x1011; pop;
+ *         ret; nop; nop; nop; ret */
+static const unsigned char code[] = {
+	0x55, 0x74, 0x03, 0x90, 0xEB, 0x02, 0x90, 0x90,
+	0xE8, 0x04, 0x00, 0x00, 0x00, 0x5D, 0xC3, 0x90,
+	0x90, 0x90, 0xC3
+};
+
+struct BLOCK_CASE {
+	opdis_vma_t vma;
+	opdis_off_t size;
+	unsigned int num_insns;
+	opdis_vma_t func;
+};
+
+/* blocks after disassembly from 0x1006, then from 0x1000 */
+static const struct BLOCK_CASE blocks[] = {
+	{ 0x1000, 3, 2, 0x1000 },
+	{ 0x1003, 3, 2, 0x1000 },
+	{ 0x1006, 2, 2, 0x1006 },
+	{ 0x1008, 5, 1, 0x1006 },	/* split by jmp 0x1008 */
+	{ 0x100D, 2, 2, 0x1006 },
+	{ 0x1011, 2, 2, 0x1011 }
+};
+
+static int has_edge( opdis_cfg_t cfg, opdis_vma_t src, opdis_vma_t dest,
+		     enum opdis_cfg_edge_type_t type ) {
+	const opdis_cfg_block_t * b = opdis_cfg_find_block( cfg, src );
+	const opdis_cfg_edge_t * e;
+	unsigned int i, found = 0;
+
+	for ( i = 0; (e = opdis_cfg_succ( cfg, b, i )); i++ ) {
+		if ( cfg->blocks[e->dest].vma == dest && e->type == type ) {
+			found++;
+		}
+	}
+
+	/* the edge must also be a predecessor of dest */
+	b = opdis_cfg_find_block( cfg, dest );
+	for ( i = 0; (e = opdis_cfg_pred( cfg, b, i )); i++ ) {
+		if ( cfg->blocks[e->src].vma == src && e->type == type ) {
+			found++;
+		}
+	}
+
+	if ( found != 2 ) {
+		printf( "Edge %p -> %p missing\n", (void *) src, (void *) dest );
+	}
+	return ( found == 2 );
+}
+
+static int print_block( opdis_cfg_t cfg, const opdis_cfg_block_t * b,
+			void * arg ) {
+	int * count = (int *) arg;
+
+	printf( "Block %p: %u bytes, %u insns, %u succ, %u pred\n",
+		(void *) b->vma, (unsigned int) b->size, b->num_insns,
+		b->num_succ, b->num_pred );
+	(*count)++;
+	return 1;
+}
+
+static int check_blocks( opdis_cfg_t cfg ) {
+	unsigned int i;
+	int ok = 1, count = 0;
+
+	opdis_cfg_foreach_block( cfg, print_block, &count );
+	ok &= ( count == sizeof(blocks) / sizeof(blocks[0]) );
+
+	for ( i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++ ) {
+		const opdis_cfg_block_t * b;
+		b = opdis_cfg_find_block( cfg, blocks[i].vma + blocks[i].size - 1 );
+		if (! b || b->vma != blocks[i].vma || b->size != blocks[i].size ||
+		     b->num_insns != blocks[i].num_insns ||
+		     b->func == OPDIS_CFG_NONE ||
+		     cfg->funcs[b->func].vma != blocks[i].func ) {
+			printf( "Block %p does not match\n",
+				(void *) blocks[i].vma );
+			ok = 0;
+		}
+	}
+
+	ok &= ( cfg->num_edges == 6 );
+	ok &= has_edge( cfg, 0x1000, 0x1003, opdis_cfg_edge_fallthrough );
+	ok &= has_edge( cfg, 0x1000, 0x1006, opdis_cfg_edge_jump );
+	ok &= has_edge( cfg, 0x1003, 0x1008, opdis_cfg_edge_jump );
+	ok &= has_edge( cfg, 0x1006, 0x1008, opdis_cfg_edge_fallthrough );
+	ok &= has_edge( cfg, 0x1008, 0x100D, opdis_cfg_edge_fallthrough );
+	ok &= has_edge( cfg, 0x1008, 0x1011, opdis_cfg_edge_call );
+
+	/* padding was never disassembled */
+	ok &= ( opdis_cfg_find_block( cfg, 0x100F ) == NULL );
+
+	return ok;
+}
+
+int main( void ) {
+	opdis_buf_t buf = opdis_buf_alloc( sizeof(code), 0x1000 );
+	opdis_cfg_t cfg = opdis_cfg_init();
+	const opdis_cfg_func_t * f;
+	opdis_t o = opdis_init();
+	int ok = 1, count = 0;
+
+	memcpy( buf->data, code, sizeof(code) );
+	o->visited_addr = opdis_visited_init();
+	opdis_set_cfg( o, cfg );
+
+	/* the second disassembly jumps into a block built by the first */
+	ok &= ( opdis_disasm_cflow( o, buf, 0x1006 ) > 0 );
+	ok &= ( opdis_cfg_build( cfg ) == 3 );
+	ok &= ( opdis_cfg_find_block( cfg, 0x1008 )->vma == 0x1006 );
+	ok &= ( opdis_disasm_cflow( o, buf, 0x1000 ) > 0 );
+	ok &= check_blocks( cfg );
+
+	/* functions: the first entry point claims the shared blocks */
+	ok &= ( cfg->num_funcs == 3 );
+	f = opdis_cfg_find_func( cfg, 0x1006 );
+	ok &= ( f && f->num_blocks == 3 &&
+		cfg->blocks[cfg->func_blocks[f->first]].vma == 0x1006 );
+	f = opdis_cfg_find_func( cfg, 0x1000 );
+	opdis_cfg_foreach_func_block( cfg, f, print_block, &count );
+	ok &= ( f && f->num_blocks == 2 && count == 2 );
+	ok &= ( opdis_cfg_find_func( cfg, 0x1003 ) == NULL );
+
+	opdis_set_cfg( o, NULL );
+	opdis_visited_free( o->visited_addr );
+	opdis_term( o );
+	opdis_buf_free( buf );
+	opdis_cfg_free( cfg );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <opdis/opdis.h>
+
+#define NUM_INSNS 4096
+#define INSN_SIZE 5
+#define NUM_THREADS 4
+
+/* one slot per instruction: threads write to different slots */
+static char classic_out[NUM_INSNS][64];
+static char ctx_out[NUM_INSNS][64];
+
+struct THREAD_ARG {
+	opdis_t o;
+	opdis_buf_t buf;
+	opdis_vma_t vma;
+	opdis_off_t len;
+	int count;
+};
+
+static void store_insn( const opdis_insn_t * insn, void * arg ) {
+	char (*out)[64] = (char (*)[64]) arg;
+	unsigned int idx = insn->vma / INSN_SIZE;
+
+	if ( idx < NUM_INSNS ) {
+		strncpy( out[idx], insn->ascii, 63 );
+	}
+}
+
+static void * decode_range( void * arg ) {
+	struct THREAD_ARG * t = (struct THREAD_ARG *) arg;
+	opdis_ctx_t ctx = opdis_ctx_init( t->o );
+
+	t->count = opdis_ctx_disasm_linear( ctx, t->buf, t->vma, t->len );
+	opdis_ctx_free( ctx );
+
+	return NULL;
+}
+
+int main( void ) {
+	struct THREAD_ARG args[NUM_THREADS];
+	pthread_t threads[NUM_THREADS];
+	opdis_buf_t buf;
+	opdis_ctx_t ctx;
+	opdis_t o;
+	opdis_off_t chunk = (NUM_INSNS / NUM_THREADS) * INSN_SIZE;
+	int i, count, total = 0, priv_ok, ok;
+
+	/* mov $i, %eax */
+	buf = opdis_buf_alloc( NUM_INSNS * INSN_SIZE, 0 );
+	for ( i = 0; i < NUM_INSNS; i++ ) {
+		buf->data[i * INSN_SIZE] = 0xB8;
+		memcpy( &buf->data[i * INSN_SIZE + 1], &i, 4 );
+	}
+
+	o = opdis_init();
+	opdis_set_display( o, store_insn, classic_out );
+	count = opdis_disasm_linear( o, buf, 0, 0 );
+
+	/* libopcodes state in private_data is not shared with contexts */
+	o->config.private_data = &count;
+	ctx = opdis_ctx_init( o );
+	priv_ok = ( ctx && ctx->config->private_data == NULL );
+	opdis_ctx_free( ctx );
+	o->config.private_data = NULL;
+
+	/* all threads share o: each decodes its own range */
+	opdis_set_display( o, store_insn, ctx_out );
+	for ( i = 0; i < NUM_THREADS; i++ ) {
+		args[i].o = o;
+		args[i].buf = buf;
+		args[i].vma = i * chunk;
+		args[i].len = chunk;
+		pthread_create( &threads[i], NULL, decode_range, &args[i] );
+	}
+	for ( i = 0; i < NUM_THREADS; i++ ) {
+		pthread_join( threads[i], NULL );
+		total += args[i].count;
+	}
+
+	ok = ( priv_ok && count == NUM_INSNS && total == NUM_INSNS );
+	for ( i = 0; i < NUM_INSNS; i++ ) {
+		if ( strcmp( classic_out[i], ctx_out[i] ) ) {
+			printf( "Insn %d: '%s' != '%s'\n", i, classic_out[i],
+				ctx_out[i] );
+			ok = 0;
+			break;
+		}
+	}
+
+	printf( "Classic: %d Threaded: %d\n", count, total );
+
+	opdis_term( o );
+	opdis_buf_free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+#include "test_code.h"
+
+#define BUF_SIZE 0x8000
+
+struct INSN_LIST {
+	char (*ascii)[128];
+	opdis_vma_t * target;
+	unsigned int count;
+};
+
+static void store_insn( const opdis_insn_t * insn, void * arg ) {
+	struct INSN_LIST * l = (struct INSN_LIST *) arg;
+
+	if ( l->count < BUF_SIZE ) {
+		snprintf( l->ascii[l->count], 128, "%p %s|%s",
+			  (void *) insn->vma, insn->ascii,
+			  insn->comment ? insn->comment : "" );
+		l->target[l->count] = ( insn->target ) ?
+				insn->target->value.immediate.vma : 0;
+	}
+	l->count++;
+}
+
+static void list_init( struct INSN_LIST * l ) {
+	l->ascii = (char (*)[128]) calloc( BUF_SIZE, 128 );
+	l->target = (opdis_vma_t *) calloc( BUF_SIZE, sizeof(opdis_vma_t) );
+	l->count = 0;
+}
+
+static void list_term( struct INSN_LIST * l ) {
+	free( l->ascii );
+	free( l->target );
+}
+
+static int compare( const char * name, struct INSN_LIST * a,
+		    struct INSN_LIST * b ) {
+	unsigned int i;
+	int ok = ( a->count == b->count );
+
+	for ( i = 0; ok && i < a->count; i++ ) {
+		if ( strcmp( a->ascii[i], b->ascii[i] ) ||
+		     a->target[i] != b->target[i] ) {
+			printf( "%s insn %u: '%s' != '%s'\n", name, i,
+				a->ascii[i], b->ascii[i] );
+			ok = 0;
+		}
+	}
+
+	printf( "%-6s Uncached: %u Cached: %u\n", name, a->count, b->count );
+	return ok;
+}
+
+/* disassemble buf without and then with the cache; the cached insns are
+ * returned in out if it is not NULL */
+static int run( opdis_t o, opdis_buf_t buf, enum opdis_x86_syntax_t syntax,
+		opdis_decode_cache_t cache, const char * name,
+		struct INSN_LIST * out ) {
+	struct INSN_LIST plain, cached;
+	int ok;
+
+	list_init( &plain );
+	list_init( &cached );
+	opdis_set_x86_syntax( o, syntax );
+
+	opdis_set_decode_cache( o, NULL );
+	opdis_set_display( o, store_insn, &plain );
+	opdis_disasm_linear( o, buf, 0x1000, 0 );
+
+	opdis_set_decode_cache( o, cache );
+	opdis_set_display( o, store_insn, &cached );
+	opdis_disasm_linear( o, buf, 0x1000, 0 );
+	opdis_set_decode_cache( o, NULL );
+
+	ok = compare( name, &plain, &cached );
+	list_term( &plain );
+	if ( out ) {
+		*out = cached;
+	} else {
+		list_term( &cached );
+	}
+
+	return ok;
+}
+
+/* relative branches: each encoding misses at its first address, is verified
+ * at its second, and hits at every other. The target is rebased in the
+ * operand and in the ascii, where libopcodes pads it to 8 digits. */
+static int check_relative( opdis_t o, opdis_decode_cache_t cache ) {
+	static const struct {
+		unsigned int size;
+		const char * bytes;
+		int32_t disp;
+	} branches[] = {
+		{ 5, "\xE8\x10\x00\x00\x00", 0x10 },		/* call rel32 */
+		{ 5, "\xE9\xF0\xFF\xFF\xFF", -0x10 },		/* jmp rel32 */
+		{ 6, "\x0F\x85\x00\x01\x00\x00", 0x100 },	/* jne rel32 */
+		{ 2, "\xEB\xFC", -4 }				/* jmp rel8 */
+	};
+	const unsigned int num = sizeof(branches) / sizeof(branches[0]);
+	const unsigned int copies = 8;
+	unsigned long hits = cache->hits, misses = cache->misses;
+	struct INSN_LIST cached;
+	opdis_vma_t vma = 0x1000;
+	opdis_buf_t buf;
+	unsigned int i, size = 0;
+	int ok;
+
+	for ( i = 0; i < num; i++ ) {
+		size += branches[i].size * copies;
+	}
+	buf = opdis_buf_alloc( size, 0x1000 );
+	for ( size = 0, i = 0; i < num * copies; i++ ) {
+		memcpy( &buf->data[size], branches[i % num].bytes,
+			branches[i % num].size );
+		size += branches[i % num].size;
+	}
+
+	ok = run( o, buf, opdis_x86_syntax_att, cache, "rel", &cached );
+	hits = cache->hits - hits;
+	misses = cache->misses - misses;
+	printf( "Hits: %lu Misses: %lu\n", hits, misses );
+	ok &= ( hits == num * ( copies - 2 ) && misses == num * 2 );
+
+	for ( i = 0; ok && i < num * copies; i++ ) {
+		opdis_vma_t target = vma + branches[i % num].size +
+				     branches[i % num].disp;
+		char text[32];
+
+		snprintf( text, sizeof(text), "0x%08llx|",
+			  (unsigned long long) target );
+		if ( cached.target[i] != target ||
+		     ! strstr( cached.ascii[i], text ) ) {
+			printf( "rel insn %u: '%s', expected target %s\n", i,
+				cached.ascii[i], text );
+			ok = 0;
+		}
+		vma += branches[i % num].size;
+	}
+
+	list_term( &cached );
+	opdis_buf_free( buf );
+	return ok;
+}
+
+int main( void ) {
+	opdis_decode_cache_t cache = opdis_decode_cache_init( 0 );
+	opdis_buf_t buf;
+	opdis_t o;
+	int ok = 1;
+
+	static const unsigned char fwait[] = {
+		0x9B, 0x90, 0x9B, 0x90, 0x9B, 0xDF, 0xE0, 0x9B, 0xDF, 0xE0,
+		0x9B, 0x90
+	};
+
+	/* a few encodings repeated throughout the buffer: relative calls and
+	 * jumps, rip-independent stack ops, immediates and nops */
+	buf = opdis_buf_alloc( BUF_SIZE, 0x1000 );
+	test_fill_encodings( buf, 1 );
+
+	o = opdis_init();
+	ok &= run( o, buf, opdis_x86_syntax_att, cache, "att", NULL );
+	printf( "Hits: %lu Misses: %lu Encodings: %lu\n", cache->hits,
+		cache->misses, (unsigned long) cache->num );
+	ok &= ( cache->hits > cache->misses );
+
+	/* the same bytes in another syntax must not hit AT&T templates */
+	ok &= run( o, buf, opdis_x86_syntax_intel, cache, "intel", NULL );
+	printf( "Hits: %lu Misses: %lu Encodings: %lu\n", cache->hits,
+		cache->misses, (unsigned long) cache->num );
+
+	opdis_decode_cache_clear( cache );
+	ok &= ( cache->num == 0 );
+
+	ok &= check_relative( o, cache );
+	opdis_decode_cache_clear( cache );
+
+	/* libopcodes reads the byte after a FWAIT to see whether it prefixes
+	 * an x87 insn: the cached 'fwait' of 9B 90 must not be used for the
+	 * 'fstsw %ax' of 9B DF E0 */
+	opdis_buf_free( buf );
+	buf = opdis_buf_alloc( sizeof(fwait), 0x1000 );
+	memcpy( buf->data, fwait, sizeof(fwait) );
+	ok &= run( o, buf, opdis_x86_syntax_att, cache, "fwait", NULL );
+
+	opdis_term( o );
+	opdis_buf_free( buf );
+	opdis_decode_cache_free( cache );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+/* 0x1000: push; je 0x1006; nop; jmp 0x1008; nop; nop; call 0x1011; pop;
+ *         ret; nop; nop; nop; ret */
+static const unsigned char code[] = {
+	0x55, 0x74, 0x03, 0x90, 0xEB, 0x02, 0x90, 0x90,
+	0xE8, 0x04, 0x00, 0x00, 0x00, 0x5D, 0xC3, 0x90,
+	0x90, 0x90, 0xC3
+};
+
+struct RESULT {
+	unsigned int num;
+	unsigned int bad;
+	enum opdis_insn_decode_t mask;
+};
+
+/* every insn must have been decoded at exactly the requested levels */
+static void display( const opdis_insn_t * insn, void * arg ) {
+	struct RESULT * r = (struct RESULT *) arg;
+	unsigned int i;
+	int ok = ( insn->status == r->mask && insn->size > 0 &&
+		   insn->ascii[0] );
+
+	if (! (r->mask & opdis_decode_mnem) ) {
+		ok &= (! insn->mnemonic[0] && ! insn->num_prefixes );
+	} else {
+		ok &= ( insn->mnemonic[0] != 0 );
+	}
+
+	if (! (r->mask & opdis_decode_ops) ) {
+		ok &= (! insn->num_operands && ! insn->target );
+	}
+
+	if (! (r->mask & opdis_decode_mnem_flags) ) {
+		ok &= ( (int) insn->category == 0 );
+	}
+
+	for ( i = 0; i < insn->num_operands; i++ ) {
+		const opdis_op_t * op = insn->operands[i];
+		ok &= ( op->ascii[0] != 0 );
+		if ( op == insn->target ) {
+			/* the branch target is decoded for cflow */
+			ok &= ( op->category == opdis_op_cat_immediate );
+		} else if (! (r->mask & opdis_decode_op_flags) ) {
+			ok &= ( op->category == opdis_op_cat_unknown );
+		}
+	}
+
+	if (! ok ) {
+		printf( "\t%p: '%s' status %d mnem '%s' ops %d\n",
+			(void *) insn->vma, insn->ascii, insn->status,
+			insn->mnemonic, (int) insn->num_operands );
+		r->bad++;
+	}
+	r->num++;
+}
+
+static int check( opdis_t o, opdis_buf_t buf, const char * name,
+		  enum opdis_insn_decode_t mask, int cflow,
+		  unsigned int expect ) {
+	struct RESULT r = { 0, 0, mask };
+
+	opdis_set_decode_mask( o, mask );
+	opdis_set_display( o, display, &r );
+	opdis_visited_clear( o->visited_addr );
+	if ( cflow ) {
+		opdis_disasm_cflow( o, buf, buf->vma );
+	} else {
+		opdis_disasm_linear( o, buf, buf->vma, 0 );
+	}
+
+	printf( "%-16s %s: %u insns, %u wrong\n", name,
+		cflow ? "cflow" : "linear", r.num, r.bad );
+	return ( r.num == expect && ! r.bad );
+}
+
+int main( void ) {
+	opdis_buf_t buf = opdis_buf_alloc( sizeof(code), 0x1000 );
+	opdis_t o = opdis_init();
+	int ok = 1, syntax;
+
+	memcpy( buf->data, code, sizeof(code) );
+	o->visited_addr = opdis_visited_init();
+
+	for ( syntax = 0; syntax < 2; syntax++ ) {
+		opdis_set_x86_syntax( o, syntax ? opdis_x86_syntax_att :
+					 opdis_x86_syntax_intel );
+		printf( "%s:\n", syntax ? "AT&T" : "Intel" );
+
+		ok &= check( o, buf, "all", OPDIS_DECODE_ALL, 0, 13 );
+		ok &= check( o, buf, "basic", opdis_decode_basic, 0, 13 );
+		ok &= check( o, buf, "mnem|ops", opdis_decode_basic |
+			     opdis_decode_mnem | opdis_decode_ops, 0, 13 );
+
+		/* branch targets are followed with only the cflow levels;
+		 * the nops at 0x100F and 0x1010 are not reached */
+		ok &= check( o, buf, "cflow", OPDIS_DECODE_CFLOW, 1, 11 );
+		ok &= check( o, buf, "all", OPDIS_DECODE_ALL, 1, 11 );
+
+		/* without the mnemonic flags no insn is a branch, so control
+		 * flow disassembly runs through to the end of the buffer */
+		ok &= check( o, buf, "mnem|ops", opdis_decode_basic |
+			     opdis_decode_mnem | opdis_decode_ops, 1, 13 );
+	}
+
+	/* implied levels are added */
+	opdis_set_decode_mask( o, opdis_decode_op_flags );
+	ok &= ( o->decode_mask == ( opdis_decode_basic | opdis_decode_ops |
+				    opdis_decode_op_flags ) );
+
+	opdis_visited_free( o->visited_addr );
+	opdis_term( o );
+	opdis_buf_free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <opdis/insn_buf.h>
+#include <opdis/x86_decoder.h>
+
+struct FRAGMENT {
+	enum opdis_span_type_t type;
+	const char * str;
+};
+
+/* lock addl $0x1,0x8(%ebp,%eax,4) as emitted by styled libopcodes */
+static struct FRAGMENT styled[] = {
+	{ opdis_span_mnemonic, "lock " },
+	{ opdis_span_mnemonic, "addl" },
+	{ opdis_span_text, "   " },
+	{ opdis_span_immediate, "$0x1" },
+	{ opdis_span_text, "," },
+	{ opdis_span_address, "0x8" },
+	{ opdis_span_text, "(" },
+	{ opdis_span_register, "%ebp" },
+	{ opdis_span_text, "," },
+	{ opdis_span_register, "%eax" },
+	{ opdis_span_text, "," },
+	{ opdis_span_immediate, "4" },
+	{ opdis_span_text, ")" },
+	{ opdis_span_comment, "        # " },
+	{ opdis_span_address, "0x1234" },
+	{ opdis_span_text, NULL }
+};
+
+/* the same insn as emitted by unstyled libopcodes */
+static const char * items[] = { "lock ", "addl   ", "$0x1", ",",
+				"0x8(%ebp,%eax,4)", "        # ", "0x1234",
+				NULL };
+
+static int append_span( opdis_insn_buf_t buf, enum opdis_span_type_t type,
+			const char * format, ... ) {
+	va_list args;
+	int rv;
+
+	va_start( args, format );
+	rv = opdis_insn_buf_append_span( buf, type, format, args );
+	va_end( args );
+
+	return rv;
+}
+
+static int same_insn( opdis_insn_t * a, opdis_insn_t * b ) {
+	int i;
+
+	if ( strcmp( a->ascii, b->ascii ) || strcmp( a->mnemonic, b->mnemonic ) ||
+	     strcmp( a->prefixes, b->prefixes ) ||
+	     strcmp( a->comment, b->comment ) ||
+	     a->num_operands != b->num_operands ) {
+		return 0;
+	}
+
+	for ( i = 0; i < a->num_operands; i++ ) {
+		if ( strcmp( a->operands[i]->ascii, b->operands[i]->ascii ) ||
+		     a->operands[i]->category != b->operands[i]->category ) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int main( void ) {
+	opdis_insn_buf_t sbuf = opdis_insn_buf_alloc( 0, 0, 0 );
+	opdis_insn_buf_t ibuf = opdis_insn_buf_alloc( 0, 0, 0 );
+	opdis_insn_t * sinsn = opdis_insn_alloc_fixed( 128, 32, 16, 32 );
+	opdis_insn_t * iinsn = opdis_insn_alloc_fixed( 128, 32, 16, 32 );
+	opdis_byte_t bytes[16] = { 0 };
+	int i, ok = 1;
+
+	for ( i = 0; styled[i].str; i++ ) {
+		append_span( sbuf, styled[i].type, "%s", styled[i].str );
+	}
+	for ( i = 0; items[i]; i++ ) {
+		opdis_insn_buf_append( ibuf, items[i] );
+	}
+
+	/* fragments of an operand are merged into one item */
+	ok &= ( sbuf->item_count == ibuf->item_count );
+	for ( i = 0; ok && i < sbuf->item_count; i++ ) {
+		if ( strcmp( sbuf->items[i], ibuf->items[i] ) ) {
+			printf( "Item %d: '%s' != '%s'\n", i, sbuf->items[i],
+				ibuf->items[i] );
+			ok = 0;
+		}
+	}
+	ok &= ! strcmp( sbuf->string, ibuf->string );
+	ok &= ( sbuf->span_count == 15 &&
+		sbuf->spans[14].type == opdis_span_comment );
+
+	opdis_x86_att_decoder( sbuf, sinsn, bytes, 0, 0, 8, NULL );
+	opdis_x86_att_decoder( ibuf, iinsn, bytes, 0, 0, 8, NULL );
+	ok &= same_insn( sinsn, iinsn ) && sinsn->num_operands == 2;
+
+	printf( "Items: %d Spans: %d Prefixes: '%s' Mnemonic: %s "
+		"Operands: %d Comment: '%s'\n", sbuf->item_count, 
+		sbuf->span_count, sinsn->prefixes, sinsn->mnemonic,
+		(int) sinsn->num_operands, sinsn->comment );
+
+	opdis_insn_buf_clear( sbuf );
+	ok &= ( sbuf->span_count == 0 && sbuf->item_count == 0 );
+
+	opdis_insn_free( sinsn );
+	opdis_insn_free( iinsn );
+	opdis_insn_buf_free( sbuf );
+	opdis_insn_buf_free( ibuf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+/* 0x1000: push; je 0x1006; nop; jmp 0x1008; nop; nop; call 0x1011; pop;
+ *         ret; nop; nop; nop; ret */
+static const unsigned char code[] = {
+	0x55, 0x74, 0x03, 0x90, 0xEB, 0x02, 0x90, 0x90,
+	0xE8, 0x04, 0x00, 0x00, 0x00, 0x5D, 0xC3, 0x90,
+	0x90, 0x90, 0xC3
+};
+
+struct RESULT {
+	opdis_buf_t buf;
+	int borrow;
+	unsigned int num;
+	unsigned int bad;
+};
+
+/* borrowed bytes point into the buffer; duplicates always own theirs */
+static int check_insn( const opdis_insn_t * insn, struct RESULT * r ) {
+	const opdis_byte_t * src = &r->buf->data[insn->offset];
+	opdis_insn_t * dupe;
+	int ok;
+
+	ok = ( insn->borrow_bytes == r->borrow &&
+	       ( insn->bytes == src ) == r->borrow &&
+	       ! memcmp( insn->bytes, src, insn->size ) );
+
+	dupe = opdis_insn_dupe( insn );
+	ok &= ( dupe && ! dupe->borrow_bytes && dupe->bytes != src &&
+		! memcmp( dupe->bytes, src, insn->size ) );
+	opdis_insn_free( dupe );
+
+	if (! ok ) {
+		printf( "\t%p: '%s' bytes %p buffer %p\n", (void *) insn->vma,
+			insn->ascii, (void *) insn->bytes, (void *) src );
+	}
+	return ok;
+}
+
+static void display( const opdis_insn_t * insn, void * arg ) {
+	struct RESULT * r = (struct RESULT *) arg;
+
+	r->bad += ! check_insn( insn, r );
+	r->num++;
+}
+
+static void ignore( const opdis_insn_t * insn, void * arg ) {
+}
+
+static int batch( const opdis_insn_t * insns, size_t n, void * arg ) {
+	size_t i;
+
+	for ( i = 0; i < n; i++ ) {
+		display( &insns[i], arg );
+	}
+	return 1;
+}
+
+static int check( opdis_t o, opdis_buf_t buf, const char * name, int borrow,
+		  int cflow ) {
+	struct RESULT r = { buf, borrow, 0, 0 };
+
+	opdis_set_borrow_bytes( o, borrow );
+	opdis_set_display( o, display, &r );
+	if ( o->batch ) {
+		o->batch_arg = &r;
+	}
+	opdis_visited_clear( o->visited_addr );
+	if ( cflow ) {
+		opdis_disasm_cflow( o, buf, buf->vma );
+	} else {
+		opdis_disasm_linear( o, buf, buf->vma, 0 );
+	}
+
+	printf( "%-8s %-6s %s: %u insns, %u wrong\n", name,
+		borrow ? "borrow" : "copy", cflow ? "cflow" : "linear",
+		r.num, r.bad );
+	return ( r.num == ( cflow ? 11 : 13 ) && ! r.bad );
+}
+
+static int check_all( opdis_t o, opdis_buf_t buf, const char * name ) {
+	int ok = 1, borrow, cflow;
+
+	for ( borrow = 0; borrow < 2; borrow++ ) {
+		for ( cflow = 0; cflow < 2; cflow++ ) {
+			ok &= check( o, buf, name, borrow, cflow );
+		}
+	}
+
+	return ok;
+}
+
+static int check_sizes( void ) {
+	const opdis_insn_sizes_t * x86 = opdis_insn_sizes( bfd_arch_i386 );
+	const opdis_insn_sizes_t * mips = opdis_insn_sizes( bfd_arch_mips );
+	const opdis_insn_sizes_t * other = opdis_insn_sizes( bfd_arch_obscure );
+	opdis_byte_t bytes[6] = { 1, 2, 3, 4, 5, 6 };
+	opdis_insn_t * insn;
+	int ok;
+
+	printf( "sizes: x86 %d mips %d other %d\n", x86->bytes_sz,
+		mips->bytes_sz, other->bytes_sz );
+	ok = ( x86->bytes_sz == 16 && mips->bytes_sz == 4 &&
+	       other->bytes_sz == 128 && mips->num_operands <
+	       other->num_operands );
+
+	/* a fixed bytes field grows if an insn does not fit */
+	insn = opdis_insn_alloc_fixed_bytes( mips->bytes_sz, mips->ascii_sz,
+					     mips->mnemonic_sz,
+					     mips->num_operands,
+					     mips->op_ascii_sz );
+	ok &= ( insn && insn->fixed_size && insn->bytes_sz == 4 );
+	ok &= opdis_insn_set_bytes( insn, bytes, 4 );
+	ok &= ( insn->bytes_sz == 4 && ! memcmp( insn->bytes, bytes, 4 ) );
+	ok &= opdis_insn_set_bytes( insn, bytes, 6 );
+	ok &= ( insn->bytes_sz == 6 && ! memcmp( insn->bytes, bytes, 6 ) );
+	opdis_insn_free( insn );
+
+	/* a borrowing insn does not copy */
+	insn = opdis_insn_alloc_fixed_bytes( 0, 32, 16, 0, 16 );
+	ok &= ( insn && ! insn->bytes );
+	insn->borrow_bytes = 1;
+	ok &= ( opdis_insn_set_bytes( insn, bytes, 6 ) && insn->bytes == bytes );
+	opdis_insn_free( insn );
+
+	return ok;
+}
+
+int main( void ) {
+	opdis_buf_t buf = opdis_buf_alloc( sizeof(code), 0x1000 );
+	opdis_t o = opdis_init();
+	opdis_decode_cache_t cache = opdis_decode_cache_init( 0 );
+	opdis_insn_t * insn;
+	int ok;
+
+	memcpy( buf->data, code, sizeof(code) );
+	o->visited_addr = opdis_visited_init();
+
+	ok = check_sizes();
+	ok &= ( o->borrow_bytes == 0 );
+
+	ok &= check_all( o, buf, "display" );
+
+	/* cache hits borrow from the buffer, not the cache */
+	opdis_set_decode_cache( o, cache );
+	ok &= check_all( o, buf, "cache" );
+	ok &= check_all( o, buf, "cache" );
+	opdis_set_decode_cache( o, NULL );
+
+	opdis_set_batch_handler( o, batch, NULL, 4 );
+	ok &= check_all( o, buf, "batch" );
+	opdis_set_batch_handler( o, NULL, NULL, 0 );
+
+	/* an insn allocated by the caller keeps its own bytes */
+	opdis_set_borrow_bytes( o, 1 );
+	opdis_set_display( o, ignore, NULL );
+	insn = opdis_insn_alloc( 0 );
+	ok &= ( opdis_disasm_insn( o, buf, 0x1008, insn ) == 5 &&
+		! insn->borrow_bytes && insn->bytes != &buf->data[8] &&
+		! memcmp( insn->bytes, &buf->data[8], 5 ) );
+	opdis_insn_free( insn );
+
+	opdis_decode_cache_free( cache );
+	opdis_visited_free( o->visited_addr );
+	opdis_term( o );
+	opdis_buf_free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/insn_cols.h>
+
+#define NUM_INSNS 5
+
+static const char * mnemonics[] = { "push", "mov", "mov", "call", "ret" };
+
+/* insn i has i % 3 operands */
+static opdis_insn_t * make_insn( unsigned int i ) {
+	opdis_insn_t * insn = opdis_insn_alloc( 0 );
+	unsigned int j;
+
+	insn->vma = 0x1000 + i * 4;
+	insn->size = i + 1;
+	insn->category = ( i == 3 ) ? opdis_insn_cat_cflow : opdis_insn_cat_lost;
+	insn->flags.cflow = ( i == 3 ) ? opdis_cflow_flag_call : 0;
+	opdis_insn_set_mnemonic( insn, mnemonics[i] );
+
+	for ( j = 0; j < i % 3; j++ ) {
+		opdis_op_t * op = opdis_op_alloc();
+		opdis_op_set_ascii( op, ( j ) ? "%ebx" : "%eax" );
+		op->category = opdis_op_cat_register;
+		op->flags = ( j ) ? opdis_op_flag_r : opdis_op_flag_w;
+		opdis_insn_add_operand( insn, op );
+	}
+
+	return insn;
+}
+
+static int check_insn( const opdis_cols_block_t * blk, uint32_t idx,
+		       unsigned int i ) {
+	uint32_t op = blk->op_first[idx];
+	int ok = ( blk->vma[idx] == 0x1000 + i * 4 && blk->size[idx] == i + 1 &&
+		   ! strcmp( opdis_cols_mnemonic( blk, idx ), mnemonics[i] ) &&
+		   blk->op_first[idx + 1] - op == i % 3 );
+
+	ok &= ( i != 3 || ( blk->category[idx] == opdis_insn_cat_cflow &&
+			    blk->flags[idx] == opdis_cflow_flag_call ) );
+	if ( i % 3 ) {
+		ok &= ( ! strcmp( opdis_cols_op_ascii( blk, op ), "%eax" ) &&
+			blk->op_category[op] == opdis_op_cat_register &&
+			blk->op_flags[op] == opdis_op_flag_w );
+	}
+	if ( i % 3 == 2 ) {
+		ok &= ( ! strcmp( opdis_cols_op_ascii( blk, op + 1 ), "%ebx" ) &&
+			blk->op_flags[op + 1] == opdis_op_flag_r );
+	}
+
+	printf( "Insn %u VMA: %lX Size: %u Mnemonic: %s Ops: %u OK: %d\n", i,
+		(unsigned long) blk->vma[idx], blk->size[idx],
+		opdis_cols_mnemonic( blk, idx ),
+		blk->op_first[idx + 1] - op, ok );
+	return ok;
+}
+
+int main( void ) {
+	opdis_cols_writer_t w;
+	opdis_cols_block_t blk;
+	unsigned int i, n = 0, blocks = 0;
+	uint64_t * buf;
+	size_t len, pos;
+	FILE * f = tmpfile();
+	int ok = 1;
+
+	/* two insns per block: three blocks */
+	w = opdis_cols_writer_init( f, 2 );
+	for ( i = 0; i < NUM_INSNS; i++ ) {
+		opdis_insn_t * insn = make_insn( i );
+		ok &= opdis_cols_writer_add( w, insn );
+		opdis_insn_free( insn );
+	}
+	ok &= opdis_cols_writer_close( w );
+
+	/* uint64_t buffer for alignment */
+	len = (size_t) ftell( f );
+	buf = calloc( 1, len + 8 );
+	rewind( f );
+	ok &= ( fread( buf, len, 1, f ) == 1 );
+	fclose( f );
+
+	pos = opdis_cols_check( buf, len );
+	ok &= ( pos != 0 );
+	while ( pos && (pos = opdis_cols_block( buf, len, pos, &blk )) ) {
+		uint32_t j;
+		blocks++;
+		/* string tables are per block: "mov" follows "push" in the
+		 * first block, and is the first string of the second */
+		if ( blocks == 1 ) {
+			ok &= ( blk.num_mnemonics == 3 && blk.num_op_strings == 2 &&
+				blk.mnemonic[1] == 2 );
+		} else if ( blocks == 2 ) {
+			ok &= ( blk.mnemonic[0] == 1 );
+		}
+		for ( j = 0; j < blk.num_insns; j++, n++ ) {
+			ok &= check_insn( &blk, j, n );
+		}
+	}
+	ok &= ( blocks == 3 && n == NUM_INSNS );
+
+	/* a truncated or byte-swapped file is rejected */
+	ok &= ( opdis_cols_block( buf, len - 8, sizeof(opdis_cols_file_hdr_t),
+				  &blk ) != 0 );
+	ok &= ( opdis_cols_block( buf, sizeof(opdis_cols_file_hdr_t) + 16,
+				  sizeof(opdis_cols_file_hdr_t), &blk ) == 0 );
+	((opdis_cols_file_hdr_t *) buf)->byte_order = 0x04030201;
+	ok &= ( opdis_cols_check( buf, len ) == 0 );
+
+	free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <opdis/opdis.h>
+#include <opdis/x86_length.h>
+
+#include "test_code.h"
+
+#define BUF_SIZE 0x40000
+
+struct LENGTH_CASE {
+	enum opdis_x86_mode_t mode;
+	unsigned int size;
+	const char * bytes;
+};
+
+/* expected sizes, as reported by objdump */
+static const struct LENGTH_CASE cases[] = {
+	{ opdis_x86_mode_64, 7, "\x48\x8b\x05\x00\x00\x00\x00" },
+	{ opdis_x86_mode_64, 10, "\x48\xb8\x01\x02\x03\x04\x05\x06\x07\x08" },
+	{ opdis_x86_mode_64, 4, "\x66\xb8\x01\x02" },
+	{ opdis_x86_mode_64, 9, "\x41\xc7\x44\x24\x08\x01\x02\x03\x04" },
+	{ opdis_x86_mode_64, 3, "\xf6\xc1\x01" },
+	{ opdis_x86_mode_64, 6, "\xf7\xc1\x01\x02\x03\x04" },
+	{ opdis_x86_mode_64, 2, "\xf6\xd1" },
+	{ opdis_x86_mode_64, 10, "\x66\x2e\x0f\x1f\x84\x00\x00\x00\x00\x00" },
+	{ opdis_x86_mode_64, 3, "\xc5\xf8\x77" },
+	{ opdis_x86_mode_64, 6, "\xc4\xe3\x79\x0f\xc1\x08" },
+	{ opdis_x86_mode_64, 8, "\x62\xf1\x7c\x48\x10\x44\x24\x01" },
+	{ opdis_x86_mode_64, 6, "\x0f\x84\x01\x02\x03\x04" },
+	{ opdis_x86_mode_64, 9, "\xa1\x01\x02\x03\x04\x05\x06\x07\x08" },
+	{ opdis_x86_mode_64, 6, "\x67\xa1\x01\x02\x03\x04" },
+	{ opdis_x86_mode_64, 3, "\x9b\xdf\xe0" },
+	{ opdis_x86_mode_64, 4, "\xc8\x10\x00\x01" },
+	{ opdis_x86_mode_64, 1, "\x06" },
+	{ opdis_x86_mode_32, 5, "\xa1\x01\x02\x03\x04" },
+	{ opdis_x86_mode_32, 4, "\x67\xa1\x01\x02" },
+	{ opdis_x86_mode_32, 7, "\x8b\x84\x24\x01\x02\x03\x04" },
+	{ opdis_x86_mode_32, 4, "\x67\x8b\x46\x08" },
+	{ opdis_x86_mode_32, 2, "\xc4\x07" },
+	{ opdis_x86_mode_32, 7, "\x9a\x01\x02\x03\x04\x05\x06" },
+	{ opdis_x86_mode_32, 3, "\x0f\x20\xc0" },
+	{ opdis_x86_mode_16, 3, "\xb8\x01\x02" },
+	{ opdis_x86_mode_16, 6, "\x66\xb8\x01\x02\x03\x04" },
+	{ opdis_x86_mode_16, 4, "\x8b\x06\x34\x12" },
+	{ opdis_x86_mode_16, 5, "\x67\x8b\x44\x24\x08" },
+	{ opdis_x86_mode_16, 3, "\xe8\x01\x02" }
+};
+
+static int check_cases( void ) {
+	unsigned int i, size;
+	int ok = 1;
+
+	for ( i = 0; i < sizeof(cases) / sizeof(cases[0]); i++ ) {
+		const opdis_byte_t * b = (const opdis_byte_t *) cases[i].bytes;
+		size = opdis_x86_insn_length( b, cases[i].size, cases[i].mode );
+		if ( size != cases[i].size ) {
+			printf( "Case %u (%d-bit): size %u, expected %u\n", i,
+				cases[i].mode, size, cases[i].size );
+			ok = 0;
+		}
+		/* a truncated insn has no size */
+		if ( opdis_x86_insn_length( b, cases[i].size - 1,
+					    cases[i].mode ) ) {
+			printf( "Case %u: truncated insn has a size\n", i );
+			ok = 0;
+		}
+	}
+
+	return ok;
+}
+
+int main( void ) {
+	opdis_off_t * offsets, pos;
+	int num, count = 0, ok;
+	clock_t start, native, lib;
+	opdis_buf_t buf;
+	opdis_t o;
+
+	ok = check_cases();
+
+	/* a few encodings repeated throughout the buffer */
+	buf = opdis_buf_alloc( BUF_SIZE, 0x1000 );
+	test_fill_encodings( buf, 1 );
+
+	offsets = (opdis_off_t *) calloc( BUF_SIZE, sizeof(opdis_off_t) );
+	o = opdis_init();
+
+	start = clock();
+	num = opdis_insn_lengths( o, buf, 0x1000, 0, offsets );
+	native = clock() - start;
+
+	/* every boundary must match a libopcodes linear sweep */
+	start = clock();
+	for ( pos = 0; pos < BUF_SIZE; count++ ) {
+		unsigned int size = opdis_disasm_insn_size( o, buf,
+							    0x1000 + pos );
+		if ( count < num && offsets[count] != pos ) {
+			printf( "Insn %d at offset %u, expected %u\n", count,
+				(unsigned int) offsets[count],
+				(unsigned int) pos );
+			ok = 0;
+			break;
+		}
+		if (! size ) {
+			break;
+		}
+		pos += size;
+	}
+	lib = clock() - start;
+
+	printf( "Native: %d insns in %lu ticks. libopcodes: %d insns in "
+		"%lu ticks\n", num, (unsigned long) native, count,
+		(unsigned long) lib );
+	ok &= ( num == count );
+
+	/* a range stops at the last insn which fits in it */
+	ok &= ( opdis_insn_lengths( o, buf, 0x1000 + offsets[1],
+				    offsets[3] - offsets[1], NULL ) == 2 );
+	ok &= ( opdis_insn_lengths( o, buf, 0x1000 + BUF_SIZE, 0, NULL ) == 0 );
+
+	/* fixed-size insns are not examined */
+	opdis_set_arch( o, bfd_arch_sparc, 0, o->disassembler );
+	ok &= ( opdis_insn_lengths( o, buf, 0x1000, 0, offsets ) ==
+		BUF_SIZE / 4 && offsets[1] == 4 );
+
+	opdis_term( o );
+	opdis_buf_free( buf );
+	free( offsets );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
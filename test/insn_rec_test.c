@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/insn_rec.h>
+
+/* build a 'jmp 0x1234' style instruction by hand */
+static opdis_insn_t * make_insn( opdis_vma_t vma ) {
+	opdis_byte_t bytes[] = { 0xe9, 0x2f, 0x12, 0x00, 0x00 };
+	opdis_insn_t * insn = opdis_insn_alloc( 0 );
+	opdis_op_t * op;
+
+	insn->status = opdis_decode_basic | opdis_decode_mnem |
+		       opdis_decode_ops | opdis_decode_mnem_flags;
+	insn->offset = vma - 0x1000;
+	insn->vma = vma;
+	insn->size = sizeof(bytes);
+	insn->bytes = calloc( 1, sizeof(bytes) );
+	memcpy( insn->bytes, bytes, sizeof(bytes) );
+	opdis_insn_set_ascii( insn, "jmp    0x1234" );
+	opdis_insn_set_mnemonic( insn, "jmp" );
+	opdis_insn_add_prefix( insn, "rep" );
+	insn->category = opdis_insn_cat_cflow;
+	insn->flags.cflow = opdis_cflow_flag_jmp;
+
+	op = opdis_op_alloc();
+	opdis_op_set_ascii( op, "0x1234" );
+	op->category = opdis_op_cat_immediate;
+	op->flags = opdis_op_flag_x | opdis_op_flag_address;
+	op->value.immediate.vma = 0x1234;
+	op->data_size = 4;
+	opdis_insn_add_operand( insn, op );
+	insn->target = op;
+
+	return insn;
+}
+
+static int check_rec( const char * name, const opdis_insn_rec_t * rec,
+		      opdis_vma_t vma ) {
+	const opdis_op_rec_t * tgt = opdis_insn_rec_target( rec );
+	int ok = ( rec->vma == vma && rec->size == 5 &&
+		   rec->rec_size % 8 == 0 &&
+		   opdis_insn_rec_bytes(rec)[0] == 0xe9 &&
+		   ! strcmp( opdis_insn_rec_ascii(rec), "jmp    0x1234" ) &&
+		   ! strcmp( opdis_insn_rec_mnemonic(rec), "jmp" ) &&
+		   ! strcmp( opdis_insn_rec_prefixes(rec), "rep" ) &&
+		   opdis_insn_rec_comment(rec) == NULL &&
+		   rec->num_operands == 1 && tgt == opdis_insn_rec_op(rec, 0) &&
+		   opdis_insn_rec_dest(rec) == NULL &&
+		   tgt->value.immediate.vma == 0x1234 &&
+		   ! strcmp( opdis_op_rec_ascii(rec, tgt), "0x1234" ) );
+
+	printf( "%-8s VMA: %lX Size: %u RecSize: %u OK: %d\n", name,
+		(unsigned long) rec->vma, rec->size, rec->rec_size, ok );
+	return ok;
+}
+
+static int check_insn( const char * name, const opdis_insn_t * insn ) {
+	int ok = ( insn->size == 5 && insn->bytes[4] == 0x00 &&
+		   ! strcmp( insn->ascii, "jmp    0x1234" ) &&
+		   ! strcmp( insn->mnemonic, "jmp" ) &&
+		   ! strcmp( insn->prefixes, "rep" ) &&
+		   insn->num_prefixes == 1 &&
+		   insn->category == opdis_insn_cat_cflow &&
+		   insn->flags.cflow == opdis_cflow_flag_jmp &&
+		   insn->num_operands == 1 && insn->target == insn->operands[0] &&
+		   insn->dest == NULL &&
+		   insn->target->value.immediate.vma == 0x1234 &&
+		   ! strcmp( insn->target->ascii, "0x1234" ) );
+
+	printf( "%-8s VMA: %lX Ascii: '%s' OK: %d\n", name,
+		(unsigned long) insn->vma, insn->ascii, ok );
+	return ok;
+}
+
+int main( void ) {
+	int i, ok = 1;
+	char buf[4096];
+	size_t pos = 0, len;
+	opdis_insn_t * insn, * copy, * fixed;
+	opdis_insn_rec_t * rec;
+	const opdis_insn_rec_t * r;
+	opdis_arena_t arena;
+	uint64_t aligned[512];
+
+	insn = make_insn( 0x1000 );
+
+	rec = opdis_insn_rec_alloc( insn );
+	ok &= check_rec( "alloc", rec, 0x1000 );
+
+	copy = opdis_insn_unpack( rec );
+	ok &= check_insn( "unpack", copy );
+	opdis_insn_free( copy );
+
+	fixed = opdis_insn_alloc_fixed( 128, 32, 4, 32 );
+	ok &= opdis_insn_rec_fill( rec, fixed );
+	ok &= check_insn( "fixed", fixed );
+	opdis_insn_free( fixed );
+	opdis_insn_rec_free( rec );
+
+	arena = opdis_arena_init( 0 );
+	rec = opdis_insn_rec_arena( insn, arena );
+	ok &= check_rec( "arena", rec, 0x1000 );
+	opdis_arena_free( arena );
+
+	/* records packed back-to-back are relocatable */
+	for ( i = 0; i < 8; i++ ) {
+		insn->vma = 0x1000 + i * 5;
+		len = opdis_insn_pack( insn, &((char *) aligned)[pos],
+				       sizeof(aligned) - pos );
+		ok &= ( len > 0 );
+		pos += len;
+	}
+	memcpy( buf, aligned, pos );
+	memset( aligned, 0, sizeof(aligned) );
+	memcpy( aligned, buf, pos );
+
+	for ( i = 0, r = (const opdis_insn_rec_t *) aligned;
+	      (const char *) r < (const char *) aligned + pos;
+	      r = opdis_insn_rec_next(r), i++ ) {
+		ok &= ( r->vma == 0x1000 + i * 5 ) &&
+		      ! strcmp( opdis_insn_rec_ascii(r), "jmp    0x1234" );
+	}
+	printf( "packed   Count: %d Bytes: %lu\n", i, (unsigned long) pos );
+	ok &= ( i == 8 );
+
+	/* buffer too small */
+	ok &= ( opdis_insn_pack( insn, aligned, 16 ) == 0 );
+
+	opdis_insn_free( insn );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <opdis/insn_vec.h>
+
+struct CHECK_ARG {
+	unsigned long count;
+	opdis_vma_t last;
+	int ordered;
+};
+
+static int check_insn( opdis_insn_t * insn, void * arg ) {
+	struct CHECK_ARG * c = (struct CHECK_ARG *) arg;
+	if ( c->count && insn->vma <= c->last ) {
+		c->ordered = 0;
+	}
+	c->last = insn->vma;
+	c->count++;
+	return 1;
+}
+
+static opdis_insn_t * make_insn( opdis_vma_t vma, opdis_off_t size ) {
+	opdis_insn_t * insn = opdis_insn_alloc( 0 );
+	insn->vma = vma;
+	insn->size = size;
+	return insn;
+}
+
+static int check_vec( const char * name, opdis_insn_vec_t v,
+		      unsigned long expected ) {
+	struct CHECK_ARG c = { 0, 0, 1 };
+	opdis_insn_t * i;
+	int ok;
+
+	opdis_insn_vec_foreach( v, check_insn, &c );
+
+	i = opdis_insn_vec_closest( v, 0x1001 );
+	ok = ( c.ordered && c.count == expected &&
+	       opdis_insn_vec_count(v) == expected &&
+	       opdis_insn_vec_contains( v, 0x1000 ) &&
+	       ! opdis_insn_vec_contains( v, 0x1001 ) &&
+	       i && i->vma == 0x1000 &&
+	       opdis_insn_vec_closest( v, 0xFFF ) == NULL );
+
+	i = opdis_insn_vec_next( v, 0x1000 );
+	ok &= ( i && i->vma == 0x1004 );
+	i = opdis_insn_vec_next( v, 0x1001 );
+	ok &= ( i && i->vma == 0x1004 );
+
+	printf( "%-8s Count: %lu/%lu Ordered: %d OK: %d\n", name, c.count,
+		(unsigned long) opdis_insn_vec_count(v), c.ordered, ok );
+	return ok;
+}
+
+int main( void ) {
+	int ok = 1, dupes = 0;
+	opdis_vma_t vma;
+	opdis_insn_vec_t v;
+	opdis_insn_t * first, * insn;
+
+	/* linear: ascending order, never needs sorting */
+	v = opdis_insn_vec_init( 1 );
+	for ( vma = 0x1000; vma < 0x1000 + 4 * 1000; vma += 4 ) {
+		opdis_insn_vec_add( v, make_insn( vma, 4 ) );
+	}
+	insn = make_insn( 0x1000 + 4 * 999, 4 );
+	dupes += opdis_insn_vec_add( v, insn );
+	opdis_insn_free( insn );
+	ok &= ( v->sorted == v->num ) && ! dupes;
+	ok &= check_vec( "linear", v, 1000 );
+	opdis_insn_vec_free( v );
+
+	/* cflow: out-of-order with duplicates; first insert must win */
+	v = opdis_insn_vec_init( 1 );
+	for ( vma = 0x1000 + 4 * 999; vma >= 0x1000; vma -= 4 ) {
+		insn = make_insn( vma, 4 );
+		if ( vma == 0x1004 ) {
+			first = insn;
+		}
+		opdis_insn_vec_add( v, insn );
+	}
+	for ( vma = 0x1000; vma < 0x1000 + 4 * 1000; vma += 8 ) {
+		insn = make_insn( vma, 8 );
+		if (! opdis_insn_vec_add( v, insn ) ) {
+			/* rejected as duplicate of last insn */
+			opdis_insn_free( insn );
+		}
+	}
+	ok &= check_vec( "cflow", v, 1000 );
+	ok &= ( opdis_insn_vec_find( v, 0x1004 ) == first );
+	opdis_insn_vec_free( v );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
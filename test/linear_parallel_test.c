@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+#include "test_code.h"
+
+#define BUF_SIZE 0x90000	/* several passes of NUM_THREADS shards */
+#define NUM_THREADS 4
+
+struct INSN_LIST {
+	opdis_vma_t * vma;
+	char (*ascii)[64];
+	unsigned int count;
+};
+
+static void store_insn( const opdis_insn_t * insn, void * arg ) {
+	struct INSN_LIST * l = (struct INSN_LIST *) arg;
+
+	if ( l->count < BUF_SIZE ) {
+		l->vma[l->count] = insn->vma;
+		strncpy( l->ascii[l->count], insn->ascii, 63 );
+	}
+	l->count++;
+}
+
+static void list_init( struct INSN_LIST * l ) {
+	l->vma = (opdis_vma_t *) calloc( BUF_SIZE, sizeof(opdis_vma_t) );
+	l->ascii = (char (*)[64]) calloc( BUF_SIZE, 64 );
+	l->count = 0;
+}
+
+static void list_term( struct INSN_LIST * l ) {
+	free( l->vma );
+	free( l->ascii );
+}
+
+static int compare( const char * name, struct INSN_LIST * a,
+		    struct INSN_LIST * b, int count ) {
+	unsigned int i;
+	int ok = ( a->count == b->count && (int) b->count == count );
+
+	for ( i = 0; ok && i < a->count; i++ ) {
+		if ( a->vma[i] != b->vma[i] || strcmp(a->ascii[i], b->ascii[i]) ){
+			printf( "%s insn %u: %p '%s' != %p '%s'\n", name, i,
+				(void *) a->vma[i], a->ascii[i],
+				(void *) b->vma[i], b->ascii[i] );
+			ok = 0;
+		}
+	}
+
+	printf( "%-8s Linear: %u Parallel: %u (%d)\n", name, a->count,
+		b->count, count );
+	return ok;
+}
+
+int main( void ) {
+	struct INSN_LIST seq, par;
+	uint32_t seed = 1;
+	unsigned int i;
+	opdis_buf_t buf;
+	opdis_t o;
+	int count, ok = 1;
+
+	/* nops and mov $imm, %eax: shards will start inside immediates */
+	buf = opdis_buf_alloc( BUF_SIZE, 0x1000 );
+	for ( i = 0; i + 5 <= BUF_SIZE; ) {
+		if ( test_rand( &seed ) & 1 ) {
+			buf->data[i++] = 0x90;
+		} else {
+			buf->data[i] = 0xB8;
+			memcpy( &buf->data[i + 1], &seed, 4 );
+			i += 5;
+		}
+	}
+	while ( i < BUF_SIZE ) {
+		buf->data[i++] = 0x90;
+	}
+
+	o = opdis_init();
+	list_init( &seq );
+	list_init( &par );
+
+	opdis_set_display( o, store_insn, &seq );
+	opdis_disasm_linear( o, buf, 0x1000, 0 );
+	opdis_set_display( o, store_insn, &par );
+	count = opdis_disasm_linear_parallel( o, buf, 0x1000, 0, NUM_THREADS );
+	ok &= compare( "buffer", &seq, &par, count );
+
+	/* a range which ends inside the buffer */
+	seq.count = par.count = 0;
+	opdis_set_display( o, store_insn, &seq );
+	opdis_disasm_linear( o, buf, 0x1003, 0x48000 );
+	opdis_set_display( o, store_insn, &par );
+	count = opdis_disasm_linear_parallel( o, buf, 0x1003, 0x48000,
+					      NUM_THREADS );
+	ok &= compare( "range", &seq, &par, count );
+
+	list_term( &seq );
+	list_term( &par );
+	opdis_term( o );
+	opdis_buf_free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
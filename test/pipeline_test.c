@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <opdis/insn_rec.h>
+
+#include "../src/pipeline.h"
+
+/* a small ring, so that records wrap around it many times. Record sizes
+ * vary, so the end of the ring is often too small for the next record and
+ * a zero-length record sends the formatter back to the start */
+#define RING_SIZE 1000
+#define NUM_INSNS 3000
+
+struct SINK {
+	unsigned int count;
+	int slow;		/* stall now and then to fill the ring */
+	int ok;
+};
+
+static opdis_insn_t * make_insn( unsigned int n ) {
+	opdis_insn_t * insn = opdis_insn_alloc( 0 );
+	char ascii[64];
+	unsigned int i;
+
+	insn->status = opdis_decode_basic;
+	insn->vma = 0x1000 + n * 16;
+	insn->size = 1 + n % 15;
+	insn->bytes = calloc( 1, insn->size );
+	for ( i = 0; i < insn->size; i++ ) {
+		insn->bytes[i] = (opdis_byte_t) ( n + i );
+	}
+	snprintf( ascii, sizeof(ascii), "insn %*u", (int) ( n % 40 ), n );
+	opdis_insn_set_ascii( insn, ascii );
+
+	return insn;
+}
+
+static void sink( const opdis_insn_t * insn, void * arg ) {
+	struct SINK * s = (struct SINK *) arg;
+	opdis_insn_t * expect = make_insn( s->count );
+	struct timespec ts = { 0, 200000 };
+
+	if ( insn->vma != expect->vma || insn->size != expect->size ||
+	     memcmp( insn->bytes, expect->bytes, insn->size ) ||
+	     strcmp( insn->ascii, expect->ascii ) ) {
+		printf( "insn %u: got %p '%s'\n", s->count,
+			(void *) insn->vma, insn->ascii );
+		s->ok = 0;
+	}
+	opdis_insn_free( expect );
+
+	if ( s->slow && s->count % 100 == 0 ) {
+		nanosleep( &ts, NULL );
+	}
+	s->count++;
+}
+
+static int push_insns( pipeline_t p, unsigned int start, unsigned int num ) {
+	unsigned int i;
+	int ok = 1;
+
+	for ( i = start; i < start + num; i++ ) {
+		opdis_insn_t * insn = make_insn( i );
+		ok &= pipeline_push( p, insn );
+		opdis_insn_free( insn );
+	}
+
+	return ok;
+}
+
+int main( void ) {
+	struct SINK s = { 0, 1, 1 };
+	opdis_insn_t * big;
+	char ascii[RING_SIZE];
+	pipeline_t p;
+	unsigned int i;
+	int ok = 1;
+
+	p = pipeline_start( RING_SIZE, sink, &s );
+	if (! p ) {
+		printf( "SKIP: threads are not supported\n" );
+		return 77;
+	}
+
+	/* backpressure: the pusher waits for the slow formatter instead of
+	 * overwriting records. After a drain, every insn has been printed */
+	for ( i = 0; i < NUM_INSNS; i += 500 ) {
+		ok &= push_insns( p, i, 500 );
+		pipeline_drain( p );
+		ok &= ( s.count == i + 500 );
+	}
+
+	/* a record larger than half the ring is refused */
+	memset( ascii, 'x', sizeof(ascii) - 1 );
+	ascii[sizeof(ascii) - 1] = '\0';
+	big = make_insn( 0 );
+	opdis_insn_set_ascii( big, ascii );
+	ok &= (! pipeline_push( p, big ) );
+	opdis_insn_free( big );
+
+	/* done: insns still in the ring are printed before finish returns */
+	s.count = 0;
+	ok &= push_insns( p, 0, NUM_INSNS );
+	pipeline_finish( p );
+	ok &= ( s.count == NUM_INSNS );
+
+	/* an empty ring stops at once */
+	s.count = 0;
+	p = pipeline_start( RING_SIZE, sink, &s );
+	pipeline_finish( p );
+	ok &= ( s.count == 0 );
+
+	ok &= s.ok;
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
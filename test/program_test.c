@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+/* program_callee is in a section of its own: both callers reach it through
+ * a branch target in another section, and program_second reaches it twice */
+#define TEST_FUNC __attribute__((noinline, noclone))
+
+TEST_FUNC __attribute__((section("opdis_test_text")))
+int program_callee( int x ) {
+	return x * 3 + 1;
+}
+
+TEST_FUNC int program_first( int x ) {
+	return program_callee( x ) + 1;
+}
+
+TEST_FUNC int program_second( int x ) {
+	return program_callee( x ) * program_callee( x + 1 );
+}
+
+struct DISPLAY_ARG {
+	opdis_visited_t seen;
+	unsigned int count;
+	int ok;
+};
+
+/* every insn is displayed exactly once */
+static void display( const opdis_insn_t * insn, void * arg ) {
+	struct DISPLAY_ARG * d = (struct DISPLAY_ARG *) arg;
+
+	d->count++;
+	if (! opdis_visited_add( d->seen, insn->vma ) ) {
+		printf( "%p displayed again: %s\n", (void *) insn->vma,
+			insn->ascii );
+		d->ok = 0;
+	}
+}
+
+static opdis_vma_t find_symbol( asymbol ** syms, long num,
+				const char * name ) {
+	long i;
+
+	for ( i = 0; i < num; i++ ) {
+		if (! strcmp( bfd_asymbol_name(syms[i]), name ) ) {
+			return bfd_asymbol_value(syms[i]);
+		}
+	}
+
+	printf( "Symbol %s not found\n", name );
+	return OPDIS_INVALID_ADDR;
+}
+
+int main( int argc, char ** argv ) {
+	struct DISPLAY_ARG arg = { NULL, 0, 1 };
+	opdis_vma_t vmas[2], callee;
+	opdis_stats_t stats;
+	asymbol ** syms;
+	long size, num;
+	opdis_t o;
+	bfd * abfd;
+	int count;
+
+#if ! defined(__i386__) && ! defined(__x86_64__)
+	/* call targets are only resolved on x86 */
+	return 77;
+#endif
+
+	bfd_init();
+	abfd = bfd_openr( argv[0], NULL );
+	if (! abfd || ! bfd_check_format( abfd, bfd_object ) ) {
+		printf( "Unable to open %s\n", argv[0] );
+		return 1;
+	}
+
+	size = bfd_get_symtab_upper_bound( abfd );
+	syms = ( size > 0 ) ? (asymbol **) malloc( size ) : NULL;
+	num = ( syms ) ? bfd_canonicalize_symtab( abfd, syms ) : 0;
+	vmas[0] = find_symbol( syms, num, "program_first" );
+	vmas[1] = find_symbol( syms, num, "program_second" );
+	callee = find_symbol( syms, num, "program_callee" );
+	free( syms );
+	if ( vmas[0] == OPDIS_INVALID_ADDR || vmas[1] == OPDIS_INVALID_ADDR ||
+	     callee == OPDIS_INVALID_ADDR ) {
+		bfd_close( abfd );
+		return 1;
+	}
+
+	o = opdis_init_from_bfd( abfd );
+	arg.seen = opdis_visited_init();
+	opdis_set_display( o, display, &arg );
+	opdis_stats_clear( &stats );
+	opdis_set_stats( o, &stats );
+
+	count = opdis_disasm_bfd_program( o, abfd, vmas, 2 );
+	printf( "Insns: %d Displayed: %u Visited: %lu\n", count, arg.count,
+		(unsigned long) stats.visited_hits );
+
+	/* both start addresses and the shared callee are disassembled. The
+	 * callee is queued by the first call to it; the other two calls are
+	 * visited hits */
+	arg.ok &= ( opdis_visited_contains( arg.seen, vmas[0] ) &&
+		    opdis_visited_contains( arg.seen, vmas[1] ) &&
+		    opdis_visited_contains( arg.seen, callee ) );
+	arg.ok &= ( count > 0 && stats.displayed == arg.count &&
+		    stats.visited_hits >= 2 );
+
+	opdis_set_stats( o, NULL );
+	opdis_visited_free( arg.seen );
+	opdis_term( o );
+	bfd_close( abfd );
+
+	printf( "%s\n", arg.ok ? "PASS" : "FAIL" );
+	return arg.ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <opdis/sec_cache.h>
+
+struct CHECK_ARG {
+	opdis_sec_cache_t cache;
+	int count;
+	int ok;
+};
+
+/* every allocated section must be found at its first and last byte */
+static void check_section( bfd * abfd, asection * s, void * data ) {
+	struct CHECK_ARG * arg = (struct CHECK_ARG *) data;
+	bfd_vma vma = bfd_section_vma( abfd, s );
+	bfd_size_type size = bfd_section_size( abfd, s );
+
+	if (! size || ! (bfd_get_section_flags( abfd, s ) & SEC_ALLOC) ) {
+		return;
+	}
+
+	arg->count++;
+	if ( opdis_sec_cache_find( arg->cache, vma ) != s ||
+	     opdis_sec_cache_find( arg->cache, vma + size - 1 ) != s ) {
+		printf( "Section %s not found at %p\n", s->name, (void *) vma );
+		arg->ok = 0;
+	}
+}
+
+int main( int argc, char ** argv ) {
+	struct CHECK_ARG arg = { NULL, 0, 1 };
+	asection * text, * sec;
+	unsigned char * data;
+	bfd * abfd;
+
+	bfd_init();
+	abfd = bfd_openr( argv[0], NULL );
+	if (! abfd || ! bfd_check_format( abfd, bfd_object ) ) {
+		printf( "Unable to open %s\n", argv[0] );
+		return 1;
+	}
+
+	text = bfd_get_section_by_name( abfd, ".text" );
+
+	/* cap the cache at a single .text section */
+	arg.cache = opdis_sec_cache_init( abfd,
+			(text) ? bfd_section_size( abfd, text ) : 1 );
+	bfd_map_over_sections( abfd, check_section, &arg );
+	printf( "Sections: %lu Allocated: %d\n",
+		(unsigned long) arg.cache->num, arg.count );
+
+	if ( text ) {
+		bfd_size_type size = bfd_section_size( abfd, text );
+		data = (unsigned char *) malloc( size );
+		arg.ok &= opdis_sec_cache_put( arg.cache, text, data, 1 );
+		arg.ok &= ( opdis_sec_cache_get( arg.cache, text ) == data );
+
+		/* .data only fits under the cap if .text is evicted */
+		sec = bfd_get_section_by_name( abfd, ".data" );
+		if ( sec && bfd_section_size( abfd, sec ) ) {
+			data = (unsigned char *) malloc( 
+						bfd_section_size(abfd, sec) );
+			if (! opdis_sec_cache_put( arg.cache, sec, data, 1 ) ) {
+				/* caller keeps buffer if it is not cached */
+				free( data );
+			} else {
+				arg.ok &= ! opdis_sec_cache_get(arg.cache, text);
+			}
+		}
+		arg.ok &= ( arg.cache->bytes <= arg.cache->max_bytes );
+
+		/* a frozen cache accepts no new contents */
+		opdis_sec_cache_freeze( arg.cache );
+		data = (unsigned char *) malloc( size );
+		if (! opdis_sec_cache_put( arg.cache, text, data, 1 ) ) {
+			free( data );
+		} else {
+			arg.ok = 0;
+		}
+		printf( "Cached: %lu Hits: %lu Misses: %lu\n",
+			(unsigned long) arg.cache->bytes, arg.cache->hits,
+			arg.cache->misses );
+	}
+
+	opdis_sec_cache_free( arg.cache );
+	bfd_close( abfd );
+
+	printf( "%s\n", arg.ok ? "PASS" : "FAIL" );
+	return arg.ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+/* push, call rel32, je +2, nop, nop, pop, ret */
+static const unsigned char code[] = {
+	0x55, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x74, 0x02, 0x90, 0x90, 0x5D, 0xC3
+};
+#define CALL_TARGET 0x2000
+
+static opdis_buf_t code_at( opdis_vma_t vma ) {
+	opdis_buf_t buf = opdis_buf_alloc( sizeof(code), vma );
+	int32_t rel = (int32_t) ( CALL_TARGET - (vma + 6) );
+
+	memcpy( buf->data, code, sizeof(code) );
+	buf->data[2] = rel & 0xFF;
+	buf->data[3] = (rel >> 8) & 0xFF;
+	buf->data[4] = (rel >> 16) & 0xFF;
+	buf->data[5] = (rel >> 24) & 0xFF;
+
+	return buf;
+}
+
+static int check_sig( opdis_t o, opdis_buf_t buf, opdis_vma_t vma,
+		      const char * expected ) {
+	opdis_insn_t * insn = opdis_insn_alloc_fixed( 128, 32, 16, 32 );
+	opdis_insn_sig_t sig;
+	char str[128];
+	int ok;
+
+	ok = ( opdis_disasm_invariant( o, buf, vma, insn, &sig ) > 0 );
+	opdis_insn_sig_str( &sig, str, sizeof(str) );
+	ok &= ! strcmp( str, expected );
+	ok &= opdis_insn_sig_match( &sig, &buf->data[vma - buf->vma],
+				    buf->len - (vma - buf->vma) );
+	printf( "%-24s %s\n", insn->ascii, str );
+
+	opdis_insn_free( insn );
+	return ok;
+}
+
+int main( void ) {
+	opdis_buf_t a = code_at( 0x1000 ), b = code_at( 0x5000 );
+	opdis_sig_index_t index = opdis_sig_index_init( 1 );
+	opdis_sig_index_t other = opdis_sig_index_init( 1 );
+	const opdis_sig_block_t * blk;
+	opdis_t o = opdis_init();
+	size_t i;
+	int ok = 1, num;
+
+	/* addresses are wildcarded; constants and opcodes are not */
+	ok &= check_sig( o, a, 0x1000, "55" );
+	ok &= check_sig( o, a, 0x1001, "e8 ?? ?? ?? ??" );
+	ok &= check_sig( o, a, 0x1006, "74 ??" );
+	ok &= ( memcmp( &a->data[2], &b->data[2], 4 ) != 0 );
+
+	/* same code at another address has the same block hashes */
+	num = opdis_sig_index_build( o, a, 0x1000, 0, index );
+	printf( "Blocks: %d\n", num );
+	ok &= ( num == 4 && index->num == 4 );
+	ok &= ( opdis_sig_index_build( o, b, 0x5000, 0, other ) == num );
+
+	for ( i = 0; i < other->num_buckets; i++ ) {
+		const opdis_sig_block_t * ob;
+		for ( ob = other->buckets[i]; ob; ob = ob->next ) {
+			blk = opdis_sig_index_find( index, ob->hash );
+			if (! blk || blk->vma - 0x1000 != ob->vma - 0x5000 ||
+			     blk->num_insns != ob->num_insns ||
+			     blk->size != ob->size ) {
+				printf( "Block at %p not matched\n",
+					(void *) ob->vma );
+				ok = 0;
+			}
+		}
+	}
+
+	ok &= ( opdis_sig_index_find( index, 0x1234 ) == NULL );
+
+	/* a changed opcode changes the block hash: nop, nop -> nop, ret */
+	b->data[9] = 0xC3;
+	opdis_sig_index_free( other );
+	other = opdis_sig_index_init( 2 );
+	ok &= ( opdis_sig_index_build( o, b, 0x5000, 0, other ) == 3 );
+	for ( i = 0, num = 0; i < other->num_buckets; i++ ) {
+		const opdis_sig_block_t * ob;
+		for ( ob = other->buckets[i]; ob; ob = ob->next ) {
+			num += ( opdis_sig_index_find( index, ob->hash ) !=
+				 NULL );
+		}
+	}
+	printf( "Matched after change: %d of %lu\n", num,
+		(unsigned long) other->num );
+	ok &= ( num == 2 );
+
+	opdis_term( o );
+	opdis_buf_free( a );
+	opdis_buf_free( b );
+	opdis_sig_index_free( index );
+	opdis_sig_index_free( other );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+
+/* 0x1000: push; je 0x1006; nop; jmp 0x1008; nop; nop; call 0x1011; pop;
+ *         ret; nop; nop; nop; ret */
+static const unsigned char code[] = {
+	0x55, 0x74, 0x03, 0x90, 0xEB, 0x02, 0x90, 0x90,
+	0xE8, 0x04, 0x00, 0x00, 0x00, 0x5D, 0xC3, 0x90,
+	0x90, 0x90, 0xC3
+};
+
+static void display( const opdis_insn_t * insn, void * arg ) {
+	(*(unsigned int *) arg)++;
+}
+
+static void print_stats( const char * name, const opdis_stats_t * s ) {
+	unsigned int i;
+
+	printf( "%-8s Insns: %lu Bytes: %lu Displayed: %lu Visited: %lu "
+		"Resolved: %lu Unresolved: %lu\n", name,
+		(unsigned long) s->insns, (unsigned long) s->bytes,
+		(unsigned long) s->displayed, (unsigned long) s->visited_hits,
+		(unsigned long) s->targets_resolved,
+		(unsigned long) s->targets_unresolved );
+	printf( "        " );
+	for ( i = 0; i < opdis_phase_count; i++ ) {
+		printf( " %s: %lu", opdis_stats_phase_name( i ),
+			(unsigned long) s->ticks[i] );
+	}
+	printf( "\n" );
+}
+
+int main( void ) {
+	opdis_buf_t buf = opdis_buf_alloc( sizeof(code), 0x1000 );
+	opdis_t o = opdis_init();
+	opdis_stats_t stats, sum;
+	unsigned int count = 0;
+	int ok = 1;
+
+	memcpy( buf->data, code, sizeof(code) );
+	o->visited_addr = opdis_visited_init();
+	opdis_set_display( o, display, &count );
+
+	/* nothing is collected by default */
+	opdis_disasm_linear( o, buf, buf->vma, 0 );
+	ok &= ( opdis_get_stats( o ) == NULL );
+
+	opdis_stats_clear( &stats );
+	opdis_set_stats( o, &stats );
+	ok &= ( opdis_get_stats( o ) == &stats );
+
+	/* linear: every insn is decoded and displayed */
+	count = 0;
+	opdis_visited_clear( o->visited_addr );
+	opdis_disasm_linear( o, buf, buf->vma, 0 );
+	print_stats( "linear", &stats );
+	ok &= ( stats.insns == 13 && stats.bytes == sizeof(code) &&
+		stats.displayed == count && count == 13 &&
+		stats.invalid == 0 && stats.targets_resolved == 0 &&
+		stats.ticks[opdis_phase_opcodes] > 0 &&
+		stats.ticks[opdis_phase_decode] > 0 &&
+		stats.ticks[opdis_phase_display] > 0 &&
+		opdis_stats_total( &stats ) > 0 );
+
+	/* cflow: je, jmp and call are resolved. the run from the je target
+	 * ends at the call, which has been visited, without decoding it */
+	opdis_stats_clear( &stats );
+	count = 0;
+	opdis_visited_clear( o->visited_addr );
+	opdis_disasm_cflow( o, buf, buf->vma );
+	print_stats( "cflow", &stats );
+	ok &= ( stats.displayed == count && stats.insns == count &&
+		stats.targets_resolved == 3 && stats.targets_unresolved == 0 &&
+		stats.visited_hits == 1 &&
+		stats.ticks[opdis_phase_resolve] > 0 );
+
+	/* parallel: the stats of each thread are added to those of o */
+	opdis_stats_clear( &stats );
+	count = 0;
+	opdis_visited_clear( o->visited_addr );
+	opdis_disasm_linear_parallel( o, buf, buf->vma, 0, 2 );
+	print_stats( "parallel", &stats );
+	ok &= ( stats.displayed == 13 && stats.insns >= 13 );
+
+	/* opdis_stats_add sums all fields */
+	opdis_stats_clear( &sum );
+	opdis_stats_add( &sum, &stats );
+	opdis_stats_add( &sum, &stats );
+	ok &= ( sum.insns == 2 * stats.insns &&
+		opdis_stats_total( &sum ) == 2 * opdis_stats_total( &stats ) );
+
+	opdis_set_stats( o, NULL );
+	opdis_visited_free( o->visited_addr );
+	opdis_term( o );
+	opdis_buf_free( buf );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/map.h"
+#include "../src/sym.h"
+
+/* ---------------------------------------------------------------------- */
+/* MEMORY MAP */
+
+typedef struct {
+	unsigned int target;
+	opdis_off_t offset;
+	opdis_vma_t vma;
+} map_request_t;
+
+/* reference: the first map in VMA order that contains offset */
+static int find_map( map_t * map, void * arg ) {
+	map_request_t * req = (map_request_t *) arg;
+
+	if ( map->target == req->target && req->offset >= map->offset &&
+	     (! map->size || req->offset < map->offset + map->size) ) {
+		req->vma = map->vma;
+		return 0;
+	}
+
+	return 1;
+}
+
+static opdis_vma_t ref_vma( mem_map_t m, unsigned int target,
+			    opdis_off_t offset ) {
+	map_request_t req = { target, offset, OPDIS_INVALID_ADDR };
+
+	mem_map_foreach( m, find_map, &req );
+	if ( req.vma == OPDIS_INVALID_ADDR && offset > 0 ) {
+		req.offset = 0;
+		mem_map_foreach( m, find_map, &req );
+	}
+
+	return req.vma;
+}
+
+static int check_vma( mem_map_t m, unsigned int target, opdis_off_t offset,
+		      opdis_vma_t expect ) {
+	opdis_vma_t vma = mem_map_vma_for_target( m, target, offset );
+
+	if ( vma != expect || vma != ref_vma( m, target, offset ) ) {
+		printf( "target %u offset %p: got %p, expected %p\n", target,
+			(void *) offset, (void *) vma, (void *) expect );
+		return 0;
+	}
+
+	return 1;
+}
+
+static int test_map( void ) {
+	mem_map_t m = mem_map_alloc();
+	unsigned int target;
+	opdis_off_t off;
+	int ok = 1;
+
+	/* target 1: overlapping ranges of the target at different VMAs */
+	ok &= mem_map_add( m, 1, 0x80, 0x100, 0x3000 );
+	ok &= mem_map_add( m, 1, 0, 0x100, 0x1000 );
+	ok &= mem_map_add( m, 1, 0x40, 0x20, 0x2000 );
+	/* target 2: a size-0 map runs through the end of the target */
+	ok &= mem_map_add( m, 2, 0x10, 0, 0x8000 );
+	ok &= mem_map_add( m, 2, 0x20, 0x10, 0x4000 );
+	/* target 3 only maps a range after offset 0 */
+	ok &= mem_map_add( m, 3, 0x100, 0x10, 0x5000 );
+
+	/* the VMA range is already mapped */
+	ok &= (! mem_map_add( m, 4, 0, 0x10, 0x1010 ) );
+	ok &= (! mem_map_add( m, 4, 0, 0x10, 0x0ff8 ) );
+	ok &= ( mem_map_count( m ) == 6 );
+
+	/* lookups fail until the map is indexed */
+	ok &= ( mem_map_vma_for_target( m, 1, 0 ) == OPDIS_INVALID_ADDR );
+	ok &= mem_map_index( m );
+
+	ok &= check_vma( m, 1, 0, 0x1000 );
+	ok &= check_vma( m, 1, 0x50, 0x1000 );
+	ok &= check_vma( m, 1, 0x90, 0x1000 );
+	ok &= check_vma( m, 1, 0x150, 0x3000 );
+	ok &= check_vma( m, 1, 0x500, 0x1000 );
+	ok &= check_vma( m, 2, 0, OPDIS_INVALID_ADDR );
+	ok &= check_vma( m, 2, 0x25, 0x4000 );
+	ok &= check_vma( m, 2, 0x100000, 0x8000 );
+	ok &= check_vma( m, 3, 0x108, 0x5000 );
+	ok &= check_vma( m, 3, 0x200, OPDIS_INVALID_ADDR );
+	ok &= check_vma( m, 4, 0, OPDIS_INVALID_ADDR );
+
+	/* adding a map invalidates the index */
+	ok &= mem_map_add( m, 2, 0, 0x8, 0x9000 );
+	ok &= ( mem_map_vma_for_target( m, 2, 0 ) == OPDIS_INVALID_ADDR );
+	ok &= mem_map_index( m );
+	ok &= check_vma( m, 2, 0, 0x9000 );
+	ok &= check_vma( m, 2, 0x100000, 0x8000 );
+
+	for ( target = 0; target <= 4; target++ ) {
+		for ( off = 0; off < 0x200; off += 8 ) {
+			ok &= ( mem_map_vma_for_target( m, target, off ) ==
+				ref_vma( m, target, off ) );
+		}
+	}
+
+	mem_map_free( m );
+	return ok;
+}
+
+/* ---------------------------------------------------------------------- */
+/* SYMBOL TABLE */
+
+static void add_func( const char * name, opdis_vma_t vma, void * arg ) {
+	char * buf = (char *) arg;
+	strcat( buf, name );
+}
+
+static int test_sym( void ) {
+	sym_tab_t s = sym_tab_alloc();
+	char funcs[32] = "";
+	int ok = 1;
+
+	ok &= sym_tab_add( s, "main", 0x30, 1 );
+	ok &= sym_tab_add( s, "start", 0x10, 1 );
+	ok &= sym_tab_add( s, "data", 0x20, 0 );
+	/* duplicate name and duplicate VMA: the first added wins */
+	ok &= sym_tab_add( s, "main", 0x40, 1 );
+	ok &= sym_tab_add( s, "alias", 0x10, 1 );
+	ok &= sym_tab_add( s, "exit", 0x50, 1 );
+
+	/* lookups find nothing until the table is indexed */
+	ok &= ( sym_tab_find_vma( s, "main" ) == OPDIS_INVALID_ADDR );
+	ok &= ( sym_tab_find_name( s, 0x30 ) == NULL );
+	ok &= sym_tab_index( s );
+
+	ok &= ( sym_tab_find_vma( s, "main" ) == 0x30 );
+	ok &= ( sym_tab_find_vma( s, "start" ) == 0x10 );
+	ok &= ( sym_tab_find_vma( s, "alias" ) == OPDIS_INVALID_ADDR );
+	ok &= ( sym_tab_find_vma( s, "none" ) == OPDIS_INVALID_ADDR );
+	ok &= ( sym_tab_find_name( s, 0x10 ) &&
+		! strcmp( sym_tab_find_name( s, 0x10 ), "start" ) );
+	ok &= ( sym_tab_find_name( s, 0x20 ) &&
+		! strcmp( sym_tab_find_name( s, 0x20 ), "data" ) );
+	ok &= ( sym_tab_find_name( s, 0x40 ) == NULL );
+	ok &= ( sym_tab_find_name( s, 0x18 ) == NULL );
+
+	/* functions are visited in order of VMA */
+	sym_tab_foreach_func( s, add_func, funcs );
+	ok &= (! strcmp( funcs, "startmainexit" ) );
+
+	/* a later symbol does not displace an indexed one */
+	ok &= sym_tab_add( s, "start", 0x60, 1 );
+	ok &= sym_tab_index( s );
+	ok &= ( sym_tab_find_vma( s, "start" ) == 0x10 );
+	ok &= ( sym_tab_find_name( s, 0x60 ) == NULL );
+
+	sym_tab_free( s );
+	return ok;
+}
+
+int main( void ) {
+	int ok = 1;
+
+	ok &= test_map();
+	ok &= test_sym();
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
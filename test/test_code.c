@@ -0,0 +1,32 @@
+/* test_code.c
+ * generated x86 code shared by the tests and the benchmarks
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#include <string.h>
+
+#include "test_code.h"
+
+uint32_t test_rand( uint32_t * seed ) {
+	*seed = *seed * 1103515245U + 12345U;
+	return *seed >> 16;
+}
+
+void test_fill_encodings( opdis_buf_t buf, uint32_t seed ) {
+	static const unsigned char encodings[][5] = {
+		{ 0xE8, 0x10, 0x00, 0x00, 0x00 },	/* call rel32 */
+		{ 0xE9, 0xF0, 0xFF, 0xFF, 0xFF },	/* jmp rel32 */
+		{ 0xB8, 0x00, 0x10, 0x40, 0x00 },	/* mov $0x401000,%eax */
+		{ 0x55, 0x89, 0xE5, 0x5D, 0xC3 },	/* push/mov/pop/ret */
+		{ 0x74, 0x02, 0xEB, 0xFC, 0x90 }	/* je, jmp rel8, nop */
+	};
+	opdis_off_t i;
+
+	for ( i = 0; i + 5 <= buf->len; i += 5 ) {
+		memcpy( &buf->data[i], encodings[test_rand( &seed ) % 5], 5 );
+	}
+	memset( &buf->data[i], 0x90, buf->len - i );
+}
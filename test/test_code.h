@@ -0,0 +1,24 @@
+/* test_code.h
+ * generated x86 code shared by the tests and the benchmarks
+ * Copyright (c) 2010 ThoughtGang
+ * Written by TG Community Developers <community@thoughtgang.org>
+ * Released under the GNU Public License, version 3.
+ * See http://www.gnu.org/licenses/gpl.txt for details.
+ */
+
+#ifndef OPDIS_TEST_CODE_H
+#define OPDIS_TEST_CODE_H
+
+#include <stdint.h>
+
+#include <opdis/opdis.h>
+
+/* fixed-seed LCG, so that generated code is the same for every run */
+uint32_t test_rand( uint32_t * seed );
+
+/* fill buf with 5-byte x86 encodings chosen by test_rand: relative calls
+ * and jumps, an immediate, stack ops and nops. The tail of buf which is
+ * too short for an encoding is filled with nops. */
+void test_fill_encodings( opdis_buf_t buf, uint32_t seed );
+
+#endif
@@ -0,0 +1,221 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/text_fmt.h"
+
+/* ---------------------------------------------------------------------- */
+/* REFERENCE COMPARISON */
+
+static int check_str( const char * what, uint64_t val, const char * out,
+		      size_t len, const char * expect ) {
+	if ( len != strlen(expect) || memcmp( out, expect, len ) ) {
+		printf( "%s %llu: got '%.*s', expected '%s'\n", what,
+			(unsigned long long) val, (int) len, out, expect );
+		return 0;
+	}
+
+	return 1;
+}
+
+static const uint64_t values[] = {
+	0, 1, 7, 8, 9, 10, 15, 16, 99, 100, 255, 256, 999, 1000,
+	0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0x100000000ULL,
+	9999999999999999999ULL, 10000000000000000000ULL,
+	(uint64_t) INT64_MAX, (uint64_t) INT64_MIN, (uint64_t) -1,
+	UINT64_MAX - 1, UINT64_MAX
+};
+
+static int check_value( uint64_t val ) {
+	char out[TXT_NUM_MAX], ref[TXT_NUM_MAX + 8];
+	int ok = 1;
+
+	snprintf( ref, sizeof(ref), "%llu", (unsigned long long) val );
+	ok &= check_str( "udec", val, out, txt_udec( out, val ), ref );
+
+	snprintf( ref, sizeof(ref), "%lld", (long long) (int64_t) val );
+	ok &= check_str( "sdec", val, out, txt_sdec( out, (int64_t) val ),
+			 ref );
+
+	snprintf( ref, sizeof(ref), "%llo", (unsigned long long) val );
+	ok &= check_str( "oct", val, out, txt_oct( out, val ), ref );
+
+	snprintf( ref, sizeof(ref), "%llX", (unsigned long long) val );
+	ok &= check_str( "hex", val, out, txt_hex( out, val, 1 ), ref );
+
+	snprintf( ref, sizeof(ref), "%llx", (unsigned long long) val );
+	ok &= check_str( "hex lower", val, out, txt_hex( out, val, 0 ), ref );
+
+	snprintf( ref, sizeof(ref), "%#llX", (unsigned long long) val );
+	ok &= check_str( "hex alt", val, out, txt_hex_alt( out, val ), ref );
+
+	snprintf( ref, sizeof(ref), "0x%llx", (unsigned long long) val );
+	ok &= check_str( "addr", val, out, txt_addr( out, val ), ref );
+
+	return ok;
+}
+
+static int test_numbers( void ) {
+	uint64_t val = 0x0123456789ABCDEFULL;
+	unsigned int i;
+	int ok = 1;
+
+	for ( i = 0; i < sizeof(values) / sizeof(values[0]); i++ ) {
+		ok &= check_value( values[i] );
+	}
+
+	/* every magnitude, plus pseudo-random values */
+	for ( i = 0; i < 64; i++ ) {
+		ok &= check_value( 1ULL << i );
+		ok &= check_value( ( 1ULL << i ) - 1 );
+	}
+	for ( i = 0; i < 10000; i++ ) {
+		val = val * 6364136223846793005ULL + 1442695040888963407ULL;
+		ok &= check_value( val );
+		ok &= check_value( val >> ( i % 64 ) );
+	}
+
+	return ok;
+}
+
+/* ---------------------------------------------------------------------- */
+/* BYTES */
+
+static int check_bytes( const unsigned char * bytes, size_t n, char sep ) {
+	char out[TXT_HEX_BYTES_LEN(33, 1)];
+	char ref[TXT_HEX_BYTES_LEN(33, 1) + 4];
+	size_t i, pos = 0, len;
+
+	for ( i = 0; i < n; i++ ) {
+		if ( i && sep ) {
+			ref[pos++] = sep;
+		}
+		pos += snprintf( &ref[pos], sizeof(ref) - pos, "%02X",
+				 bytes[i] );
+	}
+	ref[pos] = '\0';
+
+	len = txt_hex_bytes( out, bytes, n, sep );
+	if ( len != pos || memcmp( out, ref, len ) ) {
+		printf( "hex bytes %u sep '%c': got '%.*s', expected '%s'\n",
+			(unsigned int) n, sep ? sep : ' ', (int) len, out, ref );
+		return 0;
+	}
+
+	return 1;
+}
+
+static int test_bytes( void ) {
+	unsigned char bytes[33];
+	char out[2];
+	unsigned int i, n, seed = 1;
+	int ok = 1;
+
+	for ( i = 0; i < 256; i++ ) {
+		char ref[3];
+		snprintf( ref, sizeof(ref), "%02X", i );
+		ok &= check_str( "hex byte", i, out,
+				 txt_hex_byte( out, (unsigned char) i ), ref );
+	}
+
+	/* the SIMD paths convert 16 bytes at a time: cover each tail */
+	for ( n = 0; n <= sizeof(bytes); n++ ) {
+		for ( i = 0; i < 100; i++ ) {
+			unsigned int j;
+			for ( j = 0; j < n; j++ ) {
+				seed = seed * 1103515245 + 12345;
+				bytes[j] = (unsigned char) ( seed >> 16 );
+			}
+			if (! i ) {
+				memset( bytes, 0xFF, n );
+			} else if ( i == 1 ) {
+				memset( bytes, 0, n );
+			}
+			ok &= check_bytes( bytes, n, 0 );
+			ok &= check_bytes( bytes, n, ' ' );
+		}
+	}
+
+	return ok;
+}
+
+/* ---------------------------------------------------------------------- */
+/* PARSING */
+
+static int check_parse( const char * str, int base ) {
+	unsigned long val = 0, expect;
+	char * end;
+	int rv, valid;
+
+	errno = 0;
+	expect = strtoul( str, &end, base );
+	valid = ( end != str && *end == '\0' );
+
+	rv = txt_parse( str, base, &val );
+	if ( rv != valid || ( valid && val != expect ) ) {
+		printf( "parse '%s' base %d: got %d %lu, expected %d %lu\n",
+			str, base, rv, val, valid, expect );
+		return 0;
+	}
+
+	return 1;
+}
+
+static int test_parse( void ) {
+	const char * strs[] = {
+		"0", "1", "42", "  42", "\t7", "+7", "-1", "-0", "",
+		" ", "+", "-", "12a", "a12", "0x", "0x1F", "0X1f", "0xg",
+		"ff", "FF", "zz", "Zz", "017", "08", "0b1",
+		"4294967295", "4294967296", "9223372036854775808",
+		"18446744073709551615", "18446744073709551616",
+		"99999999999999999999999", "0xFFFFFFFFFFFFFFFF",
+		"0x10000000000000000", "-18446744073709551615",
+		"1777777777777777777777", "2000000000000000000000",
+		"42 ", NULL
+	};
+	const int bases[] = { 2, 8, 10, 16, 36 };
+	char buf[TXT_NUM_MAX + 1];
+	uint64_t val = 0xFEDCBA9876543210ULL;
+	unsigned long lval;
+	unsigned int i, j;
+	int ok = 1;
+
+	for ( i = 0; strs[i]; i++ ) {
+		for ( j = 0; j < sizeof(bases) / sizeof(bases[0]); j++ ) {
+			ok &= check_parse( strs[i], bases[j] );
+		}
+	}
+
+	/* unlike strtoul, base 0 is not supported */
+	ok &= (! txt_parse( "10", 0, &lval ) );
+	ok &= (! txt_parse( "10", 1, &lval ) );
+	ok &= (! txt_parse( "10", 37, &lval ) );
+
+	/* round trip through the formatters */
+	for ( i = 0; i < 1000; i++ ) {
+		val = val * 6364136223846793005ULL + 1442695040888963407ULL;
+		lval = (unsigned long) val;
+		buf[txt_udec( buf, lval )] = '\0';
+		ok &= check_parse( buf, 10 );
+		buf[txt_hex_alt( buf, lval )] = '\0';
+		ok &= check_parse( buf, 16 );
+		buf[txt_oct( buf, lval )] = '\0';
+		ok &= check_parse( buf, 8 );
+	}
+
+	return ok;
+}
+
+int main( void ) {
+	int ok = 1;
+
+	ok &= test_numbers();
+	ok &= test_bytes();
+	ok &= test_parse();
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
@@ -43,7 +43,7 @@ static int printtree( void * data, void * arg ) {
 }
 
 static int sumtree( void * data, void * arg ) {
-	int *sum = (int *) arg;
+	long *sum = (long *) arg;
 	long num = (long) data;
 	*sum += num;
 	return 1;
@@ -67,44 +67,132 @@ static int cmp_str( void * arg_a, void * arg_b ) {
 	return strcmp(a, b);
 }
 
+/* height of a subtree, or -1 if any node in it is out of balance */
+static int tree_height( opdis_tree_node_t * node ) {
+	int l, r;
+
+	if (! node ) {
+		return 0;
+	}
+
+	l = tree_height( node->left );
+	r = tree_height( node->right );
+	if ( l < 0 || r < 0 || l - r > 1 || r - l > 1 ) {
+		return -1;
+	}
+
+	return 1 + ( ( l > r ) ? l : r );
+}
+
+/* three keys inserted in any order must rotate into a tree rooted at 2 */
+static int check_rotation( long a, long b, long c ) {
+	opdis_tree_t t;
+	int ok = 1;
+
+	t = opdis_tree_init( NULL, NULL, NULL );
+	ok &= opdis_tree_add( t, (void *) a );
+	ok &= opdis_tree_add( t, (void *) b );
+	ok &= opdis_tree_add( t, (void *) c );
+	ok &= ( tree_height( t->root ) == 2 && (long) t->root->data == 2 &&
+		t->root->left && (long) t->root->left->data == 1 &&
+		t->root->right && (long) t->root->right->data == 3 );
+	if (! ok ) {
+		printf( "Insert %ld %ld %ld was not rotated\n", a, b, c );
+	}
+	opdis_tree_free( t );
+
+	return ok;
+}
+
 int main (void) {
 	long i, sum, treesum;
 	opdis_tree_t t;
+	opdis_arena_t a;
 	struct TN *strtn;
+	int height, ok = 1;
 
 	/* ============================================== */
 	/* test the unsigned int comparison */
 	t = opdis_tree_init( NULL, NULL, NULL );
 	sum = treesum = 0;
-	for ( i = 0; i < 1024; i++ ) {
-		opdis_tree_add( t, (void *) i );
+	for ( i = 1; i <= 1024; i++ ) {
+		ok &= opdis_tree_add( t, (void *) i );
 		sum += i;
 	}
 
 	opdis_tree_foreach( t, sumtree, &treesum );
 
 	printf( "(unsigned) SUM: %ld TreeSUM: %ld\n", sum, treesum );
+	ok &= ( sum == treesum && opdis_tree_count( t ) == 1024 );
 	opdis_tree_free( t );
-		
+
+	/* ascending and descending inserts must keep the tree balanced: 1024
+	 * nodes fit in a tree of height 11 */
+	t = opdis_tree_init( NULL, NULL, NULL );
+	for ( i = 1; i <= 1024; i++ ) {
+		ok &= opdis_tree_add( t, (void *) i );
+	}
+	height = tree_height( t->root );
+	printf( "(ascending)  Height: %d\n", height );
+	ok &= ( height > 0 && height <= 11 );
+	opdis_tree_free( t );
+
+	t = opdis_tree_init( NULL, NULL, NULL );
+	for ( i = 1024; i > 0; i-- ) {
+		ok &= opdis_tree_add( t, (void *) i );
+	}
+	height = tree_height( t->root );
+	printf( "(descending) Height: %d\n", height );
+	ok &= ( height > 0 && height <= 11 );
+	opdis_tree_free( t );
+
+	/* a node with a single child must rotate like any other: left-left,
+	 * right-right, left-right and right-left */
+	ok &= check_rotation( 3, 2, 1 );
+	ok &= check_rotation( 1, 2, 3 );
+	ok &= check_rotation( 3, 1, 2 );
+	ok &= check_rotation( 1, 3, 2 );
 
 	/* test the signed int comparison */
 	t = opdis_tree_init( NULL, cmp_int, NULL );
 	sum = treesum = 0;
-	for ( i = -512; i < 512; i++ ) {
-		opdis_tree_add( t, (void *) i );
+	for ( i = -512; i <= 512; i++ ) {
+		if (! i ) {
+			/* a NULL item is not stored */
+			continue;
+		}
+		ok &= opdis_tree_add( t, (void *) i );
 		sum += i;
 	}
 
 	opdis_tree_foreach( t, sumtree, &treesum );
 
 	printf( " (signed)  SUM: %ld TreeSUM: %ld\n", sum, treesum );
+	ok &= ( sum == treesum && opdis_tree_count( t ) == 1024 );
 	opdis_tree_free( t );
 
 
+	/* test a tree with nodes allocated from an arena */
+	a = opdis_arena_init( 4096 );
+	t = opdis_tree_init_arena( NULL, NULL, NULL, a );
+	sum = treesum = 0;
+	for ( i = 1; i <= 1024; i++ ) {
+		ok &= opdis_tree_add( t, (void *) i );
+		sum += i;
+	}
+
+	opdis_tree_foreach( t, sumtree, &treesum );
+
+	printf( " (arena)   SUM: %ld TreeSUM: %ld\n", sum, treesum );
+	ok &= ( sum == treesum && opdis_tree_count( t ) == 1024 );
+	opdis_tree_free( t );
+	opdis_arena_free( a );
+
+
 	/* test against our home-brewed tree */
 	t = opdis_tree_init( NULL, cmp_str, NULL );
 	for ( i = 0; i <= 14; i++ ) {
-		opdis_tree_add( t, (void *) (strtree[i].data) );
+		ok &= opdis_tree_add( t, (void *) (strtree[i].data) );
 	}
 
 	printf("Reference tree: ");
@@ -117,5 +205,6 @@ int main (void) {
 
 	opdis_tree_free( t );
 
-	return 0;
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
 }
@@ -0,0 +1,91 @@
+#include <stdio.h>
+
+#include <opdis/visited.h>
+
+struct SUM_ARG {
+	unsigned long sum;
+	unsigned long count;
+	opdis_vma_t last;
+	int ordered;
+};
+
+static int sum_vma( opdis_vma_t vma, void * arg ) {
+	struct SUM_ARG * s = (struct SUM_ARG *) arg;
+	if ( s->count && vma <= s->last ) {
+		s->ordered = 0;
+	}
+	s->sum += vma;
+	s->last = vma;
+	s->count++;
+	return 1;
+}
+
+/* fill set with a mix of in-range and out-of-range addresses */
+static int fill_set( opdis_visited_t v, unsigned long * sum ) {
+	opdis_vma_t i;
+	int dupes = 0;
+
+	*sum = 0;
+	for ( i = 0x1000; i < 0x1000 + 4096; i += 3 ) {
+		opdis_visited_add( v, i );
+		*sum += i;
+	}
+	for ( i = 0x10; i < 0x100; i += 7 ) {
+		opdis_visited_add( v, i );
+		*sum += i;
+	}
+	for ( i = 0x80000000; i < 0x80000100; i += 5 ) {
+		opdis_visited_add( v, i );
+		*sum += i;
+	}
+
+	/* second pass must report every address as already present */
+	for ( i = 0x1000; i < 0x1000 + 4096; i += 3 ) {
+		dupes += opdis_visited_add( v, i );
+	}
+
+	return dupes;
+}
+
+static int check_set( const char * name, opdis_visited_t v ) {
+	struct SUM_ARG s = { 0, 0, 0, 1 };
+	unsigned long sum;
+	int dupes = fill_set( v, &sum );
+
+	opdis_visited_foreach( v, sum_vma, &s );
+
+	printf( "%-8s SUM: %lu SetSUM: %lu Count: %lu/%lu Ordered: %d "
+		"Dupes: %d\n", name, sum, s.sum, s.count,
+		(unsigned long) opdis_visited_count(v), s.ordered, dupes );
+
+	return ( sum == s.sum && s.count == opdis_visited_count(v) &&
+		 s.ordered && ! dupes &&
+		 opdis_visited_contains( v, 0x1003 ) &&
+		 ! opdis_visited_contains( v, 0x1004 ) );
+}
+
+int main( void ) {
+	int ok = 1;
+	opdis_visited_t v;
+
+	v = opdis_visited_init_bitmap( 0x1000, 4096 );
+	ok &= check_set( "bitmap", v );
+	opdis_visited_free( v );
+
+	v = opdis_visited_init_tree();
+	ok &= check_set( "tree", v );
+	opdis_visited_free( v );
+
+	/* bitmap bound after addresses were added: entries must migrate */
+	v = opdis_visited_init();
+	ok &= check_set( "unbound", v );
+	opdis_visited_cover( v, 0x1001, 4000 );
+	opdis_visited_cover( v, 0x10, 0x100 );
+	ok &= opdis_visited_contains( v, 0x1003 ) && 
+	      opdis_visited_contains( v, 0x17 ) && v->bits != NULL;
+	printf( "migrate  Count: %lu\n", (unsigned long) opdis_visited_count(v));
+	opdis_visited_free( v );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
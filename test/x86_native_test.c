@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <opdis/opdis.h>
+#include <opdis/x86_decoder.h>
+#include <opdis/x86_native.h>
+
+#define CODE_VMA 0x401000
+
+struct NATIVE_CASE {
+	enum opdis_x86_mode_t mode;
+	unsigned int size;
+	const char * bytes;
+	const char * intel;
+	const char * att;
+};
+
+/* expected ascii, in the format used by libopcodes */
+static const struct NATIVE_CASE cases[] = {
+	{ opdis_x86_mode_64, 1, "\x55", "push   rbp", "push   %rbp" },
+	{ opdis_x86_mode_64, 3, "\x48\x89\xe5", "mov    rbp,rsp",
+	  "mov    %rsp,%rbp" },
+	{ opdis_x86_mode_64, 4, "\x48\x83\xec\x10", "sub    rsp,0x10",
+	  "sub    $0x10,%rsp" },
+	{ opdis_x86_mode_64, 7, "\x48\x8b\x05\xe2\x2f\x00\x00",
+	  "mov    rax,QWORD PTR [rip+0x2fe2]        # 0x00403fe9",
+	  "mov    0x2fe2(%rip),%rax        # 0x00403fe9" },
+	{ opdis_x86_mode_64, 6, "\xff\x25\xe4\x2f\x00\x00",
+	  "jmp    QWORD PTR [rip+0x2fe4]        # 0x00403fea",
+	  "jmp    *0x2fe4(%rip)        # 0x00403fea" },
+	{ opdis_x86_mode_64, 7, "\x48\x8b\x05\xf0\xff\xff\xff",
+	  "mov    rax,QWORD PTR [rip+0xfffffffffffffff0]        # 0x00400ff7",
+	  "mov    -0x10(%rip),%rax        # 0x00400ff7" },
+	{ opdis_x86_mode_64, 6, "\xff\x25\xf0\xff\xff\xff",
+	  "jmp    QWORD PTR [rip+0xfffffffffffffff0]        # 0x00400ff6",
+	  "jmp    *-0x10(%rip)        # 0x00400ff6" },
+	{ opdis_x86_mode_64, 2, "\xff\xd0", "call   rax", "call   *%rax" },
+	{ opdis_x86_mode_64, 2, "\xff\xe0", "jmp    rax", "jmp    *%rax" },
+	{ opdis_x86_mode_64, 3, "\x41\xff\xd3", "call   r11",
+	  "call   *%r11" },
+	{ opdis_x86_mode_64, 5, "\xe8\xfb\xff\xff\xff", "call   0x00401000",
+	  "call   0x00401000" },
+	{ opdis_x86_mode_64, 2, "\x74\x05", "je     0x00401007",
+	  "je     0x00401007" },
+	{ opdis_x86_mode_64, 6, "\x0f\x85\x00\x01\x00\x00",
+	  "jne    0x00401106", "jne    0x00401106" },
+	{ opdis_x86_mode_64, 1, "\xc3", "ret", "ret" },
+	{ opdis_x86_mode_64, 3, "\xc2\x08\x00", "ret    0x8", "ret    $0x8" },
+	{ opdis_x86_mode_64, 4, "\xf0\x83\x00\x01",
+	  "lock add DWORD PTR [rax],0x1", "lock addl $0x1,(%rax)" },
+	{ opdis_x86_mode_64, 3, "\x0f\xb6\xc0", "movzx  eax,al",
+	  "movzbl %al,%eax" },
+	{ opdis_x86_mode_64, 4, "\x48\x0f\xbf\x00",
+	  "movsx  rax,WORD PTR [rax]", "movswq (%rax),%rax" },
+	{ opdis_x86_mode_64, 3, "\x48\x63\xc8", "movsxd rcx,eax",
+	  "movslq %eax,%rcx" },
+	{ opdis_x86_mode_64, 10, "\x48\xb8\x88\x77\x66\x55\x44\x33\x22\x11",
+	  "movabs rax,0x1122334455667788",
+	  "movabs $0x1122334455667788,%rax" },
+	{ opdis_x86_mode_64, 3, "\x41\x88\xc0", "mov    r8b,al",
+	  "mov    %al,%r8b" },
+	{ opdis_x86_mode_64, 2, "\xd1\xe0", "shl    eax,1", "shl    %eax" },
+	{ opdis_x86_mode_64, 2, "\xd3\xe0", "shl    eax,cl",
+	  "shl    %cl,%eax" },
+	{ opdis_x86_mode_64, 3, "\x48\xf7\xf1", "div    rcx", "div    %rcx" },
+	{ opdis_x86_mode_64, 6, "\x66\x0f\x1f\x44\x00\x00",
+	  "nop    WORD PTR [rax+rax*1+0x0]", "nopw   0x0(%rax,%rax,1)" },
+	{ opdis_x86_mode_64, 8, "\x4c\x8d\x0c\x8d\x00\x00\x00\x00",
+	  "lea    r9,[rcx*4+0x0]", "lea    0x0(,%rcx,4),%r9" },
+	{ opdis_x86_mode_64, 2, "\x48\x98", "cdqe", "cltq" },
+	{ opdis_x86_mode_64, 2, "\x6a\x80", "push   0xffffffffffffff80",
+	  "push   $0xffffffffffffff80" },
+	{ opdis_x86_mode_64, 3, "\x0f\x94\xc0", "sete   al", "sete   %al" },
+	{ opdis_x86_mode_64, 3, "\x4d\x85\xc0", "test   r8,r8",
+	  "test   %r8,%r8" },
+	{ opdis_x86_mode_32, 6, "\x8b\x05\x00\x90\x04\x08",
+	  "mov    eax,DWORD PTR ds:0x8049000", "mov    0x8049000,%eax" },
+	{ opdis_x86_mode_32, 1, "\x40", "inc    eax", "inc    %eax" },
+	{ opdis_x86_mode_32, 5, "\xe9\x00\x00\x00\x00", "jmp    0x00401005",
+	  "jmp    0x00401005" },
+	{ opdis_x86_mode_32, 2, "\xff\xd0", "call   eax", "call   *%eax" }
+};
+
+/* encodings left to libopcodes */
+static const struct NATIVE_CASE fallbacks[] = {
+	{ opdis_x86_mode_64, 2, "\xf3\xc3" },			/* repz ret */
+	{ opdis_x86_mode_64, 2, "\x40\xc3" },			/* rex ret */
+	{ opdis_x86_mode_64, 2, "\x66\x90" },			/* xchg ax,ax */
+	{ opdis_x86_mode_64, 9, "\xa1\x01\x02\x03\x04\x05\x06\x07\x08" },
+	{ opdis_x86_mode_64, 2, "\xd9\xc9" },			/* fxch */
+	{ opdis_x86_mode_64, 3, "\x0f\x28\xc1" },		/* movaps */
+	{ opdis_x86_mode_64, 3, "\xc5\xf8\x77" },		/* vzeroupper */
+	{ opdis_x86_mode_64, 1, "\xa4" },			/* movsb */
+	{ opdis_x86_mode_32, 6, "\x65\xa1\x14\x00\x00\x00" },	/* mov gs: */
+	{ opdis_x86_mode_16, 3, "\xb8\x01\x02" }
+};
+
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+#define NUM_FALLBACKS (sizeof(fallbacks) / sizeof(fallbacks[0]))
+
+static opdis_insn_t * alloc_insn( void ) {
+	const opdis_insn_sizes_t * s = opdis_insn_sizes( bfd_arch_i386 );
+	return opdis_insn_alloc_fixed( s->ascii_sz, s->mnemonic_sz,
+				       s->num_operands, s->op_ascii_sz );
+}
+
+static int check_case( unsigned int num, const struct NATIVE_CASE * c,
+		       enum opdis_x86_syntax_t syntax ) {
+	const char * expected = ( syntax == opdis_x86_syntax_att ) ? c->att
+								   : c->intel;
+	opdis_insn_t * insn = alloc_insn();
+	unsigned int size;
+	int ok;
+
+	size = opdis_x86_native_decode( insn, (const opdis_byte_t *) c->bytes,
+					0, c->size, CODE_VMA, c->mode, syntax );
+	ok = ( size == c->size && insn->status == OPDIS_DECODE_ALL &&
+	       ! insn->ascii[0] );
+
+	/* the ascii is only rendered on request */
+	opdis_x86_native_render( insn, syntax );
+	ok &= ! strcmp( insn->ascii, expected );
+	if ( insn->category == opdis_insn_cat_cflow && insn->num_operands &&
+	     ! ( insn->flags.cflow & opdis_cflow_flag_ret ) ) {
+		ok &= ( insn->target == insn->operands[0] );
+	}
+	if ( strchr( c->att, '*' ) ) {
+		/* register or memory indirect branch target */
+		ok &= ( insn->num_operands && ( insn->operands[0]->flags &
+			opdis_op_flag_indirect ) );
+	}
+
+	if (! ok ) {
+		printf( "Case %u (%s): size %u '%s', expected %u '%s'\n", num,
+			( syntax == opdis_x86_syntax_att ) ? "att" : "intel",
+			size, insn->ascii, c->size, expected );
+	}
+
+	/* a truncated insn is not decoded */
+	if ( opdis_x86_native_decode( insn, (const opdis_byte_t *) c->bytes,
+				      0, c->size - 1, CODE_VMA, c->mode,
+				      syntax ) ) {
+		printf( "Case %u: truncated insn decoded\n", num );
+		ok = 0;
+	}
+
+	opdis_insn_free( insn );
+	return ok;
+}
+
+static int check_cases( void ) {
+	opdis_insn_t * insn = alloc_insn();
+	unsigned int i;
+	int ok = 1;
+
+	for ( i = 0; i < NUM_CASES; i++ ) {
+		ok &= check_case( i, &cases[i], opdis_x86_syntax_intel );
+		ok &= check_case( i, &cases[i], opdis_x86_syntax_att );
+	}
+
+	for ( i = 0; i < NUM_FALLBACKS; i++ ) {
+		if ( opdis_x86_native_decode( insn,
+				(const opdis_byte_t *) fallbacks[i].bytes, 0,
+				fallbacks[i].size, CODE_VMA, fallbacks[i].mode,
+				opdis_x86_syntax_intel ) ) {
+			printf( "Fallback %u: decoded as '%s'\n", i,
+				insn->mnemonic );
+			ok = 0;
+		}
+	}
+
+	opdis_insn_free( insn );
+	return ok;
+}
+
+/* libopcodes and the Intel decoder are the reference for the native decoder.
+ * The ascii depends on the binutils version, so it is only reported. */
+static int compare_insn( const opdis_insn_t * ref, const opdis_insn_t * n ) {
+	unsigned int i;
+	int ok;
+
+	ok = ( ref->size == n->size && ! strcmp( ref->mnemonic, n->mnemonic ) &&
+	       ref->num_operands == n->num_operands &&
+	       ref->category == n->category );
+
+	for ( i = 0; ok && i < ref->num_operands; i++ ) {
+		const opdis_op_t * a = ref->operands[i], * b = n->operands[i];
+		ok &= ( a->category == b->category );
+		if ( a->category == opdis_op_cat_register && a->value.reg.id ) {
+			ok &= ( a->value.reg.id == b->value.reg.id );
+		}
+	}
+
+	if ( ref->target && ref->target->category == opdis_op_cat_immediate ) {
+		ok &= ( n->target && n->target->value.immediate.vma ==
+			ref->target->value.immediate.vma );
+	}
+
+	if (! ok ) {
+		printf( "\t%p: '%s' decoded as '%s'\n", (void *) ref->vma,
+			ref->ascii, n->ascii );
+	} else if ( strcmp( ref->ascii, n->ascii ) ) {
+		printf( "\t%p: note: '%s' rendered as '%s'\n",
+			(void *) ref->vma, ref->ascii, n->ascii );
+	}
+
+	return ok;
+}
+
+static void ignore( const opdis_insn_t * insn, void * arg ) {
+}
+
+static int compare_cases( opdis_t o, enum opdis_x86_mode_t mode ) {
+	opdis_insn_t * ref = alloc_insn(), * n = alloc_insn();
+	unsigned int i, num = 0, bad = 0;
+
+	opdis_set_display( o, ignore, NULL );
+
+	for ( i = 0; i < NUM_CASES; i++ ) {
+		const struct NATIVE_CASE * c = &cases[i];
+		opdis_buf_t buf;
+
+		if ( c->mode != mode ) {
+			continue;
+		}
+
+		buf = opdis_buf_alloc( c->size, CODE_VMA );
+		memcpy( buf->data, c->bytes, c->size );
+
+		opdis_insn_clear( ref );
+		opdis_disasm_insn( o, buf, CODE_VMA, ref );
+
+		opdis_insn_clear( n );
+		opdis_x86_native_decode( n, buf->data, 0, c->size, CODE_VMA,
+					 mode, opdis_x86_syntax_intel );
+		opdis_x86_native_render( n, opdis_x86_syntax_intel );
+
+		bad += ! compare_insn( ref, n );
+		num++;
+		opdis_buf_free( buf );
+	}
+
+	printf( "%d-bit: %u insns compared to libopcodes, %u differ\n", mode,
+		num, bad );
+
+	opdis_insn_free( ref );
+	opdis_insn_free( n );
+	return ! bad;
+}
+
+struct SWEEP {
+	unsigned int num;
+	unsigned int empty;
+	opdis_off_t sizes[64];
+};
+
+static void display( const opdis_insn_t * insn, void * arg ) {
+	struct SWEEP * s = (struct SWEEP *) arg;
+
+	s->empty += ( ! insn->ascii || ! insn->ascii[0] );
+	if ( s->num < 64 ) {
+		s->sizes[s->num] = insn->size;
+	}
+	s->num++;
+}
+
+static void sweep( opdis_t o, opdis_buf_t buf, struct SWEEP * s ) {
+	memset( s, 0, sizeof(*s) );
+	opdis_set_display( o, display, s );
+	opdis_disasm_linear( o, buf, buf->vma, 0 );
+}
+
+/* the native decoder and libopcodes produce the same insns in a sweep; the
+ * insns passed to the display callback have been rendered */
+static int check_sweep( opdis_t o, enum opdis_x86_syntax_t syntax ) {
+	struct SWEEP ref, n;
+	opdis_buf_t buf;
+	size_t len = 0;
+	unsigned int i;
+	int ok;
+
+	for ( i = 0; i < NUM_CASES; i++ ) {
+		len += ( cases[i].mode == opdis_x86_mode_64 ) ? cases[i].size : 0;
+	}
+	for ( i = 0; i < NUM_FALLBACKS; i++ ) {
+		len += ( fallbacks[i].mode == opdis_x86_mode_64 ) ?
+			fallbacks[i].size : 0;
+	}
+
+	buf = opdis_buf_alloc( len, CODE_VMA );
+	for ( len = 0, i = 0; i < NUM_CASES; i++ ) {
+		if ( cases[i].mode == opdis_x86_mode_64 ) {
+			memcpy( &buf->data[len], cases[i].bytes,
+				cases[i].size );
+			len += cases[i].size;
+		}
+	}
+	for ( i = 0; i < NUM_FALLBACKS; i++ ) {
+		if ( fallbacks[i].mode == opdis_x86_mode_64 ) {
+			memcpy( &buf->data[len], fallbacks[i].bytes,
+				fallbacks[i].size );
+			len += fallbacks[i].size;
+		}
+	}
+
+	/* libopcodes and the text decoder for the syntax */
+	opdis_set_decoder( o, opdis_x86_att_decoder, o );
+	opdis_set_x86_syntax( o, syntax );
+	sweep( o, buf, &ref );
+
+	opdis_set_decoder( o, opdis_x86_native_decoder, o );
+	sweep( o, buf, &n );
+
+	/* changing the syntax keeps the native decoder */
+	opdis_set_x86_syntax( o, syntax );
+	ok = ( o->decoder == opdis_x86_native_decoder );
+
+	ok &= ( ref.num == n.num && ! n.empty &&
+		! memcmp( ref.sizes, n.sizes, sizeof(ref.sizes) ) );
+	printf( "%s sweep: %u insns, native %u insns, %u without ascii\n",
+		( syntax == opdis_x86_syntax_att ) ? "att" : "intel",
+		ref.num, n.num, n.empty );
+
+	opdis_buf_free( buf );
+	return ok;
+}
+
+int main( void ) {
+	opdis_t o = opdis_init();
+	int ok;
+
+	ok = check_cases();
+
+	opdis_set_arch( o, bfd_arch_i386, bfd_mach_i386_i386, NULL );
+	opdis_set_x86_syntax( o, opdis_x86_syntax_intel );
+	ok &= compare_cases( o, opdis_x86_mode_32 );
+
+	opdis_set_arch( o, bfd_arch_i386, bfd_mach_x86_64, NULL );
+	opdis_set_x86_syntax( o, opdis_x86_syntax_intel );
+	ok &= compare_cases( o, opdis_x86_mode_64 );
+
+	ok &= check_sweep( o, opdis_x86_syntax_att );
+	ok &= check_sweep( o, opdis_x86_syntax_intel );
+
+	opdis_term( o );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}
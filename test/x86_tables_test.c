@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <opdis/x86_rules.h>
+#include <opdis/x86_tables.h>
+
+#define NUM_ITEMS(a) (sizeof(a) / sizeof(a[0]))
+
+/* return index of name in slots table, or -1 */
+static int lookup( const char * name, const unsigned short * disp,
+		   unsigned int buckets, const short * slots,
+		   unsigned int num_slots, const char ** names ) {
+	int i = slots[X86_HASH_SLOT( name, disp, buckets, num_slots )];
+	return ( i > -1 && ! strcmp( names[i], name ) ) ? i : -1;
+}
+
+int main( void ) {
+	unsigned int i, num_mnem = 0;
+	int ok = ( NUM_ITEMS(intel_reg_id) == NUM_ITEMS(intel_registers) &&
+		   NUM_ITEMS(intel_reg_size) == NUM_ITEMS(intel_registers) );
+
+	/* every register and prefix must be found at its own index */
+	for ( i = 0; i < NUM_ITEMS(intel_registers); i++ ) {
+		if ( lookup( intel_registers[i], x86_register_disp,
+			     X86_REGISTER_BUCKETS, x86_register_slots,
+			     X86_REGISTER_SLOTS, intel_registers ) != (int) i ) {
+			printf( "Register %s not found\n", intel_registers[i] );
+			ok = 0;
+		}
+	}
+	for ( i = 0; i < NUM_ITEMS(intel_prefixes); i++ ) {
+		if ( lookup( intel_prefixes[i], x86_prefix_disp,
+			     X86_PREFIX_BUCKETS, x86_prefix_slots,
+			     X86_PREFIX_SLOTS, intel_prefixes ) != (int) i ) {
+			printf( "Prefix %s not found\n", intel_prefixes[i] );
+			ok = 0;
+		}
+	}
+	ok &= ( lookup( "xmm8x", x86_register_disp, X86_REGISTER_BUCKETS,
+			x86_register_slots, X86_REGISTER_SLOTS,
+			intel_registers ) == -1 );
+
+	/* every mnemonic must be in its own slot, and match the rules */
+	for ( i = 0; i < X86_MNEMONIC_SLOTS; i++ ) {
+		const x86_mnemonic_def_t * def = &x86_mnemonic_slots[i];
+		opdis_insn_t insn;
+
+		if (! def->name ) {
+			continue;
+		}
+		num_mnem++;
+
+		memset( &insn, 0, sizeof(insn) );
+		insn.category = opdis_insn_cat_unknown;
+		x86_mnemonic_rules( &insn, def->name );
+
+		if ( X86_HASH_SLOT( def->name, x86_mnemonic_disp,
+				    X86_MNEMONIC_BUCKETS,
+				    X86_MNEMONIC_SLOTS ) != i ||
+		     def->category != insn.category ||
+		     def->flags != insn.flags.cflow || def->isa != insn.isa ) {
+			printf( "Mnemonic %s does not match rules\n", def->name );
+			ok = 0;
+		}
+	}
+
+	printf( "Mnemonics: %u Registers: %u Prefixes: %u\n", num_mnem,
+		(unsigned int) NUM_ITEMS(intel_registers),
+		(unsigned int) NUM_ITEMS(intel_prefixes) );
+
+	printf( "%s\n", ok ? "PASS" : "FAIL" );
+	return ok ? 0 : 1;
+}